@@ -22,6 +22,9 @@
 	
 	The Overlays Extension provides Horde3D with ability to render text and images above the rendered image.
 	Extension is also used as a demonstration of registering new pipeline commands in the engine.
+
+	The functions of the extension are not recorded by h3dBeginCapture, so overlays are missing when a
+	capture is replayed.
 */
 
 
@@ -36,10 +39,14 @@
 		of the viewport, the size of overlays can always be the same, even when different screen formats
 		(standard 4:3, widescreen 16:9, etc.) are used. Texture coordinates are using a system where the
 		coordinates (0, 0) correspond to the lower left corner of the image.
-		Overlays are drawn in the order in which they are pushed using this function. Overlays with
-		the same state will be batched together, so it can make sense to group overlays that have the
-		same material, color and flags in order to achieve best performance.
+		Overlays are drawn in the order in which they are pushed using this function. Consecutive overlays
+		with the same material and flags will be batched together, so it can make sense to group overlays
+		that have the same material and flags in order to achieve best performance. The color is stored
+		per vertex and is passed to shaders as the vertex attribute vertColor, so it does not break batches.
+		The shader uniform olayColor that carried the color in earlier versions is always set to white.
 		Note that the overlays have to be removed manually using the function h3dClearOverlays.
+		Overlays that do not change every frame should be put into an overlay layer (see
+		h3dCreateOverlayLayer), which avoids resubmitting and uploading them each frame.
 	
 	Parameters:
 		verts                   - vertex data (x, y, u, v), interpreted as quads
@@ -70,6 +77,178 @@ H3D_API void h3dShowOverlays( const float *verts, int vertCount, float colR, flo
 H3D_API void h3dClearOverlays();
 
 
+/* Function: h3dCreateOverlayLayer
+		Creates a retained overlay layer.
+	
+	Details:
+		This function creates a layer that keeps its overlays in video memory until they are explicitly
+		changed. Overlays are added once to the layer and can later be modified in place; only the changed
+		vertex range is uploaded again. Layers are drawn by the DrawOverlays pipeline command before the
+		overlays added with h3dShowOverlays, in the order of their creation.
+		The coordinate system and vertex format are the same as for h3dShowOverlays.
+	
+	Parameters:
+		maxVertCount  - maximum number of vertices the layer can hold (rounded up to a multiple of 4)
+		
+	Returns:
+		handle to the created layer or 0 in case of failure
+*/
+H3D_API int h3dCreateOverlayLayer( int maxVertCount );
+
+
+/* Function: h3dDestroyOverlayLayer
+		Destroys an overlay layer.
+	
+	Details:
+		This function destroys a layer created with h3dCreateOverlayLayer and releases its video memory.
+	
+	Parameters:
+		layer  - handle to the layer
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dDestroyOverlayLayer( int layer );
+
+
+/* Function: h3dClearOverlayLayer
+		Removes all overlays from a layer.
+	
+	Details:
+		This function removes all overlays of a layer; the layer itself remains valid.
+	
+	Parameters:
+		layer  - handle to the layer
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dClearOverlayLayer( int layer );
+
+
+/* Function: h3dSetOverlayLayerVisible
+		Shows or hides an overlay layer.
+	
+	Details:
+		This function sets whether a layer is drawn. Hidden layers keep their overlays.
+	
+	Parameters:
+		layer    - handle to the layer
+		visible  - true if the layer shall be drawn
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dSetOverlayLayerVisible( int layer, bool visible );
+
+
+/* Function: h3dAddOverlayLayerQuads
+		Adds overlays to a layer.
+	
+	Details:
+		This function appends one or more overlays to a layer. The parameters are the same as for
+		h3dShowOverlays. The returned vertex index identifies the added overlays in later calls to
+		h3dUpdateOverlayLayerQuads and h3dSetOverlayLayerColor.
+	
+	Parameters:
+		layer                   - handle to the layer
+		verts                   - vertex data (x, y, u, v), interpreted as quads
+		vertCount               - number of vertices (must be multiple of 4)
+		colR, colG, colB, colA  - color (and transparency) of overlays
+		materialRes             - material resource used for rendering
+		flags                   - overlay flags (reserved for future use)
+		
+	Returns:
+		index of the first added vertex in the layer or -1 in case of failure
+*/
+H3D_API int h3dAddOverlayLayerQuads( int layer, const float *verts, int vertCount, float colR, float colG,
+                                     float colB, float colA, H3DRes materialRes, int flags );
+
+
+/* Function: h3dAddOverlayLayerText
+		Adds a text label to a layer.
+	
+	Details:
+		This function appends a text string to a layer like h3dShowText does for the current frame. Space
+		for maxChars characters is reserved, so that the label can be changed later with
+		h3dUpdateOverlayLayerText. The label occupies 4 vertices per reserved character.
+	
+	Parameters:
+		layer             - handle to the layer
+		text              - text string to be displayed
+		maxChars          - number of characters to reserve; the length of text is used if it is larger
+		x, y              - position of the lower left corner of the first character
+		size              - size (scale) factor of the font
+		colR, colG, colB  - font color
+		fontMaterialRes   - font material resource used for rendering
+		
+	Returns:
+		index of the first vertex of the label in the layer or -1 in case of failure
+*/
+H3D_API int h3dAddOverlayLayerText( int layer, const char *text, int maxChars, float x, float y, float size,
+                                    float colR, float colG, float colB, H3DRes fontMaterialRes );
+
+
+/* Function: h3dUpdateOverlayLayerQuads
+		Changes the vertices of overlays in a layer.
+	
+	Details:
+		This function overwrites the positions and texture coordinates of existing vertices of a layer.
+		Colors, materials and flags are not changed.
+	
+	Parameters:
+		layer      - handle to the layer
+		firstVert  - index of the first vertex to change
+		verts      - vertex data (x, y, u, v)
+		vertCount  - number of vertices to change
+		
+	Returns:
+		true in case of success, otherwise false
+*/
+H3D_API bool h3dUpdateOverlayLayerQuads( int layer, int firstVert, const float *verts, int vertCount );
+
+
+/* Function: h3dUpdateOverlayLayerText
+		Changes a text label in a layer.
+	
+	Details:
+		This function replaces the string and position of a label added with h3dAddOverlayLayerText.
+		Characters exceeding maxChars are cut off.
+	
+	Parameters:
+		layer      - handle to the layer
+		firstVert  - index of the first vertex of the label as returned by h3dAddOverlayLayerText
+		maxChars   - number of characters reserved for the label
+		text       - new text string
+		x, y       - position of the lower left corner of the first character
+		size       - size (scale) factor of the font
+		
+	Returns:
+		true in case of success, otherwise false
+*/
+H3D_API bool h3dUpdateOverlayLayerText( int layer, int firstVert, int maxChars, const char *text,
+                                        float x, float y, float size );
+
+
+/* Function: h3dSetOverlayLayerColor
+		Changes the color of overlays in a layer.
+	
+	Details:
+		This function sets the color of a range of vertices of a layer.
+	
+	Parameters:
+		layer                   - handle to the layer
+		firstVert               - index of the first vertex to change
+		vertCount               - number of vertices to change
+		colR, colG, colB, colA  - new color (and transparency)
+		
+	Returns:
+		true in case of success, otherwise false
+*/
+H3D_API bool h3dSetOverlayLayerColor( int layer, int firstVert, int vertCount, float colR, float colG,
+                                      float colB, float colA );
+
+
 /* Function: h3dShowText
 		Shows text on the screen using a font texture.
 
@@ -58,6 +58,81 @@ H3D_IMPL void h3dClearOverlays()
 }
 
 
+H3D_IMPL int h3dCreateOverlayLayer( int maxVertCount )
+{
+	if ( maxVertCount <= 0 )
+	{
+		Modules::setError( "Invalid vertex count in h3dCreateOverlayLayer" );
+		return 0;
+	}
+	return OverlayRenderer::createLayer( ( uint32 ) maxVertCount );
+}
+
+
+H3D_IMPL void h3dDestroyOverlayLayer( int layer )
+{
+	OverlayRenderer::destroyLayer( layer );
+}
+
+
+H3D_IMPL void h3dClearOverlayLayer( int layer )
+{
+	OverlayRenderer::clearLayer( layer );
+}
+
+
+H3D_IMPL void h3dSetOverlayLayerVisible( int layer, bool visible )
+{
+	OverlayRenderer::setLayerVisible( layer, visible );
+}
+
+
+H3D_IMPL int h3dAddOverlayLayerQuads( int layer, const float *verts, int vertCount, float colR, float colG,
+                                      float colB, float colA, ResHandle materialRes, int flags )
+{
+	Resource *resObj = Modules::resMan().resolveResHandle( materialRes );
+	APIFUNC_VALIDATE_RES_TYPE( resObj, ResourceTypes::Material, "h3dAddOverlayLayerQuads", -1 );
+	if ( verts == 0x0 || vertCount <= 0 ) return -1;
+	float rgba[ 4 ] = { colR, colG, colB, colA };
+	return OverlayRenderer::addLayerOverlays( layer, verts, ( uint32 ) vertCount, rgba, ( MaterialResource * ) resObj, flags );
+}
+
+
+H3D_IMPL int h3dAddOverlayLayerText( int layer, const char *text, int maxChars, float x, float y, float size,
+                                     float colR, float colG, float colB, ResHandle fontMaterialRes )
+{
+	Resource *resObj = Modules::resMan().resolveResHandle( fontMaterialRes );
+	APIFUNC_VALIDATE_RES_TYPE( resObj, ResourceTypes::Material, "h3dAddOverlayLayerText", -1 );
+	float rgb[ 3 ] = { colR, colG, colB };
+	return OverlayRenderer::addLayerText( layer, text, ( uint32 ) std::max( maxChars, 0 ), x, y, size, rgb,
+	                                      ( MaterialResource * ) resObj );
+}
+
+
+H3D_IMPL bool h3dUpdateOverlayLayerQuads( int layer, int firstVert, const float *verts, int vertCount )
+{
+	if ( verts == 0x0 || firstVert < 0 || vertCount < 0 ) return false;
+	return OverlayRenderer::updateLayerOverlays( layer, ( uint32 ) firstVert, verts, ( uint32 ) vertCount );
+}
+
+
+H3D_IMPL bool h3dUpdateOverlayLayerText( int layer, int firstVert, int maxChars, const char *text,
+                                         float x, float y, float size )
+{
+	if ( firstVert < 0 || maxChars < 0 ) return false;
+	return OverlayRenderer::updateLayerText( layer, ( uint32 ) firstVert, ( uint32 ) maxChars, text, x, y, size );
+}
+
+
+H3D_IMPL bool h3dSetOverlayLayerColor( int layer, int firstVert, int vertCount, float colR, float colG,
+                                       float colB, float colA )
+{
+	if ( firstVert < 0 || vertCount < 0 ) return false;
+	float rgba[ 4 ] = { colR, colG, colB, colA };
+	return OverlayRenderer::setLayerColor( layer, ( uint32 ) firstVert, ( uint32 ) vertCount, rgba );
+}
+
+
 H3D_IMPL void h3dShowText( const char *text, float x, float y, float size, float colR,
                            float colG, float colB, ResHandle fontMaterialRes )
 {
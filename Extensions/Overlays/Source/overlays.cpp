@@ -30,8 +30,19 @@ using namespace Horde3D;
 const uint32 MaxNumOverlayVerts = 8192;
 const uint32 QuadIdxBufCount = MaxNumOverlayVerts * 6;
 
+// The immediate overlays of a frame are appended to a ring buffer that holds several frames, so
+// that only the used range is uploaded and the driver does not have to wait for pending draws
+const uint32 OverlayRingVerts = QuadIdxBufCount / 6 * 4;
+
+const uint32 MaxNumLayerVerts = 1024 * 1024;
+const uint32 MaxNumTextChars = 64;
+
 uint32 OverlayRenderer::_overlayGeo = 0;
 uint32 OverlayRenderer::_overlayVB = 0;
+uint32 OverlayRenderer::_quadIdxBuf = 0;
+uint32 OverlayRenderer::_ringOffset = 0;
+uint32 OverlayRenderer::_ringBaseVert = 0;
+bool OverlayRenderer::_overlaysDirty = false;
 int OverlayRenderer::_uni_olayColor = -1;
 int OverlayRenderer::_vlOverlay = -1;
 InfoBox OverlayRenderer::_infoBox;
@@ -40,6 +51,7 @@ InfoBox OverlayRenderer::_infoBox;
 
 std::vector< OverlayBatch > OverlayRenderer::_overlayBatches = {};
 OverlayVert *OverlayRenderer::_overlayVerts = nullptr;
+std::vector< OverlayLayer * > OverlayRenderer::_layers;
 
 
 
@@ -54,6 +66,7 @@ const char * OverlayRenderer::parsePipelineCommandFunc( const char *commandName,
 		vector< PipeCmdParam > &params = cmd.params;
 		params.resize( 1 );
 		params[ 0 ].setString( node->getAttribute( "context" ) );
+		params[ 0 ].setInt( ShaderResource::getContextID( node->getAttribute( "context" ) ) );
 	}
 
 	return "";
@@ -62,7 +75,7 @@ const char * OverlayRenderer::parsePipelineCommandFunc( const char *commandName,
 
 void OverlayRenderer::executePipelineCommandFunc( const PipelineCommand *commandParams )
 {
-	drawOverlays( commandParams->params[ 0 ].getString() );
+	drawOverlays( commandParams->params[ 0 ].getInt() );
 }
 
 
@@ -71,11 +84,12 @@ bool OverlayRenderer::init()
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
 	// Create vertex layout
-	VertexLayoutAttrib attribsOverlay[ 2 ] = {
+	VertexLayoutAttrib attribsOverlay[ 3 ] = {
 		{ "vertPos", 0, 2, 0 },
-		{ "texCoords0", 0, 2, 8 }
+		{ "texCoords0", 0, 2, 8 },
+		{ "vertColor", 0, 4, 16 }
 	};
-	_vlOverlay = Modules::renderer().getRenderDevice()->registerVertexLayout( 2, attribsOverlay );
+	_vlOverlay = Modules::renderer().getRenderDevice()->registerVertexLayout( 3, attribsOverlay );
 
 	// Create index buffer used for drawing overlay quads
 	uint16 *quadIndices = new uint16[ QuadIdxBufCount ];
@@ -85,18 +99,21 @@ bool OverlayRenderer::init()
 		quadIndices[ i * 6 + 3 ] = i * 4 + 2; quadIndices[ i * 6 + 4 ] = i * 4 + 3; quadIndices[ i * 6 + 5 ] = i * 4 + 0;
 	}
 	
-	int quadIdxBuf = rdi->createIndexBuffer( QuadIdxBufCount * sizeof( uint16 ), quadIndices );
+	_quadIdxBuf = rdi->createIndexBuffer( QuadIdxBufCount * sizeof( uint16 ), quadIndices );
 	delete[] quadIndices; quadIndices = 0x0;
 
 	_overlayBatches.reserve( 64 );
 	_overlayVerts = new OverlayVert[ MaxNumOverlayVerts ];
-	_overlayVB = rdi->createVertexBuffer( MaxNumOverlayVerts * sizeof( OverlayVert ), 0x0 );
+	_overlayVB = rdi->createVertexBuffer( OverlayRingVerts * sizeof( OverlayVert ), 0x0 );
+	_ringOffset = 0;
+	_ringBaseVert = 0;
+	_overlaysDirty = false;
 
 	// Create geometry bindings
 	_overlayGeo = rdi->beginCreatingGeometry( _vlOverlay );
 
 	rdi->setGeomVertexParams( _overlayGeo, _overlayVB, 0, 0, sizeof( OverlayVert ) );
-	rdi->setGeomIndexParams( _overlayGeo, quadIdxBuf, IDXFMT_16 );
+	rdi->setGeomIndexParams( _overlayGeo, _quadIdxBuf, IDXFMT_16 );
 
 	rdi->finishCreatingGeometry( _overlayGeo );
 
@@ -116,126 +133,397 @@ void OverlayRenderer::release()
 {
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
+	for ( size_t i = 0; i < _layers.size(); ++i )
+		destroyLayer( ( int ) i + 1 );
+	_layers.clear();
+
 	rdi->destroyGeometry( _overlayGeo );
-	delete[] _overlayVerts;
+	delete[] _overlayVerts; _overlayVerts = 0x0;
 
 	_overlayBatches.clear();
 	_overlayVB = 0;
+	_quadIdxBuf = 0;
 	_vlOverlay = -1;
 }
 
 
-void OverlayRenderer::showOverlays( const float *verts, uint32 vertCount, float *colRGBA,
-	MaterialResource *matRes, int flags )
+OverlayVert *OverlayRenderer::appendBatch( vector< OverlayBatch > &batches, OverlayVert *verts, uint32 maxVertCount,
+										   uint32 vertCount, MaterialResource *matRes, int flags )
 {
-	uint32 numOverlayVerts = 0;
-	if ( !_overlayBatches.empty() )
-		numOverlayVerts = _overlayBatches.back().firstVert + _overlayBatches.back().vertCount;
+	uint32 numVerts = 0;
+	if ( !batches.empty() )
+		numVerts = batches.back().firstVert + batches.back().vertCount;
 
-	if ( numOverlayVerts + vertCount > MaxNumOverlayVerts ) return;
+	if ( numVerts + vertCount > maxVertCount ) return 0x0;
 
-	memcpy( &_overlayVerts[ numOverlayVerts ], verts, vertCount * sizeof( OverlayVert ) );
+	// Check if previous batch can be extended; color is a vertex attribute and does not break batches
+	if ( !batches.empty() && matRes == batches.back().materialRes && flags == batches.back().flags )
+		batches.back().vertCount += vertCount;
+	else
+		batches.push_back( OverlayBatch( numVerts, vertCount, matRes, flags ) );
 
-	// Check if previous batch can be extended
-	if ( !_overlayBatches.empty() )
+	return &verts[ numVerts ];
+}
+
+
+uint32 OverlayRenderer::buildTextVerts( const char *text, uint32 maxChars, float x, float y, float size,
+										OverlayVert *verts )
+{
+	uint32 numChars = 0;
+	OverlayVert *p = verts;
+
+	for ( ; text[ numChars ] != '\0' && numChars < maxChars; ++numChars, p += 4 )
 	{
-		OverlayBatch &prevBatch = _overlayBatches.back();
-		if ( matRes == prevBatch.materialRes && flags == prevBatch.flags &&
-			memcmp( colRGBA, prevBatch.colRGBA, 4 * sizeof( float ) ) == 0 )
-		{
-			prevBatch.vertCount += vertCount;
-			return;
-		}
+		unsigned char ch = ( unsigned char ) text[ numChars ];
+
+		float x0 = x + size * 0.5f * numChars, x1 = x0 + size;
+		float u0 = 0.0625f * ( ch % 16 ), u1 = u0 + 0.0625f;
+		float v0 = 1.0f - 0.0625f * ( ch / 16 ), v1 = v0 - 0.0625f;
+
+		p[ 0 ].x = x0; p[ 0 ].y = y;         p[ 0 ].u = u0; p[ 0 ].v = v0;
+		p[ 1 ].x = x0; p[ 1 ].y = y + size;  p[ 1 ].u = u0; p[ 1 ].v = v1;
+		p[ 2 ].x = x1; p[ 2 ].y = y + size;  p[ 2 ].u = u1; p[ 2 ].v = v1;
+		p[ 3 ].x = x1; p[ 3 ].y = y;         p[ 3 ].u = u1; p[ 3 ].v = v0;
 	}
 
-	// Create new batch
-	_overlayBatches.push_back( OverlayBatch( numOverlayVerts, vertCount, colRGBA, matRes, flags ) );
+	return numChars;
+}
+
+
+void OverlayRenderer::showOverlays( const float *verts, uint32 vertCount, const float *colRGBA,
+	MaterialResource *matRes, int flags )
+{
+	OverlayVert *dst = appendBatch( _overlayBatches, _overlayVerts, MaxNumOverlayVerts, vertCount, matRes, flags );
+	if ( dst == 0x0 ) return;
+
+	for ( uint32 i = 0; i < vertCount; ++i, verts += 4 )
+	{
+		dst[ i ].x = verts[ 0 ]; dst[ i ].y = verts[ 1 ]; dst[ i ].u = verts[ 2 ]; dst[ i ].v = verts[ 3 ];
+		dst[ i ].r = colRGBA[ 0 ]; dst[ i ].g = colRGBA[ 1 ]; dst[ i ].b = colRGBA[ 2 ]; dst[ i ].a = colRGBA[ 3 ];
+	}
+	_overlaysDirty = true;
 }
 
 
 void OverlayRenderer::clearOverlays()
 {
 	_overlayBatches.resize( 0 );
+	_overlaysDirty = true;
+}
+
+
+void OverlayRenderer::drawBatches( const vector< OverlayBatch > &batches, uint32 baseVert, int shaderContextID,
+								   MaterialResource *&curMatRes, ShaderCombination *&curShader )
+{
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	
+	for ( size_t i = 0, s = batches.size(); i < s; ++i )
+	{
+		const OverlayBatch &ob = batches[ i ];
+
+		if ( curMatRes != ob.materialRes )
+		{
+			if ( !Modules::renderer().setMaterial( ob.materialRes, shaderContextID ) )
+			{
+				// Unsuccessful material setting probably has destroyed the last setted material
+				curMatRes = 0x0;
+				continue;
+			}
+
+			curMatRes = ob.materialRes;
+			curShader = Modules::renderer().getCurShader();
+//			_uni_olayColor = getInternalUniformLocation( ob.materialRes );
+
+			// Color is taken from the vertices; the uniform only remains as global tint for custom shaders
+			float white[ 4 ] = { 1, 1, 1, 1 };
+			if ( curShader->uniLocs[ _uni_olayColor ] >= 0 )
+				rdi->setShaderConst( curShader->uniLocs[ _uni_olayColor ], CONST_FLOAT4, white );
+		}
+
+		// Draw batch
+		uint32 firstVert = baseVert + ob.firstVert;
+		rdi->drawIndexed( PRIM_TRILIST, firstVert * 6 / 4, ob.vertCount * 6 / 4, firstVert, ob.vertCount );
+	}
 }
 
 
-void OverlayRenderer::drawOverlays( const string &shaderContext )
+void OverlayRenderer::drawOverlays( int shaderContextID )
 {
 	uint32 numOverlayVerts = 0;
 	if ( !_overlayBatches.empty() )
 		numOverlayVerts = _overlayBatches.back().firstVert + _overlayBatches.back().vertCount;
 
-	if ( numOverlayVerts == 0 ) return;
+	bool layersVisible = false;
+	for ( size_t i = 0; i < _layers.size(); ++i )
+	{
+		if ( _layers[ i ] != 0x0 && _layers[ i ]->visible && !_layers[ i ]->batches.empty() )
+			layersVisible = true;
+	}
+
+	if ( numOverlayVerts == 0 && !layersVisible ) return;
 
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 	CameraNode *curCamera = Modules::renderer().getCurCamera();
 	if ( curCamera == 0x0 ) return;
 
-	// Upload overlay vertices
-	rdi->updateBufferData( _overlayGeo, _overlayVB, 0, MaxNumOverlayVerts * sizeof( OverlayVert ), _overlayVerts );
-
-	rdi->setGeometry( _overlayGeo );
-	ASSERT( QuadIdxBufCount >= MaxNumOverlayVerts * 6 );
-
 	float aspect = ( float ) curCamera->getViewportWidth() / ( float ) curCamera->getViewportHeight();
 	Modules::renderer().setupViewMatrices( Matrix4f(), Matrix4f::OrthoMat( 0, aspect, 1, 0, -1, 1 ) );
 
 	MaterialResource *curMatRes = 0x0;
 	ShaderCombination *curShader = 0x0;
 
-	for ( size_t i = 0, s = _overlayBatches.size(); i < s; ++i )
+	// Retained layers are drawn below the immediate overlays, in order of creation
+	for ( size_t i = 0; i < _layers.size(); ++i )
 	{
-		OverlayBatch &ob = _overlayBatches[ i ];
+		OverlayLayer *layer = _layers[ i ];
+		if ( layer == 0x0 || !layer->visible || layer->batches.empty() ) continue;
 
-		if ( curMatRes != ob.materialRes )
+		if ( layer->dirtyBegin < layer->dirtyEnd )
 		{
-			if ( !Modules::renderer().setMaterial( ob.materialRes, shaderContext ) )
-			{
-				// Unsuccessful material setting probably has destroyed the last setted material
-				curMatRes = 0x0;
-				continue;
-			}
+			rdi->updateBufferData( layer->geo, layer->vb, layer->dirtyBegin * sizeof( OverlayVert ),
+			                       ( layer->dirtyEnd - layer->dirtyBegin ) * sizeof( OverlayVert ),
+			                       &layer->verts[ layer->dirtyBegin ] );
+			layer->dirtyBegin = layer->dirtyEnd = 0;
+		}
 
-			curMatRes = ob.materialRes;
-			curShader = Modules::renderer().getCurShader();
-//			_uni_olayColor = getInternalUniformLocation( ob.materialRes );
+		rdi->setGeometry( layer->geo );
+		drawBatches( layer->batches, 0, shaderContextID, curMatRes, curShader );
+	}
+
+	if ( numOverlayVerts == 0 ) return;
+
+	// Upload used range of overlay vertices if they have changed since the last call
+	if ( _overlaysDirty )
+	{
+		ASSERT( numOverlayVerts <= OverlayRingVerts );
+		if ( _ringOffset + numOverlayVerts > OverlayRingVerts )
+		{
+			// Orphan storage when wrapping around so that pending draws can still use the old data
+			rdi->updateBufferData( _overlayGeo, _overlayVB, 0, OverlayRingVerts * sizeof( OverlayVert ), 0x0 );
+			_ringOffset = 0;
 		}
+		
+		rdi->updateBufferData( _overlayGeo, _overlayVB, _ringOffset * sizeof( OverlayVert ),
+		                       numOverlayVerts * sizeof( OverlayVert ), _overlayVerts );
+		_ringBaseVert = _ringOffset;
+		_ringOffset += ( numOverlayVerts + 3 ) & ~3u;
+		_overlaysDirty = false;
+	}
 
-		if ( curShader->uniLocs[ _uni_olayColor ] >= 0 )
-			rdi->setShaderConst( curShader->uniLocs[ _uni_olayColor ], CONST_FLOAT4, ob.colRGBA );
+	rdi->setGeometry( _overlayGeo );
+	ASSERT( QuadIdxBufCount >= OverlayRingVerts / 4 * 6 );
 
-		// Draw batch
-		rdi->drawIndexed( PRIM_TRILIST, ob.firstVert * 6 / 4, ob.vertCount * 6 / 4, ob.firstVert, ob.vertCount );
+	drawBatches( _overlayBatches, _ringBaseVert, shaderContextID, curMatRes, curShader );
+}
+
+
+// =================================================================================================
+// Retained Layers
+// =================================================================================================
+
+OverlayLayer *OverlayRenderer::getLayer( int layer )
+{
+	if ( layer <= 0 || layer > ( int ) _layers.size() ) return 0x0;
+	return _layers[ layer - 1 ];
+}
+
+
+int OverlayRenderer::createLayer( uint32 maxVertCount )
+{
+	if ( maxVertCount == 0 || maxVertCount > MaxNumLayerVerts ) return 0;
+	maxVertCount = ( maxVertCount + 3 ) & ~3u;
+
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	OverlayLayer *layer = new OverlayLayer();
+	layer->maxVertCount = maxVertCount;
+	layer->verts.resize( maxVertCount );
+	layer->vb = rdi->createVertexBuffer( maxVertCount * sizeof( OverlayVert ), 0x0 );
+
+	// Small layers share the quad index buffer of the immediate overlays
+	RDIIndexFormat idxFormat = IDXFMT_16;
+	uint32 idxBuf = _quadIdxBuf;
+	if ( maxVertCount > OverlayRingVerts )
+	{
+		uint32 numQuads = maxVertCount / 4;
+		uint32 *quadIndices = new uint32[ numQuads * 6 ];
+		for ( uint32 i = 0; i < numQuads; ++i )
+		{
+			quadIndices[ i * 6 + 0 ] = i * 4 + 0; quadIndices[ i * 6 + 1 ] = i * 4 + 1; quadIndices[ i * 6 + 2 ] = i * 4 + 2;
+			quadIndices[ i * 6 + 3 ] = i * 4 + 2; quadIndices[ i * 6 + 4 ] = i * 4 + 3; quadIndices[ i * 6 + 5 ] = i * 4 + 0;
+		}
+		layer->ib = rdi->createIndexBuffer( numQuads * 6 * sizeof( uint32 ), quadIndices );
+		delete[] quadIndices; quadIndices = 0x0;
+
+		idxFormat = IDXFMT_32;
+		idxBuf = layer->ib;
 	}
+
+	layer->geo = rdi->beginCreatingGeometry( _vlOverlay );
+	rdi->setGeomVertexParams( layer->geo, layer->vb, 0, 0, sizeof( OverlayVert ) );
+	rdi->setGeomIndexParams( layer->geo, idxBuf, idxFormat );
+	rdi->finishCreatingGeometry( layer->geo );
+
+	// Reuse free slot
+	for ( size_t i = 0; i < _layers.size(); ++i )
+	{
+		if ( _layers[ i ] == 0x0 )
+		{
+			_layers[ i ] = layer;
+			return ( int ) i + 1;
+		}
+	}
+
+	_layers.push_back( layer );
+	return ( int ) _layers.size();
 }
 
 
-void OverlayRenderer::showText( const char *text, float x, float y, float size, 
-								float colR, float colG, float colB, Horde3D::MaterialResource *fontMatRes )
+void OverlayRenderer::destroyLayer( int layer )
 {
-	if ( text == 0x0 || *text == '\0' ) return;
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 ) return;
 
-	float ovFontVerts[ 64 * 16 ];
-	float *p = ovFontVerts;
-	float pos = 0;
+	// Buffers are released with the geometry; the shared quad index buffer is reference counted
+	Modules::renderer().getRenderDevice()->destroyGeometry( l->geo );
+
+	delete l;
+	_layers[ layer - 1 ] = 0x0;
+}
 
-	do
+
+void OverlayRenderer::clearLayer( int layer )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 ) return;
+
+	l->batches.resize( 0 );
+	l->dirtyBegin = l->dirtyEnd = 0;
+}
+
+
+void OverlayRenderer::setLayerVisible( int layer, bool visible )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l != 0x0 ) l->visible = visible;
+}
+
+
+int OverlayRenderer::addLayerOverlays( int layer, const float *verts, uint32 vertCount, const float *colRGBA,
+									   MaterialResource *matRes, int flags )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 || vertCount == 0 ) return -1;
+
+	OverlayVert *dst = appendBatch( l->batches, &l->verts[ 0 ], l->maxVertCount, vertCount, matRes, flags );
+	if ( dst == 0x0 ) return -1;
+
+	for ( uint32 i = 0; i < vertCount; ++i, verts += 4 )
 	{
-		unsigned char ch = ( unsigned char ) *text++;
+		dst[ i ].x = verts[ 0 ]; dst[ i ].y = verts[ 1 ]; dst[ i ].u = verts[ 2 ]; dst[ i ].v = verts[ 3 ];
+		dst[ i ].r = colRGBA[ 0 ]; dst[ i ].g = colRGBA[ 1 ]; dst[ i ].b = colRGBA[ 2 ]; dst[ i ].a = colRGBA[ 3 ];
+	}
+
+	uint32 firstVert = ( uint32 ) ( dst - &l->verts[ 0 ] );
+	l->markDirty( firstVert, vertCount );
+	return ( int ) firstVert;
+}
+
 
-		float u0 = 0.0625f * ( ch % 16 );
-		float v0 = 1.0f - 0.0625f * ( ch / 16 );
+int OverlayRenderer::addLayerText( int layer, const char *text, uint32 maxChars, float x, float y, float size,
+								   const float *colRGB, MaterialResource *fontMatRes )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 || text == 0x0 ) return -1;
 
-		*p++ = x + size * 0.5f * pos;         *p++ = y;         *p++ = u0;            *p++ = v0;
-		*p++ = x + size * 0.5f * pos, *p++ = y + size;  *p++ = u0;            *p++ = v0 - 0.0625f;
-		*p++ = x + size * 0.5f * pos + size;  *p++ = y + size;  *p++ = u0 + 0.0625f;  *p++ = v0 - 0.0625f;
-		*p++ = x + size * 0.5f * pos + size;  *p++ = y;         *p++ = u0 + 0.0625f;  *p++ = v0;
+	// Reserve space for the longer of text and maxChars so that the label can be updated later
+	maxChars = std::max( maxChars, ( uint32 ) strlen( text ) );
+	if ( maxChars == 0 ) return -1;
 
-		pos += 1.f;
-	} while ( *text && pos < 64 );
+	OverlayVert *dst = appendBatch( l->batches, &l->verts[ 0 ], l->maxVertCount, maxChars * 4, fontMatRes, 0 );
+	if ( dst == 0x0 ) return -1;
 
-	float color[ 4 ] = { colR, colG, colB, 1.f };
-	showOverlays( ovFontVerts, ( int ) pos * 4, color, fontMatRes, 0 );
+	for ( uint32 i = 0; i < maxChars * 4; ++i )
+	{
+		dst[ i ].r = colRGB[ 0 ]; dst[ i ].g = colRGB[ 1 ]; dst[ i ].b = colRGB[ 2 ]; dst[ i ].a = 1.0f;
+	}
+
+	uint32 firstVert = ( uint32 ) ( dst - &l->verts[ 0 ] );
+	updateLayerText( layer, firstVert, maxChars, text, x, y, size );
+	return ( int ) firstVert;
+}
+
+
+bool OverlayRenderer::updateLayerOverlays( int layer, uint32 firstVert, const float *verts, uint32 vertCount )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 || l->batches.empty() ) return false;
+	if ( firstVert + vertCount > l->batches.back().firstVert + l->batches.back().vertCount ) return false;
+
+	OverlayVert *dst = &l->verts[ firstVert ];
+	for ( uint32 i = 0; i < vertCount; ++i, verts += 4 )
+	{
+		dst[ i ].x = verts[ 0 ]; dst[ i ].y = verts[ 1 ]; dst[ i ].u = verts[ 2 ]; dst[ i ].v = verts[ 3 ];
+	}
+
+	l->markDirty( firstVert, vertCount );
+	return true;
+}
+
+
+bool OverlayRenderer::updateLayerText( int layer, uint32 firstVert, uint32 maxChars, const char *text,
+									   float x, float y, float size )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 || l->batches.empty() || text == 0x0 ) return false;
+	if ( firstVert + maxChars * 4 > l->batches.back().firstVert + l->batches.back().vertCount ) return false;
+
+	OverlayVert *dst = &l->verts[ firstVert ];
+	uint32 numChars = buildTextVerts( text, maxChars, x, y, size, dst );
+
+	// Collapse unused glyphs of the reserved range
+	for ( uint32 i = numChars * 4; i < maxChars * 4; ++i )
+	{
+		dst[ i ].x = x; dst[ i ].y = y;
+	}
+
+	l->markDirty( firstVert, maxChars * 4 );
+	return true;
+}
+
+
+bool OverlayRenderer::setLayerColor( int layer, uint32 firstVert, uint32 vertCount, const float *colRGBA )
+{
+	OverlayLayer *l = getLayer( layer );
+	if ( l == 0x0 || l->batches.empty() ) return false;
+	if ( firstVert + vertCount > l->batches.back().firstVert + l->batches.back().vertCount ) return false;
+
+	OverlayVert *dst = &l->verts[ firstVert ];
+	for ( uint32 i = 0; i < vertCount; ++i )
+	{
+		dst[ i ].r = colRGBA[ 0 ]; dst[ i ].g = colRGBA[ 1 ]; dst[ i ].b = colRGBA[ 2 ]; dst[ i ].a = colRGBA[ 3 ];
+	}
+
+	l->markDirty( firstVert, vertCount );
+	return true;
+}
+
+
+void OverlayRenderer::showText( const char *text, float x, float y, float size, 
+								float colR, float colG, float colB, Horde3D::MaterialResource *fontMatRes )
+{
+	if ( text == 0x0 || *text == '\0' ) return;
+
+	// Glyphs are written directly into the overlay vertex array
+	uint32 numChars = std::min( ( uint32 ) strlen( text ), MaxNumTextChars );
+	OverlayVert *dst = appendBatch( _overlayBatches, _overlayVerts, MaxNumOverlayVerts, numChars * 4, fontMatRes, 0 );
+	if ( dst == 0x0 ) return;
+
+	buildTextVerts( text, numChars, x, y, size, dst );
+	for ( uint32 i = 0; i < numChars * 4; ++i )
+	{
+		dst[ i ].r = colR; dst[ i ].g = colG; dst[ i ].b = colB; dst[ i ].a = 1.0f;
+	}
+	_overlaysDirty = true;
 }
 
 void OverlayRenderer::beginInfoBox( float x, float y, float width, int numRows, const char *title,
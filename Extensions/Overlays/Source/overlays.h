@@ -16,6 +16,7 @@
 #include "egPipeline.h"
 
 #include <vector>
+#include <algorithm>
 
 namespace Horde3DOverlays {
 
@@ -23,22 +24,41 @@ struct OverlayBatch
 {
 	Horde3D::PMaterialResource		materialRes;
 	uint32							firstVert, vertCount;
-	float							colRGBA[ 4 ];
 	int								flags;
 
 	OverlayBatch() {}
 
-	OverlayBatch( uint32 firstVert, uint32 vertCount, float *col, Horde3D::MaterialResource *materialRes, int flags ) :
+	OverlayBatch( uint32 firstVert, uint32 vertCount, Horde3D::MaterialResource *materialRes, int flags ) :
 		materialRes( materialRes ), firstVert( firstVert ), vertCount( vertCount ), flags( flags )
 	{
-		colRGBA[ 0 ] = col[ 0 ]; colRGBA[ 1 ] = col[ 1 ]; colRGBA[ 2 ] = col[ 2 ]; colRGBA[ 3 ] = col[ 3 ];
 	}
 };
 
 struct OverlayVert
 {
-	float  x, y;  // Position
-	float  u, v;  // Texture coordinates
+	float  x, y;        // Position
+	float  u, v;        // Texture coordinates
+	float  r, g, b, a;  // Color; stored per vertex so that overlays with different colors share a batch
+};
+
+// Retained set of overlays that keeps its vertices in video memory across frames
+struct OverlayLayer
+{
+	std::vector< OverlayBatch >		batches;
+	std::vector< OverlayVert >		verts;
+	uint32							maxVertCount;
+	uint32							geo, vb, ib;
+	uint32							dirtyBegin, dirtyEnd;  // Vertex range that has to be uploaded
+	bool							visible;
+
+	OverlayLayer() : maxVertCount( 0 ), geo( 0 ), vb( 0 ), ib( 0 ), dirtyBegin( 0 ), dirtyEnd( 0 ), visible( true ) {}
+
+	void markDirty( uint32 firstVert, uint32 vertCount )
+	{
+		if( dirtyBegin == dirtyEnd ) { dirtyBegin = firstVert; dirtyEnd = firstVert + vertCount; return; }
+		dirtyBegin = std::min( dirtyBegin, firstVert );
+		dirtyEnd = std::max( dirtyEnd, firstVert + vertCount );
+	}
 };
 
 struct InfoBox
@@ -72,10 +92,23 @@ public:
 	static bool init();
 	static void release();
 
-	static void showOverlays( const float *verts, uint32 vertCount, float *colRGBA,
+	static void showOverlays( const float *verts, uint32 vertCount, const float *colRGBA,
 							  Horde3D::MaterialResource *matRes, int flags );
 	static void clearOverlays();
-	static void drawOverlays( const std::string &shaderContext );
+	static void drawOverlays( int shaderContextID );
+
+	static int createLayer( uint32 maxVertCount );
+	static void destroyLayer( int layer );
+	static void clearLayer( int layer );
+	static void setLayerVisible( int layer, bool visible );
+	static int addLayerOverlays( int layer, const float *verts, uint32 vertCount, const float *colRGBA,
+								 Horde3D::MaterialResource *matRes, int flags );
+	static int addLayerText( int layer, const char *text, uint32 maxChars, float x, float y, float size,
+							 const float *colRGB, Horde3D::MaterialResource *fontMatRes );
+	static bool updateLayerOverlays( int layer, uint32 firstVert, const float *verts, uint32 vertCount );
+	static bool updateLayerText( int layer, uint32 firstVert, uint32 maxChars, const char *text,
+								 float x, float y, float size );
+	static bool setLayerColor( int layer, uint32 firstVert, uint32 vertCount, const float *colRGBA );
 
 	static void showText( const char *text, float x, float y, float size, float colR,
 		float colG, float colB, Horde3D::MaterialResource *fontMatRes );
@@ -87,12 +120,24 @@ public:
 	//	static int getInternalUniformLocation( Horde3D::MaterialResource *mat );
 private:
 
+	static OverlayVert *appendBatch( std::vector< OverlayBatch > &batches, OverlayVert *verts, uint32 maxVertCount,
+									 uint32 vertCount, Horde3D::MaterialResource *matRes, int flags );
+	static uint32 buildTextVerts( const char *text, uint32 maxChars, float x, float y, float size, OverlayVert *verts );
+	static void drawBatches( const std::vector< OverlayBatch > &batches, uint32 baseVert, int shaderContextID,
+							 Horde3D::MaterialResource *&curMatRes, Horde3D::ShaderCombination *&curShader );
+	static OverlayLayer *getLayer( int layer );
+
 //	static std::vector< CachedUniformLocation >	_cachedLocations;
 	static std::vector< OverlayBatch >			_overlayBatches;
 	static OverlayVert							*_overlayVerts;
+	static std::vector< OverlayLayer * >		_layers;
 	static InfoBox								_infoBox;
 	static uint32								_overlayGeo;
 	static uint32								_overlayVB;
+	static uint32								_quadIdxBuf;
+	static uint32								_ringOffset;    // Next free vertex in ring buffer
+	static uint32								_ringBaseVert;  // Location of last uploaded overlays in ring buffer
+	static bool									_overlaysDirty;
 
 	static int									_uni_olayColor;
 	static int									_vlOverlay;
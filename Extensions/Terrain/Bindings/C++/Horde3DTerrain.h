@@ -32,9 +32,17 @@
 	height information, you can simply copy the greyscale image to the red channel of the height
 	map and leave the green channel black.
 
+	Very large terrains can be stored in a tile file that is created with h3dextCreateTerrainTileFile.
+	Such a terrain keeps only a coarse overview of the height data in memory and streams the detailed
+	tiles asynchronously from disk as the camera moves. Until a tile is loaded, the overview is rendered
+	in its place.
+
 	The extension defines the uniform *terBlockParams* and the attribute *terHeight* that can be used
 	in a shader to render the terrain. To see how this is working in detail, have a look at the included
 	sample shader.
+
+	The functions of the extension are not recorded by h3dBeginCapture, so terrains are missing when a
+	capture is replayed.
 */
 
 
@@ -54,7 +62,13 @@ struct H3DEXTTerrain
 		MatResI        - Material resource used for rendering the terrain
 		MeshQualityF   - Constant controlling the overall resolution of the terrain mesh (default: 50.0)
 		SkirtHeightF   - Height of the skirts used to hide cracks (default: 0.1)
-		BlockSizeI     - Size of a terrain block that is drawn in a single render call; must be 2^n+1 (default: 17)
+		BlockSizeI     - Size of a terrain block that is drawn in a single render call; must be 2^n+1 (default: 17);
+		                 defined by the tile file for tiled terrains
+		TileCacheSizeI - Maximum number of tiles that are kept in memory, including tiles being loaded;
+		                 only valid for tiled terrains (default: 64)
+		ResidentTilesI - Number of tiles that are currently in memory or being loaded [read-only]
+		BicubicHeightsI - Flag indicating whether h3dextGetTerrainHeights uses bicubic instead of bilinear
+		                  filtering (default: 0)
 	*/
 	enum List
 	{
@@ -62,7 +76,10 @@ struct H3DEXTTerrain
 		MatResI,
 		MeshQualityF,
 		SkirtHeightF,
-		BlockSizeI
+		BlockSizeI,
+		TileCacheSizeI,
+		ResidentTilesI,
+		BicubicHeightsI
 	};
 };
 
@@ -85,6 +102,83 @@ struct H3DEXTTerrain
 H3D_API H3DNode h3dextAddTerrainNode( H3DNode parent, const char *name, H3DRes heightMapRes, H3DRes materialRes );
 
 
+/* Function: h3dextAddTiledTerrainNode
+		Adds a Terrain node that streams its height data from a tile file to the scene.
+	
+	Details:
+		This function creates a new Terrain node and attaches it to the specified parent node. The height
+		data is read from a tile file created with h3dextCreateTerrainTileFile. Tiles are loaded on a
+		background thread when the camera approaches them and are released again when the tile cache
+		is full and they are no longer needed or closer tiles need their space.
+	
+	Parameters:
+		parent        - handle to parent node to which the new node will be attached
+		name          - name of the node
+		tileFile      - path of the tile file
+		materialRes   - handle to the Material resource used for rendering the terrain
+
+	Returns:
+		 handle to the created node or 0 in case of failure
+*/
+H3D_API H3DNode h3dextAddTiledTerrainNode( H3DNode parent, const char *name, const char *tileFile, H3DRes materialRes );
+
+
+/* Function: h3dextCreateTerrainTileFile
+		Creates a tile file for a tiled Terrain node.
+	
+	Details:
+		This function writes a tile file with tilesPerSide x tilesPerSide tiles. For each tile, the callback
+		is invoked to fill (tileSize + 1) x (tileSize + 1) 16 bit height values in row-major order. The last
+		row and column of a tile must be equal to the first row and column of its neighbours. The file
+		also contains the level of detail information of each tile and an overview of the whole terrain.
+	
+	Parameters:
+		fileName      - path of the file that shall be created
+		tilesPerSide  - number of tiles along each side of the terrain; must be a power of two
+		tileSize      - size of a tile; must be a power of two multiple of blockSize - 1
+		blockSize     - size of a terrain block that is drawn in a single render call; must be 2^n+1
+		fillTile      - callback that provides the height values of a tile
+		userData      - pointer that is passed to the callback
+
+	Returns:
+		 true in case of success, otherwise false
+*/
+H3D_API bool h3dextCreateTerrainTileFile( const char *fileName, int tilesPerSide, int tileSize, int blockSize,
+                                          void (*fillTile)( int tileX, int tileY, unsigned short *heights, void *userData ),
+                                          void *userData );
+
+
+/* Function: h3dextGetTerrainHeights
+		Returns the terrain height and normal at a number of positions.
+	
+	Details:
+		This function samples the height field of a Terrain node at the specified world space x/z positions
+		and returns the world space height and optionally the normal of the terrain surface there. The
+		node transformation is taken into account, but the terrain must not be tilted, i.e. its local y
+		axis must be parallel to the world y axis. Positions outside of the terrain are clamped to its border.
+		The lookups are processed in groups of four, so querying many positions with a single call is much
+		faster than casting a ray for each of them.
+
+		The height field is filtered bilinearly or, if the BicubicHeightsI parameter is set, with a
+		Catmull-Rom spline. The result corresponds to the full resolution height data and not to the
+		rendered mesh, whose level of detail depends on the camera distance: the rendered surface can
+		deviate from the returned height by up to the geometric error tolerated by MeshQualityF at the
+		distance of the camera. For tiled terrains, the resolution of resident tiles is used and the
+		overview elsewhere.
+	
+	Parameters:
+		node        - handle to terrain node that will be accessed
+		xz          - array of count x/z pairs in world space
+		count       - number of positions
+		outHeights  - array of count floats receiving the heights (can be NULL)
+		outNormals  - array of count * 3 floats receiving the normalized normals (can be NULL)
+		
+	Returns:
+		 true in case of success, otherwise false
+*/
+H3D_API bool h3dextGetTerrainHeights( H3DNode node, const float *xz, int count, float *outHeights, float *outNormals );
+
+
 /* Function: h3dextCreateTerrainGeoRes
 		Creates a Geometry resource from a specified Terrain node.
 			
@@ -103,3 +197,57 @@ H3D_API H3DNode h3dextAddTerrainNode( H3DNode parent, const char *name, H3DRes h
 		 handle to the created Geometry resource or 0 in case of failure
 */
 H3D_API H3DRes h3dextCreateTerrainGeoRes( H3DNode node, const char *resName, float meshQuality );
+
+
+/* Function: h3dextCreateTerrainRegionGeoRes
+		Creates a Geometry resource from a part of a specified Terrain node.
+			
+	Details:
+		This function works like h3dextCreateTerrainGeoRes but only exports the terrain blocks that overlap the
+		specified rectangle. The rectangle is given in the local space of the terrain, where the whole terrain
+		covers the range from 0 to 1 on the x and z axes. Blocks crossing the border of the rectangle are
+		exported completely.
+	
+	Parameters:
+		node         - handle to terrain node that will be accessed
+		resName      - name of the Geometry resource that shall be created
+		meshQuality  - constant controlling the overall mesh resolution
+		minU, minV   - lower corner of the rectangle
+		maxU, maxV   - upper corner of the rectangle
+		
+	Returns:
+		 handle to the created Geometry resource or 0 in case of failure
+*/
+H3D_API H3DRes h3dextCreateTerrainRegionGeoRes( H3DNode node, const char *resName, float meshQuality,
+                                                float minU, float minV, float maxU, float maxV );
+
+
+/* Function: h3dextGetTerrainGeometry
+		Writes the triangle mesh of a Terrain node to user provided buffers.
+			
+	Details:
+		This function creates the same vertex and index data as h3dextCreateTerrainGeoRes but writes it to the
+		specified buffers instead of creating a Geometry resource, which is useful for collision meshes.
+		Vertices consist of three floats and are given in the local space of the terrain. Indices describe a
+		triangle list. To determine the required buffer sizes, the function can be called with NULL buffers
+		first. The terrain blocks are generated in parallel and the selected blocks are kept, so that the
+		second call with the same parameters does not need to traverse the terrain again.
+	
+	Parameters:
+		node         - handle to terrain node that will be accessed
+		meshQuality  - constant controlling the overall mesh resolution
+		region       - rectangle minU, minV, maxU, maxV in local space that shall be exported or NULL for
+		               the whole terrain; see h3dextCreateTerrainRegionGeoRes
+		vertices     - buffer receiving the vertex positions (can be NULL)
+		maxVertices  - number of vertices that fit into the vertex buffer
+		indices      - buffer receiving the indices (can be NULL)
+		maxIndices   - number of indices that fit into the index buffer
+		numVertices  - receives the number of vertices of the mesh (can be NULL)
+		numIndices   - receives the number of indices of the mesh (can be NULL)
+		
+	Returns:
+		 true in case of success, false if the parameters are invalid or the buffers are too small
+*/
+H3D_API bool h3dextGetTerrainGeometry( H3DNode node, float meshQuality, const float *region,
+                                       float *vertices, int maxVertices, unsigned int *indices, int maxIndices,
+                                       int *numVertices, int *numIndices );
@@ -103,13 +103,89 @@ H3D_IMPL NodeHandle h3dextAddTerrainNode( NodeHandle parent, const char *name, R
 }
 
 
+H3D_IMPL NodeHandle h3dextAddTiledTerrainNode( NodeHandle parent, const char *name, const char *tileFile,
+                                               ResHandle materialRes )
+{
+	SceneNode *parentNode = Modules::sceneMan().resolveNodeHandle( parent );
+	if( parentNode == 0x0 ) return 0;
+	
+	Resource *matRes =  Modules::resMan().resolveResHandle( materialRes );
+	if( matRes == 0x0 || matRes->getType() != ResourceTypes::Material ) return 0;
+
+	Modules::log().writeInfo( "Adding tiled Terrain node '%s'", safeStr( name ).c_str() );
+
+	TerrainNodeTpl tpl( safeStr( name ), 0x0, (MaterialResource *)matRes );
+	tpl.tileFile = safeStr( tileFile );
+	SceneNode *sn = Modules::sceneMan().findType( SNT_TerrainNode )->factoryFunc( tpl );
+	if( ((TerrainNode *)sn)->getTileCache() == 0x0 )
+	{
+		delete sn;
+		return 0;
+	}
+	return Modules::sceneMan().addNode( sn, *parentNode );
+}
+
+
+H3D_IMPL bool h3dextCreateTerrainTileFile( const char *fileName, int tilesPerSide, int tileSize, int blockSize,
+                                           void (*fillTile)( int, int, unsigned short *, void * ), void *userData )
+{
+	if( fileName == 0x0 || fillTile == 0x0 || tilesPerSide <= 0 || tileSize <= 0 || blockSize <= 0 ) return false;
+
+	return createTerrainTileFile( fileName, tilesPerSide, tileSize, blockSize,
+		[fillTile, userData]( uint32 tileX, uint32 tileY, uint16 *heights )
+		{ fillTile( (int)tileX, (int)tileY, heights, userData ); } );
+}
+
+
+H3D_IMPL bool h3dextGetTerrainHeights( NodeHandle node, const float *xz, int count, float *outHeights,
+                                       float *outNormals )
+{
+	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
+	if( sn == 0x0 || sn->getType() != SNT_TerrainNode || xz == 0x0 || count < 0 ) return false;
+
+	((TerrainNode *)sn)->getHeights( xz, (uint32)count, outHeights, outNormals );
+	return true;
+}
+
+
+static const float fullTerrainRegion[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
 H3D_IMPL ResHandle h3dextCreateTerrainGeoRes( NodeHandle node, const char *name, float meshQuality )
 {
 	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
 	if( sn != 0x0 && sn->getType() == SNT_TerrainNode )
-		return ((TerrainNode *)sn)->createGeometryResource( safeStr( name ), 1.0f / meshQuality );
+		return ((TerrainNode *)sn)->createGeometryResource( safeStr( name ), 1.0f / meshQuality, fullTerrainRegion );
 	else
 		return 0;
 }
 
+
+H3D_IMPL ResHandle h3dextCreateTerrainRegionGeoRes( NodeHandle node, const char *name, float meshQuality,
+                                                    float minU, float minV, float maxU, float maxV )
+{
+	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
+	if( sn == 0x0 || sn->getType() != SNT_TerrainNode || minU >= maxU || minV >= maxV ) return 0;
+
+	float region[4] = { minU, minV, maxU, maxV };
+	return ((TerrainNode *)sn)->createGeometryResource( safeStr( name ), 1.0f / meshQuality, region );
+}
+
+
+H3D_IMPL bool h3dextGetTerrainGeometry( NodeHandle node, float meshQuality, const float *region,
+                                        float *vertices, int maxVertices, unsigned int *indices, int maxIndices,
+                                        int *numVertices, int *numIndices )
+{
+	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
+	if( sn == 0x0 || sn->getType() != SNT_TerrainNode || maxVertices < 0 || maxIndices < 0 ) return false;
+	if( region != 0x0 && (region[0] >= region[2] || region[1] >= region[3]) ) return false;
+
+	uint32 vertCount = 0, indexCount = 0;
+	bool result = ((TerrainNode *)sn)->createGeometry( 1.0f / meshQuality, region != 0x0 ? region : fullTerrainRegion,
+		vertices, (uint32)maxVertices, indices, (uint32)maxIndices, vertCount, indexCount );
+	if( numVertices != 0x0 ) *numVertices = (int)vertCount;
+	if( numIndices != 0x0 ) *numIndices = (int)indexCount;
+
+	return result;
+}
+
 }  // namespace
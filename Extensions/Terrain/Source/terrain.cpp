@@ -16,6 +16,8 @@
 #include "egRenderer.h"
 #include "egMaterial.h"
 #include "egCamera.h"
+#include "utSIMD.h"
+#include "egJobs.h"
 
 #include "utDebug.h"
 
@@ -91,15 +93,24 @@ uint32 TerrainNode::vlTerrain;
 ShaderCombination TerrainNode::debugViewShader;
 int TerrainNode::uni_terBlockParams = -1;
 
+// Tiles are requested when their detail is about to be needed, so that they are resident in time
+static const float TilePrefetchFactor = 0.5f;
+
 
 TerrainNode::TerrainNode( const TerrainNodeTpl &terrainTpl ) :
 	SceneNode( terrainTpl ), _materialRes( terrainTpl.matRes ), _blockSize( terrainTpl.blockSize ),
 	_skirtHeight( terrainTpl.skirtHeight ), _lodThreshold( 1.0f / terrainTpl.meshQuality ),
 	_hmapSize( 0 ), _heightData( 0x0 ), _maxLevel( 0 ), _heightArray( 0x0 ), _vertexBuffer( 0 ),
-	_indexBuffer( 0 ), _geometry( 0 )
+	_indexBuffer( 0 ), _geometry( 0 ), _tileCache( 0x0 ), _tileUpdateFrame( 0 ),
+	_bicubicHeights( false ), _geoBlocksValid( false )
 {
 	_renderable = true;
-	if( terrainTpl.hmapRes != 0x0 ) updateHeightData( *terrainTpl.hmapRes );
+	if( !terrainTpl.tileFile.empty() && !openTileFile( terrainTpl.tileFile, terrainTpl.tileCacheSize ) )
+	{
+		Modules::log().writeError( "Terrain node '%s': could not open tile file '%s'",
+			terrainTpl.name.c_str(), terrainTpl.tileFile.c_str() );
+	}
+	if( _tileCache == 0x0 && terrainTpl.hmapRes != 0x0 ) updateHeightData( *terrainTpl.hmapRes );
 	
 	// Ensure correct block size
 	if( _hmapSize % (_blockSize - 1) != 0 )
@@ -116,6 +127,7 @@ TerrainNode::TerrainNode( const TerrainNodeTpl &terrainTpl ) :
 
 TerrainNode::~TerrainNode()
 {
+	delete _tileCache;
 	delete[] _heightData;
 	delete[] _heightArray;
 }
@@ -156,6 +168,16 @@ SceneNodeTpl *TerrainNode::parsingFunc( map< string, string > &attribs )
 	{
 		terrainTpl->blockSize = atoi( itr->second.c_str() );
 	}
+	itr = attribs.find( "tileFile" );
+	if ( itr != attribs.end() )
+	{
+		terrainTpl->tileFile = itr->second;
+	}
+	itr = attribs.find( "tileCacheSize" );
+	if ( itr != attribs.end() )
+	{
+		terrainTpl->tileCacheSize = atoi( itr->second.c_str() );
+	}
 
 	return terrainTpl;
 }
@@ -176,8 +198,9 @@ void TerrainNode::onPostUpdate()
 }
 
 
-void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV, float maxU, float maxV,
-                                    int level, float scale, const Vec3f &localCamPos, const Frustum *frust1,
+void TerrainNode::drawTerrainBlock( TerrainNode *terrain, const TerrainBlockSource &src,
+                                    float minU, float minV, float maxU, float maxV,
+                                    uint32 level, float scale, const Vec3f &localCamPos, const Frustum *frust1,
                                     const Frustum *frust2, int terBlockParamsUni )
 {
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
@@ -186,13 +209,15 @@ void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV
 	const float halfV = (minV + maxV) / 2.0f;
 
 	uint32 offset = 0;
-	for( int i = 0; i < level; ++i ) offset += (1 << i) * (1 << i);
+	for( uint32 i = 0; i < level; ++i ) offset += (1 << i) * (1 << i);
 	
 	const uint32 blockIndex = offset + ftoi_t( minV * (1 << level) ) * (1 << level) + ftoi_t( minU * (1 << level) );
-	BlockInfo &block = terrain->_blockTree[blockIndex];
+	const BlockInfo &block = src.blockTree[blockIndex];
 
-	// Create AABB for block
-	Vec3f bBMin( minU, block.minHeight - terrain->_skirtHeight, minV), bBMax( maxU, block.maxHeight, maxV );
+	// Create AABB for block in terrain space
+	const float terMinU = src.originU + minU * src.extent, terMaxU = src.originU + maxU * src.extent;
+	const float terMinV = src.originV + minV * src.extent, terMaxV = src.originV + maxV * src.extent;
+	Vec3f bBMin( terMinU, block.minHeight - terrain->_skirtHeight, terMinV), bBMax( terMaxU, block.maxHeight, terMaxV );
 	
 	// Frustum culling
 	BoundingBox bb;
@@ -205,12 +230,26 @@ void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV
 	float dist = maxf( nearestDistToAABB( localCamPos, bBMin, bBMax ), 0.00001f );	
 	float p = block.geoError / dist;
 
-	if( p < terrain->_lodThreshold || level == terrain->_maxLevel )
+	if( p >= terrain->_lodThreshold && level == src.maxLevel && src.tileCache != 0x0 )
+	{
+		// Continue with the finer data of the tile covered by this block if it is resident
+		const TerrainTile *tile = src.tileCache->getTile( ftoi_t( minU * (1 << level) ), ftoi_t( minV * (1 << level) ) );
+		if( tile != 0x0 )
+		{
+			TerrainBlockSource tileSrc = { &tile->heights[0], &tile->blockTree[0], src.tileCache->getTileSize(),
+			                               src.tileCache->getTileMaxLevel(), terMinU, terMinV, terMaxU - terMinU, 0x0 };
+			drawTerrainBlock( terrain, tileSrc, 0.0f, 0.0f, 1.0f, 1.0f, 0, 1.0f, localCamPos,
+			                  frust1, frust2, terBlockParamsUni );
+			return;
+		}
+	}
+
+	if( p < terrain->_lodThreshold || level == src.maxLevel )
 	{
 		// Render terrain block
 		if( terBlockParamsUni >= 0 )
 		{
-			float values[4] = { minU, minV, scale, scale };
+			float values[4] = { terMinU, terMinV, scale * src.extent, scale * src.extent };
 			rdi->setShaderConst( terBlockParamsUni, CONST_FLOAT4, values );  // Bias and scale
 		}
 	
@@ -228,11 +267,11 @@ void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV
 				if( u == 0 ) s = 0.0f; else if( u == size - 1 ) s = 1.0f;	// Skirt
 				
 				float *vertHeight = &terrain->_heightArray[v * size + u];
-				const float newU = (s * scale + minU) * (terrain->_hmapSize) + 0.5f;
-				const float newV = (t * scale + minV) * (terrain->_hmapSize) + 0.5f;
-				uint32 index = ftoi_t( newV ) * (terrain->_hmapSize + 1) + ftoi_t( newU );
+				const float newU = (s * scale + minU) * src.size + 0.5f;
+				const float newV = (t * scale + minV) * src.size + 0.5f;
+				uint32 index = ftoi_t( newV ) * (src.size + 1) + ftoi_t( newU );
 				
-				*vertHeight = terrain->_heightData[index] / 65535.0f;
+				*vertHeight = src.heights[index] / 65535.0f;
 				
 				// Create skirt
 				if( v == 0 || v == size - 1 || u == 0 || u == size - 1 )
@@ -265,12 +304,12 @@ void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV
 		};
 		
 		// Sort blocks by distance from camera
-		if( localCamPos.x > halfU )
+		if( localCamPos.x > src.originU + halfU * src.extent )
 		{
 			std::swap( blocks[0], blocks[1] );
 			std::swap( blocks[2], blocks[3] );
 		}
-		if( localCamPos.z > halfV )
+		if( localCamPos.z > src.originV + halfV * src.extent )
 		{
 			std::swap( blocks[0], blocks[2] );
 			std::swap( blocks[1], blocks[3] );
@@ -278,14 +317,14 @@ void TerrainNode::drawTerrainBlock( TerrainNode *terrain, float minU, float minV
 
 		for( uint32 i = 0; i < 4; ++i )
 		{
-			drawTerrainBlock( terrain, blocks[i].x, blocks[i].y, blocks[i].z, blocks[i].w,
+			drawTerrainBlock( terrain, src, blocks[i].x, blocks[i].y, blocks[i].z, blocks[i].w,
 			                  level + 1, scale, localCamPos, frust1, frust2, terBlockParamsUni );
 		}
 	}
 }
 
 
-void TerrainNode::renderFunc( uint32 firstItem, uint32 lastItem, const string &shaderContext, int theClass,
+void TerrainNode::renderFunc( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
                               bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                               int occSet )
 {
@@ -305,7 +344,7 @@ void TerrainNode::renderFunc( uint32 firstItem, uint32 lastItem, const string &s
 		if( !debugView )
 		{
 			if( !terrain->_materialRes->isOfClass( theClass ) ) continue;
-			if( !Modules::renderer().setMaterial( terrain->_materialRes, shaderContext ) ) continue;
+			if( !Modules::renderer().setMaterial( terrain->_materialRes, shaderContextID ) ) continue;
 		}
 		else
 		{
@@ -321,6 +360,13 @@ void TerrainNode::renderFunc( uint32 firstItem, uint32 lastItem, const string &s
 		Matrix4f &camTransformation = curCam->getAbsTrans();
 		Vec3f localCamPos( camTransformation.x[12], camTransformation.x[13], camTransformation.x[14] );
 		localCamPos = terrain->_absTrans.inverted() * localCamPos;
+
+		// Stream tiles around the camera once per frame, before the first pass draws the terrain
+		if( terrain->_tileCache != 0x0 && terrain->_tileUpdateFrame != Modules::renderer().getFrameID() )
+		{
+			terrain->_tileUpdateFrame = Modules::renderer().getFrameID();
+			terrain->requestTiles( localCamPos );
+		}
 		
 		// Bind geometry and apply vertex layout
 // 		rdi->setIndexBuffer( terrain->_indexBuffer, IDXFMT_16 );
@@ -351,7 +397,9 @@ void TerrainNode::renderFunc( uint32 firstItem, uint32 lastItem, const string &s
 			rdi->setShaderConst( curShader->uniLocs[ uni.nodeId ], CONST_FLOAT, &id );
 		}
 
-		drawTerrainBlock( terrain, 0.0f, 0.0f, 1.0f, 1.0f, 0, 1.0f, localCamPos, frust1, frust2, terBlockUni );
+		TerrainBlockSource src = { terrain->_heightData, &terrain->_blockTree[0], terrain->_hmapSize,
+		                           terrain->_maxLevel, 0.0f, 0.0f, 1.0f, terrain->_tileCache };
+		drawTerrainBlock( terrain, src, 0.0f, 0.0f, 1.0f, 1.0f, 0, 1.0f, localCamPos, frust1, frust2, terBlockUni );
 
 // 		rdi->setVertexLayout( 0 );
 	}
@@ -451,6 +499,56 @@ bool TerrainNode::updateHeightData( TextureResource &hmap )
 }
 
 
+bool TerrainNode::openTileFile( const string &fileName, uint32 cacheSize )
+{
+	TerrainTileCache *tileCache = new TerrainTileCache();
+	if( !tileCache->open( fileName ) )
+	{
+		delete tileCache;
+		return false;
+	}
+	tileCache->setMaxResidentTiles( cacheSize );
+
+	delete _tileCache; _tileCache = tileCache;
+
+	// The overview is used as regular height map whose finest blocks map to the tiles
+	const vector< uint16 > &overview = tileCache->getOverview();
+	delete[] _heightData;
+	_heightData = new uint16[overview.size()];
+	memcpy( _heightData, &overview[0], overview.size() * sizeof( uint16 ) );
+	_hmapSize = tileCache->getOverviewSize();
+	_blockSize = tileCache->getBlockSize();
+
+	return true;
+}
+
+
+void TerrainNode::requestTiles( const Vec3f &localCamPos )
+{
+	const uint32 tilesPerSide = _tileCache->getTilesPerSide();
+
+	// Blocks of the finest overview level have the same size as the tiles
+	uint32 offset = 0;
+	for( uint32 i = 0; i < _maxLevel; ++i ) offset += (1 << i) * (1 << i);
+
+	for( uint32 y = 0; y < tilesPerSide; ++y )
+	{
+		for( uint32 x = 0; x < tilesPerSide; ++x )
+		{
+			const BlockInfo &block = _blockTree[offset + y * tilesPerSide + x];
+			Vec3f bBMin( (float)x / tilesPerSide, block.minHeight - _skirtHeight, (float)y / tilesPerSide );
+			Vec3f bBMax( (float)(x + 1) / tilesPerSide, block.maxHeight, (float)(y + 1) / tilesPerSide );
+
+			float dist = maxf( nearestDistToAABB( localCamPos, bBMin, bBMax ), 0.00001f );
+			if( block.geoError / dist >= _lodThreshold * TilePrefetchFactor )
+				_tileCache->requestTile( x, y, dist );
+		}
+	}
+
+	_tileCache->update();
+}
+
+
 void TerrainNode::calcMaxLevel()
 {
 	const uint32 pow2 = _hmapSize / (_blockSize - 1);
@@ -561,73 +659,42 @@ void TerrainNode::recreateVertexBuffer()
 }
 
 
-void TerrainNode::buildBlockInfo( BlockInfo &block, float minU, float minV, float maxU, float maxV )
+void TerrainNode::createBlockTree()
 {
-	const float pixelStep = 1.0f / _hmapSize;
-	const float stepU = (maxU - minU) / (_blockSize - 1);
-	const float stepV = (maxV - minV) / (_blockSize - 1);
-	
-	for( uint32 v = 0; v < _blockSize - 1; ++v )
+	_geoBlocksValid = false;
+	buildBlockTree( _blockTree, _heightData, _hmapSize, _blockSize, _maxLevel, 1.0f );
+	if( _tileCache == 0x0 ) return;
+
+	// The overview misses details of the tiles, so the finest level takes over the tile root blocks
+	// and the coarser levels are enlarged to include their children
+	const vector< BlockInfo > &roots = _tileCache->getTileRootBlocks();
+	uint32 offset = (uint32)_blockTree.size() - (uint32)roots.size();
+	for( uint32 i = 0; i < roots.size(); ++i )
 	{
-		for( uint32 u = 0; u < _blockSize - 1; ++u )
-		{
-			Vec3f corner0( minU + u * stepU, 0, minV + v * stepV);
-			Vec3f corner1( minU + u * stepU, 0, minV + (v + 1) * stepV);
-			Vec3f corner2( minU + (u + 1) * stepU, 0, minV + v * stepV);
-			Vec3f corner3( minU + (u + 1) * stepU, 0, minV + (v + 1) * stepV);
-
-			corner0.y = getHeight( corner0.x, corner0.z );
-			corner1.y = getHeight( corner1.x, corner1.z );
-			corner2.y = getHeight( corner2.x, corner2.z );
-			corner3.y = getHeight( corner3.x, corner3.z );
-			
-			Plane tri0( corner0, corner1, corner2 );
-			Plane tri1( corner1, corner2, corner3 );
-
-			float vv = 0;
-			float uu = 0;
-			while ( vv <= stepV )
-			{
-				while ( uu <= stepU )
-				{
-					Plane &curTri = uu <= vv ? tri0 : tri1;
-
-					Vec3f point( minU + u * stepU + uu, 0, minV + v * stepV + vv );
-					point.y = getHeight( point.x, point.z );
-
-					block.minHeight = minf( point.y, block.minHeight );
-					block.maxHeight = maxf( point.y, block.maxHeight );
-					block.geoError = maxf( block.geoError, fabsf( curTri.distToPoint( point ) ) );
-
-					uu += pixelStep;
-				}
-
-				vv += pixelStep;
-			}
-		}
+		BlockInfo &block = _blockTree[offset + i];
+		block.minHeight = minf( block.minHeight, roots[i].minHeight );
+		block.maxHeight = maxf( block.maxHeight, roots[i].maxHeight );
+		block.geoError = maxf( block.geoError, roots[i].geoError );
 	}
-}
-
-
-void TerrainNode::createBlockTree()
-{
-	// The block tree contains the renderable blocks for each quad tree level, starting at the
-	// lowest resolution level 0 (just one block for the complete terrain)
-
-	uint32 size = 0, index = 0;
-	for( uint32 i = 0; i <= _maxLevel; ++i ) size += (1 << i) * (1 << i);
-	_blockTree.resize( size );
 
-	for( uint32 i = 0; i <= _maxLevel; ++i )
+	for( int level = (int)_maxLevel - 1; level >= 0; --level )
 	{
-		uint32 numBlocks = 1 << i;
+		uint32 numBlocks = 1 << level;
+		uint32 childOffset = offset;
+		offset -= numBlocks * numBlocks;
 
 		for( uint32 y = 0; y < numBlocks; ++y )
 		{
 			for( uint32 x = 0; x < numBlocks; ++x )
 			{
-				buildBlockInfo( _blockTree[index++], (float)x / numBlocks, (float)y / numBlocks,
-				                (float)(x + 1) / numBlocks, (float)(y + 1) / numBlocks );
+				BlockInfo &block = _blockTree[offset + y * numBlocks + x];
+				for( uint32 i = 0; i < 4; ++i )
+				{
+					const BlockInfo &child = _blockTree[childOffset + (y * 2 + i / 2) * numBlocks * 2 + x * 2 + i % 2];
+					block.minHeight = minf( block.minHeight, child.minHeight );
+					block.maxHeight = maxf( block.maxHeight, child.maxHeight );
+					block.geoError = maxf( block.geoError, child.geoError );
+				}
 			}
 		}
 	}
@@ -642,6 +709,12 @@ int TerrainNode::getParamI( int param ) const
 		return _materialRes != 0x0 ? _materialRes->getHandle() : 0;
 	case TerrainNodeParams::BlockSizeI:
 		return _blockSize;
+	case TerrainNodeParams::TileCacheSizeI:
+		return _tileCache != 0x0 ? _tileCache->getMaxResidentTiles() : 0;
+	case TerrainNodeParams::ResidentTilesI:
+		return _tileCache != 0x0 ? _tileCache->getResidentTileCount() : 0;
+	case TerrainNodeParams::BicubicHeightsI:
+		return _bicubicHeights ? 1 : 0;
 	}
 
 	return SceneNode::getParamI( param );
@@ -658,6 +731,8 @@ void TerrainNode::setParamI( int param, int value )
 		if( res != 0x0 && res->getType() == ResourceTypes::Texture &&
 		    ((TextureResource *)res)->getTexType() != TextureTypes::Tex2D )
 		{
+			// Leaves tiled mode
+			delete _tileCache; _tileCache = 0x0;
 			bool result = updateHeightData( *((TextureResource *)res) );
 			recreateVertexBuffer();
 			calcMaxLevel();
@@ -674,7 +749,9 @@ void TerrainNode::setParamI( int param, int value )
 			Modules::setError( "Invalid handle in h3dSetNodeParamI for H3DEXTTerrain::MatResI" );
 		return;
 	case TerrainNodeParams::BlockSizeI:
-		if( _hmapSize % (value - 1) == 0 && (unsigned)value <= _hmapSize )
+		if( _tileCache != 0x0 )
+			Modules::setError( "Block size is defined by the tile file in h3dSetNodeParamI for H3DEXTTerrain::BlockSizeI" );
+		else if( _hmapSize % (value - 1) == 0 && (unsigned)value <= _hmapSize )
 		{
 			if( _blockSize == value ) return;
 
@@ -686,6 +763,15 @@ void TerrainNode::setParamI( int param, int value )
 		else
 			Modules::setError( "Invalid value in h3dSetNodeParamI for H3DEXTTerrain::BlockSizeI (must be 2^x + 1)" );	
 		return;
+	case TerrainNodeParams::TileCacheSizeI:
+		if( _tileCache != 0x0 && value > 0 )
+			_tileCache->setMaxResidentTiles( value );
+		else
+			Modules::setError( "Invalid value in h3dSetNodeParamI for H3DEXTTerrain::TileCacheSizeI" );
+		return;
+	case TerrainNodeParams::BicubicHeightsI:
+		_bicubicHeights = value != 0;
+		return;
 	}
 
 	SceneNode::setParamI( param, value );
@@ -862,129 +948,272 @@ bool TerrainNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir,
 }
 
 
-uint32 TerrainNode::calculateGeometryBlockCount( float lodThreshold, float minU, float minV,
-                                                 float maxU, float maxV, int level, float scale)
+void TerrainNode::getHeights( const float *xz, uint32 count, float *outHeights, float *outNormals ) const
 {
-	int blockCount = 0;
-	const float halfU = (minU + maxU) / 2.0f;
-	const float halfV = (minV + maxV) / 2.0f;
+	if( _heightData == 0x0 ) return;
 
-	uint32 offset = 0;
-	for( int i = 0; i < level; ++i ) offset += (1 << i) * (1 << i);
+	// The terrain is assumed to be upright, i.e. its local y axis is parallel to the world y axis
+	Matrix4f invTrans = _absTrans.inverted();
+	const float *m = invTrans.x, *t = _absTrans.x;
+	Matrix4f normalMat = invTrans.transposed();
+	const float *n = normalMat.x;
 
-	const uint32 blockIndex = offset + ftoi_t( minV * (1 << level) ) * (1 << level) + ftoi_t( minU * (1 << level) );
-	BlockInfo &block = _blockTree[blockIndex];
-	
-	const float p = block.geoError;
+	const int taps = _bicubicHeights ? 4 : 2;
+	const int firstTap = _bicubicHeights ? -1 : 0;
 
-	if( p < lodThreshold || level == _maxLevel )
-	{
-		return 1;
-	}
-	else
+	float laneU[4], laneV[4], fracU[4], fracV[4], gradScale[4], samples[16 * 4];
+	for( uint32 i = 0; i < count; i += 4 )
 	{
-		scale /= 2;
+		const uint32 lanes = std::min( count - i, 4u );
 
-		Vec4f blocks[] =
+		// Transform to local space
+		float x[4], z[4];
+		for( uint32 l = 0; l < 4; ++l )
 		{
-			Vec4f( minU, minV, halfU, halfV ),
-			Vec4f( halfU, minV, maxU, halfV ),
-			Vec4f( minU, halfV, halfU, maxV ),
-			Vec4f( halfU, halfV, maxU, maxV )
-		};
+			uint32 src = i + std::min( l, lanes - 1 );
+			x[l] = xz[src * 2];
+			z[l] = xz[src * 2 + 1];
+		}
+		Float4 u = add4( add4( mul4( splat4( m[0] ), load4( x ) ), mul4( splat4( m[8] ), load4( z ) ) ), splat4( m[12] ) );
+		Float4 v = add4( add4( mul4( splat4( m[2] ), load4( x ) ), mul4( splat4( m[10] ), load4( z ) ) ), splat4( m[14] ) );
+		u = min4( max4( u, splat4( 0 ) ), splat4( 1 ) );
+		v = min4( max4( v, splat4( 0 ) ), splat4( 1 ) );
+		store4( laneU, u );
+		store4( laneV, v );
+
+		// Gather samples from the resident tiles or the height map
+		for( uint32 l = 0; l < 4; ++l )
+		{
+			const uint16 *heights = _heightData;
+			uint32 size = _hmapSize;
+			float su = laneU[l], sv = laneV[l], extent = 1.0f;
 
-		for( uint32 i = 0; i < 4; ++i )
+			if( _tileCache != 0x0 )
+			{
+				const uint32 tilesPerSide = _tileCache->getTilesPerSide();
+				uint32 tileX = std::min( (uint32)ftoi_t( su * tilesPerSide ), tilesPerSide - 1 );
+				uint32 tileY = std::min( (uint32)ftoi_t( sv * tilesPerSide ), tilesPerSide - 1 );
+				const TerrainTile *tile = _tileCache->getTile( tileX, tileY );
+				if( tile != 0x0 )
+				{
+					heights = &tile->heights[0];
+					size = _tileCache->getTileSize();
+					extent = 1.0f / tilesPerSide;
+					su = su * tilesPerSide - tileX;
+					sv = sv * tilesPerSide - tileY;
+				}
+			}
+
+			int iu = std::min( ftoi_t( su * size ), (int)size - 1 );
+			int iv = std::min( ftoi_t( sv * size ), (int)size - 1 );
+			fracU[l] = su * size - iu;
+			fracV[l] = sv * size - iv;
+			gradScale[l] = size / extent;
+
+			for( int ty = 0; ty < taps; ++ty )
+			{
+				int sy = std::min( std::max( iv + firstTap + ty, 0 ), (int)size );
+				for( int tx = 0; tx < taps; ++tx )
+				{
+					int sx = std::min( std::max( iu + firstTap + tx, 0 ), (int)size );
+					samples[(ty * taps + tx) * 4 + l] = heights[sy * (size + 1) + sx] / 65535.0f;
+				}
+			}
+		}
+
+		// Filter weights and their derivatives
+		Float4 wu[4], wv[4], dwu[4], dwv[4];
+		Float4 fu = load4( fracU ), fv = load4( fracV );
+		if( _bicubicHeights )
+		{
+			// Catmull-Rom spline
+			Float4 *w[2] = { wu, wv }, *dw[2] = { dwu, dwv };
+			Float4 f[2] = { fu, fv };
+			for( int k = 0; k < 2; ++k )
+			{
+				Float4 f1 = f[k], f2 = mul4( f1, f1 ), f3 = mul4( f2, f1 ), half = splat4( 0.5f );
+				w[k][0] = mul4( half, sub4( sub4( mul4( splat4( 2 ), f2 ), f3 ), f1 ) );
+				w[k][1] = mul4( half, add4( sub4( mul4( splat4( 3 ), f3 ), mul4( splat4( 5 ), f2 ) ), splat4( 2 ) ) );
+				w[k][2] = mul4( half, add4( sub4( mul4( splat4( 4 ), f2 ), mul4( splat4( 3 ), f3 ) ), f1 ) );
+				w[k][3] = mul4( half, sub4( f3, f2 ) );
+				dw[k][0] = mul4( half, sub4( sub4( mul4( splat4( 4 ), f1 ), mul4( splat4( 3 ), f2 ) ), splat4( 1 ) ) );
+				dw[k][1] = mul4( half, sub4( mul4( splat4( 9 ), f2 ), mul4( splat4( 10 ), f1 ) ) );
+				dw[k][2] = mul4( half, add4( sub4( mul4( splat4( 8 ), f1 ), mul4( splat4( 9 ), f2 ) ), splat4( 1 ) ) );
+				dw[k][3] = mul4( half, sub4( mul4( splat4( 3 ), f2 ), mul4( splat4( 2 ), f1 ) ) );
+			}
+		}
+		else
+		{
+			wu[0] = sub4( splat4( 1 ), fu ); wu[1] = fu;
+			wv[0] = sub4( splat4( 1 ), fv ); wv[1] = fv;
+			dwu[0] = dwv[0] = splat4( -1 ); dwu[1] = dwv[1] = splat4( 1 );
+		}
+
+		Float4 h = splat4( 0 ), dhdu = splat4( 0 ), dhdv = splat4( 0 );
+		for( int ty = 0; ty < taps; ++ty )
+		{
+			Float4 row = splat4( 0 ), rowDeriv = splat4( 0 );
+			for( int tx = 0; tx < taps; ++tx )
+			{
+				Float4 sample = load4( &samples[(ty * taps + tx) * 4] );
+				row = add4( row, mul4( wu[tx], sample ) );
+				rowDeriv = add4( rowDeriv, mul4( dwu[tx], sample ) );
+			}
+			h = add4( h, mul4( wv[ty], row ) );
+			dhdu = add4( dhdu, mul4( wv[ty], rowDeriv ) );
+			dhdv = add4( dhdv, mul4( dwv[ty], row ) );
+		}
+
+		float result[4];
+		if( outHeights != 0x0 )
 		{
-			blockCount += calculateGeometryBlockCount( lodThreshold, blocks[i].x, blocks[i].y,
-			                                           blocks[i].z, blocks[i].w, level + 1, scale );
+			Float4 y = add4( add4( add4( mul4( splat4( t[1] ), u ), mul4( splat4( t[5] ), h ) ),
+			                       mul4( splat4( t[9] ), v ) ), splat4( t[13] ) );
+			store4( result, y );
+			for( uint32 l = 0; l < lanes; ++l ) outHeights[i + l] = result[l];
+		}
+
+		if( outNormals != 0x0 )
+		{
+			// Local normal is ( -dh/du, 1, -dh/dv ) with the derivatives in local units
+			Float4 scale = load4( gradScale );
+			Float4 nx = sub4( splat4( 0 ), mul4( dhdu, scale ) ), nz = sub4( splat4( 0 ), mul4( dhdv, scale ) );
+			Float4 wx = add4( add4( mul4( splat4( n[0] ), nx ), splat4( n[4] ) ), mul4( splat4( n[8] ), nz ) );
+			Float4 wy = add4( add4( mul4( splat4( n[1] ), nx ), splat4( n[5] ) ), mul4( splat4( n[9] ), nz ) );
+			Float4 wz = add4( add4( mul4( splat4( n[2] ), nx ), splat4( n[6] ) ), mul4( splat4( n[10] ), nz ) );
+
+			float resX[4], resY[4], resZ[4];
+			store4( resX, wx ); store4( resY, wy ); store4( resZ, wz );
+			for( uint32 l = 0; l < lanes; ++l )
+			{
+				float invLen = 1.0f / sqrtf( resX[l] * resX[l] + resY[l] * resY[l] + resZ[l] * resZ[l] );
+				outNormals[(i + l) * 3 + 0] = resX[l] * invLen;
+				outNormals[(i + l) * 3 + 1] = resY[l] * invLen;
+				outNormals[(i + l) * 3 + 2] = resZ[l] * invLen;
+			}
 		}
 	}
-	return blockCount;
 }
 
 
-void TerrainNode::createGeometryVertices( float lodThreshold, float minU, float minV, float maxU,
-	float maxV, int level, float scale, float *&vertData, uint32 *&indexData, uint32 &indexOffset )
+void TerrainNode::collectGeometryBlocks( float lodThreshold, const float *region, float minU, float minV,
+                                         float maxU, float maxV, uint32 level, vector< Vec3f > &blocks ) const
 {
+	if( maxU <= region[0] || minU >= region[2] || maxV <= region[1] || minV >= region[3] ) return;
+
 	const float halfU = (minU + maxU) / 2.0f;
 	const float halfV = (minV + maxV) / 2.0f;
 
 	uint32 offset = 0;
-	for( int i = 0; i < level; ++i ) offset += (1 << i) * (1 << i);
+	for( uint32 i = 0; i < level; ++i ) offset += (1 << i) * (1 << i);
 
-	const uint32 blockIndex =  offset + ftoi_t( minV * (1 << level) ) * (1 << level) + ftoi_t( minU * (1 << level) );
-	BlockInfo &block = _blockTree[blockIndex];
+	const uint32 blockIndex = offset + ftoi_t( minV * (1 << level) ) * (1 << level) + ftoi_t( minU * (1 << level) );
+	const BlockInfo &block = _blockTree[blockIndex];
+
+	if( block.geoError < lodThreshold || level == _maxLevel )
+	{
+		blocks.push_back( Vec3f( minU, minV, maxU - minU ) );
+	}
+	else
+	{
+		collectGeometryBlocks( lodThreshold, region, minU, minV, halfU, halfV, level + 1, blocks );
+		collectGeometryBlocks( lodThreshold, region, halfU, minV, maxU, halfV, level + 1, blocks );
+		collectGeometryBlocks( lodThreshold, region, minU, halfV, halfU, maxV, level + 1, blocks );
+		collectGeometryBlocks( lodThreshold, region, halfU, halfV, maxU, maxV, level + 1, blocks );
+	}
+}
 
-	// Determine level of detail
-	const float p = block.geoError;
 
-	if( p < lodThreshold || level == _maxLevel )
+const vector< Vec3f > &TerrainNode::getGeometryBlocks( float lodThreshold, const float *region )
+{
+	// Exporting the same terrain repeatedly, e.g. to query the size first, reuses the block list
+	float key[5] = { lodThreshold, region[0], region[1], region[2], region[3] };
+	if( !_geoBlocksValid || memcmp( key, _geoBlocksKey, sizeof( key ) ) != 0 )
 	{
-		const uint32 size = _blockSize + 2;
-		const float invScale = 1.0f / (_blockSize - 1);
+		_geoBlocks.resize( 0 );
+		collectGeometryBlocks( lodThreshold, region, 0.0f, 0.0f, 1.0f, 1.0f, 0, _geoBlocks );
+		memcpy( _geoBlocksKey, key, sizeof( key ) );
+		_geoBlocksValid = true;
+	}
 
-		for( uint32 v = 0; v < size; ++v )
-		{	
-			float t = (v - 1) * invScale;
-			if( v == 0 ) t = 0.0f; else if( v == size - 1 ) t = 1.0f;	// Skirt
+	return _geoBlocks;
+}
 
-			for( uint32 u = 0; u < size; ++u )
-			{
-				float s = (u - 1) * invScale;
-				if( u == 0 ) s = 0.0f; else if( u == size - 1 ) s = 1.0f;	// Skirt
 
-				const float newU = (s * scale + minU) * _hmapSize + 0.5f;
-				const float newV = (t * scale + minV) * _hmapSize + 0.5f;
-				uint32 index = ftoi_t( newV ) * (_hmapSize + 1) + ftoi_t( newU );
+void TerrainNode::writeGeometryBlocks( const vector< Vec3f > &blocks, float *vertices, uint32 *indices ) const
+{
+	const uint32 size = _blockSize + 2;
+	const float invScale = 1.0f / (_blockSize - 1);
+	const uint32 blockVerts = size * size;
+	const uint32 blockIndices = (size - 1) * (size - 1) * 6;
 
-				vertData = (float*) elemset_le(vertData, (s * scale + minU));
+	// All blocks have the same number of vertices and indices, so each one can be written independently
+	Modules::jobMan().parallelFor( (int)blocks.size(), 16, [&]( int begin, int end )
+	{
+		for( int b = begin; b < end; ++b )
+		{
+			const float minU = blocks[b].x, minV = blocks[b].y, scale = blocks[b].z;
+			const uint32 firstVert = (uint32)b * blockVerts;
+			float *vertData = vertices + (size_t)firstVert * 3;
+			uint32 *indexData = indices + (size_t)b * blockIndices;
 
-				if( v == 0 || v == size - 1 || u == 0 || u == size - 1 )
-					vertData = (float*) elemset_le(vertData, (maxf( _heightData[index] / 65535.0f - _skirtHeight, 0 )));
-				else
-					vertData = (float*) elemset_le(vertData, (_heightData[index] / 65535.0f));
+			for( uint32 v = 0; v < size; ++v )
+			{	
+				float t = (v - 1) * invScale;
+				if( v == 0 ) t = 0.0f; else if( v == size - 1 ) t = 1.0f;	// Skirt
 
-				vertData = (float*) elemset_le(vertData, (t * scale + minV));
+				for( uint32 u = 0; u < size; ++u )
+				{
+					float s = (u - 1) * invScale;
+					if( u == 0 ) s = 0.0f; else if( u == size - 1 ) s = 1.0f;	// Skirt
+
+					const float newU = (s * scale + minU) * _hmapSize + 0.5f;
+					const float newV = (t * scale + minV) * _hmapSize + 0.5f;
+					uint32 index = ftoi_t( newV ) * (_hmapSize + 1) + ftoi_t( newU );
+
+					*vertData++ = s * scale + minU;
+					if( v == 0 || v == size - 1 || u == 0 || u == size - 1 )
+						*vertData++ = maxf( _heightData[index] / 65535.0f - _skirtHeight, 0 );
+					else
+						*vertData++ = _heightData[index] / 65535.0f;
+					*vertData++ = t * scale + minV;
+				}
 			}
-		}
 
-		for( uint32 v = 0; v < size - 1; ++v )
-		{
-			for( uint32 u = 0; u < size - 1; ++u )
+			for( uint32 v = 0; v < size - 1; ++v )
 			{
-				indexData = (uint32*) elemset_le(indexData, indexOffset + v * size + u);
-				indexData = (uint32*) elemset_le(indexData, indexOffset + (v + 1) * size + u);
-				indexData = (uint32*) elemset_le(indexData, indexOffset + (v + 1) * size + u + 1);
+				for( uint32 u = 0; u < size - 1; ++u )
+				{
+					*indexData++ = firstVert + v * size + u;
+					*indexData++ = firstVert + (v + 1) * size + u;
+					*indexData++ = firstVert + (v + 1) * size + u + 1;
 
-				indexData = (uint32*) elemset_le(indexData, indexOffset + v * size + u);
-				indexData = (uint32*) elemset_le(indexData, indexOffset + (v + 1) * size + u + 1);
-				indexData = (uint32*) elemset_le(indexData, indexOffset + v * size + u + 1);
+					*indexData++ = firstVert + v * size + u;
+					*indexData++ = firstVert + (v + 1) * size + u + 1;
+					*indexData++ = firstVert + v * size + u + 1;
+				}
 			}
 		}
-		indexOffset += size * size;
-	}
-	else 
-	{
-		scale /= 2;
+	} );
+}
 
-		Vec4f blocks[] =
-		{
-			Vec4f( minU, minV, halfU, halfV ),
-			Vec4f( halfU, minV, maxU, halfV ),
-			Vec4f( minU, halfV, halfU, maxV ),
-			Vec4f( halfU, halfV, maxU, maxV )
-		};
 
-		for( uint32 i = 0; i < 4; ++i )
-		{
-			createGeometryVertices( lodThreshold, blocks[i].x, blocks[i].y, blocks[i].z, blocks[i].w,
-			                        level + 1, scale, vertData, indexData, indexOffset );
-		}
-	}
+bool TerrainNode::createGeometry( float lodThreshold, const float *region, float *vertices, uint32 maxVertices,
+                                  uint32 *indices, uint32 maxIndices, uint32 &numVertices, uint32 &numIndices )
+{
+	const vector< Vec3f > &blocks = getGeometryBlocks( lodThreshold, region );
+	numVertices = (uint32)blocks.size() * getVertexCount();
+	numIndices = (uint32)blocks.size() * (_blockSize + 1) * (_blockSize + 1) * 6;
+
+	if( vertices == 0x0 && indices == 0x0 ) return true;
+	if( vertices == 0x0 || indices == 0x0 || maxVertices < numVertices || maxIndices < numIndices ) return false;
+
+	writeGeometryBlocks( blocks, vertices, indices );
+	return true;
 }
 
 
-ResHandle TerrainNode::createGeometryResource( const string &name, float lodThreshold )
+ResHandle TerrainNode::createGeometryResource( const string &name, float lodThreshold, const float *region )
 {
 	if( name.empty() ) return 0;
 
@@ -995,7 +1224,8 @@ ResHandle TerrainNode::createGeometryResource( const string &name, float lodThre
 		return 0;
 	}
 
-	uint32 blockCount = calculateGeometryBlockCount( lodThreshold, 0.0f, 0.0f, 1.0f, 1.0f, 0, 1.0f );
+	const vector< Vec3f > &blocks = getGeometryBlocks( lodThreshold, region );
+	uint32 blockCount = (uint32)blocks.size();
 	// Calculate number of vertices 
 	const uint32 streamSize = blockCount * getVertexCount();
 	// Calculate size of elements in stream
@@ -1030,12 +1260,14 @@ ResHandle TerrainNode::createGeometryResource( const string &name, float lodThre
 	// set stream element size
 	pData = elemset_le((uint32 *)(pData), streamElementSize);
 
-	uint32 index = 0;
 	float *vertexData = (float *)pData;
-	//const unsigned int* const refIndexData = (unsigned int*)(pData + streamSize * streamElementSize + sizeof( uint32 ));
 	uint32 *indexData = (uint32 *)(pData + streamSize * streamElementSize + sizeof( uint32 ));
 	
-	createGeometryVertices( lodThreshold, 0.0f, 0.0f, 1.0f, 1.0f, 0, 1.0f, vertexData, indexData, index );
+	writeGeometryBlocks( blocks, vertexData, indexData );
+#if defined( PLATFORM_BIG_ENDIAN )
+	swap_endian( vertexData, vertexData + streamSize * 3, vertexData );
+	swap_endian( indexData, indexData + indexCount, indexData );
+#endif
 	
 	// Skip vertex data
 	pData += streamSize * streamElementSize;
@@ -17,6 +17,7 @@
 #include "egMaterial.h"
 #include "egTexture.h"
 #include "egScene.h"
+#include "terrainTiles.h"
 
 
 namespace Horde3DTerrain {
@@ -42,10 +43,12 @@ struct TerrainNodeTpl : public SceneNodeTpl
 	float              meshQuality;
 	float              skirtHeight;
 	int                blockSize;
+	std::string        tileFile;       // Paged height data; replaces the height map if not empty
+	int                tileCacheSize;  // Maximum number of resident tiles
 
 	TerrainNodeTpl( const std::string &name, TextureResource *hmapRes, MaterialResource *matRes ) :
 		SceneNodeTpl( SNT_TerrainNode, name ), hmapRes( hmapRes ), matRes( matRes ),
-		meshQuality( 50.0f ), skirtHeight( 0.1f ), blockSize( 17 )
+		meshQuality( 50.0f ), skirtHeight( 0.1f ), blockSize( 17 ), tileCacheSize( 64 )
 	{
 	}
 };
@@ -59,17 +62,23 @@ struct TerrainNodeParams
 		MatResI,
 		MeshQualityF,
 		SkirtHeightF,
-		BlockSizeI
+		BlockSizeI,
+		TileCacheSizeI,
+		ResidentTilesI,
+		BicubicHeightsI
 	};
 };
 
-struct BlockInfo
-{	
-	float minHeight;
-	float maxHeight;
-	float geoError;		// Maximum geometric error
-
-	BlockInfo() : minHeight( 1.0f ), maxHeight( 0.0f ), geoError( 0.0f ) {}
+// Height field that blocks are taken from; either the whole terrain or a single tile of it
+struct TerrainBlockSource
+{
+	const uint16      *heights;
+	const BlockInfo   *blockTree;
+	uint32            size;
+	uint32            maxLevel;
+	float             originU, originV;  // Position and size in terrain space
+	float             extent;
+	TerrainTileCache  *tileCache;        // Tiles refining the blocks of the finest level; 0x0 if none
 };
 
 class TerrainNode : public SceneNode
@@ -79,7 +88,7 @@ public:
 
 	static SceneNodeTpl *parsingFunc( std::map< std::string, std::string > &attribs );
 	static SceneNode *factoryFunc( const SceneNodeTpl &nodeTpl );
-	static void renderFunc(uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+	static void renderFunc(uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
 		bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 
 	virtual bool canAttach( SceneNode &parent ) const;
@@ -90,8 +99,16 @@ public:
 
 	virtual bool checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec3f &intsPos ) const;
 
-	ResHandle createGeometryResource( const std::string &name, float lodThreshold );
+	// Region is minU, minV, maxU, maxV in local space; blocks overlapping it are exported completely
+	ResHandle createGeometryResource( const std::string &name, float lodThreshold, const float *region );
+	// Writes vertex positions and triangle indices to the buffers; returns false if they are too small
+	bool createGeometry( float lodThreshold, const float *region, float *vertices, uint32 maxVertices,
+	                     uint32 *indices, uint32 maxIndices, uint32 &numVertices, uint32 &numIndices );
+	TerrainTileCache *getTileCache() const { return _tileCache; }
 	
+	// Samples the full resolution height field at world space x/z pairs; normals are optional
+	void getHeights( const float *xz, uint32 count, float *outHeights, float *outNormals ) const;
+
 	float getHeight( float x, float y )
 		{ return _heightData[ftoi_r( y * _hmapSize ) * (_hmapSize + 1) + ftoi_r( x * _hmapSize ) ] / 65535.0f; }
 
@@ -106,6 +123,8 @@ protected:
 	virtual void onPostUpdate();
 	
 	bool updateHeightData( TextureResource &hmap );
+	bool openTileFile( const std::string &fileName, uint32 cacheSize );
+	void requestTiles( const Vec3f &localCamPos );
 	void calcMaxLevel();
 	
 	uint32 getVertexCount();
@@ -114,18 +133,17 @@ protected:
 	uint16 *createIndices();
 	void recreateVertexBuffer();
 	
-	void buildBlockInfo( BlockInfo &block, float minU, float minV, float maxU, float maxV );
 	void createBlockTree();
 
-	static void drawTerrainBlock( TerrainNode *terrain, float minU, float minV, float maxU, float maxV,
-	                              int level, float scale, const Vec3f &localCamPos, const Frustum *frust1,
+	static void drawTerrainBlock( TerrainNode *terrain, const TerrainBlockSource &src,
+	                              float minU, float minV, float maxU, float maxV,
+	                              uint32 level, float scale, const Vec3f &localCamPos, const Frustum *frust1,
 	                              const Frustum *frust2, int uni_terBlockParams );
 
-	uint32 calculateGeometryBlockCount( float lodThreshold, float minU, float minV,
-	                                    float maxU, float maxV, int level, float scale);
-	void createGeometryVertices( float lodThreshold, float minU, float minV,
-	                             float maxU, float maxV, int level, float scale, 
-	                             float *&vertData, unsigned int *&indexData, uint32 &indexOffset );
+	const std::vector< Vec3f > &getGeometryBlocks( float lodThreshold, const float *region );
+	void collectGeometryBlocks( float lodThreshold, const float *region, float minU, float minV,
+	                            float maxU, float maxV, uint32 level, std::vector< Vec3f > &blocks ) const;
+	void writeGeometryBlocks( const std::vector< Vec3f > &blocks, float *vertices, uint32 *indices ) const;
 
 protected:
 	PMaterialResource  _materialRes;
@@ -142,6 +160,15 @@ protected:
 
 	std::vector< BlockInfo >  _blockTree;
 	uint32 _geometry;
+
+	TerrainTileCache   *_tileCache;  // Only used in tiled mode, where _heightData is the tile overview
+	uint32             _tileUpdateFrame;
+	bool               _bicubicHeights;
+
+	// Blocks of the last geometry export as minU, minV and size; rebuilt when the parameters change
+	std::vector< Vec3f >  _geoBlocks;
+	float                 _geoBlocksKey[5];
+	bool                  _geoBlocksValid;
 };
 
 }  // namespace
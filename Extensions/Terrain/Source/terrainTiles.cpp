@@ -0,0 +1,511 @@
+// *************************************************************************************************
+//
+// Horde3D Terrain Extension
+// --------------------------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz, Volker Wiendl and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "utEndian.h"
+#include "terrainTiles.h"
+#include <algorithm>
+#include <cstring>
+
+#include "utDebug.h"
+
+namespace Horde3DTerrain {
+
+using namespace Horde3D;
+using namespace std;
+
+
+static const uint32 TileFileVersion = 1;
+static const uint32 TileFileHeaderSize = 4 + 5 * sizeof( uint32 );
+
+
+static void calcBlockInfo( BlockInfo &block, const uint16 *heights, uint32 size, uint32 blockSize, float extent,
+                           float minU, float minV, float maxU, float maxV )
+{
+	auto getHeight = [heights, size]( float x, float y )
+		{ return heights[ftoi_r( y * size ) * (size + 1) + ftoi_r( x * size )] / 65535.0f; };
+
+	const float pixelStep = 1.0f / size;
+	const float stepU = (maxU - minU) / (blockSize - 1);
+	const float stepV = (maxV - minV) / (blockSize - 1);
+
+	for( uint32 v = 0; v < blockSize - 1; ++v )
+	{
+		for( uint32 u = 0; u < blockSize - 1; ++u )
+		{
+			Vec3f corner0( minU + u * stepU, 0, minV + v * stepV);
+			Vec3f corner1( minU + u * stepU, 0, minV + (v + 1) * stepV);
+			Vec3f corner2( minU + (u + 1) * stepU, 0, minV + v * stepV);
+			Vec3f corner3( minU + (u + 1) * stepU, 0, minV + (v + 1) * stepV);
+
+			corner0.y = getHeight( corner0.x, corner0.z );
+			corner1.y = getHeight( corner1.x, corner1.z );
+			corner2.y = getHeight( corner2.x, corner2.z );
+			corner3.y = getHeight( corner3.x, corner3.z );
+
+			// Geometric error is measured in terrain space
+			corner0.x *= extent; corner0.z *= extent;
+			corner1.x *= extent; corner1.z *= extent;
+			corner2.x *= extent; corner2.z *= extent;
+			corner3.x *= extent; corner3.z *= extent;
+
+			Plane tri0( corner0, corner1, corner2 );
+			Plane tri1( corner1, corner2, corner3 );
+
+			float vv = 0;
+			float uu = 0;
+			while ( vv <= stepV )
+			{
+				while ( uu <= stepU )
+				{
+					Plane &curTri = uu <= vv ? tri0 : tri1;
+
+					Vec3f point( minU + u * stepU + uu, 0, minV + v * stepV + vv );
+					point.y = getHeight( point.x, point.z );
+					point.x *= extent; point.z *= extent;
+
+					block.minHeight = minf( point.y, block.minHeight );
+					block.maxHeight = maxf( point.y, block.maxHeight );
+					block.geoError = maxf( block.geoError, fabsf( curTri.distToPoint( point ) ) );
+
+					uu += pixelStep;
+				}
+
+				vv += pixelStep;
+			}
+		}
+	}
+}
+
+
+void buildBlockTree( vector< BlockInfo > &blockTree, const uint16 *heights, uint32 size,
+                     uint32 blockSize, uint32 maxLevel, float extent )
+{
+	// The block tree contains the renderable blocks for each quad tree level, starting at the
+	// lowest resolution level 0 (just one block for the complete height field)
+
+	uint32 treeSize = 0, index = 0;
+	for( uint32 i = 0; i <= maxLevel; ++i ) treeSize += (1 << i) * (1 << i);
+	blockTree.assign( treeSize, BlockInfo() );
+
+	for( uint32 i = 0; i <= maxLevel; ++i )
+	{
+		uint32 numBlocks = 1 << i;
+
+		for( uint32 y = 0; y < numBlocks; ++y )
+		{
+			for( uint32 x = 0; x < numBlocks; ++x )
+			{
+				calcBlockInfo( blockTree[index++], heights, size, blockSize, extent,
+				               (float)x / numBlocks, (float)y / numBlocks,
+				               (float)(x + 1) / numBlocks, (float)(y + 1) / numBlocks );
+			}
+		}
+	}
+}
+
+
+static bool isPow2( uint32 value )
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+
+static uint32 calcTileMaxLevel( uint32 tileSize, uint32 blockSize )
+{
+	uint32 maxLevel = 0;
+	for( uint32 i = 1; i < tileSize / (blockSize - 1); i *= 2 ) ++maxLevel;
+	return maxLevel;
+}
+
+
+static uint32 calcTileBlockCount( uint32 tileMaxLevel )
+{
+	uint32 count = 0;
+	for( uint32 i = 0; i <= tileMaxLevel; ++i ) count += (1 << i) * (1 << i);
+	return count;
+}
+
+
+bool createTerrainTileFile( const string &fileName, uint32 tilesPerSide, uint32 tileSize,
+                            uint32 blockSize, const TerrainTileFunc &fillTile )
+{
+	if( !isPow2( tilesPerSide ) || blockSize < 3 || !isPow2( blockSize - 1 ) ||
+	    tileSize % (blockSize - 1) != 0 || !isPow2( tileSize / (blockSize - 1) ) ) return false;
+
+	ofstream outf( fileName.c_str(), ios::binary | ios::trunc );
+	if( !outf.good() ) return false;
+
+	const uint32 tileMaxLevel = calcTileMaxLevel( tileSize, blockSize );
+	const uint32 blockCount = calcTileBlockCount( tileMaxLevel );
+	const uint32 samples = (tileSize + 1) * (tileSize + 1);
+	const uint32 ovSize = tilesPerSide * (blockSize - 1);
+	const uint32 step = tileSize / (blockSize - 1);
+
+	// Header
+	char header[TileFileHeaderSize];
+	char *pData = elemcpyd_le( header, "H3DT", 4 );
+	pData = elemset_le( (uint32 *)pData, TileFileVersion );
+	pData = elemset_le( (uint32 *)pData, tilesPerSide );
+	pData = elemset_le( (uint32 *)pData, tileSize );
+	pData = elemset_le( (uint32 *)pData, blockSize );
+	pData = elemset_le( (uint32 *)pData, blockCount );
+	outf.write( header, TileFileHeaderSize );
+
+	// Reserve space for overview and root blocks, which are filled while the tiles are written
+	vector< uint16 > overview( (ovSize + 1) * (ovSize + 1), 0 );
+	vector< BlockInfo > roots( tilesPerSide * tilesPerSide );
+	vector< char > buf( overview.size() * sizeof( uint16 ) + roots.size() * 3 * sizeof( float ), 0 );
+	outf.write( &buf[0], buf.size() );
+
+	vector< uint16 > heights( samples );
+	vector< BlockInfo > blockTree;
+	buf.resize( blockCount * 3 * sizeof( float ) + samples * sizeof( uint16 ) );
+
+	for( uint32 tileY = 0; tileY < tilesPerSide; ++tileY )
+	{
+		for( uint32 tileX = 0; tileX < tilesPerSide; ++tileX )
+		{
+			fillTile( tileX, tileY, &heights[0] );
+
+			for( uint32 y = 0; y < blockSize; ++y )
+			{
+				for( uint32 x = 0; x < blockSize; ++x )
+				{
+					overview[(tileY * (blockSize - 1) + y) * (ovSize + 1) + tileX * (blockSize - 1) + x] =
+						heights[y * step * (tileSize + 1) + x * step];
+				}
+			}
+
+			buildBlockTree( blockTree, &heights[0], tileSize, blockSize, tileMaxLevel, 1.0f / tilesPerSide );
+			roots[tileY * tilesPerSide + tileX] = blockTree[0];
+
+			pData = &buf[0];
+			for( uint32 i = 0; i < blockCount; ++i )
+			{
+				pData = elemset_le( (float *)pData, blockTree[i].minHeight );
+				pData = elemset_le( (float *)pData, blockTree[i].maxHeight );
+				pData = elemset_le( (float *)pData, blockTree[i].geoError );
+			}
+			elemcpyd_le( (uint16 *)pData, &heights[0], samples );
+			outf.write( &buf[0], buf.size() );
+		}
+	}
+
+	buf.resize( overview.size() * sizeof( uint16 ) + roots.size() * 3 * sizeof( float ) );
+	pData = elemcpyd_le( (uint16 *)&buf[0], &overview[0], overview.size() );
+	for( size_t i = 0; i < roots.size(); ++i )
+	{
+		pData = elemset_le( (float *)pData, roots[i].minHeight );
+		pData = elemset_le( (float *)pData, roots[i].maxHeight );
+		pData = elemset_le( (float *)pData, roots[i].geoError );
+	}
+	outf.seekp( TileFileHeaderSize );
+	outf.write( &buf[0], buf.size() );
+
+	return outf.good();
+}
+
+
+// *************************************************************************************************
+// Class TerrainTileCache
+// *************************************************************************************************
+
+TerrainTileCache::TerrainTileCache() :
+	_tilesPerSide( 0 ), _tileSize( 0 ), _blockSize( 0 ), _tileMaxLevel( 0 ), _maxResidentTiles( 64 ),
+	_residentCount( 0 ), _updateCount( 0 ), _pendingLoads( 0 ), _quit( false )
+{
+}
+
+
+TerrainTileCache::~TerrainTileCache()
+{
+	close();
+}
+
+
+bool TerrainTileCache::open( const string &fileName )
+{
+	close();
+
+	ifstream inf( fileName.c_str(), ios::binary );
+	if( !inf.good() ) return false;
+
+	char header[TileFileHeaderSize];
+	inf.read( header, TileFileHeaderSize );
+	if( !inf.good() || strncmp( header, "H3DT", 4 ) != 0 ) return false;
+
+	uint32 version = elemget_le( (uint32 *)(header + 4) );
+	_tilesPerSide = elemget_le( (uint32 *)(header + 8) );
+	_tileSize = elemget_le( (uint32 *)(header + 12) );
+	_blockSize = elemget_le( (uint32 *)(header + 16) );
+	uint32 blockCount = elemget_le( (uint32 *)(header + 20) );
+
+	if( version != TileFileVersion || !isPow2( _tilesPerSide ) || _blockSize < 3 ||
+	    _tileSize % (_blockSize - 1) != 0 || !isPow2( _tileSize / (_blockSize - 1) ) )
+	{
+		_tilesPerSide = 0;
+		return false;
+	}
+	_tileMaxLevel = calcTileMaxLevel( _tileSize, _blockSize );
+	if( blockCount != calcTileBlockCount( _tileMaxLevel ) )
+	{
+		_tilesPerSide = 0;
+		return false;
+	}
+
+	uint32 ovSize = getOverviewSize();
+	_overview.resize( (ovSize + 1) * (ovSize + 1) );
+	_tileRoots.resize( _tilesPerSide * _tilesPerSide );
+	vector< char > buf( _overview.size() * sizeof( uint16 ) + _tileRoots.size() * 3 * sizeof( float ) );
+	inf.read( &buf[0], buf.size() );
+	if( !inf.good() )
+	{
+		_tilesPerSide = 0;
+		return false;
+	}
+	char *pData = elemcpy_le( &_overview[0], (uint16 *)&buf[0], _overview.size() );
+	for( size_t i = 0; i < _tileRoots.size(); ++i )
+	{
+		pData = elemcpy_le( &_tileRoots[i].minHeight, (float *)pData, 1 );
+		pData = elemcpy_le( &_tileRoots[i].maxHeight, (float *)pData, 1 );
+		pData = elemcpy_le( &_tileRoots[i].geoError, (float *)pData, 1 );
+	}
+
+	TileSlot slot = { 0x0, 0, 0, TileUnloaded, false };
+	_slots.assign( _tilesPerSide * _tilesPerSide, slot );
+	_fileName = fileName;
+	_quit = false;
+	_loader = thread( &TerrainTileCache::loaderThread, this );
+
+	return true;
+}
+
+
+void TerrainTileCache::close()
+{
+	if( _loader.joinable() )
+	{
+		{
+			lock_guard< mutex > lock( _mutex );
+			_quit = true;
+		}
+		_loadCond.notify_all();
+		_loader.join();
+	}
+
+	for( size_t i = 0; i < _loadedTiles.size(); ++i ) delete _loadedTiles[i].second;
+	for( size_t i = 0; i < _slots.size(); ++i ) delete _slots[i].tile;
+	_loadedTiles.clear();
+	_loadQueue.clear();
+	_slots.clear();
+	_requests.clear();
+	_overview.clear();
+	_tileRoots.clear();
+	_residentCount = 0;
+	_pendingLoads = 0;
+	_fileName.clear();
+}
+
+
+size_t TerrainTileCache::getTileMemory() const
+{
+	return (_tileSize + 1) * (_tileSize + 1) * sizeof( uint16 ) +
+	       calcTileBlockCount( _tileMaxLevel ) * sizeof( BlockInfo );
+}
+
+
+void TerrainTileCache::requestTile( uint32 tileX, uint32 tileY, float priority )
+{
+	if( tileX >= _tilesPerSide || tileY >= _tilesPerSide ) return;
+
+	uint32 index = tileY * _tilesPerSide + tileX;
+	TileSlot &slot = _slots[index];
+	if( !slot.requested )
+	{
+		slot.requested = true;
+		slot.priority = priority;
+		_requests.push_back( index );
+	}
+	else
+	{
+		slot.priority = minf( slot.priority, priority );
+	}
+}
+
+
+const TerrainTile *TerrainTileCache::getTile( uint32 tileX, uint32 tileY ) const
+{
+	if( tileX >= _tilesPerSide || tileY >= _tilesPerSide ) return 0x0;
+
+	const TileSlot &slot = _slots[tileY * _tilesPerSide + tileX];
+	return slot.state == TileResident ? slot.tile : 0x0;
+}
+
+
+void TerrainTileCache::takeLoadedTiles()
+{
+	lock_guard< mutex > lock( _mutex );
+
+	for( size_t i = 0; i < _loadedTiles.size(); ++i )
+	{
+		TileSlot &slot = _slots[_loadedTiles[i].first];
+		slot.tile = _loadedTiles[i].second;
+
+		if( slot.tile != 0x0 )
+		{
+			slot.state = TileResident;
+		}
+		else
+		{
+			// Reading failed; the slot does not count against the budget anymore
+			slot.state = TileUnloaded;
+			--_residentCount;
+		}
+	}
+	_loadedTiles.clear();
+}
+
+
+void TerrainTileCache::update()
+{
+	if( _slots.empty() ) return;
+
+	++_updateCount;
+	takeLoadedTiles();
+
+	// Closest tiles first
+	std::sort( _requests.begin(), _requests.end(), [this]( uint32 a, uint32 b )
+		{ return _slots[a].priority < _slots[b].priority; } );
+
+	vector< uint32 > newLoads;
+	for( size_t i = 0; i < _requests.size(); ++i )
+	{
+		TileSlot &slot = _slots[_requests[i]];
+		slot.lastRequest = _updateCount;
+		if( slot.state != TileUnloaded ) continue;
+
+		if( _residentCount >= _maxResidentTiles )
+		{
+			// Evict least recently requested tile that is not needed anymore; when more tiles are
+			// requested than fit into the cache, the farthest requested tile makes room for a closer one
+			TileSlot *victim = 0x0;
+			for( size_t j = 0; j < _slots.size(); ++j )
+			{
+				TileSlot &s = _slots[j];
+				if( s.state != TileResident ) continue;
+				if( !s.requested )
+				{
+					if( victim == 0x0 || victim->requested || s.lastRequest < victim->lastRequest ) victim = &s;
+				}
+				else if( s.priority > slot.priority &&
+				         (victim == 0x0 || (victim->requested && s.priority > victim->priority)) )
+				{
+					victim = &s;
+				}
+			}
+			if( victim == 0x0 ) break;
+
+			delete victim->tile; victim->tile = 0x0;
+			victim->state = TileUnloaded;
+			--_residentCount;
+		}
+
+		// Loading tiles count against the budget as their memory is allocated by the loader
+		slot.state = TileLoading;
+		++_residentCount;
+		newLoads.push_back( _requests[i] );
+	}
+
+	for( size_t i = 0; i < _requests.size(); ++i ) _slots[_requests[i]].requested = false;
+	_requests.clear();
+
+	if( !newLoads.empty() )
+	{
+		{
+			lock_guard< mutex > lock( _mutex );
+			_loadQueue.insert( _loadQueue.end(), newLoads.begin(), newLoads.end() );
+			_pendingLoads += (uint32)newLoads.size();
+		}
+		_loadCond.notify_one();
+	}
+}
+
+
+void TerrainTileCache::finishLoading()
+{
+	{
+		unique_lock< mutex > lock( _mutex );
+		_finishCond.wait( lock, [this]() { return _pendingLoads == 0; } );
+	}
+	takeLoadedTiles();
+}
+
+
+bool TerrainTileCache::readTile( ifstream &file, uint32 index, TerrainTile &tile ) const
+{
+	const uint32 blockCount = calcTileBlockCount( _tileMaxLevel );
+	const uint32 samples = (_tileSize + 1) * (_tileSize + 1);
+	const uint64 recordSize = blockCount * 3 * sizeof( float ) + samples * sizeof( uint16 );
+	const uint64 offset = TileFileHeaderSize + _overview.size() * sizeof( uint16 ) +
+	                      _tileRoots.size() * 3 * sizeof( float ) + index * recordSize;
+
+	vector< char > buf( (size_t)recordSize );
+	file.seekg( (streamoff)offset );
+	file.read( &buf[0], buf.size() );
+	if( !file.good() )
+	{
+		file.clear();
+		return false;
+	}
+
+	char *pData = &buf[0];
+	tile.blockTree.resize( blockCount );
+	for( uint32 i = 0; i < blockCount; ++i )
+	{
+		pData = elemcpy_le( &tile.blockTree[i].minHeight, (float *)pData, 1 );
+		pData = elemcpy_le( &tile.blockTree[i].maxHeight, (float *)pData, 1 );
+		pData = elemcpy_le( &tile.blockTree[i].geoError, (float *)pData, 1 );
+	}
+	tile.heights.resize( samples );
+	elemcpy_le( &tile.heights[0], (uint16 *)pData, samples );
+
+	return true;
+}
+
+
+void TerrainTileCache::loaderThread()
+{
+	ifstream file( _fileName.c_str(), ios::binary );
+
+	unique_lock< mutex > lock( _mutex );
+	for(;;)
+	{
+		_loadCond.wait( lock, [this]() { return _quit || !_loadQueue.empty(); } );
+		if( _quit ) break;
+
+		uint32 index = _loadQueue.front();
+		_loadQueue.pop_front();
+		lock.unlock();
+
+		TerrainTile *tile = new TerrainTile();
+		if( !readTile( file, index, *tile ) )
+		{
+			delete tile; tile = 0x0;
+		}
+
+		lock.lock();
+		_loadedTiles.push_back( make_pair( index, tile ) );
+		--_pendingLoads;
+		if( _pendingLoads == 0 ) _finishCond.notify_all();
+	}
+}
+
+}  // namespace
@@ -0,0 +1,143 @@
+// *************************************************************************************************
+//
+// Horde3D Terrain Extension
+// --------------------------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz, Volker Wiendl and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _Horde3DTerrain_terrainTiles_H_
+#define _Horde3DTerrain_terrainTiles_H_
+
+#include "egPrerequisites.h"
+#include "utMath.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+
+namespace Horde3DTerrain {
+
+using namespace Horde3D;
+
+struct BlockInfo
+{
+	float minHeight;
+	float maxHeight;
+	float geoError;		// Maximum geometric error
+
+	BlockInfo() : minHeight( 1.0f ), maxHeight( 0.0f ), geoError( 0.0f ) {}
+};
+
+// Fills the block quad tree for levels 0 to maxLevel of a height field with (size + 1)^2 samples.
+// Extent is the size of the height field in terrain space, which is used for the geometric error.
+void buildBlockTree( std::vector< BlockInfo > &blockTree, const uint16 *heights, uint32 size,
+                     uint32 blockSize, uint32 maxLevel, float extent );
+
+
+// =================================================================================================
+// Terrain Tile File
+// =================================================================================================
+
+// A tile file stores a square grid of tilesPerSide^2 height field tiles with tileSize + 1 samples per
+// side, where the last row and column are shared with the neighbouring tiles. Each tile comes with
+// its precomputed block tree. An overview height field that has blockSize samples per tile side and
+// the root blocks of all tiles are kept in memory all the time and are used where no tile is resident.
+
+struct TerrainTile
+{
+	std::vector< uint16 >     heights;
+	std::vector< BlockInfo >  blockTree;
+};
+
+// Called for each tile to get its (tileSize + 1)^2 height samples
+typedef std::function< void( uint32 tileX, uint32 tileY, uint16 *heights ) > TerrainTileFunc;
+
+bool createTerrainTileFile( const std::string &fileName, uint32 tilesPerSide, uint32 tileSize,
+                            uint32 blockSize, const TerrainTileFunc &fillTile );
+
+// =================================================================================================
+
+class TerrainTileCache
+{
+public:
+	TerrainTileCache();
+	~TerrainTileCache();
+
+	bool open( const std::string &fileName );
+	void close();
+
+	// Marks a tile as needed; tiles with lower priority values are loaded first
+	void requestTile( uint32 tileX, uint32 tileY, float priority );
+	// Returns 0x0 if the tile is not resident
+	const TerrainTile *getTile( uint32 tileX, uint32 tileY ) const;
+
+	// Takes over loaded tiles and starts loading the requested ones, evicting tiles that were not
+	// requested since the last update; should be called once per frame after all requests
+	void update();
+	// Blocks until all tiles that are currently being loaded are resident
+	void finishLoading();
+
+	void setMaxResidentTiles( uint32 count ) { _maxResidentTiles = count > 0 ? count : 1; }
+	uint32 getMaxResidentTiles() const { return _maxResidentTiles; }
+	uint32 getResidentTileCount() const { return _residentCount; }  // Including tiles being loaded
+	size_t getResidentMemory() const { return _residentCount * getTileMemory(); }
+	size_t getTileMemory() const;
+
+	const std::string &getFileName() const { return _fileName; }
+	uint32 getTilesPerSide() const { return _tilesPerSide; }
+	uint32 getTileSize() const { return _tileSize; }
+	uint32 getBlockSize() const { return _blockSize; }
+	uint32 getTileMaxLevel() const { return _tileMaxLevel; }
+	uint32 getOverviewSize() const { return _tilesPerSide * (_blockSize - 1); }
+	const std::vector< uint16 > &getOverview() const { return _overview; }
+	const std::vector< BlockInfo > &getTileRootBlocks() const { return _tileRoots; }  // Row-major
+
+protected:
+	struct TileSlot
+	{
+		TerrainTile  *tile;
+		float        priority;
+		uint32       lastRequest;
+		int          state;
+		bool         requested;
+	};
+
+	enum TileState { TileUnloaded, TileLoading, TileResident };
+
+	void loaderThread();
+	bool readTile( std::ifstream &file, uint32 index, TerrainTile &tile ) const;
+	void takeLoadedTiles();
+
+protected:
+	std::string                  _fileName;
+	uint32                       _tilesPerSide, _tileSize, _blockSize, _tileMaxLevel;
+	std::vector< uint16 >        _overview;
+	std::vector< BlockInfo >     _tileRoots;
+
+	std::vector< TileSlot >      _slots;
+	std::vector< uint32 >        _requests;
+	uint32                       _maxResidentTiles, _residentCount;
+	uint32                       _updateCount;
+
+	// Shared with loader thread
+	std::thread                  _loader;
+	std::mutex                   _mutex;
+	std::condition_variable      _loadCond, _finishCond;
+	std::deque< uint32 >         _loadQueue;
+	std::vector< std::pair< uint32, TerrainTile * > >  _loadedTiles;
+	uint32                       _pendingLoads;
+	bool                         _quit;
+};
+
+}  // namespace
+
+#endif // _Horde3DTerrain_terrainTiles_H_
@@ -42,11 +42,14 @@ OpenGLES3
 uniform mat4 projMat;
 attribute vec2 vertPos;
 attribute vec2 texCoords0;
+attribute vec4 vertColor;
 varying vec2 texCoords;
+varying vec4 color;
 
 void main( void )
 {
 	texCoords = vec2( texCoords0.s, -texCoords0.t ); 
+	color = vertColor;
 	gl_Position = projMat * vec4( vertPos.x, vertPos.y, 1, 1 );
 }
 
@@ -54,12 +57,15 @@ void main( void )
 
 layout( location = 0 ) in vec2 vertPos;
 layout( location = 1 ) in vec2 texCoords0;
+layout( location = 2 ) in vec4 vertColor;
 out vec2 texCoords;
+out vec4 color;
 
 uniform mat4 projMat;
 void main( void )
 {
 	texCoords = vec2( texCoords0.s, -texCoords0.t ); 
+	color = vertColor;
 	gl_Position = projMat * vec4( vertPos.x, vertPos.y, 1, 1 );
 }
 
@@ -69,12 +75,13 @@ void main( void )
 uniform vec4 olayColor;
 uniform sampler2D albedoMap;
 varying vec2 texCoords;
+varying vec4 color;
 
 void main( void )
 {
 	vec4 albedo = texture2D( albedoMap, texCoords );
 	
-	gl_FragColor = albedo * olayColor;
+	gl_FragColor = albedo * color * olayColor;
 }
 
 [[FS_OVERLAY_GL4]]
@@ -82,6 +89,7 @@ void main( void )
 uniform vec4 olayColor;
 uniform sampler2D albedoMap;
 in vec2 texCoords;
+in vec4 color;
 
 out vec4 fragColor;
 
@@ -89,5 +97,5 @@ void main( void )
 {
 	vec4 albedo = texture( albedoMap, texCoords );
 	
-	fragColor = albedo * olayColor;
+	fragColor = albedo * color * olayColor;
 }
\ No newline at end of file
@@ -0,0 +1,73 @@
+// *************************************************************************************************
+// Horde3D Shader Utility Library
+// --------------------------------------
+//		- Clustered lighting functions -
+//
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// You may use the following code in projects based on the Horde3D graphics engine.
+//
+// *************************************************************************************************
+
+uniform 	vec3 viewerPos;
+uniform 	sampler2D clusterLightMap;   // Three texels per light: position/radius, direction/cos cone, color
+uniform 	sampler2D clusterGridMap;    // One texel per cluster: offset and count of light index list
+uniform 	sampler2D clusterIndexMap;   // Light indices, four per texel
+uniform 	vec4 clusterTileParams;      // Viewport x, y and tiles per pixel in x, y
+uniform 	vec4 clusterDepthParams;     // Near distance, slices per log unit, slice count, tiles in y
+
+
+vec3 calcClusteredLighting( const vec3 pos, const vec3 normal, const vec3 albedo, const vec3 specColor,
+							const float gloss, const float viewDist )
+{
+	// Find cluster of fragment
+	ivec2 tile = ivec2( (gl_FragCoord.xy - clusterTileParams.xy) * clusterTileParams.zw );
+	float slice = 0.0;
+	if( viewDist > clusterDepthParams.x )
+		slice = floor( log( viewDist / clusterDepthParams.x ) * clusterDepthParams.y );
+	slice = clamp( slice, 0.0, clusterDepthParams.z - 1.0 );
+	
+	vec4 cluster = texelFetch( clusterGridMap, ivec2( tile.x, tile.y + int( slice ) * int( clusterDepthParams.w ) ), 0 );
+	int offset = int( cluster.x );
+	int count = int( cluster.y );
+	
+	vec3 view = normalize( viewerPos - pos );
+	float specExp = exp2( 10.0 * gloss + 1.0 );
+	vec3 result = vec3( 0.0, 0.0, 0.0 );
+	
+	for( int i = 0; i < count; ++i )
+	{
+		int idx = offset + i;
+		vec4 indices = texelFetch( clusterIndexMap, ivec2( (idx / 4) % 1024, idx / 4096 ), 0 );
+		int lightIdx = int( indices[idx % 4] );
+		
+		vec4 lightPos = texelFetch( clusterLightMap, ivec2( 0, lightIdx ), 0 );
+		vec4 lightDir = texelFetch( clusterLightMap, ivec2( 1, lightIdx ), 0 );
+		vec3 lightColor = texelFetch( clusterLightMap, ivec2( 2, lightIdx ), 0 ).rgb;
+		
+		vec3 light = lightPos.xyz - pos;
+		float lightLen = length( light );
+		light /= lightLen;
+		
+		// Distance attenuation
+		float lightDepth = lightLen / lightPos.w;
+		float atten = max( 1.0 - lightDepth * lightDepth, 0.0 );
+		
+		// Spotlight falloff
+		float angle = dot( lightDir.xyz, -light );
+		atten *= clamp( (angle - lightDir.w) / 0.2, 0.0, 1.0 );
+		
+		// Lambert diffuse
+		atten *= max( dot( normal, light ), 0.0 );
+		if( atten <= 0.0 ) continue;
+		
+		// Blinn-Phong specular with energy conservation
+		vec3 halfVec = normalize( light + view );
+		vec3 specular = specColor * pow( max( dot( halfVec, normal ), 0.0 ), specExp );
+		specular *= (specExp * 0.125 + 0.25);  // Normalization factor (n+2)/8
+		
+		result += (albedo + specular) * lightColor * atten;
+	}
+	
+	return result;
+}
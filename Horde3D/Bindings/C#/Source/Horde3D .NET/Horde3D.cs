@@ -31,12 +31,14 @@ public static int H3DRootNode
         /// <summary>
         /// Enum: H3DRenderDevice
         /// The available engine Renderer backends.
+        /// Null	- use a backend that does not draw anything and requires no graphics context
         /// OpenGL2	- use OpenGL 2 as renderer backend (can be used to force OpenGL 2 when higher version is undesirable)
         /// OpenGL4	- use OpenGL 4 as renderer backend (falls back to OpenGL 2 in case of error)
         /// OpenGLES3 - use OpenGL ES 3 as renderer backend
         /// </summary>
         public enum H3DRenderDevice
         {
+            Null = 1,
             OpenGL2 = 2,
             OpenGL4 = 4,
             OpenGLES3 = 8
@@ -67,6 +69,39 @@ public enum H3DRenderDevice
         ///   GatherTimeStats     - Enables or disables gathering of time stats that are useful for profiling (Values: 0, 1; Default: 1)
         ///   DebugRenderBackend  - Enables or disables logging of render backend diagnostic messages. May require additional actions on 
 		///					        application side, like creating a debug opengl context. (Values: 0, 1; Default: 0)
+        ///   TexMipmapFilter     - Filter for generating mipmaps of uncompressed 8 bit images; 0 leaves mipmap generation
+        ///                         to the driver, 1 uses a gamma-correct box filter and 2 a gamma-correct Kaiser filter
+        ///                         on the CPU. Only affects textures that are loaded after setting the option.
+        ///                         (Values: 0, 1, 2; Default: 0)
+        ///   TexStreamingBudget  - Video memory budget in Mb for streamed textures; 0 disables streaming. When enabled, 2D
+        ///                         textures with mipmaps that are loaded afterwards keep a copy of their mip chain in system
+        ///                         memory and only upload the levels required by their screen-space size. Setting the
+        ///                         budget to 0 again makes all levels of these textures resident. (Default: 0)
+        ///   SoftwareOcclusion   - Enables or disables CPU occlusion culling; meshes with the Occluder flag are rasterized
+        ///                         into a low resolution depth buffer and objects of the camera view whose bounding box
+        ///                         is hidden behind them are not drawn. (Values: 0, 1; Default: 0)
+        ///   ShadowMapCacheSize  - Number of lights whose shadow maps are kept in separate buffers; the shadow map of such a
+        ///                         light is only rendered again when the light, the camera or one of the shadow casters
+        ///                         changed, including changes of their geometry, material or shader resources. Each cached
+        ///                         light needs video memory for a shadow map of ShadowMapSize; 0 disables caching. (Default: 0)
+        ///   RenderTargetAliasing - Enables or disables sharing of memory between pipeline render targets that are
+        ///                         not used at the same time and have the same size and format. Targets that are read
+        ///                         before they are written in a frame or whose first quad is drawn with blending keep
+        ///                         their own memory; lifetimes follow the enabled stages. The contents of shared
+        ///                         targets cannot be queried with h3dGetRenderTargetData after rendering; only affects
+        ///                         pipelines that are loaded or resized after setting the option. (Values: 0, 1; Default: 0)
+        ///   CPUProfiler         - Enables or disables recording of CPU profiler zones, see saveProfilerTrace; fails
+        ///                         if the engine was built without the HORDE3D_PROFILER CMake option. (Values: 0, 1; Default: 0)
+        ///   ResourceMemoryBudget - Memory budget in Mb for all resources, including the estimated video memory; a warning
+        ///                         is written to the log when a resource load exceeds it, see getResourceMemory.
+        ///                         (Default: 0 = no budget)
+        ///   DiscardCPUCopies    - Frees the CPU copies of the tangent and static vertex streams after uploading Geometry
+        ///                         resources without joints and morph targets. Positions and indices are kept; the
+        ///                         discarded streams cannot be mapped anymore. Only affects geometry that is loaded
+        ///                         after setting the option. (Values: 0, 1; Default: 0)
+        ///   WorkerThreads       - Number of worker threads that run jobs of the engine and extensions; -1 uses one
+        ///                         less than the number of hardware threads and 0 runs all jobs on the calling
+        ///                         thread. (Values: -1..64; Default: -1)
         /// </summary>
         public enum H3DOptions
         {
@@ -84,7 +119,16 @@ public enum H3DOptions
             DebugViewMode,
             DumpFailedShaders,
             GatherTimeStats,
-            DebugRenderBackend
+            DebugRenderBackend,
+            TexMipmapFilter,
+            TexStreamingBudget,
+            SoftwareOcclusion,
+            ShadowMapCacheSize,
+            RenderTargetAliasing,
+            CPUProfiler,
+            ResourceMemoryBudget,
+            DiscardCPUCopies,
+            WorkerThreads
         }
 
        /// <summary>
@@ -105,6 +149,23 @@ public enum H3DOptions
        ///    TextureVMem       - Estimated amount of video memory used by textures (in Mb)
        ///    GeometryVMem      - Estimated amount of video memory used by geometry (in Mb)
        ///    ComputeGPUTime    - GPU time in ms spent for processing compute shaders
+       ///    CullingTime       - CPU time in ms spent for scene culling
+       ///    TexStreamingPressure - Video memory requested by streamed textures divided by the streaming budget;
+       ///                           values above 1 mean that textures are displayed below their desired resolution
+       ///    TexStreamingMem   - Video memory used by streamed textures (in Mb)
+       ///    OcclusionCulledCount - Number of objects removed from the camera view by software occlusion culling
+       ///    ShadowMapRenderCount - Number of shadow maps that were rendered; shadow maps reused from the cache are not counted
+       ///    ShaderBindCount   - Number of shader program binds
+       ///    MaterialBindCount - Number of materials that were applied for drawing
+       ///    TextureBindCount  - Number of textures assigned to texture units
+       ///    GeometryBindCount - Number of vertex and index buffer binds
+       ///    UniformUploadCount - Number of shader uniform uploads
+       ///    UniformUploadSize - Size of uploaded shader uniforms in bytes
+       ///    BufferUploadSize  - Size of data uploaded to vertex, index and other GPU buffers in bytes
+       ///    RenderTargetSwitchCount - Number of render target switches
+       ///    OcclusionQueryCount - Number of hardware occlusion queries issued
+       ///    OcclusionQueryCulledCount - Number of objects and lights skipped because of the result of an occlusion query
+       ///    RenderViewObjectCount - Number of objects in the render queues of all render views (camera, lights and shadows)
        /// </summary>
         public enum H3DStats
         {
@@ -121,8 +182,75 @@ public enum H3DStats
             ParticleGPUTime,
             TextureVMem,
             GeometryVMem,
-            ComputeGPUTime
-        }
+            ComputeGPUTime,
+            CullingTime,
+            TexStreamingPressure,
+            TexStreamingMem,
+            OcclusionCulledCount,
+            ShadowMapRenderCount,
+            ShaderBindCount,
+            MaterialBindCount,
+            TextureBindCount,
+            GeometryBindCount,
+            UniformUploadCount,
+            UniformUploadSize,
+            BufferUploadSize,
+            RenderTargetSwitchCount,
+            OcclusionQueryCount,
+            OcclusionQueryCulledCount,
+            RenderViewObjectCount
+        }
+
+        public const int H3DMaxStatStages = 32;
+        public const int H3DMaxStatViews = 64;
+
+        /// <summary>
+        /// Render work of a frame or a pipeline stage; see H3DStats for the meaning of the values.
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct H3DRenderCounters
+        {
+            public int triCount;
+            public int batchCount;
+            public int lightPassCount;
+            public int shaderBinds;
+            public int materialBinds;
+            public int textureBinds;
+            public int geometryBinds;
+            public int uniformUploads;
+            public int uniformBytes;
+            public int bufferUploadBytes;
+            public int renderTargetSwitches;
+            public int occlusionQueries;
+            public int occlusionQueryCulled;
+        };
+
+        /// <summary>
+        /// Render work of a pipeline stage in getFrameStats.
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+        public struct H3DStageStats
+        {
+            [MarshalAs(UnmanagedType.ByValTStr, SizeConst = 32)]
+            public string name;                 // id of the stage, truncated to 31 characters
+            public H3DRenderCounters counters;  // work done by the commands of the stage
+        };
+
+        /// <summary>
+        /// Statistics of a complete frame returned by getFrameStats.
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct H3DFrameStats
+        {
+            public H3DRenderCounters counters;  // work done during the frame
+            public float frameTime;             // time in ms between the two last finalizeFrame calls
+            public int numStages;               // number of valid entries in stages
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = H3DMaxStatStages)]
+            public H3DStageStats[] stages;      // work done by each pipeline stage
+            public int numViews;                // number of valid entries in viewObjectCounts
+            [MarshalAs(UnmanagedType.ByValArray, SizeConst = H3DMaxStatViews)]
+            public int[] viewObjectCounts;      // number of objects in the render queue of each render view
+        };
 
         /// <summary>
         ///
@@ -270,6 +398,21 @@ public enum H3DFormats
             TEX_ASTC_12x12
         }
 
+        /// <summary>
+        /// Enum: H3DResMem
+        ///           The memory accessors available for all resource types.
+
+        ///       MemoryElem   - Memory usage of the resource
+        ///       CPUMemoryI   - Estimated system memory used by the resource data in bytes [read-only]
+        ///       GPUMemoryI   - Estimated video memory used by the resource in bytes [read-only]
+        /// </summary>
+        public enum H3DResMem
+        {
+            MemoryElem = 100,
+            CPUMemoryI,
+            GPUMemoryI
+        }
+
         /// <summary>
         /// Enum: H3DGeoRes
         ///           The available Geometry resource accessors.
@@ -378,6 +521,8 @@ public enum H3DShaderRes
         ///                         by the texture format with the exception that half-float is converted
         ///                         to float. The first element in the data array corresponds to the lower
         ///                         left corner.
+        ///       TexResidentMipI - Finest mip level that is resident in video memory; always 0 for textures that are
+        ///                         not streamed [read-only]
        /// </summary>
         public enum H3DTexRes
         {
@@ -387,7 +532,8 @@ public enum H3DTexRes
             TexSliceCountI,
             ImgWidthI,
             ImgHeightI,
-            ImgPixelStream
+            ImgPixelStream,
+            TexResidentMipI
         }
 
 
@@ -504,13 +650,38 @@ public enum H3DNodeTypes
         /// NoRayQuery     - Excludes scene node from ray intersection queries
         /// Inactive       - Deactivates scene node so that it is completely ignored
         ///                  (combination of all flags above)            
+        /// Occluder       - Mesh is rasterized as occluder when software occlusion culling is enabled; can be
+        ///                  combined with NoDraw for invisible low-poly occluder meshes
         /// </summary>
         public enum H3DNodeFlags
         {
             NoDraw = 1,
             NoCastShadow = 2,
             NoRayQuery = 4,
-            Inactive = 7  // NoDraw | NoCastShadow | NoRayQuery        
+            Inactive = 7,  // NoDraw | NoCastShadow | NoRayQuery
+            Occluder = 8
+        };
+
+        /// <summary>
+        /// Enum: H3DRayQueryFlags
+        ///        The available flags for castRays in addition to H3DNodeFlags.
+        ///
+        /// AnyHit  - Stop at the first intersection found instead of searching for the closest one
+        /// </summary>
+        public enum H3DRayQueryFlags
+        {
+            AnyHit = 0x10000
+        };
+
+        /// <summary>
+        /// Result of a single ray in castRays.
+        /// </summary>
+        [StructLayout(LayoutKind.Sequential)]
+        public struct H3DRayHit
+        {
+            public int node;           // handle of intersected node or 0
+            public float distance;     // distance from ray origin to intersection point
+            public float x, y, z;      // coordinates of intersection point
         };
 
         /// <summary>
@@ -891,6 +1062,31 @@ public static bool setOption(H3DOptions param, float value)
             return NativeMethodsEngine.h3dSetOption((int)param, value);
         }
 
+        /// <summary>
+        /// Sets the directory used by the engine for on-disk caches.
+        /// </summary>
+        /// This function sets the directory where the engine stores data that is expensive to regenerate,
+        /// like textures processed by the CPU texture pipeline and linked shader programs. An empty string
+        /// disables the caches.
+        /// <param name="path">path of an existing, writable directory</param>
+        public static void setCacheDirectory(string path)
+        {
+            if (path == null) throw new ArgumentNullException("path", Resources.StringNullExceptionString);
+
+            NativeMethodsEngine.h3dSetCacheDirectory(path);
+        }
+
+        /// <summary>
+        /// Stores the programs of all loaded shaders in the cache.
+        /// </summary>
+        /// This function stores the programs of all compiled shader combinations whose cache entries are
+        /// missing or are rejected by the driver. It can be used to fill and validate the cache offline.
+        /// <returns>number of stored programs or -1 if the program cache is not available</returns>
+        public static int updateShaderCache()
+        {
+            return NativeMethodsEngine.h3dUpdateShaderCache();
+        }
+
         /// <summary>
         /// Gets a statistic value of the engine.
         /// </summary>
@@ -904,6 +1100,92 @@ public static float getStat(H3DStats param, bool reset)
             return NativeMethodsEngine.h3dGetStat((int)param, reset);
         }
 
+        /// <summary>
+        /// Gets the render statistics of the last frame.
+        /// </summary>
+        /// This function fills a struct with the render statistics of the last frame that was completed by
+        /// finalizeFrame, including the work done by each pipeline stage and the number of objects in each
+        /// render view. The values are not affected by the reset flag of getStat.
+        /// <param name="stats">struct that receives the statistics</param>
+        /// <returns>true in case of success, otherwise false</returns>
+        public static bool getFrameStats(out H3DFrameStats stats)
+        {
+            return NativeMethodsEngine.h3dGetFrameStats(out stats);
+        }
+
+        /// <summary>
+        /// Saves the zones recorded by the CPU profiler to a trace file.
+        /// </summary>
+        /// This function writes the CPU profiler zones of the last frames to a file in the Chrome trace event
+        /// format, which can be viewed with chrome://tracing or Perfetto. Zones are only recorded while the
+        /// CPUProfiler option is enabled. A frame ends with the call to finalizeFrame().
+        /// <param name="fileName">name of the trace file</param>
+        /// <param name="numFrames">number of completed frames that are saved</param>
+        /// <returns>true if the file could be written, otherwise false</returns>
+        public static bool saveProfilerTrace(string fileName, int numFrames)
+        {
+            if (fileName == null) throw new ArgumentNullException("fileName", Resources.StringNullExceptionString);
+
+            return NativeMethodsEngine.h3dSaveProfilerTrace(fileName, numFrames);
+        }
+
+        /// <summary>
+        /// Starts recording API calls to a capture file.
+        /// </summary>
+        /// This function writes all API calls that change the engine state or cause work with their arguments
+        /// and resource data into a compact binary file that can be replayed with beginReplay and replayFrame.
+        /// To reproduce a session exactly, the capture has to be started right after init. Calls of extensions
+        /// like Terrain and Overlays are not recorded.
+        /// <param name="fileName">name of the capture file</param>
+        /// <returns>true if the capture file could be created, otherwise false</returns>
+        public static bool beginCapture(string fileName)
+        {
+            if (fileName == null) throw new ArgumentNullException("fileName", Resources.StringNullExceptionString);
+
+            return NativeMethodsEngine.h3dBeginCapture(fileName);
+        }
+
+        /// <summary>
+        /// Stops recording API calls.
+        /// </summary>
+        public static void endCapture()
+        {
+            NativeMethodsEngine.h3dEndCapture();
+        }
+
+        /// <summary>
+        /// Opens a capture file for replaying it.
+        /// </summary>
+        /// The engine should be freshly initialized, so that the replayed calls create the same handles as in
+        /// the captured session.
+        /// <param name="fileName">name of the capture file</param>
+        /// <returns>true if the file could be opened and has a valid header, otherwise false</returns>
+        public static bool beginReplay(string fileName)
+        {
+            if (fileName == null) throw new ArgumentNullException("fileName", Resources.StringNullExceptionString);
+
+            return NativeMethodsEngine.h3dBeginReplay(fileName);
+        }
+
+        /// <summary>
+        /// Replays the next frame of a capture.
+        /// </summary>
+        /// This function executes the recorded calls of the next frame including the final finalizeFrame.
+        /// <param name="captureTime">frame time of the captured application in ms</param>
+        /// <returns>true if a frame was replayed, false at the end of the capture or for invalid data</returns>
+        public static bool replayFrame(out float captureTime)
+        {
+            return NativeMethodsEngine.h3dReplayFrame(out captureTime);
+        }
+
+        /// <summary>
+        /// Closes the capture file of a replay.
+        /// </summary>
+        public static void endReplay()
+        {
+            NativeMethodsEngine.h3dEndReplay();
+        }
+
         /// <summary>
         /// Checks whether GPU supports a certain feature.
         /// </summary>
@@ -1373,6 +1655,20 @@ public static void releaseUnusedResources()
             NativeMethodsEngine.h3dReleaseUnusedResources();
         }
 
+        /// <summary>
+        /// Gets the memory used by resources.
+        /// </summary>
+        /// This function sums up the memory used by all resources of the specified type, as returned by
+        /// the MemoryElem accessors of the single resources. Video memory is an estimate.
+        /// <param name="type">type of the resources or H3DResTypes.Undefined for all resources</param>
+        /// <param name="numResources">number of resources</param>
+        /// <param name="cpuMemory">used system memory in Mb</param>
+        /// <param name="gpuMemory">estimated used video memory in Mb</param>
+        public static void getResourceMemory(H3DResTypes type, out int numResources, out float cpuMemory, out float gpuMemory)
+        {
+            NativeMethodsEngine.h3dGetResourceMemory((int)type, out numResources, out cpuMemory, out gpuMemory);
+        }
+
         /// <summary>
         /// Adds a Texture2D resource.
         /// </summary>
@@ -1851,6 +2147,23 @@ public static bool getCastRayResult(int index, out int node, out float distance,
             return NativeMethodsEngine.h3dGetCastRayResult(index, out node, out distance, intersection);
         }
 
+        /// <summary>
+        /// Performs a batch of ray collision queries.
+        /// </summary>
+        /// <remarks>This function finds the closest intersection of each ray with the node and its children.
+        /// Nodes that have one of the H3DNodeFlags specified in flags set are ignored together with their children.
+        /// If H3DRayQueryFlags.AnyHit is specified, each query stops at the first intersection found.</remarks>
+        /// <param name="node">node at which intersection check is beginning</param>
+        /// <param name="rays">ray data (origin x, y, z and direction x, y, z per ray)</param>
+        /// <param name="count">number of rays</param>
+        /// <param name="hits">array of count elements receiving the result of each ray</param>
+        /// <param name="flags">combination of H3DNodeFlags and H3DRayQueryFlags</param>
+        /// <returns>number of rays that intersect a node</returns>
+        public static int castRays(int node, float[] rays, int count, H3DRayHit[] hits, int flags)
+        {
+            return NativeMethodsEngine.h3dCastRays(node, rays, count, hits, flags);
+        }
+
         /// <summary>
         /// Checks if a node is visible.
         /// </summary>
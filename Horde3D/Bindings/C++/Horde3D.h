@@ -66,12 +66,15 @@ struct H3DRenderDevice
 	/* Enum: H3DRenderDevice
 	The available engine Renderer backends.
 
+	Null				- use a backend that does not draw anything and requires no graphics context, e.g. for
+						  servers, tools and benchmarks; resources are loaded and scenes are processed as usual
 	OpenGL2				- use OpenGL 2 as renderer backend (can be used to force OpenGL 2 when higher version is undesirable)
 	OpenGL4				- use OpenGL 4 as renderer backend (falls back to OpenGL 2 in case of error)
 	OpenGLES3			- use OpenGL ES 3 as renderer backend
 	*/
 	enum List
 	{
+		Null = 1,
 		OpenGL2 = 2,
 		OpenGL4 = 4,
 		OpenGLES3 = 8
@@ -90,7 +93,8 @@ struct H3DOptions
 		TrilinearFiltering  - Enables or disables trilinear filtering for textures. (Values: 0, 1; Default: 1)
 		MaxAnisotropy       - Sets the maximum quality for anisotropic filtering. (Values: 1, 2, 4, 8, 16; Default: 1)
 		TexCompression      - Enables or disables texture compression; only affects textures that are
-		                      loaded after setting the option. (Values: 0, 1; Default: 0)
+		                      loaded after setting the option. Uncompressed 8 bit images are encoded to DXT1 or
+		                      DXT5 on the CPU if the device supports it. (Values: 0, 1; Default: 0)
 		SRGBLinearization   - Eanbles or disables gamma-to-linear-space conversion of input textures that are tagged as sRGB (Values: 0, 1; Default: 0)
 		LoadTextures        - Enables or disables loading of textures referenced by materials; this can be useful to reduce
 		                      loading times for testing. (Values: 0, 1; Default: 1)
@@ -106,6 +110,41 @@ struct H3DOptions
 		GatherTimeStats     - Enables or disables gathering of time stats that are useful for profiling (Values: 0, 1; Default: 1)
 		DebugRenderBackend  - Enables or disables logging of render backend diagnostic messages. May require additional actions on 
 							  application side, like creating a debug opengl context. (Values: 0, 1; Default: 0)
+		TexMipmapFilter     - Filter for generating mipmaps of uncompressed 8 bit images; 0 leaves mipmap generation
+		                      to the driver, 1 uses a gamma-correct box filter and 2 a gamma-correct Kaiser filter
+		                      on the CPU. Only affects textures that are loaded after setting the option.
+		                      (Values: 0, 1, 2; Default: 0)
+		TexStreamingBudget  - Video memory budget in Mb for streamed textures; 0 disables streaming. When enabled, 2D
+		                      textures with mipmaps that are loaded afterwards keep a copy of their mip chain in system
+		                      memory and only upload the levels required by their screen-space size. Setting the
+		                      budget to 0 again makes all levels of these textures resident. (Default: 0)
+		SoftwareOcclusion   - Enables or disables CPU occlusion culling; meshes with the Occluder flag are rasterized
+		                      into a low resolution depth buffer and objects of the camera view whose bounding box
+		                      is hidden behind them are not drawn. (Values: 0, 1; Default: 0)
+		ShadowMapCacheSize  - Number of lights whose shadow maps are kept in separate buffers; the shadow map of such a
+		                      light is only rendered again when the light, the camera or one of the shadow casters
+		                      changed, including changes of their geometry, material or shader resources. Each cached
+		                      light needs video memory for a shadow map of ShadowMapSize; 0 disables caching. (Default: 0)
+		RenderTargetAliasing - Enables or disables sharing of memory between pipeline render targets that are
+		                      not used at the same time and have the same size and format. Targets that are read
+		                      before they are written in a frame or whose first quad is drawn with blending keep
+		                      their own memory; lifetimes follow the enabled stages. The contents of shared
+		                      targets cannot be queried with h3dGetRenderTargetData after rendering; only affects
+		                      pipelines that are loaded or resized after setting the option. (Values: 0, 1; Default: 0)
+		CPUProfiler         - Enables or disables recording of CPU profiler zones, see h3dSaveProfilerTrace; fails
+		                      if the engine was built without the HORDE3D_PROFILER CMake option. (Values: 0, 1; Default: 0)
+		ResourceMemoryBudget - Memory budget in Mb for all resources, including the estimated video memory; a warning
+		                      is written to the log when a resource load exceeds it, see h3dGetResourceMemory.
+		                      (Default: 0 = no budget)
+		DiscardCPUCopies    - Frees the CPU copies of the tangent and static vertex streams after uploading Geometry
+		                      resources without joints and morph targets, which are not modified on the CPU by the
+		                      engine. Positions and indices are kept for ray queries and occlusion culling. The
+		                      discarded streams cannot be mapped anymore; only affects geometry that is loaded
+		                      after setting the option. (Values: 0, 1; Default: 0)
+		WorkerThreads       - Number of worker threads that run jobs of the engine and extensions, like ray
+		                      queries, light binning and texture processing; -1 uses one less than the number of
+		                      hardware threads and 0 runs all jobs on the calling thread. Changing the value waits
+		                      for running jobs. (Values: -1..64; Default: -1)
 	*/
 	enum List
 	{
@@ -123,7 +162,16 @@ struct H3DOptions
 		DebugViewMode,
 		DumpFailedShaders,
 		GatherTimeStats,
-		DebugRenderBackend
+		DebugRenderBackend,
+		TexMipmapFilter,
+		TexStreamingBudget,
+		SoftwareOcclusion,
+		ShadowMapCacheSize,
+		RenderTargetAliasing,
+		CPUProfiler,
+		ResourceMemoryBudget,
+		DiscardCPUCopies,
+		WorkerThreads
 	};
 };
 
@@ -146,6 +194,23 @@ struct H3DStats
 		TextureVMem       - Estimated amount of video memory used by textures (in Mb)
 		GeometryVMem      - Estimated amount of video memory used by geometry (in Mb),
 		ComputeGPUTime	  - GPU time in ms spent for processing compute shaders
+		CullingTime       - CPU time in ms spent for scene culling
+		TexStreamingPressure - Video memory requested by streamed textures divided by the streaming budget;
+		                       values above 1 mean that textures are displayed below their desired resolution
+		TexStreamingMem   - Video memory used by streamed textures (in Mb)
+		OcclusionCulledCount - Number of objects removed from the camera view by software occlusion culling
+		ShadowMapRenderCount - Number of shadow maps that were rendered; shadow maps reused from the cache are not counted
+		ShaderBindCount   - Number of shader program binds
+		MaterialBindCount - Number of materials that were applied for drawing
+		TextureBindCount  - Number of textures assigned to texture units
+		GeometryBindCount - Number of vertex and index buffer binds
+		UniformUploadCount - Number of shader uniform uploads
+		UniformUploadSize - Size of uploaded shader uniforms in bytes
+		BufferUploadSize  - Size of data uploaded to vertex, index and other GPU buffers in bytes
+		RenderTargetSwitchCount - Number of render target switches
+		OcclusionQueryCount - Number of hardware occlusion queries issued
+		OcclusionQueryCulledCount - Number of objects and lights skipped because of the result of an occlusion query
+		RenderViewObjectCount - Number of objects in the render queues of all render views (camera, lights and shadows)
 	*/
 	enum List
 	{
@@ -162,7 +227,23 @@ struct H3DStats
 		ParticleGPUTime,
 		TextureVMem,
 		GeometryVMem,
-		ComputeGPUTime
+		ComputeGPUTime,
+		CullingTime,
+		TexStreamingPressure,
+		TexStreamingMem,
+		OcclusionCulledCount,
+		ShadowMapRenderCount,
+		ShaderBindCount,
+		MaterialBindCount,
+		TextureBindCount,
+		GeometryBindCount,
+		UniformUploadCount,
+		UniformUploadSize,
+		BufferUploadSize,
+		RenderTargetSwitchCount,
+		OcclusionQueryCount,
+		OcclusionQueryCulledCount,
+		RenderViewObjectCount
 	};
 };
 
@@ -322,6 +403,23 @@ struct H3DFormats
 };
 
 
+struct H3DResMem
+{
+	/* Enum: H3DResMem
+			The memory accessors available for all resource types.
+		
+		MemoryElem   - Memory usage of the resource
+		CPUMemoryI   - Estimated system memory used by the resource data in bytes [read-only]
+		GPUMemoryI   - Estimated video memory used by the resource in bytes [read-only]
+	*/
+	enum List
+	{
+		MemoryElem = 100,
+		CPUMemoryI,
+		GPUMemoryI
+	};
+};
+
 struct H3DGeoRes
 {
 	/* Enum: H3DGeoRes
@@ -443,6 +541,8 @@ struct H3DTexRes
 		                  by the texture format with the exception that half-float is converted
 		                  to float. The first element in the data array corresponds to the lower
 		                  left corner.
+		TexResidentMipI - Finest mip level that is resident in video memory; always 0 for textures that are
+		                  not streamed [read-only]
 	*/
 	enum List
 	{
@@ -452,7 +552,8 @@ struct H3DTexRes
 		TexSliceCountI,
 		ImgWidthI,
 		ImgHeightI,
-		ImgPixelStream
+		ImgPixelStream,
+		TexResidentMipI
 	};
 };
 
@@ -579,13 +680,16 @@ struct H3DNodeFlags
 		NoRayQuery     - Excludes scene node from ray intersection queries
 		Inactive       - Deactivates scene node so that it is completely ignored
 		                 (combination of all flags above)
+		Occluder       - Mesh is rasterized as occluder when software occlusion culling is enabled; can be
+		                 combined with NoDraw for invisible low-poly occluder meshes
 	*/
 	enum List
 	{
 		NoDraw = 1,
 		NoCastShadow = 2,
 		NoRayQuery = 4,
-		Inactive = 7  // NoDraw | NoCastShadow | NoRayQuery
+		Inactive = 7,  // NoDraw | NoCastShadow | NoRayQuery
+		Occluder = 8
 	};
 };
 
@@ -830,6 +934,93 @@ struct H3DModelUpdateFlags
 	};
 };
 
+struct H3DRayQueryFlags
+{
+	/*	Enum: H3DRayQueryFlags
+			The available flags for h3dCastRays in addition to H3DNodeFlags.
+		
+		AnyHit  - Stop at the first intersection found instead of searching for the closest one;
+		          useful for visibility tests
+	*/
+	enum List
+	{
+		AnyHit = 0x10000
+	};
+};
+
+struct H3DRayHit
+{
+	/*	Struct: H3DRayHit
+			Result of a single ray in h3dCastRays.
+		
+		node          - handle of intersected node or 0 if the ray did not hit anything
+		distance      - distance from ray origin to intersection point
+		intersection  - coordinates of intersection point
+	*/
+	H3DNode  node;
+	float    distance;
+	float    intersection[3];
+};
+
+/*	Constants: Frame statistics limits
+	H3DMaxStatStages  - Maximum number of pipeline stages in H3DFrameStats
+	H3DMaxStatViews   - Maximum number of render views in H3DFrameStats
+*/
+const int H3DMaxStatStages = 32;
+const int H3DMaxStatViews = 64;
+
+struct H3DRenderCounters
+{
+	/*	Struct: H3DRenderCounters
+			Render work of a frame or a pipeline stage; see H3DStats for the meaning of the values.
+	*/
+	int  triCount;
+	int  batchCount;
+	int  lightPassCount;
+	int  shaderBinds;
+	int  materialBinds;
+	int  textureBinds;
+	int  geometryBinds;
+	int  uniformUploads;
+	int  uniformBytes;
+	int  bufferUploadBytes;
+	int  renderTargetSwitches;
+	int  occlusionQueries;
+	int  occlusionQueryCulled;
+};
+
+struct H3DStageStats
+{
+	/*	Struct: H3DStageStats
+			Render work of a pipeline stage in h3dGetFrameStats.
+		
+		name      - id of the stage, truncated to 31 characters
+		counters  - work done by the commands of the stage
+	*/
+	char               name[32];
+	H3DRenderCounters  counters;
+};
+
+struct H3DFrameStats
+{
+	/*	Struct: H3DFrameStats
+			Statistics of a complete frame returned by h3dGetFrameStats.
+		
+		counters          - work done during the frame
+		frameTime         - time in ms between the two last h3dFinalizeFrame calls
+		numStages         - number of valid entries in stages
+		stages            - work done by each pipeline stage; stages with the same id are merged
+		numViews          - number of valid entries in viewObjectCounts
+		viewObjectCounts  - number of objects in the render queue of each render view in creation order
+	*/
+	H3DRenderCounters  counters;
+	float              frameTime;
+	int                numStages;
+	H3DStageStats      stages[H3DMaxStatStages];
+	int                numViews;
+	int                viewObjectCounts[H3DMaxStatViews];
+};
+
 
 /* Group: Basic functions */
 /* Function: h3dGetVersionString
@@ -989,6 +1180,10 @@ H3D_API void h3dClear();
 
 	Details:
 		If 0 is provided as function pointer, the callback is deleted.
+		Messages can be written by any thread and are collected without locking, so the callback is not
+		invoked immediately: collected messages are passed to it on the calling thread of h3dFinalizeFrame
+		and h3dGetMessage, and when the internal message buffer is full. Messages that are written by the
+		callback itself are passed on with the next flush.
 
 	Parameters:
 		callaback  - function pointer to call
@@ -1043,6 +1238,44 @@ H3D_API float h3dGetOption( H3DOptions::List param );
 */
 H3D_API bool h3dSetOption( H3DOptions::List param, float value );
 
+/* Function: h3dSetCacheDirectory
+		Sets the directory used by the engine for on-disk caches.
+	
+	Details:
+		This function sets the directory where the engine stores data that is expensive to regenerate,
+		like textures that were processed by the CPU texture pipeline (see TexMipmapFilter and
+		TexCompression options) and linked shader programs if the render backend supports program
+		binaries. Cache entries are keyed by a hash of the source data and the processing settings, so
+		stale entries are never used. Shader programs are keyed by their final code including the
+		preambles, the render backend and the driver version. An empty string disables the caches.
+	
+	Parameters:
+		path  - path of an existing, writable directory
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dSetCacheDirectory( const char *path );
+
+/* Function: h3dUpdateShaderCache
+		Stores the programs of all loaded shaders in the cache.
+	
+	Details:
+		This function checks the cache entries of all shader combinations that were compiled so far and
+		stores the programs whose entries are missing or are rejected by the driver. It can be used to
+		fill and validate the cache offline, e.g. by an installer that loads all resources and
+		preloads the required shader combinations. The cache directory must be set before the shaders
+		are loaded. The number of programs loaded from the cache is reported in the log.
+	
+	Parameters:
+		none
+		
+	Returns:
+		number of stored programs (0 if the cache was complete) or -1 if no cache directory is set or
+		the render backend does not support program binaries
+*/
+H3D_API int h3dUpdateShaderCache();
+
 /* Function: h3dGetStat
 		Gets a statistic value of the engine.
 	
@@ -1059,6 +1292,130 @@ H3D_API bool h3dSetOption( H3DOptions::List param, float value );
 */
 H3D_API float h3dGetStat( H3DStats::List param, bool reset );
 
+/* Function: h3dGetFrameStats
+		Gets the render statistics of the last frame.
+	
+	Details:
+		This function fills a struct with the render statistics of the last frame that was completed by
+		h3dFinalizeFrame, including the work done by each pipeline stage and the number of objects in each
+		render view. It is intended for telemetry that samples the statistics every frame. The values are
+		independent of the values returned by h3dGetStat and are not affected by its reset flag.
+	
+	Parameters:
+		stats  - pointer to the struct that receives the statistics
+		
+	Returns:
+		true in case of success, otherwise false
+*/
+H3D_API bool h3dGetFrameStats( H3DFrameStats *stats );
+
+/* Function: h3dSaveProfilerTrace
+		Saves the zones recorded by the CPU profiler to a trace file.
+	
+	Details:
+		This function writes the CPU profiler zones of the last frames to a file in the Chrome trace event
+		format, which can be viewed with chrome://tracing or Perfetto. Zones cover the pipeline commands,
+		culling, scene updates, material setup and resource loading on all threads and are only recorded
+		while the CPUProfiler option is enabled. Each thread keeps a limited number of zones, so long frame
+		ranges may be incomplete. A frame ends with the call to h3dFinalizeFrame.
+	
+	Parameters:
+		fileName   - name of the trace file
+		numFrames  - number of completed frames that are saved
+		
+	Returns:
+		true if the file could be written, otherwise false
+*/
+H3D_API bool h3dSaveProfilerTrace( const char *fileName, int numFrames );
+
+/* Function: h3dBeginCapture
+		Starts recording API calls to a capture file.
+	
+	Details:
+		This function starts writing all API calls that change the engine state or cause work, like adding
+		and loading resources, changing nodes, ray casts and rendering, with their arguments into a compact
+		binary file. Resource data passed to h3dLoadResource or written to mapped streams is stored once per
+		unique data block. The capture can be replayed with h3dBeginReplay and h3dReplayFrame to reproduce
+		the frames of an application without the application itself.
+		
+		To reproduce a session exactly, the capture has to be started right after h3dInit, since the replay
+		starts from an empty engine. Calls of extensions, like the functions of the Terrain and Overlays
+		extensions, are not recorded, so the nodes and overlays created by them are missing in a replay.
+		The recording is stopped with h3dEndCapture or h3dRelease. Fails if the engine was built without the HORDE3D_API_CAPTURE CMake
+		option or a replay is in progress.
+	
+	Parameters:
+		fileName  - name of the capture file
+		
+	Returns:
+		true if the capture file could be created, otherwise false
+*/
+H3D_API bool h3dBeginCapture( const char *fileName );
+
+/* Function: h3dEndCapture
+		Stops recording API calls.
+	
+	Details:
+		This function finishes and closes the capture file started with h3dBeginCapture.
+	
+	Parameters:
+		none
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dEndCapture();
+
+/* Function: h3dBeginReplay
+		Opens a capture file for replaying it.
+	
+	Details:
+		This function loads a capture file recorded with h3dBeginCapture into memory. The engine should be
+		freshly initialized, so that the replayed calls create the same handles as in the captured session.
+		The replay works with every render device; using H3DRenderDevice::Null allows comparing the CPU
+		side of the engine without a graphics context.
+	
+	Parameters:
+		fileName  - name of the capture file
+		
+	Returns:
+		true if the file could be opened and has a valid header, otherwise false
+*/
+H3D_API bool h3dBeginReplay( const char *fileName );
+
+/* Function: h3dReplayFrame
+		Replays the next frame of a capture.
+	
+	Details:
+		This function executes the recorded calls of the next frame including the final h3dFinalizeFrame.
+		The application can measure the time of the call and do its own per-frame work afterwards, e.g.
+		swapping the buffers. Handles that differ from the captured ones are reported as warnings, since
+		the replay diverged from the capture in that case.
+	
+	Parameters:
+		captureTime  - pointer to variable that receives the frame time of the captured application in ms,
+		               measured between the calls to h3dFinalizeFrame (can be NULL)
+		
+	Returns:
+		true if a frame was replayed, false at the end of the capture or for invalid data
+*/
+H3D_API bool h3dReplayFrame( float *captureTime );
+
+/* Function: h3dEndReplay
+		Closes the capture file of a replay.
+	
+	Details:
+		This function releases the capture data loaded by h3dBeginReplay. The engine state created by the
+		replayed calls is kept.
+	
+	Parameters:
+		none
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dEndReplay();
+
 /* Function: h3dGetDeviceCapabilities
 		Checks whether GPU supports a certain feature.
 
@@ -1469,6 +1826,26 @@ H3D_API H3DRes h3dQueryUnloadedResource( int index );
 */
 H3D_API void h3dReleaseUnusedResources();
 
+/* Function: h3dGetResourceMemory
+		Gets the memory used by resources.
+	
+	Details:
+		This function sums up the memory used by all resources of the specified type, as returned by
+		the MemoryElem accessors of the single resources. Video memory is an estimate based on the size
+		of the uploaded data. Resources created internally, e.g. geometry cloned for software skinning,
+		are included.
+	
+	Parameters:
+		type          - type of the resources or H3DResTypes::Undefined for all resources
+		numResources  - pointer to variable receiving the number of resources (can be NULL)
+		cpuMemory     - pointer to variable receiving the used system memory in Mb (can be NULL)
+		gpuMemory     - pointer to variable receiving the estimated used video memory in Mb (can be NULL)
+		
+	Returns:
+		nothing
+*/
+H3D_API void h3dGetResourceMemory( int type, int *numResources, float *cpuMemory, float *gpuMemory );
+
 
 /* Group: Specific resource management functions */
 /* Function: h3dCreateTexture
@@ -2020,6 +2397,34 @@ H3D_API int h3dCastRay( H3DNode node, float ox, float oy, float oz, float dx, fl
 */
 H3D_API bool h3dGetCastRayResult( int index, H3DNode *node, float *distance, float *intersection );
 
+/*	Function: h3dCastRays
+		Performs a batch of ray collision queries.
+	
+	Details:
+		This function finds the closest intersection of each of the specified rays with the node and its
+		children. Like for h3dCastRay, each ray is a line segment given by an origin and a direction vector
+		that also defines its length. Rays are tested against the bounding boxes of the nodes before the
+		nodes themselves are checked. Batches of rays are distributed over the worker threads of the engine
+		(see H3DOptions::WorkerThreads) and the calling thread; no threads are created by the call. In contrast
+		to h3dCastRay, the results are written directly to the output array and do not replace the results
+		of a previous h3dCastRay call.
+		
+		Nodes that have one of the H3DNodeFlags specified in flags set are ignored together with their
+		children, in the same way as nodes with the NoRayQuery flag. If H3DRayQueryFlags::AnyHit is specified,
+		each query stops at the first intersection found, which is not necessarily the closest one.
+	
+	Parameters:
+		node   - node at which intersection check is beginning
+		rays   - ray data (origin x, y, z and direction x, y, z per ray)
+		count  - number of rays
+		hits   - array of count elements receiving the result of each ray
+		flags  - combination of H3DNodeFlags and H3DRayQueryFlags
+		
+	Returns:
+		number of rays that intersect a node
+*/
+H3D_API int h3dCastRays( H3DNode node, const float *rays, int count, H3DRayHit *hits, int flags );
+
 /*	Function: h3dCheckNodeVisibility
 		Checks if a node is visible.
 
@@ -48,8 +48,9 @@ inline void fwrite_le(const T* data, size_t count, FILE* f)
     }
 }
 
-Converter::Converter( ColladaDocument &doc, const string &outPath, const float *lodDists ) :
-	_daeDoc( doc )
+Converter::Converter( ColladaDocument &doc, const string &outPath, const float *lodDists,
+                      const LodGenSettings &lodGen ) :
+	_daeDoc( doc ), _lodGen( lodGen )
 {
 	_outPath = outPath;
 	
@@ -70,7 +71,7 @@ Converter::~Converter()
 }
 
 
-bool Converter::convertModel( bool optimize )
+bool Converter::convertModel( bool optimize, bool optimizeOverdraw, float weldTolerance )
 {
 	if( _daeDoc.scene == 0x0 ) return true;		// Nothing to convert
 	
@@ -93,7 +94,7 @@ bool Converter::convertModel( bool optimize )
 
 	// Process joints and meshes
 	processJoints();
-	processMeshes( optimize );
+	processMeshes( optimize, optimizeOverdraw, weldTolerance );
 	
 	return true;
 }
@@ -415,16 +416,16 @@ void Converter::calcTangentSpaceBasis( vector<Vertex> &verts ) const
 					verts[_indices[k + l]].bitangent += vDir;
 
 					// Handle texture seams where vertices were split
-					vector< unsigned int > &vertList =
-						triGroup->posIndexToVertices[verts[_indices[k + l]].daePosIndex];
-					for( unsigned int m = 0; m < vertList.size(); ++m )
+					const vector< unsigned int > &ring = triGroup->posIndexRing;
+					unsigned int vertIndex = _indices[k + l];
+					for( unsigned int m = triGroup->vertRStart + ring[vertIndex - triGroup->vertRStart];
+					     m != vertIndex; m = triGroup->vertRStart + ring[m - triGroup->vertRStart] )
 					{
-						if( vertList[m] != _indices[k + l] &&
-						    verts[vertList[m]].storedNormal == verts[_indices[k + l]].storedNormal )
+						if( verts[m].storedNormal == verts[vertIndex].storedNormal )
 						{
-							verts[vertList[m]].normal += normal;
-							verts[vertList[m]].tangent += uDir;
-							verts[vertList[m]].bitangent += vDir;
+							verts[m].normal += normal;
+							verts[m].tangent += uDir;
+							verts[m].bitangent += vDir;
 						}
 					}
 				}
@@ -473,7 +474,7 @@ void Converter::processJoints()
 }
 
 
-void Converter::processMeshes( bool optimize )
+void Converter::processMeshes( bool optimize, bool optimizeOverdraw, float weldTolerance )
 {
 	// Note: At the moment the geometry for all nodes is copied and not referenced
 	for( unsigned int i = 0; i < _meshes.size(); ++i )
@@ -592,50 +593,42 @@ void Converter::processMeshes( bool optimize )
 			oTriGroup->count = (unsigned int)iTriGroup.indices.size();
 			oTriGroup->vertRStart = (unsigned int)_vertices.size();
 
-			// Add indices and vertices
-			oTriGroup->numPosIndices = (unsigned int)iTriGroup.vSource->posSource->floatArray.size() /
-			                          iTriGroup.vSource->posSource->paramsPerItem;
-			oTriGroup->posIndexToVertices = new vector< unsigned int >[oTriGroup->numPosIndices];
+			// Add indices and vertices; skinning and morphing data is assigned by Collada position index,
+			// so vertices of such meshes are only welded if they share that index
+			unsigned int attribMask = iTriGroup.normSource != 0x0 ? VertexWelder::Normal : 0;
+			for( unsigned int k = 0; k < 4; ++k )
+			{
+				if( iTriGroup.texSource[k] != 0x0 ) attribMask |= VertexWelder::TexCoords0 << k;
+			}
+			
+			VertexWelder welder( weldTolerance, skin != 0x0 || morpher != 0x0, attribMask );
+			// Usually each position results in at least one vertex
+			welder.reserve( std::min( (unsigned int)iTriGroup.vSource->posSource->floatArray.size() /
+			                          iTriGroup.vSource->posSource->paramsPerItem, (unsigned int)iTriGroup.indices.size() ) );
 			
 			for( unsigned int k = 0; k < iTriGroup.indices.size(); ++k )
 			{
-				// Try to find vertex
-				vector< unsigned int > &vertList = oTriGroup->posIndexToVertices[iTriGroup.indices[k].posIndex];
-				bool found = false;
-				unsigned int index = (unsigned int)_vertices.size();
+				const IndexEntry &indexEntry = iTriGroup.indices[k];
+				Vertex v;
 				
-				// Only check vertices that have the same Collada position index
-				for( unsigned int l = 0; l < vertList.size(); ++l )
-				{
-					Vertex &v = _vertices[vertList[l]];
-					
-					if( v.storedPos == iTriGroup.getPos( iTriGroup.indices[k].posIndex ) &&
-						v.storedNormal == iTriGroup.getNormal( iTriGroup.indices[k].normIndex ) &&
-						v.texCoords[0] == iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[0], 0 ) &&
-						v.texCoords[1] == iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[1], 1 ) &&
-						v.texCoords[2] == iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[2], 2 ) &&
-						v.texCoords[3] == iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[3], 3 ) )
-	
-					{
-						found = true;
-						index = vertList[l];
-						break;
-					}
-				}
+				v.daePosIndex = indexEntry.posIndex;
+				v.storedPos = iTriGroup.getPos( v.daePosIndex );
+				v.storedNormal = iTriGroup.getNormal( indexEntry.normIndex );
+				v.texCoords[0] = iTriGroup.getTexCoords( indexEntry.texIndex[0], 0 );
+				v.texCoords[1] = iTriGroup.getTexCoords( indexEntry.texIndex[1], 1 );
+				v.texCoords[2] = iTriGroup.getTexCoords( indexEntry.texIndex[2], 2 );
+				v.texCoords[3] = iTriGroup.getTexCoords( indexEntry.texIndex[3], 3 );
+				
+				// Try to find vertex
+				unsigned int index = welder.weld( v, (unsigned int)_vertices.size() );
 
-				if( found )
+				if( index != (unsigned int)_vertices.size() )
 				{
 					_indices.push_back( index );	
 				}
 				else
 				{
-					Vertex v;
-
-					v.daePosIndex = iTriGroup.indices[k].posIndex;
-					int normIndex = iTriGroup.indices[k].normIndex;
-
 					// Position
-					v.storedPos = iTriGroup.getPos( v.daePosIndex );
 					v.pos = v.storedPos;
 					if( !_daeDoc.y_up )
 					{	
@@ -643,15 +636,6 @@ void Converter::processMeshes( bool optimize )
 						v.pos.z *= -1;
 					}
 
-					// Texture coordinates
-					v.texCoords[0] = iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[0], 0 );
-					v.texCoords[1] = iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[1], 1 );
-					v.texCoords[2] = iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[2], 2 );
-					v.texCoords[3] = iTriGroup.getTexCoords( iTriGroup.indices[k].texIndex[3], 3 );
-
-					// Normal
-					v.storedNormal = iTriGroup.getNormal( normIndex );
-
 					// Skinning
 					if( skin != 0x0 && v.daePosIndex < (int)skin->vertWeights.size() )
 					{
@@ -711,12 +695,25 @@ void Converter::processMeshes( bool optimize )
 					
 					_vertices.push_back( v );
 					_indices.push_back( index );
-
-					vertList.push_back( (unsigned int)_vertices.size() - 1 );
 				}
 			}
 
 			oTriGroup->vertREnd = (unsigned int)_vertices.size() - 1;
+
+			// Link vertices with the same position index to rings by sorting them by that index
+			unsigned int numGroupVerts = (unsigned int)_vertices.size() - oTriGroup->vertRStart;
+			vector< unsigned long long > posOrder( numGroupVerts );
+			for( unsigned int k = 0; k < numGroupVerts; ++k )
+				posOrder[k] = ((unsigned long long)_vertices[oTriGroup->vertRStart + k].daePosIndex << 32) | k;
+			sort( posOrder.begin(), posOrder.end() );
+
+			oTriGroup->posIndexRing.resize( numGroupVerts );
+			for( unsigned int k = 0, first = 0; k < numGroupVerts; ++k )
+			{
+				bool last = k + 1 == numGroupVerts || (posOrder[k + 1] >> 32) != (posOrder[k] >> 32);
+				oTriGroup->posIndexRing[(unsigned int)posOrder[k]] = (unsigned int)posOrder[last ? first : k + 1];
+				if( last ) first = k + 1;
+			}
 			
 			// Remove degenerated triangles
 			unsigned int numDegTris = MeshOptimizer::removeDegeneratedTriangles( oTriGroup, _vertices, _indices );
@@ -843,54 +840,178 @@ void Converter::processMeshes( bool optimize )
 		}
 	}
 
+	// Seam information is not required anymore
+	for( unsigned int i = 0; i < _meshes.size(); ++i )
+	{
+		for( unsigned int j = 0; j < _meshes[i]->triGroups.size(); ++j )
+			vector< unsigned int >().swap( _meshes[i]->triGroups[j]->posIndexRing );
+	}
+
+	// Generate simplified LOD meshes
+	generateLods();
+
 	// Optimization and clean up
 	float optEffBefore = 0, optEffAfter = 0;
-	unsigned int optNumCalls = 0;
+	unsigned int optNumTris = 0;
 	for( unsigned int i = 0; i < _meshes.size(); ++i )
 	{
 		for( unsigned int j = 0; j < _meshes[i]->triGroups.size(); ++j )
 		{
+			TriGroup *triGroup = _meshes[i]->triGroups[j];
+			
 			// Optimize order of indices for best vertex cache usage and remap vertices
-			if( optimize )
+			if( optimize && triGroup->count > 0 )
 			{
-				map< unsigned int, unsigned int > vertMap;
+				vector< unsigned int > vertMap;
+				unsigned int numTris = triGroup->count / 3;
 				
-				++optNumCalls;
-				optEffBefore += MeshOptimizer::calcCacheEfficiency( _meshes[i]->triGroups[j], _indices );
-				MeshOptimizer::optimizeIndexOrder( _meshes[i]->triGroups[j], _vertices, _indices, vertMap );
-				optEffAfter += MeshOptimizer::calcCacheEfficiency( _meshes[i]->triGroups[j], _indices );
+				optNumTris += numTris;
+				optEffBefore += MeshOptimizer::calcCacheEfficiency( triGroup, _indices ) * numTris;
+				MeshOptimizer::optimizeIndexOrder( triGroup, _indices );
+				if( optimizeOverdraw ) MeshOptimizer::optimizeOverdraw( triGroup, _vertices, _indices );
+				optEffAfter += MeshOptimizer::calcCacheEfficiency( triGroup, _indices ) * numTris;
+				MeshOptimizer::optimizeVertexFetch( triGroup, _vertices, _indices, vertMap );
 
 				// Update morph target vertex indices according to vertex remapping
 				for( unsigned int k = 0; k < _morphTargets.size(); ++k )
 				{
 					for( unsigned int l = 0; l < _morphTargets[k].diffs.size(); ++l )
 					{
-						map< unsigned int, unsigned int >::iterator itr1 =
-							vertMap.find( _morphTargets[k].diffs[l].vertIndex );
-
-						if( itr1 != vertMap.end() )
+						unsigned int &vertIndex = _morphTargets[k].diffs[l].vertIndex;
+						
+						if( vertIndex >= triGroup->vertRStart && vertIndex <= triGroup->vertREnd &&
+						    vertMap[vertIndex - triGroup->vertRStart] != (unsigned int)-1 )
 						{
-							_morphTargets[k].diffs[l].vertIndex = itr1->second;
+							vertIndex = vertMap[vertIndex - triGroup->vertRStart];
 						}
 					}
 				}
 			}
-			
-			// Clean up
-			delete[] _meshes[i]->triGroups[j]->posIndexToVertices;
-			_meshes[i]->triGroups[j]->posIndexToVertices = 0x0;
 		}
 	}
 
 	// Output info about optimization
-	/*if( optNumCalls > 0 )
+	if( optNumTris > 0 )
 	{
 		stringstream ss;
 		ss << fixed << setprecision( 3 );
-		ss << "Optimized geometry for vertex cache: from ATVR " << optEffBefore / optNumCalls;
-		ss << " to ATVR " << optEffAfter / optNumCalls;
+		ss << "Optimized geometry for vertex cache: from ACMR " << optEffBefore / optNumTris;
+		ss << " to ACMR " << optEffAfter / optNumTris;
 		log( ss.str() );
-	}*/
+	}
+}
+
+
+void Converter::generateLods()
+{
+	if( _lodGen.numLevels == 0 ) return;
+	
+	if( _maxLodLevel > 0 )
+	{
+		log( "Skipping LOD generation since model already has LOD meshes" );
+		return;
+	}
+
+	unsigned int numLevels = std::min( _lodGen.numLevels, 4u );
+	unsigned int baseTriCount = 0, lodTriCounts[4] = { 0, 0, 0, 0 };
+	float lodErrors[4] = { 0, 0, 0, 0 };
+	
+	size_t numBaseMeshes = _meshes.size();
+	for( size_t i = 0; i < numBaseMeshes; ++i )
+	{
+		Mesh *baseMesh = _meshes[i];
+
+		for( unsigned int j = 0; j < baseMesh->triGroups.size(); ++j )
+			baseTriCount += baseMesh->triGroups[j]->count / 3;
+		
+		for( unsigned int level = 1; level <= numLevels; ++level )
+		{
+			// LOD meshes share name and transformation with base mesh; animation is applied by name
+			Mesh *lodMesh = new Mesh();
+			strcpy( lodMesh->name, baseMesh->name );
+			lodMesh->daeNode = baseMesh->daeNode;
+			lodMesh->daeInstance = baseMesh->daeInstance;
+			lodMesh->parent = baseMesh->parent;
+			lodMesh->matRel = baseMesh->matRel;
+			lodMesh->matAbs = baseMesh->matAbs;
+			lodMesh->lodLevel = level;
+			
+			for( unsigned int j = 0; j < baseMesh->triGroups.size(); ++j )
+			{
+				TriGroup *baseGroup = baseMesh->triGroups[j];
+				TriGroup *lodGroup = new TriGroup();
+				lodGroup->matName = baseGroup->matName;
+				
+				unsigned int targetCount = (unsigned int)(baseGroup->count * _lodGen.ratios[level - 1]) / 3 * 3;
+				vector< unsigned int > lodIndices;
+				float error = MeshSimplifier::simplify( _vertices, baseGroup, _indices, targetCount,
+				                                        _lodGen.maxError, lodIndices );
+				if( lodIndices.empty() )
+				{
+					lodIndices.assign( _indices.begin() + baseGroup->first,
+					                   _indices.begin() + baseGroup->first + baseGroup->count );
+				}
+				lodErrors[level - 1] = std::max( lodErrors[level - 1], error );
+
+				// Copy referenced vertices so that LOD can be optimized independently of base mesh
+				vector< unsigned int > vertMap( baseGroup->vertREnd - baseGroup->vertRStart + 1, (unsigned int)-1 );
+				lodGroup->first = (unsigned int)_indices.size();
+				lodGroup->count = (unsigned int)lodIndices.size();
+				lodGroup->vertRStart = (unsigned int)_vertices.size();
+				
+				for( size_t k = 0; k < lodIndices.size(); ++k )
+				{
+					unsigned int &newIndex = vertMap[lodIndices[k] - baseGroup->vertRStart];
+					if( newIndex == (unsigned int)-1 )
+					{
+						newIndex = (unsigned int)_vertices.size();
+						Vertex v = _vertices[lodIndices[k]];
+						_vertices.push_back( v );
+					}
+					_indices.push_back( newIndex );
+				}
+				lodGroup->vertREnd = (unsigned int)_vertices.size() - 1;
+
+				// Duplicate morph target differences of copied vertices
+				for( unsigned int k = 0; k < _morphTargets.size(); ++k )
+				{
+					vector< MorphDiff > &diffs = _morphTargets[k].diffs;
+					for( size_t l = 0, s = diffs.size(); l < s; ++l )
+					{
+						if( diffs[l].vertIndex < baseGroup->vertRStart || diffs[l].vertIndex > baseGroup->vertREnd )
+							continue;
+						
+						unsigned int newIndex = vertMap[diffs[l].vertIndex - baseGroup->vertRStart];
+						if( newIndex == (unsigned int)-1 ) continue;
+						
+						MorphDiff md = diffs[l];
+						md.vertIndex = newIndex;
+						diffs.push_back( md );
+					}
+				}
+
+				lodTriCounts[level - 1] += lodGroup->count / 3;
+				lodMesh->triGroups.push_back( lodGroup );
+			}
+
+			_meshes.push_back( lodMesh );
+			if( lodMesh->parent != 0x0 ) lodMesh->parent->children.push_back( lodMesh );
+		}
+	}
+
+	_maxLodLevel = numLevels;
+
+	// Output info about generated LODs
+	for( unsigned int i = 0; i < numLevels; ++i )
+	{
+		stringstream ss;
+		ss << fixed << setprecision( 1 );
+		ss << "Generated LOD" << i + 1 << ": " << lodTriCounts[i] << " of " << baseTriCount << " triangles (";
+		ss << (baseTriCount > 0 ? 100.0f * lodTriCounts[i] / baseTriCount : 0.0f) << "%), ";
+		ss << baseTriCount - lodTriCounts[i] << " triangles saved, ";
+		ss << setprecision( 4 ) << "max error " << lodErrors[i];
+		log( ss.str() );
+	}
 }
 
 
@@ -47,14 +47,9 @@ struct TriGroup
 	unsigned int  vertRStart, vertREnd;
 	std::string   matName;
 
-	unsigned int                 numPosIndices;
-	std::vector< unsigned int >  *posIndexToVertices;
-
-	TriGroup() : posIndexToVertices( 0x0 )
-	{
-	}
-
-	~TriGroup() { delete[] posIndexToVertices; }
+	// Vertices of the group with the same Collada position index are linked to a ring;
+	// indexed by vertex index - vertRStart and only available while processing meshes
+	std::vector< unsigned int >  posIndexRing;
 };
 
 
@@ -140,13 +135,28 @@ struct MorphTarget
 };
 
 
+struct LodGenSettings
+{
+	unsigned int  numLevels;  // Number of LOD levels generated by simplification; 0 disables generation
+	float         ratios[4];  // Target triangle count of each LOD level relative to base mesh
+	float         maxError;   // Maximum simplification error relative to mesh extent
+
+	LodGenSettings() : numLevels( 0 ), maxError( 0.05f )
+	{
+		ratios[0] = 0.5f; ratios[1] = 0.25f; ratios[2] = 0.125f; ratios[3] = 0.0625f;
+	}
+};
+
+
 class Converter
 {
 public:
-	Converter( ColladaDocument &doc, const std::string &outPath, const float *lodDists );
+	Converter( ColladaDocument &doc, const std::string &outPath, const float *lodDists,
+	           const LodGenSettings &lodGen = LodGenSettings() );
 	~Converter();
 	
-	bool convertModel( bool optimize );
+	// Vertices whose attributes are in the same cell of a grid with the weld tolerance as spacing are merged
+	bool convertModel( bool optimize, bool optimizeOverdraw = false, float weldTolerance = 0 );
 	
 	bool writeModel( const std::string &assetPath, const std::string &assetName, const std::string &modelName ) const;
 	bool writeMaterials( const std::string &assetPath, const std::string &modelName, bool replace ) const;
@@ -162,7 +172,8 @@ private:
 	                        Matrix4f transAccum, std::vector< Matrix4f > animTransAccum );
 	void calcTangentSpaceBasis( std::vector< Vertex > &vertices ) const;
 	void processJoints();
-	void processMeshes( bool optimize );
+	void processMeshes( bool optimize, bool optimizeOverdraw, float weldTolerance );
+	void generateLods();
 	bool writeGeometry( const std::string &assetPath, const std::string &assetName ) const;
 	void writeSGNode( const std::string &assetPath, const std::string &modelName, SceneNode *node, unsigned int depth, std::ofstream &outf ) const;
 	bool writeSceneGraph( const std::string &assetPath, const std::string &assetName, const std::string &modelName ) const;
@@ -180,6 +191,7 @@ private:
 
 	std::string                  _outPath;
 	float                        _lodDist1, _lodDist2, _lodDist3, _lodDist4;
+	LodGenSettings               _lodGen;
 	unsigned int                 _frameCount;
 	unsigned int                 _maxLodLevel;
 	bool                         _animNotSampled;
@@ -17,11 +17,35 @@
 #include "utils.h"
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 namespace Horde3D {
 namespace ColladaConverter {
 
 
+// Hash map from IDs to library elements, so that references can be resolved without linear search.
+// Like a linear search, the index returns the first element added for an ID.
+template< class T > struct DaeIdIndex
+{
+	std::unordered_map< std::string, T * >  elements;
+
+
+	void add( T *element )
+	{
+		if( !element->id.empty() ) elements.insert( std::make_pair( element->id, element ) );
+	}
+
+
+	T *find( const std::string &id ) const
+	{
+		if( id.empty() ) return 0x0;
+
+		typename std::unordered_map< std::string, T * >::const_iterator itr = elements.find( id );
+		return itr != elements.end() ? itr->second : 0x0;
+	}
+};
+
+
 struct DaeSource
 {
 	std::string                 id;
@@ -68,19 +92,15 @@ struct DaeSource
 			if( str == 0x0 ) return false;
 			
 			if( isFloatArray )
-				floatArray.reserve( count );
+			{
+				// Missing values are zero
+				floatArray.resize( count, 0.0f );
+				parseFloatArray( str, &floatArray[0], (unsigned int)count );
+			}
 			else
-				stringArray.reserve( count );
-			
-			for( int i = 0; i < count; ++i )
 			{
-				if( isFloatArray )
-				{
-					float f;
-					parseFloat( str, f );
-					floatArray.push_back( f );
-				}
-				else
+				stringArray.reserve( count );
+				for( int i = 0; i < count; ++i )
 				{
 					parseString( str, name );
 					stringArray.push_back( name );
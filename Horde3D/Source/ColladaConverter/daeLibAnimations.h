@@ -19,6 +19,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
 
 namespace Horde3D {
 namespace ColladaConverter {
@@ -50,6 +51,17 @@ struct DaeAnimation
 	std::vector< DaeAnimation * >  children;
 
 
+	// Adds all channels including those of child animations in search order to the map
+	void indexChannels( std::unordered_map< std::string, DaeChannel * > &channelMap )
+	{
+		for( unsigned int i = 0; i < channels.size(); ++i )
+			channelMap.insert( std::make_pair( channels[i].nodeId + "/" + channels[i].transSid, &channels[i] ) );
+
+		for( unsigned int i = 0; i < children.size(); ++i )
+			children[i]->indexChannels( channelMap );
+	}
+
+
 	~DaeAnimation()
 	{
 		for( unsigned int i = 0; i < children.size(); ++i ) delete children[i];
@@ -251,6 +263,9 @@ struct DaeLibAnimations
 	std::vector< DaeAnimation * >  animations;
 	unsigned int                   maxFrameCount;
 	float                          maxAnimTime;
+
+	// Channels by target node ID and transformation SID, separated by a slash
+	std::unordered_map< std::string, DaeChannel * >  channelIndex;
 	
 
 	~DaeLibAnimations()
@@ -261,13 +276,14 @@ struct DaeLibAnimations
 
 	DaeSampler *findAnimForTarget( const std::string &nodeId, std::string const &transSid, int *index ) const
 	{
-		for( unsigned int i = 0; i < animations.size(); ++i )
-		{
-			DaeSampler *sampler = animations[i]->findAnimForTarget( nodeId, transSid, index );
-			if( sampler != 0x0 ) return sampler;
-		}
+		if( nodeId == "" || transSid == "" ) return 0x0;
 
-		return 0x0;
+		// Node IDs cannot contain a slash since it separates the node in channel targets
+		std::unordered_map< std::string, DaeChannel * >::const_iterator itr = channelIndex.find( nodeId + "/" + transSid );
+		if( itr == channelIndex.end() ) return 0x0;
+
+		if( index != 0x0 ) *index = itr->second->transValuesIndex;
+		return itr->second->source;
 	}
 
 	
@@ -287,6 +303,9 @@ struct DaeLibAnimations
 
 			node2 = node2.getNextSibling( "animation" );
 		}
+
+		for( unsigned int i = 0; i < animations.size(); ++i )
+			animations[i]->indexChannels( channelIndex );
 		
 		return true;
 	}
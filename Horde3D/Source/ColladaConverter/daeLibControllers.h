@@ -14,6 +14,7 @@
 #define _daeLibControllers_H_
 
 #include "utXML.h"
+#include "daeCommon.h"
 #include <string>
 #include <vector>
 
@@ -80,12 +81,7 @@ struct DaeSkin
 
 		char *str = (char *)node2.getText();
 		if( str == 0x0 ) return false;
-		for( int i = 0; i < 16; ++i )
-		{
-			float f;
-			parseFloat( str, f );
-			bindShapeMat[i] = f;
-		}
+		parseFloatArray( str, bindShapeMat, 16 );
 		
 		// Sources
 		node2 = node1.getFirstChild( "source" );
@@ -275,6 +271,8 @@ struct DaeLibControllers
 {
 	std::vector< DaeSkin * >   skinControllers;
 	std::vector< DaeMorph * >  morphControllers;
+	DaeIdIndex< DaeSkin >      skinIndex;
+	DaeIdIndex< DaeMorph >     morphIndex;
 
 
 	~DaeLibControllers()
@@ -286,27 +284,13 @@ struct DaeLibControllers
 	
 	DaeSkin *findSkin( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < skinControllers.size(); ++i )
-		{
-			if( skinControllers[i]->id == id ) return skinControllers[i];
-		}
-		
-		return 0x0;
+		return skinIndex.find( id );
 	}
 
 
 	DaeMorph *findMorph( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < morphControllers.size(); ++i )
-		{
-			if( morphControllers[i]->id == id ) return morphControllers[i];
-		}
-		
-		return 0x0;
+		return morphIndex.find( id );
 	}
 	
 	
@@ -323,7 +307,11 @@ struct DaeLibControllers
 			if( !node3.isEmpty() )
 			{
 				DaeSkin *skin = new DaeSkin();
-				if( skin->parse( node2 ) ) skinControllers.push_back( skin );
+				if( skin->parse( node2 ) )
+				{
+					skinControllers.push_back( skin );
+					skinIndex.add( skin );
+				}
 				else delete skin;
 			}
 
@@ -332,7 +320,11 @@ struct DaeLibControllers
 			if( !node3.isEmpty() )
 			{
 				DaeMorph *morph = new DaeMorph();
-				if( morph->parse( node2 ) ) morphControllers.push_back( morph );
+				if( morph->parse( node2 ) )
+				{
+					morphControllers.push_back( morph );
+					morphIndex.add( morph );
+				}
 				else delete morph;
 			}
 
@@ -156,6 +156,7 @@ struct DaeEffect
 struct DaeLibEffects
 {
 	std::vector< DaeEffect * >  effects;
+	DaeIdIndex< DaeEffect >     index;
 
 	
 	~DaeLibEffects()
@@ -166,14 +167,7 @@ struct DaeLibEffects
 
 	DaeEffect *findEffect( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < effects.size(); ++i )
-		{
-			if( effects[i]->id == id ) return effects[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 
 
@@ -186,7 +180,11 @@ struct DaeLibEffects
 		while( !node2.isEmpty() )
 		{
 			DaeEffect *effect = new DaeEffect();
-			if( effect->parse( node2 ) ) effects.push_back( effect );
+			if( effect->parse( node2 ) )
+			{
+				effects.push_back( effect );
+				index.add( effect );
+			}
 			else delete effect;
 
 			node2 = node2.getNextSibling( "effect" );
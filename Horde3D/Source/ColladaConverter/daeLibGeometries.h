@@ -431,6 +431,7 @@ struct DaeLibGeometries
 public:
 
 	std::vector< DaeGeometry* >  geometries;
+	DaeIdIndex< DaeGeometry >    index;
 
 	
 	~DaeLibGeometries()
@@ -441,14 +442,7 @@ public:
 
 	DaeGeometry *findGeometry( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < geometries.size(); ++i )
-		{
-			if( geometries[i]->id == id ) return geometries[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 	
 	
@@ -461,7 +455,11 @@ public:
 		while( !node2.isEmpty() )
 		{
 			DaeGeometry *geometry = new DaeGeometry();
-			if( geometry->parse( node2 ) ) geometries.push_back( geometry );
+			if( geometry->parse( node2 ) )
+			{
+				geometries.push_back( geometry );
+				index.add( geometry );
+			}
 			else delete geometry;
 
 			node2 = node2.getNextSibling( "geometry" );
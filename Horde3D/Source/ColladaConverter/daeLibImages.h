@@ -14,6 +14,7 @@
 #define _daeLibImages_H_
 
 #include "utXML.h"
+#include "daeCommon.h"
 #include <string>
 #include <vector>
 
@@ -56,6 +57,7 @@ struct DaeImage
 struct DaeLibImages
 {
 	std::vector< DaeImage * >	images;
+	DaeIdIndex< DaeImage >      index;
 
 
 	~DaeLibImages()
@@ -66,14 +68,7 @@ struct DaeLibImages
 
 	DaeImage *findImage( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < images.size(); ++i )
-		{
-			if( images[i]->id == id ) return images[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 
 	
@@ -86,7 +81,11 @@ struct DaeLibImages
 		while( !node2.isEmpty() )
 		{
 			DaeImage *image = new DaeImage();
-			if( image->parse( node2 ) ) images.push_back( image );
+			if( image->parse( node2 ) )
+			{
+				images.push_back( image );
+				index.add( image );
+			}
 			else delete image;
 
 			node2 = node2.getNextSibling( "image" );
@@ -59,6 +59,7 @@ struct DaeMaterial
 struct DaeLibMaterials
 {
 	std::vector< DaeMaterial * >  materials;
+	DaeIdIndex< DaeMaterial >     index;
 
 
 	~DaeLibMaterials()
@@ -69,14 +70,7 @@ struct DaeLibMaterials
 
 	DaeMaterial *findMaterial( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < materials.size(); ++i )
-		{
-			if( materials[i]->id == id ) return materials[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 
 
@@ -89,7 +83,11 @@ struct DaeLibMaterials
 		while( !node2.isEmpty() )
 		{
 			DaeMaterial *material = new DaeMaterial();
-			if( material->parse( node2 ) ) materials.push_back( material );
+			if( material->parse( node2 ) )
+			{
+				materials.push_back( material );
+				index.add( material );
+			}
 			else delete material;
 
 			node2 = node2.getNextSibling( "material" );
@@ -25,6 +25,7 @@ namespace ColladaConverter {
 struct DaeLibNodes
 {
 	std::vector< DaeNode * >  nodes;
+	DaeIdIndex< DaeNode >     index;
 	std::string               id;
 	std::string               name;
 
@@ -36,14 +37,7 @@ struct DaeLibNodes
 
 	DaeNode *findNode( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < nodes.size(); ++i )
-		{
-			if( nodes[i]->id == id ) return nodes[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 
 	
@@ -56,7 +50,11 @@ struct DaeLibNodes
 		while( !node2.isEmpty() )
 		{
 			DaeNode *node = new DaeNode();
-			if( node->parse( node2 ) ) nodes.push_back( node );
+			if( node->parse( node2 ) )
+			{
+				nodes.push_back( node );
+				index.add( node );
+			}
 			else delete node;
 
 			node2 = node2.getNextSibling( "node" );
@@ -82,12 +82,7 @@ struct DaeNode
 
 				char *str = (char *)node1.getText();
 				if( str == 0x0 ) return false;
-				for( int i = 0; i < 16; ++i )
-				{
-					float f;
-					parseFloat( str, f );
-					trans.values[i] = f;
-				}
+				parseFloatArray( str, trans.values, 16 );
 
 				memcpy( trans.animValues, trans.values, 16 * sizeof( float ) );
 				transStack.push_back( trans );
@@ -304,6 +299,7 @@ struct DaeVisualScene
 struct DaeLibVisScenes
 {
 	std::vector< DaeVisualScene * >	visScenes;
+	DaeIdIndex< DaeVisualScene >    index;
 
 
 	~DaeLibVisScenes()
@@ -314,14 +310,7 @@ struct DaeLibVisScenes
 
 	DaeVisualScene *findVisualScene( const std::string &id ) const
 	{
-		if( id == "" ) return 0x0;
-		
-		for( unsigned int i = 0; i < visScenes.size(); ++i )
-		{
-			if( visScenes[i]->id == id ) return visScenes[i];
-		}
-
-		return 0x0;
+		return index.find( id );
 	}
 	
 	
@@ -335,7 +324,11 @@ struct DaeLibVisScenes
 		{
 			DaeVisualScene *visScene = new DaeVisualScene();
 
-			if( visScene->parse( node2 ) ) visScenes.push_back( visScene );
+			if( visScene->parse( node2 ) )
+			{
+				visScenes.push_back( visScene );
+				index.add( visScene );
+			}
 			else delete visScene;
 
 			node2 = node2.getNextSibling( "visual_scene" );
@@ -13,6 +13,8 @@
 #include "daeMain.h"
 #include "utXML.h"
 #include "utils.h"
+#include <chrono>
+#include <cstdio>
 
 using namespace std;
 namespace Horde3D {
@@ -28,6 +30,8 @@ ColladaDocument::ColladaDocument()
 
 bool ColladaDocument::parseFile( const string &fileName )
 {
+	chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+	
 	// Parse Collada file
 	XMLDoc doc;
 	if( !doc.parseFile( fileName.c_str() ) )
@@ -129,6 +133,22 @@ bool ColladaDocument::parseFile( const string &fileName )
 	}
 	
 	if( !foundScene ) log( "Warning: No scene instance found" );
+
+	// Report parsing throughput
+	double seconds = chrono::duration< double >( chrono::steady_clock::now() - startTime ).count();
+	double fileSize = 0;
+	FILE *f = fopen( fileName.c_str(), "rb" );
+	if( f != 0x0 )
+	{
+		fseek( f, 0, SEEK_END );
+		fileSize = (double)ftell( f ) / (1024 * 1024);
+		fclose( f );
+	}
+
+	char str[128];
+	snprintf( str, sizeof( str ), "Parsed %.2f MB in %.1f ms (%.1f MB/s)", fileSize, seconds * 1000.0,
+	          seconds > 0 ? fileSize / seconds : 0.0 );
+	log( str );
 	
 	return true;
 }
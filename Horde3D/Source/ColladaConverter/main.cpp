@@ -14,6 +14,14 @@
 #include "converter.h"
 #include "utPlatform.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #ifdef PLATFORM_WIN
 #   define WIN32_LEAN_AND_MEAN 1
@@ -45,6 +53,35 @@ struct AssetTypes
 };
 
 
+struct ConvSettings
+{
+	AssetTypes::List  assetType;
+	string            basePath, outPath;
+	bool              geoOpt, overdrawOpt, overwriteMats, addModelName;
+	float             lodDists[4];
+	float             weldTolerance;
+	LodGenSettings    lodGen;
+};
+
+
+struct AssetResult
+{
+	string              log;  // Output of the asset when converting in parallel
+	double              parseTime, convertTime, writeTime;  // In ms
+	unsigned long long  hash;  // Hash of input file and settings, 0 if not calculated
+	bool                processed;  // False if the conversion was stopped before reaching the asset
+	bool                success, skipped;
+
+	AssetResult() : parseTime( 0 ), convertTime( 0 ), writeTime( 0 ), hash( 0 ), processed( false ),
+		success( false ), skipped( false ) {}
+};
+
+typedef map< string, unsigned long long > AssetManifest;  // Asset path to hash of converted input
+
+// Materials can be shared by assets in the same directory
+static mutex materialMutex;
+
+
 void createAssetList( const string &basePath, const string &assetPath, vector< string > &assetList )
 {
 	vector< string >  directories;
@@ -125,12 +162,209 @@ void printHelp()
 	log( "-base path        base path where the repository root is located" );
 	log( "-dest path        existing destination path where output is written" );
 	log( "-noGeoOpt         disable geometry optimization" );
+	log( "-overdrawOpt      reorder triangles to reduce overdraw" );
 	log( "-overwriteMats    force update of existing materials" );
 	log( "-addModelName     adds model name before material name" );
 	log( "-lodDist1 dist    distance for LOD1" );
 	log( "-lodDist2 dist    distance for LOD2" );
 	log( "-lodDist3 dist    distance for LOD3" );
 	log( "-lodDist4 dist    distance for LOD4" );
+	log( "-lodGen count     generate count (1-4) LOD levels by mesh simplification" );
+	log( "-lodRatio1 ratio  target triangle ratio for generated LOD1 (default: 0.5)" );
+	log( "-lodRatio2 ratio  target triangle ratio for generated LOD2 (default: 0.25)" );
+	log( "-lodRatio3 ratio  target triangle ratio for generated LOD3 (default: 0.125)" );
+	log( "-lodRatio4 ratio  target triangle ratio for generated LOD4 (default: 0.0625)" );
+	log( "-lodMaxError err  maximum simplification error relative to mesh size (default: 0.05)" );
+	log( "-weldTolerance t  merge vertices whose attributes fall into the same cell of a grid with" );
+	log( "                  spacing t (default: 0, exact match)" );
+	log( "-jobs count       number of assets converted in parallel; 0 uses all cores (default: 1)" );
+	log( "-incremental      skip assets whose input and settings did not change since the last run" );
+}
+
+
+static double elapsedMS( chrono::steady_clock::time_point &start )
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	double ms = chrono::duration< double, milli >( now - start ).count();
+	start = now;
+	
+	return ms;
+}
+
+
+unsigned long long calcSettingsHash( const ConvSettings &settings )
+{
+	// All settings that influence the output
+	stringstream ss;
+	ss << "ColladaConv 2.0.0|" << settings.assetType << "|" << settings.outPath << "|" << settings.geoOpt << settings.overdrawOpt
+	   << settings.overwriteMats << settings.addModelName;
+	for( unsigned int i = 0; i < 4; ++i )
+		ss << "|" << settings.lodDists[i] << "|" << settings.lodGen.ratios[i];
+	ss << "|" << settings.lodGen.numLevels << "|" << settings.lodGen.maxError << "|" << settings.weldTolerance;
+	
+	string str = ss.str();
+	return hashData( str.c_str(), str.length() );
+}
+
+
+unsigned long long calcFileHash( const string &fileName, unsigned long long seed )
+{
+	ifstream inf( fileName.c_str(), ios::binary );
+	if( !inf.good() ) return 0;
+
+	unsigned long long hash = seed;
+	char buf[65536];
+	while( inf.good() )
+	{
+		inf.read( buf, sizeof( buf ) );
+		hash = hashData( buf, (size_t)inf.gcount(), hash );
+	}
+	
+	return hash;
+}
+
+
+void readManifest( const string &fileName, AssetManifest &manifest )
+{
+	ifstream inf( fileName.c_str() );
+	string line;
+	
+	while( getline( inf, line ) )
+	{
+		// Format: 16 hex digits, space, asset path
+		if( line.length() < 18 || line[16] != ' ' ) continue;
+		manifest[line.substr( 17 )] = strtoull( line.substr( 0, 16 ).c_str(), 0x0, 16 );
+	}
+}
+
+
+bool writeManifest( const string &fileName, const AssetManifest &manifest )
+{
+	ofstream outf( fileName.c_str(), ios::trunc );
+	char hashStr[32];
+	
+	for( AssetManifest::const_iterator itr = manifest.begin(); itr != manifest.end(); ++itr )
+	{
+		snprintf( hashStr, sizeof( hashStr ), "%016llx", itr->second );
+		outf << hashStr << " " << itr->first << "\n";
+	}
+
+	return outf.good();
+}
+
+
+bool outputsExist( const ConvSettings &settings, const string &assetPath, const string &assetName )
+{
+	string name = settings.outPath + assetPath + assetName;
+	if( settings.assetType == AssetTypes::Animation ) return ifstream( (name + ".anim").c_str() ).good();
+	
+	return ifstream( (name + ".geo").c_str() ).good() && ifstream( (name + ".scene.xml").c_str() ).good();
+}
+
+
+bool convertAsset( const ConvSettings &settings, const string &asset, AssetResult &result )
+{
+	string sourcePath = settings.basePath + asset;
+	string assetName = extractFileName( asset, false );
+	string modelName = settings.addModelName ? assetName + "_" : "";
+
+	string assetPath = cleanPath( extractFilePath( asset ) );
+	if( !assetPath.empty() ) assetPath += "/";
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool success = true;
+	
+	ColladaDocument *daeDoc = new ColladaDocument();
+	
+	log( "Parsing dae asset '" + asset + "'..." );
+	if( !daeDoc->parseFile( sourcePath ) )
+	{
+		delete daeDoc;
+		return false;
+	}
+	result.parseTime = elapsedMS( start );
+	
+	if( settings.assetType == AssetTypes::Model )
+	{
+		log( "Compiling model data..." );
+		Converter *converter = new Converter( *daeDoc, settings.outPath, settings.lodDists, settings.lodGen );
+		converter->convertModel( settings.geoOpt, settings.overdrawOpt, settings.weldTolerance );
+		result.convertTime = elapsedMS( start );
+		
+		createDirectories( settings.outPath, assetPath );
+		success &= converter->writeModel( assetPath, assetName, modelName );
+		{
+			lock_guard< mutex > lock( materialMutex );
+			success &= converter->writeMaterials( assetPath, modelName, settings.overwriteMats );
+		}
+		result.writeTime = elapsedMS( start );
+
+		delete converter; converter = 0x0;
+	}
+	else if( settings.assetType == AssetTypes::Animation )
+	{	
+		log( "Compiling animation data..." );
+		Converter *converter = new Converter( *daeDoc, settings.outPath, settings.lodDists );
+		converter->convertModel( false );
+		result.convertTime = elapsedMS( start );
+		
+		if( converter->hasAnimation() )
+		{
+			createDirectories( settings.outPath, assetPath );
+			success &= converter->writeAnimation( assetPath, assetName );
+		}
+		else
+		{
+			log( "Skipping file (does not contain animation data)" );
+			
+			// Without an output file the asset cannot be checked for being up to date, so it is
+			// not recorded in the manifest
+			result.hash = 0;
+		}
+		result.writeTime = elapsedMS( start );
+
+		delete converter; converter = 0x0;
+	}
+	
+	delete daeDoc; daeDoc = 0x0;
+
+	return success;
+}
+
+
+void processAsset( const ConvSettings &settings, const string &asset, const AssetManifest *manifest,
+                   unsigned long long settingsHash, AssetResult &result )
+{
+	result.processed = true;
+	
+	if( manifest != 0x0 )
+	{
+		result.hash = calcFileHash( settings.basePath + asset, settingsHash );
+		
+		AssetManifest::const_iterator itr = manifest->find( asset );
+		if( result.hash != 0 && itr != manifest->end() && itr->second == result.hash )
+		{
+			string assetPath = cleanPath( extractFilePath( asset ) );
+			if( !assetPath.empty() ) assetPath += "/";
+			
+			if( outputsExist( settings, assetPath, extractFileName( asset, false ) ) )
+			{
+				log( "Skipping dae asset '" + asset + "' (up to date)" );
+				result.skipped = true;
+				result.success = true;
+				return;
+			}
+		}
+	}
+	
+	result.success = convertAsset( settings, asset, result );
+
+	char timeStr[128];
+	snprintf( timeStr, sizeof( timeStr ), "%s in %.1f ms (parse %.1f ms, convert %.1f ms, write %.1f ms)",
+	          result.success ? "Done" : "Failed", result.parseTime + result.convertTime + result.writeTime,
+	          result.parseTime, result.convertTime, result.writeTime );
+	log( timeStr );
+	log( "" );
 }
 
 
@@ -152,9 +386,12 @@ int main( int argc, char **argv )
 	vector< string > assetList;
 	string input = argv[1], basePath = "./", outPath = "./";
 	AssetTypes::List assetType = AssetTypes::Model;
-	bool geoOpt = true, overwriteMats = false, addModelName = false;
+	bool geoOpt = true, overdrawOpt = false, overwriteMats = false, addModelName = false;
 	float lodDists[4] = { 10, 20, 40, 80 };
-	string modelName = "";	
+	LodGenSettings lodGen;
+	float weldTolerance = 0;
+	unsigned int numJobs = 1;
+	bool incremental = false;
 
 	// Make sure that first argument ist not an option
 	if( argv[1][0] == '-' )
@@ -188,6 +425,10 @@ int main( int argc, char **argv )
 		{
 			geoOpt = false;
 		}
+		else if( _stricmp( arg.c_str(), "-overdrawOpt" ) == 0 )
+		{
+			overdrawOpt = true;
+		}
 		else if( _stricmp( arg.c_str(), "-overwriteMats" ) == 0 )
 		{
 			overwriteMats = true;
@@ -202,10 +443,37 @@ int main( int argc, char **argv )
 			
 			lodDists[index] = toFloat( argv[++i] );
 		}
+		else if( _stricmp( arg.c_str(), "-lodGen" ) == 0 && argc > i + 1 )
+		{
+			lodGen.numLevels = std::min( (unsigned int)std::max( atoi( argv[++i] ), 0 ), 4u );
+		}
+		else if( (_stricmp( arg.c_str(), "-lodRatio1" ) == 0 || _stricmp( arg.c_str(), "-lodRatio2" ) == 0 ||
+		          _stricmp( arg.c_str(), "-lodRatio3" ) == 0 || _stricmp( arg.c_str(), "-lodRatio4" ) == 0) && argc > i + 1 )
+		{
+			int index = arg[9] - '1';
+			lodGen.ratios[index] = toFloat( argv[++i] );
+		}
+		else if( _stricmp( arg.c_str(), "-lodMaxError" ) == 0 && argc > i + 1 )
+		{
+			lodGen.maxError = toFloat( argv[++i] );
+		}
 		else if( _stricmp( arg.c_str(), "-addModelName" ) == 0 )
 		{
 			addModelName = true;
 		}
+		else if( _stricmp( arg.c_str(), "-weldTolerance" ) == 0 && argc > i + 1 )
+		{
+			weldTolerance = std::max( toFloat( argv[++i] ), 0.0f );
+		}
+		else if( _stricmp( arg.c_str(), "-jobs" ) == 0 && argc > i + 1 )
+		{
+			int jobs = atoi( argv[++i] );
+			numJobs = jobs > 0 ? (unsigned int)jobs : std::max( thread::hardware_concurrency(), 1u );
+		}
+		else if( _stricmp( arg.c_str(), "-incremental" ) == 0 )
+		{
+			incremental = true;
+		}
 		else
 		{
 			log( std::string( "Invalid arguments: '" ) + arg.c_str() + std::string( "'" ) );
@@ -251,64 +519,95 @@ int main( int argc, char **argv )
 		log( "" );
 	}
 	
-	string tmpStr;
-	tmpStr.reserve( 256 );
+	ConvSettings settings;
+	settings.assetType = assetType;
+	settings.basePath = basePath;
+	settings.outPath = outPath;
+	settings.geoOpt = geoOpt;
+	settings.overdrawOpt = overdrawOpt;
+	settings.overwriteMats = overwriteMats;
+	settings.addModelName = addModelName;
+	for( unsigned int i = 0; i < 4; ++i ) settings.lodDists[i] = lodDists[i];
+	settings.lodGen = lodGen;
+	settings.weldTolerance = weldTolerance;
+
+	// The manifest stores the hash of input and settings of each successfully converted asset
+	AssetManifest manifest;
+	string manifestName = outPath + (assetType == AssetTypes::Model ? "colladaconv_models.manifest" : "colladaconv_anims.manifest");
+	unsigned long long settingsHash = calcSettingsHash( settings );
+	if( incremental ) readManifest( manifestName, manifest );
+
+	numJobs = std::min( numJobs, std::max( (unsigned int)assetList.size(), 1u ) );
+	vector< AssetResult > results( assetList.size() );
+	atomic< size_t > nextAsset( 0 );
+	atomic< bool > failed( false );
+	mutex outputMutex;
 	
-	for( unsigned int i = 0; i < assetList.size(); ++i )
+	chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+	// Stop taking new assets after a failure like the serial conversion does
+	auto convertAssets = [&]()
 	{
-		if( assetType == AssetTypes::Model || assetType == AssetTypes::Animation )
+		for( size_t i = nextAsset++; i < assetList.size() && !failed; i = nextAsset++ )
 		{
-			string sourcePath = basePath + assetList[i];
-			string assetName = extractFileName( assetList[i], false );
-
-			if( addModelName )	
-				modelName = assetName + "_";
-
-			string assetPath = cleanPath( extractFilePath( assetList[i] ) );
-			if( !assetPath.empty() ) assetPath += "/";
-			
-			ColladaDocument *daeDoc = new ColladaDocument();
+			AssetResult &result = results[i];
 			
-			log( "Parsing dae asset '" + assetList[i] + "'..." );
-			if( !daeDoc->parseFile( sourcePath ) )
-				return 1;
+			// Buffer output so that the messages of different assets do not get mixed up
+			if( numJobs > 1 ) setLogBuffer( &result.log );
+			processAsset( settings, assetList[i], incremental ? &manifest : 0x0, settingsHash, result );
+			if( !result.success ) failed = true;
 			
-			if( assetType == AssetTypes::Model )
+			if( numJobs > 1 )
 			{
-				log( "Compiling model data..." );
-				Converter *converter = new Converter( *daeDoc, outPath, lodDists );
-				converter->convertModel( geoOpt );
+				setLogBuffer( 0x0 );
+				if( !result.log.empty() ) result.log.erase( result.log.length() - 1 );
 				
-				createDirectories( outPath, assetPath );
-				converter->writeModel( assetPath, assetName, modelName );
-				converter->writeMaterials( assetPath, modelName, overwriteMats );
-
-				delete converter; converter = 0x0;
+				lock_guard< mutex > lock( outputMutex );
+				log( result.log );
 			}
-			else if( assetType == AssetTypes::Animation )
-			{	
-				log( "Compiling animation data..." );
-				Converter *converter = new Converter( *daeDoc, outPath, lodDists );
-				converter->convertModel( false );
-				
-				if( converter->hasAnimation() )
-				{
-					createDirectories( outPath, assetPath );
-					converter->writeAnimation( assetPath, assetName );
-				}
-				else
-				{
-					log( "Skipping file (does not contain animation data)" );
-				}
-
-				delete converter; converter = 0x0;
-			}
-			
-			delete daeDoc; daeDoc = 0x0;
 		}
+	};
 
-		log( "" );
+	if( numJobs > 1 )
+	{
+		vector< thread > workers;
+		for( unsigned int i = 0; i < numJobs; ++i ) workers.push_back( thread( convertAssets ) );
+		for( unsigned int i = 0; i < numJobs; ++i ) workers[i].join();
+	}
+	else
+	{
+		convertAssets();
 	}
+
+	double totalTime = elapsedMS( startTime );
+	
+	// Summary
+	unsigned int numConverted = 0, numSkipped = 0, numFailed = 0;
+	double parseTime = 0, convertTime = 0, writeTime = 0;
+	for( size_t i = 0; i < results.size(); ++i )
+	{
+		const AssetResult &result = results[i];
+		if( result.skipped ) ++numSkipped;
+		else if( result.success ) ++numConverted;
+		else if( result.processed ) ++numFailed;
+		
+		parseTime += result.parseTime;
+		convertTime += result.convertTime;
+		writeTime += result.writeTime;
+
+		if( result.success && !result.skipped && result.hash != 0 ) manifest[assetList[i]] = result.hash;
+	}
+
+	if( incremental && !writeManifest( manifestName, manifest ) )
+		log( "Failed to write " + manifestName + " file" );
+
+	char summaryStr[256];
+	snprintf( summaryStr, sizeof( summaryStr ), "Converted %u of %u assets (%u up to date, %u failed) in %.2f s using %u job(s)",
+	          numConverted, (unsigned int)assetList.size(), numSkipped, numFailed, totalTime / 1000.0, numJobs );
+	log( summaryStr );
+	snprintf( summaryStr, sizeof( summaryStr ), "Time summed over assets: parse %.2f s, convert %.2f s, write %.2f s",
+	          parseTime / 1000.0, convertTime / 1000.0, writeTime / 1000.0 );
+	log( summaryStr );
 	
-	return 0;
+	return failed ? 1 : 0;
 }
@@ -13,36 +13,60 @@
 #include "optimizer.h"
 #include "converter.h"
 #include "utPlatform.h"
-#include <list>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 using namespace std;
 namespace Horde3D {
 namespace ColladaConverter {
 
 
-void OptVertex::updateScore( int cacheIndex )
+const float MeshOptimizer::defaultOverdrawThreshold = 1.05f;
+
+
+namespace {
+
+const unsigned int MaxValenceScore = 32;
+
+struct CacheScoreTable
 {
-	if( faces.empty() )
-	{	
-		score = 0;
-		return;
+	// Vertex scores from Linear-Speed Vertex Cache Optimisation by Tom Forsyth
+	float  cache[MeshOptimizer::maxCacheSize + 1];  // Last entry is used for vertices not in cache
+	float  valence[MaxValenceScore + 1];
+
+	CacheScoreTable()
+	{
+		for( int i = 0; i < MeshOptimizer::maxCacheSize; ++i )
+		{
+			if( i < 3 ) cache[i] = 0.75f;  // Among three most recent vertices
+			else cache[i] = pow( 1.0f - (float)(i - 3) / (MeshOptimizer::maxCacheSize - 3), 1.5f );
+		}
+		cache[MeshOptimizer::maxCacheSize] = 0;
+
+		valence[0] = 0;
+		for( unsigned int i = 1; i <= MaxValenceScore; ++i )
+			valence[i] = 2.0f * pow( (float)i, -0.5f );
 	}
-	
-	// The constants used here are coming from the paper
-	if( cacheIndex < 0 ) score = 0;				// Not in cache
-	else if( cacheIndex < 3 ) score = 0.75f;	// Among three most recent vertices
-	else score = pow( 1.0f - ((cacheIndex - 3) / MeshOptimizer::maxCacheSize), 1.5f );
 
-	score += 2.0f * pow( (float)faces.size(), -0.5f );
-}
+	float getScore( int cachePos, unsigned int liveTris ) const
+	{
+		if( liveTris == 0 ) return 0;
+		return cache[cachePos < 0 ? MeshOptimizer::maxCacheSize : cachePos] +
+		       valence[std::min( liveTris, MaxValenceScore )];
+	}
+};
+
+const CacheScoreTable cacheScores;
 
+} // namespace
 
 
 unsigned int MeshOptimizer::removeDegeneratedTriangles( TriGroup *triGroup, vector< Vertex > &vertices,
                                                         vector< unsigned int > &indices )
 {
 	unsigned int numDegTris = 0;
+	unsigned int dest = triGroup->first;
 	
 	for( unsigned int k = triGroup->first; k < triGroup->first + triGroup->count; k += 3 )
 	{
@@ -53,151 +77,304 @@ unsigned int MeshOptimizer::removeDegeneratedTriangles( TriGroup *triGroup, vect
 		if( (v2 - v0).cross( v1 - v0 ).length() < Math::ZeroEpsilon )
 		{
 			++numDegTris;
-			// Remove triangle indices
-			indices.erase( indices.begin() + k + 2 );
-			indices.erase( indices.begin() + k + 1 );
-			indices.erase( indices.begin() + k + 0 );
-			k -= 3;
-			triGroup->count -= 3;
+			continue;
 		}
+
+		indices[dest++] = indices[k + 0];
+		indices[dest++] = indices[k + 1];
+		indices[dest++] = indices[k + 2];
+	}
+
+	// Remove triangle indices
+	if( numDegTris > 0 )
+	{
+		indices.erase( indices.begin() + dest, indices.begin() + triGroup->first + triGroup->count );
+		triGroup->count -= numDegTris * 3;
 	}
 
 	return numDegTris;
 }
 
 
-void MeshOptimizer::optimizeIndexOrder( TriGroup *triGroup, vector< Vertex > &vertices,
-                                        vector< unsigned int > &indices,
-                                        map< unsigned int, unsigned int > &vertMap )
+void MeshOptimizer::optimizeIndexOrder( TriGroup *triGroup, vector< unsigned int > &indices )
 {
 	// Implementation of Linear-Speed Vertex Cache Optimisation by Tom Forsyth
-	// (see http://home.comcast.net/~tom_forsyth/papers/fast_vert_cache_opt.html)
+	// (see https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html)
 	
 	if( triGroup->count == 0 ) return;
 	
-	vector< OptVertex > verts( triGroup->vertREnd - triGroup->vertRStart + 1 );
-	set< OptFace * > faces;
-	list< OptVertex * > cache;
+	unsigned int numVerts = triGroup->vertREnd - triGroup->vertRStart + 1;
+	unsigned int numTris = triGroup->count / 3;
+	unsigned int *groupIndices = &indices[triGroup->first];
+
+	// Build vertex to triangle adjacency as flat arrays
+	vector< unsigned int > adjOffsets( numVerts + 1, 0 );
+	vector< unsigned int > adjTris( triGroup->count );
+	vector< unsigned int > liveTris( numVerts, 0 );
+	
+	for( unsigned int i = 0; i < triGroup->count; ++i )
+		++liveTris[groupIndices[i] - triGroup->vertRStart];
+	for( unsigned int i = 0; i < numVerts; ++i )
+		adjOffsets[i + 1] = adjOffsets[i] + liveTris[i];
 	
-	// Build vertex and triangle structures
-	for( unsigned int i = 0; i < triGroup->count; i += 3 )
+	vector< unsigned int > adjFill( adjOffsets.begin(), adjOffsets.end() - 1 );
+	for( unsigned int i = 0; i < triGroup->count; ++i )
+		adjTris[adjFill[groupIndices[i] - triGroup->vertRStart]++] = i / 3;
+
+	// Initial scores
+	vector< float > vertScores( numVerts );
+	vector< int > cachePos( numVerts, -1 );
+	for( unsigned int i = 0; i < numVerts; ++i )
+		vertScores[i] = cacheScores.getScore( -1, liveTris[i] );
+
+	vector< float > triScores( numTris );
+	vector< unsigned char > emitted( numTris, 0 );
+	for( unsigned int i = 0; i < numTris; ++i )
 	{
-		set< OptFace * >::iterator itr1 = faces.insert( faces.begin(), new OptFace() );
-		OptFace *face = (*itr1);
-		
-		face->verts[0] = &verts[indices[triGroup->first + i] - triGroup->vertRStart];
-		face->verts[1] = &verts[indices[triGroup->first + i + 1] - triGroup->vertRStart];
-		face->verts[2] = &verts[indices[triGroup->first + i + 2] - triGroup->vertRStart];
-		face->verts[0]->faces.insert( face );
-		face->verts[1]->faces.insert( face );
-		face->verts[2]->faces.insert( face );
+		triScores[i] = vertScores[groupIndices[i * 3] - triGroup->vertRStart] +
+		               vertScores[groupIndices[i * 3 + 1] - triGroup->vertRStart] +
+		               vertScores[groupIndices[i * 3 + 2] - triGroup->vertRStart];
 	}
-	for( unsigned int i = 0; i < verts.size(); ++i )
+
+	unsigned int cache[maxCacheSize + 3], newCache[maxCacheSize + 3];
+	unsigned int cacheSize = 0;
+	
+	vector< unsigned int > outIndices( triGroup->count );
+	unsigned int numOutIndices = 0;
+	unsigned int inputCursor = 0;  // Fallback for dead ends, scans input order only once
+	
+	// Start with best triangle
+	unsigned int bestTri = 0;
+	for( unsigned int i = 1; i < numTris; ++i )
 	{
-		verts[i].index = triGroup->vertRStart + i;
-		verts[i].updateScore( -1 );
+		if( triScores[i] > triScores[bestTri] ) bestTri = i;
 	}
 
-	// Main loop of algorithm
-	unsigned int curIndex = triGroup->first;
-	
-	while( !faces.empty() )
+	while( true )
 	{
-		OptFace *bestFace = 0x0;
-		float bestScore = -1.0f;
+		// Emit best triangle
+		const unsigned int *tri = &groupIndices[bestTri * 3];
+		emitted[bestTri] = 1;
 		
-		// Try to find best scoring face in cache
-		list< OptVertex * >::iterator itr1 = cache.begin();
-		while( itr1 != cache.end() )
+		unsigned int newCacheSize = 0;
+		for( unsigned int i = 0; i < 3; ++i )
 		{
-			set< OptFace * >::iterator itr2 = (*itr1)->faces.begin();
-			while( itr2 != (*itr1)->faces.end() )
-			{
-				if( (*itr2)->getScore() > bestScore )
-				{
-					bestFace = *itr2;
-					bestScore = bestFace->getScore();
-				}
-				++itr2;
-			}
-			++itr1;
+			unsigned int v = tri[i] - triGroup->vertRStart;
+			outIndices[numOutIndices++] = tri[i];
+			newCache[newCacheSize++] = v;
+
+			// Remove triangle from adjacency of vertex
+			unsigned int *first = &adjTris[adjOffsets[v]], *last = first + liveTris[v];
+			*std::find( first, last, bestTri ) = *(last - 1);
+			--liveTris[v];
+		}
+		
+		// Move emitted vertices to head of cache
+		for( unsigned int i = 0; i < cacheSize; ++i )
+		{
+			unsigned int v = cache[i];
+			if( v != newCache[0] && v != newCache[1] && v != newCache[2] )
+				newCache[newCacheSize++] = v;
+		}
+		
+		// Vertices that dropped out of cache
+		for( unsigned int i = maxCacheSize; i < newCacheSize; ++i )
+		{
+			cachePos[newCache[i]] = -1;
+			vertScores[newCache[i]] = cacheScores.getScore( -1, liveTris[newCache[i]] );
+		}
+		
+		cacheSize = std::min( newCacheSize, (unsigned int)maxCacheSize );
+		memcpy( cache, newCache, cacheSize * sizeof( unsigned int ) );
+		
+		// Update scores of vertices in cache and find best adjacent triangle
+		for( unsigned int i = 0; i < cacheSize; ++i )
+		{
+			cachePos[cache[i]] = i;
+			vertScores[cache[i]] = cacheScores.getScore( i, liveTris[cache[i]] );
 		}
 
-		// If that didn't work find it in the complete list of triangles
-		if( bestFace == 0x0 )
+		float bestScore = -1.0f;
+		for( unsigned int i = 0; i < cacheSize; ++i )
 		{
-			set< OptFace * >::iterator itr2 = faces.begin();
-			while( itr2 != faces.end() )
+			unsigned int v = cache[i];
+			for( unsigned int j = adjOffsets[v]; j < adjOffsets[v] + liveTris[v]; ++j )
 			{
-				if( (*itr2)->getScore() > bestScore )
+				unsigned int t = adjTris[j];
+				float score = vertScores[groupIndices[t * 3] - triGroup->vertRStart] +
+				              vertScores[groupIndices[t * 3 + 1] - triGroup->vertRStart] +
+				              vertScores[groupIndices[t * 3 + 2] - triGroup->vertRStart];
+				triScores[t] = score;
+				
+				if( score > bestScore )
 				{
-					bestFace = (*itr2);
-					bestScore = bestFace->getScore();
+					bestScore = score;
+					bestTri = t;
 				}
-				++itr2;
 			}
 		}
-		ASSERT( bestFace != 0x0 );
-		
-		// Process vertices of best face
-		for( unsigned int i = 0; i < 3; ++i )
+
+		// Dead end: continue with next triangle that was not emitted yet
+		if( bestScore < 0 )
 		{
-			// Add vertex to draw list
-			indices[curIndex++] = bestFace->verts[i]->index;
+			while( inputCursor < numTris && emitted[inputCursor] ) ++inputCursor;
+			if( inputCursor == numTris ) break;
+			bestTri = inputCursor;
+		}
+	}
+
+	memcpy( groupIndices, &outIndices[0], triGroup->count * sizeof( unsigned int ) );
+}
 
-			// Move vertex to head of cache
-			itr1 = find( cache.begin(), cache.end(), bestFace->verts[i] );
-			if( itr1 != cache.end() ) cache.erase( itr1 );
-			cache.push_front( bestFace->verts[i] );
 
-			// Remove face from vertex lists
-			bestFace->verts[i]->faces.erase( bestFace );
+void MeshOptimizer::optimizeOverdraw( TriGroup *triGroup, vector< Vertex > &vertices,
+                                      vector< unsigned int > &indices, float threshold )
+{
+	// Implementation of the clustering and sorting steps of Fast Triangle Reordering for Vertex
+	// Locality and Reduced Overdraw by Sander, Nehab and Barczak; expects cache optimized indices.
+	// Threshold is the allowed degradation of the vertex cache efficiency.
+	
+	if( triGroup->count == 0 ) return;
+
+	unsigned int numVerts = triGroup->vertREnd - triGroup->vertRStart + 1;
+	unsigned int numTris = triGroup->count / 3;
+	unsigned int *groupIndices = &indices[triGroup->first];
+
+	// Split into clusters where the cache gets flushed (hard boundaries)
+	vector< unsigned int > cacheTime( numVerts, 0 );
+	vector< unsigned int > hardClusters;
+	unsigned int time = maxCacheSize + 1;
+	
+	for( unsigned int i = 0; i < numTris; ++i )
+	{
+		unsigned int misses = 0;
+		for( unsigned int j = 0; j < 3; ++j )
+		{
+			unsigned int v = groupIndices[i * 3 + j] - triGroup->vertRStart;
+			if( time - cacheTime[v] > (unsigned int)maxCacheSize )
+			{
+				cacheTime[v] = time++;
+				++misses;
+			}
 		}
+		
+		if( i == 0 || misses == 3 ) hardClusters.push_back( i );
+	}
+	hardClusters.push_back( numTris );
 
-		// Remove best face
-		faces.erase( faces.find( bestFace ) );
-		delete bestFace;
+	// Split hard clusters further as long as the cache efficiency of the parts, each starting with
+	// an empty cache, stays within the threshold (soft boundaries)
+	vector< unsigned int > clusters;
+	for( size_t i = 0; i + 1 < hardClusters.size(); ++i )
+	{
+		unsigned int start = hardClusters[i], end = hardClusters[i + 1];
+		
+		TriGroup hardGroup = *triGroup;
+		hardGroup.first = triGroup->first + start * 3;
+		hardGroup.count = (end - start) * 3;
+		float maxACMR = threshold * calcCacheEfficiency( &hardGroup, indices );
 
-		// Update scores of vertices in cache
-		unsigned int cacheIndex = 0;
-		for( itr1 = cache.begin(); itr1 != cache.end(); ++itr1 )
+		unsigned int curStart = start, curMisses = 0;
+		time += maxCacheSize + 1;  // Flush cache
+		clusters.push_back( start );
+		
+		for( unsigned int j = start; j < end; ++j )
 		{
-			(*itr1)->updateScore( cacheIndex++ );
+			for( unsigned int k = 0; k < 3; ++k )
+			{
+				unsigned int v = groupIndices[j * 3 + k] - triGroup->vertRStart;
+				if( time - cacheTime[v] > (unsigned int)maxCacheSize )
+				{
+					cacheTime[v] = time++;
+					++curMisses;
+				}
+			}
+			
+			if( j + 1 < end && (float)curMisses / (j + 1 - curStart) <= maxACMR )
+			{
+				curStart = j + 1;
+				curMisses = 0;
+				time += maxCacheSize + 1;
+				clusters.push_back( curStart );
+			}
 		}
+	}
+	clusters.push_back( numTris );
 
-		// Trim cache
-		for( int i = (int)cache.size(); i > maxCacheSize; --i )
+	// Calculate sort key for every cluster: clusters facing away from the mesh center come first
+	Vec3f meshCenter( 0, 0, 0 );
+	float meshArea = 0;
+	vector< Vec3f > clusterCenters( clusters.size() - 1 ), clusterNormals( clusters.size() - 1 );
+	
+	for( size_t i = 0; i + 1 < clusters.size(); ++i )
+	{
+		Vec3f center( 0, 0, 0 ), normal( 0, 0, 0 );
+		float area = 0;
+		
+		for( unsigned int j = clusters[i]; j < clusters[i + 1]; ++j )
 		{
-			cache.pop_back();
+			const Vec3f &p0 = vertices[groupIndices[j * 3]].pos;
+			const Vec3f &p1 = vertices[groupIndices[j * 3 + 1]].pos;
+			const Vec3f &p2 = vertices[groupIndices[j * 3 + 2]].pos;
+			
+			Vec3f triNormal = (p1 - p0).cross( p2 - p0 );
+			float triArea = triNormal.length();
+			
+			center += (p0 + p1 + p2) * (triArea / 3.0f);
+			normal += triNormal;
+			area += triArea;
 		}
+
+		meshCenter += center;
+		meshArea += area;
+		clusterCenters[i] = area > 0 ? center / area : center;
+		clusterNormals[i] = normal.length() > 0 ? normal.normalized() : normal;
+	}
+	if( meshArea > 0 ) meshCenter /= meshArea;
+
+	vector< pair< float, unsigned int > > clusterOrder( clusters.size() - 1 );
+	for( size_t i = 0; i < clusterOrder.size(); ++i )
+	{
+		clusterOrder[i].first = -(clusterCenters[i] - meshCenter).dot( clusterNormals[i] );
+		clusterOrder[i].second = (unsigned int)i;
 	}
+	stable_sort( clusterOrder.begin(), clusterOrder.end() );
 
+	// Write triangles in cluster order
+	vector< unsigned int > outIndices;
+	outIndices.reserve( triGroup->count );
+	for( size_t i = 0; i < clusterOrder.size(); ++i )
+	{
+		unsigned int c = clusterOrder[i].second;
+		outIndices.insert( outIndices.end(), groupIndices + clusters[c] * 3, groupIndices + clusters[c + 1] * 3 );
+	}
 
-	// Remap vertices to make access to them as linear as possible
+	memcpy( groupIndices, &outIndices[0], triGroup->count * sizeof( unsigned int ) );
+}
+
+
+void MeshOptimizer::optimizeVertexFetch( TriGroup *triGroup, vector< Vertex > &vertices,
+                                         vector< unsigned int > &indices, vector< unsigned int > &vertMap )
+{
+	// Remap vertices to make access to them as linear as possible;
+	// vertMap maps from old vertex index relative to vertRStart to new absolute index
+	
+	unsigned int numVerts = triGroup->vertREnd - triGroup->vertRStart + 1;
 	vector< Vertex > oldVertices( vertices.begin() + triGroup->vertRStart,
 	                              vertices.begin() + triGroup->vertREnd + 1 );
-	vertMap.clear();
+	vertMap.assign( numVerts, (unsigned int)-1 );
 	unsigned int curVertex = triGroup->vertRStart;
 	
 	for( unsigned int i = triGroup->first; i < triGroup->first + triGroup->count; ++i )
 	{
-		map< unsigned int, unsigned int >::iterator itr1 = vertMap.find( indices[i] );
+		unsigned int &newIndex = vertMap[indices[i] - triGroup->vertRStart];
 		
-		if( itr1 == vertMap.end() )
+		if( newIndex == (unsigned int)-1 )
 		{
-			vertMap[indices[i]] = curVertex;
-			indices[i] = curVertex++;
+			newIndex = curVertex++;
+			vertices[newIndex] = oldVertices[indices[i] - triGroup->vertRStart];
 		}
-		else
-		{
-			indices[i] = itr1->second;
-		}
-	}
-
-	for( map< unsigned int, unsigned int >::iterator itr1 = vertMap.begin();
-	     itr1 != vertMap.end(); ++itr1 )
-	{
-		vertices[itr1->second] = oldVertices[itr1->first - triGroup->vertRStart];
+		indices[i] = newIndex;
 	}
 }
 
@@ -205,27 +382,707 @@ void MeshOptimizer::optimizeIndexOrder( TriGroup *triGroup, vector< Vertex > &ve
 float MeshOptimizer::calcCacheEfficiency( TriGroup *triGroup, vector< unsigned int > &indices,
                                           const unsigned int cacheSize )
 {	
-	// Measure efficiency of index array regarding post-transform vertex cache
+	// Measure efficiency of index array regarding a FIFO post-transform vertex cache
 
+	if( triGroup->count == 0 ) return 0;
+	
+	unsigned int numVerts = triGroup->vertREnd - triGroup->vertRStart + 1;
+	vector< unsigned int > cacheTime( numVerts, 0 );
 	unsigned int misses = 0;
-	list< unsigned int > testCache;
+	unsigned int time = cacheSize + 1;
+	
 	for( unsigned int i = 0; i < triGroup->count; ++i )
 	{
-		unsigned int index = indices[triGroup->first + i];
-		if( find( testCache.begin(), testCache.end(), index ) == testCache.end() )
+		unsigned int v = indices[triGroup->first + i] - triGroup->vertRStart;
+		if( time - cacheTime[v] > cacheSize )
 		{
-			testCache.push_back( index );
-			if( testCache.size() > cacheSize ) testCache.erase( testCache.begin() );
+			cacheTime[v] = time++;
 			++misses;
 		}
 	}
 	
-	// Average transform to vertex ratio (ATVR)
-	// 1.0 is theoretical optimum, meaning that each vertex is just transformed exactly one time
-	float atvr = (float)(triGroup->count + misses) / triGroup->count;
-	return atvr;
+	// Average cache miss ratio (ACMR)
+	// 0.5 is the theoretical optimum for large regular meshes, 3.0 is the worst case
+	return (float)misses / (triGroup->count / 3);
+}
+
+
+// =================================================================================================
+// Vertex welding
+// =================================================================================================
+
+VertexWelder::VertexWelder( float tolerance, bool matchPosIndices, unsigned int attribMask ) :
+	_invTolerance( tolerance > 0 ? 1.0f / tolerance : 0 ), _matchPosIndices( matchPosIndices || tolerance <= 0 )
+{
+	_numAttribs = 0;
+	_attribs[_numAttribs++] = 0;
+	for( unsigned int i = 1; i < 6; ++i )
+	{
+		if( attribMask & (1 << (i - 1)) ) _attribs[_numAttribs++] = i;
+	}
+	_keySize = 1 + _numAttribs * 3;
+	
+	_table.resize( 1024, 0 );
+}
+
+
+void VertexWelder::reserve( unsigned int numVertices )
+{
+	unsigned int tableSize = (unsigned int)_table.size();
+	while( tableSize < numVertices * 2 ) tableSize *= 2;
+	if( tableSize > _table.size() ) rehash( tableSize );
+
+	_keys.reserve( (size_t)numVertices * _keySize );
+	_hashes.reserve( numVertices );
+	_vertIndices.reserve( numVertices );
+}
+
+
+void VertexWelder::makeKey( const Vertex &v, unsigned int *key ) const
+{
+	const Vec3f *attribs[6] = { &v.storedPos, &v.storedNormal, &v.texCoords[0], &v.texCoords[1],
+	                            &v.texCoords[2], &v.texCoords[3] };
+	
+	key[0] = _matchPosIndices ? (unsigned int)v.daePosIndex : 0;
+	for( unsigned int i = 0; i < _numAttribs; ++i )
+	{
+		const Vec3f &attrib = *attribs[_attribs[i]];
+		const float values[3] = { attrib.x, attrib.y, attrib.z };
+		unsigned int *attribKey = &key[1 + i * 3];
+		
+		if( _invTolerance > 0 )
+		{
+			// Snap to grid cell
+			for( unsigned int j = 0; j < 3; ++j )
+			{
+				double cell = floor( (double)values[j] * _invTolerance );
+				attribKey[j] = (unsigned int)(int)std::max( std::min( cell, 2147483647.0 ), -2147483648.0 );
+			}
+		}
+		else
+		{
+			// Compare bit patterns; adding zero turns negative zero into positive zero
+			const float exact[3] = { values[0] + 0.0f, values[1] + 0.0f, values[2] + 0.0f };
+			memcpy( attribKey, exact, sizeof( exact ) );
+		}
+	}
+}
+
+
+unsigned int VertexWelder::hashKey( const unsigned int *key ) const
+{
+	// Word-wise variant of FNV-1a with final avalanche
+	unsigned int hash = 2166136261u;
+	for( unsigned int i = 0; i < _keySize; ++i )
+		hash = (hash ^ key[i]) * 16777619u;
+	
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	
+	return hash;
+}
+
+
+void VertexWelder::rehash( unsigned int tableSize )
+{
+	_table.assign( tableSize, 0 );
+	unsigned int mask = tableSize - 1;
+
+	for( unsigned int i = 0; i < (unsigned int)_hashes.size(); ++i )
+	{
+		unsigned int slot = _hashes[i] & mask;
+		while( _table[slot] != 0 ) slot = (slot + 1) & mask;
+		_table[slot] = i + 1;
+	}
+}
+
+
+unsigned int VertexWelder::weld( const Vertex &v, unsigned int index )
+{
+	unsigned int key[MaxKeySize];
+	makeKey( v, key );
+	
+	unsigned int hash = hashKey( key );
+	unsigned int mask = (unsigned int)_table.size() - 1;
+	unsigned int slot = hash & mask;
+	
+	// Linear probing
+	while( _table[slot] != 0 )
+	{
+		unsigned int unique = _table[slot] - 1;
+		if( _hashes[unique] == hash && memcmp( &_keys[unique * _keySize], key, _keySize * sizeof( unsigned int ) ) == 0 )
+			return _vertIndices[unique];
+		slot = (slot + 1) & mask;
+	}
+
+	_table[slot] = (unsigned int)_vertIndices.size() + 1;
+	_keys.insert( _keys.end(), key, key + _keySize );
+	_hashes.push_back( hash );
+	_vertIndices.push_back( index );
+	
+	// Keep load factor below one half
+	if( _vertIndices.size() * 2 > _table.size() ) rehash( (unsigned int)_table.size() * 2 );
+
+	return index;
 }
 
 
+// =================================================================================================
+// Mesh simplification
+// =================================================================================================
+
+namespace {
+
+const unsigned int InvalidIndex = 0xffffffff;
+
+struct Quadric
+{
+	// Symmetric matrix A, vector b and constant c of the quadric form p^T A p + 2 b^T p + c
+	double  a00, a11, a22, a01, a02, a12;
+	double  b0, b1, b2, c;
+
+	Quadric() : a00( 0 ), a11( 0 ), a22( 0 ), a01( 0 ), a02( 0 ), a12( 0 ), b0( 0 ), b1( 0 ), b2( 0 ), c( 0 )
+	{
+	}
+
+	void addPlane( const Vec3f &n, float d, float weight )
+	{
+		a00 += weight * n.x * n.x; a11 += weight * n.y * n.y; a22 += weight * n.z * n.z;
+		a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a12 += weight * n.y * n.z;
+		b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+		c += weight * d * d;
+	}
+
+	void add( const Quadric &q )
+	{
+		a00 += q.a00; a11 += q.a11; a22 += q.a22;
+		a01 += q.a01; a02 += q.a02; a12 += q.a12;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+	}
+
+	double eval( const Vec3f &p ) const
+	{
+		double rx = a00 * p.x + a01 * p.y + a02 * p.z;
+		double ry = a01 * p.x + a11 * p.y + a12 * p.z;
+		double rz = a02 * p.x + a12 * p.y + a22 * p.z;
+		double r = p.x * rx + p.y * ry + p.z * rz + 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+		
+		return r > 0 ? r : 0;  // Can get slightly negative due to rounding
+	}
+};
+
+
+struct SimpVertKind
+{
+	enum List
+	{
+		Manifold,  // Interior vertex without attribute seam, can collapse to any neighbor
+		Border,    // Vertex on open border, can only collapse along the border
+		Seam,      // Vertex on UV/normal seam, can only collapse along the seam
+		Locked     // Vertex that must not move
+	};
+};
+
+
+struct SimpCollapse
+{
+	unsigned int  v0, v1;  // Source and target vertex
+	double        error;
+
+	bool operator<( const SimpCollapse &other ) const { return error < other.error; }
+};
+
+
+class SimpMesh
+{
+public:
+	SimpMesh( const vector< Vertex > &vertices, unsigned int vertRStart, unsigned int numVerts,
+	          vector< unsigned int > &indices );
+
+	void buildAdjacency();
+	void classifyVertices();
+	void computeQuadrics();
+	
+	bool hasEdge( unsigned int a, unsigned int b ) const;
+	bool hasPosEdge( unsigned int posA, unsigned int posB ) const;
+	bool canCollapse( unsigned int v0, unsigned int v1, bool posOpen, bool attrOpen ) const;
+	void pickCollapses( vector< SimpCollapse > &collapses ) const;
+	bool checkFlip( unsigned int pos0, unsigned int pos1, unsigned int &numRemovedTris ) const;
+	bool mapSeamWedges( unsigned int pos0, unsigned int pos1, vector< unsigned int > &remap ) const;
+	void applyRemap( const vector< unsigned int > &remap );
+
+	const Vec3f &getPos( unsigned int v ) const { return _vertices[_vertRStart + v].pos; }
+
+public:
+	const vector< Vertex >    &_vertices;
+	unsigned int              _vertRStart, _numVerts;
+	vector< unsigned int >    &_indices;  // Local indices
+
+	vector< unsigned int >    _posRep;      // Representative vertex of all vertices sharing a position
+	vector< unsigned int >    _wedgeNext;   // Cyclic list of vertices sharing a position
+	vector< unsigned int >    _adjOffsets;  // Offsets into _adjTris for each vertex
+	vector< unsigned int >    _adjTris;     // Triangles referencing a vertex
+	vector< unsigned char >   _kinds;       // Vertex kind, valid for position representatives
+	vector< Quadric >         _quadrics;    // Quadrics, valid for position representatives
+};
+
+
+SimpMesh::SimpMesh( const vector< Vertex > &vertices, unsigned int vertRStart, unsigned int numVerts,
+                    vector< unsigned int > &indices ) :
+	_vertices( vertices ), _vertRStart( vertRStart ), _numVerts( numVerts ), _indices( indices )
+{
+	// Group vertices that share the same position (split by UV or normal seams)
+	vector< unsigned int > order( numVerts );
+	for( unsigned int i = 0; i < numVerts; ++i ) order[i] = i;
+
+	struct PosLess
+	{
+		const SimpMesh *mesh;
+		bool operator()( unsigned int a, unsigned int b ) const
+		{
+			const Vec3f &pa = mesh->getPos( a ), &pb = mesh->getPos( b );
+			if( pa.x != pb.x ) return pa.x < pb.x;
+			if( pa.y != pb.y ) return pa.y < pb.y;
+			if( pa.z != pb.z ) return pa.z < pb.z;
+			return a < b;
+		}
+	} posLess = { this };
+	sort( order.begin(), order.end(), posLess );
+
+	_posRep.resize( numVerts );
+	_wedgeNext.resize( numVerts );
+	for( unsigned int i = 0; i < numVerts; )
+	{
+		unsigned int j = i + 1;
+		while( j < numVerts && getPos( order[j] ) == getPos( order[i] ) ) ++j;
+		
+		for( unsigned int k = i; k < j; ++k )
+		{
+			_posRep[order[k]] = order[i];
+			_wedgeNext[order[k]] = order[k + 1 < j ? k + 1 : i];
+		}
+		i = j;
+	}
+
+	_kinds.resize( numVerts, SimpVertKind::Locked );
+	_quadrics.resize( numVerts );
+}
+
+
+void SimpMesh::buildAdjacency()
+{
+	_adjOffsets.assign( _numVerts + 1, 0 );
+	_adjTris.resize( _indices.size() );
+
+	for( size_t i = 0; i < _indices.size(); ++i ) ++_adjOffsets[_indices[i] + 1];
+	for( unsigned int i = 0; i < _numVerts; ++i ) _adjOffsets[i + 1] += _adjOffsets[i];
+
+	vector< unsigned int > fill( _adjOffsets.begin(), _adjOffsets.end() - 1 );
+	for( size_t i = 0; i < _indices.size(); ++i )
+		_adjTris[fill[_indices[i]]++] = (unsigned int)(i / 3);
+}
+
+
+bool SimpMesh::hasEdge( unsigned int a, unsigned int b ) const
+{
+	// Check for directed edge a->b
+	for( unsigned int i = _adjOffsets[a]; i < _adjOffsets[a + 1]; ++i )
+	{
+		const unsigned int *tri = &_indices[_adjTris[i] * 3];
+		unsigned int next = tri[0] == a ? tri[1] : (tri[1] == a ? tri[2] : tri[0]);
+		if( next == b ) return true;
+	}
+	return false;
+}
+
+
+bool SimpMesh::hasPosEdge( unsigned int posA, unsigned int posB ) const
+{
+	// Check for directed edge between two positions, considering all wedges
+	unsigned int a = posA;
+	do
+	{
+		for( unsigned int i = _adjOffsets[a]; i < _adjOffsets[a + 1]; ++i )
+		{
+			const unsigned int *tri = &_indices[_adjTris[i] * 3];
+			unsigned int next = tri[0] == a ? tri[1] : (tri[1] == a ? tri[2] : tri[0]);
+			if( _posRep[next] == posB ) return true;
+		}
+		a = _wedgeNext[a];
+	} while( a != posA );
+	
+	return false;
+}
+
+
+void SimpMesh::classifyVertices()
+{
+	vector< unsigned int > attrOpenIn( _numVerts, 0 ), attrOpenOut( _numVerts, 0 );
+	vector< unsigned int > posOpenIn( _numVerts, 0 ), posOpenOut( _numVerts, 0 );
+
+	for( size_t i = 0; i < _indices.size(); ++i )
+	{
+		unsigned int a = _indices[i];
+		unsigned int b = _indices[i % 3 == 2 ? i - 2 : i + 1];
+
+		if( !hasEdge( b, a ) )
+		{
+			++attrOpenOut[a]; ++attrOpenIn[b];
+			if( !hasPosEdge( _posRep[b], _posRep[a] ) )
+			{
+				++posOpenOut[_posRep[a]]; ++posOpenIn[_posRep[b]];
+			}
+		}
+	}
+
+	for( unsigned int i = 0; i < _numVerts; ++i )
+	{
+		if( _posRep[i] != i ) continue;
+		
+		// Collect wedges that are still referenced
+		unsigned int wedges[3], numWedges = 0, v = i;
+		do
+		{
+			if( _adjOffsets[v + 1] > _adjOffsets[v] )
+			{
+				if( numWedges < 3 ) wedges[numWedges] = v;
+				++numWedges;
+			}
+			v = _wedgeNext[v];
+		} while( v != i );
+		
+		unsigned char kind = SimpVertKind::Locked;
+		if( numWedges == 1 )
+		{
+			unsigned int w = wedges[0];
+			if( attrOpenIn[w] == 0 && attrOpenOut[w] == 0 )
+				kind = SimpVertKind::Manifold;
+			else if( posOpenIn[i] == 1 && posOpenOut[i] == 1 && attrOpenIn[w] == 1 && attrOpenOut[w] == 1 )
+				kind = SimpVertKind::Border;
+		}
+		else if( numWedges == 2 )
+		{
+			if( posOpenIn[i] == 0 && posOpenOut[i] == 0 &&
+			    attrOpenIn[wedges[0]] == 1 && attrOpenOut[wedges[0]] == 1 &&
+			    attrOpenIn[wedges[1]] == 1 && attrOpenOut[wedges[1]] == 1 )
+			{
+				kind = SimpVertKind::Seam;
+			}
+		}
+		_kinds[i] = kind;
+	}
+}
+
+
+void SimpMesh::computeQuadrics()
+{
+	const float edgeWeight = 10.0f;  // Penalty for moving border and seam edges
+	
+	for( size_t i = 0; i < _indices.size(); i += 3 )
+	{
+		const Vec3f &p0 = getPos( _indices[i] ), &p1 = getPos( _indices[i + 1] ), &p2 = getPos( _indices[i + 2] );
+		Vec3f normal = (p1 - p0).cross( p2 - p0 );
+		float area = normal.length();
+		if( area < Math::ZeroEpsilon ) continue;
+		normal /= area;
+
+		Quadric q;
+		q.addPlane( normal, -normal.dot( p0 ), area * 0.5f );
+		for( unsigned int k = 0; k < 3; ++k ) _quadrics[_posRep[_indices[i + k]]].add( q );
+
+		// Add perpendicular planes along border and seam edges to keep them in place
+		for( unsigned int k = 0; k < 3; ++k )
+		{
+			unsigned int a = _indices[i + k], b = _indices[i + (k + 1) % 3];
+			if( hasEdge( b, a ) ) continue;
+
+			Vec3f edge = getPos( b ) - getPos( a );
+			float edgeLen = edge.length();
+			if( edgeLen < Math::ZeroEpsilon ) continue;
+			
+			Vec3f edgeNormal = edge.cross( normal ).normalized();
+			Quadric eq;
+			eq.addPlane( edgeNormal, -edgeNormal.dot( getPos( a ) ), edgeLen * edgeLen * edgeWeight );
+			_quadrics[_posRep[a]].add( eq );
+			_quadrics[_posRep[b]].add( eq );
+		}
+	}
+}
+
+
+bool SimpMesh::canCollapse( unsigned int v0, unsigned int v1, bool posOpen, bool attrOpen ) const
+{
+	unsigned int pos0 = _posRep[v0], pos1 = _posRep[v1];
+	
+	// Preserve skin-weight seams by only merging vertices with the same influences
+	const Vertex &vert0 = _vertices[_vertRStart + v0], &vert1 = _vertices[_vertRStart + v1];
+	for( unsigned int i = 0; i < 4; ++i )
+	{
+		if( vert0.joints[i] != vert1.joints[i] ) return false;
+	}
+	
+	switch( _kinds[pos0] )
+	{
+	case SimpVertKind::Manifold:
+		return true;
+	case SimpVertKind::Border:
+		return posOpen && _kinds[pos1] == SimpVertKind::Border;
+	case SimpVertKind::Seam:
+		return attrOpen && !posOpen && _kinds[pos1] == SimpVertKind::Seam;
+	default:
+		return false;
+	}
+}
+
+
+void SimpMesh::pickCollapses( vector< SimpCollapse > &collapses ) const
+{
+	// Find cheapest collapse for every position
+	vector< SimpCollapse > best( _numVerts );
+	for( unsigned int i = 0; i < _numVerts; ++i )
+	{
+		best[i].v0 = InvalidIndex;
+		best[i].error = Math::MaxFloat;
+	}
+	
+	for( size_t i = 0; i < _indices.size(); ++i )
+	{
+		unsigned int a = _indices[i];
+		unsigned int b = _indices[i % 3 == 2 ? i - 2 : i + 1];
+		if( _posRep[a] == _posRep[b] ) continue;
+		
+		bool attrOpen = !hasEdge( b, a );
+		bool posOpen = attrOpen && !hasPosEdge( _posRep[b], _posRep[a] );
+
+		for( unsigned int dir = 0; dir < 2; ++dir )
+		{
+			unsigned int v0 = dir == 0 ? a : b, v1 = dir == 0 ? b : a;
+			
+			// Interior edges are visited from both sides
+			if( !attrOpen && dir == 1 ) continue;
+			if( !canCollapse( v0, v1, posOpen, attrOpen ) ) continue;
+
+			double error = _quadrics[_posRep[v0]].eval( getPos( v1 ) );
+			SimpCollapse &c = best[_posRep[v0]];
+			if( error < c.error )
+			{
+				c.v0 = v0;
+				c.v1 = v1;
+				c.error = error;
+			}
+		}
+	}
+
+	collapses.clear();
+	for( unsigned int i = 0; i < _numVerts; ++i )
+	{
+		if( best[i].v0 != InvalidIndex ) collapses.push_back( best[i] );
+	}
+	sort( collapses.begin(), collapses.end() );
+}
+
+
+bool SimpMesh::checkFlip( unsigned int pos0, unsigned int pos1, unsigned int &numRemovedTris ) const
+{
+	const Vec3f &newPos = getPos( pos1 );
+	numRemovedTris = 0;
+
+	unsigned int v = pos0;
+	do
+	{
+		for( unsigned int i = _adjOffsets[v]; i < _adjOffsets[v + 1]; ++i )
+		{
+			const unsigned int *tri = &_indices[_adjTris[i] * 3];
+			unsigned int k = tri[0] == v ? 0 : (tri[1] == v ? 1 : 2);
+			unsigned int o1 = tri[(k + 1) % 3], o2 = tri[(k + 2) % 3];
+
+			// Triangles on the collapsed edge vanish
+			if( _posRep[o1] == pos1 || _posRep[o2] == pos1 )
+			{
+				++numRemovedTris;
+				continue;
+			}
+
+			const Vec3f &p1 = getPos( o1 ), &p2 = getPos( o2 );
+			Vec3f oldNormal = (p1 - getPos( v )).cross( p2 - getPos( v ) );
+			Vec3f newNormal = (p1 - newPos).cross( p2 - newPos );
+			if( oldNormal.dot( newNormal ) <= 0 ) return false;
+		}
+		v = _wedgeNext[v];
+	} while( v != pos0 );
+
+	return true;
+}
+
+
+bool SimpMesh::mapSeamWedges( unsigned int pos0, unsigned int pos1, vector< unsigned int > &remap ) const
+{
+	// Each wedge of the source needs to collapse to the wedge of the target on the same side of the seam
+	unsigned int sources[2], targets[2], numMapped = 0;
+	
+	unsigned int v = pos0;
+	do
+	{
+		if( _adjOffsets[v + 1] > _adjOffsets[v] )
+		{
+			if( numMapped == 2 ) return false;
+			
+			unsigned int w = pos1, target = InvalidIndex;
+			do
+			{
+				if( _adjOffsets[w + 1] > _adjOffsets[w] && (hasEdge( v, w ) || hasEdge( w, v )) )
+				{
+					target = w;
+					break;
+				}
+				w = _wedgeNext[w];
+			} while( w != pos1 );
+			
+			if( target == InvalidIndex ) return false;
+			sources[numMapped] = v;
+			targets[numMapped++] = target;
+		}
+		v = _wedgeNext[v];
+	} while( v != pos0 );
+
+	if( numMapped != 2 || targets[0] == targets[1] ) return false;
+
+	remap[sources[0]] = targets[0];
+	remap[sources[1]] = targets[1];
+	return true;
+}
+
+
+void SimpMesh::applyRemap( const vector< unsigned int > &remap )
+{
+	size_t numIndices = 0;
+	for( size_t i = 0; i < _indices.size(); i += 3 )
+	{
+		unsigned int v0 = remap[_indices[i]], v1 = remap[_indices[i + 1]], v2 = remap[_indices[i + 2]];
+		
+		// Remove triangles that became degenerated
+		if( _posRep[v0] == _posRep[v1] || _posRep[v0] == _posRep[v2] || _posRep[v1] == _posRep[v2] )
+			continue;
+
+		_indices[numIndices++] = v0;
+		_indices[numIndices++] = v1;
+		_indices[numIndices++] = v2;
+	}
+	_indices.resize( numIndices );
+}
+
+} // namespace
+
+
+float MeshSimplifier::simplify( const vector< Vertex > &vertices, const TriGroup *triGroup,
+                                const vector< unsigned int > &indices, unsigned int targetIndexCount,
+                                float maxError, vector< unsigned int > &outIndices )
+{
+	// Quadric error metric simplification (Garland and Heckbert) using half-edge collapses, so
+	// no new vertices are created; border, seam and skinning discontinuities are preserved
+
+	outIndices.clear();
+	if( triGroup->count == 0 ) return 0;
+	
+	unsigned int numVerts = triGroup->vertREnd - triGroup->vertRStart + 1;
+	vector< unsigned int > localIndices( triGroup->count );
+	
+	Vec3f bbMin( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat ), bbMax( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
+	for( unsigned int i = 0; i < triGroup->count; ++i )
+	{
+		localIndices[i] = indices[triGroup->first + i] - triGroup->vertRStart;
+		
+		const Vec3f &pos = vertices[indices[triGroup->first + i]].pos;
+		bbMin = Vec3f( std::min( bbMin.x, pos.x ), std::min( bbMin.y, pos.y ), std::min( bbMin.z, pos.z ) );
+		bbMax = Vec3f( std::max( bbMax.x, pos.x ), std::max( bbMax.y, pos.y ), std::max( bbMax.z, pos.z ) );
+	}
+
+	// Error bound is relative to the mesh extent
+	Vec3f extents = bbMax - bbMin;
+	float meshSize = std::max( std::max( extents.x, extents.y ), extents.z );
+	double maxErrorSq = (double)maxError * meshSize * maxError * meshSize;
+	double resultError = 0;
+
+	targetIndexCount = std::max( targetIndexCount, 3u );
+
+	SimpMesh mesh( vertices, triGroup->vertRStart, numVerts, localIndices );
+	vector< SimpCollapse > collapses;
+	vector< unsigned int > remap( numVerts );
+	vector< unsigned char > locked( numVerts );
+
+	mesh.buildAdjacency();
+	mesh.computeQuadrics();
+	
+	while( localIndices.size() > targetIndexCount )
+	{
+		mesh.buildAdjacency();
+		mesh.classifyVertices();
+		mesh.pickCollapses( collapses );
+		if( collapses.empty() ) break;
+
+		// Every collapse removes about two triangles; limit error of this pass to get uniform quality
+		unsigned int triGoal = (unsigned int)(localIndices.size() - targetIndexCount) / 3;
+		size_t goalIndex = std::min( (size_t)std::max( triGoal / 2, 1u ), collapses.size() ) - 1;
+		double passErrorLimit = collapses[goalIndex].error * 1.5;
+
+		for( unsigned int i = 0; i < numVerts; ++i ) remap[i] = i;
+		locked.assign( numVerts, 0 );
+		
+		unsigned int numRemovedTris = 0, numCollapses = 0;
+		for( size_t i = 0; i < collapses.size() && numRemovedTris < triGoal; ++i )
+		{
+			const SimpCollapse &c = collapses[i];
+			if( c.error > maxErrorSq || c.error > passErrorLimit ) break;
+
+			unsigned int pos0 = mesh._posRep[c.v0], pos1 = mesh._posRep[c.v1];
+			if( locked[pos0] || locked[pos1] ) continue;
+
+			unsigned int collapseTris;
+			if( !mesh.checkFlip( pos0, pos1, collapseTris ) ) continue;
+
+			if( mesh._kinds[pos0] == SimpVertKind::Seam )
+			{
+				if( !mesh.mapSeamWedges( pos0, pos1, remap ) ) continue;
+			}
+			else
+			{
+				remap[c.v0] = c.v1;
+			}
+
+			mesh._quadrics[pos1].add( mesh._quadrics[pos0] );
+			
+			// Lock all positions whose triangles were modified
+			locked[pos1] = 1;
+			unsigned int v = pos0;
+			do
+			{
+				for( unsigned int j = mesh._adjOffsets[v]; j < mesh._adjOffsets[v + 1]; ++j )
+				{
+					const unsigned int *tri = &localIndices[mesh._adjTris[j] * 3];
+					locked[mesh._posRep[tri[0]]] = 1;
+					locked[mesh._posRep[tri[1]]] = 1;
+					locked[mesh._posRep[tri[2]]] = 1;
+				}
+				v = mesh._wedgeNext[v];
+			} while( v != pos0 );
+
+			numRemovedTris += collapseTris;
+			resultError = std::max( resultError, c.error );
+			++numCollapses;
+		}
+		
+		if( numCollapses == 0 ) break;
+		mesh.applyRemap( remap );
+	}
+
+	outIndices.resize( localIndices.size() );
+	for( size_t i = 0; i < localIndices.size(); ++i )
+		outIndices[i] = localIndices[i] + triGroup->vertRStart;
+
+	return meshSize > 0 ? (float)sqrt( resultError ) / meshSize : 0;
+}
+
 } // namespace ColladaConverter
 } // namespace Horde3D
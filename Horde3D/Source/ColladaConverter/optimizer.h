@@ -14,8 +14,6 @@
 #define _optimizer_H_
 
 #include <vector>
-#include <set>
-#include <map>
 
 namespace Horde3D {
 namespace ColladaConverter {
@@ -23,37 +21,78 @@ namespace ColladaConverter {
 
 struct TriGroup;
 struct Vertex;
-struct OptFace;
 
 
-struct OptVertex
-{
-	unsigned int           index;  // Index in vertex array
-	float                  score;
-	std::set< OptFace * >  faces;  // Faces that are using this vertex
-
-	void updateScore( int cacheIndex );
-};
-
-struct OptFace
-{
-	OptVertex  *verts[3];
-	
-	float getScore() const { return verts[0]->score + verts[1]->score + verts[2]->score; }
-};
-
 class MeshOptimizer
 {
 public:
 	static const int maxCacheSize = 16;
+	static const float defaultOverdrawThreshold;
 	
 	static unsigned int removeDegeneratedTriangles( TriGroup *triGroup, std::vector< Vertex > &vertices,
 	                                                std::vector< unsigned int > &indices );
 	static float calcCacheEfficiency( TriGroup *triGroup, std::vector< unsigned int > &indices,
 	                                  const unsigned int cacheSize = maxCacheSize );
-	static void optimizeIndexOrder( TriGroup *triGroup, std::vector< Vertex > &vertices,
-	                                std::vector< unsigned int > &indices,
-	                                std::map< unsigned int, unsigned int > &vertMap );
+	static void optimizeIndexOrder( TriGroup *triGroup, std::vector< unsigned int > &indices );
+	static void optimizeOverdraw( TriGroup *triGroup, std::vector< Vertex > &vertices,
+	                              std::vector< unsigned int > &indices,
+	                              float threshold = defaultOverdrawThreshold );
+	static void optimizeVertexFetch( TriGroup *triGroup, std::vector< Vertex > &vertices,
+	                                 std::vector< unsigned int > &indices,
+	                                 std::vector< unsigned int > &vertMap );
+};
+
+
+// Hash based vertex deduplication that compares the full attribute tuple of position, normal and
+// texture coordinates. With a tolerance greater than zero, attributes are snapped to a grid with that
+// spacing before comparison; this is a quantisation, so values closer than the tolerance stay separate
+// if a cell boundary lies between them. Memory usage is proportional to the number of unique vertices.
+class VertexWelder
+{
+public:
+	enum Attribs
+	{
+		Normal = 1,
+		TexCoords0 = 2,  // Further texture coordinate sets follow
+		AllAttribs = 31
+	};
+	
+	// If matchPosIndices is set, only vertices with the same Collada position index are welded,
+	// which is required if skinning or morphing data is assigned by position index. The position
+	// is always compared; other attributes only if they are included in attribMask.
+	VertexWelder( float tolerance, bool matchPosIndices, unsigned int attribMask = AllAttribs );
+
+	// Prepares the lookup structure for the expected number of unique vertices
+	void reserve( unsigned int numVertices );
+	// Returns the index of an equal vertex that was added before; if there is none, the vertex is
+	// added with the passed index, which is returned
+	unsigned int weld( const Vertex &v, unsigned int index );
+	unsigned int getNumUniqueVertices() const { return (unsigned int)_vertIndices.size(); }
+
+private:
+	static const unsigned int MaxKeySize = 19;  // Position index and up to 18 attribute values
+
+	void makeKey( const Vertex &v, unsigned int *key ) const;
+	unsigned int hashKey( const unsigned int *key ) const;
+	void rehash( unsigned int tableSize );
+
+private:
+	float                        _invTolerance;
+	bool                         _matchPosIndices;
+	unsigned int                 _attribs[6], _numAttribs;  // Compared attributes: 0 = position, 1 = normal, 2+ = tex coords
+	unsigned int                 _keySize;
+	std::vector< unsigned int >  _keys;  // _keySize values per unique vertex
+	std::vector< unsigned int >  _hashes, _vertIndices;  // Per unique vertex
+	std::vector< unsigned int >  _table;  // Open addressing; unique vertex number + 1, 0 for empty slots
+};
+
+
+class MeshSimplifier
+{
+public:
+	static float simplify( const std::vector< Vertex > &vertices, const TriGroup *triGroup,
+	                       const std::vector< unsigned int > &indices, unsigned int targetIndexCount,
+	                       float maxError, std::vector< unsigned int > &outIndices );
 };
 
 
@@ -116,8 +116,17 @@ string cleanPath( const string &path )
 }
 
 
+static thread_local string *logBuffer = 0x0;
+
 void log( const std::string &msg )
 {
+	if( logBuffer != 0x0 )
+	{
+		*logBuffer += msg;
+		*logBuffer += '\n';
+		return;
+	}
+	
 	cout << msg << endl;
 	
 #ifdef PLATFORM_WIN
@@ -127,6 +136,27 @@ void log( const std::string &msg )
 }
 
 
+void setLogBuffer( std::string *buffer )
+{
+	logBuffer = buffer;
+}
+
+
+unsigned long long hashData( const void *data, size_t size, unsigned long long seed )
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	unsigned long long hash = seed;
+	
+	for( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+
 Matrix4f makeMatrix4f( float *floatArray16, bool y_up )
 {
 	Matrix4f mat( floatArray16 );
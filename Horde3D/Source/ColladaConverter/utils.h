@@ -17,6 +17,7 @@
 #include "utPlatform.h"
 #include <cstring>
 #include <cstdlib>
+#include <cmath>
 #include <string>
 
 namespace Horde3D {
@@ -30,6 +31,11 @@ std::string extractFilePath( const std::string &fullPath );
 std::string cleanPath( const std::string &path );
 
 void log( const std::string &msg );
+// While a buffer is set, messages logged by the calling thread are appended to it instead of being printed
+void setLogBuffer( std::string *buffer );
+
+// 64 bit FNV-1a hash; pass the result of a previous call as seed to hash several blocks
+unsigned long long hashData( const void *data, size_t size, unsigned long long seed = 14695981039346656037ULL );
 
 Matrix4f makeMatrix4f( float *floatArray16, bool y_up );
 
@@ -37,45 +43,45 @@ void createDirectories( const std::string &basePath, const std::string &newPath
 
 
 
+inline bool isSpace( char c )
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
 inline bool parseString( char *&str, std::string &token )
 {
 	token.clear();
-	token.reserve( 16 );
 	
 	// Skip whitespace
-	while( *str == ' ' || *str == '\t' || *str == '\n' || *str == '\r' )
-	{
-		++str;
-	}
+	while( isSpace( *str ) ) ++str;
 	if( *str == '\0' ) return false;
 
 	// Copy token
-	while( *str && *str != ' ' && *str != '\t' && *str != '\n' && *str != '\r' )
-	{
-		token += *str++;
-	}
+	char *first = str;
+	while( *str && !isSpace( *str ) ) ++str;
+	token.assign( first, str );
 
 	return true;
 }
 
 inline bool parseFloat( char *&str, float &f )
 {
-	float sign = 1.0f;
-	float value = 0.0f;
+	// Exact powers of ten; mantissas below 2^53 scaled by them give correctly rounded results
+	static const double pow10[23] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
 	
 	// Skip whitespace
-	while( *str == ' ' || *str == '\t' || *str == '\n' || *str == '\r' )
-	{
-		++str;
-	}
+	while( isSpace( *str ) ) ++str;
 	if( *str == '\0' ) return false;
 
 	char *firstChar = str;
+	bool negative = false;
 	
 	// Handle sign
 	if( *str == '-' )
 	{
-		sign = -1.0;
+		negative = true;
 		++str;
 	}
 	else if( *str == '+' )
@@ -83,66 +89,97 @@ inline bool parseFloat( char *&str, float &f )
 		++str;
 	}
 	
+	// Accumulate up to 18 significant digits as integer mantissa, so that no rounding errors
+	// build up over the digits
+	unsigned long long mantissa = 0;
+	int numDigits = 0, exponent = 0;
+	bool hasDigits = false;
+	
 	// Integral part
-	while( *str >= '0' && *str <= '9' )
+	for( ; *str >= '0' && *str <= '9'; ++str )
 	{
-		value = value * 10.0f + (*str++ - '0');
+		hasDigits = true;
+		if( numDigits < 18 )
+		{
+			mantissa = mantissa * 10 + (unsigned)(*str - '0');
+			if( mantissa != 0 ) ++numDigits;
+		}
+		else ++exponent;
 	}
 
 	// Fractional part
 	if( *str == '.' )
 	{
-		++str;
-		float pow10 = 0.1f;
-
-		while( *str >= '0' && *str <= '9' )
+		for( ++str; *str >= '0' && *str <= '9'; ++str )
 		{
-			value += (*str++ - '0') * pow10;
-			pow10 *= 0.1f;
+			hasDigits = true;
+			if( numDigits < 18 )
+			{
+				mantissa = mantissa * 10 + (unsigned)(*str - '0');
+				if( mantissa != 0 ) ++numDigits;
+				--exponent;
+			}
 		}
 	}
 	
-	// Exponent (use standard `toFloat` in this case)
-	if( *str == 'e' || *str == 'E')
+	// Exponent
+	
+	if( hasDigits && (*str == 'e' || *str == 'E') )
 	{
-		while( *str && *str != ' ' && *str != '\t' && *str != '\n' && *str != '\r' )
-			++str;
-		
-		if( str - firstChar < 64 )
-		{
-			char buf[64];
-			memcpy( buf, firstChar, str - firstChar );
-			buf[str - firstChar] = '\0';
+		char *expStart = str++;
+		bool negExp = false;
+		if( *str == '-' ) { negExp = true; ++str; }
+		else if( *str == '+' ) ++str;
 
-			f = toFloat( buf );
+		if( *str >= '0' && *str <= '9' )
+		{
+			int expValue = 0;
+			while( *str >= '0' && *str <= '9' )
+			{
+				if( expValue < 10000 ) expValue = expValue * 10 + (*str - '0');
+				++str;
+			}
+			exponent += negExp ? -expValue : expValue;
 		}
-		else
-			return false;
+		else str = expStart;
+	}
+	
+	if( !hasDigits || !(isSpace( *str ) || *str == '\0') )
+	{
+		// Unusual token like nan or inf, use standard conversion
+		while( *str && !isSpace( *str ) ) ++str;
+		if( str - firstChar >= 64 ) return false;
+		
+		char buf[64];
+		memcpy( buf, firstChar, str - firstChar );
+		buf[str - firstChar] = '\0';
+		f = toFloat( buf );
+		return true;
 	}
-	else
+
+	double value = (double)mantissa;
+	if( exponent != 0 && mantissa != 0 )
 	{
-		f = value * sign;
+		if( exponent > 0 && exponent <= 22 ) value *= pow10[exponent];
+		else if( exponent < 0 && exponent >= -22 ) value /= pow10[-exponent];
+		else value *= pow( 10.0, (double)exponent );
 	}
 	
+	f = (float)(negative ? -value : value);
 	return true;
 }
 
 inline bool parseInt( char *&str, int &i )
 {
-	int value = 0;
-	int sign = 1;
-	
 	// Skip whitespace
-	while( *str == ' ' || *str == '\t' || *str == '\n' || *str == '\r' )
-	{
-		++str;
-	}
+	while( isSpace( *str ) ) ++str;
 	if( *str == '\0' ) return false;
 	
 	// Sign
+	bool negative = false;
 	if( *str == '-' )
 	{
-		sign = -1;
+		negative = true;
 		++str;
 	}
 	else if( *str == '+' )
@@ -151,15 +188,36 @@ inline bool parseInt( char *&str, int &i )
 	}
 	
 	// Value
+	unsigned int value = 0;
 	while( *str >= '0' && *str <= '9' )
 	{
-		value = (value * 10) + (*str++ - '0');
+		value = value * 10 + (unsigned)(*str++ - '0');
 	}
 
-	i = value * sign;
+	// Skip remainder of malformed tokens so that parsing always advances
+	while( *str && !isSpace( *str ) ) ++str;
+
+	i = negative ? -(int)value : (int)value;
 	return true;
 }
 
+// Parse up to count values; returns the number of values read
+inline unsigned int parseFloatArray( char *&str, float *values, unsigned int count )
+{
+	unsigned int i = 0;
+	while( i < count && parseFloat( str, values[i] ) ) ++i;
+	
+	return i;
+}
+
+inline unsigned int parseIntArray( char *&str, int *values, unsigned int count )
+{
+	unsigned int i = 0;
+	while( i < count && parseInt( str, values[i] ) ) ++i;
+	
+	return i;
+}
+
 
 } // namespace ColladaConverter
 } // namespace Horde3D
@@ -0,0 +1,303 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "daeMain.h"
+#include "converter.h"
+#include "optimizer.h"
+#include <cmath>
+#include <cstdio>
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+using namespace Horde3D;
+using namespace Horde3D::ColladaConverter;
+
+namespace {
+
+// *************************************************************************************************
+// Collada parsing
+// *************************************************************************************************
+
+// Writes a height field grid with per-vertex normals and texture coordinates as Collada document
+bool writeGridDAE( const string &fileName, unsigned int size )
+{
+	FILE *f = fopen( fileName.c_str(), "w" );
+	if( f == 0x0 ) return false;
+
+	unsigned int numVerts = (size + 1) * (size + 1);
+	fprintf( f, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" );
+	fprintf( f, "<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n" );
+	fprintf( f, "<asset><up_axis>Y_UP</up_axis></asset>\n" );
+	fprintf( f, "<library_geometries>\n<geometry id=\"grid\" name=\"grid\"><mesh>\n" );
+
+	const char *semantics[3] = { "positions", "normals", "texcoords" };
+	for( unsigned int s = 0; s < 3; ++s )
+	{
+		unsigned int stride = s < 2 ? 3 : 2;
+		fprintf( f, "<source id=\"grid-%s\">\n<float_array id=\"grid-%s-array\" count=\"%u\">", semantics[s],
+		         semantics[s], numVerts * stride );
+		for( unsigned int y = 0; y <= size; ++y )
+		{
+			for( unsigned int x = 0; x <= size; ++x )
+			{
+				float u = (float)x / size, v = (float)y / size;
+				float h = 0.1f * sinf( u * 12.0f ) * cosf( v * 9.0f );
+				if( s == 0 ) fprintf( f, "%.6f %.6f %.6f ", u * 100.0f, h * 100.0f, v * 100.0f );
+				else if( s == 1 ) fprintf( f, "%.6f %.6f %.6f ", -h, 0.99f, h * 0.5f );
+				else fprintf( f, "%.6f %.6f ", u, v );
+			}
+			fprintf( f, "\n" );
+		}
+		fprintf( f, "</float_array>\n<technique_common><accessor source=\"#grid-%s-array\" count=\"%u\" stride=\"%u\">",
+		         semantics[s], numVerts, stride );
+		fprintf( f, stride == 3 ? "<param name=\"X\" type=\"float\"/><param name=\"Y\" type=\"float\"/><param name=\"Z\" type=\"float\"/>"
+		                        : "<param name=\"S\" type=\"float\"/><param name=\"T\" type=\"float\"/>" );
+		fprintf( f, "</accessor></technique_common>\n</source>\n" );
+	}
+
+	fprintf( f, "<vertices id=\"grid-vertices\"><input semantic=\"POSITION\" source=\"#grid-positions\"/></vertices>\n" );
+	fprintf( f, "<triangles count=\"%u\">\n", size * size * 2 );
+	fprintf( f, "<input semantic=\"VERTEX\" source=\"#grid-vertices\" offset=\"0\"/>\n" );
+	fprintf( f, "<input semantic=\"NORMAL\" source=\"#grid-normals\" offset=\"1\"/>\n" );
+	fprintf( f, "<input semantic=\"TEXCOORD\" source=\"#grid-texcoords\" offset=\"2\" set=\"0\"/>\n<p>" );
+	for( unsigned int y = 0; y < size; ++y )
+	{
+		for( unsigned int x = 0; x < size; ++x )
+		{
+			unsigned int i0 = y * (size + 1) + x, i1 = i0 + 1, i2 = i0 + size + 1, i3 = i2 + 1;
+			fprintf( f, "%u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u %u ",
+			         i0, i0, i0, i2, i2, i2, i1, i1, i1, i1, i1, i1, i2, i2, i2, i3, i3, i3 );
+		}
+		fprintf( f, "\n" );
+	}
+	fprintf( f, "</p>\n</triangles>\n</mesh></geometry>\n</library_geometries>\n" );
+
+	fprintf( f, "<library_visual_scenes><visual_scene id=\"scene\">" );
+	fprintf( f, "<node id=\"grid-node\"><instance_geometry url=\"#grid\"/></node>" );
+	fprintf( f, "</visual_scene></library_visual_scenes>\n" );
+	fprintf( f, "<scene><instance_visual_scene url=\"#scene\"/></scene>\n</COLLADA>\n" );
+
+	bool result = ferror( f ) == 0;
+	fclose( f );
+
+	return result;
+}
+
+
+void benchColladaParse( BenchRunner &runner )
+{
+	vector< unsigned int > sizes = runner.getScales( { 128, 512 } );
+	for( size_t i = 0; i < sizes.size(); ++i )
+	{
+		string fileName = runner.getConfig().tempDir + "/h3dbench_grid_" + to_string( sizes[i] ) + ".dae";
+		if( !writeGridDAE( fileName, sizes[i] ) )
+		{
+			runner.addFailure( "collada/parse: could not write " + fileName );
+			continue;
+		}
+
+		vector< char > data;
+		readFile( fileName, data );
+		unsigned int numGeometries = 0;
+
+		// Collect the log messages of the parser, which include its own throughput report
+		string logBuffer;
+		setLogBuffer( &logBuffer );
+		BenchResult *result = runner.run( "collada/parse", "grid=" + to_string( sizes[i] ), 10, [&]( BenchTimer &timer )
+		{
+			ColladaDocument *doc = new ColladaDocument();
+			if( doc->parseFile( fileName ) ) numGeometries = (unsigned int)doc->libGeometries.geometries.size();
+
+			timer.stop();
+			delete doc;
+		} );
+		setLogBuffer( 0x0 );
+
+		if( result != 0x0 )
+		{
+			runner.addCounter( result, "MB", data.size() / (1024.0 * 1024.0) );
+			runner.addCounter( result, "MB_per_s", data.size() / (1024.0 * 1024.0) / (result->getPercentile( 50 ) / 1000.0) );
+			if( numGeometries != 1 ) runner.addFailure( "collada/parse: grid geometry was not parsed" );
+		}
+
+		remove( fileName.c_str() );
+	}
+}
+
+
+// *************************************************************************************************
+// Vertex welding
+// *************************************************************************************************
+
+// Grid with 6 indices per quad where every quad has its own copies of normals and texture
+// coordinates, as exported for flat shading or texture atlases. The per-quad normals differ only by
+// a tiny offset, so that exact welding keeps the quads separate while welding with a tolerance
+// merges them. Every 8th column is a texture seam that stays split either way.
+void makeWeldVertex( unsigned int size, unsigned int index, Vertex &v )
+{
+	static const unsigned int cornerX[6] = { 0, 0, 1, 1, 0, 1 }, cornerY[6] = { 0, 1, 0, 0, 1, 1 };
+
+	unsigned int quad = index / 6, corner = index % 6;
+	unsigned int qx = quad % size, qy = quad / size;
+	unsigned int x = qx + cornerX[corner], y = qy + cornerY[corner];
+
+	float u = (float)x / size, w = (float)y / size;
+	float h = 0.1f * sinf( u * 12.0f ) * cosf( w * 9.0f );
+	float offset = (float)(quad & 7) * 1e-5f;
+
+	v.storedPos = Vec3f( u * 100.0f, h * 100.0f, w * 100.0f );
+	v.storedNormal = Vec3f( -h + offset, 0.99f, h * 0.5f );
+	v.texCoords[0] = Vec3f( (x % 8 == 0 && cornerX[corner] == 0) ? u + 0.5f : u, w, 0 );
+	v.daePosIndex = (int)(y * (size + 1) + x);
+}
+
+
+void benchVertexWeld( BenchRunner &runner )
+{
+	const unsigned int gridSize = 913;  // 913^2 quads with 6 indices are 5M indices
+	const unsigned int numIndices = gridSize * gridSize * 6;
+	const unsigned int chunkSize = 65536;
+
+	vector< Vertex > chunk( chunkSize );
+	const float tolerances[2] = { 0, 0.01f };
+	for( unsigned int t = 0; t < 2; ++t )
+	{
+		unsigned int numUnique = 0;
+		string params = "indices=" + to_string( numIndices ) + (tolerances[t] > 0 ? " tolerance=0.01" : " exact");
+
+		BenchResult *result = runner.run( "collada/weld", params, 5, [&]( BenchTimer &timer )
+		{
+			VertexWelder welder( tolerances[t], false );
+			welder.reserve( gridSize * gridSize * 4 );
+
+			// Generating the vertices is not measured; they are created in chunks to limit memory usage
+			for( unsigned int first = 0; first < numIndices; first += chunkSize )
+			{
+				unsigned int count = std::min( chunkSize, numIndices - first );
+				timer.stop();
+				for( unsigned int i = 0; i < count; ++i ) makeWeldVertex( gridSize, first + i, chunk[i] );
+				timer.start();
+
+				for( unsigned int i = 0; i < count; ++i ) welder.weld( chunk[i], first + i );
+			}
+			numUnique = welder.getNumUniqueVertices();
+		} );
+
+		runner.addCounter( result, "unique_vertices", numUnique );
+		if( result != 0x0 )
+			runner.addCounter( result, "Mindices_per_s", numIndices / 1e6 / (result->getPercentile( 50 ) / 1000.0) );
+	}
+}
+
+
+// *************************************************************************************************
+// Mesh optimization
+// *************************************************************************************************
+
+// Height field grid as produced by the converter after welding, with the triangles in random order
+// so that the post-transform vertex cache is used as badly as in unsorted exports
+void makeOptimizeGrid( unsigned int size, vector< Vertex > &vertices, vector< unsigned int > &indices )
+{
+	vertices.resize( (size + 1) * (size + 1) );
+	for( unsigned int y = 0; y <= size; ++y )
+	{
+		for( unsigned int x = 0; x <= size; ++x )
+		{
+			float u = (float)x / size, w = (float)y / size;
+			Vertex &v = vertices[y * (size + 1) + x];
+			v.pos = v.storedPos = Vec3f( u * 100.0f, 10.0f * sinf( u * 12.0f ) * cosf( w * 9.0f ), w * 100.0f );
+			v.normal = v.storedNormal = Vec3f( 0, 1, 0 );
+			v.texCoords[0] = Vec3f( u, w, 0 );
+			v.daePosIndex = (int)(y * (size + 1) + x);
+		}
+	}
+
+	unsigned int numTris = size * size * 2;
+	vector< unsigned int > triOrder( numTris );
+	for( unsigned int i = 0; i < numTris; ++i ) triOrder[i] = i;
+	BenchRandom random( 27 );
+	for( unsigned int i = numTris - 1; i > 0; --i ) swap( triOrder[i], triOrder[random.next() % (i + 1)] );
+
+	indices.resize( numTris * 3 );
+	for( unsigned int i = 0; i < numTris; ++i )
+	{
+		unsigned int quad = triOrder[i] / 2, x = quad % size, y = quad / size;
+		unsigned int i0 = y * (size + 1) + x, i1 = i0 + 1, i2 = i0 + size + 1, i3 = i2 + 1;
+		unsigned int *tri = &indices[i * 3];
+		if( triOrder[i] & 1 ) { tri[0] = i1; tri[1] = i2; tri[2] = i3; }
+		else { tri[0] = i0; tri[1] = i2; tri[2] = i1; }
+	}
+}
+
+
+void benchMeshOptimize( BenchRunner &runner )
+{
+	vector< unsigned int > sizes = runner.getScales( { 1024, 1448 } );  // 2M and 4M triangles
+	for( size_t i = 0; i < sizes.size(); ++i )
+	{
+		vector< Vertex > gridVertices, vertices;
+		vector< unsigned int > gridIndices, indices, vertMap;
+		makeOptimizeGrid( sizes[i], gridVertices, gridIndices );
+		unsigned int numTris = (unsigned int)gridIndices.size() / 3;
+
+		TriGroup triGroup;
+		triGroup.first = 0;
+		triGroup.count = (unsigned int)gridIndices.size();
+		triGroup.vertRStart = 0;
+		triGroup.vertREnd = (unsigned int)gridVertices.size() - 1;
+
+		float acmrBefore = 0, acmrAfter = 0;
+		BenchResult *result = runner.run( "collada/optimize", "triangles=" + to_string( numTris ), 3, [&]( BenchTimer &timer )
+		{
+			// Every iteration starts from the unoptimized mesh
+			timer.stop();
+			vertices = gridVertices;
+			indices = gridIndices;
+			acmrBefore = MeshOptimizer::calcCacheEfficiency( &triGroup, indices );
+			timer.start();
+
+			MeshOptimizer::optimizeIndexOrder( &triGroup, indices );
+			MeshOptimizer::optimizeOverdraw( &triGroup, vertices, indices );
+			MeshOptimizer::optimizeVertexFetch( &triGroup, vertices, indices, vertMap );
+
+			timer.stop();
+			acmrAfter = MeshOptimizer::calcCacheEfficiency( &triGroup, indices );
+		} );
+
+		if( result != 0x0 )
+		{
+			runner.addCounter( result, "acmr_before", acmrBefore );
+			runner.addCounter( result, "acmr_after", acmrAfter );
+			runner.addCounter( result, "Mtris_per_s", numTris / 1e6 / (result->getPercentile( 50 ) / 1000.0) );
+			if( !(acmrAfter < acmrBefore) )
+				runner.addFailure( "collada/optimize: optimization did not improve the ACMR" );
+		}
+	}
+}
+
+}  // namespace
+
+
+void runConverterBenchmarks( BenchRunner &runner )
+{
+	if( runner.isSelected( "collada/" ) )
+	{
+		benchColladaParse( runner );
+		benchVertexWeld( runner );
+		benchMeshOptimize( runner );
+	}
+}
+
+}  // namespace
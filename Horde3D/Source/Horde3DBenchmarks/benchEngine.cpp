@@ -0,0 +1,805 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "Horde3D.h"
+#include "Horde3DUtils.h"
+#include "egModules.h"
+#include "egScene.h"
+#include "egRenderer.h"
+#include "egTexture.h"
+#include "egTexStreaming.h"
+#include <cmath>
+#include <cstring>
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+using namespace Horde3D;
+
+namespace {
+
+string formatParams( const char *format, unsigned int a, unsigned int b = 0 )
+{
+	char str[128];
+	snprintf( str, sizeof( str ), format, a, b );
+	return str;
+}
+
+
+// Places count instances of a scene graph resource on a square grid in the xz-plane below a new
+// group node
+H3DNode addGrid( H3DRes sceneRes, unsigned int count, float spacing )
+{
+	H3DNode group = h3dAddGroupNode( H3DRootNode, "BenchGrid" );
+	unsigned int side = (unsigned int)ceil( sqrt( (double)count ) );
+	float offset = (side - 1) * spacing * 0.5f;
+
+	for( unsigned int i = 0; i < count; ++i )
+	{
+		H3DNode node = h3dAddNodes( group, sceneRes );
+		h3dSetNodeTransform( node, (i % side) * spacing - offset, 0, (i / side) * spacing - offset, 0, 0, 0, 1, 1, 1 );
+	}
+
+	return group;
+}
+
+
+// Creates a model with a grid of size x size quads in the xz-plane with a wavy height
+H3DNode addGridMesh( const char *name, unsigned int size, float extent, H3DRes materialRes )
+{
+	unsigned int numVerts = (size + 1) * (size + 1);
+	vector< float > positions( numVerts * 3 );
+	for( unsigned int y = 0; y <= size; ++y )
+	{
+		for( unsigned int x = 0; x <= size; ++x )
+		{
+			float *pos = &positions[(y * (size + 1) + x) * 3];
+			pos[0] = ((float)x / size - 0.5f) * extent;
+			pos[2] = ((float)y / size - 0.5f) * extent;
+			pos[1] = sinf( pos[0] * 0.3f ) * cosf( pos[2] * 0.2f ) * extent * 0.02f;
+		}
+	}
+
+	vector< unsigned int > indices;
+	indices.reserve( size * size * 6 );
+	for( unsigned int y = 0; y < size; ++y )
+	{
+		for( unsigned int x = 0; x < size; ++x )
+		{
+			unsigned int i = y * (size + 1) + x;
+			indices.push_back( i ); indices.push_back( i + size + 1 ); indices.push_back( i + 1 );
+			indices.push_back( i + 1 ); indices.push_back( i + size + 1 ); indices.push_back( i + size + 2 );
+		}
+	}
+
+	H3DRes geoRes = h3dutCreateGeometryRes( name, (int)numVerts, (int)indices.size(), &positions[0], &indices[0],
+	                                        0x0, 0x0, 0x0, 0x0, 0x0 );
+	H3DNode model = h3dAddModelNode( H3DRootNode, name, geoRes );
+	h3dAddMeshNode( model, name, materialRes, 0, 0, (int)indices.size(), 0, (int)numVerts - 1 );
+
+	return model;
+}
+
+
+void makeDownwardRays( vector< float > &rays, unsigned int count, float extent, BenchRandom &random )
+{
+	rays.resize( count * 6 );
+	for( unsigned int i = 0; i < count; ++i )
+	{
+		float *ray = &rays[i * 6];
+		ray[0] = random.nextFloat( -0.5f, 0.5f ) * extent;
+		ray[1] = 100.0f;
+		ray[2] = random.nextFloat( -0.5f, 0.5f ) * extent;
+		ray[3] = random.nextFloat( -0.2f, 0.2f ) * 200.0f;
+		ray[4] = -200.0f;
+		ray[5] = random.nextFloat( -0.2f, 0.2f ) * 200.0f;
+	}
+}
+
+
+// *************************************************************************************************
+// Scene graph
+// *************************************************************************************************
+
+void benchSceneGraph( BenchRunner &runner, H3DRes sphereRes, H3DRes pipeRes )
+{
+	vector< unsigned int > scales = runner.getScales( { 1000, 10000, 100000 } );
+	for( size_t i = 0; i < scales.size(); ++i )
+	{
+		unsigned int count = scales[i];
+
+		runner.run( "scene/build", formatParams( "nodes=%u", count ), 10, [&]( BenchTimer &timer )
+		{
+			H3DNode group = addGrid( sphereRes, count, 3.0f );
+			timer.stop();
+			h3dRemoveNode( group );
+		} );
+
+		// Moving all nodes requires the transformations and bounding boxes of the whole tree to be updated
+		if( !runner.isSelected( "scene/update" ) ) continue;
+
+		H3DNode group = addGrid( sphereRes, count, 3.0f );
+		float time = 0;
+		runner.run( "scene/update", formatParams( "nodes=%u", count ), 20, [&]( BenchTimer & )
+		{
+			time += 0.1f;
+			for( unsigned int j = 0; j < count; ++j )
+			{
+				H3DNode node = h3dGetNodeChild( group, (int)j );
+				float tx, ty, tz;
+				h3dGetNodeTransform( node, &tx, &ty, &tz, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0 );
+				h3dSetNodeTransform( node, tx, sinf( time + tx ), tz, 0, time * 10.0f, 0, 1, 1, 1 );
+			}
+			Modules::sceneMan().updateNodes();
+		} );
+		h3dRemoveNode( group );
+	}
+
+	// Views are culled in a single pass over the spatial graph like the shadow views of a frame
+	vector< unsigned int > cullScales = runner.getScales( { 10000, 100000 } );
+	vector< unsigned int > viewScales = runner.getScales( { 1, 8, 64 } );
+	if( !runner.isSelected( "scene/cull" ) ) return;
+
+	SceneManager &sceneMan = Modules::sceneMan();
+	H3DNode cam = h3dAddCameraNode( H3DRootNode, "BenchCamera", pipeRes );
+	SceneNode *camNode = sceneMan.resolveNodeHandle( cam );
+
+	for( size_t i = 0; i < cullScales.size(); ++i )
+	{
+		unsigned int count = cullScales[i];
+		float extent = ceil( sqrtf( (float)count ) ) * 4.0f;
+		H3DNode group = addGrid( sphereRes, count, 4.0f );
+		sceneMan.updateNodes();
+
+		for( size_t j = 0; j < viewScales.size(); ++j )
+		{
+			unsigned int numViews = viewScales[j];
+
+			BenchRandom random( 7 );
+			vector< Frustum > frustums( numViews );
+			for( unsigned int k = 0; k < numViews; ++k )
+			{
+				Matrix4f mat = Matrix4f::TransMat( random.nextFloat( -0.5f, 0.5f ) * extent, 20.0f,
+				                                   random.nextFloat( -0.5f, 0.5f ) * extent ) *
+				               Matrix4f::RotMat( degToRad( -20.0f ), random.nextFloat( 0, 2 * Math::Pi ), 0 );
+				frustums[k].buildViewFrustum( mat, 45.0f, 16.0f / 9.0f, 0.5f, 300.0f );
+			}
+
+			size_t numVisible = 0;
+			BenchResult *result = runner.run( "scene/cull", formatParams( "nodes=%u views=%u", count, numViews ), 20,
+				[&]( BenchTimer & )
+			{
+				sceneMan.clearRenderViews();
+				for( unsigned int k = 0; k < numViews; ++k )
+					sceneMan.addRenderView( RenderViewType::Camera, camNode, frustums[k] );
+				sceneMan.updateQueues( SceneNodeFlags::NoDraw, true );
+
+				numVisible = 0;
+				for( unsigned int k = 0; k < numViews; ++k )
+					numVisible += sceneMan.getRenderViews()[k].objects.size();
+			} );
+			runner.addCounter( result, "visible_per_view", (double)numVisible / numViews );
+		}
+
+		sceneMan.clearRenderViews();
+		h3dRemoveNode( group );
+	}
+
+	h3dRemoveNode( cam );
+}
+
+
+// *************************************************************************************************
+// Animation
+// *************************************************************************************************
+
+void benchAnimation( BenchRunner &runner, H3DRes knightRes, H3DRes anim1Res, H3DRes anim2Res )
+{
+	vector< unsigned int > scales = runner.getScales( { 10, 100, 1000 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "anim/blend" ); ++i )
+	{
+		unsigned int count = scales[i];
+		H3DNode group = addGrid( knightRes, count, 3.0f );
+		for( unsigned int j = 0; j < count; ++j )
+		{
+			H3DNode model = h3dGetNodeChild( group, (int)j );
+			h3dSetupModelAnimStage( model, 0, anim1Res, 0, "", false );
+			h3dSetupModelAnimStage( model, 1, anim2Res, 0, "", false );
+		}
+
+		float time = 0;
+		runner.run( "anim/blend", formatParams( "models=%u", count ), 20, [&]( BenchTimer & )
+		{
+			time += 0.5f;
+			for( unsigned int j = 0; j < count; ++j )
+			{
+				H3DNode model = h3dGetNodeChild( group, (int)j );
+				float weight = 0.5f + 0.5f * sinf( time * 0.1f + j );
+				h3dSetModelAnimParams( model, 0, time + j, weight );
+				h3dSetModelAnimParams( model, 1, time + j, 1.0f - weight );
+				h3dUpdateModel( model, H3DModelUpdateFlags::Animation );
+			}
+		} );
+		h3dRemoveNode( group );
+	}
+
+	scales = runner.getScales( { 1, 10, 100 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "anim/skinning" ); ++i )
+	{
+		unsigned int count = scales[i];
+		H3DNode group = addGrid( knightRes, count, 3.0f );
+		for( unsigned int j = 0; j < count; ++j )
+		{
+			H3DNode model = h3dGetNodeChild( group, (int)j );
+			h3dSetNodeParamI( model, H3DModel::SWSkinningI, 1 );
+			h3dSetupModelAnimStage( model, 0, anim1Res, 0, "", false );
+		}
+
+		float time = 0;
+		runner.run( "anim/skinning", formatParams( "models=%u", count ), 20, [&]( BenchTimer & )
+		{
+			time += 0.5f;
+			for( unsigned int j = 0; j < count; ++j )
+			{
+				H3DNode model = h3dGetNodeChild( group, (int)j );
+				h3dSetModelAnimParams( model, 0, time + j, 1.0f );
+				h3dUpdateModel( model, H3DModelUpdateFlags::Animation | H3DModelUpdateFlags::Geometry );
+			}
+		} );
+		h3dRemoveNode( group );
+	}
+}
+
+
+// *************************************************************************************************
+// Particles
+// *************************************************************************************************
+
+void benchParticles( BenchRunner &runner, H3DRes matRes, H3DRes effectRes )
+{
+	const unsigned int particlesPerEmitter = 1000;
+	const float timeDelta = 1.0f / 60.0f;
+
+	vector< unsigned int > scales = runner.getScales( { 1000, 10000, 100000 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "particles/update" ); ++i )
+	{
+		unsigned int numEmitters = scales[i] / particlesPerEmitter;
+
+		srand( 1 );
+		H3DNode group = h3dAddGroupNode( H3DRootNode, "BenchEmitters" );
+		vector< H3DNode > emitters( numEmitters );
+		for( unsigned int j = 0; j < numEmitters; ++j )
+		{
+			emitters[j] = h3dAddEmitterNode( group, "BenchEmitter", matRes, effectRes, particlesPerEmitter, -1 );
+			h3dSetNodeParamF( emitters[j], H3DEmitter::EmissionRateF, 0, (float)particlesPerEmitter );
+			h3dSetNodeParamF( emitters[j], H3DEmitter::SpreadAngleF, 0, 45.0f );
+			h3dSetNodeTransform( emitters[j], (float)(j % 10) * 5.0f, 0, (float)(j / 10) * 5.0f, 0, 0, 0, 1, 1, 1 );
+		}
+
+		// Run until the emitters are saturated
+		for( unsigned int frame = 0; frame < 120; ++frame )
+		{
+			for( unsigned int j = 0; j < numEmitters; ++j ) h3dUpdateEmitter( emitters[j], timeDelta );
+		}
+
+		runner.run( "particles/update", formatParams( "particles=%u emitters=%u", scales[i], numEmitters ), 20,
+			[&]( BenchTimer & )
+		{
+			for( unsigned int j = 0; j < numEmitters; ++j ) h3dUpdateEmitter( emitters[j], timeDelta );
+		} );
+		h3dRemoveNode( group );
+	}
+}
+
+
+// *************************************************************************************************
+// Loading
+// *************************************************************************************************
+
+void benchLoadFile( BenchRunner &runner, const char *name, int resType, const char *fileName )
+{
+	if( !runner.isSelected( name ) ) return;
+
+	vector< char > data;
+	if( !readFile( runner.getConfig().contentDir + "/" + fileName, data ) )
+	{
+		fprintf( stderr, "Failed to read '%s' from the content directory\n", fileName );
+		return;
+	}
+
+	unsigned int counter = 0;
+	BenchResult *result = runner.run( name, string( "file=" ) + fileName, 20, [&]( BenchTimer &timer )
+	{
+		char resName[64];
+		snprintf( resName, sizeof( resName ), "BenchLoad%u", counter++ );
+		H3DRes res = h3dAddResource( resType, resName, 0 );
+		h3dLoadResource( res, &data[0], (int)data.size() );
+		timer.stop();
+
+		h3dRemoveResource( res );
+		h3dReleaseUnusedResources();
+	} );
+	runner.addCounter( result, "MB_per_s", result ? data.size() / (result->getPercentile( 50 ) * 1000.0) : 0 );
+}
+
+
+void benchLoading( BenchRunner &runner )
+{
+	benchLoadFile( runner, "load/geometry", H3DResTypes::Geometry, "models/sphere/sphere.geo" );
+	benchLoadFile( runner, "load/geometry", H3DResTypes::Geometry, "models/man/man.geo" );
+	benchLoadFile( runner, "load/geometry", H3DResTypes::Geometry, "models/knight/knight.geo" );
+	benchLoadFile( runner, "load/animation", H3DResTypes::Animation, "animations/man.anim" );
+	benchLoadFile( runner, "load/animation", H3DResTypes::Animation, "animations/knight_order.anim" );
+	benchLoadFile( runner, "load/scene", H3DResTypes::SceneGraph, "models/knight/knight.scene.xml" );
+	benchLoadFile( runner, "load/scene", H3DResTypes::SceneGraph, "models/man/man.scene.xml" );
+	benchLoadFile( runner, "load/material", H3DResTypes::Material, "models/knight/knight.material.xml" );
+
+	// Synthetic geometry of several sizes; includes building the geometry data in memory
+	vector< unsigned int > scales = runner.getScales( { 64, 256, 1024 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "load/grid_geometry" ); ++i )
+	{
+		unsigned int size = scales[i];
+		unsigned int numVerts = (size + 1) * (size + 1);
+		vector< float > positions( numVerts * 3 ), texCoords( numVerts * 2 );
+		vector< short > normals( numVerts * 3, 0 );
+		for( unsigned int j = 0; j < numVerts; ++j )
+		{
+			positions[j * 3 + 0] = (float)(j % (size + 1));
+			positions[j * 3 + 2] = (float)(j / (size + 1));
+			texCoords[j * 2 + 0] = positions[j * 3 + 0] / size;
+			texCoords[j * 2 + 1] = positions[j * 3 + 2] / size;
+			normals[j * 3 + 1] = 32767;
+		}
+		vector< unsigned int > indices;
+		indices.reserve( size * size * 6 );
+		for( unsigned int j = 0; j < size * size; ++j )
+		{
+			unsigned int v = (j / size) * (size + 1) + j % size;
+			indices.push_back( v ); indices.push_back( v + size + 1 ); indices.push_back( v + 1 );
+			indices.push_back( v + 1 ); indices.push_back( v + size + 1 ); indices.push_back( v + size + 2 );
+		}
+
+		unsigned int counter = 0;
+		runner.run( "load/grid_geometry", formatParams( "quads=%ux%u", size, size ), 10, [&]( BenchTimer &timer )
+		{
+			char resName[64];
+			snprintf( resName, sizeof( resName ), "BenchGridGeo%u", counter++ );
+			H3DRes res = h3dutCreateGeometryRes( resName, (int)numVerts, (int)indices.size(), &positions[0],
+			                                     &indices[0], &normals[0], 0x0, 0x0, &texCoords[0], 0x0 );
+			timer.stop();
+
+			h3dRemoveResource( res );
+			h3dReleaseUnusedResources();
+		} );
+	}
+}
+
+
+// *************************************************************************************************
+// Ray casts
+// *************************************************************************************************
+
+void benchRayCasts( BenchRunner &runner, H3DRes sphereRes, H3DRes matRes )
+{
+	const unsigned int numRays = 10000;
+
+	vector< unsigned int > scales = runner.getScales( { 1000, 10000 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "rays/" ); ++i )
+	{
+		unsigned int count = scales[i];
+		float extent = ceil( sqrtf( (float)count ) ) * 3.0f;
+		H3DNode group = addGrid( sphereRes, count, 3.0f );
+
+		BenchRandom random( 3 );
+		vector< float > rays;
+		makeDownwardRays( rays, numRays, extent, random );
+		vector< H3DRayHit > hits( numRays );
+
+		int numHits = 0;
+		BenchResult *result = runner.run( "rays/nodes", formatParams( "nodes=%u rays=%u", count, numRays ), 20,
+			[&]( BenchTimer & )
+		{
+			numHits = h3dCastRays( group, &rays[0], (int)numRays, &hits[0], 0 );
+		} );
+		runner.addCounter( result, "hits", numHits );
+
+		// Single queries return the results through h3dGetCastRayResult
+		const unsigned int numSingleRays = 1000;
+		runner.run( "rays/single", formatParams( "nodes=%u rays=%u", count, numSingleRays ), 10,
+			[&]( BenchTimer & )
+		{
+			for( unsigned int j = 0; j < numSingleRays; ++j )
+			{
+				const float *ray = &rays[j * 6];
+				h3dCastRay( group, ray[0], ray[1], ray[2], ray[3], ray[4], ray[5], 1 );
+			}
+		} );
+
+		h3dRemoveNode( group );
+	}
+
+	// Large meshes use the triangle hierarchy of the geometry, which is built by the warm-up run
+	scales = runner.getScales( { 128, 512 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "rays/mesh" ); ++i )
+	{
+		unsigned int size = scales[i];
+		char name[64];
+		snprintf( name, sizeof( name ), "BenchRayMesh%u", size );
+		H3DNode model = addGridMesh( name, size, 200.0f, matRes );
+
+		BenchRandom random( 5 );
+		vector< float > rays;
+		makeDownwardRays( rays, numRays, 200.0f, random );
+		vector< H3DRayHit > hits( numRays );
+
+		int numHits = 0;
+		BenchResult *result = runner.run( "rays/mesh", formatParams( "triangles=%u rays=%u", size * size * 2, numRays ),
+			20, [&]( BenchTimer & )
+		{
+			numHits = h3dCastRays( model, &rays[0], (int)numRays, &hits[0], 0 );
+		} );
+		runner.addCounter( result, "hits", numHits );
+
+		H3DRes geoRes = h3dGetNodeParamI( model, H3DModel::GeoResI );
+		h3dRemoveNode( model );
+		h3dRemoveResource( geoRes );
+	}
+	h3dReleaseUnusedResources();
+}
+
+
+
+// *************************************************************************************************
+// Texture streaming
+// *************************************************************************************************
+
+// Square texture with 4 bytes per pixel and a full mip chain
+TexResidencyItem makeResidencyItem( uint32 size, uint32 floorLevel, uint32 desiredLevel, float priority )
+{
+	TexResidencyItem item;
+	for( ; size > 0 && item.numLevels < MaxStreamedMipLevels; size /= 2 )
+		item.levelSizes[item.numLevels++] = size * size * 4;
+	item.floorLevel = floorLevel;
+	item.desiredLevel = desiredLevel;
+	item.priority = priority;
+	return item;
+}
+
+
+uint64 calcResidentSize( const vector< TexResidencyItem > &items )
+{
+	uint64 size = 0;
+	for( size_t i = 0; i < items.size(); ++i ) size += items[i].calcChainSize( items[i].targetLevel );
+	return size;
+}
+
+
+// Checks the decisions of the residency policy: textures get their desired levels when the budget
+// allows it, less important textures lose levels first when it is exceeded and no texture is
+// evicted below its floor level
+void benchResidencyPolicy( BenchRunner &runner )
+{
+	if( !runner.isSelected( "streaming/residency_policy" ) ) return;
+
+	// Two textures of 1024 pixels that differ only in priority; level 4 with 64 pixels is the floor
+	vector< TexResidencyItem > items;
+	items.push_back( makeResidencyItem( 1024, 4, 0, 1000.0f ) );
+	items.push_back( makeResidencyItem( 1024, 4, 2, 10.0f ) );
+	uint64 fullSize = items[0].calcChainSize( 0 );
+
+	float pressure = TexResidencyPolicy::solve( items, fullSize * 2 );
+	if( items[0].targetLevel != 0 || items[1].targetLevel != 2 || pressure > 1.0f )
+		runner.addFailure( "streaming/residency_policy: textures do not get their desired levels within the budget" );
+
+	// Room for the full chain of one texture and levels 3 and below of the other
+	items[1].desiredLevel = 0;
+	uint64 budget = fullSize + items[1].calcChainSize( 3 );
+	pressure = TexResidencyPolicy::solve( items, budget );
+	if( calcResidentSize( items ) > budget || pressure <= 1.0f )
+		runner.addFailure( "streaming/residency_policy: resident levels exceed the budget" );
+	if( items[0].targetLevel != 0 || items[1].targetLevel != 3 )
+	{
+		runner.addFailure( "streaming/residency_policy: evicted levels " + to_string( items[0].targetLevel ) + " and " +
+		                   to_string( items[1].targetLevel ) + " instead of the less important texture first" );
+	}
+
+	// The floor levels stay resident even when they exceed the budget
+	pressure = TexResidencyPolicy::solve( items, items[0].calcChainSize( 4 ) );
+	if( items[0].targetLevel != 4 || items[1].targetLevel != 4 || pressure <= 1.0f )
+		runner.addFailure( "streaming/residency_policy: textures were not kept at their floor level" );
+
+	vector< unsigned int > scales = runner.getScales( { 1000, 10000 } );
+	for( size_t i = 0; i < scales.size(); ++i )
+	{
+		// Random sizes, usages and priorities with a budget of a quarter of the demand
+		BenchRandom random;
+		vector< TexResidencyItem > randomItems( scales[i] );
+		uint64 demand = 0, floorSize = 0;
+		for( unsigned int j = 0; j < scales[i]; ++j )
+		{
+			uint32 size = 64u << (random.next() % 6);
+			uint32 floorLevel = (uint32)log2f( size / 64.0f );
+			randomItems[j] = makeResidencyItem( size, floorLevel, random.next() % (floorLevel + 1),
+			                                    (float)(random.next() % 2048) );
+			demand += randomItems[j].calcChainSize( randomItems[j].desiredLevel );
+			floorSize += randomItems[j].calcChainSize( floorLevel );
+		}
+		budget = std::max( demand / 4, floorSize );
+
+		runner.run( "streaming/residency_policy", formatParams( "textures=%u", scales[i] ), 20, [&]( BenchTimer & )
+		{
+			TexResidencyPolicy::solve( randomItems, budget );
+		} );
+
+		if( calcResidentSize( randomItems ) > budget )
+			runner.addFailure( "streaming/residency_policy: resident levels of " + to_string( scales[i] ) +
+			                   " textures exceed the budget" );
+	}
+}
+
+
+// Uncompressed 32 bit TGA image with a pattern, so that the mip levels are generated on the CPU
+vector< char > makeTGAImage( unsigned int size )
+{
+	vector< char > data( 18 + size * size * 4 );
+	data[2] = 2;  // Uncompressed true color
+	data[12] = (char)(size & 0xFF);
+	data[13] = (char)(size >> 8);
+	data[14] = (char)(size & 0xFF);
+	data[15] = (char)(size >> 8);
+	data[16] = 32;
+	data[17] = 0x28;  // 8 alpha bits, origin at top left
+
+	for( unsigned int i = 0; i < size * size; ++i )
+	{
+		char *pixel = &data[18 + i * 4];
+		pixel[0] = (char)(i % size);
+		pixel[1] = (char)(i / size);
+		pixel[2] = (char)((i % size) ^ (i / size));
+		pixel[3] = (char)0xFF;
+	}
+
+	return data;
+}
+
+
+// Runs the streamer on textures with decreasing screen-space sizes: the resident memory has to stay
+// within the budget, textures with a larger size must not have coarser levels than the others and
+// raising the budget has to make all desired levels resident again
+void benchTexStreaming( BenchRunner &runner )
+{
+	if( !runner.isSelected( "streaming/budget" ) ) return;
+
+	const int numTextures = 8;
+	const unsigned int texSize = 512;
+	const int budgetMb = 2;
+	TextureStreamer &streamer = Modules::renderer().getTexStreamer();
+
+	h3dSetOption( H3DOptions::TexStreamingBudget, (float)budgetMb );
+	h3dSetOption( H3DOptions::TexMipmapFilter, 1 );
+
+	vector< char > image = makeTGAImage( texSize );
+	H3DRes texRes[numTextures];
+	TextureResource *textures[numTextures];
+	float screenSizes[numTextures];
+	bool loaded = true;
+	for( int i = 0; i < numTextures; ++i )
+	{
+		texRes[i] = h3dAddResource( H3DResTypes::Texture, ("BenchStream" + to_string( i ) + ".tga").c_str(), 0 );
+		h3dLoadResource( texRes[i], &image[0], (int)image.size() );
+		textures[i] = (TextureResource *)Modules::resMan().resolveResHandle( texRes[i] );
+		screenSizes[i] = (float)(2 * texSize >> i);
+		loaded = loaded && h3dIsResLoaded( texRes[i] ) && textures[i]->isStreamed();
+	}
+
+	auto noteUsage = [&]()
+	{
+		for( int i = 0; i < numTextures; ++i ) textures[i]->noteStreamUsage( screenSizes[i] );
+		h3dFinalizeFrame();
+	};
+
+	if( !loaded )
+	{
+		runner.addFailure( "streaming/budget: failed to load the streamed textures" );
+	}
+	else
+	{
+		runner.run( "streaming/budget", formatParams( "textures=%u budget_mb=%u", numTextures, budgetMb ), 20,
+		            [&]( BenchTimer & ) { noteUsage(); } );
+
+		const uint64 budget = (uint64)budgetMb * 1024 * 1024;
+		if( streamer.getResidentMem() > budget || streamer.getPressure() <= 1.0f )
+		{
+			runner.addFailure( "streaming/budget: " + to_string( streamer.getResidentMem() ) +
+			                   " bytes are resident with a budget of " + to_string( budget ) );
+		}
+		for( int i = 1; i < numTextures; ++i )
+		{
+			if( textures[i]->getResidentMip() < textures[i - 1]->getResidentMip() )
+			{
+				runner.addFailure( "streaming/budget: texture " + to_string( i ) +
+				                   " has finer levels than a texture with a larger screen-space size" );
+				break;
+			}
+		}
+
+		// All desired levels fit into the larger budget; the upload limit per frame allows this in one frame
+		h3dSetOption( H3DOptions::TexStreamingBudget, 64 );
+		noteUsage();
+		for( int i = 0; i < numTextures; ++i )
+		{
+			uint32 desiredLevel = TextureStreamer::calcDesiredLevel( texSize, texSize, textures[i]->getStreamFloorMip(),
+			                                                         screenSizes[i] );
+			if( textures[i]->getResidentMip() != desiredLevel )
+			{
+				runner.addFailure( "streaming/budget: texture " + to_string( i ) + " has level " +
+				                   to_string( textures[i]->getResidentMip() ) + " resident instead of " +
+				                   to_string( desiredLevel ) + " after raising the budget" );
+				break;
+			}
+		}
+
+		// Levels are released without limit in the frame the budget is lowered again
+		h3dSetOption( H3DOptions::TexStreamingBudget, (float)budgetMb );
+		noteUsage();
+		if( streamer.getResidentMem() > budget )
+			runner.addFailure( "streaming/budget: resident memory exceeds the budget after lowering it" );
+
+		// Disabling streaming makes the full mip chains of the loaded textures resident again
+		h3dSetOption( H3DOptions::TexStreamingBudget, 0 );
+		noteUsage();
+		for( int i = 0; i < numTextures; ++i )
+		{
+			if( textures[i]->getResidentMip() != 0 )
+			{
+				runner.addFailure( "streaming/budget: texture " + to_string( i ) + " has level " +
+				                   to_string( textures[i]->getResidentMip() ) + " resident after disabling streaming" );
+				break;
+			}
+		}
+	}
+
+	for( int i = 0; i < numTextures; ++i ) h3dRemoveResource( texRes[i] );
+	h3dReleaseUnusedResources();
+	h3dSetOption( H3DOptions::TexMipmapFilter, 0 );
+	h3dSetOption( H3DOptions::TexStreamingBudget, 0 );
+}
+
+
+// *************************************************************************************************
+// Pipelines
+// *************************************************************************************************
+
+// The null render device uses the OpenGL4 contexts
+const char *QuadShader =
+	"[[FX]]\n"
+	"sampler2D buf0 = sampler_state { Address = Clamp; };\n"
+	"OpenGL4 {\n"
+	"context OPAQUE { VertexShader = compile GLSL VS; PixelShader = compile GLSL FS; ZWriteEnable = false; }\n"
+	"context BLEND { VertexShader = compile GLSL VS; PixelShader = compile GLSL FS; ZWriteEnable = false; BlendMode = Add; }\n"
+	"}\n"
+	"[[VS]]\nvoid main() {}\n"
+	"[[FS]]\nvoid main() {}\n";
+
+// Stage Feedback reads target B before it is written, stages A and B then fill targets of the same
+// format one after another
+const char *AliasingPipeline =
+	"<Pipeline><Setup>\n"
+	"<RenderTarget id=\"A\" depthBuf=\"false\" numColBufs=\"1\" format=\"RGBA8\" scale=\"1.0\" />\n"
+	"<RenderTarget id=\"B\" depthBuf=\"false\" numColBufs=\"1\" format=\"RGBA8\" scale=\"1.0\" />\n"
+	"</Setup><CommandQueue>\n"
+	"<Stage id=\"Feedback\"><SwitchTarget target=\"\" /><BindBuffer sampler=\"buf0\" sourceRT=\"B\" bufIndex=\"0\" />\n"
+	"<DrawQuad material=\"BenchQuad.material.xml\" context=\"OPAQUE\" /><UnbindBuffers /></Stage>\n"
+	"<Stage id=\"A\"><SwitchTarget target=\"A\" /><DrawQuad material=\"BenchQuad.material.xml\" context=\"OPAQUE\" /></Stage>\n"
+	"<Stage id=\"B\"><SwitchTarget target=\"B\" /><DrawQuad material=\"BenchQuad.material.xml\" context=\"%s\" /></Stage>\n"
+	"</CommandQueue></Pipeline>\n";
+
+int getGPUMemory( H3DRes res )
+{
+	return h3dGetResParamI( res, H3DResMem::MemoryElem, 0, H3DResMem::GPUMemoryI );
+}
+
+
+// Checks that targets only share memory when their lifetimes allow it: a target that is read before
+// it is written or that is blended onto keeps its contents, and toggling stages updates the lifetimes
+void benchTargetAliasing( BenchRunner &runner )
+{
+	if( !runner.isSelected( "pipeline/target_aliasing" ) ) return;
+
+	h3dSetOption( H3DOptions::RenderTargetAliasing, 1 );
+
+	H3DRes shaderRes = h3dAddResource( H3DResTypes::Shader, "BenchQuad.shader", 0 );
+	h3dLoadResource( shaderRes, QuadShader, (int)strlen( QuadShader ) );
+	const char *material = "<Material><Shader source=\"BenchQuad.shader\" /></Material>";
+	H3DRes matRes = h3dAddResource( H3DResTypes::Material, "BenchQuad.material.xml", 0 );
+	h3dLoadResource( matRes, material, (int)strlen( material ) );
+
+	H3DRes pipeRes[2];
+	H3DNode cams[2];
+	const char *contexts[2] = { "OPAQUE", "BLEND" };
+	const char *names[2] = { "BenchAliasingOpaque.pipeline.xml", "BenchAliasingBlend.pipeline.xml" };
+	for( int i = 0; i < 2; ++i )
+	{
+		char xml[2048];
+		snprintf( xml, sizeof( xml ), AliasingPipeline, contexts[i] );
+		pipeRes[i] = h3dAddResource( H3DResTypes::Pipeline, names[i], 0 );
+		h3dLoadResource( pipeRes[i], xml, (int)strlen( xml ) );
+		cams[i] = h3dAddCameraNode( H3DRootNode, "BenchAliasingCamera", pipeRes[i] );
+	}
+
+	if( !h3dIsResLoaded( shaderRes ) || !h3dIsResLoaded( matRes ) || !h3dIsResLoaded( pipeRes[0] ) ||
+	    !h3dIsResLoaded( pipeRes[1] ) )
+	{
+		runner.addFailure( "pipeline/target_aliasing: failed to load the test resources" );
+	}
+	else
+	{
+		// Both targets are in use at the same time while the feedback stage reads B
+		h3dRender( cams[0] );
+		int bothMem = getGPUMemory( pipeRes[0] );
+
+		h3dSetResParamI( pipeRes[0], H3DPipeRes::StageElem, 0, H3DPipeRes::StageActivationI, 0 );
+		h3dSetResParamI( pipeRes[1], H3DPipeRes::StageElem, 0, H3DPipeRes::StageActivationI, 0 );
+		runner.run( "pipeline/target_aliasing", "targets=2", 20, [&]( BenchTimer & )
+		{
+			h3dRender( cams[0] );
+			h3dRender( cams[1] );
+			h3dFinalizeFrame();
+		} );
+
+		if( getGPUMemory( pipeRes[0] ) * 2 != bothMem )
+			runner.addFailure( "pipeline/target_aliasing: targets do not share memory after disabling the feedback stage" );
+		if( getGPUMemory( pipeRes[1] ) != bothMem )
+			runner.addFailure( "pipeline/target_aliasing: a target that is blended onto shares memory" );
+	}
+
+	h3dRemoveNode( cams[0] );
+	h3dRemoveNode( cams[1] );
+	h3dRemoveResource( pipeRes[0] );
+	h3dRemoveResource( pipeRes[1] );
+	h3dRemoveResource( matRes );
+	h3dRemoveResource( shaderRes );
+	h3dReleaseUnusedResources();
+	h3dSetOption( H3DOptions::RenderTargetAliasing, 0 );
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+
+void runEngineBenchmarks( BenchRunner &runner )
+{
+	H3DRes pipeRes = loadContent( runner, H3DResTypes::Pipeline, "pipelines/forward.pipeline.xml" );
+	H3DRes sphereRes = loadContent( runner, H3DResTypes::SceneGraph, "models/sphere/sphere.scene.xml" );
+	H3DRes knightRes = loadContent( runner, H3DResTypes::SceneGraph, "models/knight/knight.scene.xml" );
+	H3DRes anim1Res = loadContent( runner, H3DResTypes::Animation, "animations/knight_order.anim" );
+	H3DRes anim2Res = loadContent( runner, H3DResTypes::Animation, "animations/knight_attack.anim" );
+	H3DRes partMatRes = loadContent( runner, H3DResTypes::Material, "particles/particleSys1/particle1.material.xml" );
+	H3DRes partEffectRes = loadContent( runner, H3DResTypes::ParticleEffect, "particles/particleSys1/particle1.particle.xml" );
+	H3DRes stonesRes = loadContent( runner, H3DResTypes::Material, "models/sphere/stones.material.xml" );
+	if( !pipeRes || !sphereRes || !knightRes || !anim1Res || !anim2Res || !partMatRes || !partEffectRes || !stonesRes )
+		return;
+
+	benchSceneGraph( runner, sphereRes, pipeRes );
+	benchAnimation( runner, knightRes, anim1Res, anim2Res );
+	benchParticles( runner, partMatRes, partEffectRes );
+	benchLoading( runner );
+	benchRayCasts( runner, sphereRes, stonesRes );
+	benchResidencyPolicy( runner );
+	benchTexStreaming( runner );
+	benchTargetAliasing( runner );
+}
+
+}  // namespace
@@ -0,0 +1,299 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "Horde3D.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifdef HORDE3D_BENCH_OVERLAYS
+#	include "Horde3DOverlays.h"
+#endif
+#ifdef HORDE3D_BENCH_TERRAIN
+#	include "Horde3DTerrain.h"
+#	include "egModules.h"
+#	include "terrain.h"
+#endif
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+
+namespace {
+
+#ifdef HORDE3D_BENCH_OVERLAYS
+
+// *************************************************************************************************
+// Overlays
+// *************************************************************************************************
+
+const int LabelChars = 16;
+
+void benchOverlays( BenchRunner &runner )
+{
+	H3DRes fontMatRes = loadContent( runner, H3DResTypes::Material, "overlays/font.material.xml" );
+	if( fontMatRes == 0 ) return;
+
+	vector< unsigned int > labelCounts = runner.getScales( { 1000, 5000 } );
+	for( size_t i = 0; i < labelCounts.size(); ++i )
+	{
+		int numLabels = (int)labelCounts[i];
+		string params = "labels=" + to_string( numLabels );
+
+		int layer = h3dCreateOverlayLayer( numLabels * LabelChars * 4 );
+		if( layer == 0 ) continue;
+
+		vector< int > firstVerts( numLabels );
+		char text[LabelChars + 1];
+
+		runner.run( "overlays/add_labels", params, 20, [&]( BenchTimer &timer )
+		{
+			timer.stop();
+			h3dClearOverlayLayer( layer );
+			timer.start();
+
+			for( int j = 0; j < numLabels; ++j )
+			{
+				snprintf( text, sizeof( text ), "Label %d", j );
+				firstVerts[j] = h3dAddOverlayLayerText( layer, text, LabelChars, (j % 50) * 0.02f,
+				                                        (j / 50) * 0.01f, 0.02f, 1, 1, 1, fontMatRes );
+			}
+		} );
+
+		// Make sure the labels exist when only the update is selected
+		if( !runner.isSelected( "overlays/add_labels" ) )
+		{
+			for( int j = 0; j < numLabels; ++j )
+				firstVerts[j] = h3dAddOverlayLayerText( layer, "", LabelChars, 0, 0, 0.02f, 1, 1, 1, fontMatRes );
+		}
+
+		// Typical HUD usage: changing values of labels that keep their layout
+		int frame = 0;
+		runner.run( "overlays/update_labels", params, 50, [&]( BenchTimer & )
+		{
+			for( int j = 0; j < numLabels; ++j )
+			{
+				snprintf( text, sizeof( text ), "Value %d", frame * j );
+				h3dUpdateOverlayLayerText( layer, firstVerts[j], LabelChars, text, (j % 50) * 0.02f,
+				                           (j / 50) * 0.01f, 0.02f );
+			}
+			++frame;
+		} );
+
+		h3dDestroyOverlayLayer( layer );
+	}
+
+	// Immediate mode text is limited by the per-frame overlay vertex budget, so the same HUD can only
+	// be shown in part
+	const int numTexts = 100;
+	runner.run( "overlays/show_text", "labels=" + to_string( numTexts ), 100, [&]( BenchTimer & )
+	{
+		char text[LabelChars + 1];
+		for( int j = 0; j < numTexts; ++j )
+		{
+			snprintf( text, sizeof( text ), "Label %d", j );
+			h3dShowText( text, (j % 50) * 0.02f, (j / 50) * 0.01f, 0.02f, 1, 1, 1, fontMatRes );
+		}
+		h3dClearOverlays();
+	} );
+}
+
+#endif  // HORDE3D_BENCH_OVERLAYS
+
+
+#ifdef HORDE3D_BENCH_TERRAIN
+
+// *************************************************************************************************
+// Terrain tile streaming
+// *************************************************************************************************
+
+using namespace Horde3DTerrain;
+
+const uint32 TileSize = 64;
+const uint32 BlockSize = 17;
+const uint32 MaxResidentTiles = 12;
+const float TileExtent = 100.0f;    // In world units
+const float CamAltitude = 2.0f;     // Above the ground
+
+// The null render device uses the OpenGL4 contexts
+const char *TerrainShader =
+	"[[FX]]\n"
+	"OpenGL4 {\n"
+	"context TERRAIN { VertexShader = compile GLSL VS; PixelShader = compile GLSL FS; }\n"
+	"}\n"
+	"[[VS]]\nvoid main() {}\n"
+	"[[FS]]\nvoid main() {}\n";
+
+const char *TerrainPipeline =
+	"<Pipeline><CommandQueue><Stage id=\"Terrain\">\n"
+	"<SwitchTarget target=\"\" /><ClearTarget depthBuf=\"true\" /><DrawGeometry context=\"TERRAIN\" />\n"
+	"</Stage></CommandQueue></Pipeline>\n";
+
+// Bytes allocated by the tiles that are resident in the cache
+size_t calcTileAllocations( const TerrainTileCache &cache )
+{
+	size_t size = 0;
+	for( uint32 y = 0; y < cache.getTilesPerSide(); ++y )
+	{
+		for( uint32 x = 0; x < cache.getTilesPerSide(); ++x )
+		{
+			const TerrainTile *tile = cache.getTile( x, y );
+			if( tile == 0x0 ) continue;
+			size += tile->heights.capacity() * sizeof( uint16 ) + tile->blockTree.capacity() * sizeof( BlockInfo );
+		}
+	}
+	return size;
+}
+
+
+H3DRes loadBenchResource( int type, const char *name, const char *data )
+{
+	H3DRes res = h3dAddResource( type, name, 0 );
+	h3dLoadResource( res, data, (int)strlen( data ) );
+	return h3dIsResLoaded( res ) ? res : 0;
+}
+
+
+// A camera flies a circle close to the ground of a tiled terrain that is rendered each frame, so that the terrain
+// requests the tiles it needs itself. The memory of the resident tiles has to stay within the cache
+// size and the tile below the camera has to be resident once the loader caught up.
+void benchTerrainStreaming( BenchRunner &runner )
+{
+	H3DRes shaderRes = loadBenchResource( H3DResTypes::Shader, "BenchTerrain.shader", TerrainShader );
+	H3DRes matRes = loadBenchResource( H3DResTypes::Material, "BenchTerrain.material.xml",
+	                                   "<Material><Shader source=\"BenchTerrain.shader\" /></Material>" );
+	H3DRes pipeRes = loadBenchResource( H3DResTypes::Pipeline, "BenchTerrain.pipeline.xml", TerrainPipeline );
+	if( shaderRes == 0 || matRes == 0 || pipeRes == 0 )
+	{
+		runner.addFailure( "terrain/streaming: failed to load the test resources" );
+		return;
+	}
+
+	H3DNode cam = h3dAddCameraNode( H3DRootNode, "BenchTerrainCamera", pipeRes );
+
+	vector< unsigned int > tileCounts = runner.getScales( { 8, 16 } );
+	for( size_t i = 0; i < tileCounts.size(); ++i )
+	{
+		uint32 tilesPerSide = tileCounts[i];
+		string fileName = runner.getConfig().tempDir + "/h3dbench_terrain_" + to_string( tilesPerSide ) + ".tiles";
+
+		// Rolling hills that are continuous across tile borders
+		bool created = createTerrainTileFile( fileName, tilesPerSide, TileSize, BlockSize,
+			[]( uint32 tileX, uint32 tileY, uint16 *heights )
+		{
+			for( uint32 y = 0; y <= TileSize; ++y )
+			{
+				for( uint32 x = 0; x <= TileSize; ++x )
+				{
+					float gx = (float)(tileX * TileSize + x), gy = (float)(tileY * TileSize + y);
+					float h = 0.5f + 0.25f * sinf( gx * 0.02f ) * cosf( gy * 0.015f ) + 0.1f * sinf( (gx + gy) * 0.07f );
+					heights[y * (TileSize + 1) + x] = (uint16)(h * 65535.0f);
+				}
+			}
+		} );
+		if( !created )
+		{
+			runner.addFailure( "terrain/streaming: could not create " + fileName );
+			continue;
+		}
+
+		H3DNode terrain = h3dextAddTiledTerrainNode( H3DRootNode, "BenchTerrain", fileName.c_str(), matRes );
+		if( terrain == 0 )
+		{
+			runner.addFailure( "terrain/streaming: could not open " + fileName );
+			remove( fileName.c_str() );
+			continue;
+		}
+		const float extent = tilesPerSide * TileExtent;
+		h3dSetNodeTransform( terrain, 0, 0, 0, 0, 0, 0, extent, TileExtent, extent );
+		h3dSetNodeParamI( terrain, H3DEXTTerrain::TileCacheSizeI, MaxResidentTiles );
+		TerrainTileCache &cache =
+			*((TerrainNode *)Horde3D::Modules::sceneMan().resolveNodeHandle( terrain ))->getTileCache();
+
+		// Each iteration is a frame; every 100th frame waits for the loader and checks the tile below
+		// the camera
+		const int numFrames = 1000;
+		int frame = 0, numMissing = 0;
+		size_t peakMemory = 0;
+		BenchResult *result = runner.run( "terrain/streaming", "tiles=" + to_string( tilesPerSide * tilesPerSide ),
+		                                  numFrames, [&]( BenchTimer &timer )
+		{
+			float angle = (float)frame / numFrames * 6.2831853f;
+			float camX = tilesPerSide * (0.5f + 0.35f * cosf( angle ));
+			float camY = tilesPerSide * (0.5f + 0.35f * sinf( angle ));
+			float camPos[2] = { camX * TileExtent, camY * TileExtent }, groundHeight = 0;
+			h3dextGetTerrainHeights( terrain, camPos, 1, &groundHeight, 0x0 );
+			h3dSetNodeTransform( cam, camPos[0], groundHeight + CamAltitude, camPos[1], -90, 0, 0, 1, 1, 1 );
+
+			h3dRender( cam );
+			h3dFinalizeFrame();
+
+			timer.stop();
+			peakMemory = max( peakMemory, calcTileAllocations( cache ) );
+			if( ++frame % 100 == 0 )
+			{
+				// The next frame takes over the loaded tiles
+				cache.finishLoading();
+				h3dRender( cam );
+				h3dFinalizeFrame();
+				peakMemory = max( peakMemory, calcTileAllocations( cache ) );
+				if( cache.getTile( (uint32)camX, (uint32)camY ) == 0x0 ) ++numMissing;
+			}
+		} );
+
+		size_t budget = MaxResidentTiles * cache.getTileMemory();
+		if( result != 0x0 )
+		{
+			runner.addCounter( result, "peak_resident_bytes", (double)peakMemory );
+			runner.addCounter( result, "budget_bytes", (double)budget );
+			if( peakMemory > budget )
+			{
+				runner.addFailure( "terrain/streaming: resident tiles allocated " + to_string( peakMemory ) +
+				                   " bytes with a budget of " + to_string( budget ) + " bytes" );
+			}
+			if( numMissing > 0 )
+			{
+				runner.addFailure( "terrain/streaming: the tile below the camera was not resident " +
+				                   to_string( numMissing ) + " times after the loader caught up" );
+			}
+		}
+
+		h3dRemoveNode( terrain );
+		remove( fileName.c_str() );
+	}
+
+	h3dRemoveNode( cam );
+	h3dRemoveResource( pipeRes );
+	h3dRemoveResource( matRes );
+	h3dRemoveResource( shaderRes );
+	h3dReleaseUnusedResources();
+}
+
+#endif  // HORDE3D_BENCH_TERRAIN
+
+}  // namespace
+
+
+void runExtensionBenchmarks( BenchRunner &runner )
+{
+#ifdef HORDE3D_BENCH_OVERLAYS
+	if( runner.isSelected( "overlays/" ) ) benchOverlays( runner );
+#endif
+#ifdef HORDE3D_BENCH_TERRAIN
+	if( runner.isSelected( "terrain/" ) ) benchTerrainStreaming( runner );
+#endif
+	(void)runner;
+}
+
+}  // namespace
@@ -0,0 +1,337 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "Horde3D.h"
+#include "egModules.h"
+#include "egJobs.h"
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cmath>
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+using namespace Horde3D;
+
+namespace {
+
+string formatWorkers( const char *param, unsigned int count, unsigned int numWorkers )
+{
+	return string( param ) + "=" + to_string( count ) + " workers=" + to_string( numWorkers );
+}
+
+
+// *************************************************************************************************
+// Scheduling overhead
+// *************************************************************************************************
+
+void benchSubmit( BenchRunner &runner, unsigned int numWorkers )
+{
+	JobManager &jobMan = Modules::jobMan();
+	const int numJobs = 10000;
+	atomic< int > counter( 0 );
+
+	// Independent jobs that do almost nothing, so the time is spent in submitting and scheduling
+	BenchResult *result = runner.run( "jobs/submit_wait", formatWorkers( "jobs", numJobs, numWorkers ), 20,
+	                                  [&]( BenchTimer & )
+	{
+		for( int i = 0; i < numJobs; ++i )
+			jobMan.submit( [&counter]() { counter.fetch_add( 1, memory_order_relaxed ); } );
+		jobMan.waitAll();
+	} );
+
+	if( result != 0x0 ) runner.addCounter( result, "ns_per_job", result->getPercentile( 50 ) * 1e6 / numJobs );
+
+	// Every job depends on the previous one, so the jobs must run in submission order
+	const int chainLength = 1000;
+	int next = 0;
+	bool ordered = true;
+	result = runner.run( "jobs/dependency_chain", formatWorkers( "jobs", chainLength, numWorkers ), 20,
+	                     [&]( BenchTimer & )
+	{
+		next = 0;
+		JobHandle prev;
+		for( int i = 0; i < chainLength; ++i )
+		{
+			prev = jobMan.submit( [&next, &ordered, i]()
+			{
+				if( next != i ) ordered = false;
+				next = i + 1;
+			}, { prev } );
+		}
+		jobMan.wait( prev );
+	} );
+
+	if( result != 0x0 )
+	{
+		runner.addCounter( result, "ns_per_job", result->getPercentile( 50 ) * 1e6 / chainLength );
+		if( !ordered ) runner.addFailure( "jobs/dependency_chain: a job started before its dependency finished" );
+	}
+}
+
+
+void benchParallelFor( BenchRunner &runner, unsigned int numWorkers )
+{
+	JobManager &jobMan = Modules::jobMan();
+	const int count = 1 << 20;
+	const int grainSize = 4096;
+
+	vector< float > values( count );
+	for( int i = 0; i < count; ++i ) values[i] = (float)(i % 1000);
+
+	vector< float > results( count );
+	auto func = [&]( int begin, int end )
+	{
+		for( int i = begin; i < end; ++i ) results[i] = sqrtf( values[i] ) * sinf( values[i] );
+	};
+
+	// Serial baseline to report the speedup
+	BenchResult *serial = runner.run( "jobs/parallel_for", formatWorkers( "elements", count, numWorkers ) + " serial",
+	                                  20, [&]( BenchTimer & ) { func( 0, count ); } );
+
+	BenchResult *result = runner.run( "jobs/parallel_for", formatWorkers( "elements", count, numWorkers ), 20,
+	                                  [&]( BenchTimer &timer )
+	{
+		jobMan.parallelFor( count, grainSize, func );
+
+		timer.stop();
+		for( int i = 0; i < count; i += 997 )
+		{
+			if( results[i] != sqrtf( values[i] ) * sinf( values[i] ) )
+			{
+				runner.addFailure( "jobs/parallel_for: element " + to_string( i ) + " was not processed" );
+				break;
+			}
+		}
+		fill( results.begin(), results.end(), 0.0f );
+	} );
+
+	if( result != 0x0 && serial != 0x0 )
+		runner.addCounter( result, "speedup", serial->getPercentile( 50 ) / result->getPercentile( 50 ) );
+}
+
+
+// *************************************************************************************************
+// Stress tests
+// *************************************************************************************************
+
+const int MaxProbeLatency = 2;  // In s
+
+// Random dependency graph where some jobs submit further jobs while they run. Checks that every job
+// is executed exactly once and that a job submitted by the application starts quickly while the
+// workers are flooded with jobs that keep resubmitting themselves.
+void benchStress( BenchRunner &runner, unsigned int numWorkers )
+{
+	JobManager &jobMan = Modules::jobMan();
+	const int numJobs = 4096;
+
+	vector< atomic< int > > executions( numJobs * 2 );
+	vector< atomic< int > > workerJobs( numWorkers + 1 );
+	BenchRandom random;
+
+	BenchResult *result = runner.run( "jobs/stress", formatWorkers( "jobs", numJobs * 2, numWorkers ), 10,
+	                                  [&]( BenchTimer &timer )
+	{
+		timer.stop();
+		for( size_t i = 0; i < executions.size(); ++i ) executions[i] = 0;
+		vector< JobHandle > handles( numJobs );
+		timer.start();
+
+		for( int i = 0; i < numJobs; ++i )
+		{
+			auto func = [&, i]()
+			{
+				executions[i].fetch_add( 1, memory_order_relaxed );
+				workerJobs[jobMan.getCurrentWorker() + 1].fetch_add( 1, memory_order_relaxed );
+
+				// Nested job that ends up in the queue of the running worker
+				jobMan.submit( [&, i]() { executions[numJobs + i].fetch_add( 1, memory_order_relaxed ); } );
+			};
+
+			JobHandle deps[2];
+			uint32 numDeps = 0;
+			if( i > 0 && random.next() % 2 == 0 ) deps[numDeps++] = handles[random.next() % i];
+			if( i > 0 && random.next() % 4 == 0 ) deps[numDeps++] = handles[random.next() % i];
+			handles[i] = jobMan.submit( func, deps, numDeps );
+		}
+		jobMan.waitAll();
+
+		for( size_t i = 0; i < executions.size(); ++i )
+		{
+			if( executions[i] != 1 )
+			{
+				runner.addFailure( "jobs/stress: job " + to_string( i ) + " was executed " +
+				                   to_string( executions[i] ) + " times" );
+				break;
+			}
+		}
+	} );
+
+	if( result != 0x0 )
+	{
+		// Share of the busiest thread relative to an even distribution over workers and the application
+		int total = 0, busiest = 0;
+		for( size_t i = 0; i < workerJobs.size(); ++i )
+		{
+			total += workerJobs[i];
+			busiest = std::max( busiest, (int)workerJobs[i] );
+		}
+		runner.addCounter( result, "busiest_thread_share", total > 0 ? busiest * (double)workerJobs.size() / total : 0 );
+	}
+
+	// Latency of an application job while every worker runs a job that resubmits itself until stopped
+	atomic< bool > stopFlood( false );
+	function< void() > floodFunc = [&]()
+	{
+		this_thread::sleep_for( chrono::microseconds( 50 ) );
+		if( !stopFlood.load( memory_order_relaxed ) ) jobMan.submit( floodFunc );
+	};
+	for( unsigned int i = 0; i < std::max( numWorkers, 1u ) * 2; ++i ) jobMan.submit( floodFunc );
+
+	double maxLatency = 0;
+	result = runner.run( "jobs/fairness", formatWorkers( "flood_jobs", std::max( numWorkers, 1u ) * 2, numWorkers ), 50,
+	                     [&]( BenchTimer & )
+	{
+		chrono::steady_clock::time_point submitted = chrono::steady_clock::now();
+		atomic< double > latency( -1 );
+		JobHandle probe = jobMan.submit( [&]()
+		{
+			latency = chrono::duration< double, milli >( chrono::steady_clock::now() - submitted ).count();
+		} );
+
+		// Without workers the probe is run by waiting for it; otherwise a worker has to pick it up
+		if( numWorkers == 0 ) jobMan.wait( probe );
+		while( !probe.isDone() && chrono::steady_clock::now() - submitted < chrono::seconds( MaxProbeLatency ) )
+			this_thread::yield();
+		jobMan.wait( probe );
+
+		maxLatency = std::max( maxLatency, latency.load() );
+	} );
+
+	stopFlood = true;
+	jobMan.waitAll();
+
+	runner.addCounter( result, "max_latency_ms", maxLatency );
+	if( result != 0x0 && maxLatency >= MaxProbeLatency * 1000.0 )
+		runner.addFailure( "jobs/fairness: a job waited " + to_string( maxLatency ) + " ms to be started" );
+}
+
+
+// Waiting for a job that sleeps on a worker must block instead of spinning; the CPU time of the
+// process is compared to the time the job took
+void benchBlockingWait( BenchRunner &runner, unsigned int numWorkers )
+{
+	if( numWorkers == 0 ) return;
+
+	JobManager &jobMan = Modules::jobMan();
+	static const int sleepTime = 50;  // In ms
+	double maxCPUShare = 0;
+
+	BenchResult *result = runner.run( "jobs/blocking_wait", formatWorkers( "sleep_ms", sleepTime, numWorkers ), 5,
+	                                  [&]( BenchTimer & )
+	{
+		clock_t cpuStart = clock();
+		JobHandle job = jobMan.submit( []() { this_thread::sleep_for( chrono::milliseconds( sleepTime ) ); } );
+		jobMan.wait( job );
+		maxCPUShare = std::max( maxCPUShare, (clock() - cpuStart) * 1000.0 / CLOCKS_PER_SEC / sleepTime );
+	} );
+
+	runner.addCounter( result, "max_cpu_share", maxCPUShare );
+	if( result != 0x0 && maxCPUShare > 0.5 )
+		runner.addFailure( "jobs/blocking_wait: waiting thread used the CPU for " +
+		                   to_string( (int)(maxCPUShare * 100) ) + "% of the wait" );
+}
+
+
+// Restarts the engine with pending jobs; h3dRelease has to finish all of them, including the jobs
+// they submit while the engine shuts down
+bool benchShutdown( BenchRunner &runner, unsigned int numWorkers )
+{
+	const int numJobs = 2000;
+	atomic< int > counter( 0 );
+	bool initialized = true;
+
+	runner.run( "jobs/shutdown", formatWorkers( "jobs", numJobs * 2, numWorkers ), 20, [&]( BenchTimer &timer )
+	{
+		timer.stop();
+		if( !initialized ) return;
+		counter = 0;
+		JobManager &jobMan = Modules::jobMan();
+
+		JobHandle prev;
+		for( int i = 0; i < numJobs; ++i )
+		{
+			auto func = [&jobMan, &counter]()
+			{
+				counter.fetch_add( 1, memory_order_relaxed );
+				jobMan.submit( [&counter]() { counter.fetch_add( 1, memory_order_relaxed ); } );
+			};
+			prev = jobMan.submit( func, { i % 3 == 0 ? prev : JobHandle() } );
+		}
+
+		// Only the release is measured
+		timer.start();
+		h3dRelease();
+		timer.stop();
+
+		if( counter != numJobs * 2 )
+		{
+			runner.addFailure( "jobs/shutdown: " + to_string( numJobs * 2 - counter ) +
+			                   " jobs were not executed before h3dRelease returned" );
+		}
+
+		initialized = h3dInit( H3DRenderDevice::Null );
+		if( initialized )
+		{
+			h3dSetOption( H3DOptions::MaxLogLevel, 2 );
+			h3dSetOption( H3DOptions::WorkerThreads, (float)numWorkers );
+		}
+	} );
+
+	if( !initialized ) runner.addFailure( "jobs/shutdown: failed to initialize the engine again" );
+	return initialized;
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+
+void runJobBenchmarks( BenchRunner &runner )
+{
+	if( !runner.isSelected( "jobs/" ) ) return;
+
+	// The scheduling paths differ between no workers, where waiting threads run all jobs, and workers
+	// that steal from each other
+	vector< unsigned int > workerCounts = runner.getScales( { 4, 0, 2 } );
+	for( size_t i = 0; i < workerCounts.size(); ++i )
+	{
+		if( !h3dSetOption( H3DOptions::WorkerThreads, (float)workerCounts[i] ) )
+		{
+			runner.addFailure( "jobs: failed to set " + to_string( workerCounts[i] ) + " worker threads" );
+			continue;
+		}
+
+		benchSubmit( runner, workerCounts[i] );
+		benchParallelFor( runner, workerCounts[i] );
+		benchStress( runner, workerCounts[i] );
+		benchBlockingWait( runner, workerCounts[i] );
+		if( !benchShutdown( runner, workerCounts[i] ) ) return;
+	}
+
+	h3dSetOption( H3DOptions::WorkerThreads, -1 );
+}
+
+}  // namespace
@@ -0,0 +1,581 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "egCom.h"
+#include "egLightClusters.h"
+#include "egProfiler.h"
+#include "egRenderer.h"
+#include "utBVH.h"
+#include "utOcclusion.h"
+#include <atomic>
+#include <cmath>
+#include <cstdarg>
+#include <thread>
+#if !defined( PLATFORM_WIN )
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+using namespace Horde3D;
+
+namespace {
+
+string formatParams( const char *format, unsigned int a, unsigned int b = 0 )
+{
+	char str[128];
+	snprintf( str, sizeof( str ), format, a, b );
+	return str;
+}
+
+
+Matrix4f makeProjMat( float fov, float aspect, float nearDist, float farDist )
+{
+	float ymax = nearDist * tanf( degToRad( fov / 2 ) );
+	float xmax = ymax * aspect;
+
+	return Matrix4f::PerspectiveMat( -xmax, xmax, -ymax, ymax, nearDist, farDist );
+}
+
+
+// Grid of size x size quads in the xz-plane with a wavy height
+void makeGridMesh( unsigned int size, float extent, vector< Vec3f > &verts, vector< uint32 > &indices )
+{
+	verts.resize( (size + 1) * (size + 1) );
+	for( unsigned int y = 0; y <= size; ++y )
+	{
+		for( unsigned int x = 0; x <= size; ++x )
+		{
+			Vec3f &v = verts[y * (size + 1) + x];
+			v.x = ((float)x / size - 0.5f) * extent;
+			v.z = ((float)y / size - 0.5f) * extent;
+			v.y = sinf( v.x * 0.3f ) * cosf( v.z * 0.2f ) * extent * 0.02f;
+		}
+	}
+
+	indices.clear();
+	indices.reserve( size * size * 6 );
+	for( unsigned int y = 0; y < size; ++y )
+	{
+		for( unsigned int x = 0; x < size; ++x )
+		{
+			uint32 i = y * (size + 1) + x;
+			indices.push_back( i ); indices.push_back( i + size + 1 ); indices.push_back( i + 1 );
+			indices.push_back( i + 1 ); indices.push_back( i + size + 1 ); indices.push_back( i + size + 2 );
+		}
+	}
+}
+
+
+// Entry distance of the segment into the box as fraction of the segment
+bool intersectBox( const Vec3f &rayOrig, const Vec3f &rayDir, const Vec3f &bbMin, const Vec3f &bbMax, float &t )
+{
+	float tMin = 0, tMax = t;
+	for( int i = 0; i < 3; ++i )
+	{
+		float invDir = 1.0f / (&rayDir.x)[i];
+		float t0 = ((&bbMin.x)[i] - (&rayOrig.x)[i]) * invDir;
+		float t1 = ((&bbMax.x)[i] - (&rayOrig.x)[i]) * invDir;
+		tMin = maxf( tMin, minf( t0, t1 ) );
+		tMax = minf( tMax, maxf( t0, t1 ) );
+	}
+	if( tMin > tMax ) return false;
+
+	t = tMin;
+	return true;
+}
+
+
+// Messages that the log passed to the application callback and the count of dropped messages it
+// reported
+atomic< uint64 > numLogMessages( 0 ), numLogDropped( 0 );
+
+void countLogMessage( int level, const char *text )
+{
+	unsigned int dropped = 0;
+	if( sscanf( text, "%u log messages were dropped", &dropped ) == 1 ) numLogDropped += dropped;
+	else if( level == 2 ) ++numLogMessages;
+}
+
+
+// Redirects stderr to the null device while it exists, so that the debugger output of the log does
+// not flood the console; on Windows the log writes to the debugger instead
+class StderrSilencer
+{
+public:
+#if !defined( PLATFORM_WIN )
+	StderrSilencer()
+	{
+		fflush( stderr );
+		_savedFd = dup( 2 );
+		int nullFd = open( "/dev/null", O_WRONLY );
+		if( nullFd >= 0 )
+		{
+			dup2( nullFd, 2 );
+			close( nullFd );
+		}
+	}
+
+	~StderrSilencer()
+	{
+		fflush( stderr );
+		if( _savedFd < 0 ) return;
+		dup2( _savedFd, 2 );
+		close( _savedFd );
+	}
+
+private:
+	int  _savedFd;
+#endif
+};
+
+
+// *************************************************************************************************
+// BVHs
+// *************************************************************************************************
+
+void benchTriangleBVH( BenchRunner &runner )
+{
+	const unsigned int numRays = 100000;
+	const float extent = 200.0f;
+
+	vector< unsigned int > scales = runner.getScales( { 64, 256, 724 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "bvh/triangle" ); ++i )
+	{
+		unsigned int size = scales[i];
+		vector< Vec3f > verts;
+		vector< uint32 > indices;
+		makeGridMesh( size, extent, verts, indices );
+
+		TriangleBVH bvh;
+		runner.run( "bvh/triangle_build", formatParams( "triangles=%u", size * size * 2 ), 10, [&]( BenchTimer & )
+		{
+			bvh.build( &verts[0], &indices[0], false, 0, (uint32)indices.size() );
+		} );
+		if( bvh.isEmpty() ) bvh.build( &verts[0], &indices[0], false, 0, (uint32)indices.size() );
+
+		// Random segments that start above the mesh and end below it
+		BenchRandom random( 11 );
+		vector< Vec3f > rays( numRays * 2 );
+		for( unsigned int j = 0; j < numRays; ++j )
+		{
+			rays[j * 2] = Vec3f( random.nextFloat( -0.5f, 0.5f ) * extent, 20.0f, random.nextFloat( -0.5f, 0.5f ) * extent );
+			rays[j * 2 + 1] = Vec3f( random.nextFloat( -40.0f, 40.0f ), -40.0f, random.nextFloat( -40.0f, 40.0f ) );
+		}
+
+		unsigned int numHits = 0;
+		BenchResult *result = runner.run( "bvh/triangle_rays", formatParams( "triangles=%u rays=%u", size * size * 2, numRays ),
+			5, [&]( BenchTimer & )
+		{
+			numHits = 0;
+			for( unsigned int j = 0; j < numRays; ++j )
+			{
+				float t;
+				if( bvh.intersect( &verts[0], rays[j * 2], rays[j * 2 + 1], t ) ) ++numHits;
+			}
+		} );
+		runner.addCounter( result, "hits", numHits );
+		if( result != 0x0 ) runner.addCounter( result, "Mrays_per_s", numRays / (result->getPercentile( 50 ) * 1000.0) );
+	}
+}
+
+
+void benchBoxBVH( BenchRunner &runner )
+{
+	const unsigned int numRays = 100000;
+	const float extent = 1000.0f;
+
+	vector< unsigned int > scales = runner.getScales( { 10000, 100000 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "bvh/box" ); ++i )
+	{
+		unsigned int count = scales[i];
+
+		// Boxes of objects scattered over a level
+		BenchRandom random( 13 );
+		vector< Vec3f > bounds( count * 2 );
+		for( unsigned int j = 0; j < count; ++j )
+		{
+			Vec3f center( random.nextFloat( -0.5f, 0.5f ) * extent, random.nextFloat( 0, 20.0f ),
+			              random.nextFloat( -0.5f, 0.5f ) * extent );
+			Vec3f halfSize( random.nextFloat( 0.5f, 4.0f ), random.nextFloat( 0.5f, 4.0f ), random.nextFloat( 0.5f, 4.0f ) );
+			bounds[j * 2] = center - halfSize;
+			bounds[j * 2 + 1] = center + halfSize;
+		}
+
+		BoxBVH bvh;
+		runner.run( "bvh/box_build", formatParams( "boxes=%u", count ), 10, [&]( BenchTimer & )
+		{
+			bvh.build( &bounds[0], count );
+		} );
+		if( bvh.isEmpty() ) bvh.build( &bounds[0], count );
+
+		// Mostly horizontal segments like line of sight checks
+		vector< Vec3f > rays( numRays * 2 );
+		for( unsigned int j = 0; j < numRays; ++j )
+		{
+			rays[j * 2] = Vec3f( random.nextFloat( -0.5f, 0.5f ) * extent, random.nextFloat( 0, 20.0f ),
+			                     random.nextFloat( -0.5f, 0.5f ) * extent );
+			rays[j * 2 + 1] = Vec3f( random.nextFloat( -100.0f, 100.0f ), random.nextFloat( -5.0f, 5.0f ),
+			                         random.nextFloat( -100.0f, 100.0f ) );
+		}
+
+		unsigned int numHits = 0;
+		BenchResult *result = runner.run( "bvh/box_rays", formatParams( "boxes=%u rays=%u", count, numRays ), 5,
+			[&]( BenchTimer & )
+		{
+			numHits = 0;
+			for( unsigned int j = 0; j < numRays; ++j )
+			{
+				const Vec3f &orig = rays[j * 2], &dir = rays[j * 2 + 1];
+				float t;
+				bool hit = bvh.intersect( orig, dir, t, false, [&]( uint32 prim, float &tPrim )
+				{
+					return intersectBox( orig, dir, bounds[prim * 2], bounds[prim * 2 + 1], tPrim );
+				} );
+				if( hit ) ++numHits;
+			}
+		} );
+		runner.addCounter( result, "hits", numHits );
+		if( result != 0x0 ) runner.addCounter( result, "Mrays_per_s", numRays / (result->getPercentile( 50 ) * 1000.0) );
+	}
+}
+
+
+// *************************************************************************************************
+// Occlusion buffer
+// *************************************************************************************************
+
+void benchOcclusion( BenchRunner &runner )
+{
+	if( !runner.isSelected( "occlusion/" ) ) return;
+
+	static const Vec3f boxVerts[8] = {
+		Vec3f( -0.5f, 0, -0.5f ), Vec3f( 0.5f, 0, -0.5f ), Vec3f( 0.5f, 1, -0.5f ), Vec3f( -0.5f, 1, -0.5f ),
+		Vec3f( -0.5f, 0, 0.5f ), Vec3f( 0.5f, 0, 0.5f ), Vec3f( 0.5f, 1, 0.5f ), Vec3f( -0.5f, 1, 0.5f ) };
+	static const uint16 boxIndices[36] = {
+		0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 4, 7, 0, 7, 3,
+		1, 2, 6, 1, 6, 5,  3, 7, 6, 3, 6, 2,  0, 1, 5, 0, 5, 4 };
+
+	// Camera at the origin looking along the negative z-axis over a street with buildings
+	Matrix4f viewProjMat = makeProjMat( 60.0f, 16.0f / 9.0f, 0.5f, 500.0f ) *
+	                       Matrix4f::TransMat( 0, -2.0f, 0 ).inverted();
+
+	OcclusionBuffer buffer;
+	buffer.resize( 256, 144 );
+
+	// Known cases with a wall 20 units in front of the camera
+	buffer.clear( viewProjMat );
+	Matrix4f wallMat = Matrix4f::TransMat( 0, 0, -20.0f ) * Matrix4f::ScaleMat( 40.0f, 20.0f, 1.0f );
+	buffer.rasterizeTriangles( wallMat, boxVerts, 0, 7, boxIndices, true, 0, 36 );
+
+	if( buffer.testBox( Vec3f( -1.0f, 1.0f, -31.0f ), Vec3f( 1.0f, 3.0f, -29.0f ) ) )
+		runner.addFailure( "occlusion/test: a box behind the wall is reported visible" );
+	if( !buffer.testBox( Vec3f( -1.0f, 1.0f, -12.0f ), Vec3f( 1.0f, 3.0f, -10.0f ) ) )
+		runner.addFailure( "occlusion/test: a box in front of the wall is reported occluded" );
+	// Reaches from behind the camera to behind the wall
+	if( !buffer.testBox( Vec3f( -1.0f, 1.0f, -40.0f ), Vec3f( 1.0f, 3.0f, 1.0f ) ) )
+		runner.addFailure( "occlusion/test: a box crossing the near plane is reported occluded" );
+
+	vector< unsigned int > scales = runner.getScales( { 16, 64, 256 } );
+	for( size_t i = 0; i < scales.size(); ++i )
+	{
+		unsigned int numOccluders = scales[i];
+
+		BenchRandom random( 17 );
+		vector< Matrix4f > occluders( numOccluders );
+		for( unsigned int j = 0; j < numOccluders; ++j )
+		{
+			occluders[j] = Matrix4f::TransMat( random.nextFloat( -40.0f, 40.0f ), 0, random.nextFloat( -80.0f, -15.0f ) ) *
+			               Matrix4f::ScaleMat( random.nextFloat( 4.0f, 12.0f ), random.nextFloat( 4.0f, 20.0f ),
+			                                   random.nextFloat( 2.0f, 8.0f ) );
+		}
+
+		auto rasterize = [&]()
+		{
+			buffer.clear( viewProjMat );
+			for( unsigned int j = 0; j < numOccluders; ++j )
+				buffer.rasterizeTriangles( occluders[j], boxVerts, 0, 7, boxIndices, true, 0, 36 );
+		};
+
+		BenchResult *result = runner.run( "occlusion/rasterize", formatParams( "occluders=%u", numOccluders ), 50,
+			[&]( BenchTimer & ) { rasterize(); } );
+		runner.addCounter( result, "triangles", buffer.getRasterizedTriCount() );
+		if( result == 0x0 ) rasterize();
+
+		vector< unsigned int > testScales = runner.getScales( { 10000, 100000 } );
+		for( size_t j = 0; j < testScales.size() && runner.isSelected( "occlusion/test" ); ++j )
+		{
+			unsigned int numBoxes = testScales[j];
+			vector< Vec3f > bounds( numBoxes * 2 );
+			for( unsigned int k = 0; k < numBoxes; ++k )
+			{
+				Vec3f pos( random.nextFloat( -100.0f, 100.0f ), random.nextFloat( 0, 5.0f ), random.nextFloat( -300.0f, -20.0f ) );
+				float size = random.nextFloat( 0.5f, 3.0f );
+				bounds[k * 2] = pos;
+				bounds[k * 2 + 1] = pos + Vec3f( size, size, size );
+			}
+
+			unsigned int numVisible = 0;
+			result = runner.run( "occlusion/test", formatParams( "occluders=%u boxes=%u", numOccluders, numBoxes ), 20,
+				[&]( BenchTimer & )
+			{
+				numVisible = 0;
+				for( unsigned int k = 0; k < numBoxes; ++k )
+				{
+					if( buffer.testBox( bounds[k * 2], bounds[k * 2 + 1] ) ) ++numVisible;
+				}
+			} );
+			runner.addCounter( result, "visible_fraction", (double)numVisible / numBoxes );
+		}
+	}
+}
+
+
+// *************************************************************************************************
+// Light clusters
+// *************************************************************************************************
+
+// Reference for the binning: true if a sample point of the box lies in the light volume. The box is
+// sampled on a grid and at the point closest to the light, so that the test can miss intersections
+// but never reports one that does not exist.
+bool isPointInLight( const ClusterLight &light, const Vec3f &point )
+{
+	Vec3f toPoint = point - light.pos;
+	float dist = toPoint.length();
+	if( dist > light.radius ) return false;
+
+	return light.cosHalfAngle <= 0 || dist == 0 || toPoint.dot( light.dir ) >= light.cosHalfAngle * dist;
+}
+
+
+bool isLightInBox( const ClusterLight &light, const Vec3f &bbMin, const Vec3f &bbMax )
+{
+	Vec3f closest( clamp( light.pos.x, bbMin.x, bbMax.x ), clamp( light.pos.y, bbMin.y, bbMax.y ),
+	               clamp( light.pos.z, bbMin.z, bbMax.z ) );
+	if( isPointInLight( light, closest ) ) return true;
+
+	const int numSteps = 6;
+	Vec3f step = (bbMax - bbMin) / (float)numSteps;
+	for( int z = 0; z <= numSteps; ++z )
+	{
+		for( int y = 0; y <= numSteps; ++y )
+		{
+			for( int x = 0; x <= numSteps; ++x )
+			{
+				if( isPointInLight( light, bbMin + Vec3f( step.x * x, step.y * y, step.z * z ) ) ) return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+void benchLightClusters( BenchRunner &runner )
+{
+	const float nearDist = 0.5f, farDist = 500.0f;
+
+	LightClusterGrid grid;
+	grid.setup( makeProjMat( 60.0f, 16.0f / 9.0f, nearDist, farDist ), nearDist, farDist,
+	            ClusterGridX, ClusterGridY, ClusterGridZ );
+
+	vector< unsigned int > scales = runner.getScales( { 64, 256, 1024 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "lightclusters/bin" ); ++i )
+	{
+		unsigned int numLights = scales[i];
+
+		// Point and spot lights in the view frustum; view space looks along the negative z-axis
+		BenchRandom random( 19 );
+		vector< ClusterLight > lights( numLights );
+		for( unsigned int j = 0; j < numLights; ++j )
+		{
+			ClusterLight &light = lights[j];
+			float dist = random.nextFloat( 1.0f, 200.0f );
+			light.pos = Vec3f( random.nextFloat( -0.9f, 0.9f ) * dist, random.nextFloat( -0.5f, 0.5f ) * dist, -dist );
+			light.radius = random.nextFloat( 2.0f, 20.0f );
+			if( j % 2 == 0 )
+			{
+				light.dir = Vec3f( 0, 0, -1 );
+				light.cosHalfAngle = -1.0f;
+				light.sinHalfAngle = 0.0f;
+			}
+			else
+			{
+				light.dir = Vec3f( random.nextFloat( -1, 1 ), random.nextFloat( -1, 0 ), random.nextFloat( -1, 1 ) ).normalized();
+				float halfAngle = degToRad( random.nextFloat( 10.0f, 45.0f ) );
+				light.cosHalfAngle = cosf( halfAngle );
+				light.sinHalfAngle = sinf( halfAngle );
+			}
+		}
+
+		BenchResult *result = runner.run( "lightclusters/bin", formatParams( "lights=%u", numLights ), 50,
+			[&]( BenchTimer & )
+		{
+			grid.bin( &lights[0], numLights, MaxClusterIndices );
+		} );
+
+		double numAssignments = 0;
+		for( size_t j = 0; j < grid.getCounts().size(); ++j ) numAssignments += grid.getCounts()[j];
+		runner.addCounter( result, "assignments", numAssignments );
+		runner.addCounter( result, "overflow", grid.hasOverflow() ? 1 : 0 );
+
+		// Every cluster that a few of the point and spot lights reach has to list them
+		if( grid.hasOverflow() ) continue;
+		const uint32 numCheckedLights = 8;
+		uint32 numMissing = 0;
+		for( uint32 c = 0; c < grid.getClusterCount(); ++c )
+		{
+			Vec3f bbMin, bbMax;
+			grid.getClusterBounds( c, bbMin, bbMax );
+			const uint32 *first = grid.getCounts()[c] > 0 ? &grid.getIndices()[grid.getOffsets()[c]] : 0x0;
+			const uint32 *last = first + grid.getCounts()[c];
+
+			for( uint32 j = 0; j < numCheckedLights && j < numLights; ++j )
+			{
+				if( isLightInBox( lights[j], bbMin, bbMax ) && find( first, last, j ) == last ) ++numMissing;
+			}
+		}
+		if( numMissing > 0 )
+		{
+			runner.addFailure( "lightclusters/bin: " + to_string( numMissing ) + " clusters do not list one of the first " +
+			                   to_string( numCheckedLights ) + " lights although it reaches them" );
+		}
+	}
+}
+
+
+// *************************************************************************************************
+// Profiler
+// *************************************************************************************************
+
+// Zones are constructed directly, since H3D_PROFILE_ZONE is empty unless the engine is built with the
+// HORDE3D_PROFILER option
+void profileNested( unsigned int depth )
+{
+	ProfSample sample( "Bench::nested" );
+	if( depth > 1 ) profileNested( depth - 1 );
+}
+
+
+void benchProfiler( BenchRunner &runner )
+{
+	if( !runner.isSelected( "profiler/zone" ) ) return;
+
+	const unsigned int numZones = 200000;
+	const unsigned int nestingDepth = 8;
+
+	for( int enabled = 1; enabled >= 0; --enabled )
+	{
+		Profiler::setEnabled( enabled != 0 );
+
+		BenchResult *result = runner.run( "profiler/zone", formatParams( "flat enabled=%u", enabled ), 20, []( BenchTimer & )
+		{
+			for( unsigned int i = 0; i < numZones; ++i )
+			{
+				ProfSample sample( "Bench::flat" );
+			}
+		} );
+		if( result != 0x0 ) runner.addCounter( result, "ns_per_zone", result->getPercentile( 50 ) * 1e6 / numZones );
+
+		result = runner.run( "profiler/zone", formatParams( "nested enabled=%u", enabled ), 20, []( BenchTimer & )
+		{
+			for( unsigned int i = 0; i < numZones / nestingDepth; ++i ) profileNested( nestingDepth );
+		} );
+		if( result != 0x0 ) runner.addCounter( result, "ns_per_zone", result->getPercentile( 50 ) * 1e6 / numZones );
+	}
+
+	Profiler::release();
+}
+
+
+// *************************************************************************************************
+// Log
+// *************************************************************************************************
+
+void benchLog( BenchRunner &runner )
+{
+	const unsigned int messagesPerThread = 20000;
+
+	// Warnings are the lowest level the benchmarks let through
+	EngineLog::setMessageCallback( countLogMessage );
+
+	vector< unsigned int > scales = runner.getScales( { 1, 4 } );
+	for( size_t i = 0; i < scales.size() && runner.isSelected( "log/throughput" ); ++i )
+	{
+		unsigned int numProducers = scales[i];
+		uint64 numDelivered = 0, numLost = 0;
+
+		BenchResult *result = runner.run( "log/throughput", formatParams( "producers=%u", numProducers ), 10,
+			[&]( BenchTimer & )
+		{
+			StderrSilencer silencer;
+			EngineLog log;
+			numLogMessages = 0;
+			numLogDropped = 0;
+			atomic< unsigned int > running( numProducers );
+
+			vector< thread > producers;
+			for( unsigned int j = 0; j < numProducers; ++j )
+			{
+				producers.push_back( thread( [&log, &running, j]()
+				{
+					for( unsigned int k = 0; k < messagesPerThread; ++k )
+						log.writeWarning( "Message %u from producer %u", k, j );
+					running.fetch_sub( 1 );
+				} ) );
+			}
+
+			// Consumer that flushes continuously like a frame loop without any other work
+			while( running.load() > 0 ) log.flush();
+			for( size_t j = 0; j < producers.size(); ++j ) producers[j].join();
+			log.flush();
+
+			numDelivered = numLogMessages;
+			numLost = numLogDropped;
+		} );
+
+		if( result != 0x0 )
+			runner.addCounter( result, "Mmsg_per_s", numDelivered / (result->getPercentile( 50 ) * 1000.0) );
+		runner.addCounter( result, "dropped", (double)numLost );
+
+		// Producers flush the full ring buffer themselves or wait for the consumer, so hardly any
+		// message may get lost
+		if( result != 0x0 && numLost * 100 > (uint64)numProducers * messagesPerThread )
+		{
+			runner.addFailure( "log/throughput: " + to_string( numLost ) + " of " +
+			                   to_string( numProducers * messagesPerThread ) + " messages were dropped" );
+		}
+	}
+
+	EngineLog::setMessageCallback( 0x0 );
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+
+void runUtilityBenchmarks( BenchRunner &runner )
+{
+	benchTriangleBVH( runner );
+	benchBoxBVH( runner );
+	benchOcclusion( runner );
+	benchLightClusters( runner );
+	benchProfiler( runner );
+	benchLog( runner );
+}
+
+}  // namespace
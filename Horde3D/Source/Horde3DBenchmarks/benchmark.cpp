@@ -0,0 +1,182 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "Horde3D.h"
+#include "Horde3DUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+
+namespace Horde3DBenchmarks {
+
+using namespace std;
+
+// *************************************************************************************************
+// Class BenchResult
+// *************************************************************************************************
+
+double BenchResult::getPercentile( double percentile ) const
+{
+	if( samples.empty() ) return 0;
+
+	// Nearest rank
+	vector< double > sorted( samples );
+	sort( sorted.begin(), sorted.end() );
+	size_t rank = (size_t)ceil( percentile / 100.0 * sorted.size() );
+
+	return sorted[std::min( std::max( rank, (size_t)1 ), sorted.size() ) - 1];
+}
+
+
+double BenchResult::getMean() const
+{
+	if( samples.empty() ) return 0;
+
+	double sum = 0;
+	for( size_t i = 0; i < samples.size(); ++i ) sum += samples[i];
+
+	return sum / samples.size();
+}
+
+
+// *************************************************************************************************
+// Class BenchRunner
+// *************************************************************************************************
+
+namespace {
+
+void writeEscaped( FILE *f, const string &str )
+{
+	for( size_t i = 0; i < str.size(); ++i )
+	{
+		if( str[i] == '"' || str[i] == '\\' ) fputc( '\\', f );
+		if( (unsigned char)str[i] >= 0x20 ) fputc( str[i], f );
+	}
+}
+
+}  // namespace
+
+
+bool BenchRunner::isSelected( const char *name ) const
+{
+	return strncmp( name, _config.filter.c_str(), std::min( strlen( name ), _config.filter.size() ) ) == 0;
+}
+
+
+vector< unsigned int > BenchRunner::getScales( initializer_list< unsigned int > scales ) const
+{
+	vector< unsigned int > result( scales );
+	if( _config.quick && !result.empty() ) result.resize( 1 );
+
+	return result;
+}
+
+
+void BenchRunner::addCounter( BenchResult *result, const char *name, double value )
+{
+	if( result == 0x0 ) return;
+
+	result->counters.push_back( pair< string, double >( name, value ) );
+	fprintf( stderr, "    %-24s %.3f\n", name, value );
+}
+
+
+void BenchRunner::addFailure( const string &message )
+{
+	_failures.push_back( message );
+	fprintf( stderr, "FAILED: %s\n", message.c_str() );
+}
+
+
+void BenchRunner::printResult( const BenchResult &result ) const
+{
+	fprintf( stderr, "%-28s %-28s median %10.3f ms   p99 %10.3f ms   (%u iterations)\n", result.name.c_str(),
+	         result.params.c_str(), result.getPercentile( 50 ), result.getPercentile( 99 ),
+	         (unsigned int)result.samples.size() );
+	fflush( stderr );
+}
+
+
+bool BenchRunner::writeJSON( FILE *f ) const
+{
+	fprintf( f, "{\n\"quick\": %s,\n\"benchmarks\": [", _config.quick ? "true" : "false" );
+	for( size_t i = 0; i < _results.size(); ++i )
+	{
+		const BenchResult &result = _results[i];
+
+		fprintf( f, "%s\n{\"name\":\"", i > 0 ? "," : "" );
+		writeEscaped( f, result.name );
+		fprintf( f, "\",\"params\":\"" );
+		writeEscaped( f, result.params );
+		fprintf( f, "\",\"iterations\":%u,\"median_ms\":%.6f,\"p99_ms\":%.6f,\"min_ms\":%.6f,\"mean_ms\":%.6f",
+		         (unsigned int)result.samples.size(), result.getPercentile( 50 ), result.getPercentile( 99 ),
+		         result.getPercentile( 0 ), result.getMean() );
+
+		fprintf( f, ",\"counters\":{" );
+		for( size_t j = 0; j < result.counters.size(); ++j )
+		{
+			fprintf( f, "%s\"", j > 0 ? "," : "" );
+			writeEscaped( f, result.counters[j].first );
+			if( std::isfinite( result.counters[j].second ) ) fprintf( f, "\":%.6g", result.counters[j].second );
+			else fprintf( f, "\":null" );
+		}
+		fprintf( f, "}}" );
+	}
+	fprintf( f, "\n],\n\"failures\": [" );
+	for( size_t i = 0; i < _failures.size(); ++i )
+	{
+		fprintf( f, "%s\n\"", i > 0 ? "," : "" );
+		writeEscaped( f, _failures[i] );
+		fprintf( f, "\"" );
+	}
+	fprintf( f, "\n]\n}\n" );
+
+	return ferror( f ) == 0;
+}
+
+
+// *************************************************************************************************
+// Helpers
+// *************************************************************************************************
+
+bool readFile( const string &fileName, vector< char > &data )
+{
+	ifstream inf( fileName.c_str(), ios::binary );
+	if( !inf.good() ) return false;
+
+	inf.seekg( 0, ios::end );
+	data.resize( (size_t)inf.tellg() );
+	inf.seekg( 0, ios::beg );
+	if( !data.empty() ) inf.read( &data[0], data.size() );
+
+	return inf.good();
+}
+
+
+int loadContent( const BenchRunner &runner, int resType, const char *name )
+{
+	H3DRes res = h3dAddResource( resType, name, 0 );
+	h3dutLoadResourcesFromDisk( runner.getConfig().contentDir.c_str() );
+
+	if( !h3dIsResLoaded( res ) )
+	{
+		fprintf( stderr, "Failed to load '%s' from the content directory\n", name );
+		return 0;
+	}
+
+	return res;
+}
+
+}  // namespace
@@ -0,0 +1,200 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _Horde3DBenchmarks_benchmark_H_
+#define _Horde3DBenchmarks_benchmark_H_
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace Horde3DBenchmarks {
+
+// =================================================================================================
+// Timer
+// =================================================================================================
+
+// Accumulates the time between start and stop; benchmarks stop the timer around work that should
+// not be measured, like the setup and cleanup of an iteration
+class BenchTimer
+{
+public:
+	BenchTimer() : _elapsed( 0 ), _running( false ) {}
+
+	void start()
+	{
+		if( _running ) return;
+		_begin = std::chrono::steady_clock::now();
+		_running = true;
+	}
+
+	void stop()
+	{
+		if( !_running ) return;
+		_elapsed += std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - _begin ).count();
+		_running = false;
+	}
+
+	double getElapsedMS() const { return _elapsed; }
+
+protected:
+	std::chrono::steady_clock::time_point  _begin;
+	double                                 _elapsed;
+	bool                                   _running;
+};
+
+
+// =================================================================================================
+// Runner
+// =================================================================================================
+
+struct BenchResult
+{
+	std::string                                      name;    // Benchmark, e.g. "scene/cull"
+	std::string                                      params;  // Scale of the run, e.g. "nodes=1000 views=8"
+	std::vector< double >                            samples;  // In ms, one per iteration
+	std::vector< std::pair< std::string, double > >  counters;  // Additional results like throughputs
+
+	double getPercentile( double percentile ) const;
+	double getMean() const;
+};
+
+struct BenchConfig
+{
+	std::string  contentDir;
+	std::string  tempDir;
+	std::string  filter;  // Selects benchmarks by name, see BenchRunner::isSelected
+	bool         quick;   // Run only the smallest scale with fewer iterations, e.g. for smoke tests
+
+	BenchConfig() : quick( false ) {}
+};
+
+// =================================================================================================
+
+class BenchRunner
+{
+public:
+	BenchRunner( const BenchConfig &config ) : _config( config ) {}
+
+	const BenchConfig &getConfig() const { return _config; }
+	// Names and filter are compared up to the length of the shorter one, so that a filter selects single
+	// benchmarks like "bvh/box_rays" as well as groups like "bvh/", and a group name can be checked
+	// before preparing the data of its benchmarks
+	bool isSelected( const char *name ) const;
+	std::vector< unsigned int > getScales( std::initializer_list< unsigned int > scales ) const;
+
+	// Calls func( BenchTimer & ) once for warming up and then iterations times with a running timer;
+	// returns 0x0 if the benchmark is not selected
+	template< class Func > BenchResult *run( const char *name, const std::string &params, int iterations, Func func )
+	{
+		if( !isSelected( name ) ) return 0x0;
+		if( _config.quick ) iterations = (iterations + 3) / 4;
+
+		BenchResult result;
+		result.name = name;
+		result.params = params;
+		result.samples.reserve( iterations );
+		for( int i = -1; i < iterations; ++i )
+		{
+			BenchTimer timer;
+			timer.start();
+			func( timer );
+			timer.stop();
+			if( i >= 0 ) result.samples.push_back( timer.getElapsedMS() );
+		}
+
+		_results.push_back( result );
+		printResult( _results.back() );
+		return &_results.back();
+	}
+
+	// Attaches a named value to the result of a benchmark; does nothing if the result is 0x0
+	void addCounter( BenchResult *result, const char *name, double value );
+	// Records a violated expectation of a benchmark, e.g. an exceeded memory budget
+	void addFailure( const std::string &message );
+	bool hasFailures() const { return !_failures.empty(); }
+
+	bool writeJSON( FILE *f ) const;
+
+protected:
+	void printResult( const BenchResult &result ) const;
+
+protected:
+	BenchConfig                 _config;
+	std::deque< BenchResult >   _results;  // Deque keeps results at the same address when adding new ones
+	std::vector< std::string >  _failures;
+};
+
+
+// =================================================================================================
+// Helpers
+// =================================================================================================
+
+// Small deterministic generator, so that the synthetic data is the same on all platforms and runs
+class BenchRandom
+{
+public:
+	BenchRandom( unsigned int seed = 1 ) : _state( seed != 0 ? seed : 1 ) {}
+
+	unsigned int next()
+	{
+		// Xorshift32
+		_state ^= _state << 13;
+		_state ^= _state >> 17;
+		_state ^= _state << 5;
+		return _state;
+	}
+
+	// Uniformly distributed in [min, max)
+	float nextFloat( float min, float max ) { return min + (max - min) * (float)((next() >> 8) * (1.0 / 16777216.0)); }
+
+protected:
+	unsigned int  _state;
+};
+
+bool readFile( const std::string &fileName, std::vector< char > &data );
+
+// Adds a resource and loads it from the content directory; returns the resource handle or 0 if the
+// resource could not be loaded
+int loadContent( const BenchRunner &runner, int resType, const char *name );
+
+
+// =================================================================================================
+// Benchmark groups
+// =================================================================================================
+
+// Scene graph, culling, animation, skinning, particles, loading and ray casts through the engine API;
+// the engine needs to be initialized
+void runEngineBenchmarks( BenchRunner &runner );
+
+// Engine utilities: BVHs, occlusion buffer, light clusters, profiler and log; only the light clusters
+// need an initialized engine for its job system
+void runUtilityBenchmarks( BenchRunner &runner );
+
+// Overlays and terrain tile streaming; the overlay benchmarks need an initialized engine
+void runExtensionBenchmarks( BenchRunner &runner );
+
+// Collada parsing and vertex welding of the ColladaConv tool
+void runConverterBenchmarks( BenchRunner &runner );
+
+// Job system overhead, parallelFor speedup and stress tests for correctness, fairness and shutdown;
+// the engine needs to be initialized and is restarted by the shutdown test
+void runJobBenchmarks( BenchRunner &runner );
+
+}  // namespace
+
+#endif // _Horde3DBenchmarks_benchmark_H_
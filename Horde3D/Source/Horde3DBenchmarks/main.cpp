@@ -0,0 +1,114 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "benchmark.h"
+#include "Horde3D.h"
+#include "Horde3DUtils.h"
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace Horde3DBenchmarks;
+
+
+void printHelp()
+{
+	printf( "Usage:\n" );
+	printf( "Horde3DBenchmarks [optional arguments]\n\n" );
+	printf( "Optional arguments:\n" );
+	printf( "-out FILE       write the results as JSON to FILE instead of stdout\n" );
+	printf( "-content DIR    content directory with the sample assets (default: %s)\n", HORDE3D_BENCH_CONTENT_DIR );
+	printf( "-temp DIR       directory for generated files (default: system temp directory)\n" );
+	printf( "-filter NAME    run only benchmarks whose name starts with NAME, e.g. scene/ or bvh/\n" );
+	printf( "-quick          run only the smallest scale with fewer iterations\n" );
+}
+
+
+string getTempDir()
+{
+	const char *vars[3] = { "TMPDIR", "TEMP", "TMP" };
+	for( int i = 0; i < 3; ++i )
+	{
+		const char *dir = getenv( vars[i] );
+		if( dir != 0x0 && dir[0] != '\0' ) return dir;
+	}
+
+	return "/tmp";
+}
+
+
+int main( int argc, char **argv )
+{
+	BenchConfig config;
+	config.contentDir = HORDE3D_BENCH_CONTENT_DIR;
+	config.tempDir = getTempDir();
+	string outFile;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		bool hasValue = i + 1 < argc;
+
+		if( strcmp( argv[i], "-out" ) == 0 && hasValue ) outFile = argv[++i];
+		else if( strcmp( argv[i], "-content" ) == 0 && hasValue ) config.contentDir = argv[++i];
+		else if( strcmp( argv[i], "-temp" ) == 0 && hasValue ) config.tempDir = argv[++i];
+		else if( strcmp( argv[i], "-filter" ) == 0 && hasValue ) config.filter = argv[++i];
+		else if( strcmp( argv[i], "-quick" ) == 0 ) config.quick = true;
+		else
+		{
+			printHelp();
+			return 1;
+		}
+	}
+
+	// The null render device does not need a window or graphics context
+	if( !h3dInit( H3DRenderDevice::Null ) )
+	{
+		printf( "Failed to initialize the engine\n" );
+		return 1;
+	}
+	h3dSetOption( H3DOptions::MaxLogLevel, 2 );
+
+	BenchRunner runner( config );
+	runEngineBenchmarks( runner );
+	runUtilityBenchmarks( runner );
+	runExtensionBenchmarks( runner );
+	runConverterBenchmarks( runner );
+
+	// Print errors and warnings that occurred while running the benchmarks
+	int level;
+	float time;
+	for( const char *msg = h3dGetMessage( &level, &time ); msg[0] != '\0'; msg = h3dGetMessage( &level, &time ) )
+	{
+		if( level <= 2 ) fprintf( stderr, "Engine %s: %s\n", level == 1 ? "error" : "warning", msg );
+	}
+
+	// Run last since the engine is restarted, which discards the messages and loaded resources
+	runJobBenchmarks( runner );
+
+	h3dRelease();
+
+	bool result;
+	if( outFile.empty() )
+	{
+		result = runner.writeJSON( stdout );
+	}
+	else
+	{
+		FILE *f = fopen( outFile.c_str(), "w" );
+		result = f != 0x0 && runner.writeJSON( f );
+		if( f != 0x0 ) fclose( f );
+	}
+
+	if( !result ) fprintf( stderr, "Failed to write results\n" );
+
+	return result && !runner.hasFailures() ? 0 : 1;
+}
@@ -14,6 +14,7 @@
 #include "egMaterial.h"
 #include "egModules.h"
 #include "egRenderer.h"
+#include "utBVH.h"
 
 #include "utDebug.h"
 
@@ -207,7 +208,19 @@ bool MeshNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec
 	Vec3f orig = m * rayOrig;
 	Vec3f dir = m * (rayOrig + rayDir) - orig;
 
+	// Software skinned geometry changes every frame, so a hierarchy would have to be rebuilt per query
+	const TriangleBVH *bvh = _parentModel->usesSoftwareSkinning() ? 0x0 : geoRes->getBVH( _batchStart, _batchCount );
+	if( bvh != 0x0 )
+	{
+		float t;
+		if( !bvh->intersect( geoRes->getVertPosData(), orig, dir, t ) ) return false;
+		
+		intsPos = _absTrans * (orig + dir * t);
+		return true;
+	}
+
 	Vec3f nearestIntsPos = Vec3f( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
+	float nearestDist = Math::MaxFloat;
 	bool intersection = false;
 	
 	// Check triangles
@@ -230,9 +243,14 @@ bool MeshNode::checkIntersection( const Vec3f &rayOrig, const Vec3f &rayDir, Vec
 		
 		if( rayTriangleIntersection( orig, dir, *vert0, *vert1, *vert2, intsPos ) )
 		{
+			Vec3f v = intsPos - orig;
+			float dist = v.dot( v );
 			intersection = true;
-			if( (intsPos - orig).length() < (nearestIntsPos - orig).length() )
+			if( dist < nearestDist )
+			{
+				nearestDist = dist;
 				nearestIntsPos = intsPos;
+			}
 		}
 	}
 
@@ -14,6 +14,7 @@
 #include "egAnimation.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include <cstring>
 #include <algorithm>
 
@@ -84,6 +85,8 @@ struct AnimEntCompFunc  // Functor for std::sort (can't be nested directly in fu
 
 bool AnimationResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "AnimationResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	// Make sure header is available
@@ -188,6 +191,15 @@ int AnimationResource::getElemParamI( int elem, int elemIdx, int param ) const
 }
 
 
+void AnimationResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = _entities.size() * sizeof( AnimResEntity );
+	for( size_t i = 0; i < _entities.size(); ++i )
+		cpuBytes += _entities[i].frames.size() * sizeof( Frame );
+	gpuBytes = 0;
+}
+
+
 AnimResEntity *AnimationResource::findEntity( uint32 nameId )
 {
 	// Perform binary search (requires that _entities is sorted)
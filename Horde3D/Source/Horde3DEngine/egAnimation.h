@@ -68,6 +68,7 @@ public:
 
 	int getElemCount( int elem ) const;
 	int getElemParamI( int elem, int elemIdx, int param ) const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	AnimResEntity *findEntity( uint32 nameId );
 
@@ -0,0 +1,337 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egCapture.h"
+#include "egModules.h"
+#include "egCom.h"
+#include <algorithm>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+FILE *APICapture::_file = 0x0;
+int64 APICapture::_fileSize = 0;
+vector< char > APICapture::_buffer;
+unordered_multimap< uint64, uint32 > APICapture::_dataIds;
+vector< APICapture::StoredData > APICapture::_dataBlocks;
+Timer APICapture::_frameTimer;
+ResHandle APICapture::_mappedRes = 0;
+int APICapture::_mappedElem = 0;
+int APICapture::_mappedElemIdx = 0;
+int APICapture::_mappedStream = 0;
+void *APICapture::_mappedData = 0x0;
+
+
+namespace {
+
+uint64 hashData( const void *data, uint32 size )
+{
+	// 64 bit FNV-1a; the size is mixed in to separate blocks with equal prefixes
+	uint64 hash = 14695981039346656037ULL ^ size;
+	const unsigned char *bytes = (const unsigned char *)data;
+	for( uint32 i = 0; i < size; ++i )
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+
+	return hash;
+}
+
+
+int seekFile( FILE *f, int64 offset, int origin )
+{
+#if defined( PLATFORM_WIN )
+	return _fseeki64( f, offset, origin );
+#else
+	return fseeko( f, (off_t)offset, origin );
+#endif
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+// Class APICapture
+// *************************************************************************************************
+
+bool APICapture::begin( const char *fileName )
+{
+	if( _file != 0x0 ) end();
+
+	// Opened for reading as well to compare data blocks with the ones already written
+	_file = fopen( fileName, "w+b" );
+	if( _file == 0x0 )
+	{
+		Modules::log().writeError( "Failed to open capture file '%s'", fileName );
+		return false;
+	}
+
+	_fileSize = 0;
+	_buffer.reserve( FlushSize + 4096 );
+	writeValue( CaptureMagic );
+	writeValue( CaptureVersion );
+	_frameTimer.reset();
+	_frameTimer.setEnabled( true );
+	_mappedData = 0x0;
+
+	Modules::log().writeInfo( "Capturing API calls to '%s'", fileName );
+	return true;
+}
+
+
+void APICapture::end()
+{
+	if( _file == 0x0 ) return;
+
+	flush();
+	fclose( _file );
+	_file = 0x0;
+
+	_buffer.clear();
+	_dataIds.clear();
+	_dataBlocks.clear();
+	_frameTimer.setEnabled( false );
+	_mappedData = 0x0;
+}
+
+
+void APICapture::recordFrame()
+{
+	float frameTime = _frameTimer.getElapsedTimeMS();
+	_frameTimer.reset();
+
+	record( CaptureCalls::FinalizeFrame, frameTime );
+	flush();
+}
+
+
+void APICapture::setMappedStream( ResHandle res, int elem, int elemIdx, int stream, void *data )
+{
+	_mappedRes = res;
+	_mappedElem = elem;
+	_mappedElemIdx = elemIdx;
+	_mappedStream = stream;
+	_mappedData = data;
+}
+
+
+void APICapture::recordStreamUpdate( ResHandle res, uint32 size )
+{
+	if( _mappedData == 0x0 || res != _mappedRes ) return;
+
+	if( size > 0 )
+	{
+		record( CaptureCalls::UpdateResStream, res, _mappedElem, _mappedElemIdx, _mappedStream,
+		        CaptureData( _mappedData, size ) );
+	}
+	_mappedData = 0x0;
+}
+
+
+void APICapture::writeBytes( const void *data, size_t size )
+{
+	const char *bytes = (const char *)data;
+	_buffer.insert( _buffer.end(), bytes, bytes + size );
+}
+
+
+void APICapture::writeValue( const char *str )
+{
+	if( str == 0x0 )
+	{
+		writeValue( CaptureNullString );
+		return;
+	}
+
+	uint32 len = (uint32)strlen( str ) + 1;
+	writeValue( len );
+	writeBytes( str, len );
+}
+
+
+void APICapture::writeValue( const CaptureData &data )
+{
+	// Resources are often loaded several times, e.g. after unloading; their data is stored once.
+	// Blocks with the same hash are compared, since a collision would silently replay wrong data.
+	uint64 hash = hashData( data.data, data.size );
+	typedef unordered_multimap< uint64, uint32 >::iterator DataIdItr;
+	pair< DataIdItr, DataIdItr > range = _dataIds.equal_range( hash );
+	for( DataIdItr itr = range.first; itr != range.second; ++itr )
+	{
+		if( isStoredData( itr->second, data ) )
+		{
+			writeValue( itr->second );
+			return;
+		}
+	}
+
+	uint32 id = (uint32)_dataBlocks.size();
+	_dataIds.insert( make_pair( hash, id ) );
+	writeValue( id | CaptureNewData );
+	writeValue( data.size );
+
+	StoredData stored;
+	stored.offset = _fileSize + (int64)_buffer.size();
+	stored.size = data.size;
+	_dataBlocks.push_back( stored );
+
+	// Large blocks are written directly without copying them into the buffer
+	if( data.size >= FlushSize )
+	{
+		flush();
+		if( fwrite( data.data, 1, data.size, _file ) != data.size )
+			Modules::log().writeError( "Failed to write capture file" );
+		_fileSize += data.size;
+	}
+	else
+	{
+		writeBytes( data.data, data.size );
+	}
+}
+
+
+void APICapture::writeValue( const CaptureFloats &floats )
+{
+	uint32 count = floats.values != 0x0 ? floats.count : 0;
+	writeValue( count );
+	writeBytes( floats.values, count * sizeof( float ) );
+}
+
+
+bool APICapture::isStoredData( uint32 id, const CaptureData &data )
+{
+	const StoredData &stored = _dataBlocks[id];
+	if( stored.size != data.size ) return false;
+
+	// The block is read back from the file instead of keeping copies of all data in memory
+	flush();
+	bool equal = seekFile( _file, stored.offset, SEEK_SET ) == 0;
+
+	char chunk[4096];
+	for( uint32 pos = 0; pos < stored.size && equal; pos += sizeof( chunk ) )
+	{
+		uint32 len = std::min( stored.size - pos, (uint32)sizeof( chunk ) );
+		equal = fread( chunk, 1, len, _file ) == len && memcmp( chunk, (const char *)data.data + pos, len ) == 0;
+	}
+
+	seekFile( _file, 0, SEEK_END );
+	return equal;
+}
+
+
+void APICapture::flush()
+{
+	if( _file == 0x0 || _buffer.empty() ) return;
+
+	if( fwrite( &_buffer[0], 1, _buffer.size(), _file ) != _buffer.size() )
+		Modules::log().writeError( "Failed to write capture file" );
+	_fileSize += (int64)_buffer.size();
+	_buffer.clear();
+}
+
+
+// *************************************************************************************************
+// Class CaptureReader
+// *************************************************************************************************
+
+bool CaptureReader::open( const char *fileName )
+{
+	FILE *f = fopen( fileName, "rb" );
+	if( f == 0x0 ) return false;
+
+	// The whole capture is kept in memory, so that replaying does not wait for file accesses
+	fseek( f, 0, SEEK_END );
+	long size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	_data.resize( size > 0 ? (size_t)size : 0 );
+	bool result = _data.empty() || fread( &_data[0], 1, _data.size(), f ) == _data.size();
+	fclose( f );
+
+	_pos = 0;
+	_error = !result;
+	_dataBlocks.clear();
+
+	if( readValue< uint32 >() != CaptureMagic || readValue< uint32 >() != CaptureVersion )
+		_error = true;
+
+	return !_error;
+}
+
+
+const char *CaptureReader::readString()
+{
+	uint32 len = readValue< uint32 >();
+	if( len == CaptureNullString || _error ) return 0x0;
+	if( len == 0 || _pos + len > _data.size() || _data[_pos + len - 1] != '\0' )
+	{
+		_error = true;
+		return 0x0;
+	}
+
+	const char *str = &_data[_pos];
+	_pos += len;
+	return str;
+}
+
+
+const char *CaptureReader::readData( uint32 &size )
+{
+	size = 0;
+	uint32 id = readValue< uint32 >();
+	if( _error ) return 0x0;
+
+	if( id & CaptureNewData )
+	{
+		size = readValue< uint32 >();
+		if( _error || (id & ~CaptureNewData) != _dataBlocks.size() || _pos + size > _data.size() )
+		{
+			_error = true;
+			return 0x0;
+		}
+
+		_dataBlocks.push_back( pair< const char *, uint32 >( size > 0 ? &_data[_pos] : 0x0, size ) );
+		_pos += size;
+		return _dataBlocks.back().first;
+	}
+
+	if( id >= _dataBlocks.size() )
+	{
+		_error = true;
+		return 0x0;
+	}
+
+	size = _dataBlocks[id].second;
+	return _dataBlocks[id].first;
+}
+
+
+const float *CaptureReader::readFloats( uint32 &count )
+{
+	count = readValue< uint32 >();
+	if( _error || _pos + (size_t)count * sizeof( float ) > _data.size() )
+	{
+		_error = true;
+		count = 0;
+		return 0x0;
+	}
+
+	// Copied since the values are not aligned in the file
+	_floats.resize( count );
+	if( count > 0 ) memcpy( &_floats[0], &_data[_pos], count * sizeof( float ) );
+	_pos += count * sizeof( float );
+
+	return count > 0 ? &_floats[0] : 0x0;
+}
+
+}  // namespace
@@ -0,0 +1,225 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egCapture_H_
+#define _egCapture_H_
+
+#include "egPrerequisites.h"
+#include "utTimer.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// Capture Format
+// =================================================================================================
+
+// A capture file starts with CaptureMagic and CaptureVersion followed by one record per API call:
+// the call id as uint16 and the arguments in the order of the function signature. Values are stored
+// in native byte order: ints and floats with 4 bytes, bools with 1 byte, strings as uint32 length
+// including the terminator (CaptureNullString for null pointers) and the characters, float arrays as
+// uint32 count and the values. Data blocks are stored once as uint32 id, uint32 size and the bytes;
+// later uses of the same data only store the id. Calls that create handles store the returned handle
+// as last value, so that a replay can detect divergences.
+const uint32 CaptureMagic = 0x43443348;  // "H3DC"
+const uint32 CaptureVersion = 1;
+const uint32 CaptureNullString = 0xFFFFFFFF;
+const uint32 CaptureNewData = 0x80000000;  // Set in the id of data that is stored for the first time
+
+// Ids are part of the file format; new calls are appended only
+struct CaptureCalls
+{
+	enum List
+	{
+		FinalizeFrame = 1,  // Frame time of the captured application in ms
+		Render,
+		Compute,
+		Clear,
+		SetOption,
+		AddResource,
+		CloneResource,
+		RemoveResource,
+		LoadResource,
+		UnloadResource,
+		SetResParamI,
+		SetResParamF,
+		SetResParamStr,
+		UpdateResStream,  // Data written to a mapped resource stream, stored on unmapping
+		ReleaseUnusedResources,
+		CreateTexture,
+		SetShaderPreambles,
+		SetMaterialUniform,
+		ResizePipelineBuffers,
+		SetNodeParent,
+		AddNodes,
+		RemoveNode,
+		SetNodeTransform,
+		SetNodeTransMat,
+		SetNodeParamI,
+		SetNodeParamF,
+		SetNodeParamStr,
+		SetNodeFlags,
+		FindNodes,
+		SetNodeUniforms,
+		CastRay,
+		CastRays,
+		CheckNodeVisibility,
+		AddGroupNode,
+		AddModelNode,
+		SetupModelAnimStage,
+		SetModelAnimParams,
+		SetModelMorpher,
+		UpdateModel,
+		AddMeshNode,
+		AddJointNode,
+		AddLightNode,
+		AddCameraNode,
+		SetupCameraView,
+		SetCameraProjMat,
+		AddEmitterNode,
+		UpdateEmitter,
+		AddComputeNode
+	};
+};
+
+struct CaptureData
+{
+	const void  *data;
+	uint32      size;
+
+	CaptureData( const void *data, uint32 size ) : data( data ), size( size ) {}
+};
+
+struct CaptureFloats
+{
+	const float  *values;
+	uint32       count;
+
+	CaptureFloats( const float *values, uint32 count ) : values( values ), count( count ) {}
+};
+
+// =================================================================================================
+// API Capture
+// =================================================================================================
+
+// Records the calls of the public API that change the engine state or cause work into a capture
+// file. Calls are recorded after they were executed and only if they passed the argument validation.
+// Only calls of the core API are recorded; the functions of extensions like Terrain and Overlays are
+// not, so nodes and overlays created by them are missing in a replay.
+class APICapture
+{
+public:
+	static bool begin( const char *fileName );
+	static void end();
+	static bool isActive() { return _file != 0x0; }
+
+	template< class... Args > static void record( CaptureCalls::List call, const Args &... args )
+	{
+		writeValue( (uint16)call );
+		writeValues( args... );
+		if( _buffer.size() >= FlushSize ) flush();
+	}
+
+	// Frames are ended by h3dFinalizeFrame; the capture file is flushed once per frame
+	static void recordFrame();
+
+	// Remembers the stream mapped for writing, so that its contents can be recorded on unmapping
+	static void setMappedStream( ResHandle res, int elem, int elemIdx, int stream, void *data );
+	static void recordStreamUpdate( ResHandle res, uint32 size );
+
+private:
+	static const size_t FlushSize = 1 << 20;
+
+	static void writeValues() {}
+	template< class T, class... Args > static void writeValues( const T &value, const Args &... args )
+	{
+		writeValue( value );
+		writeValues( args... );
+	}
+
+	static void writeBytes( const void *data, size_t size );
+	static void writeValue( uint16 value ) { writeBytes( &value, sizeof( value ) ); }
+	static void writeValue( uint32 value ) { writeBytes( &value, sizeof( value ) ); }
+	static void writeValue( int value ) { writeBytes( &value, sizeof( value ) ); }
+	static void writeValue( float value ) { writeBytes( &value, sizeof( value ) ); }
+	static void writeValue( bool value ) { uint8 v = value ? 1 : 0; writeBytes( &v, 1 ); }
+	static void writeValue( const char *str );
+	static void writeValue( const CaptureData &data );
+	static void writeValue( const CaptureFloats &floats );
+	static bool isStoredData( uint32 id, const CaptureData &data );
+
+	static void flush();
+
+private:
+	struct StoredData
+	{
+		int64   offset;  // Position in the capture file
+		uint32  size;
+	};
+
+	static FILE                                        *_file;
+	static int64                                       _fileSize;  // Bytes written to the file without the buffer
+	static std::vector< char >                         _buffer;
+	static std::unordered_multimap< uint64, uint32 >   _dataIds;  // Hash of stored data blocks
+	static std::vector< StoredData >                   _dataBlocks;  // By id, to compare blocks with equal hashes
+	static Timer                                       _frameTimer;
+
+	static ResHandle                                   _mappedRes;
+	static int                                         _mappedElem, _mappedElemIdx, _mappedStream;
+	static void                                        *_mappedData;
+};
+
+// =================================================================================================
+
+// Reads a capture file for replaying it; values are returned in the order they were written
+class CaptureReader
+{
+public:
+	CaptureReader() : _pos( 0 ), _error( false ) {}
+
+	bool open( const char *fileName );
+	bool atEnd() const { return _pos >= _data.size() || _error; }
+	bool hasError() const { return _error; }
+
+	int readCall() { return readValue< uint16 >(); }
+	int readInt() { return readValue< int >(); }
+	float readFloat() { return readValue< float >(); }
+	bool readBool() { return readValue< uint8 >() != 0; }
+	const char *readString();  // Valid as long as the reader exists
+	const char *readData( uint32 &size );  // Valid as long as the reader exists
+	const float *readFloats( uint32 &count );  // Valid until the next call of readFloats
+
+private:
+	template< class T > T readValue()
+	{
+		T value = T();
+		if( _pos + sizeof( T ) > _data.size() ) { _error = true; return value; }
+		memcpy( &value, &_data[_pos], sizeof( T ) );
+		_pos += sizeof( T );
+		return value;
+	}
+
+private:
+	std::vector< char >                                _data;
+	size_t                                             _pos;
+	bool                                               _error;
+	std::vector< std::pair< const char *, uint32 > >   _dataBlocks;
+	std::vector< float >                               _floats;
+};
+
+}
+#endif // _egCapture_H_
@@ -14,14 +14,20 @@
 #include "utMath.h"
 #include "egModules.h"
 #include "egRenderer.h"
+#include "egProfiler.h"
+#include "egJobs.h"
 #include <stdarg.h>
 #include <stdio.h>
+#include <cstring>
+#include <thread>
 
 #include "utDebug.h"
 
 
 namespace Horde3D {
 
+using namespace std;
+
 // *************************************************************************************************
 // Class EngineConfig
 // *************************************************************************************************
@@ -37,10 +43,17 @@ EngineConfig::EngineConfig()
 	fastAnimation = true;
 	shadowMapSize = 1024;
 	sampleCount = 0;
+	texMipmapFilter = 0;
+	texStreamingBudget = 0;
+	shadowMapCacheSize = 0;
+	renderTargetAliasing = false;
+	resourceMemoryBudget = 0;
+	discardCPUCopies = false;
 	wireframeMode = false;
 	debugViewMode = false;
 	dumpFailedShaders = false;
 	gatherTimeStats = true;
+	softwareOcclusion = false;
 	debugRenderBackend = false;
 }
 
@@ -79,6 +92,24 @@ float EngineConfig::getOption( EngineOptions::List param ) const
 		return gatherTimeStats ? 1.0f : 0.0f;
 	case EngineOptions::DebugRenderBackend:
 		return debugRenderBackend ? 1.0f : 0.0f;
+	case EngineOptions::TexMipmapFilter:
+		return (float)texMipmapFilter;
+	case EngineOptions::TexStreamingBudget:
+		return (float)texStreamingBudget;
+	case EngineOptions::SoftwareOcclusion:
+		return softwareOcclusion ? 1.0f : 0.0f;
+	case EngineOptions::ShadowMapCacheSize:
+		return (float)shadowMapCacheSize;
+	case EngineOptions::RenderTargetAliasing:
+		return renderTargetAliasing ? 1.0f : 0.0f;
+	case EngineOptions::CPUProfiler:
+		return Profiler::isEnabled() ? 1.0f : 0.0f;
+	case EngineOptions::ResourceMemoryBudget:
+		return (float)resourceMemoryBudget;
+	case EngineOptions::DiscardCPUCopies:
+		return discardCPUCopies ? 1.0f : 0.0f;
+	case EngineOptions::WorkerThreads:
+		return (float)Modules::jobMan().getNumWorkers();
 	default:
 		Modules::setError( "Invalid param for h3dGetOption" );
 		return Math::NaN;
@@ -124,6 +155,7 @@ bool EngineConfig::setOption( EngineOptions::List param, float value )
 
 		// Update shadow map
 		Modules::renderer().releaseShadowRB();
+		Modules::renderer().releaseShadowCache();
 		
 		if( !Modules::renderer().createShadowRB( size, size ) )
 		{
@@ -160,6 +192,47 @@ bool EngineConfig::setOption( EngineOptions::List param, float value )
 										   Modules::renderer().getRenderDevice()->disableDebugOutput();
 		return result;
 	}
+	case EngineOptions::TexMipmapFilter:
+		size = ftoi_r( value );
+		if( size < 0 || size > 2 ) return false;
+		texMipmapFilter = size;
+		return true;
+	case EngineOptions::TexStreamingBudget:
+		size = ftoi_r( value );
+		if( size < 0 ) return false;
+		texStreamingBudget = size;
+		return true;
+	case EngineOptions::SoftwareOcclusion:
+		softwareOcclusion = (value != 0);
+		return true;
+	case EngineOptions::ShadowMapCacheSize:
+		size = ftoi_r( value );
+		if( size < 0 ) return false;
+		shadowMapCacheSize = size;
+		Modules::renderer().releaseShadowCache();
+		return true;
+	case EngineOptions::RenderTargetAliasing:
+		renderTargetAliasing = (value != 0);
+		return true;
+	case EngineOptions::CPUProfiler:
+#ifndef H3D_PROFILER
+		if( value != 0 ) return false;
+#endif
+		Profiler::setEnabled( value != 0 );
+		return true;
+	case EngineOptions::ResourceMemoryBudget:
+		size = ftoi_r( value );
+		if( size < 0 ) return false;
+		resourceMemoryBudget = size;
+		Modules::resMan().checkMemoryBudget();
+		return true;
+	case EngineOptions::DiscardCPUCopies:
+		discardCPUCopies = (value != 0);
+		return true;
+	case EngineOptions::WorkerThreads:
+		size = ftoi_r( value );
+		if( size < -1 || size > MaxWorkerThreads ) return false;
+		return Modules::jobMan().setNumWorkers( size );
 	default:
 		Modules::setError( "Invalid param for h3dSetOption" );
 		return false;
@@ -183,18 +256,187 @@ EngineLog::EngineLog()
 {
 	_timer.setEnabled( true );
 	_maxNumMessages = 512;
+	_inFlush = false;
+
+	for( uint32 i = 0; i < NumLogRecords; ++i )
+		_records[i].sequence.store( i, memory_order_relaxed );
+	_writePos.store( 0, memory_order_relaxed );
+	_readPos = 0;
+	_numDropped.store( 0, memory_order_relaxed );
+
+	for( uint32 i = 0; i < NumLogCallsites; ++i )
+	{
+		_callsites[i].second.store( 0, memory_order_relaxed );
+		_callsites[i].count.store( 0, memory_order_relaxed );
+		_callsites[i].suppressed.store( 0, memory_order_relaxed );
+	}
+}
+
+
+EngineLog::~EngineLog()
+{
+	flush();
 }
 
 
-void EngineLog::pushMessage( int level, const char *msg, va_list args )
+void EngineLog::pushMessage( int level, bool rateLimited, const char *msg, va_list args )
 {
 	float time = _timer.getElapsedTimeMS() / 1000.0f;
 
-	vsnprintf( _textBuf, 2048, msg, args );
+	// Only debug messages are limited; errors and warnings must not get lost and info messages are
+	// written once per event like loading a resource
+	uint32 suppressed = 0;
+	if( rateLimited && level == 4 && !checkRateLimit( msg, time, suppressed ) ) return;
+
+	bool pushed = false;
+	for( uint32 attempt = 0; attempt < MaxLogPushAttempts; ++attempt )
+	{
+		va_list argsCopy;
+		va_copy( argsCopy, args );
+		pushed = pushRecord( level, time, msg, argsCopy );
+		va_end( argsCopy );
+		if( pushed ) break;
+
+		// Ring buffer is full: make room or wait for the thread that is flushing; messages written
+		// by the callback during a flush are dropped
+		if( _flushMutex.try_lock() )
+		{
+			bool inFlush = _inFlush;
+			if( !inFlush ) flushRecords();
+			_flushMutex.unlock();
+			if( inFlush ) break;
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+
+	if( !pushed )
+		_numDropped.fetch_add( 1, memory_order_relaxed );
+	else if( suppressed > 0 )
+		pushFormattedRecord( level, time, "(%u similar messages were suppressed)", suppressed );
+}
 
+
+bool EngineLog::pushRecord( int level, float time, const char *format, va_list args )
+{
+	// Reserve a record; the sequence of a free record equals the write position
+	uint32 pos = _writePos.load( memory_order_relaxed );
+	LogRecord *rec;
+	for(;;)
+	{
+		rec = &_records[pos & (NumLogRecords - 1)];
+		int32 diff = (int32)(rec->sequence.load( memory_order_acquire ) - pos);
+		if( diff == 0 )
+		{
+			if( _writePos.compare_exchange_weak( pos, pos + 1, memory_order_relaxed ) ) break;
+		}
+		else if( diff < 0 )
+		{
+			return false;  // Full
+		}
+		else
+		{
+			pos = _writePos.load( memory_order_relaxed );
+		}
+	}
+
+	rec->level = level;
+	rec->time = time;
+	int len = vsnprintf( rec->text, LogRecordTextSize, format, args );
+	if( len < 0 ) rec->text[0] = '\0';
+	else if( len >= (int)LogRecordTextSize ) memcpy( rec->text + LogRecordTextSize - 4, "...", 4 );
+
+	rec->sequence.store( pos + 1, memory_order_release );
+	return true;
+}
+
+
+bool EngineLog::pushFormattedRecord( int level, float time, const char *format, ... )
+{
+	va_list args;
+	va_start( args, format );
+	bool result = pushRecord( level, time, format, args );
+	va_end( args );
+
+	return result;
+}
+
+
+bool EngineLog::checkRateLimit( const char *msg, float time, uint32 &suppressed )
+{
+	// Callsites are identified by their format string; callsites that share a slot share the limit
+	size_t key = (size_t)msg;
+	LogCallsite &callsite = _callsites[(key ^ (key >> 7) ^ (key >> 17)) & (NumLogCallsites - 1)];
+
+	uint32 second = (uint32)time;
+	uint32 prevSecond = callsite.second.load( memory_order_relaxed );
+	if( prevSecond != second && callsite.second.compare_exchange_strong( prevSecond, second, memory_order_relaxed ) )
+	{
+		callsite.count.store( 0, memory_order_relaxed );
+		suppressed = callsite.suppressed.exchange( 0, memory_order_relaxed );
+	}
+
+	if( callsite.count.fetch_add( 1, memory_order_relaxed ) < MaxLogMessagesPerSecond ) return true;
+
+	callsite.suppressed.fetch_add( 1, memory_order_relaxed );
+	return false;
+}
+
+
+void EngineLog::flush()
+{
+	lock_guard< recursive_mutex > lock( _flushMutex );
+
+	// Messages written by the callback are passed on with the next flush
+	if( !_inFlush ) flushRecords();
+}
+
+
+void EngineLog::flushRecords()
+{
+	_inFlush = true;
+
+	for(;;)
+	{
+		LogRecord &rec = _records[_readPos & (NumLogRecords - 1)];
+		if( rec.sequence.load( memory_order_acquire ) != _readPos + 1 ) break;
+
+		dispatchMessage( rec.level, rec.time, rec.text );
+
+		rec.sequence.store( _readPos + NumLogRecords, memory_order_release );
+		++_readPos;
+	}
+
+	// Report messages suppressed by callsites that did not write again since then
+	uint32 numSuppressed = 0;
+	for( uint32 i = 0; i < NumLogCallsites; ++i )
+		numSuppressed += _callsites[i].suppressed.exchange( 0, memory_order_relaxed );
+	if( numSuppressed > 0 )
+	{
+		char text[64];
+		snprintf( text, sizeof( text ), "%u debug messages were suppressed", numSuppressed );
+		dispatchMessage( 4, _timer.getElapsedTimeMS() / 1000.0f, text );
+	}
+
+	uint32 numDropped = _numDropped.exchange( 0, memory_order_relaxed );
+	if( numDropped > 0 )
+	{
+		char text[64];
+		snprintf( text, sizeof( text ), "%u log messages were dropped", numDropped );
+		dispatchMessage( 2, _timer.getElapsedTimeMS() / 1000.0f, text );
+	}
+
+	_inFlush = false;
+}
+
+
+void EngineLog::dispatchMessage( int level, float time, const char *text )
+{
 	if( _messages.size() < _maxNumMessages - 1 )
 	{
-		_messages.push( LogMessage( _textBuf, level, time ) );
+		_messages.push( LogMessage( text, level, time ) );
 	}
 	else if( _messages.size() == _maxNumMessages - 1 )
 	{
@@ -202,19 +444,19 @@ void EngineLog::pushMessage( int level, const char *msg, va_list args )
 	}
 
 	if (_callback) {
-		_callback(level, _textBuf);
+		_callback(level, text);
 	}
 #if defined( H3D_DEBUGGER_OUTPUT )
 	static const char *headers[6] = { "", "  [h3d-err] ", "  [h3d-warn] ", "[h3d] ", "  [h3d-dbg] ", "[h3d- ] "};
 #if defined( PLATFORM_WIN )
 	OutputDebugStringA( headers[std::min( (uint32)level, (uint32)5 )] );
-	OutputDebugStringA( _textBuf );
+	OutputDebugStringA( text );
 	OutputDebugString( TEXT("\r\n") );
 #elif defined( PLATFORM_ANDROID )
-	__android_log_print( ANDROID_LOG_DEBUG, "h3d", "%s%s\n", headers[std::min( (uint32)level, (uint32)5 )], _textBuf );
+	__android_log_print( ANDROID_LOG_DEBUG, "h3d", "%s%s\n", headers[std::min( (uint32)level, (uint32)5 )], text );
 #else
 	fputs( headers[std::min( (uint32)level, (uint32)5 )], stderr );
-	fputs( _textBuf, stderr );
+	fputs( text, stderr );
 	fputs( "\n", stderr );
 #endif
 #endif
@@ -227,7 +469,7 @@ void EngineLog::writeError( const char *msg, ... )
 
 	va_list args;
 	va_start( args, msg );
-	pushMessage( 1, msg, args );
+	pushMessage( 1, true, msg, args );
 	va_end( args );
 }
 
@@ -238,7 +480,7 @@ void EngineLog::writeWarning( const char *msg, ... )
 
 	va_list args;
 	va_start( args, msg );
-	pushMessage( 2, msg, args );
+	pushMessage( 2, true, msg, args );
 	va_end( args );
 }
 
@@ -249,7 +491,7 @@ void EngineLog::writeInfo( const char *msg, ... )
 
 	va_list args;
 	va_start( args, msg );
-	pushMessage( 3, msg, args );
+	pushMessage( 3, true, msg, args );
 	va_end( args );
 }
 
@@ -260,13 +502,27 @@ void EngineLog::writeDebugInfo( const char *msg, ... )
 
 	va_list args;
 	va_start( args, msg );
-	pushMessage( 4, msg, args );
+	pushMessage( 4, true, msg, args );
+	va_end( args );
+}
+
+
+void EngineLog::writeUnlimited( int level, const char *msg, ... )
+{
+	if( Modules::config().maxLogLevel < level ) return;
+
+	va_list args;
+	va_start( args, msg );
+	pushMessage( level, false, msg, args );
 	va_end( args );
 }
 
 
 bool EngineLog::getMessage( LogMessage &msg )
 {
+	lock_guard< recursive_mutex > lock( _flushMutex );
+	if( !_inFlush ) flushRecords();
+
 	if( !_messages.empty() )
 	{
 		msg = _messages.front();
@@ -282,12 +538,40 @@ bool EngineLog::getMessage( LogMessage &msg )
 // Class StatManager
 // *************************************************************************************************
 
+static int *getRenderCounter( RenderCounters &counters, int param )
+{
+	switch( param )
+	{
+	case EngineStats::TriCount: return &counters.triCount;
+	case EngineStats::BatchCount: return &counters.batchCount;
+	case EngineStats::LightPassCount: return &counters.lightPassCount;
+	case EngineStats::ShaderBindCount: return &counters.shaderBinds;
+	case EngineStats::MaterialBindCount: return &counters.materialBinds;
+	case EngineStats::TextureBindCount: return &counters.textureBinds;
+	case EngineStats::GeometryBindCount: return &counters.geometryBinds;
+	case EngineStats::UniformUploadCount: return &counters.uniformUploads;
+	case EngineStats::UniformUploadSize: return &counters.uniformBytes;
+	case EngineStats::BufferUploadSize: return &counters.bufferUploadBytes;
+	case EngineStats::RenderTargetSwitchCount: return &counters.renderTargetSwitches;
+	case EngineStats::OcclusionQueryCount: return &counters.occlusionQueries;
+	case EngineStats::OcclusionQueryCulledCount: return &counters.occlusionQueryCulled;
+	default: return 0x0;
+	}
+}
+
+
 StatManager::StatManager() : _fwdLightsGPUTimer( 0 ), _defLightsGPUTimer( 0 ), _shadowsGPUTimer( 0 ), _particleGPUTimer( 0 ),
 							 _computeGPUTimer( 0 )
 {
-	_statTriCount = 0;
-	_statBatchCount = 0;
-	_statLightPassCount = 0;
+	memset( &_counters, 0, sizeof( RenderCounters ) );
+	memset( &_curFrame, 0, sizeof( FrameStats ) );
+	memset( &_lastFrame, 0, sizeof( FrameStats ) );
+	_curStage = -1;
+	_deviceCounters = new RDICounters();
+
+	_statOccCulledCount = 0;
+	_statShadowMapRenders = 0;
+	_statViewObjects = 0;
 
 	_frameTime = 0;
 }
@@ -295,6 +579,7 @@ StatManager::StatManager() : _fwdLightsGPUTimer( 0 ), _defLightsGPUTimer( 0 ), _
 
 StatManager::~StatManager()
 {
+	delete _deviceCounters; _deviceCounters = 0x0;
 	if ( _fwdLightsGPUTimer ) { delete _fwdLightsGPUTimer; _fwdLightsGPUTimer = 0; }
 	if ( _defLightsGPUTimer ) { delete _defLightsGPUTimer; _defLightsGPUTimer = 0; }
 	if ( _shadowsGPUTimer ) { delete _shadowsGPUTimer; _shadowsGPUTimer = 0; }
@@ -315,6 +600,8 @@ bool StatManager::init()
 	_particleGPUTimer = rdi->createGPUTimer();
 	_computeGPUTimer = rdi->createGPUTimer();
 
+	*_deviceCounters = rdi->getCounters();
+
 	return true;
 }
 
@@ -322,20 +609,17 @@ float StatManager::getStat( int param, bool reset )
 {
 	float value;	
 	
-	switch( param )
+	int *counter = getRenderCounter( _counters, param );
+	if( counter != 0x0 )
 	{
-	case EngineStats::TriCount:
-		value = (float)_statTriCount;
-		if( reset ) _statTriCount = 0;
-		return value;
-	case EngineStats::BatchCount:
-		value = (float)_statBatchCount;
-		if( reset ) _statBatchCount = 0;
-		return value;
-	case EngineStats::LightPassCount:
-		value = (float)_statLightPassCount;
-		if( reset ) _statLightPassCount = 0;
+		updateDeviceCounters();
+		value = (float)*counter;
+		if( reset ) *counter = 0;
 		return value;
+	}
+
+	switch( param )
+	{
 	case EngineStats::FrameTime:
 		value = _frameTime;
 		if( reset ) _frameTime = 0;
@@ -380,6 +664,22 @@ float StatManager::getStat( int param, bool reset )
 		value = _cullingTimer.getElapsedTimeMS();
 		if ( reset ) _cullingTimer.reset();
 		return value;
+	case EngineStats::TexStreamingPressure:
+		return Modules::renderer().getTexStreamer().getPressure();
+	case EngineStats::TexStreamingMem:
+		return ( Modules::renderer().getTexStreamer().getResidentMem() / 1024 ) / 1024.0f;
+	case EngineStats::OcclusionCulledCount:
+		value = (float)_statOccCulledCount;
+		if( reset ) _statOccCulledCount = 0;
+		return value;
+	case EngineStats::ShadowMapRenderCount:
+		value = (float)_statShadowMapRenders;
+		if( reset ) _statShadowMapRenders = 0;
+		return value;
+	case EngineStats::RenderViewObjectCount:
+		value = (float)_statViewObjects;
+		if( reset ) _statViewObjects = 0;
+		return value;
 	default:
 		Modules::setError( "Invalid param for h3dGetStat" );
 		return Math::NaN;
@@ -389,16 +689,19 @@ float StatManager::getStat( int param, bool reset )
 
 void StatManager::incStat( int param, float value )
 {
+	if( getRenderCounter( _counters, param ) != 0x0 )
+	{
+		incCounter( param, ftoi_r( value ) );
+		return;
+	}
+	
 	switch( param )
 	{
-	case EngineStats::TriCount:
-		_statTriCount += ftoi_r( value );
-		break;
-	case EngineStats::BatchCount:
-		_statBatchCount += ftoi_r( value );
+	case EngineStats::OcclusionCulledCount:
+		_statOccCulledCount += ftoi_r( value );
 		break;
-	case EngineStats::LightPassCount:
-		_statLightPassCount += ftoi_r( value );
+	case EngineStats::ShadowMapRenderCount:
+		_statShadowMapRenders += ftoi_r( value );
 		break;
 	case EngineStats::FrameTime:
 		_frameTime += value;
@@ -427,6 +730,89 @@ Timer *StatManager::getTimer( int param )
 }
 
 
+void StatManager::incCounter( int param, int value )
+{
+	*getRenderCounter( _counters, param ) += value;
+	*getRenderCounter( _curFrame.counters, param ) += value;
+	if( _curStage >= 0 ) *getRenderCounter( _curFrame.stages[_curStage].counters, param ) += value;
+}
+
+
+void StatManager::updateDeviceCounters()
+{
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	if( rdi == 0x0 ) return;
+
+	// Differences are correct even if the device counters wrapped around
+	const RDICounters &cur = rdi->getCounters();
+	RDICounters &prev = *_deviceCounters;
+	
+	incCounter( EngineStats::ShaderBindCount, (int)(cur.shaderBinds - prev.shaderBinds) );
+	incCounter( EngineStats::TextureBindCount, (int)(cur.textureBinds - prev.textureBinds) );
+	incCounter( EngineStats::GeometryBindCount, (int)(cur.geometryBinds - prev.geometryBinds) );
+	incCounter( EngineStats::UniformUploadCount, (int)(cur.uniformUploads - prev.uniformUploads) );
+	incCounter( EngineStats::UniformUploadSize, (int)(cur.uniformBytes - prev.uniformBytes) );
+	incCounter( EngineStats::BufferUploadSize, (int)(cur.bufferUploadBytes - prev.bufferUploadBytes) );
+	incCounter( EngineStats::RenderTargetSwitchCount, (int)(cur.renderTargetSwitches - prev.renderTargetSwitches) );
+	incCounter( EngineStats::OcclusionQueryCount, (int)(cur.occlusionQueries - prev.occlusionQueries) );
+
+	prev = cur;
+}
+
+
+void StatManager::beginStage( const char *name )
+{
+	// Device calls before the stage belong to the frame only
+	updateDeviceCounters();
+
+	_curStage = -1;
+	for( int i = 0; i < _curFrame.numStages; ++i )
+	{
+		if( strncmp( _curFrame.stages[i].name, name, sizeof( _curFrame.stages[i].name ) - 1 ) == 0 )
+		{
+			_curStage = i;
+			return;
+		}
+	}
+
+	// Stages exceeding the limit are only included in the frame counters
+	if( _curFrame.numStages < (int)MaxStatStages )
+	{
+		_curStage = _curFrame.numStages++;
+		StageStats &stage = _curFrame.stages[_curStage];
+		strncpy( stage.name, name, sizeof( stage.name ) - 1 );
+		stage.name[sizeof( stage.name ) - 1] = '\0';
+	}
+}
+
+
+void StatManager::endStage()
+{
+	updateDeviceCounters();
+	_curStage = -1;
+}
+
+
+void StatManager::addRenderView( uint32 numObjects )
+{
+	_statViewObjects += numObjects;
+	if( _curFrame.numViews < (int)MaxStatViews )
+		_curFrame.viewObjectCounts[_curFrame.numViews++] = (int)numObjects;
+}
+
+
+void StatManager::finalizeFrame()
+{
+	updateDeviceCounters();
+
+	_curFrame.frameTime = _frameTime;
+	_lastFrame = _curFrame;
+	
+	memset( &_curFrame, 0, sizeof( FrameStats ) );
+	_curStage = -1;
+}
+
+
 GPUTimer *StatManager::getGPUTimer( int param ) const
 {
 	switch( param )
@@ -17,12 +17,15 @@
 #include <string>
 #include <queue>
 #include <cstdarg>
+#include <atomic>
+#include <mutex>
 #include "utTimer.h"
 
 
 namespace Horde3D {
 
 class GPUTimer;
+struct RDICounters;
 
 // =================================================================================================
 // Engine Config
@@ -46,7 +49,16 @@ struct EngineOptions
 		DebugViewMode,
 		DumpFailedShaders,
 		GatherTimeStats,
-		DebugRenderBackend
+		DebugRenderBackend,
+		TexMipmapFilter,
+		TexStreamingBudget,
+		SoftwareOcclusion,
+		ShadowMapCacheSize,
+		RenderTargetAliasing,
+		CPUProfiler,
+		ResourceMemoryBudget,
+		DiscardCPUCopies,
+		WorkerThreads
 	};
 };
 
@@ -65,6 +77,10 @@ public:
 	int   maxAnisotropy;
 	int   shadowMapSize;
 	int   sampleCount;
+	int   texMipmapFilter;
+	int   texStreamingBudget;  // In Mb, 0 if streaming is disabled
+	int   shadowMapCacheSize;  // Number of lights with cached shadow maps, 0 if caching is disabled
+	int   resourceMemoryBudget;  // In Mb, 0 if no budget is set
 	bool  texCompression;
 	bool  sRGBLinearization;
 	bool  loadTextures;
@@ -74,7 +90,11 @@ public:
 	bool  debugViewMode;
 	bool  dumpFailedShaders;
 	bool  gatherTimeStats;
+	bool  softwareOcclusion;
+	bool  renderTargetAliasing;
+	bool  discardCPUCopies;
 	bool  debugRenderBackend;
+	std::string  cacheDirectory;  // Location of on-disk caches, empty if disabled
 };
 
 
@@ -98,8 +118,36 @@ struct LogMessage
 	}
 };
 
+const uint32 LogRecordTextSize = 2048;
+const uint32 NumLogRecords = 128;          // Must be a power of two
+const uint32 NumLogCallsites = 256;        // Must be a power of two
+const uint32 MaxLogMessagesPerSecond = 8;  // Per callsite, only for debug messages
+const uint32 MaxLogPushAttempts = 1000;    // Before a message is dropped when the records are full
+
+// Message that was written but not yet passed to the callback and the message queue
+struct LogRecord
+{
+	std::atomic< uint32 >  sequence;
+	int                    level;
+	float                  time;
+	char                   text[LogRecordTextSize];
+};
+
+// Messages of a callsite in the current second, used for rate limiting
+struct LogCallsite
+{
+	std::atomic< uint32 >  second;
+	std::atomic< uint32 >  count;
+	std::atomic< uint32 >  suppressed;
+};
+
 // =================================================================================================
 
+// Messages can be written from any thread without allocating memory or taking a lock; they are
+// formatted into a fixed-size record of a ring buffer and passed to the callback, the debugger output
+// and the message queue when the log is flushed. The log is flushed by the render thread in
+// h3dFinalizeFrame and h3dGetMessage and by a writer that finds the ring buffer full. Messages are
+// only dropped if the ring buffer stays full while another thread flushes it.
 class EngineLog
 {
 public:
@@ -108,28 +156,43 @@ public:
 	static void setMessageCallback(MessageCallback f);
 
 	EngineLog();
+	~EngineLog();
 
 	void writeError( const char *msg, ... );
 	void writeWarning( const char *msg, ... );
 	void writeInfo( const char *msg, ... );
 	void writeDebugInfo( const char *msg, ... );
+	// Writes a message that is not rate limited, e.g. an API error that is assembled at runtime
+	void writeUnlimited( int level, const char *msg, ... );
 
+	void flush();
 	bool getMessage( LogMessage &msg );
 
 	uint32 getMaxNumMessages() const { return _maxNumMessages; }
 	void setMaxNumMessages( uint32 maxNumMessages ) { _maxNumMessages = maxNumMessages; }
 	
 protected:
-	void pushMessage( const std::string &text, uint32 level );
-	void pushMessage( int level, const char *msg, va_list ap );
+	void pushMessage( int level, bool rateLimited, const char *msg, va_list ap );
+	bool pushRecord( int level, float time, const char *format, va_list ap );
+	bool pushFormattedRecord( int level, float time, const char *format, ... );
+	bool checkRateLimit( const char *msg, float time, uint32 &suppressed );
+	void flushRecords();
+	void dispatchMessage( int level, float time, const char *text );
 
 protected:
 	static MessageCallback    _callback;
 
 	Timer                     _timer;
-	char                      _textBuf[2048];
 	uint32                    _maxNumMessages;
 	std::queue< LogMessage >  _messages;
+	std::recursive_mutex      _flushMutex;  // Guards the reading side of the records and the message queue
+	bool                      _inFlush;     // Set while the callback is invoked, which may write messages
+
+	LogRecord                 _records[NumLogRecords];
+	std::atomic< uint32 >     _writePos;
+	uint32                    _readPos;
+	std::atomic< uint32 >     _numDropped;
+	LogCallsite               _callsites[NumLogCallsites];
 };
 
 
@@ -155,10 +218,64 @@ struct EngineStats
 		TextureVMem,
 		GeometryVMem,
 		ComputeGPUTime,
-		CullingTime
+		CullingTime,
+		TexStreamingPressure,
+		TexStreamingMem,
+		OcclusionCulledCount,
+		ShadowMapRenderCount,
+		ShaderBindCount,
+		MaterialBindCount,
+		TextureBindCount,
+		GeometryBindCount,
+		UniformUploadCount,
+		UniformUploadSize,
+		BufferUploadSize,
+		RenderTargetSwitchCount,
+		OcclusionQueryCount,
+		OcclusionQueryCulledCount,
+		RenderViewObjectCount
 	};
 };
 
+const uint32 MaxStatStages = 32;
+const uint32 MaxStatViews = 64;
+
+// Layout is identical to H3DRenderCounters of the public API
+struct RenderCounters
+{
+	int  triCount;
+	int  batchCount;
+	int  lightPassCount;
+	int  shaderBinds;
+	int  materialBinds;
+	int  textureBinds;
+	int  geometryBinds;
+	int  uniformUploads;
+	int  uniformBytes;
+	int  bufferUploadBytes;
+	int  renderTargetSwitches;
+	int  occlusionQueries;
+	int  occlusionQueryCulled;
+};
+
+// Layout is identical to H3DStageStats of the public API
+struct StageStats
+{
+	char            name[32];
+	RenderCounters  counters;
+};
+
+// Layout is identical to H3DFrameStats of the public API
+struct FrameStats
+{
+	RenderCounters  counters;
+	float           frameTime;
+	int             numStages;
+	StageStats      stages[MaxStatStages];
+	int             numViews;
+	int             viewObjectCounts[MaxStatViews];
+};
+
 // =================================================================================================
 
 class StatManager
@@ -174,10 +291,28 @@ public:
 	Timer *getTimer( int param );
 	GPUTimer *getGPUTimer( int param ) const;
 
+	// Work between beginStage and endStage is also recorded for the stage; stages with the same
+	// name, e.g. of several cameras, are merged
+	void beginStage( const char *name );
+	void endStage();
+	void addRenderView( uint32 numObjects );
+	// Completes the stats of the current frame, which are afterwards returned by getFrameStats
+	void finalizeFrame();
+	const FrameStats &getFrameStats() const { return _lastFrame; }
+
 protected:
-	uint32    _statTriCount;
-	uint32    _statBatchCount;
-	uint32    _statLightPassCount;
+	void incCounter( int param, int value );
+	void updateDeviceCounters();
+
+protected:
+	RenderCounters  _counters;  // Since last reset by getStat
+	FrameStats      _curFrame, _lastFrame;
+	int             _curStage;
+	RDICounters     *_deviceCounters;  // Device counters that were already added
+
+	uint32    _statOccCulledCount;
+	uint32    _statShadowMapRenders;
+	uint32    _statViewObjects;
 
 	Timer     _frameTimer;
 	Timer     _animTimer;
@@ -192,7 +327,6 @@ protected:
 	GPUTimer  *_shadowsGPUTimer;
 	GPUTimer  *_particleGPUTimer;
 	GPUTimer  *_computeGPUTimer;
-	friend class ProfSample;
 };
 
 // =================================================================================================
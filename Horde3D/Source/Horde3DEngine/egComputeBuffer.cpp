@@ -2,6 +2,7 @@
 #include "egModules.h"
 #include "egRenderer.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "utXML.h"
 
 #include <map>
@@ -96,6 +97,8 @@ bool ComputeBufferResource::raiseError( const std::string &msg, int line )
 
 bool ComputeBufferResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "ComputeBufferResource::load" );
+
 	if ( !Resource::load( data, size ) ) return false;
 
 	if ( !Modules::renderer().getRenderDevice()->getCaps().computeShaders )
@@ -580,6 +583,19 @@ void *ComputeBufferResource::mapStream( int elem, int elemIdx, int stream, bool
 }
 
 
+void ComputeBufferResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = 0;
+	gpuBytes = _bufferID != 0 ? _dataSize : 0;
+}
+
+
+uint32 ComputeBufferResource::getMappedWriteSize() const
+{
+	return _mapped && _writeRequested ? _dataSize : 0;
+}
+
+
 void ComputeBufferResource::unmapStream()
 {
 	if ( _mapped && _bufferID != 0 )
@@ -74,6 +74,8 @@ public:
 
 	void *mapStream( int elem, int elemIdx, int stream, bool read, bool write );
 	void unmapStream();
+	uint32 getMappedWriteSize() const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 protected:
 
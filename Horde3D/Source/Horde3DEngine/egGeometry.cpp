@@ -16,8 +16,11 @@
 #include "egAnimation.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
+#include "utBVH.h"
 #include <cstring>
+#include <mutex>
 
 #include "utDebug.h"
 
@@ -27,6 +30,19 @@ namespace Horde3D {
 using namespace std;
 
 
+struct GeometryBVHCache
+{
+	struct Entry
+	{
+		uint32       batchStart, batchCount;
+		TriangleBVH  bvh;
+	};
+
+	std::mutex               mutex;
+	std::vector< Entry * >   entries;  // Pointers stay valid when further entries are added
+};
+
+
 uint32 GeometryResource::defVertBuffer = 0;
 uint32 GeometryResource::defIndexBuffer = 0;
 int GeometryResource::mappedWriteStream = -1;
@@ -49,6 +65,7 @@ void GeometryResource::releaseFunc()
 GeometryResource::GeometryResource( const string &name, int flags ) :
 	Resource( ResourceTypes::Geometry, name, flags )
 {
+	_bvhCache = new GeometryBVHCache();
 	initDefault();
 }
 
@@ -56,6 +73,7 @@ GeometryResource::GeometryResource( const string &name, int flags ) :
 GeometryResource::~GeometryResource()
 {
 	release();
+	delete _bvhCache; _bvhCache = 0x0;
 }
 
 
@@ -63,20 +81,39 @@ Resource *GeometryResource::clone()
 {
 	GeometryResource *res = new GeometryResource( "", _flags );
 
+	// Keep the clone's own hierarchy cache
+	GeometryBVHCache *bvhCache = res->_bvhCache;
 	*res = *this;
+	res->_bvhCache = bvhCache;
 
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
 	// TODO: Check if elemcpy_le should be used
-	// Make a deep copy of the data
-	res->_indexData = new char[_indexCount * (_16BitIndices ? 2 : 4)];
-	res->_vertPosData = new Vec3f[_vertCount];
-	res->_vertTanData = new VertexDataTan[_vertCount];
-	res->_vertStaticData = new VertexDataStatic[_vertCount];
-	memcpy( res->_indexData, _indexData, _indexCount * (_16BitIndices ? 2 : 4) );
-	memcpy( res->_vertPosData, _vertPosData, _vertCount * sizeof( Vec3f ) );
-	memcpy( res->_vertTanData, _vertTanData, _vertCount * sizeof( VertexDataTan ) );
-	memcpy( res->_vertStaticData, _vertStaticData, _vertCount * sizeof( VertexDataStatic ) );
+	// Make a deep copy of the data; streams can be missing when CPU copies were discarded
+	res->_indexData = 0x0;
+	res->_vertPosData = 0x0;
+	res->_vertTanData = 0x0;
+	res->_vertStaticData = 0x0;
+	if( _indexData != 0x0 )
+	{
+		res->_indexData = new char[_indexCount * (_16BitIndices ? 2 : 4)];
+		memcpy( res->_indexData, _indexData, _indexCount * (_16BitIndices ? 2 : 4) );
+	}
+	if( _vertPosData != 0x0 )
+	{
+		res->_vertPosData = new Vec3f[_vertCount];
+		memcpy( res->_vertPosData, _vertPosData, _vertCount * sizeof( Vec3f ) );
+	}
+	if( _vertTanData != 0x0 )
+	{
+		res->_vertTanData = new VertexDataTan[_vertCount];
+		memcpy( res->_vertTanData, _vertTanData, _vertCount * sizeof( VertexDataTan ) );
+	}
+	if( _vertStaticData != 0x0 )
+	{
+		res->_vertStaticData = new VertexDataStatic[_vertCount];
+		memcpy( res->_vertStaticData, _vertStaticData, _vertCount * sizeof( VertexDataStatic ) );
+	}
 
 	res->_16BitIndices = _16BitIndices;
 	res->_geoObj = rdi->beginCreatingGeometry( Modules::renderer().getDefaultVertexLayout( DefaultVertexLayouts::Model ) );
@@ -139,6 +176,7 @@ void GeometryResource::release()
 	delete[] _vertPosData; _vertPosData = 0x0;
 	delete[] _vertTanData; _vertTanData = 0x0;
 	delete[] _vertStaticData; _vertStaticData = 0x0;
+	invalidateBVHs();
 	
 	_joints.clear();
 	_morphTargets.clear();
@@ -159,6 +197,8 @@ bool GeometryResource::raiseError( const string &msg )
 
 bool GeometryResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "GeometryResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	// Make sure header is available
@@ -476,6 +516,9 @@ bool GeometryResource::load( const char *data, int size )
 		if( pos.z > _skelAABB.max.z ) _skelAABB.max.z = pos.z;
 	}
 
+	// Geometry without skeleton and morph targets is not modified on the CPU by the engine
+	bool discardCPUCopies = Modules::config().discardCPUCopies && _joints.empty() && _morphTargets.empty();
+
 	// Add default joint if necessary
 	if( _joints.empty() )
 	{
@@ -505,6 +548,13 @@ bool GeometryResource::load( const char *data, int size )
 		rdi->setGeomIndexParams( _geoObj, _indexBuf, _16BitIndices ? IDXFMT_16 : IDXFMT_32 );
 
 		rdi->finishCreatingGeometry( _geoObj );
+
+		// Positions and indices are kept for ray queries and occlusion culling
+		if( discardCPUCopies )
+		{
+			delete[] _vertTanData; _vertTanData = 0x0;
+			delete[] _vertStaticData; _vertStaticData = 0x0;
+		}
 	}
 	
 	return true;
@@ -553,10 +603,10 @@ void *GeometryResource::mapStream( int elem, int elemIdx, int stream, bool read,
 			switch( stream )
 			{
 			case GeometryResData::GeoIndexStream:
-				if( write ) mappedWriteStream = GeometryResData::GeoIndexStream;
+				if( write ) { mappedWriteStream = GeometryResData::GeoIndexStream; invalidateBVHs(); }
 				return _indexData;
 			case GeometryResData::GeoVertPosStream:
-				if( write ) mappedWriteStream = GeometryResData::GeoVertPosStream;
+				if( write ) { mappedWriteStream = GeometryResData::GeoVertPosStream; invalidateBVHs(); }
 				return _vertPosData != 0x0 ? _vertPosData : 0x0;
 			case GeometryResData::GeoVertTanStream:
 				if( write ) mappedWriteStream = GeometryResData::GeoVertTanStream;
@@ -572,6 +622,24 @@ void *GeometryResource::mapStream( int elem, int elemIdx, int stream, bool read,
 }
 
 
+uint32 GeometryResource::getMappedWriteSize() const
+{
+	switch( mappedWriteStream )
+	{
+	case GeometryResData::GeoIndexStream:
+		return _indexData != 0x0 ? _indexCount * (_16BitIndices ? 2 : 4) : 0;
+	case GeometryResData::GeoVertPosStream:
+		return _vertPosData != 0x0 ? _vertCount * sizeof( Vec3f ) : 0;
+	case GeometryResData::GeoVertTanStream:
+		return _vertTanData != 0x0 ? _vertCount * sizeof( VertexDataTan ) : 0;
+	case GeometryResData::GeoVertStaticStream:
+		return _vertStaticData != 0x0 ? _vertCount * sizeof( VertexDataStatic ) : 0;
+	default:
+		return 0;
+	}
+}
+
+
 void GeometryResource::unmapStream()
 {
 	if( mappedWriteStream >= 0 )
@@ -583,10 +651,12 @@ void GeometryResource::unmapStream()
 		case GeometryResData::GeoIndexStream:
 			if( _indexData != 0x0 )
 				rdi->updateBufferData( _geoObj, _indexBuf, 0, _indexCount * (_16BitIndices ? 2 : 4), _indexData );
+			invalidateBVHs();
 			break;
 		case GeometryResData::GeoVertPosStream:
 			if( _vertPosData != 0x0 )
 				rdi->updateBufferData( _geoObj, _posVBuf, 0, _vertCount * sizeof( Vec3f ), _vertPosData );
+			invalidateBVHs();
 			break;
 		case GeometryResData::GeoVertTanStream:
 			if( _vertTanData != 0x0 )
@@ -603,9 +673,39 @@ void GeometryResource::unmapStream()
 }
 
 
+void GeometryResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	uint64 indexSize = (uint64)_indexCount * (_16BitIndices ? 2 : 4);
+	
+	cpuBytes = 0;
+	if( _indexData != 0x0 ) cpuBytes += indexSize;
+	if( _vertPosData != 0x0 ) cpuBytes += (uint64)_vertCount * sizeof( Vec3f );
+	if( _vertTanData != 0x0 ) cpuBytes += (uint64)_vertCount * sizeof( VertexDataTan );
+	if( _vertStaticData != 0x0 ) cpuBytes += (uint64)_vertCount * sizeof( VertexDataStatic );
+	cpuBytes += _joints.size() * sizeof( Joint );
+	for( size_t i = 0; i < _morphTargets.size(); ++i )
+		cpuBytes += _morphTargets[i].diffs.size() * sizeof( MorphDiff );
+
+	if( _bvhCache != 0x0 )
+	{
+		std::lock_guard< std::mutex > lock( _bvhCache->mutex );
+		for( size_t i = 0; i < _bvhCache->entries.size(); ++i )
+			cpuBytes += _bvhCache->entries[i]->bvh.getMemSize();
+	}
+	
+	gpuBytes = 0;
+	if( _geoObj != 0 )
+	{
+		gpuBytes = indexSize + (uint64)_vertCount *
+			(sizeof( Vec3f ) + sizeof( VertexDataTan ) + sizeof( VertexDataStatic ));
+	}
+}
+
+
 void GeometryResource::updateDynamicVertData()
 {
 	// Upload dynamic stream data
+	invalidateBVHs();
 	if( _vertPosData != 0x0 )
 	{
 		Modules::renderer().getRenderDevice()->updateBufferData( _geoObj, _posVBuf, 0, _vertCount * sizeof( Vec3f ), _vertPosData );
@@ -616,4 +716,35 @@ void GeometryResource::updateDynamicVertData()
 	}
 }
 
+
+const TriangleBVH *GeometryResource::getBVH( uint32 batchStart, uint32 batchCount )
+{
+	if( _indexData == 0x0 || _vertPosData == 0x0 || batchStart + batchCount > _indexCount ) return 0x0;
+
+	std::lock_guard< std::mutex > lock( _bvhCache->mutex );
+
+	for( size_t i = 0; i < _bvhCache->entries.size(); ++i )
+	{
+		GeometryBVHCache::Entry *entry = _bvhCache->entries[i];
+		if( entry->batchStart == batchStart && entry->batchCount == batchCount ) return &entry->bvh;
+	}
+
+	GeometryBVHCache::Entry *entry = new GeometryBVHCache::Entry();
+	entry->batchStart = batchStart;
+	entry->batchCount = batchCount;
+	entry->bvh.build( _vertPosData, _indexData, _16BitIndices, batchStart, batchCount );
+	_bvhCache->entries.push_back( entry );
+
+	return &entry->bvh;
+}
+
+
+void GeometryResource::invalidateBVHs()
+{
+	std::lock_guard< std::mutex > lock( _bvhCache->mutex );
+	
+	for( size_t i = 0; i < _bvhCache->entries.size(); ++i ) delete _bvhCache->entries[i];
+	_bvhCache->entries.clear();
+}
+
 }  // namespace
@@ -21,6 +21,9 @@
 
 namespace Horde3D {
 
+class TriangleBVH;
+struct GeometryBVHCache;
+
 // =================================================================================================
 // Geometry Resource
 // =================================================================================================
@@ -100,9 +103,16 @@ public:
 	int getElemParamI( int elem, int elemIdx, int param ) const;
 	void *mapStream( int elem, int elemIdx, int stream, bool read, bool write );
 	void unmapStream();
+	uint32 getMappedWriteSize() const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	void updateDynamicVertData();
 
+	// Returns the triangle hierarchy of an index range, building it on first use; can be called from
+	// several threads as long as the geometry is not modified at the same time
+	const TriangleBVH *getBVH( uint32 batchStart, uint32 batchCount );
+	void invalidateBVHs();
+
 	uint32 getVertCount() const { return _vertCount; }
 	char *getIndexData() const { return _indexData; }
 	Vec3f *getVertPosData() const { return _vertPosData; }
@@ -139,6 +149,8 @@ private:
 	std::vector< MorphTarget >  _morphTargets;
 	uint32                      _minMorphIndex, _maxMorphIndex;
 
+	GeometryBVHCache            *_bvhCache;  // Triangle hierarchies built by ray queries
+
 	friend class Renderer;
 	friend class ModelNode;
 	friend class MeshNode;
@@ -0,0 +1,369 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egJobs.h"
+#include "egProfiler.h"
+#include "utMath.h"
+#include <algorithm>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+// Chunks per thread in parallelFor; more chunks than threads balance uneven work by stealing
+const int ParallelForChunksPerThread = 4;
+// Workers look at the shared queue first every n-th time, so that jobs of the application are not
+// starved by workers that keep finding jobs in their own queues
+const uint32 SharedQueueInterval = 32;
+// Number of times a waiting thread without jobs to execute yields before it blocks
+const uint32 WaitSpinCount = 64;
+
+struct Job
+{
+	JobFunc                        func;
+	atomic< int >                  pendingDeps;
+	atomic< bool >                 done;
+
+	std::mutex                     mutex;  // Guards dependents and the transition to done
+	vector< shared_ptr< Job > >    dependents;
+
+	Job( const JobFunc &func ) : func( func ), pendingDeps( 1 ), done( false ) {}
+};
+
+
+namespace {
+
+thread_local JobManager *currentManager = 0x0;
+thread_local int currentWorker = -1;
+thread_local uint32 numLookups = 0;
+
+}  // namespace
+
+
+// *************************************************************************************************
+// Class JobHandle
+// *************************************************************************************************
+
+bool JobHandle::isDone() const
+{
+	return _job == 0x0 || _job->done.load( memory_order_acquire );
+}
+
+
+// *************************************************************************************************
+// Class JobManager
+// *************************************************************************************************
+
+JobManager::JobManager() :
+	_numQueued( 0 ), _numUnfinished( 0 ), _stealSeed( 0 ), _numSleeping( 0 ), _numWaiting( 0 ), _stop( false )
+{
+	startWorkers( 0 );
+	setNumWorkers( -1 );
+}
+
+
+JobManager::~JobManager()
+{
+	waitAll();
+	stopWorkers();
+}
+
+
+bool JobManager::setNumWorkers( int numWorkers )
+{
+	// A worker cannot join itself
+	if( getCurrentWorker() >= 0 ) return false;
+
+	if( numWorkers < 0 ) numWorkers = std::max( (int)thread::hardware_concurrency() - 1, 0 );
+	numWorkers = std::min( numWorkers, MaxWorkerThreads );
+	if( numWorkers == getNumWorkers() ) return true;
+
+	waitAll();
+	stopWorkers();
+	startWorkers( numWorkers );
+
+	return true;
+}
+
+
+int JobManager::getCurrentWorker() const
+{
+	return currentManager == this ? currentWorker : -1;
+}
+
+
+JobHandle JobManager::submit( const JobFunc &func, const JobHandle *deps, uint32 numDeps )
+{
+	JobHandle handle;
+	handle._job = make_shared< Job >( func );
+	_numUnfinished.fetch_add( 1, memory_order_relaxed );
+
+	// The initial count of one keeps the job from being started by a dependency that finishes
+	// while the others are registered
+	for( uint32 i = 0; i < numDeps; ++i )
+	{
+		Job *dep = deps[i]._job.get();
+		if( dep == 0x0 ) continue;
+
+		lock_guard< std::mutex > lock( dep->mutex );
+		if( !dep->done.load( memory_order_relaxed ) )
+		{
+			dep->dependents.push_back( handle._job );
+			handle._job->pendingDeps.fetch_add( 1, memory_order_relaxed );
+		}
+	}
+
+	if( handle._job->pendingDeps.fetch_sub( 1, memory_order_acq_rel ) == 1 ) enqueue( handle._job );
+
+	return handle;
+}
+
+
+void JobManager::parallelFor( int count, int grainSize, const JobRangeFunc &func )
+{
+	if( count <= 0 ) return;
+
+	int numChunks = std::min( idivceil( count, std::max( grainSize, 1 ) ),
+	                          (getNumWorkers() + 1) * ParallelForChunksPerThread );
+	if( numChunks <= 1 || _workers.empty() )
+	{
+		func( 0, count );
+		return;
+	}
+
+	int chunkSize = idivceil( count, numChunks );
+	vector< JobHandle > jobs;
+	jobs.reserve( numChunks - 1 );
+	for( int begin = chunkSize; begin < count; begin += chunkSize )
+	{
+		int end = std::min( begin + chunkSize, count );
+		jobs.push_back( submit( [&func, begin, end]()
+		{
+			H3D_PROFILE_ZONE( "JobManager::parallelFor" );
+			func( begin, end );
+		} ) );
+	}
+
+	{
+		H3D_PROFILE_ZONE( "JobManager::parallelFor" );
+		func( 0, chunkSize );
+	}
+
+	for( size_t i = 0; i < jobs.size(); ++i ) wait( jobs[i] );
+}
+
+
+JobHandle JobManager::submitParallelFor( int count, int grainSize, const JobRangeFunc &func,
+                                         const JobHandle *deps, uint32 numDeps )
+{
+	// The chunks are submitted by the job, so they end up in the queue of the worker running it
+	return submit( [this, count, grainSize, func]() { parallelFor( count, grainSize, func ); }, deps, numDeps );
+}
+
+
+void JobManager::wait( const JobHandle &job )
+{
+	uint32 spins = 0;
+	while( !job.isDone() )
+	{
+		if( executeQueuedJob() ) spins = 0;
+		else if( ++spins < WaitSpinCount ) this_thread::yield();
+		else waitForProgress( [&job]() { return job.isDone(); } );
+	}
+}
+
+
+void JobManager::waitAll()
+{
+	uint32 spins = 0;
+	while( _numUnfinished.load( memory_order_acquire ) > 0 )
+	{
+		if( executeQueuedJob() ) spins = 0;
+		else if( ++spins < WaitSpinCount ) this_thread::yield();
+		else waitForProgress( [this]() { return _numUnfinished.load( memory_order_acquire ) <= 0; } );
+	}
+}
+
+
+void JobManager::waitForProgress( const function< bool() > &isDone )
+{
+	unique_lock< std::mutex > lock( _sleepMutex );
+	
+	// Pairs with the fence in execute: either the condition is seen as done here or the finishing
+	// thread sees the waiter and notifies it after the lock is released by waiting
+	_numWaiting.fetch_add( 1, memory_order_relaxed );
+	atomic_thread_fence( memory_order_seq_cst );
+	if( !isDone() && _numQueued.load( memory_order_acquire ) <= 0 ) _progressCond.wait( lock );
+	_numWaiting.fetch_sub( 1, memory_order_relaxed );
+}
+
+
+void JobManager::startWorkers( int numWorkers )
+{
+	_queues.clear();
+	for( int i = 0; i <= numWorkers; ++i ) _queues.push_back( unique_ptr< WorkQueue >( new WorkQueue() ) );
+
+	_stop = false;
+	for( int i = 0; i < numWorkers; ++i ) _workers.push_back( thread( &JobManager::workerFunc, this, i ) );
+}
+
+
+void JobManager::stopWorkers()
+{
+	{
+		lock_guard< std::mutex > lock( _sleepMutex );
+		_stop = true;
+	}
+	_wakeCond.notify_all();
+
+	for( size_t i = 0; i < _workers.size(); ++i ) _workers[i].join();
+	_workers.clear();
+}
+
+
+void JobManager::workerFunc( int index )
+{
+	currentManager = this;
+	currentWorker = index;
+
+	for( ;; )
+	{
+		shared_ptr< Job > job = findJob( index );
+		if( job != 0x0 )
+		{
+			execute( job );
+			continue;
+		}
+
+		// Enqueuing checks for sleeping workers under the same lock, so a wake up cannot get lost
+		unique_lock< std::mutex > lock( _sleepMutex );
+		if( _numQueued.load( memory_order_acquire ) > 0 ) continue;
+		if( _stop ) break;
+
+		++_numSleeping;
+		_wakeCond.wait( lock );
+		--_numSleeping;
+	}
+
+	currentManager = 0x0;
+	currentWorker = -1;
+}
+
+
+void JobManager::enqueue( const shared_ptr< Job > &job )
+{
+	int worker = getCurrentWorker();
+	WorkQueue &queue = *_queues[worker >= 0 ? worker : _queues.size() - 1];
+	{
+		lock_guard< std::mutex > lock( queue.mutex );
+		queue.jobs.push_back( job );
+	}
+	_numQueued.fetch_add( 1, memory_order_release );
+
+	lock_guard< std::mutex > lock( _sleepMutex );
+	if( _numSleeping > 0 ) _wakeCond.notify_one();
+	if( _numWaiting.load( memory_order_relaxed ) > 0 ) _progressCond.notify_all();
+}
+
+
+shared_ptr< Job > JobManager::findJob( int queueIndex )
+{
+	if( _numQueued.load( memory_order_acquire ) <= 0 ) return 0x0;
+
+	int numQueues = (int)_queues.size();
+	int sharedQueue = numQueues - 1;
+	shared_ptr< Job > job;
+
+	// Newest job of the own queue
+	if( queueIndex != sharedQueue )
+	{
+		if( ++numLookups % SharedQueueInterval == 0 ) job = popJob( sharedQueue, true );
+		if( job == 0x0 ) job = popJob( queueIndex, false );
+	}
+
+	// Oldest job of another queue; the start is varied so that thieves spread over the victims
+	int start = (int)(_stealSeed.fetch_add( 1, memory_order_relaxed ) % (uint32)numQueues);
+	for( int i = 0; i < numQueues && job == 0x0; ++i )
+	{
+		int index = (start + i) % numQueues;
+		if( index != queueIndex || index == sharedQueue ) job = popJob( index, true );
+	}
+
+	return job;
+}
+
+
+shared_ptr< Job > JobManager::popJob( int queueIndex, bool oldest )
+{
+	WorkQueue &queue = *_queues[queueIndex];
+	lock_guard< std::mutex > lock( queue.mutex );
+	if( queue.jobs.empty() ) return 0x0;
+
+	shared_ptr< Job > job;
+	if( oldest )
+	{
+		job = queue.jobs.front();
+		queue.jobs.pop_front();
+	}
+	else
+	{
+		job = queue.jobs.back();
+		queue.jobs.pop_back();
+	}
+	_numQueued.fetch_sub( 1, memory_order_relaxed );
+
+	return job;
+}
+
+
+bool JobManager::executeQueuedJob()
+{
+	int worker = getCurrentWorker();
+	shared_ptr< Job > job = findJob( worker >= 0 ? worker : (int)_queues.size() - 1 );
+	if( job == 0x0 ) return false;
+
+	execute( job );
+	return true;
+}
+
+
+void JobManager::execute( const shared_ptr< Job > &job )
+{
+	job->func();
+	job->func = nullptr;  // Free the captured state before anyone is notified
+
+	vector< shared_ptr< Job > > dependents;
+	{
+		lock_guard< std::mutex > lock( job->mutex );
+		job->done.store( true, memory_order_release );
+		dependents.swap( job->dependents );
+	}
+
+	for( size_t i = 0; i < dependents.size(); ++i )
+	{
+		if( dependents[i]->pendingDeps.fetch_sub( 1, memory_order_acq_rel ) == 1 ) enqueue( dependents[i] );
+	}
+
+	_numUnfinished.fetch_sub( 1, memory_order_release );
+
+	atomic_thread_fence( memory_order_seq_cst );
+	if( _numWaiting.load( memory_order_relaxed ) > 0 )
+	{
+		lock_guard< std::mutex > lock( _sleepMutex );
+		_progressCond.notify_all();
+	}
+}
+
+}  // namespace
@@ -0,0 +1,134 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egJobs_H_
+#define _egJobs_H_
+
+#include "egPrerequisites.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Horde3D {
+
+// Upper limit for EngineOptions::WorkerThreads
+const int MaxWorkerThreads = 64;
+
+typedef std::function< void() > JobFunc;
+typedef std::function< void( int, int ) > JobRangeFunc;
+
+struct Job;
+
+// =================================================================================================
+// Job Handle
+// =================================================================================================
+
+// Refers to a submitted job; handles can be copied freely and stay valid after the job has finished
+class JobHandle
+{
+public:
+	bool isValid() const { return _job != 0x0; }
+	bool isDone() const;  // True for invalid handles as well
+
+private:
+	std::shared_ptr< Job >  _job;
+
+	friend class JobManager;
+};
+
+// =================================================================================================
+// Job Manager
+// =================================================================================================
+
+// Runs jobs on a pool of worker threads. Every worker has its own queue: jobs submitted by a worker
+// are pushed to its queue and taken from the back again, so that nested work stays in the caches of
+// that worker. Idle workers steal the oldest jobs from the queues of other workers. Jobs submitted by
+// other threads go to a shared queue which is processed in submission order.
+//
+// A job only starts when all of its dependencies have finished. Threads that wait for a job execute
+// other queued jobs in the meantime, so jobs can wait for further jobs without blocking a worker and
+// without workers at all, all jobs are executed by the waiting threads.
+class JobManager
+{
+public:
+	JobManager();
+	~JobManager();  // Waits until all submitted jobs have finished
+
+	// Stops the current workers after all submitted jobs have finished and starts numWorkers new
+	// ones; -1 uses one worker less than the number of hardware threads, so that the thread which
+	// submits jobs has a core as well. Must not be called while other threads submit jobs and fails
+	// when called by a worker.
+	bool setNumWorkers( int numWorkers );
+	int getNumWorkers() const { return (int)_workers.size(); }
+	// Returns the index of the calling worker thread or -1 if it is no worker of this manager
+	int getCurrentWorker() const;
+
+	// The function is copied and executed exactly once after the given jobs have finished; invalid
+	// handles in the dependencies are ignored
+	JobHandle submit( const JobFunc &func, const JobHandle *deps = 0x0, uint32 numDeps = 0 );
+	JobHandle submit( const JobFunc &func, std::initializer_list< JobHandle > deps )
+		{ return submit( func, deps.begin(), (uint32)deps.size() ); }
+
+	// Splits [0, count) into chunks of at least grainSize elements and runs func( begin, end ) on
+	// them in parallel; the calling thread takes part and returns when all chunks are done
+	void parallelFor( int count, int grainSize, const JobRangeFunc &func );
+	// Submits a job that runs a parallelFor once the dependencies have finished
+	JobHandle submitParallelFor( int count, int grainSize, const JobRangeFunc &func,
+	                             const JobHandle *deps = 0x0, uint32 numDeps = 0 );
+
+	// Waiting threads execute queued jobs; when there are none, they yield for a while and then block
+	// until a job finishes or is queued
+	void wait( const JobHandle &job );
+	void waitAll();
+
+private:
+	struct WorkQueue
+	{
+		std::mutex                             mutex;
+		std::deque< std::shared_ptr< Job > >   jobs;
+	};
+
+	void startWorkers( int numWorkers );
+	void stopWorkers();
+	void workerFunc( int index );
+
+	void enqueue( const std::shared_ptr< Job > &job );
+	std::shared_ptr< Job > findJob( int queueIndex );
+	std::shared_ptr< Job > popJob( int queueIndex, bool oldest );
+	bool executeQueuedJob();
+	void execute( const std::shared_ptr< Job > &job );
+	void waitForProgress( const std::function< bool() > &isDone );
+
+private:
+	std::vector< std::thread >                   _workers;
+	std::vector< std::unique_ptr< WorkQueue > >  _queues;  // One per worker and the shared queue last
+	std::atomic< int >                           _numQueued;
+	std::atomic< int >                           _numUnfinished;  // Submitted but not finished jobs
+	std::atomic< uint32 >                        _stealSeed;
+
+	std::mutex                                   _sleepMutex;
+	std::condition_variable                      _wakeCond;
+	std::condition_variable                      _progressCond;  // Notified for blocked waiting threads
+	int                                          _numSleeping;
+	std::atomic< int >                           _numWaiting;  // Threads blocked in wait or waitAll
+	bool                                         _stop;
+};
+
+}
+#endif // _egJobs_H_
@@ -29,6 +29,8 @@ LightNode::LightNode( const LightNodeTpl &lightTpl ) :
 	_materialRes = lightTpl.matRes;
 	_lightingContext = lightTpl.lightingContext;
 	_shadowContext = lightTpl.shadowContext;
+	_lightingContextID = ShaderResource::getContextID( _lightingContext );
+	_shadowContextID = ShaderResource::getContextID( _shadowContext );
 	_radius = lightTpl.radius; _fov = lightTpl.fov;
 	_diffuseCol = Vec3f( lightTpl.col_R, lightTpl.col_G, lightTpl.col_B );
 	_diffuseColMult = lightTpl.colMult;
@@ -227,9 +229,11 @@ void LightNode::setParamStr( int param, const char *value )
 	{
 	case LightNodeParams::LightingContextStr:
 		_lightingContext = value;
+		_lightingContextID = ShaderResource::getContextID( _lightingContext );
 		return;
 	case LightNodeParams::ShadowContextStr:
 		_shadowContext = value;
+		_shadowContextID = ShaderResource::getContextID( _shadowContext );
 		return;
 	}
 
@@ -96,6 +96,7 @@ private:
 
 	PMaterialResource      _materialRes;
 	std::string            _lightingContext, _shadowContext;
+	int                    _lightingContextID, _shadowContextID;
 	float                  _radius, _fov;
 	Vec3f                  _diffuseCol;
 	float                  _diffuseColMult;
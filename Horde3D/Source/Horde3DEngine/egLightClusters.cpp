@@ -0,0 +1,247 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egLightClusters.h"
+#include "egModules.h"
+#include "egJobs.h"
+#include "utSIMD.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+// Below this number of lights, binning all slices on the calling thread is faster than spawning threads
+static const uint32 ClusterParallelLights = 64;
+
+
+// *************************************************************************************************
+// Class LightClusterGrid
+// *************************************************************************************************
+
+LightClusterGrid::LightClusterGrid() :
+	_nearDist( 0 ), _farDist( 0 ), _sliceScale( 0 ), _gridX( 0 ), _gridY( 0 ), _gridZ( 0 ),
+	_slicePitch( 0 ), _overflow( false )
+{
+}
+
+
+void LightClusterGrid::setup( const Matrix4f &projMat, float nearDist, float farDist,
+                              uint32 gridX, uint32 gridY, uint32 gridZ )
+{
+	ASSERT( gridX > 0 && gridY > 0 && gridZ > 0 );
+
+	// Exponential slicing requires a positive near distance, e.g. for orthographic cameras
+	nearDist = std::max( nearDist, 0.001f );
+	farDist = std::max( farDist, nearDist * 1.001f );
+
+	if( gridX == _gridX && gridY == _gridY && gridZ == _gridZ && nearDist == _nearDist && farDist == _farDist &&
+	    memcmp( projMat.x, _projMat.x, sizeof( projMat.x ) ) == 0 )
+	{
+		return;
+	}
+
+	_projMat = projMat;
+	_nearDist = nearDist;
+	_farDist = farDist;
+	_gridX = gridX;
+	_gridY = gridY;
+	_gridZ = gridZ;
+	_sliceScale = gridZ / logf( farDist / nearDist );
+	_slicePitch = (gridX * gridY + 3) & ~3u;
+
+	size_t size = (size_t)_slicePitch * gridZ;
+	_bbMinX.assign( size, Math::MaxFloat ); _bbMinY.assign( size, Math::MaxFloat ); _bbMinZ.assign( size, Math::MaxFloat );
+	_bbMaxX.assign( size, -Math::MaxFloat ); _bbMaxY.assign( size, -Math::MaxFloat ); _bbMaxZ.assign( size, -Math::MaxFloat );
+	_sphereCenters.assign( size, Vec3f( 0, 0, 0 ) );
+	_sphereRadii.assign( size, 0 );
+	_clusterLights.resize( getClusterCount() );
+
+	// Rays through the tile corners, given by their intersections with the near and far planes
+	Matrix4f invProj = projMat.inverted();
+	vector< Vec3f > nearPts( (gridX + 1) * (gridY + 1) ), farPts( (gridX + 1) * (gridY + 1) );
+	for( uint32 y = 0; y <= gridY; ++y )
+	{
+		for( uint32 x = 0; x <= gridX; ++x )
+		{
+			float ndcX = -1.0f + 2.0f * x / gridX, ndcY = -1.0f + 2.0f * y / gridY;
+			Vec4f pn = invProj * Vec4f( ndcX, ndcY, -1, 1 ), pf = invProj * Vec4f( ndcX, ndcY, 1, 1 );
+			nearPts[y * (gridX + 1) + x] = Vec3f( pn.x / pn.w, pn.y / pn.w, pn.z / pn.w );
+			farPts[y * (gridX + 1) + x] = Vec3f( pf.x / pf.w, pf.y / pf.w, pf.z / pf.w );
+		}
+	}
+
+	for( uint32 z = 0; z < gridZ; ++z )
+	{
+		float dists[2] = { nearDist * powf( farDist / nearDist, (float)z / gridZ ),
+		                   nearDist * powf( farDist / nearDist, (float)(z + 1) / gridZ ) };
+
+		for( uint32 y = 0; y < gridY; ++y )
+		{
+			for( uint32 x = 0; x < gridX; ++x )
+			{
+				Vec3f bbMin( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat );
+				Vec3f bbMax( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat );
+
+				for( uint32 i = 0; i < 8; ++i )
+				{
+					uint32 corner = (y + ((i >> 1) & 1)) * (gridX + 1) + x + (i & 1);
+					const Vec3f &pn = nearPts[corner], &pf = farPts[corner];
+					float t = (-dists[i >> 2] - pn.z) / (pf.z - pn.z);
+					Vec3f p = pn + (pf - pn) * t;
+
+					bbMin.x = minf( bbMin.x, p.x ); bbMin.y = minf( bbMin.y, p.y ); bbMin.z = minf( bbMin.z, p.z );
+					bbMax.x = maxf( bbMax.x, p.x ); bbMax.y = maxf( bbMax.y, p.y ); bbMax.z = maxf( bbMax.z, p.z );
+				}
+
+				size_t i = (size_t)z * _slicePitch + y * gridX + x;
+				_bbMinX[i] = bbMin.x; _bbMinY[i] = bbMin.y; _bbMinZ[i] = bbMin.z;
+				_bbMaxX[i] = bbMax.x; _bbMaxY[i] = bbMax.y; _bbMaxZ[i] = bbMax.z;
+				_sphereCenters[i] = (bbMin + bbMax) * 0.5f;
+				_sphereRadii[i] = (bbMax - bbMin).length() * 0.5f;
+			}
+		}
+	}
+}
+
+
+uint32 LightClusterGrid::calcSlice( float viewDist ) const
+{
+	if( viewDist <= _nearDist ) return 0;
+
+	int slice = (int)floorf( logf( viewDist / _nearDist ) * _sliceScale );
+	return (uint32)std::min( std::max( slice, 0 ), (int)_gridZ - 1 );
+}
+
+
+void LightClusterGrid::getClusterBounds( uint32 index, Vec3f &bbMin, Vec3f &bbMax ) const
+{
+	uint32 tiles = _gridX * _gridY;
+	size_t i = (size_t)(index / tiles) * _slicePitch + index % tiles;
+
+	bbMin = Vec3f( _bbMinX[i], _bbMinY[i], _bbMinZ[i] );
+	bbMax = Vec3f( _bbMaxX[i], _bbMaxY[i], _bbMaxZ[i] );
+}
+
+
+void LightClusterGrid::binSlice( uint32 slice, const ClusterLight *lights, uint32 numLights )
+{
+	uint32 tiles = _gridX * _gridY;
+	size_t base = (size_t)slice * _slicePitch;
+
+	for( uint32 i = 0; i < tiles; ++i )
+		_clusterLights[slice * tiles + i].resize( 0 );
+
+	Float4 zero = splat4( 0 );
+	for( uint32 l = 0; l < numLights; ++l )
+	{
+		if( slice < _lightSlices[l * 2] || slice > _lightSlices[l * 2 + 1] ) continue;
+
+		const ClusterLight &light = lights[l];
+		Float4 cx = splat4( light.pos.x ), cy = splat4( light.pos.y ), cz = splat4( light.pos.z );
+		Float4 r2 = splat4( light.radius * light.radius );
+		bool spot = light.cosHalfAngle > 0;
+
+		for( uint32 i = 0; i < tiles; i += 4 )
+		{
+			// Squared distance from sphere center to the cluster boxes
+			size_t c = base + i;
+			Float4 dx = max4( max4( sub4( load4( &_bbMinX[c] ), cx ), sub4( cx, load4( &_bbMaxX[c] ) ) ), zero );
+			Float4 dy = max4( max4( sub4( load4( &_bbMinY[c] ), cy ), sub4( cy, load4( &_bbMaxY[c] ) ) ), zero );
+			Float4 dz = max4( max4( sub4( load4( &_bbMinZ[c] ), cz ), sub4( cz, load4( &_bbMaxZ[c] ) ) ), zero );
+			Float4 dist2 = add4( add4( mul4( dx, dx ), mul4( dy, dy ) ), mul4( dz, dz ) );
+
+			int mask = movemask4( cmpGE4( r2, dist2 ) );
+			for( ; mask != 0; mask &= mask - 1 )
+			{
+				uint32 lane = 0;
+				while( !(mask & (1 << lane)) ) ++lane;
+				if( i + lane >= tiles ) break;
+
+				if( spot )
+				{
+					// Cone against bounding sphere of cluster
+					const Vec3f &center = _sphereCenters[c + lane];
+					float radius = _sphereRadii[c + lane];
+					Vec3f v = center - light.pos;
+					float vLenSq = v.dot( v );
+					float v1Len = v.dot( light.dir );
+					float distClosest = light.cosHalfAngle * sqrtf( std::max( vLenSq - v1Len * v1Len, 0.0f ) ) -
+					                    v1Len * light.sinHalfAngle;
+
+					if( distClosest > radius || v1Len > radius + light.radius || v1Len < -radius ) continue;
+				}
+
+				_clusterLights[slice * tiles + i + lane].push_back( (uint16)l );
+			}
+		}
+	}
+}
+
+
+void LightClusterGrid::bin( const ClusterLight *lights, uint32 numLights, uint32 maxIndices )
+{
+	ASSERT( _gridZ > 0 && numLights <= 65536 );
+
+	// Depth range of each light
+	_lightSlices.resize( numLights * 2 );
+	for( uint32 l = 0; l < numLights; ++l )
+	{
+		float dist = -lights[l].pos.z;
+		if( dist + lights[l].radius < _nearDist || dist - lights[l].radius > _farDist )
+		{
+			_lightSlices[l * 2] = 1;  // Empty range
+			_lightSlices[l * 2 + 1] = 0;
+			continue;
+		}
+
+		_lightSlices[l * 2] = calcSlice( dist - lights[l].radius );
+		_lightSlices[l * 2 + 1] = calcSlice( dist + lights[l].radius );
+	}
+
+	// Slices are independent, so they can be binned in parallel
+	int grain = numLights >= ClusterParallelLights ? 1 : (int)_gridZ;
+	Modules::jobMan().parallelFor( (int)_gridZ, grain, [&]( int begin, int end )
+	{
+		for( int z = begin; z < end; ++z )
+			binSlice( (uint32)z, lights, numLights );
+	} );
+
+	// Compact cluster lists
+	uint32 count = getClusterCount();
+	_offsets.resize( count );
+	_counts.resize( count );
+	_indices.resize( 0 );
+	_overflow = false;
+
+	for( uint32 i = 0; i < count; ++i )
+	{
+		const vector< uint16 > &list = _clusterLights[i];
+		uint32 num = (uint32)list.size();
+		if( _indices.size() + num > maxIndices )
+		{
+			num = maxIndices - (uint32)_indices.size();
+			_overflow = true;
+		}
+
+		_offsets[i] = (uint32)_indices.size();
+		_counts[i] = num;
+		_indices.insert( _indices.end(), list.begin(), list.begin() + num );
+	}
+}
+
+}  // namespace
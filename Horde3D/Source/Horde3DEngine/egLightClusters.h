@@ -0,0 +1,91 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egLightClusters_H_
+#define _egLightClusters_H_
+
+#include "egPrerequisites.h"
+#include "utMath.h"
+#include <vector>
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// Light Cluster Grid
+// =================================================================================================
+
+// Light in view space as seen by the cluster binning
+struct ClusterLight
+{
+	Vec3f  pos;
+	float  radius;
+	Vec3f  dir;           // Normalized spot direction
+	float  cosHalfAngle;  // Cone is ignored if the half angle is 90 degrees or more
+	float  sinHalfAngle;
+};
+
+// Froxel grid that subdivides the view frustum into gridX * gridY screen tiles and gridZ depth slices
+// with exponentially growing thickness. Lights are assigned to the clusters their volume intersects.
+// The grid does not depend on a render device so that it can be evaluated offline.
+class LightClusterGrid
+{
+public:
+	LightClusterGrid();
+
+	// Computes the view space bounds of all clusters; cheap if nothing changed since the last call
+	void setup( const Matrix4f &projMat, float nearDist, float farDist, uint32 gridX, uint32 gridY, uint32 gridZ );
+
+	// Assigns the lights to the clusters. At most maxIndices light indices are stored in total;
+	// further assignments are dropped and hasOverflow returns true.
+	void bin( const ClusterLight *lights, uint32 numLights, uint32 maxIndices );
+
+	// Slice of a positive view space distance; matches the calculation in the shaders
+	uint32 calcSlice( float viewDist ) const;
+	uint32 getClusterIndex( uint32 x, uint32 y, uint32 z ) const { return x + _gridX * (y + _gridY * z); }
+	void getClusterBounds( uint32 index, Vec3f &bbMin, Vec3f &bbMax ) const;
+
+	uint32 getGridX() const { return _gridX; }
+	uint32 getGridY() const { return _gridY; }
+	uint32 getGridZ() const { return _gridZ; }
+	uint32 getClusterCount() const { return _gridX * _gridY * _gridZ; }
+	float getNearDist() const { return _nearDist; }
+	float getSliceScale() const { return _sliceScale; }  // Slices per unit of log( viewDist / nearDist )
+
+	// Light indices of cluster i are getIndices()[getOffsets()[i]] to getIndices()[getOffsets()[i] + getCounts()[i] - 1]
+	const std::vector< uint32 > &getOffsets() const { return _offsets; }
+	const std::vector< uint32 > &getCounts() const { return _counts; }
+	const std::vector< uint32 > &getIndices() const { return _indices; }
+	bool hasOverflow() const { return _overflow; }
+
+protected:
+	void binSlice( uint32 slice, const ClusterLight *lights, uint32 numLights );
+
+protected:
+	Matrix4f                              _projMat;
+	float                                 _nearDist, _farDist, _sliceScale;
+	uint32                                _gridX, _gridY, _gridZ;
+	uint32                                _slicePitch;  // Clusters per slice rounded up to a multiple of four
+
+	// Cluster bounds as structure of arrays, so that four clusters can be tested at once
+	std::vector< float >                  _bbMinX, _bbMinY, _bbMinZ, _bbMaxX, _bbMaxY, _bbMaxZ;
+	std::vector< Vec3f >                  _sphereCenters;  // Bounding spheres for the spot cone test
+	std::vector< float >                  _sphereRadii;
+
+	std::vector< uint32 >                 _lightSlices;  // First and last slice of each light
+	std::vector< std::vector< uint16 > >  _clusterLights;
+	std::vector< uint32 >                 _offsets, _counts, _indices;
+	bool                                  _overflow;
+};
+
+}
+#endif // _egLightClusters_H_
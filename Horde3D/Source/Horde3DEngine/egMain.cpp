@@ -21,6 +21,8 @@
 #include "egTexture.h"
 #include "egComputeBuffer.h"
 #include "egComputeNode.h"
+#include "egProfiler.h"
+#include "egCapture.h"
 #include <cstdlib>
 #include <cstring>
 #include <string>
@@ -68,6 +70,7 @@ bool initialized;
 const char *emptyCString = "";
 std::string emptyString = emptyCString;
 std::string strPool[ 8 ];  // String pool for avoiding memory allocations of temporary string objects
+CaptureReader *replayReader = 0x0;
 
 
 inline const string &safeStr( const char *str, int index )
@@ -110,12 +113,16 @@ H3D_IMPL bool h3dInit( RenderBackendType::List backendType )
 	initialized = true;
 
 	__ValidatePlatform__();
-	return Modules::init( backendType );
+	bool result = Modules::init( backendType );
+	
+	Modules::log().flush();
+	return result;
 }
 
 
 H3D_IMPL void h3dRelease()
 {
+	delete replayReader; replayReader = 0x0;
 	Modules::release();
 	initialized = false;
 }
@@ -133,6 +140,7 @@ H3D_IMPL void h3dCompute( int materialRes, const char *context, int groupX, int
 	}
 
 	Modules::renderer().dispatchCompute( ( MaterialResource * ) res, safeStr( context, 0 ), groupX, groupY, groupZ );
+	APIFUNC_CAPTURE( CaptureCalls::Compute, materialRes, context, groupX, groupY, groupZ );
 }
 
 
@@ -142,12 +150,16 @@ H3D_IMPL void h3dRender( NodeHandle cameraNode )
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Camera, "h3dRender", APIFUNC_RET_VOID );
 	
 	Modules::renderer().render( (CameraNode *)sn );
+	APIFUNC_CAPTURE( CaptureCalls::Render, cameraNode );
 }
 
 
 H3D_IMPL void h3dFinalizeFrame()
 {
 	Modules::renderer().finalizeFrame();
+#ifdef H3D_API_CAPTURE
+	if( APICapture::isActive() ) APICapture::recordFrame();
+#endif
 }
 
 
@@ -156,6 +168,7 @@ H3D_IMPL void h3dClear()
 	Modules::sceneMan().removeNode( Modules::sceneMan().getRootNode() );
 	Modules::resMan().clear();
 	MaterialClassCollection::clear();
+	APIFUNC_CAPTURE( CaptureCalls::Clear );
 }
 
 
@@ -193,7 +206,36 @@ H3D_IMPL float h3dGetOption( EngineOptions::List param )
 
 H3D_IMPL bool h3dSetOption( EngineOptions::List param, float value )
 {
-	return Modules::config().setOption( param, value );
+	bool result = Modules::config().setOption( param, value );
+	APIFUNC_CAPTURE( CaptureCalls::SetOption, (int)param, value );
+	return result;
+}
+
+
+H3D_IMPL void h3dSetCacheDirectory( const char *path )
+{
+	Modules::config().cacheDirectory = safeStr( path, 0 );
+}
+
+
+H3D_IMPL int h3dUpdateShaderCache()
+{
+	int numStored = 0;
+	
+	Resource *res = Modules::resMan().getNextResource( ResourceTypes::Shader, 0 );
+	while( res != 0x0 )
+	{
+		if( res->isLoaded() )
+		{
+			int count = ((ShaderResource *)res)->updateProgramCache();
+			if( count < 0 ) return -1;
+			numStored += count;
+		}
+		
+		res = Modules::resMan().getNextResource( ResourceTypes::Shader, res->getHandle() );
+	}
+
+	return numStored;
 }
 
 
@@ -203,6 +245,25 @@ H3D_IMPL float h3dGetStat( EngineStats::List param, bool reset )
 }
 
 
+H3D_IMPL bool h3dGetFrameStats( FrameStats *stats )
+{
+	if( stats == 0x0 )
+	{
+		Modules::setError( "Invalid pointer in h3dGetFrameStats" );
+		return false;
+	}
+
+	*stats = Modules::stats().getFrameStats();
+	return true;
+}
+
+
+H3D_IMPL bool h3dSaveProfilerTrace( const char *fileName, int numFrames )
+{
+	return Profiler::saveTrace( safeStr( fileName, 0 ).c_str(), numFrames );
+}
+
+
 H3D_IMPL float h3dGetDeviceCapabilities( RenderDeviceCapabilities::List param )
 {
 	return getRenderDeviceCapabilities( param );
@@ -249,7 +310,9 @@ H3D_IMPL ResHandle h3dFindResource( int type, const char *name )
 
 H3D_IMPL ResHandle h3dAddResource( int type, const char *name, int flags )
 {
-	return Modules::resMan().addResource( type, safeStr( name, 0 ), flags, true );
+	ResHandle res = Modules::resMan().addResource( type, safeStr( name, 0 ), flags, true );
+	APIFUNC_CAPTURE( CaptureCalls::AddResource, type, name, flags, res );
+	return res;
 }
 
 
@@ -258,7 +321,9 @@ H3D_IMPL ResHandle h3dCloneResource( ResHandle sourceRes, const char *name )
 	Resource *resObj = Modules::resMan().resolveResHandle( sourceRes );
 	APIFUNC_VALIDATE_RES( resObj, "h3dCloneResource", 0 );
 	
-	return Modules::resMan().cloneResource( *resObj, safeStr( name, 0 ) );
+	ResHandle res = Modules::resMan().cloneResource( *resObj, safeStr( name, 0 ) );
+	APIFUNC_CAPTURE( CaptureCalls::CloneResource, sourceRes, name, res );
+	return res;
 }
 
 
@@ -267,7 +332,9 @@ H3D_IMPL int h3dRemoveResource( ResHandle res )
 	Resource *resObj = Modules::resMan().resolveResHandle( res );
 	APIFUNC_VALIDATE_RES( resObj, "h3dRemoveResource", -1 );
 	
-	return Modules::resMan().removeResource( *resObj, true );
+	int refCount = Modules::resMan().removeResource( *resObj, true );
+	APIFUNC_CAPTURE( CaptureCalls::RemoveResource, res );
+	return refCount;
 }
 
 
@@ -292,7 +359,11 @@ H3D_IMPL bool h3dLoadResource( ResHandle res, const char *data, int size )
 	}
 	else
 		Modules::log().writeInfo( "Loading resource '%s'", resObj->getName().c_str() );
-	return resObj->load( data, size );
+	
+	bool result = resObj->load( data, size );
+	if( result ) Modules::resMan().checkMemoryBudget();
+	APIFUNC_CAPTURE( CaptureCalls::LoadResource, res, CaptureData( data, data != 0x0 && size > 0 ? (uint32)size : 0 ) );
+	return result;
 }
 
 
@@ -302,6 +373,7 @@ H3D_IMPL void h3dUnloadResource( ResHandle res )
 	APIFUNC_VALIDATE_RES( resObj, "h3dUnloadResource", APIFUNC_RET_VOID );
 
 	resObj->unload();
+	APIFUNC_CAPTURE( CaptureCalls::UnloadResource, res );
 }
 
 
@@ -338,6 +410,8 @@ H3D_IMPL void h3dSetResParamI( ResHandle res, int elem, int elemIdx, int param,
 	APIFUNC_VALIDATE_RES( resObj, "h3dSetResParamI", APIFUNC_RET_VOID );
 
 	resObj->setElemParamI( elem, elemIdx, param, value );
+	resObj->markUpdated();
+	APIFUNC_CAPTURE( CaptureCalls::SetResParamI, res, elem, elemIdx, param, value );
 }
 
 
@@ -356,6 +430,8 @@ H3D_IMPL void h3dSetResParamF( ResHandle res, int elem, int elemIdx, int param,
 	APIFUNC_VALIDATE_RES( resObj, "h3dSetResParamF", APIFUNC_RET_VOID );
 
 	resObj->setElemParamF( elem, elemIdx, param, compIdx, value );
+	resObj->markUpdated();
+	APIFUNC_CAPTURE( CaptureCalls::SetResParamF, res, elem, elemIdx, param, compIdx, value );
 }
 
 
@@ -374,6 +450,8 @@ H3D_IMPL void h3dSetResParamStr( ResHandle res, int elem, int elemIdx, int param
 	APIFUNC_VALIDATE_RES( resObj, "h3dSetResParamStr", APIFUNC_RET_VOID );
 	
 	resObj->setElemParamStr( elem, elemIdx, param, value != 0x0 ? value : emptyCString );
+	resObj->markUpdated();
+	APIFUNC_CAPTURE( CaptureCalls::SetResParamStr, res, elem, elemIdx, param, value );
 }
 
 
@@ -382,7 +460,11 @@ H3D_IMPL void *h3dMapResStream( ResHandle res, int elem, int elemIdx, int stream
 	Resource *resObj = Modules::resMan().resolveResHandle( res );
 	APIFUNC_VALIDATE_RES( resObj, "h3dMapResStream", 0x0 );
 
-	return resObj->mapStream( elem, elemIdx, stream, read, write );
+	void *data = resObj->mapStream( elem, elemIdx, stream, read, write );
+#ifdef H3D_API_CAPTURE
+	if( APICapture::isActive() && write ) APICapture::setMappedStream( res, elem, elemIdx, stream, data );
+#endif
+	return data;
 }
 
 
@@ -391,7 +473,11 @@ H3D_IMPL void h3dUnmapResStream( ResHandle res )
 	Resource *resObj = Modules::resMan().resolveResHandle( res );
 	APIFUNC_VALIDATE_RES( resObj, "h3dUnmapResStream", APIFUNC_RET_VOID );
 
+#ifdef H3D_API_CAPTURE
+	if( APICapture::isActive() ) APICapture::recordStreamUpdate( res, resObj->getMappedWriteSize() );
+#endif
 	resObj->unmapStream();
+	resObj->markUpdated();
 }
 
 
@@ -404,6 +490,19 @@ H3D_IMPL ResHandle h3dQueryUnloadedResource( int index )
 H3D_IMPL void h3dReleaseUnusedResources()
 {
 	Modules::resMan().releaseUnusedResources();
+	APIFUNC_CAPTURE( CaptureCalls::ReleaseUnusedResources );
+}
+
+
+H3D_IMPL void h3dGetResourceMemory( int type, int *numResources, float *cpuMemory, float *gpuMemory )
+{
+	int count;
+	uint64 cpuBytes, gpuBytes;
+	Modules::resMan().getMemoryUsage( type, count, cpuBytes, gpuBytes );
+
+	if( numResources != 0x0 ) *numResources = count;
+	if( cpuMemory != 0x0 ) *cpuMemory = cpuBytes / (1024.0f * 1024.0f);
+	if( gpuMemory != 0x0 ) *gpuMemory = gpuBytes / (1024.0f * 1024.0f);
 }
 
 
@@ -419,6 +518,7 @@ H3D_IMPL ResHandle h3dCreateTexture( const char *name, int width, int height, in
 		delete texRes;
 	}
 
+	APIFUNC_CAPTURE( CaptureCalls::CreateTexture, name, width, height, fmt, flags, res );
 	return res;
 }
 
@@ -428,6 +528,8 @@ H3D_IMPL void h3dSetShaderPreambles( const char *vertPreamble, const char *fragP
 {
 	ShaderResource::setPreambles( safeStr( vertPreamble, 0 ), safeStr( fragPreamble, 1 ), safeStr( geomPreamble, 2 ), 
 								  safeStr( tessControlPreamble, 3 ), safeStr( tessEvalPreamble, 4 ), safeStr( computePreamble, 5 ) );
+	APIFUNC_CAPTURE( CaptureCalls::SetShaderPreambles, vertPreamble, fragPreamble, geomPreamble, tessControlPreamble,
+	                 tessEvalPreamble, computePreamble );
 }
 
 
@@ -436,7 +538,10 @@ H3D_IMPL bool h3dSetMaterialUniform( ResHandle materialRes, const char *name, fl
 	Resource *resObj = Modules::resMan().resolveResHandle( materialRes );
 	APIFUNC_VALIDATE_RES_TYPE( resObj, ResourceTypes::Material, "h3dSetMaterialUniform", false );
 
-	return ((MaterialResource *)resObj)->setUniform( safeStr( name, 0 ), a, b, c, d );
+	bool result = ((MaterialResource *)resObj)->setUniform( safeStr( name, 0 ), a, b, c, d );
+	resObj->markUpdated();
+	APIFUNC_CAPTURE( CaptureCalls::SetMaterialUniform, materialRes, name, a, b, c, d );
+	return result;
 }
 
 
@@ -447,6 +552,7 @@ H3D_IMPL void h3dResizePipelineBuffers( ResHandle pipeRes, int width, int height
 
 	PipelineResource *pipeResObj = (PipelineResource *)resObj;
 	pipeResObj->resize( width, height );
+	APIFUNC_CAPTURE( CaptureCalls::ResizePipelineBuffers, pipeRes, width, height );
 }
 
 
@@ -497,7 +603,9 @@ H3D_IMPL bool h3dSetNodeParent( NodeHandle node, NodeHandle parent )
 	SceneNode *snp = Modules::sceneMan().resolveNodeHandle( parent );
 	APIFUNC_VALIDATE_NODE( snp, "h3dSetNodeParent", false );
 	
-	return Modules::sceneMan().relocateNode( *sn, *snp );
+	bool result = Modules::sceneMan().relocateNode( *sn, *snp );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeParent, node, parent );
+	return result;
 }
 
 
@@ -528,7 +636,9 @@ H3D_IMPL NodeHandle h3dAddNodes( NodeHandle parent, ResHandle sceneGraphRes )
 	}
 	
 	//Modules::log().writeInfo( "Adding nodes from SceneGraph resource '%s'", res->getName().c_str() );
-	return Modules::sceneMan().addNodes( *parentNode, *(SceneGraphResource *)sgRes );
+	NodeHandle result = Modules::sceneMan().addNodes( *parentNode, *(SceneGraphResource *)sgRes );
+	APIFUNC_CAPTURE( CaptureCalls::AddNodes, parent, sceneGraphRes, result );
+	return result;
 }
 
 
@@ -539,6 +649,7 @@ H3D_IMPL void h3dRemoveNode( NodeHandle node )
 
 	//Modules::log().writeInfo( "Removing node %i", node );
 	Modules::sceneMan().removeNode( *sn );
+	APIFUNC_CAPTURE( CaptureCalls::RemoveNode, node );
 }
 
 
@@ -579,6 +690,7 @@ H3D_IMPL void h3dSetNodeTransform( NodeHandle node, float tx, float ty, float tz
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeTransform", APIFUNC_RET_VOID );
 	
 	sn->setTransform( Vec3f( tx, ty, tz ), Vec3f( rx, ry, rz ), Vec3f( sx, sy, sz ) );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeTransform, node, tx, ty, tz, rx, ry, rz, sx, sy, sz );
 }
 
 
@@ -605,6 +717,7 @@ H3D_IMPL void h3dSetNodeTransMat( NodeHandle node, const float *mat4x4 )
 
 	memcpy( mat.c, mat4x4, 16 * sizeof( float ) );
 	sn->setTransform( mat );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeTransMat, node, CaptureFloats( mat4x4, 16 ) );
 }
 
 
@@ -623,6 +736,7 @@ H3D_IMPL void h3dSetNodeParamI( NodeHandle node, int param, int value )
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeParamI", APIFUNC_RET_VOID );
 
 	sn->setParamI( param, value );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeParamI, node, param, value );
 }
 
 
@@ -641,6 +755,7 @@ H3D_IMPL void h3dSetNodeParamF( NodeHandle node, int param, int compIdx, float v
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeParamF", APIFUNC_RET_VOID );
 
 	sn->setParamF( param, compIdx, value );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeParamF, node, param, compIdx, value );
 }
 
 
@@ -659,6 +774,7 @@ H3D_IMPL void h3dSetNodeParamStr( NodeHandle node, int param, const char *name )
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeParamStr", APIFUNC_RET_VOID );
 	
 	sn->setParamStr( param, name != 0x0 ? name : emptyCString );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeParamStr, node, param, name );
 }
 
 
@@ -675,6 +791,7 @@ H3D_IMPL void h3dSetNodeFlags( NodeHandle node, int flags, bool recursive )
 	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeFlags", APIFUNC_RET_VOID );
 	sn->setFlags( flags, recursive );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeFlags, node, flags, recursive );
 }
 
 
@@ -700,7 +817,9 @@ H3D_IMPL int h3dFindNodes( NodeHandle startNode, const char *name, int type )
 	APIFUNC_VALIDATE_NODE( sn, "h3dFindNodes", 0 );
 
 	Modules::sceneMan().clearFindResults();
-	return Modules::sceneMan().findNodes( *sn, safeStr( name, 0 ), type );
+	int count = Modules::sceneMan().findNodes( *sn, safeStr( name, 0 ), type );
+	APIFUNC_CAPTURE( CaptureCalls::FindNodes, startNode, name, type );
+	return count;
 }
 
 
@@ -717,6 +836,7 @@ H3D_IMPL void h3dSetNodeUniforms( NodeHandle node, const float *uniformData, int
 	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
 	APIFUNC_VALIDATE_NODE( sn, "h3dSetNodeUniforms", APIFUNC_RET_VOID );
 	sn->setCustomInstData( uniformData, (uint32)count );
+	APIFUNC_CAPTURE( CaptureCalls::SetNodeUniforms, node, CaptureFloats( uniformData, count > 0 ? (uint32)count : 0 ) );
 }
 
 
@@ -726,7 +846,9 @@ H3D_IMPL NodeHandle h3dCastRay( NodeHandle node, float ox, float oy, float oz, f
 	APIFUNC_VALIDATE_NODE( sn, "h3dCastRay", 0 );
 
 	Modules::sceneMan().updateNodes();
-	return Modules::sceneMan().castRay( *sn, Vec3f( ox, oy, oz ), Vec3f( dx, dy, dz ), numNearest );
+	NodeHandle result = Modules::sceneMan().castRay( *sn, Vec3f( ox, oy, oz ), Vec3f( dx, dy, dz ), numNearest );
+	APIFUNC_CAPTURE( CaptureCalls::CastRay, node, ox, oy, oz, dx, dy, dz, numNearest );
+	return result;
 }
 
 
@@ -751,6 +873,24 @@ H3D_IMPL bool h3dGetCastRayResult( int index, NodeHandle *node, float *distance,
 }
 
 
+H3D_IMPL int h3dCastRays( NodeHandle node, const float *rays, int count, RayHit *hits, int flags )
+{
+	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
+	APIFUNC_VALIDATE_NODE( sn, "h3dCastRays", 0 );
+	if( count <= 0 ) return 0;
+	if( rays == 0x0 || hits == 0x0 )
+	{
+		Modules::setError( "Invalid pointer in h3dCastRays" );
+		return 0;
+	}
+
+	Modules::sceneMan().updateNodes();
+	int numHits = Modules::sceneMan().castRays( *sn, rays, (uint32)count, hits, flags );
+	APIFUNC_CAPTURE( CaptureCalls::CastRays, node, CaptureFloats( rays, (uint32)count * 6 ), flags );
+	return numHits;
+}
+
+
 H3D_IMPL int h3dCheckNodeVisibility( NodeHandle node, NodeHandle cameraNode, bool checkOcclusion, bool calcLod )
 {
 	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( node );
@@ -758,7 +898,9 @@ H3D_IMPL int h3dCheckNodeVisibility( NodeHandle node, NodeHandle cameraNode, boo
 	SceneNode *cam = Modules::sceneMan().resolveNodeHandle( cameraNode );
 	APIFUNC_VALIDATE_NODE_TYPE( cam, SceneNodeTypes::Camera, "h3dCheckNodeVisibility", -1 );
 	
-	return Modules::sceneMan().checkNodeVisibility( *sn, *(CameraNode *)cam, checkOcclusion, calcLod );
+	int result = Modules::sceneMan().checkNodeVisibility( *sn, *(CameraNode *)cam, checkOcclusion, calcLod );
+	APIFUNC_CAPTURE( CaptureCalls::CheckNodeVisibility, node, cameraNode, checkOcclusion, calcLod );
+	return result;
 }
 
 
@@ -770,7 +912,9 @@ H3D_IMPL NodeHandle h3dAddGroupNode( NodeHandle parent, const char *name )
 	//Modules::log().writeInfo( "Adding Group node '%s'", safeStr( name ).c_str() );
 	GroupNodeTpl tpl( safeStr( name, 0 ) );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Group )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddGroupNode, parent, name, node );
+	return node;
 }
 
 
@@ -784,7 +928,9 @@ H3D_IMPL NodeHandle h3dAddModelNode( NodeHandle parent, const char *name, ResHan
 	//Modules::log().writeInfo( "Adding Model node '%s'", safeStr( name ).c_str() );
 	ModelNodeTpl tpl( safeStr( name, 0 ), (GeometryResource *)geoRes );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Model )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddModelNode, parent, name, geometryRes, node );
+	return node;
 }
 
 
@@ -802,6 +948,7 @@ H3D_IMPL void h3dSetupModelAnimStage( NodeHandle modelNode, int stage, ResHandle
 	
 	((ModelNode *)sn)->setupAnimStage( stage, (AnimationResource *)animRes, layer,
 	                                   safeStr( startNode, 0 ), additive );
+	APIFUNC_CAPTURE( CaptureCalls::SetupModelAnimStage, modelNode, stage, animationRes, layer, startNode, additive );
 }
 
 
@@ -820,6 +967,7 @@ H3D_IMPL void h3dSetModelAnimParams( NodeHandle modelNode, int stage, float time
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Model, "h3dSetModelAnimParams", APIFUNC_RET_VOID );
 	
 	((ModelNode *)sn)->setAnimParams( stage, time, weight );
+	APIFUNC_CAPTURE( CaptureCalls::SetModelAnimParams, modelNode, stage, time, weight );
 }
 
 
@@ -828,7 +976,9 @@ H3D_IMPL bool h3dSetModelMorpher( NodeHandle modelNode, const char *target, floa
 	SceneNode *sn = Modules::sceneMan().resolveNodeHandle( modelNode );
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Model, "h3dSetModelMorpher", false );
 	
-	return ((ModelNode *)sn)->setMorphParam( safeStr( target, 0 ), weight );
+	bool result = ((ModelNode *)sn)->setMorphParam( safeStr( target, 0 ), weight );
+	APIFUNC_CAPTURE( CaptureCalls::SetModelMorpher, modelNode, target, weight );
+	return result;
 }
 
 
@@ -838,6 +988,7 @@ H3D_IMPL void h3dUpdateModel( NodeHandle modelNode, int flags )
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Model, "h3dUpdateModel", APIFUNC_RET_VOID );
 
 	((ModelNode *)sn)->update( flags );
+	APIFUNC_CAPTURE( CaptureCalls::UpdateModel, modelNode, flags );
 }
 
 
@@ -853,7 +1004,10 @@ H3D_IMPL NodeHandle h3dAddMeshNode( NodeHandle parent, const char *name, ResHand
 	MeshNodeTpl tpl( safeStr( name, 0 ), (MaterialResource *)matRes, (MeshPrimType::List)primType,
 	                 (unsigned)batchStart, (unsigned)batchCount, (unsigned)vertRStart, (unsigned)vertREnd );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Mesh )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddMeshNode, parent, name, materialRes, primType,
+	                 batchStart, batchCount, vertRStart, vertREnd, node );
+	return node;
 }
 
 
@@ -865,7 +1019,9 @@ H3D_IMPL NodeHandle h3dAddJointNode( NodeHandle parent, const char *name, int jo
 	//Modules::log().writeInfo( "Adding Joint node '%s'", safeStr( name ).c_str() );
 	JointNodeTpl tpl( safeStr( name, 0 ), (unsigned)jointIndex );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Joint )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddJointNode, parent, name, jointIndex, node );
+	return node;
 }
 
 
@@ -884,7 +1040,10 @@ H3D_IMPL NodeHandle h3dAddLightNode( NodeHandle parent, const char *name, ResHan
 	LightNodeTpl tpl( safeStr( name, 0 ), (MaterialResource *)matRes,
 	                  safeStr( lightingContext, 1 ), safeStr( shadowContext, 2 ) );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Light )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddLightNode, parent, name, materialRes, lightingContext,
+	                 shadowContext, node );
+	return node;
 }
 
 
@@ -898,7 +1057,9 @@ H3D_IMPL NodeHandle h3dAddCameraNode( NodeHandle parent, const char *name, ResHa
 	//Modules::log().writeInfo( "Adding Camera node '%s'", safeStr( name ).c_str() );
 	CameraNodeTpl tpl( safeStr( name, 0 ), (PipelineResource *)pipeRes );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Camera )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddCameraNode, parent, name, pipelineRes, node );
+	return node;
 }
 
 
@@ -908,6 +1069,7 @@ H3D_IMPL void h3dSetupCameraView( NodeHandle cameraNode, float fov, float aspect
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Camera, "h3dSetupCameraView", APIFUNC_RET_VOID );
 	
 	((CameraNode *)sn)->setupViewParams( fov, aspect, nearDist, farDist );
+	APIFUNC_CAPTURE( CaptureCalls::SetupCameraView, cameraNode, fov, aspect, nearDist, farDist );
 }
 
 
@@ -939,6 +1101,7 @@ H3D_IMPL void h3dSetCameraProjMat( NodeHandle cameraNode, float *projMat )
 	Modules::sceneMan().updateNodes();
 
 	( ( CameraNode * ) sn )->setProjectionMatrix( projMat );
+	APIFUNC_CAPTURE( CaptureCalls::SetCameraProjMat, cameraNode, CaptureFloats( projMat, 16 ) );
 }
 
 
@@ -956,7 +1119,10 @@ H3D_IMPL NodeHandle h3dAddEmitterNode( NodeHandle parent, const char *name, ResH
 	EmitterNodeTpl tpl( safeStr( name, 0 ), (MaterialResource *)matRes, (ParticleEffectResource *)effRes,
 	                    (unsigned)maxParticleCount, respawnCount );
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Emitter )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddEmitterNode, parent, name, materialRes, particleEffectRes,
+	                 maxParticleCount, respawnCount, node );
+	return node;
 }
 
 
@@ -966,6 +1132,7 @@ H3D_IMPL void h3dUpdateEmitter( NodeHandle emitterNode, float timeDelta )
 	APIFUNC_VALIDATE_NODE_TYPE( sn, SceneNodeTypes::Emitter, "h3dUpdateEmitter", APIFUNC_RET_VOID );
 	
 	((EmitterNode *)sn)->update( timeDelta );
+	APIFUNC_CAPTURE( CaptureCalls::UpdateEmitter, emitterNode, timeDelta );
 }
 
 
@@ -992,9 +1159,444 @@ H3D_IMPL NodeHandle h3dAddComputeNode( NodeHandle parent, const char *name, ResH
 						primType, elementsCount );
 
 	SceneNode *sn = Modules::sceneMan().findType( SceneNodeTypes::Compute )->factoryFunc( tpl );
-	return Modules::sceneMan().addNode( sn, *parentNode );
+	NodeHandle node = Modules::sceneMan().addNode( sn, *parentNode );
+	APIFUNC_CAPTURE( CaptureCalls::AddComputeNode, parent, name, materialRes, compBufferRes, primType, elementsCount,
+	                 node );
+	return node;
+}
+
+// =================================================================================================
+// Capture and replay functions
+// =================================================================================================
+
+H3D_IMPL bool h3dBeginCapture( const char *fileName )
+{
+#ifdef H3D_API_CAPTURE
+	if( replayReader != 0x0 )
+	{
+		Modules::setError( "Capture cannot be started during a replay in h3dBeginCapture" );
+		return false;
+	}
+	
+	return APICapture::begin( safeStr( fileName, 0 ).c_str() );
+#else
+	H3D_UNUSED_VAR( fileName );
+	Modules::log().writeError( "h3dBeginCapture: engine was built without HORDE3D_API_CAPTURE" );
+	return false;
+#endif
+}
+
+
+H3D_IMPL void h3dEndCapture()
+{
+	APICapture::end();
 }
 
+
+static void checkReplayHandle( const char *func, int captured, int replayed )
+{
+	// Handles are assigned in the same order, so any difference shows that the replay diverged
+	if( captured != replayed )
+		Modules::log().writeWarning( "Replay diverged in %s: got handle %i instead of %i", func, replayed, captured );
+}
+
+
+static bool replayCall( CaptureReader &r, int call )
+{
+	switch( call )
+	{
+	case CaptureCalls::Render:
+		h3dRender( r.readInt() );
+		break;
+	case CaptureCalls::Compute:
+	{
+		int materialRes = r.readInt();
+		const char *context = r.readString();
+		int groupX = r.readInt(), groupY = r.readInt(), groupZ = r.readInt();
+		h3dCompute( materialRes, context, groupX, groupY, groupZ );
+		break;
+	}
+	case CaptureCalls::Clear:
+		h3dClear();
+		break;
+	case CaptureCalls::SetOption:
+	{
+		int param = r.readInt();
+		h3dSetOption( (EngineOptions::List)param, r.readFloat() );
+		break;
+	}
+	
+	// Resources
+	case CaptureCalls::AddResource:
+	{
+		int type = r.readInt();
+		const char *name = r.readString();
+		int flags = r.readInt();
+		checkReplayHandle( "h3dAddResource", r.readInt(), h3dAddResource( type, name, flags ) );
+		break;
+	}
+	case CaptureCalls::CloneResource:
+	{
+		int sourceRes = r.readInt();
+		const char *name = r.readString();
+		checkReplayHandle( "h3dCloneResource", r.readInt(), h3dCloneResource( sourceRes, name ) );
+		break;
+	}
+	case CaptureCalls::RemoveResource:
+		h3dRemoveResource( r.readInt() );
+		break;
+	case CaptureCalls::LoadResource:
+	{
+		int res = r.readInt();
+		uint32 size;
+		const char *data = r.readData( size );
+		h3dLoadResource( res, data, (int)size );
+		break;
+	}
+	case CaptureCalls::UnloadResource:
+		h3dUnloadResource( r.readInt() );
+		break;
+	case CaptureCalls::SetResParamI:
+	{
+		int res = r.readInt(), elem = r.readInt(), elemIdx = r.readInt(), param = r.readInt();
+		h3dSetResParamI( res, elem, elemIdx, param, r.readInt() );
+		break;
+	}
+	case CaptureCalls::SetResParamF:
+	{
+		int res = r.readInt(), elem = r.readInt(), elemIdx = r.readInt(), param = r.readInt(), compIdx = r.readInt();
+		h3dSetResParamF( res, elem, elemIdx, param, compIdx, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::SetResParamStr:
+	{
+		int res = r.readInt(), elem = r.readInt(), elemIdx = r.readInt(), param = r.readInt();
+		h3dSetResParamStr( res, elem, elemIdx, param, r.readString() );
+		break;
+	}
+	case CaptureCalls::UpdateResStream:
+	{
+		int res = r.readInt(), elem = r.readInt(), elemIdx = r.readInt(), stream = r.readInt();
+		uint32 size;
+		const char *data = r.readData( size );
+		void *dst = h3dMapResStream( res, elem, elemIdx, stream, false, true );
+		if( dst != 0x0 && data != 0x0 ) memcpy( dst, data, size );
+		h3dUnmapResStream( res );
+		break;
+	}
+	case CaptureCalls::ReleaseUnusedResources:
+		h3dReleaseUnusedResources();
+		break;
+	case CaptureCalls::CreateTexture:
+	{
+		const char *name = r.readString();
+		int width = r.readInt(), height = r.readInt(), fmt = r.readInt(), flags = r.readInt();
+		checkReplayHandle( "h3dCreateTexture", r.readInt(), h3dCreateTexture( name, width, height, fmt, flags ) );
+		break;
+	}
+	case CaptureCalls::SetShaderPreambles:
+	{
+		const char *preambles[6];
+		for( int i = 0; i < 6; ++i ) preambles[i] = r.readString();
+		h3dSetShaderPreambles( preambles[0], preambles[1], preambles[2], preambles[3], preambles[4], preambles[5] );
+		break;
+	}
+	case CaptureCalls::SetMaterialUniform:
+	{
+		int materialRes = r.readInt();
+		const char *name = r.readString();
+		float a = r.readFloat(), b = r.readFloat(), c = r.readFloat(), d = r.readFloat();
+		h3dSetMaterialUniform( materialRes, name, a, b, c, d );
+		break;
+	}
+	case CaptureCalls::ResizePipelineBuffers:
+	{
+		int pipeRes = r.readInt(), width = r.readInt();
+		h3dResizePipelineBuffers( pipeRes, width, r.readInt() );
+		break;
+	}
+
+	// Scene graph
+	case CaptureCalls::SetNodeParent:
+	{
+		int node = r.readInt();
+		h3dSetNodeParent( node, r.readInt() );
+		break;
+	}
+	case CaptureCalls::AddNodes:
+	{
+		int parent = r.readInt(), sceneGraphRes = r.readInt();
+		checkReplayHandle( "h3dAddNodes", r.readInt(), h3dAddNodes( parent, sceneGraphRes ) );
+		break;
+	}
+	case CaptureCalls::RemoveNode:
+		h3dRemoveNode( r.readInt() );
+		break;
+	case CaptureCalls::SetNodeTransform:
+	{
+		int node = r.readInt();
+		float v[9];
+		for( int i = 0; i < 9; ++i ) v[i] = r.readFloat();
+		h3dSetNodeTransform( node, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8] );
+		break;
+	}
+	case CaptureCalls::SetNodeTransMat:
+	{
+		int node = r.readInt();
+		uint32 count;
+		const float *mat = r.readFloats( count );
+		if( count == 16 ) h3dSetNodeTransMat( node, mat );
+		break;
+	}
+	case CaptureCalls::SetNodeParamI:
+	{
+		int node = r.readInt(), param = r.readInt();
+		h3dSetNodeParamI( node, param, r.readInt() );
+		break;
+	}
+	case CaptureCalls::SetNodeParamF:
+	{
+		int node = r.readInt(), param = r.readInt(), compIdx = r.readInt();
+		h3dSetNodeParamF( node, param, compIdx, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::SetNodeParamStr:
+	{
+		int node = r.readInt(), param = r.readInt();
+		h3dSetNodeParamStr( node, param, r.readString() );
+		break;
+	}
+	case CaptureCalls::SetNodeFlags:
+	{
+		int node = r.readInt(), flags = r.readInt();
+		h3dSetNodeFlags( node, flags, r.readBool() );
+		break;
+	}
+	case CaptureCalls::FindNodes:
+	{
+		int startNode = r.readInt();
+		const char *name = r.readString();
+		h3dFindNodes( startNode, name, r.readInt() );
+		break;
+	}
+	case CaptureCalls::SetNodeUniforms:
+	{
+		int node = r.readInt();
+		uint32 count;
+		const float *data = r.readFloats( count );
+		h3dSetNodeUniforms( node, data, (int)count );
+		break;
+	}
+	case CaptureCalls::CastRay:
+	{
+		int node = r.readInt();
+		float v[6];
+		for( int i = 0; i < 6; ++i ) v[i] = r.readFloat();
+		h3dCastRay( node, v[0], v[1], v[2], v[3], v[4], v[5], r.readInt() );
+		break;
+	}
+	case CaptureCalls::CastRays:
+	{
+		static vector< RayHit > hits;
+		int node = r.readInt();
+		uint32 count;
+		const float *rays = r.readFloats( count );
+		hits.resize( count / 6 + 1 );
+		h3dCastRays( node, rays, (int)(count / 6), &hits[0], r.readInt() );
+		break;
+	}
+	case CaptureCalls::CheckNodeVisibility:
+	{
+		int node = r.readInt(), cameraNode = r.readInt();
+		bool checkOcclusion = r.readBool();
+		h3dCheckNodeVisibility( node, cameraNode, checkOcclusion, r.readBool() );
+		break;
+	}
+	case CaptureCalls::AddGroupNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		checkReplayHandle( "h3dAddGroupNode", r.readInt(), h3dAddGroupNode( parent, name ) );
+		break;
+	}
+	case CaptureCalls::AddModelNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int geometryRes = r.readInt();
+		checkReplayHandle( "h3dAddModelNode", r.readInt(), h3dAddModelNode( parent, name, geometryRes ) );
+		break;
+	}
+	case CaptureCalls::SetupModelAnimStage:
+	{
+		int modelNode = r.readInt(), stage = r.readInt(), animationRes = r.readInt(), layer = r.readInt();
+		const char *startNode = r.readString();
+		h3dSetupModelAnimStage( modelNode, stage, animationRes, layer, startNode, r.readBool() );
+		break;
+	}
+	case CaptureCalls::SetModelAnimParams:
+	{
+		int modelNode = r.readInt(), stage = r.readInt();
+		float time = r.readFloat();
+		h3dSetModelAnimParams( modelNode, stage, time, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::SetModelMorpher:
+	{
+		int modelNode = r.readInt();
+		const char *target = r.readString();
+		h3dSetModelMorpher( modelNode, target, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::UpdateModel:
+	{
+		int modelNode = r.readInt();
+		h3dUpdateModel( modelNode, r.readInt() );
+		break;
+	}
+	case CaptureCalls::AddMeshNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int materialRes = r.readInt(), primType = r.readInt(), batchStart = r.readInt(), batchCount = r.readInt();
+		int vertRStart = r.readInt(), vertREnd = r.readInt();
+		checkReplayHandle( "h3dAddMeshNode", r.readInt(), h3dAddMeshNode( parent, name, materialRes, primType,
+		                   batchStart, batchCount, vertRStart, vertREnd ) );
+		break;
+	}
+	case CaptureCalls::AddJointNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int jointIndex = r.readInt();
+		checkReplayHandle( "h3dAddJointNode", r.readInt(), h3dAddJointNode( parent, name, jointIndex ) );
+		break;
+	}
+	case CaptureCalls::AddLightNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int materialRes = r.readInt();
+		const char *lightingContext = r.readString();
+		const char *shadowContext = r.readString();
+		checkReplayHandle( "h3dAddLightNode", r.readInt(),
+		                   h3dAddLightNode( parent, name, materialRes, lightingContext, shadowContext ) );
+		break;
+	}
+	case CaptureCalls::AddCameraNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int pipelineRes = r.readInt();
+		checkReplayHandle( "h3dAddCameraNode", r.readInt(), h3dAddCameraNode( parent, name, pipelineRes ) );
+		break;
+	}
+	case CaptureCalls::SetupCameraView:
+	{
+		int cameraNode = r.readInt();
+		float fov = r.readFloat(), aspect = r.readFloat(), nearDist = r.readFloat();
+		h3dSetupCameraView( cameraNode, fov, aspect, nearDist, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::SetCameraProjMat:
+	{
+		float mat[16];
+		int cameraNode = r.readInt();
+		uint32 count;
+		const float *values = r.readFloats( count );
+		if( count != 16 ) break;
+		memcpy( mat, values, sizeof( mat ) );
+		h3dSetCameraProjMat( cameraNode, mat );
+		break;
+	}
+	case CaptureCalls::AddEmitterNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int materialRes = r.readInt(), particleEffectRes = r.readInt(), maxParticleCount = r.readInt();
+		int respawnCount = r.readInt();
+		checkReplayHandle( "h3dAddEmitterNode", r.readInt(), h3dAddEmitterNode( parent, name, materialRes,
+		                   particleEffectRes, maxParticleCount, respawnCount ) );
+		break;
+	}
+	case CaptureCalls::UpdateEmitter:
+	{
+		int emitterNode = r.readInt();
+		h3dUpdateEmitter( emitterNode, r.readFloat() );
+		break;
+	}
+	case CaptureCalls::AddComputeNode:
+	{
+		int parent = r.readInt();
+		const char *name = r.readString();
+		int materialRes = r.readInt(), compBufferRes = r.readInt(), primType = r.readInt();
+		int elementsCount = r.readInt();
+		checkReplayHandle( "h3dAddComputeNode", r.readInt(), h3dAddComputeNode( parent, name, materialRes,
+		                   compBufferRes, primType, elementsCount ) );
+		break;
+	}
+	default:
+		return false;
+	}
+
+	return !r.hasError();
+}
+
+
+H3D_IMPL bool h3dBeginReplay( const char *fileName )
+{
+	if( APICapture::isActive() )
+	{
+		Modules::setError( "Replay cannot be started during a capture in h3dBeginReplay" );
+		return false;
+	}
+	
+	delete replayReader;
+	replayReader = new CaptureReader();
+	if( !replayReader->open( safeStr( fileName, 0 ).c_str() ) )
+	{
+		Modules::log().writeError( "Failed to open capture file '%s'", safeStr( fileName, 0 ).c_str() );
+		delete replayReader; replayReader = 0x0;
+		return false;
+	}
+
+	return true;
+}
+
+
+H3D_IMPL bool h3dReplayFrame( float *captureTime )
+{
+	if( replayReader == 0x0 ) return false;
+
+	while( !replayReader->atEnd() )
+	{
+		int call = replayReader->readCall();
+		if( call == CaptureCalls::FinalizeFrame )
+		{
+			float frameTime = replayReader->readFloat();
+			if( captureTime != 0x0 ) *captureTime = frameTime;
+			h3dFinalizeFrame();
+			return !replayReader->hasError();
+		}
+		
+		if( !replayCall( *replayReader, call ) )
+		{
+			Modules::log().writeError( "Invalid capture data for call %i in h3dReplayFrame", call );
+			break;
+		}
+	}
+
+	// End of the capture; calls after the last h3dFinalizeFrame were executed without ending a frame
+	return false;
+}
+
+
+H3D_IMPL void h3dEndReplay()
+{
+	delete replayReader; replayReader = 0x0;
+}
+
+
 // =================================================================================================
 // DLL entry point
 // =================================================================================================
@@ -14,6 +14,7 @@
 #include "egTexture.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "utXML.h"
 #include <cstring>
 #include <algorithm>
@@ -99,6 +100,8 @@ bool MaterialResource::raiseError( const string &msg, int line )
 
 bool MaterialResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "MaterialResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 	
 	XMLDoc doc;
@@ -153,6 +153,8 @@ private:
 	friend class ResourceManager;
 	friend class Renderer;
 	friend class MeshNode;
+	friend class TextureStreamer;
+	friend class PipelineResource;
 };
 
 }
@@ -114,6 +114,7 @@ public:
 		  _skinMatRows[index * 3 + 1] = mat.getRow( 1 );
 		  _skinMatRows[index * 3 + 2] = mat.getRow( 2 ); }
 	void markNodeListDirty() { _nodeListDirty = true; }
+	bool usesSoftwareSkinning() const { return _softwareSkinning; }
 
 protected:
 	ModelNode( const ModelNodeTpl &modelTpl );
@@ -24,6 +24,9 @@
 #include "egExtensions.h"
 #include "egComputeBuffer.h"
 #include "egComputeNode.h"
+#include "egProfiler.h"
+#include "egCapture.h"
+#include "egJobs.h"
 
 
 // Extensions
@@ -45,6 +48,7 @@ ResourceManager						*Modules::_resourceManager = 0x0;
 Renderer							*Modules::_renderer = 0x0;
 ExtensionManager					*Modules::_extensionManager = 0x0;
 ExternalPipelineCommandsManager		*Modules::_extCmdPipeMan = 0x0;
+JobManager							*Modules::_jobManager = 0x0;
 
 void Modules::installExtensions()
 {
@@ -58,6 +62,7 @@ bool Modules::init( int backendType )
 	if( _extensionManager == 0x0 ) _extensionManager = new ExtensionManager();
 	if( _engineLog == 0x0 ) _engineLog = new EngineLog();
 	if( _engineConfig == 0x0 ) _engineConfig = new EngineConfig();
+	if( _jobManager == 0x0 ) _jobManager = new JobManager();
 	if( _sceneManager == 0x0 ) _sceneManager = new SceneManager();
 	if( _resourceManager == 0x0 ) _resourceManager = new ResourceManager();
 	if( _renderer == 0x0 ) _renderer = new Renderer();
@@ -156,7 +161,13 @@ void Modules::release()
 {
 	// Remove overlays since they reference resources and resource manager is removed before renderer
 //	if( _renderer ) _renderer->clearOverlays();
+
+	// Close the capture file while the log is still available for errors
+	APICapture::end();
 	
+	// Finish all jobs first since they can reference any other module
+	delete _jobManager; _jobManager = 0x0;
+
 	// Order of destruction is important
 	delete _extensionManager; _extensionManager = 0x0;
 	delete _extCmdPipeMan; _extCmdPipeMan = 0x0;
@@ -166,6 +177,8 @@ void Modules::release()
 	delete _statManager; _statManager = 0x0;
 	delete _engineLog; _engineLog = 0x0;
 	delete _engineConfig; _engineConfig = 0x0;
+
+	Profiler::release();
 }
 
 
@@ -178,7 +191,7 @@ void Modules::setError( const char *errorStr1, const char *errorStr2 )
 	if( errorStr2 ) msg.append( errorStr2 );
 	
 	_errorFlag = true;
-	_engineLog->writeDebugInfo( msg.c_str() );
+	_engineLog->writeUnlimited( 4, "%s", msg.c_str() );
 }
 
 
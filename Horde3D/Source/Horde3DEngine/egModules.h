@@ -27,6 +27,7 @@ class ResourceManager;
 class Renderer;
 class ExtensionManager;
 class ExternalPipelineCommandsManager;
+class JobManager;
 
 
 // =================================================================================================
@@ -50,6 +51,8 @@ public:
 	static Renderer &renderer() { return *_renderer; }
 	static ExtensionManager &extMan() { return *_extensionManager; }
 	static ExternalPipelineCommandsManager &pipeMan() { return *_extCmdPipeMan; }
+	// Worker threads shared by the engine and extensions; requires egJobs.h
+	static JobManager &jobMan() { return *_jobManager; }
 public:
 	static const char *versionString;
 
@@ -67,6 +70,7 @@ private:
 	static Renderer							*_renderer;
 	static ExtensionManager					*_extensionManager;
 	static ExternalPipelineCommandsManager	*_extCmdPipeMan;
+	static JobManager						*_jobManager;
 
 };
 
@@ -92,5 +96,12 @@ private:
 	#define APIFUNC_RET_VOID
 #endif
 
+// Records a call with its arguments while a capture is active; requires egCapture.h
+#ifdef H3D_API_CAPTURE
+	#define APIFUNC_CAPTURE( ... ) if( APICapture::isActive() ) APICapture::record( __VA_ARGS__ )
+#else
+	#define APIFUNC_CAPTURE( ... )
+#endif
+
 }
 #endif // _egModules_H_
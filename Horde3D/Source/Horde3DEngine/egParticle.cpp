@@ -14,6 +14,7 @@
 #include "egMaterial.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
 #include "utXML.h"
 
@@ -109,6 +110,8 @@ bool ParticleEffectResource::raiseError( const string &msg, int line )
 
 bool ParticleEffectResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "ParticleEffectResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	XMLDoc doc;
@@ -14,8 +14,10 @@
 #include "egMaterial.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
 #include "utXML.h"
+#include <algorithm>
 #include <fstream>
 
 #include "utDebug.h"
@@ -45,6 +47,7 @@ PipelineResource::~PipelineResource()
 void PipelineResource::initDefault()
 {
 	_baseWidth = 320; _baseHeight = 240;
+	_renderBufferMem = 0;
 }
 
 
@@ -183,7 +186,9 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 			stage.commands.push_back( PipelineCommand( DefaultPipelineCommands::DrawGeometry ) );
 			vector< PipeCmdParam > &params = stage.commands.back().params;
 			params.resize( 3 );			
+			// Context parameters store the interned context id as int next to the name
 			params[0].setString( node1.getAttribute( "context" ) );
+			params[0].setInt( ShaderResource::getContextID( params[0].getString() ) );
 			params[1].setInt( MaterialClassCollection::addClass( node1.getAttribute( "class", "" ) ) );
 			params[2].setInt( order );
 		}
@@ -200,6 +205,7 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 			params.resize( 2 );
 			params[0].setResource( Modules::resMan().resolveResHandle( matRes ) );
 			params[1].setString( node1.getAttribute( "context" ) );
+			params[1].setInt( ShaderResource::getContextID( params[1].getString() ) );
 		}
 		else if( strcmp( node1.getName(), "DoForwardLightLoop" ) == 0 )
 		{
@@ -213,6 +219,7 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 			vector< PipeCmdParam > &params = stage.commands.back().params;
 			params.resize( 4 );
 			params[0].setString( node1.getAttribute( "context", "" ) );
+			params[0].setInt( params[0].getString().empty() ? -1 : ShaderResource::getContextID( params[0].getString() ) );
 			params[1].setInt( MaterialClassCollection::addClass( node1.getAttribute( "class", "" ) ) );
 			params[2].setBool( _stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0 );
 			params[3].setInt( order );
@@ -223,8 +230,27 @@ const string PipelineResource::parseStage( XMLNode &node, PipelineStage &stage )
 			vector< PipeCmdParam > &params = stage.commands.back().params;
 			params.resize( 2 );
 			params[0].setString( node1.getAttribute( "context", "" ) );
+			params[0].setInt( params[0].getString().empty() ? -1 : ShaderResource::getContextID( params[0].getString() ) );
 			params[1].setBool( _stricmp( node1.getAttribute( "noShadows", "false" ), "true" ) == 0 );
 		}
+		else if( strcmp( node1.getName(), "DoClusteredLighting" ) == 0 )
+		{
+			if( !node1.getAttribute( "context" ) ) return "Missing DoClusteredLighting attribute 'context'";
+
+			const char *orderStr = node1.getAttribute( "order", "" );
+			int order = RenderingOrder::StateChanges;
+			if( _stricmp( orderStr, "FRONT_TO_BACK" ) == 0 ) order = RenderingOrder::FrontToBack;
+			else if( _stricmp( orderStr, "BACK_TO_FRONT" ) == 0 ) order = RenderingOrder::BackToFront;
+			else if( _stricmp( orderStr, "NONE" ) == 0 ) order = RenderingOrder::None;
+
+			stage.commands.push_back( PipelineCommand( DefaultPipelineCommands::DoClusteredLighting ) );
+			vector< PipeCmdParam > &params = stage.commands.back().params;
+			params.resize( 3 );
+			params[0].setString( node1.getAttribute( "context" ) );
+			params[0].setInt( ShaderResource::getContextID( params[0].getString() ) );
+			params[1].setInt( MaterialClassCollection::addClass( node1.getAttribute( "class", "" ) ) );
+			params[2].setInt( order );
+		}
 // 		else if ( strcmp( node1.getName(), "DispatchComputeShader" ) == 0 )
 // 		{
 // 			if ( !node1.getAttribute( "material" ) ) return "Missing DispatchComputeShader attribute 'material'";
@@ -325,21 +351,236 @@ RenderTarget *PipelineResource::findRenderTarget( const string &id ) const
 }
 
 
+void PipelineResource::compile()
+{
+	uint32 numCommands = 0, numCompiled = 0;
+
+	// Resolve targets and drop commands whose effect is overridden by the next command: switching
+	// the target also unbinds all buffers
+	for( size_t i = 0; i < _stages.size(); ++i )
+	{
+		PipelineStage &stage = _stages[i];
+		vector< CompiledPipeCmd > &compiled = stage.compiledCommands;
+		compiled.clear();
+		compiled.reserve( stage.commands.size() );
+
+		for( uint32 j = 0; j < stage.commands.size(); ++j )
+		{
+			const PipelineCommand &pc = stage.commands[j];
+			DefaultPipelineCommands::List prevCmd = compiled.empty() ?
+				DefaultPipelineCommands::ExternalCommand : stage.commands[compiled.back().cmdIndex].command;
+
+			switch( pc.command )
+			{
+			case DefaultPipelineCommands::SwitchTarget:
+				while( !compiled.empty() &&
+				       (stage.commands[compiled.back().cmdIndex].command == DefaultPipelineCommands::SwitchTarget ||
+				        stage.commands[compiled.back().cmdIndex].command == DefaultPipelineCommands::UnbindBuffers) )
+				{
+					compiled.pop_back();
+				}
+				// Fall through
+			case DefaultPipelineCommands::BindBuffer:
+				if( pc.params[0].getPtr() != 0x0 )
+					compiled.push_back( CompiledPipeCmd( j, (int)((RenderTarget *)pc.params[0].getPtr() - &_renderTargets[0]) ) );
+				else
+					compiled.push_back( CompiledPipeCmd( j, -1 ) );
+				break;
+			case DefaultPipelineCommands::UnbindBuffers:
+				if( prevCmd != DefaultPipelineCommands::SwitchTarget && prevCmd != DefaultPipelineCommands::UnbindBuffers )
+					compiled.push_back( CompiledPipeCmd( j, -1 ) );
+				break;
+			default:
+				compiled.push_back( CompiledPipeCmd( j, -1 ) );
+				break;
+			}
+		}
+
+		numCommands += (uint32)stage.commands.size();
+		numCompiled += (uint32)compiled.size();
+	}
+
+	findTargetLifetimes();
+
+	Modules::log().writeInfo( "Pipeline resource '%s': %i commands compiled to %i",
+	                          _name.c_str(), numCommands, numCompiled );
+}
+
+
+bool PipelineResource::overwritesTarget( const PipelineCommand &pc, const RenderTarget &rt ) const
+{
+	if( pc.command == DefaultPipelineCommands::ClearTarget )
+	{
+		bool overwrites = pc.params[0].getBool() || !rt.hasDepthBuf;
+		for( uint32 c = 0; c < rt.numColBufs && c < 4; ++c )
+			overwrites &= pc.params[1 + c].getBool();
+		return overwrites;
+	}
+	
+	// A quad only replaces the contents if it is drawn without blending; as long as the material
+	// or its shader is not loaded, the blend state is unknown
+	if( rt.hasDepthBuf ) return false;
+	MaterialResource *matRes = (MaterialResource *)pc.params[0].getResource();
+	if( matRes == 0x0 || !matRes->isLoaded() ) return false;
+	ShaderResource *shaderRes = matRes->_shaderRes;
+	if( shaderRes == 0x0 || !shaderRes->isLoaded() ) return false;
+	ShaderContext *context = shaderRes->findContext( pc.params[1].getInt() );
+	
+	return context != 0x0 && !context->blendingEnabled;
+}
+
+
+bool PipelineResource::findTargetLifetimes()
+{
+	vector< int > prevUses( _renderTargets.size() * 3 );
+	for( size_t i = 0; i < _renderTargets.size(); ++i )
+	{
+		RenderTarget &rt = _renderTargets[i];
+		prevUses[i * 3] = rt.firstUse;
+		prevUses[i * 3 + 1] = rt.lastUse;
+		prevUses[i * 3 + 2] = rt.transient ? 1 : 0;
+		
+		rt.firstUse = rt.lastUse = -1;
+		rt.transient = false;
+	}
+
+	// Disabled stages are skipped like in rendering, so the current target stays bound across them
+	int pos = 0, curTarget = -1;
+	for( size_t i = 0; i < _stages.size(); ++i )
+	{
+		const PipelineStage &stage = _stages[i];
+		if( !stage.enabled ) continue;
+
+		for( size_t j = 0; j < stage.compiledCommands.size(); ++j, ++pos )
+		{
+			const CompiledPipeCmd &cc = stage.compiledCommands[j];
+			const PipelineCommand &pc = stage.commands[cc.cmdIndex];
+			
+			int target = curTarget;
+			if( pc.command == DefaultPipelineCommands::SwitchTarget ) target = curTarget = cc.target;
+			else if( pc.command == DefaultPipelineCommands::BindBuffer ) target = cc.target;
+			if( target < 0 ) continue;
+
+			RenderTarget &rt = _renderTargets[target];
+			if( rt.firstUse < 0 && pc.command == DefaultPipelineCommands::SwitchTarget )
+			{
+				// Contents do not need to survive from the previous frame if the first drawing
+				// command overwrites all buffers
+				for( size_t k = j + 1; k < stage.compiledCommands.size(); ++k )
+				{
+					const PipelineCommand &next = stage.commands[stage.compiledCommands[k].cmdIndex];
+					if( next.command == DefaultPipelineCommands::ClearTarget ||
+					    next.command == DefaultPipelineCommands::DrawQuad )
+					{
+						rt.transient = overwritesTarget( next, rt );
+						break;
+					}
+					else if( next.command != DefaultPipelineCommands::BindBuffer &&
+					         next.command != DefaultPipelineCommands::SetUniform )
+					{
+						break;
+					}
+				}
+			}
+			
+			if( rt.firstUse < 0 ) rt.firstUse = pos;
+			rt.lastUse = pos;
+		}
+	}
+
+	for( size_t i = 0; i < _renderTargets.size(); ++i )
+	{
+		const RenderTarget &rt = _renderTargets[i];
+		if( rt.firstUse != prevUses[i * 3] || rt.lastUse != prevUses[i * 3 + 1] ||
+		    (rt.transient ? 1 : 0) != prevUses[i * 3 + 2] ) return true;
+	}
+	
+	return false;
+}
+
+
+void PipelineResource::updateRenderTargets()
+{
+	// Lifetimes only matter for aliasing. They change when stages are toggled and when quad materials
+	// are (re)loaded with a different blend state, so they are checked every frame, which only walks
+	// the compiled commands.
+	if( !Modules::config().renderTargetAliasing ) return;
+	
+	if( findTargetLifetimes() )
+	{
+		releaseRenderTargets();
+		createRenderTargets();
+	}
+}
+
+
 bool PipelineResource::createRenderTargets()
 {
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	bool aliasing = Modules::config().renderTargetAliasing;
 
-	for( uint32 i = 0; i < _renderTargets.size(); ++i )
+	// Assign targets in order of their first use, so that each buffer can be reused as soon as
+	// its last user is done
+	vector< uint32 > order( _renderTargets.size() );
+	for( uint32 i = 0; i < order.size(); ++i ) order[i] = i;
+	std::stable_sort( order.begin(), order.end(), [this]( uint32 a, uint32 b )
+		{ return _renderTargets[a].firstUse < _renderTargets[b].firstUse; } );
+
+	vector< uint32 > bufTargets, bufWidths, bufHeights;  // First target using each buffer
+	vector< int > bufLastUse;
+	size_t memory = 0, unaliasedMemory = 0;
+
+	for( uint32 i = 0; i < order.size(); ++i )
 	{
-		RenderTarget &rt = _renderTargets[i];
+		RenderTarget &rt = _renderTargets[order[i]];
 	
 		uint32 width = ftoi_r( rt.width * rt.scale ), height = ftoi_r( rt.height * rt.scale );
 		if( width == 0 ) width = ftoi_r( _baseWidth * rt.scale );
 		if( height == 0 ) height = ftoi_r( _baseHeight * rt.scale );
+
+		size_t size = (size_t)rdi->calcTextureSize( rt.format, width, height, 1 ) * rt.numColBufs;
+		if( rt.hasDepthBuf ) size += (size_t)width * height * 4;
+		size *= std::max( rt.samples, 1u );
+		unaliasedMemory += size;
+
+		rt.rendBuf = 0;
+		rt.aliased = false;
+		if( aliasing && rt.transient )
+		{
+			for( size_t j = 0; j < _renderBuffers.size(); ++j )
+			{
+				RenderTarget &owner = _renderTargets[bufTargets[j]];
+				if( !owner.transient || bufLastUse[j] >= rt.firstUse ) continue;
+				if( bufWidths[j] != width || bufHeights[j] != height || owner.format != rt.format ||
+				    owner.numColBufs != rt.numColBufs || owner.hasDepthBuf != rt.hasDepthBuf ||
+				    owner.samples != rt.samples ) continue;
+
+				rt.rendBuf = _renderBuffers[j];
+				rt.aliased = owner.aliased = true;
+				bufLastUse[j] = rt.lastUse;
+				break;
+			}
+			if( rt.rendBuf != 0 ) continue;
+		}
 		
 		rt.rendBuf = rdi->createRenderBuffer(
 			width, height, rt.format, rt.hasDepthBuf, rt.numColBufs, rt.samples, 0 );
 		if( rt.rendBuf == 0 ) return false;
+
+		_renderBuffers.push_back( rt.rendBuf );
+		bufTargets.push_back( order[i] );
+		bufWidths.push_back( width );
+		bufHeights.push_back( height );
+		bufLastUse.push_back( rt.lastUse );
+		memory += size;
+	}
+	_renderBufferMem = memory;
+
+	if( aliasing )
+	{
+		Modules::log().writeInfo( "Pipeline resource '%s': %i render buffers for %i targets, %.1f MB saved by aliasing",
+		                          _name.c_str(), (int)_renderBuffers.size(), (int)_renderTargets.size(),
+		                          (unaliasedMemory - memory) / (1024.0 * 1024.0) );
 	}
 	
 	return true;
@@ -350,17 +591,20 @@ void PipelineResource::releaseRenderTargets()
 {
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
+	for( uint32 i = 0; i < _renderBuffers.size(); ++i )
+		rdi->destroyRenderBuffer( _renderBuffers[i] );
+	_renderBuffers.clear();
+	_renderBufferMem = 0;
+
 	for( uint32 i = 0; i < _renderTargets.size(); ++i )
-	{
-		RenderTarget &rt = _renderTargets[i];
-		if( rt.rendBuf )
-			rdi->destroyRenderBuffer( rt.rendBuf );
-	}
+		_renderTargets[i].rendBuf = 0;
 }
 
 
 bool PipelineResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "PipelineResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	XMLDoc doc;
@@ -432,6 +676,8 @@ bool PipelineResource::load( const char *data, int size )
 		}
 	}
 
+	compile();
+
 	// Create render targets
 	if( !createRenderTargets() )
 	{
@@ -484,6 +730,13 @@ int PipelineResource::getElemParamI( int elem, int elemIdx, int param ) const
 }
 
 
+void PipelineResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = 0;
+	gpuBytes = _renderBufferMem;
+}
+
+
 void PipelineResource::setElemParamI( int elem, int elemIdx, int param, int value )
 {
 	switch( elem )
@@ -532,7 +785,7 @@ bool PipelineResource::getRenderTargetData( const string &target, int bufIndex,
 	if( target != "" )
 	{	
 		RenderTarget *rt = findRenderTarget( target );
-		if( rt == 0x0 ) return false;
+		if( rt == 0x0 || rt->aliased ) return false;
 		else rbObj = rt->rendBuf;
 	}
 	
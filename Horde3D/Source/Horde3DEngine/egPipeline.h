@@ -55,6 +55,7 @@ struct DefaultPipelineCommands
 		DoForwardLightLoop,
 		DoDeferredLightLoop,
 		SetUniform,
+		DoClusteredLighting,
 		ExternalCommand = 256 // must be the last command
 	};
 };
@@ -123,11 +124,22 @@ struct PipelineCommand
 };
 
 
+// Command as executed by the renderer; render targets are resolved to indices into the target list
+struct CompiledPipeCmd
+{
+	uint32  cmdIndex;  // Index into the commands of the stage
+	int     target;    // SwitchTarget and BindBuffer target, -1 for the main buffer
+
+	CompiledPipeCmd( uint32 cmdIndex, int target ) : cmdIndex( cmdIndex ), target( target ) {}
+};
+
+
 struct PipelineStage
 {
 	std::string                     id;
 	PMaterialResource               matLink;
 	std::vector< PipelineCommand >  commands;
+	std::vector< CompiledPipeCmd >  compiledCommands;  // Commands without redundant target switches and unbinds
 	bool                            enabled;
 
 	PipelineStage() : matLink( 0x0 ), enabled( false ) {}
@@ -145,11 +157,19 @@ struct RenderTarget
 	bool                  hasDepthBuf;
 	uint32                rendBuf;
 
+	// Lifetime as positions in the compiled command sequence of all stages
+	int                   firstUse, lastUse;
+	bool                  transient;  // Fully overwritten without blending before being read in each frame
+	bool                  aliased;    // Render buffer is shared with other targets
+
 	RenderTarget()
 	{
 		hasDepthBuf = false;
 		numColBufs = 0;
 		rendBuf = 0;
+		firstUse = lastUse = -1;
+		transient = false;
+		aliased = false;
 		width = height = 0;
 		samples = 0;
 		scale = 0;
@@ -210,6 +230,7 @@ public:
 	int getElemParamI( int elem, int elemIdx, int param ) const;
 	void setElemParamI( int elem, int elemIdx, int param, int value );
 	const char *getElemParamStr( int elem, int elemIdx, int param ) const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	bool getRenderTargetData( const std::string &target, int bufIndex, int *width, int *height,
 	                          int *compCount, void *dataBuffer, int bufferSize ) const;
@@ -222,11 +243,17 @@ private:
 	                      TextureFormats::List format, uint32 samples,
 	                      uint32 width, uint32 height, float scale );
 	RenderTarget *findRenderTarget( const std::string &id ) const;
+	void compile();
+	bool overwritesTarget( const PipelineCommand &pc, const RenderTarget &rt ) const;
+	bool findTargetLifetimes();  // Returns true if any lifetime changed
+	void updateRenderTargets();
 	bool createRenderTargets();
 	void releaseRenderTargets();
 
 private:
 	std::vector< RenderTarget >   _renderTargets;
+	std::vector< uint32 >         _renderBuffers;  // Render buffer objects, fewer than targets if aliased
+	size_t                        _renderBufferMem;  // Video memory used by the render buffers in bytes
 	std::vector< PipelineStage >  _stages;
 	uint32                        _baseWidth, _baseHeight;
 
@@ -0,0 +1,224 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egProfiler.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+std::atomic< bool > Profiler::_enabled( false );
+std::atomic< uint32 > Profiler::_frame( 0 );
+
+// *************************************************************************************************
+// Thread buffers
+// *************************************************************************************************
+
+namespace {
+
+struct ProfThreadBuffer
+{
+	ProfZone               zones[ProfilerZonesPerThread];
+	std::atomic< uint32 >  writeCount;  // Total number of zones written, wraps around
+	bool                   inUse;
+
+	ProfThreadBuffer() : writeCount( 0 ), inUse( true ) {}
+};
+
+// Buffers live until the process exits so that the zones of finished threads can still be saved;
+// the buffer of a finished thread is reused by the next new thread
+struct ProfRegistry
+{
+	std::mutex                                        mutex;
+	std::vector< std::unique_ptr< ProfThreadBuffer > >  buffers;
+};
+
+ProfRegistry &getRegistry()
+{
+	static ProfRegistry registry;
+	return registry;
+}
+
+struct ProfThreadHandle
+{
+	ProfThreadBuffer  *buffer;
+
+	ProfThreadHandle() : buffer( 0x0 ) {}
+	~ProfThreadHandle()
+	{
+		if( buffer == 0x0 ) return;
+
+		lock_guard< mutex > lock( getRegistry().mutex );
+		buffer->inUse = false;
+	}
+};
+
+thread_local ProfThreadHandle threadHandle;
+
+
+ProfThreadBuffer *acquireThreadBuffer()
+{
+	ProfRegistry &registry = getRegistry();
+	lock_guard< mutex > lock( registry.mutex );
+
+	for( size_t i = 0; i < registry.buffers.size(); ++i )
+	{
+		if( !registry.buffers[i]->inUse )
+		{
+			registry.buffers[i]->inUse = true;
+			return registry.buffers[i].get();
+		}
+	}
+
+	registry.buffers.push_back( unique_ptr< ProfThreadBuffer >( new ProfThreadBuffer() ) );
+	return registry.buffers.back().get();
+}
+
+
+void writeEscaped( FILE *f, const char *str )
+{
+	for( ; *str != '\0'; ++str )
+	{
+		if( *str == '"' || *str == '\\' ) fputc( '\\', f );
+		if( (unsigned char)*str >= 0x20 ) fputc( *str, f );
+	}
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+// Class Profiler
+// *************************************************************************************************
+
+int64 Profiler::getTime()
+{
+	return chrono::duration_cast< chrono::nanoseconds >(
+		chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+void Profiler::addZone( const char *name, int64 begin, int64 end )
+{
+	ProfThreadBuffer *buf = threadHandle.buffer;
+	if( buf == 0x0 ) buf = threadHandle.buffer = acquireThreadBuffer();
+
+	// Only the owning thread writes to the buffer, so the slot can be filled before publishing it
+	uint32 count = buf->writeCount.load( memory_order_relaxed );
+	ProfZone &zone = buf->zones[count & (ProfilerZonesPerThread - 1)];
+	zone.name = name;
+	zone.begin = begin;
+	zone.end = end;
+	zone.frame = _frame.load( memory_order_relaxed );
+	buf->writeCount.store( count + 1, memory_order_release );
+}
+
+
+bool Profiler::saveTrace( const char *fileName, int numFrames )
+{
+	if( fileName == 0x0 || numFrames <= 0 ) return false;
+
+	uint32 lastFrame = getFrame();
+	uint32 firstFrame = lastFrame - std::min( (uint32)numFrames, lastFrame );
+
+	// Copy the zones of the requested frames; threads can continue recording while doing so
+	vector< vector< ProfZone > > threadZones;
+	{
+		ProfRegistry &registry = getRegistry();
+		lock_guard< mutex > lock( registry.mutex );
+
+		threadZones.resize( registry.buffers.size() );
+		for( size_t i = 0; i < registry.buffers.size(); ++i )
+		{
+			ProfThreadBuffer &buf = *registry.buffers[i];
+			uint32 end = buf.writeCount.load( memory_order_acquire );
+			uint32 begin = end - std::min( end, ProfilerZonesPerThread );
+
+			vector< ProfZone > &zones = threadZones[i];
+			zones.reserve( end - begin );
+			for( uint32 j = begin; j != end; ++j )
+				zones.push_back( buf.zones[j & (ProfilerZonesPerThread - 1)] );
+
+			// Discard zones that may have been overwritten by the owning thread during the copy;
+			// a zone that is still being written replaces one more slot
+			uint32 numWritten = buf.writeCount.load( memory_order_acquire ) - end;
+			int64 numOverwritten = (int64)numWritten + 1 - (ProfilerZonesPerThread - (end - begin));
+			numOverwritten = std::max( std::min( numOverwritten, (int64)zones.size() ), (int64)0 );
+			zones.erase( zones.begin(), zones.begin() + (size_t)numOverwritten );
+
+			zones.erase( remove_if( zones.begin(), zones.end(), [=]( const ProfZone &zone )
+				{ return zone.frame < firstFrame || zone.frame >= lastFrame; } ), zones.end() );
+		}
+	}
+
+	int64 timeBase = -1;
+	for( size_t i = 0; i < threadZones.size(); ++i )
+	{
+		for( size_t j = 0; j < threadZones[i].size(); ++j )
+		{
+			if( timeBase < 0 || threadZones[i][j].begin < timeBase ) timeBase = threadZones[i][j].begin;
+		}
+	}
+
+	FILE *f = fopen( fileName, "w" );
+	if( f == 0x0 ) return false;
+
+	fprintf( f, "{\"traceEvents\":[\n" );
+	bool first = true;
+	for( size_t i = 0; i < threadZones.size(); ++i )
+	{
+		if( threadZones[i].empty() ) continue;
+
+		fprintf( f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+		         first ? "" : ",\n", (uint32)i, (uint32)i );
+		first = false;
+
+		for( size_t j = 0; j < threadZones[i].size(); ++j )
+		{
+			const ProfZone &zone = threadZones[i][j];
+
+			fprintf( f, ",\n{\"name\":\"" );
+			writeEscaped( f, zone.name );
+			fprintf( f, "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%u}}",
+			         (zone.begin - timeBase) / 1000.0, (zone.end - zone.begin) / 1000.0, (uint32)i, zone.frame );
+		}
+	}
+	fprintf( f, "\n]}\n" );
+
+	bool result = ferror( f ) == 0;
+	fclose( f );
+
+	return result;
+}
+
+
+void Profiler::release()
+{
+	setEnabled( false );
+	_frame.store( 0, memory_order_relaxed );
+
+	ProfRegistry &registry = getRegistry();
+	lock_guard< mutex > lock( registry.mutex );
+	for( size_t i = 0; i < registry.buffers.size(); ++i )
+		registry.buffers[i]->writeCount.store( 0, memory_order_relaxed );
+}
+
+}  // namespace
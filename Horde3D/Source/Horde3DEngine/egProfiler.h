@@ -0,0 +1,100 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egProfiler_H_
+#define _egProfiler_H_
+
+#include "egPrerequisites.h"
+#include <atomic>
+
+
+namespace Horde3D {
+
+// Number of zones kept per thread; older zones are overwritten (must be a power of two)
+const uint32 ProfilerZonesPerThread = 65536;
+
+// =================================================================================================
+// Profiler
+// =================================================================================================
+
+// A zone is a named time span on one thread. Zones are recorded into a ring buffer per thread
+// without locking, so they can be used in worker threads as well. Nesting is given implicitly by
+// the time spans of the zones on the same thread.
+struct ProfZone
+{
+	const char  *name;   // Must point to a string with static lifetime
+	int64       begin;   // In ns
+	int64       end;
+	uint32      frame;
+};
+
+// =================================================================================================
+
+class Profiler
+{
+public:
+	static void setEnabled( bool enabled ) { _enabled.store( enabled, std::memory_order_relaxed ); }
+	static bool isEnabled() { return _enabled.load( std::memory_order_relaxed ); }
+
+	// Marks the end of the current frame; zones are tagged with the frame in which they ended
+	static void nextFrame() { _frame.fetch_add( 1, std::memory_order_relaxed ); }
+	static uint32 getFrame() { return _frame.load( std::memory_order_relaxed ); }
+
+	static int64 getTime();
+	static void addZone( const char *name, int64 begin, int64 end );
+
+	// Writes the zones of the last numFrames completed frames in the Chrome trace event format
+	// which can be viewed with chrome://tracing or Perfetto
+	static bool saveTrace( const char *fileName, int numFrames );
+
+	// Discards all recorded zones and disables the profiler
+	static void release();
+
+private:
+	static std::atomic< bool >    _enabled;
+	static std::atomic< uint32 >  _frame;
+};
+
+// =================================================================================================
+
+class ProfSample
+{
+public:
+	ProfSample( const char *name ) :
+		_name( name ), _begin( Profiler::isEnabled() ? Profiler::getTime() : -1 )
+	{
+	}
+
+	~ProfSample()
+	{
+		if( _begin >= 0 ) Profiler::addZone( _name, _begin, Profiler::getTime() );
+	}
+
+private:
+	const char  *_name;
+	int64       _begin;
+};
+
+}
+
+
+#define H3D_PROFILE_CONCAT2( a, b ) a##b
+#define H3D_PROFILE_CONCAT( a, b ) H3D_PROFILE_CONCAT2( a, b )
+
+// Records the remainder of the enclosing scope as zone; name must be a string with static lifetime
+#ifdef H3D_PROFILER
+#	define H3D_PROFILE_ZONE( name ) Horde3D::ProfSample H3D_PROFILE_CONCAT( _profSample, __LINE__ )( name )
+#else
+#	define H3D_PROFILE_ZONE( name )
+#endif
+
+#endif // _egProfiler_H_
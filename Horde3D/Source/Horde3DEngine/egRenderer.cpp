@@ -17,6 +17,8 @@
 #include "egModules.h"
 #include "egCom.h"
 #include "egComputeNode.h"
+#include "egProfiler.h"
+#include "utImageProc.h"
 #include <cstring>
 
 #include "utDebug.h"
@@ -31,9 +33,11 @@
 #else
 #	include "egRendererBaseGLES3.h"
 #endif
+#include "egRendererBaseNull.h"
 
 // Constants
 constexpr int defaultCameraView = 0;
+constexpr uint32 OcclusionBufferWidth = 256;
 
 namespace Horde3D {
 
@@ -56,6 +60,7 @@ Renderer::Renderer()
 	_maxAnisoMask = 0;
 	_smSize = 0;
 	_shadowRB = 0;
+	_curShadowRB = 0;
 	_vlPosOnly = 0;
 	_vlModel = 0;
 	_vlParticle = 0;
@@ -66,6 +71,11 @@ Renderer::Renderer()
 	_coneGeo = 0;
 	_FSPolyGeo = 0;
 
+	_clusterLightTex = _clusterGridTex = _clusterIndexTex = 0;
+	_clusterFrameID = 0;
+	_clusterCamera = 0x0;
+	for( uint32 i = 0; i < 4; ++i ) _clusterTileParams[i] = _clusterDepthParams[i] = 0;
+
 	// reserve memory for occlusion culling proxies
 	_occProxies[ 0 ].reserve( 200 ); // meshes
 	_occProxies[ 1 ].reserve( 100 ); // lights
@@ -106,6 +116,10 @@ Renderer::Renderer()
 	_uni.shadowMapSize = registerEngineUniform( "shadowMapSize" );
 	_uni.shadowBias = registerEngineUniform( "shadowBias" );
 
+	// Clustered lighting uniforms
+	_uni.clusterTileParams = registerEngineUniform( "clusterTileParams" );
+	_uni.clusterDepthParams = registerEngineUniform( "clusterDepthParams" );
+
 	// Particle-specific uniforms
 	_uni.parPosArray = registerEngineUniform( "parPosArray" );
 	_uni.parSizeAndRotArray = registerEngineUniform( "parSizeAndRotArray" );
@@ -120,7 +134,11 @@ Renderer::~Renderer()
 	if ( _renderDevice )
 	{
 		releaseShadowRB();
+		releaseShadowCache();
 		_renderDevice->destroyTexture( _defShadowMap );
+		_renderDevice->destroyTexture( _clusterLightTex );
+		_renderDevice->destroyTexture( _clusterGridTex );
+		_renderDevice->destroyTexture( _clusterIndexTex );
 		releaseShaderComb( _defColorShader );
 
 		_renderDevice->destroyGeometry( _particleGeo );
@@ -145,6 +163,17 @@ void Renderer::registerRenderFunc( int nodeType, RenderFunc rf )
 	RenderFuncListItem item;
 	item.nodeType = nodeType;
 	item.renderFunc = rf;
+	item.renderFuncID = 0x0;
+	_renderFuncRegistry.push_back( item );
+}
+
+
+void Renderer::registerRenderFunc( int nodeType, RenderFuncID rf )
+{
+	RenderFuncListItem item;
+	item.nodeType = nodeType;
+	item.renderFunc = 0x0;
+	item.renderFuncID = rf;
 	_renderFuncRegistry.push_back( item );
 }
 
@@ -348,6 +377,10 @@ RenderDeviceInterface *Renderer::createRenderDevice( int type )
 			return new RDI_GLES3::RenderDeviceGLES3();
 		}
 #endif
+		case RenderBackendType::Null:
+		{
+			return new RDI_Null::RenderDeviceNull();
+		}
 		default:
 			Modules::log().writeError( "Incorrect render interface type or type not specified. Renderer cannot be initialized." );
 			break;
@@ -533,6 +566,8 @@ void Renderer::drawCone( float height, float radius, const Matrix4f &transMat )
 
 void Renderer::prepareRenderViews()
 {
+	H3D_PROFILE_ZONE( "Renderer::prepareRenderViews" );
+
 	SceneManager &scm = Modules::sceneMan();
 
 	Timer *timer = Modules::stats().getTimer( EngineStats::CullingTime );
@@ -548,27 +583,38 @@ void Renderer::prepareRenderViews()
 	//
 	// Step 1. Add views for camera and lights based on their frustums
 	//
-	scm.addRenderView( RenderViewType::Camera, _curCamera, _curCamera->getFrustum() );
-
-	SceneNode *node = nullptr;
-	for ( size_t i = 0; i < scm._nodes.size(); ++i )
 	{
-		node = scm._nodes[ i ];
-		if ( !node || node->_type != SceneNodeTypes::Light ) continue;
+		H3D_PROFILE_ZONE( "Renderer::prepareRenderViews/Step1" );
 
-		// Ignore lights that do not cross the camera frustum and are disabled
-		LightNode *light = ( LightNode * ) node;
-		if ( _curCamera->getFrustum().cullFrustum( light->getFrustum() ) || light->_flags & SceneNodeFlags::NoDraw ) continue;
+		scm.addRenderView( RenderViewType::Camera, _curCamera, _curCamera->getFrustum() );
 
-		// Light is in current camera view, so add it as a render view 
-		// Light's view should be culled with the camera frustum, so link the camera view
-		// Also, for shadows we have to cull additional objects that do not cast shadows
-		light->_renderViewID = scm.addRenderView( RenderViewType::Light, light, light->getFrustum(), 
-												  defaultCameraView, SceneNodeFlags::NoCastShadow );
+		SceneNode *node = nullptr;
+		for ( size_t i = 0; i < scm._nodes.size(); ++i )
+		{
+			node = scm._nodes[ i ];
+			if ( !node || node->_type != SceneNodeTypes::Light ) continue;
+
+			// Ignore lights that do not cross the camera frustum and are disabled
+			LightNode *light = ( LightNode * ) node;
+			if ( _curCamera->getFrustum().cullFrustum( light->getFrustum() ) || light->_flags & SceneNodeFlags::NoDraw ) continue;
+
+			// Light is in current camera view, so add it as a render view 
+			// Light's view should be culled with the camera frustum, so link the camera view
+			// Also, for shadows we have to cull additional objects that do not cast shadows
+			light->_renderViewID = scm.addRenderView( RenderViewType::Light, light, light->getFrustum(), 
+													  defaultCameraView, SceneNodeFlags::NoCastShadow );
+		}
+
+		// Generate render queue for camera and lights
+		scm.updateQueues( SceneNodeFlags::NoDraw );
 	}
 
-	// Generate render queue for camera and lights
-	scm.updateQueues( SceneNodeFlags::NoDraw );
+	// Remove objects hidden behind occluders; shadow views are created later and are not affected
+	if( Modules::config().softwareOcclusion )
+	{
+		H3D_PROFILE_ZONE( "Renderer::cullOccludedObjects" );
+		cullOccludedObjects();
+	}
 
 	//
 	// Step 2. Create temporary crop shadow frustums that are used for creating tighter shadow frustums to increase shadow quality
@@ -576,47 +622,128 @@ void Renderer::prepareRenderViews()
 	auto &views = scm.getRenderViews(); auto count = scm.getActiveRenderViewCount();
 	int shadowViewStartID = count;
 	int processedLightsCount = 0;
-	for ( size_t i = 0; i < count; ++i )
 	{
-		RenderView *view = &views[ i ];
-		if ( view->type != RenderViewType::Light ) continue;
+		H3D_PROFILE_ZONE( "Renderer::prepareRenderViews/Step2" );
 
-		// Skip lights that do not produce shadows
-		LightNode *light = ( LightNode * ) view->node;
-		if ( light->_shadowMapCount == 0 ) continue;
+		for ( size_t i = 0; i < count; ++i )
+		{
+			RenderView *view = &views[ i ];
+			if ( view->type != RenderViewType::Light ) continue;
 
-		// Calculate temporary crop shadow frustums
-		// We need to send AABB with only shadow casting objects
-		light->_shadowRenderParamsID = prepareCropFrustum( light, view->auxObjectsAABB );
-		processedLightsCount++;
-	}
+			// Skip lights that do not produce shadows
+			LightNode *light = ( LightNode * ) view->node;
+			if ( light->_shadowMapCount == 0 ) continue;
 
-	// Prepare render queues for crop frustums
-	scm.updateQueues( SceneNodeFlags::NoDraw | SceneNodeFlags::NoCastShadow );
+			// Calculate temporary crop shadow frustums
+			// We need to send AABB with only shadow casting objects
+			light->_shadowRenderParamsID = prepareCropFrustum( light, view->auxObjectsAABB );
+			processedLightsCount++;
+		}
+
+		// Prepare render queues for crop frustums
+		scm.updateQueues( SceneNodeFlags::NoDraw | SceneNodeFlags::NoCastShadow );
+	}
 
 	//
 	// Step 3. Calculate final shadow frustums
 	//
-
-	// Generate shadow frustums and their render queues
-	int start = shadowViewStartID;
-	for ( int i = 0; i < processedLightsCount; ++i )
 	{
-		RenderView *view = &views[ start + i ];
-		if ( view->type != RenderViewType::Shadow ) continue;
+		H3D_PROFILE_ZONE( "Renderer::prepareRenderViews/Step3" );
+
+		// Generate shadow frustums and their render queues
+		int start = shadowViewStartID;
+		for ( int i = 0; i < processedLightsCount; ++i )
+		{
+			RenderView *view = &views[ start + i ];
+			if ( view->type != RenderViewType::Shadow ) continue;
 
-		LightNode *light = ( LightNode * ) view->node;
+			LightNode *light = ( LightNode * ) view->node;
 
-		prepareShadowMapFrustum( light, start + i );
-		start += light->_shadowMapCount;
+			prepareShadowMapFrustum( light, start + i );
+			start += light->_shadowMapCount;
+		}
+
+		// Shadow frustums are ready, prepare render queues for them
+		scm.updateQueues( SceneNodeFlags::NoDraw | SceneNodeFlags::NoCastShadow );
 	}
 
-	// Shadow frustums are ready, prepare render queues for them
-	scm.updateQueues( SceneNodeFlags::NoDraw | SceneNodeFlags::NoCastShadow );
+	for( size_t i = 0, s = scm.getActiveRenderViewCount(); i < s; ++i )
+		Modules::stats().addRenderView( (uint32)views[i].objects.size() );
 
 	timer->setEnabled( false );
 }
 
+
+void Renderer::cullOccludedObjects()
+{
+	SceneManager &scm = Modules::sceneMan();
+	auto &views = scm.getRenderViews();
+	RenderView &camView = views[ defaultCameraView ];
+
+	// Resolution of the buffer follows the aspect ratio of the viewport
+	float aspect = (float)_curCamera->_vpHeight / (float)std::max( _curCamera->_vpWidth, 1 );
+	_occBuffer.resize( OcclusionBufferWidth, (uint32)clamp( OcclusionBufferWidth * aspect, 16.0f, 512.0f ) );
+	_occBuffer.clear( _curCamera->getProjMat() * _curCamera->getViewMat() );
+
+	// Rasterize occluders, which do not have to be drawn themselves, e.g. low-poly proxy meshes
+	Vec3f camPos( _curCamera->_absTrans.c[3][0], _curCamera->_absTrans.c[3][1], _curCamera->_absTrans.c[3][2] );
+	for( size_t i = 0, s = scm._nodes.size(); i < s; ++i )
+	{
+		SceneNode *node = scm._nodes[ i ];
+		if( node == 0x0 || node->_type != SceneNodeTypes::Mesh || !(node->_flags & SceneNodeFlags::Occluder) ) continue;
+
+		MeshNode *mesh = (MeshNode *)node;
+		ModelNode *model = mesh->_parentModel;
+		if( model == 0x0 || camView.frustum.cullBox( mesh->_bBox ) ) continue;
+		if( !mesh->checkLodCorrectness( mesh->calcLodLevel( camPos ) ) ) continue;
+		
+		// Vertex data of hardware skinned meshes does not match the rendered pose
+		if( !model->_jointList.empty() && !model->_softwareSkinning ) continue;
+
+		GeometryResource *geoRes = model->getGeometryResource();
+		if( geoRes == 0x0 || geoRes->getIndexData() == 0x0 || geoRes->getVertPosData() == 0x0 ) continue;
+
+		_occBuffer.rasterizeTriangles( mesh->_absTrans, geoRes->getVertPosData(), mesh->_vertRStart, mesh->_vertREnd,
+		                               geoRes->getIndexData(), geoRes->_16BitIndices, mesh->_batchStart, mesh->_batchCount );
+	}
+	if( _occBuffer.getRasterizedTriCount() == 0 ) return;
+
+	// Test camera view objects
+	_occludedNodes.resize( 0 );
+	RenderQueue &objects = camView.objects;
+	size_t numVisible = 0;
+	camView.objectsAABB.clear();
+	for( size_t i = 0; i < objects.size(); ++i )
+	{
+		SceneNode *node = objects[ i ].node;
+		if( !_occBuffer.testBox( node->_bBox.min, node->_bBox.max ) )
+		{
+			_occludedNodes.push_back( node );
+			continue;
+		}
+
+		camView.objectsAABB.makeUnion( node->_bBox );
+		objects[ numVisible++ ] = objects[ i ];
+	}
+	objects.resize( numVisible );
+	
+	Modules::stats().incStat( EngineStats::OcclusionCulledCount, (float)_occludedNodes.size() );
+	if( _occludedNodes.empty() ) return;
+
+	// Light views are culled with the camera frustum, so their objects are a subset of the camera
+	// objects; the shadow caster bounds are kept since occluded objects can still cast visible shadows
+	std::sort( _occludedNodes.begin(), _occludedNodes.end() );
+	for( size_t i = 0, count = scm.getActiveRenderViewCount(); i < count; ++i )
+	{
+		RenderView &view = views[ i ];
+		if( view.type != RenderViewType::Light ) continue;
+
+		RenderQueue &lightObjects = view.objects;
+		lightObjects.erase( std::remove_if( lightObjects.begin(), lightObjects.end(), [this]( const RenderQueueItem &item )
+			{ return std::binary_search( _occludedNodes.begin(), _occludedNodes.end(), item.node ); } ), lightObjects.end() );
+	}
+}
+
 // =================================================================================================
 // Material System
 // =================================================================================================
@@ -628,12 +755,35 @@ bool Renderer::createShaderComb( ShaderCombination &sc, const char *vertexShader
 	uint32 shdObj = _renderDevice->createShader( vertexShader, fragmentShader, geometryShader, tessControlShader, tessEvaluationShader, computeShader );
 	if( shdObj == 0 ) return false;
 	
+	setupShaderComb( sc, shdObj );
+	return true;
+}
+
+
+bool Renderer::createShaderCombFromBinary( ShaderCombination &sc, uint32 binaryFormat, const void *data, uint32 size )
+{
+	uint32 shdObj = _renderDevice->createShaderFromBinary( binaryFormat, data, size );
+	if( shdObj == 0 ) return false;
+
+	setupShaderComb( sc, shdObj );
+	return true;
+}
+
+
+void Renderer::setupShaderComb( ShaderCombination &sc, uint32 shdObj )
+{
 	sc.shaderObj = shdObj;
 	_renderDevice->bindShader( shdObj );
 	
 	// Set standard uniforms
 	int loc =_renderDevice-> getShaderSamplerLoc( shdObj, "shadowMap" );
 	if( loc >= 0 ) _renderDevice->setShaderSampler( loc, 12 );
+	loc = _renderDevice->getShaderSamplerLoc( shdObj, "clusterLightMap" );
+	if( loc >= 0 ) _renderDevice->setShaderSampler( loc, 13 );
+	loc = _renderDevice->getShaderSamplerLoc( shdObj, "clusterGridMap" );
+	if( loc >= 0 ) _renderDevice->setShaderSampler( loc, 14 );
+	loc = _renderDevice->getShaderSamplerLoc( shdObj, "clusterIndexMap" );
+	if( loc >= 0 ) _renderDevice->setShaderSampler( loc, 15 );
 
 	sc.uniLocs.reserve( _engineUniforms.size() );
 
@@ -676,7 +826,6 @@ bool Renderer::createShaderComb( ShaderCombination &sc, const char *vertexShader
 // 	
 // 	// Uniforms, requested by extensions
 
-	return true;
 }
 
 
@@ -729,6 +878,13 @@ void Renderer::commitGeneralUniforms()
 		
 		if( _curShader->uniLocs[ _uni.viewerPos ] >= 0 )
 			_renderDevice->setShaderConst( _curShader->uniLocs[ _uni.viewerPos ], CONST_FLOAT3, &_viewMatInv.x[12] );
+
+		// Clustered lighting params
+		if( _curShader->uniLocs[ _uni.clusterTileParams ] >= 0 )
+			_renderDevice->setShaderConst( _curShader->uniLocs[ _uni.clusterTileParams ], CONST_FLOAT4, _clusterTileParams );
+
+		if( _curShader->uniLocs[ _uni.clusterDepthParams ] >= 0 )
+			_renderDevice->setShaderConst( _curShader->uniLocs[ _uni.clusterDepthParams ], CONST_FLOAT4, _clusterDepthParams );
 		
 		// Light params
 		if( _curLight != 0x0 )
@@ -771,7 +927,7 @@ void Renderer::commitGeneralUniforms()
 }
 
 
-bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shaderContext,
+bool Renderer::setMaterialRec( MaterialResource *materialRes, int shaderContextID,
                                ShaderResource *shaderRes )
 {
 	if( materialRes == 0x0 ) return false;
@@ -786,7 +942,7 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 		if( shaderRes == 0x0 ) return false;	
 	
 		// Find context
-		ShaderContext *context = shaderRes->findContext( shaderContext );
+		ShaderContext *context = shaderRes->findContext( shaderContextID );
 		if( context == 0x0 ) return false;
 		
 		// Set shader combination
@@ -962,23 +1118,25 @@ bool Renderer::setMaterialRec( MaterialResource *materialRes, const string &shad
 	{
 		// Handle link of stage
 		if( _curStageMatLink != 0x0 && _curStageMatLink != materialRes )
-			result &= setMaterialRec( _curStageMatLink, shaderContext, shaderRes );
+			result &= setMaterialRec( _curStageMatLink, shaderContextID, shaderRes );
 
 		// Handle material of light source
 		if( _curLight != 0x0 && _curLight->_materialRes != 0x0 && _curLight->_materialRes != materialRes )
-			result &= setMaterialRec( _curLight->_materialRes, shaderContext, shaderRes );
+			result &= setMaterialRec( _curLight->_materialRes, shaderContextID, shaderRes );
 	}
 
 	// Handle link of material resource
 	if( materialRes->_matLink != 0x0 )
-		result &= setMaterialRec( materialRes->_matLink, shaderContext, shaderRes );
+		result &= setMaterialRec( materialRes->_matLink, shaderContextID, shaderRes );
 
 	return result;
 }
 
 
-bool Renderer::setMaterial( MaterialResource *materialRes, const string &shaderContext )
+bool Renderer::setMaterial( MaterialResource *materialRes, int shaderContextID )
 {
+	H3D_PROFILE_ZONE( "Renderer::setMaterial" );
+
 	if( materialRes == 0x0 )
 	{	
 		setShaderComb( 0x0 );
@@ -990,16 +1148,24 @@ bool Renderer::setMaterial( MaterialResource *materialRes, const string &shaderC
 		return false;
 	}
 
-	if( !setMaterialRec( materialRes, shaderContext, 0x0 ) )
+	if( !setMaterialRec( materialRes, shaderContextID, 0x0 ) )
 	{
 		_curShader = 0x0;
 		return false;
 	}
 
+	Modules::stats().incStat( EngineStats::MaterialBindCount, 1 );
 	return true;
 }
 
 
+bool Renderer::setMaterial( MaterialResource *materialRes, const string &shaderContext )
+{
+	// Unknown names are not interned, since no shader can have a context with that name
+	return setMaterial( materialRes, ShaderResource::findContextID( shaderContext ) );
+}
+
+
 // =================================================================================================
 // Shadowing
 // =================================================================================================
@@ -1018,6 +1184,18 @@ void Renderer::releaseShadowRB()
 }
 
 
+void Renderer::releaseShadowCache()
+{
+	if( _renderDevice )
+	{
+		for( size_t i = 0, s = _shadowCache.size(); i < s; ++i )
+			_renderDevice->destroyRenderBuffer( _shadowCache[ i ].renderBuffer );
+	}
+	_shadowCache.clear();
+	_curShadowRB = _shadowRB;
+}
+
+
 void Renderer::setupShadowMap( bool noShadows )
 {
 	uint32 sampState = SS_FILTER_BILINEAR | SS_ANISO1 | SS_ADDR_CLAMPCOL | SS_COMP_LEQUAL;
@@ -1025,7 +1203,7 @@ void Renderer::setupShadowMap( bool noShadows )
 	// Bind shadow map
 	if( !noShadows && _curLight->_shadowMapCount > 0 )
 	{
-		_renderDevice->setTexture( 12, _renderDevice->getRenderBufferTex( _shadowRB, 32 ), sampState, TextureUsage::Texture );
+		_renderDevice->setTexture( 12, _renderDevice->getRenderBufferTex( _curShadowRB, 32 ), sampState, TextureUsage::Texture );
 		_smSize = (float)Modules::config().shadowMapSize;
 	}
 	else
@@ -1245,62 +1423,190 @@ bool Renderer::prepareShadowMapFrustum( const LightNode *light, int shadowView )
 }
 
 
-void Renderer::updateShadowMap()
+static uint64 hashResource( const Resource *res, uint64 hash )
 {
-	if ( _curLight == 0x0 || _curLight->_shadowRenderParamsID == -1 ) return;
+	hash = ImageProc::hash( &res, sizeof( res ), hash );
+	if( res == 0x0 ) return hash;
+	uint32 stamp = res->getUpdateStamp();
+	return ImageProc::hash( &stamp, sizeof( stamp ), hash );
+}
 
-	uint32 prevRendBuf = _renderDevice->_curRendBuf;
-	int prevVPX = _renderDevice->_vpX, prevVPY = _renderDevice->_vpY, prevVPWidth = _renderDevice->_vpWidth, prevVPHeight = _renderDevice->_vpHeight;
 
-	int shadowRTWidth, shadowRTHeight;
-	_renderDevice->getRenderBufferDimensions( _shadowRB, &shadowRTWidth, &shadowRTHeight );
+uint64 Renderer::hashMeshResources( const MeshNode *mesh, uint64 hash )
+{
+	hash = hashResource( mesh->getParentModel()->getGeometryResource(), hash );
+	for( const MaterialResource *matRes = mesh->getMaterialRes(); matRes != 0x0; matRes = matRes->_matLink )
+	{
+		hash = hashResource( matRes, hash );
+		hash = hashResource( matRes->_shaderRes.getPtr(), hash );
+	}
 
-	_renderDevice->setViewport( 0, 0, shadowRTWidth, shadowRTHeight );
-	_renderDevice->setRenderBuffer( _shadowRB );
+	return hash;
+}
 
-	_renderDevice->setColorWriteMask( false );
-	_renderDevice->setDepthMask( true );
-	_renderDevice->clear( CLR_DEPTH, 0x0, 1.f );
 
-	// ********************************************************************************************
-	// Cascaded Shadow Maps
-	// ********************************************************************************************
+bool Renderer::acquireCachedShadowMap( const ShadowParameters &params )
+{
+	// Returns true if the shadow map in _curShadowRB is still valid for the current light
+	_curShadowRB = _shadowRB;
+	uint32 cacheSize = (uint32)Modules::config().shadowMapCacheSize;
+	if( cacheSize == 0 ) return false;
+
+	ShadowMapCacheEntry *entry = 0x0;
+	for( size_t i = 0, s = _shadowCache.size(); i < s; ++i )
+	{
+		if( _shadowCache[ i ].light == _curLight->_handle )
+		{
+			entry = &_shadowCache[ i ];
+			break;
+		}
+	}
+
+	if( entry == 0x0 )
+	{
+		if( _shadowCache.size() < cacheSize )
+		{
+			int size = Modules::config().shadowMapSize;
+			uint32 rb = _renderDevice->createRenderBuffer( size, size, TextureFormats::BGRA8, true, 0, 0, 0 );
+			if( rb == 0 ) return false;
+
+			_shadowCache.push_back( ShadowMapCacheEntry() );
+			entry = &_shadowCache.back();
+			entry->renderBuffer = rb;
+		}
+		else
+		{
+			// Take over least recently used map; maps used in the current frame are kept to avoid thrashing
+			for( size_t i = 0, s = _shadowCache.size(); i < s; ++i )
+			{
+				if( _shadowCache[ i ].lastUsedFrame == _frameID ) continue;
+				if( entry == 0x0 || _shadowCache[ i ].lastUsedFrame < entry->lastUsedFrame )
+					entry = &_shadowCache[ i ];
+			}
+			if( entry == 0x0 ) return false;
+		}
+
+		entry->light = _curLight->_handle;
+		entry->valid = false;
+	}
+
+	entry->lastUsedFrame = _frameID;
+	_curShadowRB = entry->renderBuffer;
+
+	// Casters are identified by their update stamps, which change when a node is moved or animated;
+	// the stamps of the geometry, material and shader resources cover changes of the drawn data
+	uint64 casterHash = ImageProc::hash( 0x0, 0 );
+	for( uint32 i = 0; i < _curLight->_shadowMapCount; ++i )
+	{
+		RenderQueue &casters = Modules::sceneMan().getRenderViews()[ params.viewID[ i ] ].objects;
+		uint32 count = (uint32)casters.size();
+		casterHash = ImageProc::hash( &count, sizeof( count ), casterHash );
+
+		for( size_t j = 0; j < count; ++j )
+		{
+			const SceneNode *node = casters[ j ].node;
+			casterHash = ImageProc::hash( &node, sizeof( node ), casterHash );
+			casterHash = ImageProc::hash( &node->_updateStamp, sizeof( node->_updateStamp ), casterHash );
+			if( casters[ j ].type == SceneNodeTypes::Mesh ) casterHash = hashMeshResources( (MeshNode *)node, casterHash );
+		}
+	}
+
+	Vec4f lightPos( _curLight->_absPos.x, _curLight->_absPos.y, _curLight->_absPos.z, _curLight->_radius );
+	bool upToDate = entry->valid && entry->casterHash == casterHash && entry->mapCount == _curLight->_shadowMapCount &&
+	                entry->bias == _curLight->_shadowMapBias && entry->contextID == _curLight->_shadowContextID &&
+	                memcmp( &entry->lightPos, &lightPos, sizeof( Vec4f ) ) == 0 &&
+	                memcmp( entry->lightMats, params.lightMats, sizeof( Matrix4f ) * _curLight->_shadowMapCount ) == 0;
+	if( upToDate ) return true;
+
+	entry->valid = true;
+	entry->casterHash = casterHash;
+	entry->mapCount = _curLight->_shadowMapCount;
+	entry->bias = _curLight->_shadowMapBias;
+	entry->contextID = _curLight->_shadowContextID;
+	entry->lightPos = lightPos;
+	memcpy( entry->lightMats, params.lightMats, sizeof( Matrix4f ) * _curLight->_shadowMapCount );
+
+	return false;
+}
+
+
+void Renderer::updateShadowMap()
+{
+	if ( _curLight == 0x0 || _curLight->_shadowRenderParamsID == -1 ) return;
 
-	// Prepare shadow map rendering
-	_renderDevice->setDepthTest( true );
-	//_renderDevice->setCullMode( RS_CULL_FRONT );	// Front face culling reduces artefacts but produces more "peter-panning"
-	
 	const uint32 numMaps = _curLight->_shadowMapCount;
 	ShadowParameters &params = _shadowParams[ _curLight->_shadowRenderParamsID ];
 
 	// Copy split planes so that it is passed to shader on material setting
 	for ( uint32 i = 0; i < 5; ++i ) _splitPlanes[ i ] = params.splitPlanes[ i ];
 
-	// Split viewing frustum into slices and render shadow maps
+	// Select quadrants of shadow map if several splits are enabled
+	const int hsm = Modules::config().shadowMapSize / 2;
+	const int scissorXY[ 8 ] = { 0, 0,  hsm, 0,  hsm, hsm,  0, hsm };
+	const float transXY[ 8 ] = { -0.5f, -0.5f,  0.5f, -0.5f,  0.5f, 0.5f,  -0.5f, 0.5f };
+
 	for ( uint32 i = 0; i < numMaps; ++i )
 	{
-		// Create texture atlas if several splits are enabled
 		if ( numMaps > 1 )
 		{
-			const int hsm = Modules::config().shadowMapSize / 2;
-			const int scissorXY[ 8 ] = { 0, 0,  hsm, 0,  hsm, hsm,  0, hsm };
-			const float transXY[ 8 ] = { -0.5f, -0.5f,  0.5f, -0.5f,  0.5f, 0.5f,  -0.5f, 0.5f };
-
-			_renderDevice->setScissorTest( true );
-
-			// Select quadrant of shadow map
 			params.lightProjMatrix[ i ].scale( 0.5f, 0.5f, 1.0f );
 			params.lightProjMatrix[ i ].translate( transXY[ i * 2 ], transXY[ i * 2 + 1 ], 0.0f );
-			_renderDevice->setScissorRect( scissorXY[ i * 2 ], scissorXY[ i * 2 + 1 ], hsm, hsm );
 		}
-
 		_lightMats[ i ] = params.lightProjMatrix[ i ] * _curLight->getViewMat();
-		setupViewMatrices( _curLight->getViewMat(), params.lightProjMatrix[ i ] );
+	}
 
-		// Render
-		Modules::sceneMan().setCurrentView( params.viewID[ i ] );
-		Frustum &f = Modules::sceneMan().getRenderViews()[ params.viewID[ i ] ].frustum;
-		drawRenderables( _curLight->_shadowContext, 0, false, &f, 0x0, RenderingOrder::None, -1 );
+	// Render shadow map unless a cached one can be reused
+	if ( !acquireCachedShadowMap( params ) )
+	{
+		uint32 prevRendBuf = _renderDevice->_curRendBuf;
+		int prevVPX = _renderDevice->_vpX, prevVPY = _renderDevice->_vpY, prevVPWidth = _renderDevice->_vpWidth, prevVPHeight = _renderDevice->_vpHeight;
+
+		int shadowRTWidth, shadowRTHeight;
+		_renderDevice->getRenderBufferDimensions( _curShadowRB, &shadowRTWidth, &shadowRTHeight );
+
+		_renderDevice->setViewport( 0, 0, shadowRTWidth, shadowRTHeight );
+		_renderDevice->setRenderBuffer( _curShadowRB );
+
+		_renderDevice->setColorWriteMask( false );
+		_renderDevice->setDepthMask( true );
+		_renderDevice->clear( CLR_DEPTH, 0x0, 1.f );
+
+		// ****************************************************************************************
+		// Cascaded Shadow Maps
+		// ****************************************************************************************
+
+		// Prepare shadow map rendering
+		_renderDevice->setDepthTest( true );
+		//_renderDevice->setCullMode( RS_CULL_FRONT );	// Front face culling reduces artefacts but produces more "peter-panning"
+
+		// Split viewing frustum into slices and render shadow maps
+		for ( uint32 i = 0; i < numMaps; ++i )
+		{
+			// Create texture atlas if several splits are enabled
+			if ( numMaps > 1 )
+			{
+				_renderDevice->setScissorTest( true );
+				_renderDevice->setScissorRect( scissorXY[ i * 2 ], scissorXY[ i * 2 + 1 ], hsm, hsm );
+			}
+
+			setupViewMatrices( _curLight->getViewMat(), params.lightProjMatrix[ i ] );
+
+			// Render
+			Modules::sceneMan().setCurrentView( params.viewID[ i ] );
+			Frustum &f = Modules::sceneMan().getRenderViews()[ params.viewID[ i ] ].frustum;
+			drawRenderables( _curLight->_shadowContextID, 0, false, &f, 0x0, RenderingOrder::None, -1 );
+		}
+
+		// ****************************************************************************************
+
+		_renderDevice->setCullMode( RS_CULL_BACK );
+		_renderDevice->setScissorTest( false );
+
+		_renderDevice->setViewport( prevVPX, prevVPY, prevVPWidth, prevVPHeight );
+		_renderDevice->setRenderBuffer( prevRendBuf );
+		_renderDevice->setColorWriteMask( true );
+
+		Modules::stats().incStat( EngineStats::ShadowMapRenderCount, 1 );
 	}
 
 	// Map from post-projective space [-1,1] to texture space [0,1]
@@ -1309,15 +1615,6 @@ void Renderer::updateShadowMap()
 		_lightMats[ i ].scale( 0.5f, 0.5f, 1.0f );
 		_lightMats[ i ].translate( 0.5f, 0.5f, 0.0f );
 	}
-
-	// ********************************************************************************************
-
-	_renderDevice->setCullMode( RS_CULL_BACK );
-	_renderDevice->setScissorTest( false );
-
-	_renderDevice->setViewport( prevVPX, prevVPY, prevVPWidth, prevVPHeight );
-	_renderDevice->setRenderBuffer( prevRendBuf );
-	_renderDevice->setColorWriteMask( true );
 }
 
 // =================================================================================================
@@ -1355,7 +1652,7 @@ void Renderer::drawOccProxies( uint32 list )
 	_renderDevice->getColorWriteMask( prevColorMask );
 	_renderDevice->getDepthMask( prevDepthMask );
 	
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, -1 );
 	_renderDevice->setColorWriteMask( false );
 	_renderDevice->setDepthMask( false );
 	
@@ -1452,31 +1749,31 @@ void Renderer::clear( bool depth, bool buf0, bool buf1, bool buf2, bool buf3,
 }
 
 
-void Renderer::drawFSQuad( Resource *matRes, const string &shaderContext )
+void Renderer::drawFSQuad( Resource *matRes, int shaderContextID )
 {
 	if( matRes == 0x0 || matRes->getType() != ResourceTypes::Material ) return;
 
 	setupViewMatrices( _curCamera->getViewMat(), Matrix4f::OrthoMat( 0, 1, 0, 1, -1, 1 ) );
 	
-	if( !setMaterial( (MaterialResource *)matRes, shaderContext ) ) return;
+	if( !setMaterial( (MaterialResource *)matRes, shaderContextID ) ) return;
 
 	_renderDevice->setGeometry( _FSPolyGeo );
 	_renderDevice->draw( PRIM_TRILIST, 0, 3 );
 }
 
 
-void Renderer::drawGeometry( const string &shaderContext, int theClass,
+void Renderer::drawGeometry( int shaderContextID, int theClass,
                              RenderingOrder::List order, int occSet )
 {
 	Modules::sceneMan().setCurrentView( defaultCameraView );
 	Modules::sceneMan().sortViewObjects( order );
 	
 	setupViewMatrices( _curCamera->getViewMat(), _curCamera->getProjMat() );
-	drawRenderables( shaderContext, theClass, false, &_curCamera->getFrustum(), 0x0, order, occSet );
+	drawRenderables( shaderContextID, theClass, false, &_curCamera->getFrustum(), 0x0, order, occSet );
 }
 
 
-void Renderer::drawLightGeometry( const string &shaderContext, int theClass,
+void Renderer::drawLightGeometry( int shaderContextID, int theClass,
                                   bool noShadows, RenderingOrder::List order, int occSet )
 {
 // 	Modules::sceneMan().updateQueues( _curCamera->getFrustum(), 0x0, RenderingOrder::None,
@@ -1519,6 +1816,7 @@ void Renderer::drawLightGeometry( const string &shaderContext, int theClass,
 						// Check query result from previous frame
 						if( _renderDevice->getQueryResult( _curLight->_occQueries[occSet] ) < 1 )
 						{
+							Modules::stats().incStat( EngineStats::OcclusionQueryCulledCount, 1 );
 							continue;
 						}
 					}
@@ -1563,7 +1861,7 @@ void Renderer::drawLightGeometry( const string &shaderContext, int theClass,
 // 		Modules::sceneMan().updateQueues( _curCamera->getFrustum(), &_curLight->getFrustum(),
 // 		                                  order, SceneNodeFlags::NoDraw, false, true );
 		setupViewMatrices( _curCamera->getViewMat(), _curCamera->getProjMat() );
-		drawRenderables( shaderContext.empty() ? _curLight->_lightingContext : shaderContext,
+		drawRenderables( shaderContextID < 0 ? _curLight->_lightingContextID : shaderContextID,
 		                 theClass, false, &_curCamera->getFrustum(),
 		                 &_curLight->getFrustum(), order, occSet );
 		Modules().stats().incStat( EngineStats::LightPassCount, 1 );
@@ -1585,7 +1883,117 @@ void Renderer::drawLightGeometry( const string &shaderContext, int theClass,
 }
 
 
-void Renderer::drawLightShapes( const string &shaderContext, bool noShadows, int occSet )
+void Renderer::updateLightClusters()
+{
+	// Lights only have to be binned once per frame and camera
+	if( _clusterFrameID == _frameID && _clusterCamera == _curCamera ) return;
+	_clusterFrameID = _frameID;
+	_clusterCamera = _curCamera;
+
+	if( _clusterLightTex == 0 )
+	{
+		_clusterLightTex = _renderDevice->createTexture( TextureTypes::Tex2D, ClusterLightTexels, MaxClusterLights, 1,
+		                                                 TextureFormats::RGBA32F, 0, false, false, false );
+		_clusterGridTex = _renderDevice->createTexture( TextureTypes::Tex2D, ClusterGridX, ClusterGridY * ClusterGridZ, 1,
+		                                                TextureFormats::RGBA32F, 0, false, false, false );
+		_clusterIndexTex = _renderDevice->createTexture( TextureTypes::Tex2D, ClusterIndexTexWidth,
+		                                                 MaxClusterIndices / 4 / ClusterIndexTexWidth, 1,
+		                                                 TextureFormats::RGBA32F, 0, false, false, false );
+	}
+	
+	const Matrix4f &viewMat = _curCamera->getViewMat();
+	_lightClusters.setup( _curCamera->getProjMat(), _curCamera->_frustNear, _curCamera->_frustFar,
+	                      ClusterGridX, ClusterGridY, ClusterGridZ );
+
+	// Gather visible lights; the light data texture stores world space parameters in the same
+	// layout as the lightPos, lightDir and lightColor uniforms
+	vector< SceneNode * > &lightQueue = Modules::sceneMan().getLightQueue();
+	uint32 numLights = std::min( (uint32)lightQueue.size(), MaxClusterLights );
+	
+	_clusterLights.resize( numLights );
+	_clusterUploadBuf.assign( ClusterLightTexels * MaxClusterLights * 4, 0.0f );
+	for( uint32 i = 0; i < numLights; ++i )
+	{
+		LightNode *light = (LightNode *)lightQueue[ i ];
+		float halfAngle = degToRad( light->_fov / 2.0f );
+		Vec3f col = light->_diffuseCol * light->_diffuseColMult;
+
+		ClusterLight &cl = _clusterLights[ i ];
+		cl.pos = viewMat * light->_absPos;
+		cl.radius = light->_radius;
+		cl.dir = viewMat.mult33Vec( light->_spotDir ).normalized();
+		cl.cosHalfAngle = cosf( halfAngle );
+		cl.sinHalfAngle = sinf( halfAngle );
+
+		float *texels = &_clusterUploadBuf[ i * ClusterLightTexels * 4 ];
+		texels[ 0 ] = light->_absPos.x; texels[ 1 ] = light->_absPos.y; texels[ 2 ] = light->_absPos.z;
+		texels[ 3 ] = light->_radius;
+		texels[ 4 ] = light->_spotDir.x; texels[ 5 ] = light->_spotDir.y; texels[ 6 ] = light->_spotDir.z;
+		texels[ 7 ] = cl.cosHalfAngle;
+		texels[ 8 ] = col.x; texels[ 9 ] = col.y; texels[ 10 ] = col.z;
+	}
+	_renderDevice->updateTextureData( _clusterLightTex, 0, 0, &_clusterUploadBuf[ 0 ] );
+
+	_lightClusters.bin( numLights > 0 ? &_clusterLights[ 0 ] : 0x0, numLights, MaxClusterIndices );
+	if( _lightClusters.hasOverflow() )
+		Modules::log().writeWarning( "Too many light assignments for clustered lighting; some lights are skipped" );
+
+	// Grid texels hold offset and count of the light index list of each cluster
+	const vector< uint32 > &offsets = _lightClusters.getOffsets(), &counts = _lightClusters.getCounts();
+	_clusterUploadBuf.assign( _lightClusters.getClusterCount() * 4, 0.0f );
+	for( uint32 i = 0, s = _lightClusters.getClusterCount(); i < s; ++i )
+	{
+		_clusterUploadBuf[ i * 4 + 0 ] = (float)offsets[ i ];
+		_clusterUploadBuf[ i * 4 + 1 ] = (float)counts[ i ];
+	}
+	_renderDevice->updateTextureData( _clusterGridTex, 0, 0, &_clusterUploadBuf[ 0 ] );
+
+	const vector< uint32 > &indices = _lightClusters.getIndices();
+	_clusterUploadBuf.assign( MaxClusterIndices, 0.0f );
+	for( size_t i = 0, s = indices.size(); i < s; ++i )
+		_clusterUploadBuf[ i ] = (float)indices[ i ];
+	_renderDevice->updateTextureData( _clusterIndexTex, 0, 0, &_clusterUploadBuf[ 0 ] );
+
+	_clusterDepthParams[ 0 ] = _lightClusters.getNearDist();
+	_clusterDepthParams[ 1 ] = _lightClusters.getSliceScale();
+	_clusterDepthParams[ 2 ] = (float)ClusterGridZ;
+	_clusterDepthParams[ 3 ] = (float)ClusterGridY;
+}
+
+
+void Renderer::drawClusteredGeometry( int shaderContextID, int theClass,
+                                      RenderingOrder::List order, int occSet )
+{
+	GPUTimer *timer = Modules::stats().getGPUTimer( EngineStats::FwdLightsGPUTime );
+	if( Modules::config().gatherTimeStats ) timer->beginQuery( _frameID );
+
+	updateLightClusters();
+
+	// Tiles are relative to the current viewport
+	_clusterTileParams[ 0 ] = (float)_renderDevice->_vpX;
+	_clusterTileParams[ 1 ] = (float)_renderDevice->_vpY;
+	_clusterTileParams[ 2 ] = (float)ClusterGridX / (float)std::max( _renderDevice->_vpWidth, 1 );
+	_clusterTileParams[ 3 ] = (float)ClusterGridY / (float)std::max( _renderDevice->_vpHeight, 1 );
+
+	uint32 sampState = SS_FILTER_POINT | SS_ANISO1 | SS_ADDR_CLAMP;
+	_renderDevice->setTexture( 13, _clusterLightTex, sampState, TextureUsage::Texture );
+	_renderDevice->setTexture( 14, _clusterGridTex, sampState, TextureUsage::Texture );
+	_renderDevice->setTexture( 15, _clusterIndexTex, sampState, TextureUsage::Texture );
+
+	// All lights are applied in a single pass without shadows
+	_curLight = 0x0;
+	Modules::sceneMan().setCurrentView( defaultCameraView );
+	Modules::sceneMan().sortViewObjects( order );
+
+	setupViewMatrices( _curCamera->getViewMat(), _curCamera->getProjMat() );
+	drawRenderables( shaderContextID, theClass, false, &_curCamera->getFrustum(), 0x0, order, occSet );
+	Modules().stats().incStat( EngineStats::LightPassCount, 1 );
+
+	timer->endQuery();
+}
+
+
+void Renderer::drawLightShapes( int shaderContextID, bool noShadows, int occSet )
 {
 	MaterialResource *curMatRes = 0x0;
 	
@@ -1632,6 +2040,7 @@ void Renderer::drawLightShapes( const string &shaderContext, bool noShadows, int
 						// Check query result from previous frame
 						if( _renderDevice->getQueryResult( _curLight->_occQueries[occSet] ) < 1 )
 						{
+							Modules::stats().incStat( EngineStats::OcclusionQueryCulledCount, 1 );
 							continue;
 						}
 					}
@@ -1663,7 +2072,7 @@ void Renderer::drawLightShapes( const string &shaderContext, bool noShadows, int
 		if( curMatRes != _curLight->_materialRes )
 		{
 			if( !setMaterial( _curLight->_materialRes,
-				              shaderContext.empty() ? _curLight->_lightingContext : shaderContext ) )
+				              shaderContextID < 0 ? _curLight->_lightingContextID : shaderContextID ) )
 			{
 				continue;
 			}
@@ -1724,7 +2133,7 @@ void Renderer::dispatchCompute( MaterialResource *materialRes, const std::string
 // Scene Node Rendering Functions
 // =================================================================================================
 
-void Renderer::drawRenderables( const string &shaderContext, int theClass, bool debugView,
+void Renderer::drawRenderables( int shaderContextID, int theClass, bool debugView,
                                 const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                                 int occSet )
 {
@@ -1755,8 +2164,12 @@ void Renderer::drawRenderables( const string &shaderContext, int theClass, bool
 		{
 			if( _renderFuncRegistry[i].nodeType == renderQueue[firstItem].type )
 			{
-				_renderFuncRegistry[i].renderFunc(
-					firstItem, lastItem, shaderContext, theClass, debugView, frust1, frust2, order, occSet );
+				if( _renderFuncRegistry[i].renderFuncID != 0x0 )
+					_renderFuncRegistry[i].renderFuncID(
+						firstItem, lastItem, shaderContextID, theClass, debugView, frust1, frust2, order, occSet );
+				else
+					_renderFuncRegistry[i].renderFunc( firstItem, lastItem, ShaderResource::getContextName( shaderContextID ),
+						theClass, debugView, frust1, frust2, order, occSet );
 				break;
 			}
 		}
@@ -1772,7 +2185,7 @@ void Renderer::drawRenderables( const string &shaderContext, int theClass, bool
 }
 
 
-void Renderer::drawMeshes( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+void Renderer::drawMeshes( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
                            bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                            int occSet )
 {
@@ -1828,6 +2241,7 @@ void Renderer::drawMeshes( uint32 firstItem, uint32 lastItem, const std::string
 					{
 						Modules::renderer().pushOccProxy( 0, meshNode->getBBox().min, meshNode->getBBox().max,
 						                                  meshNode->_occQueries[occSet] );
+						Modules::stats().incStat( EngineStats::OcclusionQueryCulledCount, 1 );
 						continue;
 					}
 					else
@@ -1854,13 +2268,25 @@ void Renderer::drawMeshes( uint32 firstItem, uint32 lastItem, const std::string
 			// Set material
 			if( curMatRes != meshNode->getMaterialRes() )
 			{
-				if( !Modules::renderer().setMaterial( meshNode->getMaterialRes(), shaderContext ) )
+				if( !Modules::renderer().setMaterial( meshNode->getMaterialRes(), shaderContextID ) )
 				{	
 					curMatRes = 0x0;
 					continue;
 				}
 				curMatRes = meshNode->getMaterialRes();
 			}
+
+			// Gather screen-space usage of streamed textures in camera passes
+			CameraNode *curCam = Modules::renderer().getCurCamera();
+			if( Modules::config().texStreamingBudget > 0 && curCam != 0x0 && frust1 == &curCam->getFrustum() )
+			{
+				const BoundingBox &bb = meshNode->getBBox();
+				float radius = (bb.max - bb.min).length() * 0.5f;
+				float dist = curCam->_orthographic ? 1.0f :
+					std::max( ((bb.min + bb.max) * 0.5f - frust1->getOrigin()).length() - radius, curCam->_frustNear );
+				float screenSize = radius / dist * curCam->getProjMat().c[1][1] * curCam->_vpHeight;
+				Modules::renderer().getTexStreamer().noteMaterialUsage( curMatRes, screenSize );
+			}
 		}
 		else
 		{
@@ -1942,7 +2368,7 @@ void Renderer::drawMeshes( uint32 firstItem, uint32 lastItem, const std::string
 }
 
 
-void Renderer::drawParticles( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+void Renderer::drawParticles( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
                               bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
                               int occSet )
 {
@@ -2010,7 +2436,7 @@ void Renderer::drawParticles( uint32 firstItem, uint32 lastItem, const std::stri
 		// Set material
 		if( curMatRes != emitter->_materialRes )
 		{
-			if( !Modules::renderer().setMaterial( emitter->_materialRes, shaderContext ) ) continue;
+			if( !Modules::renderer().setMaterial( emitter->_materialRes, shaderContextID ) ) continue;
 			curMatRes = emitter->_materialRes;
 		}
 
@@ -2103,7 +2529,7 @@ void Renderer::drawParticles( uint32 firstItem, uint32 lastItem, const std::stri
 }
 
 
-void Renderer::drawComputeResults( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+void Renderer::drawComputeResults( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
 								   bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order,
 								   int occSet )
 {
@@ -2170,7 +2596,7 @@ void Renderer::drawComputeResults( uint32 firstItem, uint32 lastItem, const std:
 		// Set material
 		if ( curMatRes != compNode->_materialRes )
 		{
-			if ( !Modules::renderer().setMaterial( compNode->_materialRes, shaderContext ) ) continue;
+			if ( !Modules::renderer().setMaterial( compNode->_materialRes, shaderContextID ) ) continue;
 			curMatRes = compNode->_materialRes;
 		}
 
@@ -2207,8 +2633,31 @@ void Renderer::drawComputeResults( uint32 firstItem, uint32 lastItem, const std:
 // Main Rendering Functions
 // =================================================================================================
 
+#ifdef H3D_PROFILER
+static const char *getPipeCmdZoneName( int command )
+{
+	switch( command )
+	{
+	case DefaultPipelineCommands::SwitchTarget: return "Pipeline::SwitchTarget";
+	case DefaultPipelineCommands::BindBuffer: return "Pipeline::BindBuffer";
+	case DefaultPipelineCommands::UnbindBuffers: return "Pipeline::UnbindBuffers";
+	case DefaultPipelineCommands::ClearTarget: return "Pipeline::ClearTarget";
+	case DefaultPipelineCommands::DrawGeometry: return "Pipeline::DrawGeometry";
+	case DefaultPipelineCommands::DrawQuad: return "Pipeline::DrawQuad";
+	case DefaultPipelineCommands::DoForwardLightLoop: return "Pipeline::DoForwardLightLoop";
+	case DefaultPipelineCommands::DoDeferredLightLoop: return "Pipeline::DoDeferredLightLoop";
+	case DefaultPipelineCommands::SetUniform: return "Pipeline::SetUniform";
+	case DefaultPipelineCommands::DoClusteredLighting: return "Pipeline::DoClusteredLighting";
+	default: return "Pipeline::ExternalCommand";
+	}
+}
+#endif
+
+
 void Renderer::render( CameraNode *camNode )
 {
+	H3D_PROFILE_ZONE( "Renderer::render" );
+
 	_curCamera = camNode;
 	if( _curCamera == 0x0 ) return;
 
@@ -2239,17 +2688,22 @@ void Renderer::render( CameraNode *camNode )
 	else 
 		_renderDevice->setRenderBuffer( 0 );
 
-	// Process pipeline commands
-	for( uint32 i = 0; i < _curCamera->_pipelineRes->_stages.size(); ++i )
+	// Process compiled pipeline commands
+	PipelineResource *pipeRes = _curCamera->_pipelineRes;
+	pipeRes->updateRenderTargets();
+	for( uint32 i = 0; i < pipeRes->_stages.size(); ++i )
 	{
-		PipelineStage &stage = _curCamera->_pipelineRes->_stages[i];
+		PipelineStage &stage = pipeRes->_stages[i];
 		if( !stage.enabled ) continue;
 		_curStageMatLink = stage.matLink;
+		Modules::stats().beginStage( stage.id.c_str() );
 		
-		for( uint32 j = 0; j < stage.commands.size(); ++j )
+		for( uint32 j = 0; j < stage.compiledCommands.size(); ++j )
 		{
-			PipelineCommand &pc = stage.commands[j];
-			RenderTarget *rt;
+			const CompiledPipeCmd &cc = stage.compiledCommands[j];
+			PipelineCommand &pc = stage.commands[cc.cmdIndex];
+			RenderTarget *rt = cc.target >= 0 ? &pipeRes->_renderTargets[cc.target] : 0x0;
+			H3D_PROFILE_ZONE( getPipeCmdZoneName( pc.command ) );
 
 			switch( pc.command )
 			{
@@ -2258,7 +2712,6 @@ void Renderer::render( CameraNode *camNode )
 				bindPipeBuffer( 0x0, "", 0 );
 				
 				// Bind new render target
-				rt = (RenderTarget *)pc.params[0].getPtr();
 				_curRenderTarget = rt;
 
 				if( rt != 0x0 )
@@ -2278,7 +2731,6 @@ void Renderer::render( CameraNode *camNode )
 				break;
 
 			case DefaultPipelineCommands::BindBuffer:
-				rt = (RenderTarget *)pc.params[0].getPtr();
 				bindPipeBuffer( rt->rendBuf, pc.params[1].getString(), (uint32)pc.params[2].getInt() );
 				break;
 
@@ -2293,22 +2745,27 @@ void Renderer::render( CameraNode *camNode )
 				break;
 
 			case DefaultPipelineCommands::DrawGeometry:
-				drawGeometry( pc.params[0].getString(), pc.params[1].getInt(),
+				drawGeometry( pc.params[0].getInt(), pc.params[1].getInt(),
 				              (RenderingOrder::List)pc.params[2].getInt(), _curCamera->_occSet );
 				break;
 
 			case DefaultPipelineCommands::DrawQuad:
-				drawFSQuad( pc.params[0].getResource(), pc.params[1].getString() );
+				drawFSQuad( pc.params[0].getResource(), pc.params[1].getInt() );
 			break;
 
 			case DefaultPipelineCommands::DoForwardLightLoop:
-				drawLightGeometry( pc.params[0].getString(), pc.params[1].getInt(),
+				drawLightGeometry( pc.params[0].getInt(), pc.params[1].getInt(),
 				                   pc.params[2].getBool(), (RenderingOrder::List)pc.params[3].getInt(),
 								   _curCamera->_occSet );
 				break;
 
 			case DefaultPipelineCommands::DoDeferredLightLoop:
-				drawLightShapes( pc.params[0].getString(), pc.params[1].getBool(), _curCamera->_occSet );
+				drawLightShapes( pc.params[0].getInt(), pc.params[1].getBool(), _curCamera->_occSet );
+				break;
+
+			case DefaultPipelineCommands::DoClusteredLighting:
+				drawClusteredGeometry( pc.params[0].getInt(), pc.params[1].getInt(),
+				                       (RenderingOrder::List)pc.params[2].getInt(), _curCamera->_occSet );
 				break;
 
 			case DefaultPipelineCommands::SetUniform:
@@ -2325,6 +2782,8 @@ void Renderer::render( CameraNode *camNode )
 				break;
 			}
 		}
+
+		Modules::stats().endStage();
 	}
 	
 	// Update mipmaps if necessary
@@ -2338,6 +2797,10 @@ void Renderer::render( CameraNode *camNode )
 void Renderer::finalizeFrame()
 {
 	++_frameID;
+	Profiler::nextFrame();
+
+	// Adjust resident mip levels of streamed textures to the usage of this frame
+	_texStreamer.update();
 	
 	// Reset frame timer
 	Timer *timer = Modules::stats().getTimer( EngineStats::FrameTime );
@@ -2345,6 +2808,11 @@ void Renderer::finalizeFrame()
 	Modules::stats().getStat( EngineStats::FrameTime, true );  // Reset
 	Modules::stats().incStat( EngineStats::FrameTime, timer->getElapsedTimeMS() );
 	timer->reset();
+
+	Modules::stats().finalizeFrame();
+
+	// Pass the messages of this frame to the callback
+	Modules::log().flush();
 }
 
 
@@ -2357,7 +2825,7 @@ void Renderer::renderDebugView()
 		_renderDevice->setRenderBuffer( _curCamera->_outputTex->getRBObject() );
 	else 
 		_renderDevice->setRenderBuffer( 0 );
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, -1 );
 	_renderDevice->setFillMode( RS_FILL_WIREFRAME );
 
 	_renderDevice->clear( CLR_DEPTH | CLR_COLOR_RT0 );
@@ -2367,11 +2835,11 @@ void Renderer::renderDebugView()
 
 	// Draw renderable nodes as wireframe
 	setupViewMatrices( _curCamera->getViewMat(), _curCamera->getProjMat() );
-	drawRenderables( "", 0, true, &_curCamera->getFrustum(), 0x0, RenderingOrder::None, -1 );
+	drawRenderables( -1, 0, true, &_curCamera->getFrustum(), 0x0, RenderingOrder::None, -1 );
 
 	// Draw bounding boxes
 	_renderDevice->setCullMode( RS_CULL_NONE );
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, -1 );
 	setShaderComb( &_defColorShader );
 	commitGeneralUniforms();
 	
@@ -2419,7 +2887,7 @@ void Renderer::finishRendering()
 	_shadowParams.resize( 0 );
 
 	_renderDevice->setRenderBuffer( 0 );
-	setMaterial( 0x0, "" );
+	setMaterial( 0x0, -1 );
 	_renderDevice->resetStates();
 }
 
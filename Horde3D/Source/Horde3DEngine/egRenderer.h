@@ -17,6 +17,9 @@
 #include "egRendererBase.h"
 #include "egPrimitives.h"
 #include "egModel.h"
+#include "egTexStreaming.h"
+#include "utOcclusion.h"
+#include "egLightClusters.h"
 #include <vector>
 #include <algorithm>
 #include <string>
@@ -32,6 +35,13 @@ struct ShaderContext;
 const uint32 ParticlesPerBatch = 64;	// Warning: The GPU must have enough registers
 const uint32 QuadIndexBufCount = ParticlesPerBatch * 6;
 
+// Clustered lighting
+const uint32 ClusterGridX = 16, ClusterGridY = 8, ClusterGridZ = 24;
+const uint32 MaxClusterLights = 1024;
+const uint32 ClusterLightTexels = 3;           // Texels per light in the light data texture
+const uint32 ClusterIndexTexWidth = 1024;      // Four light indices per texel
+const uint32 MaxClusterIndices = ClusterIndexTexWidth * 16 * 4;
+
 #define OCCPROXYLIST_RENDERABLES 0
 #define OCCPROXYLIST_LIGHTS 1
 
@@ -46,17 +56,23 @@ extern const char *fsOccBox;
 typedef void (*RenderFunc)( uint32 firstItem, uint32 lastItem, const std::string &shaderContext,
                             int theClass, bool debugView, const Frustum *frust1,
                             const Frustum *frust2, RenderingOrder::List order, int occSet );
+// Variant that receives the context as id (see ShaderResource::getContextID) to avoid string lookups
+typedef void (*RenderFuncID)( uint32 firstItem, uint32 lastItem, int shaderContextID,
+                              int theClass, bool debugView, const Frustum *frust1,
+                              const Frustum *frust2, RenderingOrder::List order, int occSet );
 
 struct RenderFuncListItem
 {
-	int         nodeType;
-	RenderFunc  renderFunc;
+	int           nodeType;
+	RenderFunc    renderFunc;
+	RenderFuncID  renderFuncID;
 };
 
 struct RenderBackendType
 {
 	enum List
 	{
+		Null = 1,
 		OpenGL2 = 2,
 		OpenGL4 = 4,
 		OpenGLES3 = 8
@@ -126,6 +142,7 @@ struct DefaultShaderUniforms
 	int                 skinMatRows = -1;
 	int                 lightPos = -1, lightDir = -1, lightColor = -1;
 	int                 shadowSplitDists = -1, shadowMats = -1, shadowMapSize = -1, shadowBias = -1;
+	int                 clusterTileParams = -1, clusterDepthParams = -1;
 	int                 parPosArray = -1, parSizeAndRotArray = -1, parColorArray = -1;
 };
 
@@ -148,6 +165,22 @@ struct ShadowParameters
 	int								   viewID[ 4 ] = { 0 };
 };
 
+struct ShadowMapCacheEntry
+{
+	NodeHandle                         light;
+	uint32                             renderBuffer;
+	uint32                             lastUsedFrame;
+
+	// State the shadow map was rendered with
+	Matrix4f                           lightMats[ 4 ];  // Before packing into the shadow map atlas
+	Vec4f                              lightPos;  // Position and radius
+	float                              bias;
+	uint32                             mapCount;
+	int                                contextID;
+	uint64                             casterHash;
+	bool                               valid;
+};
+
 class Renderer
 {
 public:
@@ -159,6 +192,7 @@ public:
 	void initStates();
 
 	void registerRenderFunc( int nodeType, RenderFunc rf );
+	void registerRenderFunc( int nodeType, RenderFuncID rf );
 
 	unsigned char *useScratchBuf( uint32 minSize, uint32 alignment );
 	void setupViewMatrices( const Matrix4f &viewMat, const Matrix4f &projMat );
@@ -172,13 +206,16 @@ public:
 	// Shader & material handling
 	bool createShaderComb( ShaderCombination &sc, const char *vertexShader, const char *fragmentShader, const char *geometryShader,
 						   const char *tessControlShader, const char *tessEvaluationShader, const char *computeShader );
+	bool createShaderCombFromBinary( ShaderCombination &sc, uint32 binaryFormat, const void *data, uint32 size );
 	void releaseShaderComb( ShaderCombination &sc );
 	void setShaderComb( ShaderCombination *sc );
 	void commitGeneralUniforms();
+	bool setMaterial( MaterialResource *materialRes, int shaderContextID );
 	bool setMaterial( MaterialResource *materialRes, const std::string &shaderContext );
 	
 	bool createShadowRB( uint32 width, uint32 height );
 	void releaseShadowRB();
+	void releaseShadowCache();
 
 	// Occlusion culling
 	int registerOccSet();
@@ -192,11 +229,11 @@ public:
 	void drawSphere( const Vec3f &pos, float radius );
 	void drawCone( float height, float fov, const Matrix4f &transMat );
 
-	static void drawMeshes( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+	static void drawMeshes( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
 		bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
-	static void drawParticles( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass,
+	static void drawParticles( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass,
 		bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
-	static void drawComputeResults( uint32 firstItem, uint32 lastItem, const std::string &shaderContext, int theClass, 
+	static void drawComputeResults( uint32 firstItem, uint32 lastItem, int shaderContextID, int theClass, 
 									bool debugView, const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 
 	void render( CameraNode *camNode );
@@ -213,6 +250,9 @@ public:
 	uint32 getParticleGeometry() const { return _particleGeo; }
 	uint32 getDefaultVertexLayout( DefaultVertexLayouts::List vl ) const;
 
+	TextureStreamer &getTexStreamer() { return _texStreamer; }
+	const OcclusionBuffer &getOcclusionBuffer() const { return _occBuffer; }
+
 	inline RenderDeviceInterface *getRenderDevice() const { return _renderDevice; }
 	int getRenderDeviceType() { return _renderDeviceType; }
 
@@ -220,9 +260,11 @@ protected:
 	
 	void createPrimitives();
 	
-	bool setMaterialRec( MaterialResource *materialRes, const std::string &shaderContext, ShaderResource *shaderRes );
+	void setupShaderComb( ShaderCombination &sc, uint32 shdObj );
+	bool setMaterialRec( MaterialResource *materialRes, int shaderContextID, ShaderResource *shaderRes );
 	
 	void prepareRenderViews();
+	void cullOccludedObjects();
 
 	// Shadows
 	void setupShadowMap( bool noShadows );
@@ -232,20 +274,25 @@ protected:
 	
 	int prepareCropFrustum( const LightNode *light, const BoundingBox &viewBB );
 	bool prepareShadowMapFrustum( const LightNode *light, int shadowView );
+	static uint64 hashMeshResources( const MeshNode *mesh, uint64 hash );
+	bool acquireCachedShadowMap( const ShadowParameters &params );
 	void updateShadowMap();
 	void updateShadowMapOld();
 
 	// Drawing functions
 	void bindPipeBuffer( uint32 rbObj, const std::string &sampler, uint32 bufIndex );
 	void clear( bool depth, bool buf0, bool buf1, bool buf2, bool buf3, float r, float g, float b, float a );
-	void drawFSQuad( Resource *matRes, const std::string &shaderContext );
-	void drawGeometry( const std::string &shaderContext, int theClass,
+	void drawFSQuad( Resource *matRes, int shaderContextID );
+	void drawGeometry( int shaderContextID, int theClass,
 	                   RenderingOrder::List order, int occSet );
-	void drawLightGeometry( const std::string &shaderContext, int theClass,
+	void drawLightGeometry( int shaderContextID, int theClass,
 	                        bool noShadows, RenderingOrder::List order, int occSet );
-	void drawLightShapes( const std::string &shaderContext, bool noShadows, int occSet );
+	void drawLightShapes( int shaderContextID, bool noShadows, int occSet );
+	void updateLightClusters();
+	void drawClusteredGeometry( int shaderContextID, int theClass,
+	                            RenderingOrder::List order, int occSet );
 	
-	void drawRenderables( const std::string &shaderContext, int theClass, bool debugView,
+	void drawRenderables( int shaderContextID, int theClass, bool debugView,
 		const Frustum *frust1, const Frustum *frust2, RenderingOrder::List order, int occSet );
 	
 	void renderDebugView();
@@ -269,6 +316,18 @@ protected:
 	std::vector< EngineUniform >	   _engineUniforms; // uniforms, that are used internally by the engine and extensions
 	std::vector< ShadowParameters >	   _shadowParams; // shadow lightmaps and project matrices
 
+	TextureStreamer                    _texStreamer;
+	OcclusionBuffer                    _occBuffer;  // Software occlusion culling of camera view
+	std::vector< SceneNode * >         _occludedNodes;
+
+	LightClusterGrid                   _lightClusters;
+	std::vector< ClusterLight >        _clusterLights;
+	std::vector< float >               _clusterUploadBuf;
+	uint32                             _clusterLightTex, _clusterGridTex, _clusterIndexTex;
+	uint32                             _clusterFrameID;
+	CameraNode                         *_clusterCamera;
+	float                              _clusterTileParams[4], _clusterDepthParams[4];
+
 	Matrix4f                           _viewMat, _viewMatInv, _projMat, _viewProjMat, _viewProjMatInv;
 
 	unsigned char                      *_scratchBuf;
@@ -282,6 +341,8 @@ protected:
 	uint32								_FSPolyGeo;
 
 	uint32                             _shadowRB;
+	uint32                             _curShadowRB;  // Shadow map of current light, either _shadowRB or cached
+	std::vector< ShadowMapCacheEntry > _shadowCache;
 	uint32                             _frameID;
 	uint32                             _defShadowMap;
 	uint32                             _quadIdxBuf;
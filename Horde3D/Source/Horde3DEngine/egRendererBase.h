@@ -184,6 +184,7 @@ struct DeviceCaps
 	bool	texETC2;
 	bool	texASTC;
 	bool	texBPTC;
+	bool	programBinaries;  // Linked shader programs can be saved and restored
 };
 
 
@@ -487,6 +488,30 @@ enum RDIDrawBarriers
 	ImageBarrier				// Wait till image is updated by shaders
 };
 
+// ---------------------------------------------------------
+// Statistics
+// ---------------------------------------------------------
+
+// Number of device calls since the device was created; the counters are never reset and wrap around,
+// so users compute differences between two snapshots
+struct RDICounters
+{
+	uint32  shaderBinds;
+	uint32  textureBinds;
+	uint32  geometryBinds;
+	uint32  uniformUploads;
+	uint32  uniformBytes;
+	uint32  bufferUploadBytes;  // Data passed to buffer creation and updates
+	uint32  renderTargetSwitches;
+	uint32  occlusionQueries;
+
+	RDICounters() :
+		shaderBinds( 0 ), textureBinds( 0 ), geometryBinds( 0 ), uniformUploads( 0 ), uniformBytes( 0 ),
+		bufferUploadBytes( 0 ), renderTargetSwitches( 0 ), occlusionQueries( 0 )
+	{
+	}
+};
+
 class RenderDeviceInterface
 {
 // -----------------------------------------------------------------------------
@@ -526,6 +551,8 @@ protected:
 	RDIDelegate< void ( uint32, void * ) >								_delegate_bindImageToTexture;
 
 	RDIDelegate< uint32 ( const char *, const char *, const char *, const char *, const char *, const char * ) > _delegate_createShader;
+	RDIDelegate< uint32 ( uint32, const void *, uint32 ) >				_delegate_createShaderFromBinary;
+	RDIDelegate< bool ( uint32, uint32 *, std::vector< char > * ) >	_delegate_getShaderBinary;
 	RDIDelegate< void ( uint32 & ) >									_delegate_destroyShader;
 	RDIDelegate< void ( uint32 ) >										_delegate_bindShader;
 	RDIDelegate< int ( uint32, const char * ) >							_delegate_getShaderConstLoc;
@@ -630,18 +657,22 @@ public:
 	}
 	uint32 createVertexBuffer( uint32 size, const void *data )
 	{
+		if( data != 0x0 ) _counters.bufferUploadBytes += size;
 		return _delegate_createVertexBuffer.invoke( size, data );
 	}
 	uint32 createIndexBuffer( uint32 size, const void *data ) 
 	{ 
+		if( data != 0x0 ) _counters.bufferUploadBytes += size;
 		return _delegate_createIndexBuffer.invoke( size, data );
 	}
 	uint32 createTextureBuffer( TextureFormats::List format, uint32 bufSize, const void *data )
 	{
+		if( data != 0x0 ) _counters.bufferUploadBytes += bufSize;
 		return _delegate_createTextureBuffer.invoke( format, bufSize, data );
 	}
 	uint32 createShaderStorageBuffer( uint32 size, const void *data )
 	{
+		if( data != 0x0 ) _counters.bufferUploadBytes += size;
 		return _delegate_createShaderStorageBuffer.invoke( size, data );
 	}
 	void destroyBuffer( uint32& bufObj )
@@ -654,6 +685,7 @@ public:
 	}
 	void updateBufferData( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, void *data ) 
 	{ 
+		_counters.bufferUploadBytes += size;
 		_delegate_updateBufferData.invoke( geoObj, bufObj, offset, size, data );
 	}
 	void *mapBuffer( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, RDIBufferMappingTypes mapType )
@@ -670,6 +702,11 @@ public:
 		return _bufferMem;
 	}
 
+	const RDICounters &getCounters() const
+	{
+		return _counters;
+	}
+
 	// Textures
 	uint32 calcTextureSize( TextureFormats::List format, int width, int height, int depth ) 
 	{ 
@@ -772,18 +809,32 @@ public:
 		return _delegate_createShader.invoke( vertexShaderSrc, fragmentShaderSrc, geometryShaderSrc, 
 											  tessControlShaderSrc, tessEvaluationShaderSrc, computeShaderSrc );
 	}
+	// Returns 0 if the binary was not accepted, e.g. because the driver changed
+	uint32 createShaderFromBinary( uint32 binaryFormat, const void *data, uint32 size )
+	{
+		return _delegate_createShaderFromBinary.invoke( binaryFormat, data, size );
+	}
+	bool getShaderBinary( uint32 shaderId, uint32 *binaryFormat, std::vector< char > *data )
+	{
+		return _delegate_getShaderBinary.invoke( shaderId, binaryFormat, data );
+	}
 	void destroyShader( uint32& shaderId )
 	{
 		_delegate_destroyShader.invoke( shaderId );
 	}
 	void bindShader( uint32 shaderId ) 
 	{ 
+		if( shaderId != 0 ) ++_counters.shaderBinds;
 		_delegate_bindShader.invoke( shaderId );
 	}
 	std::string getShaderLog() const 
 	{
 		return _shaderLog; 
 	}
+	const std::string &getDriverString() const  // Identifies driver version and GPU
+	{
+		return _driverString;
+	}
 	int getShaderConstLoc( uint32 shaderId, const char *name ) 
 	{ 
 		return _delegate_getShaderConstLoc.invoke( shaderId, name );
@@ -798,6 +849,9 @@ public:
 	}
 	void setShaderConst( int loc, RDIShaderConstType type, void *values, uint32 count = 1 ) 
 	{
+		static const uint32 constSizes[] = { 4, 8, 12, 16, 64, 36, 4, 8, 12, 16 };
+		++_counters.uniformUploads;
+		_counters.uniformBytes += constSizes[type] * count;
 		_delegate_setShaderConst.invoke( loc, type, values, count );
 	}
 	void setShaderSampler( int loc, uint32 texUnit ) 
@@ -833,6 +887,7 @@ public:
 	}
 	void setRenderBuffer( uint32 rbObj ) 
 	{ 
+		++_counters.renderTargetSwitches;
 		_delegate_setRenderBuffer.invoke( rbObj );
 	}
 	bool getRenderBufferData( uint32 rbObj, int bufIndex, int *width, int *height,
@@ -856,6 +911,7 @@ public:
 	}
 	void beginQuery( uint32 queryObj ) 
 	{ 
+		++_counters.occlusionQueries;
 		_delegate_beginQuery.invoke( queryObj );
 	}
 	void endQuery( uint32 queryObj ) 
@@ -882,10 +938,10 @@ public:
 	void setScissorRect( int x, int y, int width, int height )
 		{ _scX = x; _scY = y; _scWidth = width; _scHeight = height; _pendingMask |= PM_SCISSOR; }
 	void setGeometry( uint32 geoIndex )
-		{ _curGeometryIndex = geoIndex;  _pendingMask |= PM_GEOMETRY; }
+		{ _curGeometryIndex = geoIndex;  _pendingMask |= PM_GEOMETRY; ++_counters.geometryBinds; }
 	void setTexture( uint32 slot, uint32 texObj, uint16 samplerState, uint16 usage )
 		{ ASSERT( slot < 16/*_maxTexSlots*/ ); _texSlots[slot] = RDITexSlot( texObj, samplerState, usage );
-	      _pendingMask |= PM_TEXTURES; }
+	      _pendingMask |= PM_TEXTURES; if( texObj != 0 ) ++_counters.textureBinds; }
 // 	void setTextureBuffer( uint32 bufObj )
 // 	{	_curTextureBuf = bufObj; _pendingMask |= PM_TEXTUREBUFFER; }
 	void setMemoryBarrier( RDIDrawBarriers barrier )
@@ -999,6 +1055,7 @@ protected:
 	RDIDrawBarriers				_memBarriers;
 
 	std::string					_shaderLog;
+	std::string					_driverString;
 	uint32						_depthFormat;
 	int							_vpX, _vpY, _vpWidth, _vpHeight;
 	int							_scX, _scY, _scWidth, _scHeight;
@@ -1006,6 +1063,7 @@ protected:
 	uint32						_curRendBuf;
 	int							_outputBufferIndex;  // Left and right eye for stereo rendering
 	uint32						_textureMem, _bufferMem;
+	RDICounters					_counters;
 
 	uint32                      _numVertexLayouts;
 
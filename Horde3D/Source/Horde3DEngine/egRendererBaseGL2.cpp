@@ -276,6 +276,8 @@ void RenderDeviceGL2::initRDIFuncs()
 	_delegate_bindImageToTexture.bind< RenderDeviceGL2, &RenderDeviceGL2::bindImageToTexture >( this );
 
 	_delegate_createShader.bind< RenderDeviceGL2, &RenderDeviceGL2::createShader >( this );
+	_delegate_createShaderFromBinary.bind< RenderDeviceGL2, &RenderDeviceGL2::createShaderFromBinary >( this );
+	_delegate_getShaderBinary.bind< RenderDeviceGL2, &RenderDeviceGL2::getShaderBinary >( this );
 	_delegate_destroyShader.bind< RenderDeviceGL2, &RenderDeviceGL2::destroyShader >( this );
 	_delegate_bindShader.bind< RenderDeviceGL2, &RenderDeviceGL2::bindShader >( this );
 	_delegate_getShaderConstLoc.bind< RenderDeviceGL2, &RenderDeviceGL2::getShaderConstLoc >( this );
@@ -341,6 +343,7 @@ bool RenderDeviceGL2::init()
 
 	Modules::log().writeInfo( "Initializing GL2 backend using OpenGL driver '%s' by '%s' on '%s'",
 	                          version, vendor, renderer );
+	_driverString = std::string( vendor ) + "|" + renderer + "|" + version;
 	
 	// Init extensions
 	if( !initOpenGLExtensions(true) )
@@ -406,6 +409,7 @@ bool RenderDeviceGL2::init()
 	_caps.texETC2 = false;
 	_caps.texBPTC = glExt::ARB_texture_compression_bptc;
 	_caps.texASTC = false;
+	_caps.programBinaries = false;
 
 	// Init states before creating test render buffer, to
 	// ensure binding the current FBO again
@@ -1077,6 +1081,19 @@ uint32 RenderDeviceGL2::createShader( const char *vertexShaderSrc, const char *f
 }
 
 
+uint32 RenderDeviceGL2::createShaderFromBinary( uint32 /*binaryFormat*/, const void * /*data*/, uint32 /*size*/ )
+{
+	// Program binaries are not supported by this backend
+	return 0;
+}
+
+
+bool RenderDeviceGL2::getShaderBinary( uint32 /*shaderId*/, uint32 * /*binaryFormat*/, std::vector< char > * /*data*/ )
+{
+	return false;
+}
+
+
 void RenderDeviceGL2::destroyShader( uint32& shaderId )
 {
 	if( shaderId == 0 )
@@ -253,6 +253,8 @@ public:
 	// Shaders
 	uint32 createShader( const char *vertexShaderSrc, const char *fragmentShaderSrc, const char *geometryShaderSrc,
 						 const char *tessControlShaderSrc, const char *tessEvaluationShaderSrc, const char *computeShaderSrc );
+	uint32 createShaderFromBinary( uint32 binaryFormat, const void *data, uint32 size );
+	bool getShaderBinary( uint32 shaderId, uint32 *binaryFormat, std::vector< char > *data );
 	void destroyShader(uint32 &shaderId );
 	void bindShader( uint32 shaderId );
 	std::string getShaderLog() const { return _shaderLog; }
@@ -316,6 +316,8 @@ void RenderDeviceGL4::initRDIFuncs()
 	_delegate_bindImageToTexture.bind< RenderDeviceGL4, &RenderDeviceGL4::bindImageToTexture >( this );
 
 	_delegate_createShader.bind< RenderDeviceGL4, &RenderDeviceGL4::createShader >( this );
+	_delegate_createShaderFromBinary.bind< RenderDeviceGL4, &RenderDeviceGL4::createShaderFromBinary >( this );
+	_delegate_getShaderBinary.bind< RenderDeviceGL4, &RenderDeviceGL4::getShaderBinary >( this );
 	_delegate_destroyShader.bind< RenderDeviceGL4, &RenderDeviceGL4::destroyShader >( this );
 	_delegate_bindShader.bind< RenderDeviceGL4, &RenderDeviceGL4::bindShader >( this );
 	_delegate_getShaderConstLoc.bind< RenderDeviceGL4, &RenderDeviceGL4::getShaderConstLoc >( this );
@@ -381,6 +383,7 @@ bool RenderDeviceGL4::init()
 	
 	Modules::log().writeInfo( "Initializing GL4 backend using OpenGL driver '%s' by '%s' on '%s'",
 							  version, vendor, renderer );
+	_driverString = std::string( vendor ) + "|" + renderer + "|" + version;
 	
 	// Init extensions
 	if( !initOpenGLExtensions( false ) )
@@ -438,6 +441,11 @@ bool RenderDeviceGL4::init()
 	_caps.texBPTC = glExt::ARB_texture_compression_bptc;
 	_caps.texASTC = glExt::KHR_texture_compression_astc;
 
+	GLint numBinaryFormats = 0;
+	if( glExt::majorVersion * 10 + glExt::minorVersion >= 41 )
+		glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats );
+	_caps.programBinaries = numBinaryFormats > 0;
+
 	// Find maximum number of storage buffers in compute shader
 	glGetIntegerv( GL_MAX_COMPUTE_SHADER_STORAGE_BLOCKS, (GLint *) &_maxComputeBufferAttachments );
 	// Init states before creating test render buffer, to
@@ -1335,10 +1343,58 @@ uint32 RenderDeviceGL4::createShader( const char *vertexShaderSrc, const char *f
 	// Compile and link shader
 	uint32 programObj = createShaderProgram( vertexShaderSrc, fragmentShaderSrc, geometryShaderSrc, tessControlShaderSrc, tessEvaluationShaderSrc, computeShaderSrc );
 	if( programObj == 0 ) return 0;
+	if( _caps.programBinaries ) glProgramParameteri( programObj, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 	if( !linkShaderProgram( programObj ) ) return 0;
 
 //	int loc = glGetFragDataLocation( programObj, "fragColor" );
 
+	return addShaderProgram( programObj );
+}
+
+
+uint32 RenderDeviceGL4::createShaderFromBinary( uint32 binaryFormat, const void *data, uint32 size )
+{
+	if( !_caps.programBinaries ) return 0;
+
+	_shaderLog = "";
+
+	uint32 programObj = glCreateProgram();
+	glProgramBinary( programObj, binaryFormat, data, size );
+
+	int status;
+	glGetProgramiv( programObj, GL_LINK_STATUS, &status );
+	if( !status )
+	{
+		// Binaries are rejected if the driver or hardware changed
+		glDeleteProgram( programObj );
+		return 0;
+	}
+
+	return addShaderProgram( programObj );
+}
+
+
+bool RenderDeviceGL4::getShaderBinary( uint32 shaderId, uint32 *binaryFormat, std::vector< char > *data )
+{
+	if( !_caps.programBinaries || shaderId == 0 ) return false;
+
+	RDIShaderGL4 &shader = _shaders.getRef( shaderId );
+	int size = 0;
+	glGetProgramiv( shader.oglProgramObj, GL_PROGRAM_BINARY_LENGTH, &size );
+	if( size <= 0 ) return false;
+
+	data->resize( size );
+	GLenum format = 0;
+	glGetProgramBinary( shader.oglProgramObj, size, &size, &format, &(*data)[0] );
+	data->resize( size );
+	*binaryFormat = format;
+	
+	return size > 0;
+}
+
+
+uint32 RenderDeviceGL4::addShaderProgram( uint32 programObj )
+{
 	uint32 shaderId = _shaders.add( RDIShaderGL4() );
 	RDIShaderGL4 &shader = _shaders.getRef( shaderId );
 	shader.oglProgramObj = programObj;
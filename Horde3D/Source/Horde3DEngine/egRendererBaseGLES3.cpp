@@ -311,6 +311,8 @@ void RenderDeviceGLES3::initRDIFuncs()
 	_delegate_bindImageToTexture.bind< RenderDeviceGLES3, &RenderDeviceGLES3::bindImageToTexture >( this );
 
 	_delegate_createShader.bind< RenderDeviceGLES3, &RenderDeviceGLES3::createShader >( this );
+	_delegate_createShaderFromBinary.bind< RenderDeviceGLES3, &RenderDeviceGLES3::createShaderFromBinary >( this );
+	_delegate_getShaderBinary.bind< RenderDeviceGLES3, &RenderDeviceGLES3::getShaderBinary >( this );
 	_delegate_destroyShader.bind< RenderDeviceGLES3, &RenderDeviceGLES3::destroyShader >( this );
 	_delegate_bindShader.bind< RenderDeviceGLES3, &RenderDeviceGLES3::bindShader >( this );
 	_delegate_getShaderConstLoc.bind< RenderDeviceGLES3, &RenderDeviceGLES3::getShaderConstLoc >( this );
@@ -371,6 +373,7 @@ bool RenderDeviceGLES3::init()
 
 	Modules::log().writeInfo( "Initializing GLES3 backend using OpenGL driver '%s' by '%s' on '%s'",
 	                          version, vendor, renderer );
+	_driverString = std::string( vendor ) + "|" + renderer + "|" + version;
 	
 	// Init extensions
 	if( !initOpenGLExtensions() )
@@ -437,6 +440,7 @@ bool RenderDeviceGLES3::init()
 	_caps.texETC2 = true;
 	_caps.texBPTC = glESExt::EXT_texture_compression_bptc;
 	_caps.texASTC = glESExt::KHR_texture_compression_astc;
+	_caps.programBinaries = false;
 
     // Get the currently bound frame buffer object.
     glGetIntegerv( GL_FRAMEBUFFER_BINDING, &_defaultFBO );
@@ -1353,6 +1357,19 @@ uint32 RenderDeviceGLES3::createShader( const char *vertexShaderSrc, const char
 }
 
 
+uint32 RenderDeviceGLES3::createShaderFromBinary( uint32 /*binaryFormat*/, const void * /*data*/, uint32 /*size*/ )
+{
+	// Program binaries are not supported by this backend
+	return 0;
+}
+
+
+bool RenderDeviceGLES3::getShaderBinary( uint32 /*shaderId*/, uint32 * /*binaryFormat*/, std::vector< char > * /*data*/ )
+{
+	return false;
+}
+
+
 void RenderDeviceGLES3::destroyShader( uint32 &shaderId )
 {
 	if( shaderId == 0 ) return;
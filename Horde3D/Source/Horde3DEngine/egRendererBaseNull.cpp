@@ -0,0 +1,808 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egRendererBaseNull.h"
+#include "egModules.h"
+#include "egCom.h"
+#include <cstring>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+namespace RDI_Null {
+
+using namespace std;
+
+// Shader code is never compiled, but the renderer requires a default shader
+static const char *defaultShaderVS = "";
+static const char *defaultShaderFS = "";
+
+
+// =================================================================================================
+// GPUTimer
+// =================================================================================================
+
+GPUTimerNull::GPUTimerNull()
+{
+	_beginQuery.bind< GPUTimerNull, &GPUTimerNull::beginQuery >( this );
+	_endQuery.bind< GPUTimerNull, &GPUTimerNull::endQuery > ( this );
+	_updateResults.bind< GPUTimerNull, &GPUTimerNull::updateResults >( this );
+	_reset.bind< GPUTimerNull, &GPUTimerNull::reset >( this );
+
+	reset();
+}
+
+
+GPUTimerNull::~GPUTimerNull()
+{
+}
+
+
+void GPUTimerNull::beginQuery( uint32 frameID )
+{
+	H3D_UNUSED_VAR( frameID );
+}
+
+
+void GPUTimerNull::endQuery()
+{
+}
+
+
+bool GPUTimerNull::updateResults()
+{
+	_time = 0;
+	return true;
+}
+
+
+void GPUTimerNull::reset()
+{
+	_time = 0;
+}
+
+
+// =================================================================================================
+// RenderDevice
+// =================================================================================================
+
+RenderDeviceNull::RenderDeviceNull()
+{
+	initRDIFuncs(); // bind render device functions
+
+	_numVertexLayouts = 0;
+
+	_vpX = 0; _vpY = 0; _vpWidth = 320; _vpHeight = 240;
+	_scX = 0; _scY = 0; _scWidth = 320; _scHeight = 240;
+	_fbWidth = 0; _fbHeight = 0;
+	_prevShaderId = _curShaderId = 0;
+	_curRendBuf = 0; _outputBufferIndex = 0;
+	_textureMem = 0; _bufferMem = 0;
+	_curRasterState.hash = _newRasterState.hash = 0;
+	_curBlendState.hash = _newBlendState.hash = 0;
+	_curDepthStencilState.hash = _newDepthStencilState.hash = 0;
+	_curGeometryIndex = 0;
+	_defaultFBO = 0;
+	_defaultFBOMultisampled = false;
+	_pendingMask = 0;
+	_tessPatchVerts = 0;
+	_memBarriers = NotSet;
+	_maxTexSlots = 16;
+	_numQueries = 0;
+}
+
+
+RenderDeviceNull::~RenderDeviceNull()
+{
+}
+
+
+void RenderDeviceNull::initRDIFuncs()
+{
+	_delegate_init.bind< RenderDeviceNull, &RenderDeviceNull::init >( this );
+	_delegate_initStates.bind< RenderDeviceNull, &RenderDeviceNull::initStates >( this );
+	_delegate_enableDebugOutput.bind< RenderDeviceNull, &RenderDeviceNull::enableDebugOutput >( this );
+	_delegate_disableDebugOutput.bind< RenderDeviceNull, &RenderDeviceNull::disableDebugOutput >( this );
+	_delegate_registerVertexLayout.bind< RenderDeviceNull, &RenderDeviceNull::registerVertexLayout >( this );
+	_delegate_beginRendering.bind< RenderDeviceNull, &RenderDeviceNull::beginRendering >( this );
+
+	_delegate_beginCreatingGeometry.bind< RenderDeviceNull, &RenderDeviceNull::beginCreatingGeometry >( this );
+	_delegate_finishCreatingGeometry.bind< RenderDeviceNull, &RenderDeviceNull::finishCreatingGeometry >( this );
+	_delegate_destroyGeometry.bind< RenderDeviceNull, &RenderDeviceNull::destroyGeometry >( this );
+	_delegate_setGeomVertexParams.bind< RenderDeviceNull, &RenderDeviceNull::setGeomVertexParams >( this );
+	_delegate_setGeomIndexParams.bind< RenderDeviceNull, &RenderDeviceNull::setGeomIndexParams >( this );
+	_delegate_createVertexBuffer.bind< RenderDeviceNull, &RenderDeviceNull::createVertexBuffer >( this );
+	_delegate_createIndexBuffer.bind< RenderDeviceNull, &RenderDeviceNull::createIndexBuffer >( this );
+	_delegate_createTextureBuffer.bind< RenderDeviceNull, &RenderDeviceNull::createTextureBuffer >( this );
+	_delegate_createShaderStorageBuffer.bind< RenderDeviceNull, &RenderDeviceNull::createShaderStorageBuffer >( this );
+	_delegate_destroyBuffer.bind< RenderDeviceNull, &RenderDeviceNull::destroyBuffer >( this );
+	_delegate_destroyTextureBuffer.bind< RenderDeviceNull, &RenderDeviceNull::destroyTextureBuffer >( this );
+	_delegate_updateBufferData.bind< RenderDeviceNull, &RenderDeviceNull::updateBufferData >( this );
+	_delegate_mapBuffer.bind< RenderDeviceNull, &RenderDeviceNull::mapBuffer >( this );
+	_delegate_unmapBuffer.bind< RenderDeviceNull, &RenderDeviceNull::unmapBuffer >( this );
+
+	_delegate_createTexture.bind< RenderDeviceNull, &RenderDeviceNull::createTexture >( this );
+	_delegate_generateTextureMipmap.bind< RenderDeviceNull, &RenderDeviceNull::generateTextureMipmap >( this );
+	_delegate_uploadTextureData.bind< RenderDeviceNull, &RenderDeviceNull::uploadTextureData >( this );
+	_delegate_destroyTexture.bind< RenderDeviceNull, &RenderDeviceNull::destroyTexture >( this );
+	_delegate_updateTextureData.bind< RenderDeviceNull, &RenderDeviceNull::updateTextureData >( this );
+	_delegate_getTextureData.bind< RenderDeviceNull, &RenderDeviceNull::getTextureData >( this );
+	_delegate_bindImageToTexture.bind< RenderDeviceNull, &RenderDeviceNull::bindImageToTexture >( this );
+
+	_delegate_createShader.bind< RenderDeviceNull, &RenderDeviceNull::createShader >( this );
+	_delegate_createShaderFromBinary.bind< RenderDeviceNull, &RenderDeviceNull::createShaderFromBinary >( this );
+	_delegate_getShaderBinary.bind< RenderDeviceNull, &RenderDeviceNull::getShaderBinary >( this );
+	_delegate_destroyShader.bind< RenderDeviceNull, &RenderDeviceNull::destroyShader >( this );
+	_delegate_bindShader.bind< RenderDeviceNull, &RenderDeviceNull::bindShader >( this );
+	_delegate_getShaderConstLoc.bind< RenderDeviceNull, &RenderDeviceNull::getShaderConstLoc >( this );
+	_delegate_getShaderSamplerLoc.bind< RenderDeviceNull, &RenderDeviceNull::getShaderSamplerLoc >( this );
+	_delegate_getShaderBufferLoc.bind< RenderDeviceNull, &RenderDeviceNull::getShaderBufferLoc >( this );
+	_delegate_runComputeShader.bind< RenderDeviceNull, &RenderDeviceNull::runComputeShader >( this );
+	_delegate_setShaderConst.bind< RenderDeviceNull, &RenderDeviceNull::setShaderConst >( this );
+	_delegate_setShaderSampler.bind< RenderDeviceNull, &RenderDeviceNull::setShaderSampler >( this );
+	_delegate_getDefaultVSCode.bind< RenderDeviceNull, &RenderDeviceNull::getDefaultVSCode >( this );
+	_delegate_getDefaultFSCode.bind< RenderDeviceNull, &RenderDeviceNull::getDefaultFSCode >( this );
+
+	_delegate_createRenderBuffer.bind< RenderDeviceNull, &RenderDeviceNull::createRenderBuffer >( this );
+	_delegate_destroyRenderBuffer.bind< RenderDeviceNull, &RenderDeviceNull::destroyRenderBuffer >( this );
+	_delegate_getRenderBufferTex.bind< RenderDeviceNull, &RenderDeviceNull::getRenderBufferTex >( this );
+	_delegate_setRenderBuffer.bind< RenderDeviceNull, &RenderDeviceNull::setRenderBuffer >( this );
+	_delegate_getRenderBufferData.bind< RenderDeviceNull, &RenderDeviceNull::getRenderBufferData >( this );
+	_delegate_getRenderBufferDimensions.bind< RenderDeviceNull, &RenderDeviceNull::getRenderBufferDimensions >( this );
+
+	_delegate_createOcclusionQuery.bind< RenderDeviceNull, &RenderDeviceNull::createOcclusionQuery >( this );
+	_delegate_destroyQuery.bind< RenderDeviceNull, &RenderDeviceNull::destroyQuery >( this );
+	_delegate_beginQuery.bind< RenderDeviceNull, &RenderDeviceNull::beginQuery >( this );
+	_delegate_endQuery.bind< RenderDeviceNull, &RenderDeviceNull::endQuery >( this );
+	_delegate_getQueryResult.bind< RenderDeviceNull, &RenderDeviceNull::getQueryResult >( this );
+
+	_delegate_createGPUTimer.bind< RenderDeviceNull, &RenderDeviceNull::createGPUTimer >( this );
+	_delegate_commitStates.bind< RenderDeviceNull, &RenderDeviceNull::commitStates >( this );
+	_delegate_resetStates.bind< RenderDeviceNull, &RenderDeviceNull::resetStates >( this );
+	_delegate_clear.bind< RenderDeviceNull, &RenderDeviceNull::clear >( this );
+
+	_delegate_draw.bind< RenderDeviceNull, &RenderDeviceNull::draw >( this );
+	_delegate_drawIndexed.bind< RenderDeviceNull, &RenderDeviceNull::drawIndexed >( this );
+	_delegate_setStorageBuffer.bind< RenderDeviceNull, &RenderDeviceNull::setStorageBuffer >( this );
+}
+
+
+void RenderDeviceNull::initStates()
+{
+}
+
+
+bool RenderDeviceNull::init()
+{
+	Modules::log().writeInfo( "Initializing null render backend; nothing will be drawn" );
+
+	// Report the capabilities of a current desktop GPU, so that all resources can be loaded
+	_caps.texFloat = true;
+	_caps.texNPOT = true;
+	_caps.rtMultisampling = true;
+	_caps.geometryShaders = true;
+	_caps.tesselation = true;
+	_caps.computeShaders = true;
+	_caps.instancing = true;
+	_caps.maxJointCount = 330;
+	_caps.maxTexUnitCount = 16;
+	_caps.texDXT = true;
+	_caps.texETC2 = true;
+	_caps.texBPTC = true;
+	_caps.texASTC = true;
+	_caps.programBinaries = false;
+
+	_driverString = "Null";
+
+	return true;
+}
+
+
+bool RenderDeviceNull::enableDebugOutput()
+{
+	return true;
+}
+
+
+bool RenderDeviceNull::disableDebugOutput()
+{
+	return true;
+}
+
+
+// =================================================================================================
+// Vertex layouts
+// =================================================================================================
+
+uint32 RenderDeviceNull::registerVertexLayout( uint32 numAttribs, VertexLayoutAttrib *attribs )
+{
+	H3D_UNUSED_VAR( numAttribs );
+	H3D_UNUSED_VAR( attribs );
+
+	return ++_numVertexLayouts;
+}
+
+
+// =================================================================================================
+// Buffers
+// =================================================================================================
+
+void RenderDeviceNull::beginRendering()
+{
+	resetStates();
+}
+
+
+uint32 RenderDeviceNull::beginCreatingGeometry( uint32 vlObj )
+{
+	RDIGeometryInfoNull geo;
+	geo.layout = vlObj;
+
+	return _geometries.add( geo );
+}
+
+
+void RenderDeviceNull::finishCreatingGeometry( uint32 geoObj )
+{
+	ASSERT( geoObj > 0 );
+	H3D_UNUSED_VAR( geoObj );
+}
+
+
+void RenderDeviceNull::setGeomVertexParams( uint32 geoObj, uint32 vbo, uint32 vbSlot, uint32 offset, uint32 stride )
+{
+	H3D_UNUSED_VAR( vbSlot );
+	H3D_UNUSED_VAR( offset );
+	H3D_UNUSED_VAR( stride );
+
+	_buffers.getRef( vbo ).geometryRefCount++;
+	_geometries.getRef( geoObj ).vertexBufs.push_back( vbo );
+}
+
+
+void RenderDeviceNull::setGeomIndexParams( uint32 geoObj, uint32 indBuf, RDIIndexFormat format )
+{
+	H3D_UNUSED_VAR( format );
+
+	_buffers.getRef( indBuf ).geometryRefCount++;
+	_geometries.getRef( geoObj ).indexBuf = indBuf;
+}
+
+
+void RenderDeviceNull::destroyGeometry( uint32 &geoObj, bool destroyBindedBuffers )
+{
+	if( geoObj == 0 ) return;
+
+	RDIGeometryInfoNull &geo = _geometries.getRef( geoObj );
+
+	for( size_t i = 0; i < geo.vertexBufs.size(); ++i )
+	{
+		decreaseBufferRefCount( geo.vertexBufs[i] );
+		if( destroyBindedBuffers ) destroyBuffer( geo.vertexBufs[i] );
+	}
+	decreaseBufferRefCount( geo.indexBuf );
+	if( destroyBindedBuffers ) destroyBuffer( geo.indexBuf );
+
+	_geometries.remove( geoObj );
+	geoObj = 0;
+}
+
+
+void RenderDeviceNull::decreaseBufferRefCount( uint32 bufObj )
+{
+	if( bufObj == 0 ) return;
+
+	_buffers.getRef( bufObj ).geometryRefCount--;
+}
+
+
+uint32 RenderDeviceNull::createBuffer( uint32 size )
+{
+	RDIBufferNull buf;
+	buf.size = size;
+
+	_bufferMem += size;
+	return _buffers.add( buf );
+}
+
+
+uint32 RenderDeviceNull::createVertexBuffer( uint32 size, const void *data )
+{
+	H3D_UNUSED_VAR( data );
+	return createBuffer( size );
+}
+
+
+uint32 RenderDeviceNull::createIndexBuffer( uint32 size, const void *data )
+{
+	H3D_UNUSED_VAR( data );
+	return createBuffer( size );
+}
+
+
+uint32 RenderDeviceNull::createTextureBuffer( TextureFormats::List format, uint32 bufSize, const void *data )
+{
+	H3D_UNUSED_VAR( format );
+	H3D_UNUSED_VAR( data );
+
+	RDITextureBufferNull buf;
+	buf.bufObj = createBuffer( bufSize );
+
+	return _textureBuffs.add( buf );
+}
+
+
+uint32 RenderDeviceNull::createShaderStorageBuffer( uint32 size, const void *data )
+{
+	H3D_UNUSED_VAR( data );
+	return createBuffer( size );
+}
+
+
+void RenderDeviceNull::destroyBuffer( uint32 &bufObj )
+{
+	if( bufObj == 0 ) return;
+
+	RDIBufferNull &buf = _buffers.getRef( bufObj );
+	if( buf.geometryRefCount < 1 )
+	{
+		_bufferMem -= buf.size;
+		_buffers.remove( bufObj );
+		bufObj = 0;
+	}
+}
+
+
+void RenderDeviceNull::destroyTextureBuffer( uint32 &bufObj )
+{
+	if( bufObj == 0 ) return;
+
+	RDITextureBufferNull &buf = _textureBuffs.getRef( bufObj );
+	destroyBuffer( buf.bufObj );
+
+	_textureBuffs.remove( bufObj );
+	bufObj = 0;
+}
+
+
+void RenderDeviceNull::updateBufferData( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, void *data )
+{
+	H3D_UNUSED_VAR( geoObj );
+
+	RDIBufferNull &buf = _buffers.getRef( bufObj );
+	ASSERT( offset + size <= buf.size );
+
+	// Only buffers that were mapped before keep their contents
+	if( !buf.data.empty() && data != 0x0 ) memcpy( &buf.data[offset], data, size );
+}
+
+
+void *RenderDeviceNull::mapBuffer( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, RDIBufferMappingTypes mapType )
+{
+	H3D_UNUSED_VAR( geoObj );
+	H3D_UNUSED_VAR( size );
+	H3D_UNUSED_VAR( mapType );
+
+	RDIBufferNull &buf = _buffers.getRef( bufObj );
+	ASSERT( offset + size <= buf.size );
+
+	if( buf.data.empty() ) buf.data.resize( buf.size );
+	return buf.data.empty() ? 0x0 : &buf.data[offset];
+}
+
+
+void RenderDeviceNull::unmapBuffer( uint32 geoObj, uint32 bufObj )
+{
+	H3D_UNUSED_VAR( geoObj );
+	H3D_UNUSED_VAR( bufObj );
+}
+
+
+// =================================================================================================
+// Textures
+// =================================================================================================
+
+uint32 RenderDeviceNull::createTexture( TextureTypes::List type, int width, int height, int depth,
+                                        TextureFormats::List format,
+                                        int maxMipLevel, bool genMips, bool compress, bool sRGB )
+{
+	H3D_UNUSED_VAR( genMips );
+	H3D_UNUSED_VAR( compress );
+	H3D_UNUSED_VAR( sRGB );
+	ASSERT( depth > 0 );
+
+	RDITextureNull tex;
+	tex.format = format;
+	tex.width = width;
+	tex.height = height;
+	tex.depth = depth;
+
+	tex.memSize = calcTextureSize( format, width, height, depth, maxMipLevel );
+	if( type == TextureTypes::TexCube ) tex.memSize *= 6;
+	_textureMem += tex.memSize;
+
+	return _textures.add( tex );
+}
+
+
+void RenderDeviceNull::generateTextureMipmap( uint32 texObj )
+{
+	H3D_UNUSED_VAR( texObj );
+}
+
+
+void RenderDeviceNull::uploadTextureData( uint32 texObj, int slice, int mipLevel, const void *pixels )
+{
+	H3D_UNUSED_VAR( texObj );
+	H3D_UNUSED_VAR( slice );
+	H3D_UNUSED_VAR( mipLevel );
+	H3D_UNUSED_VAR( pixels );
+}
+
+
+void RenderDeviceNull::destroyTexture( uint32 &texObj )
+{
+	if( texObj == 0 ) return;
+
+	_textureMem -= _textures.getRef( texObj ).memSize;
+	_textures.remove( texObj );
+	texObj = 0;
+}
+
+
+void RenderDeviceNull::updateTextureData( uint32 texObj, int slice, int mipLevel, const void *pixels )
+{
+	uploadTextureData( texObj, slice, mipLevel, pixels );
+}
+
+
+bool RenderDeviceNull::getTextureData( uint32 texObj, int slice, int mipLevel, void *buffer )
+{
+	H3D_UNUSED_VAR( slice );
+
+	// Texture contents are not stored, so the image is always black
+	const RDITextureNull &tex = _textures.getRef( texObj );
+	int width = std::max( tex.width >> mipLevel, 1 );
+	int height = std::max( tex.height >> mipLevel, 1 );
+	memset( buffer, 0, calcTextureSize( tex.format, width, height, 1 ) );
+
+	return true;
+}
+
+
+void RenderDeviceNull::bindImageToTexture( uint32 texObj, void *eglImage )
+{
+	H3D_UNUSED_VAR( texObj );
+	H3D_UNUSED_VAR( eglImage );
+}
+
+
+// =================================================================================================
+// Shaders
+// =================================================================================================
+
+uint32 RenderDeviceNull::createShader( const char *vertexShaderSrc, const char *fragmentShaderSrc, const char *geometryShaderSrc,
+                                       const char *tessControlShaderSrc, const char *tessEvaluationShaderSrc, const char *computeShaderSrc )
+{
+	H3D_UNUSED_VAR( vertexShaderSrc );
+	H3D_UNUSED_VAR( fragmentShaderSrc );
+	H3D_UNUSED_VAR( geometryShaderSrc );
+	H3D_UNUSED_VAR( tessControlShaderSrc );
+	H3D_UNUSED_VAR( tessEvaluationShaderSrc );
+	H3D_UNUSED_VAR( computeShaderSrc );
+
+	_shaderLog = "";
+
+	RDIShaderNull shader;
+	shader.valid = true;
+
+	return _shaders.add( shader );
+}
+
+
+uint32 RenderDeviceNull::createShaderFromBinary( uint32 binaryFormat, const void *data, uint32 size )
+{
+	H3D_UNUSED_VAR( binaryFormat );
+	H3D_UNUSED_VAR( data );
+	H3D_UNUSED_VAR( size );
+
+	return 0;
+}
+
+
+bool RenderDeviceNull::getShaderBinary( uint32 shaderId, uint32 *binaryFormat, std::vector< char > *data )
+{
+	H3D_UNUSED_VAR( shaderId );
+	H3D_UNUSED_VAR( binaryFormat );
+	H3D_UNUSED_VAR( data );
+
+	return false;
+}
+
+
+void RenderDeviceNull::destroyShader( uint32 &shaderId )
+{
+	if( shaderId == 0 ) return;
+
+	_shaders.remove( shaderId );
+	shaderId = 0;
+}
+
+
+void RenderDeviceNull::bindShader( uint32 shaderId )
+{
+	_curShaderId = shaderId;
+}
+
+
+int RenderDeviceNull::getShaderConstLoc( uint32 shaderId, const char *name )
+{
+	H3D_UNUSED_VAR( shaderId );
+	H3D_UNUSED_VAR( name );
+
+	return -1;
+}
+
+
+int RenderDeviceNull::getShaderSamplerLoc( uint32 shaderId, const char *name )
+{
+	H3D_UNUSED_VAR( shaderId );
+	H3D_UNUSED_VAR( name );
+
+	return -1;
+}
+
+
+int RenderDeviceNull::getShaderBufferLoc( uint32 shaderId, const char *name )
+{
+	H3D_UNUSED_VAR( shaderId );
+	H3D_UNUSED_VAR( name );
+
+	return -1;
+}
+
+
+void RenderDeviceNull::setShaderConst( int loc, RDIShaderConstType type, void *values, uint32 count )
+{
+	H3D_UNUSED_VAR( loc );
+	H3D_UNUSED_VAR( type );
+	H3D_UNUSED_VAR( values );
+	H3D_UNUSED_VAR( count );
+}
+
+
+void RenderDeviceNull::setShaderSampler( int loc, uint32 texUnit )
+{
+	H3D_UNUSED_VAR( loc );
+	H3D_UNUSED_VAR( texUnit );
+}
+
+
+const char *RenderDeviceNull::getDefaultVSCode()
+{
+	return defaultShaderVS;
+}
+
+
+const char *RenderDeviceNull::getDefaultFSCode()
+{
+	return defaultShaderFS;
+}
+
+
+void RenderDeviceNull::runComputeShader( uint32 shaderId, uint32 xDim, uint32 yDim, uint32 zDim )
+{
+	H3D_UNUSED_VAR( shaderId );
+	H3D_UNUSED_VAR( xDim );
+	H3D_UNUSED_VAR( yDim );
+	H3D_UNUSED_VAR( zDim );
+}
+
+
+// =================================================================================================
+// Renderbuffers
+// =================================================================================================
+
+uint32 RenderDeviceNull::createRenderBuffer( uint32 width, uint32 height, TextureFormats::List format,
+                                             bool depth, uint32 numColBufs, uint32 samples, uint32 maxMipLevel )
+{
+	H3D_UNUSED_VAR( samples );
+
+	if( numColBufs > RDIRenderBufferNull::MaxColorAttachmentCount ) return 0;
+
+	RDIRenderBufferNull rb;
+	rb.width = width;
+	rb.height = height;
+
+	for( uint32 i = 0; i < numColBufs; ++i )
+	{
+		rb.colTexs[i] = createTexture( TextureTypes::Tex2D, width, height, 1, format, maxMipLevel,
+		                               maxMipLevel > 0, false, false );
+	}
+	if( depth )
+	{
+		rb.depthTex = createTexture( TextureTypes::Tex2D, width, height, 1, TextureFormats::DEPTH, 0,
+		                             false, false, false );
+	}
+
+	return _rendBufs.add( rb );
+}
+
+
+void RenderDeviceNull::destroyRenderBuffer( uint32 &rbObj )
+{
+	if( rbObj == 0 ) return;
+
+	RDIRenderBufferNull &rb = _rendBufs.getRef( rbObj );
+
+	if( rb.depthTex != 0 ) destroyTexture( rb.depthTex );
+	for( uint32 i = 0; i < RDIRenderBufferNull::MaxColorAttachmentCount; ++i )
+	{
+		if( rb.colTexs[i] != 0 ) destroyTexture( rb.colTexs[i] );
+	}
+
+	_rendBufs.remove( rbObj );
+	rbObj = 0;
+}
+
+
+uint32 RenderDeviceNull::getRenderBufferTex( uint32 rbObj, uint32 bufIndex )
+{
+	RDIRenderBufferNull &rb = _rendBufs.getRef( rbObj );
+
+	if( bufIndex < RDIRenderBufferNull::MaxColorAttachmentCount ) return rb.colTexs[bufIndex];
+	else if( bufIndex == 32 ) return rb.depthTex;
+	else return 0;
+}
+
+
+void RenderDeviceNull::setRenderBuffer( uint32 rbObj )
+{
+	_curRendBuf = rbObj;
+
+	if( rbObj == 0 )
+	{
+		_fbWidth = _vpWidth + _vpX;
+		_fbHeight = _vpHeight + _vpY;
+	}
+	else
+	{
+		RDIRenderBufferNull &rb = _rendBufs.getRef( rbObj );
+		_fbWidth = rb.width;
+		_fbHeight = rb.height;
+	}
+}
+
+
+bool RenderDeviceNull::getRenderBufferData( uint32 rbObj, int bufIndex, int *width, int *height,
+                                            int *compCount, void *dataBuffer, int bufferSize )
+{
+	H3D_UNUSED_VAR( rbObj );
+	H3D_UNUSED_VAR( bufIndex );
+	H3D_UNUSED_VAR( width );
+	H3D_UNUSED_VAR( height );
+	H3D_UNUSED_VAR( compCount );
+	H3D_UNUSED_VAR( dataBuffer );
+	H3D_UNUSED_VAR( bufferSize );
+
+	// Nothing is rendered, so there is no data to read back
+	return false;
+}
+
+
+void RenderDeviceNull::getRenderBufferDimensions( uint32 rbObj, int *width, int *height )
+{
+	RDIRenderBufferNull &rb = _rendBufs.getRef( rbObj );
+
+	*width = rb.width;
+	*height = rb.height;
+}
+
+
+// =================================================================================================
+// Queries
+// =================================================================================================
+
+uint32 RenderDeviceNull::createOcclusionQuery()
+{
+	return ++_numQueries;
+}
+
+
+void RenderDeviceNull::destroyQuery( uint32 queryObj )
+{
+	H3D_UNUSED_VAR( queryObj );
+}
+
+
+void RenderDeviceNull::beginQuery( uint32 queryObj )
+{
+	H3D_UNUSED_VAR( queryObj );
+}
+
+
+void RenderDeviceNull::endQuery( uint32 queryObj )
+{
+	H3D_UNUSED_VAR( queryObj );
+}
+
+
+uint32 RenderDeviceNull::getQueryResult( uint32 queryObj )
+{
+	H3D_UNUSED_VAR( queryObj );
+
+	// Report objects as visible, so that no work is skipped
+	return 1;
+}
+
+
+// =================================================================================================
+// Commands
+// =================================================================================================
+
+void RenderDeviceNull::setStorageBuffer( uint8 slot, uint32 bufObj )
+{
+	H3D_UNUSED_VAR( slot );
+	H3D_UNUSED_VAR( bufObj );
+}
+
+
+bool RenderDeviceNull::commitStates( uint32 filter )
+{
+	H3D_UNUSED_VAR( filter );
+
+	_pendingMask = 0;
+	return true;
+}
+
+
+void RenderDeviceNull::resetStates()
+{
+	_curShaderId = 0;
+	_curGeometryIndex = 0;
+	_pendingMask = 0xFFFFFFFF;
+}
+
+
+void RenderDeviceNull::clear( uint32 flags, float *colorRGBA, float depth )
+{
+	H3D_UNUSED_VAR( flags );
+	H3D_UNUSED_VAR( colorRGBA );
+	H3D_UNUSED_VAR( depth );
+}
+
+
+void RenderDeviceNull::draw( RDIPrimType primType, uint32 firstVert, uint32 numVerts )
+{
+	H3D_UNUSED_VAR( primType );
+	H3D_UNUSED_VAR( firstVert );
+	H3D_UNUSED_VAR( numVerts );
+
+	commitStates();
+}
+
+
+void RenderDeviceNull::drawIndexed( RDIPrimType primType, uint32 firstIndex, uint32 numIndices,
+                                    uint32 firstVert, uint32 numVerts )
+{
+	H3D_UNUSED_VAR( primType );
+	H3D_UNUSED_VAR( firstIndex );
+	H3D_UNUSED_VAR( numIndices );
+	H3D_UNUSED_VAR( firstVert );
+	H3D_UNUSED_VAR( numVerts );
+
+	commitStates();
+}
+
+} // namespace RDI_Null
+}  // namespace
@@ -0,0 +1,228 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egRendererBaseNull_H_
+#define _egRendererBaseNull_H_
+
+#include "egRendererBase.h"
+
+
+namespace Horde3D {
+namespace RDI_Null {
+
+// The null device keeps track of all objects like a real device but does not draw anything. It
+// allows to run the engine without graphics context, e.g. for servers, tools and benchmarks.
+
+// =================================================================================================
+// GPUTimer
+// =================================================================================================
+
+class GPUTimerNull : public GPUTimer
+{
+public:
+	GPUTimerNull();
+	~GPUTimerNull();
+
+	void beginQuery( uint32 frameID );
+	void endQuery();
+	bool updateResults();
+
+	void reset();
+};
+
+
+// =================================================================================================
+// Render Device Interface
+// =================================================================================================
+
+struct RDIBufferNull
+{
+	uint32                 size;
+	int                    geometryRefCount;
+	std::vector< uint8 >   data;  // Only allocated when the buffer is mapped
+
+	RDIBufferNull() : size( 0 ), geometryRefCount( 0 ) {}
+};
+
+struct RDIGeometryInfoNull
+{
+	std::vector< uint32 >  vertexBufs;
+	uint32                 indexBuf;
+	uint32                 layout;
+
+	RDIGeometryInfoNull() : indexBuf( 0 ), layout( 0 ) {}
+};
+
+struct RDITextureNull
+{
+	TextureFormats::List  format;
+	int                   width, height, depth;
+	int                   memSize;
+
+	RDITextureNull() : format( TextureFormats::Unknown ), width( 0 ), height( 0 ), depth( 0 ), memSize( 0 ) {}
+};
+
+struct RDITextureBufferNull
+{
+	uint32  bufObj;
+
+	RDITextureBufferNull() : bufObj( 0 ) {}
+};
+
+struct RDIShaderNull
+{
+	bool  valid;
+
+	RDIShaderNull() : valid( false ) {}
+};
+
+struct RDIRenderBufferNull
+{
+	static const uint32 MaxColorAttachmentCount = 4;
+
+	uint32  width, height;
+	uint32  depthTex, colTexs[MaxColorAttachmentCount];
+
+	RDIRenderBufferNull() : width( 0 ), height( 0 ), depthTex( 0 )
+	{
+		for( uint32 i = 0; i < MaxColorAttachmentCount; ++i ) colTexs[i] = 0;
+	}
+};
+
+// =================================================================================================
+
+
+class RenderDeviceNull : public RenderDeviceInterface
+{
+public:
+
+	RenderDeviceNull();
+	~RenderDeviceNull();
+
+	void initStates();
+	bool init();
+
+	bool enableDebugOutput();
+	bool disableDebugOutput();
+
+// -----------------------------------------------------------------------------
+// Resources
+// -----------------------------------------------------------------------------
+
+	// Vertex layouts
+	uint32 registerVertexLayout( uint32 numAttribs, VertexLayoutAttrib *attribs );
+
+	// Buffers
+	void beginRendering();
+	uint32 beginCreatingGeometry( uint32 vlObj );
+	void finishCreatingGeometry( uint32 geoObj );
+	void setGeomVertexParams( uint32 geoObj, uint32 vbo, uint32 vbSlot, uint32 offset, uint32 stride );
+	void setGeomIndexParams( uint32 geoObj, uint32 indBuf, RDIIndexFormat format );
+	void destroyGeometry( uint32 &geoObj, bool destroyBindedBuffers );
+
+	uint32 createVertexBuffer( uint32 size, const void *data );
+	uint32 createIndexBuffer( uint32 size, const void *data );
+	uint32 createTextureBuffer( TextureFormats::List format, uint32 bufSize, const void *data );
+	uint32 createShaderStorageBuffer( uint32 size, const void *data );
+	void destroyBuffer( uint32 &bufObj );
+	void destroyTextureBuffer( uint32 &bufObj );
+	void updateBufferData( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, void *data );
+	void *mapBuffer( uint32 geoObj, uint32 bufObj, uint32 offset, uint32 size, RDIBufferMappingTypes mapType );
+	void unmapBuffer( uint32 geoObj, uint32 bufObj );
+
+	// Textures
+	uint32 createTexture( TextureTypes::List type, int width, int height, int depth, TextureFormats::List format,
+	                      int maxMipLevel, bool genMips, bool compress, bool sRGB );
+	void generateTextureMipmap( uint32 texObj );
+	void uploadTextureData( uint32 texObj, int slice, int mipLevel, const void *pixels );
+	void destroyTexture( uint32 &texObj );
+	void updateTextureData( uint32 texObj, int slice, int mipLevel, const void *pixels );
+	bool getTextureData( uint32 texObj, int slice, int mipLevel, void *buffer );
+	uint32 getTextureMem() const { return _textureMem; }
+	void bindImageToTexture( uint32 texObj, void *eglImage );
+
+	// Shaders
+	uint32 createShader( const char *vertexShaderSrc, const char *fragmentShaderSrc, const char *geometryShaderSrc,
+	                     const char *tessControlShaderSrc, const char *tessEvaluationShaderSrc, const char *computeShaderSrc );
+	uint32 createShaderFromBinary( uint32 binaryFormat, const void *data, uint32 size );
+	bool getShaderBinary( uint32 shaderId, uint32 *binaryFormat, std::vector< char > *data );
+	void destroyShader( uint32 &shaderId );
+	void bindShader( uint32 shaderId );
+	std::string getShaderLog() const { return _shaderLog; }
+	int getShaderConstLoc( uint32 shaderId, const char *name );
+	int getShaderSamplerLoc( uint32 shaderId, const char *name );
+	int getShaderBufferLoc( uint32 shaderId, const char *name );
+	void setShaderConst( int loc, RDIShaderConstType type, void *values, uint32 count = 1 );
+	void setShaderSampler( int loc, uint32 texUnit );
+	const char *getDefaultVSCode();
+	const char *getDefaultFSCode();
+	void runComputeShader( uint32 shaderId, uint32 xDim, uint32 yDim, uint32 zDim );
+
+	// Renderbuffers
+	uint32 createRenderBuffer( uint32 width, uint32 height, TextureFormats::List format,
+	                           bool depth, uint32 numColBufs, uint32 samples, uint32 maxMipLevel );
+	void destroyRenderBuffer( uint32 &rbObj );
+	uint32 getRenderBufferTex( uint32 rbObj, uint32 bufIndex );
+	void setRenderBuffer( uint32 rbObj );
+	bool getRenderBufferData( uint32 rbObj, int bufIndex, int *width, int *height,
+	                          int *compCount, void *dataBuffer, int bufferSize );
+	void getRenderBufferDimensions( uint32 rbObj, int *width, int *height );
+
+	// Queries
+	uint32 createOcclusionQuery();
+	void destroyQuery( uint32 queryObj );
+	void beginQuery( uint32 queryObj );
+	void endQuery( uint32 queryObj );
+	uint32 getQueryResult( uint32 queryObj );
+
+	// Render Device dependent GPU Timer
+	GPUTimer *createGPUTimer()
+	{
+		return new GPUTimerNull();
+	}
+
+// -----------------------------------------------------------------------------
+// Commands
+// -----------------------------------------------------------------------------
+	void setStorageBuffer( uint8 slot, uint32 bufObj );
+
+	bool commitStates( uint32 filter = 0xFFFFFFFF );
+	void resetStates();
+
+	// Draw calls and clears
+	void clear( uint32 flags, float *colorRGBA = 0x0, float depth = 1.0f );
+	void draw( RDIPrimType primType, uint32 firstVert, uint32 numVerts );
+	void drawIndexed( RDIPrimType primType, uint32 firstIndex, uint32 numIndices,
+	                  uint32 firstVert, uint32 numVerts );
+
+protected:
+
+	uint32 createBuffer( uint32 size );
+	void decreaseBufferRefCount( uint32 bufObj );
+
+	void initRDIFuncs();
+
+protected:
+
+	RDIObjects< RDIBufferNull >         _buffers;
+	RDIObjects< RDITextureNull >        _textures;
+	RDIObjects< RDITextureBufferNull >  _textureBuffs;
+	RDIObjects< RDIShaderNull >         _shaders;
+	RDIObjects< RDIRenderBufferNull >   _rendBufs;
+	RDIObjects< RDIGeometryInfoNull >   _geometries;
+	uint32                              _numQueries;
+};
+
+} // namespace RDI_Null
+} // namespace Horde3D
+
+#endif // _egRendererBaseNull_H_
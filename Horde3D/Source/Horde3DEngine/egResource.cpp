@@ -15,6 +15,7 @@
 #include "egCom.h"
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 
 #include "utDebug.h"
 
@@ -36,6 +37,7 @@ Resource::Resource( int type, const string &name, int flags )
 	_refCount = 0;
 	_userRefCount = 0;
 	_flags = flags;
+	markUpdated();
 	
 	if( (flags & ResourceFlags::NoQuery) == ResourceFlags::NoQuery ) _noQuery = true;
 	else _noQuery = false;
@@ -80,6 +82,7 @@ bool Resource::load( const char *data, int size )
 	}
 
 	_loaded = true;
+	markUpdated();
 	
 	return true;
 }
@@ -90,6 +93,15 @@ void Resource::unload()
 	release();
 	initDefault();
 	_loaded = false;
+	markUpdated();
+}
+
+
+void Resource::markUpdated()
+{
+	// Stamps are unique among all resources, so a new resource at the address of a removed one
+	// cannot be mistaken for it
+	_updateStamp = Modules::resMan().nextUpdateStamp();
 }
 
 
@@ -107,16 +119,28 @@ int Resource::findElem( int elem, int param, const char *value ) const
 
 int Resource::getElemCount( int elem ) const
 {
-	H3D_UNUSED_VAR(elem);
+	if( elem == ResourceMemory::MemoryElem ) return 1;
+	
 	Modules::setError( "Invalid elem in h3dGetResElemCount" );
 	return 0;
 }
 
 int Resource::getElemParamI( int elem, int elemIdx, int param ) const
 {
-	H3D_UNUSED_VAR(elem);
-	H3D_UNUSED_VAR(elemIdx);
-	H3D_UNUSED_VAR(param);
+	if( elem == ResourceMemory::MemoryElem && elemIdx == 0 )
+	{
+		uint64 cpuBytes = 0, gpuBytes = 0;
+		switch( param )
+		{
+		case ResourceMemory::CPUMemoryI:
+			getMemoryUsage( cpuBytes, gpuBytes );
+			return (int)std::min( cpuBytes, (uint64)Math::MaxInt32 );
+		case ResourceMemory::GPUMemoryI:
+			getMemoryUsage( cpuBytes, gpuBytes );
+			return (int)std::min( gpuBytes, (uint64)Math::MaxInt32 );
+		}
+	}
+	
 	Modules::setError( "Invalid elem or param in h3dGetResParamI" );
 	return Math::MinInt32;
 }
@@ -185,6 +209,13 @@ void Resource::unmapStream()
 }
 
 
+void Resource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = 0;
+	gpuBytes = 0;
+}
+
+
 // **********************************************************************************
 // Class ResourceManager
 // **********************************************************************************
@@ -192,6 +223,8 @@ void Resource::unmapStream()
 ResourceManager::ResourceManager()
 {
 	_resources.reserve( 100 );
+	_budgetExceeded = false;
+	_updateCounter = 0;
 }
 
 
@@ -431,4 +464,50 @@ void ResourceManager::releaseUnusedResources()
 	if( !killList.empty() ) releaseUnusedResources();
 }
 
+
+
+void ResourceManager::getMemoryUsage( int type, int &numResources, uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	numResources = 0;
+	cpuBytes = 0;
+	gpuBytes = 0;
+	
+	for( size_t i = 0, s = _resources.size(); i < s; ++i )
+	{
+		Resource *res = _resources[i];
+		if( res == 0x0 || (type != ResourceTypes::Undefined && res->_type != type) ) continue;
+
+		uint64 resCPUBytes = 0, resGPUBytes = 0;
+		res->getMemoryUsage( resCPUBytes, resGPUBytes );
+
+		++numResources;
+		cpuBytes += resCPUBytes;
+		gpuBytes += resGPUBytes;
+	}
+}
+
+
+void ResourceManager::checkMemoryBudget()
+{
+	int budget = Modules::config().resourceMemoryBudget;
+	if( budget <= 0 )
+	{
+		_budgetExceeded = false;
+		return;
+	}
+	
+	int numResources;
+	uint64 cpuBytes, gpuBytes;
+	getMemoryUsage( ResourceTypes::Undefined, numResources, cpuBytes, gpuBytes );
+
+	// Warn only once until the usage drops below the budget again
+	bool exceeded = cpuBytes + gpuBytes > (uint64)budget * 1024 * 1024;
+	if( exceeded && !_budgetExceeded )
+	{
+		Modules::log().writeWarning( "Resource memory budget of %i Mb exceeded: %.1f Mb CPU, %.1f Mb GPU",
+			budget, cpuBytes / (1024.0f * 1024.0f), gpuBytes / (1024.0f * 1024.0f) );
+	}
+	_budgetExceeded = exceeded;
+}
+
 }  // namespace
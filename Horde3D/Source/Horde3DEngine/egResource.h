@@ -44,6 +44,16 @@ struct ResourceTypes
 	};
 };
 
+struct ResourceMemory
+{
+	enum List
+	{
+		MemoryElem = 100,
+		CPUMemoryI,
+		GPUMemoryI
+	};
+};
+
 struct ResourceFlags
 {
 	enum Flags
@@ -83,12 +93,20 @@ public:
 	virtual void setElemParamStr( int elem, int elemIdx, int param, const char *value );
 	virtual void *mapStream( int elem, int elemIdx, int stream, bool read, bool write );
 	virtual void unmapStream();
+	// Number of bytes of the stream that is currently mapped for writing, 0 if there is none
+	virtual uint32 getMappedWriteSize() const { return 0; }
+
+	// Estimated number of bytes used by the resource in system memory and video memory
+	virtual void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	int getType() const { return _type; }
 	int getFlags() const { return _flags; }
 	const std::string &getName() const { return _name; }
 	ResHandle getHandle() const { return _handle; }
 	bool isLoaded() const { return _loaded; }
+	// Unique value that changes whenever the resource is loaded, unloaded or modified through the API
+	uint32 getUpdateStamp() const { return _updateStamp; }
+	void markUpdated();
 	void addRef() { ++_refCount; }
     void subRef() { ASSERT(_refCount > 0 ); --_refCount; }
 
@@ -100,6 +118,7 @@ protected:
 	
 	uint32               _refCount;  // Number of other objects referencing this resource
 	uint32               _userRefCount;  // Number of handles created by user
+	uint32               _updateStamp;
 
 	bool                 _loaded;
 	bool                 _noQuery;
@@ -177,6 +196,9 @@ public:
 	void clear();
 	ResHandle queryUnloadedResource( int index ) const;
 	void releaseUnusedResources();
+	void getMemoryUsage( int type, int &numResources, uint64 &cpuBytes, uint64 &gpuBytes ) const;
+	void checkMemoryBudget();
+	uint32 nextUpdateStamp() { return ++_updateCounter; }
 
 	Resource *resolveResHandle( ResHandle handle ) const
 		{ return (handle != 0 && (unsigned)(handle - 1) < _resources.size()) ? _resources[handle - 1] : 0x0; }
@@ -189,6 +211,8 @@ protected:
 protected:
 	std::vector < Resource * >         _resources;
 	std::map< int, ResourceRegEntry >  _registry;  // Registry of resource types
+	bool                               _budgetExceeded;  // Budget warning was already issued
+	uint32                             _updateCounter;
 };
 
 }
@@ -17,7 +17,12 @@
 #include "egParticle.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
+#include "utBVH.h"
+#include "egJobs.h"
+#include <algorithm>
+#include <atomic>
 
 #include "utDebug.h"
 
@@ -26,13 +31,16 @@ namespace Horde3D {
 
 using namespace std;
 
+// Number of rays below which h3dCastRays does not split the work into jobs
+const int RayQueryGrainSize = 32;
+
 // *************************************************************************************************
 // Class SceneNode
 // *************************************************************************************************
 
 SceneNode::SceneNode( const SceneNodeTpl &tpl ) :
 	_name( tpl.name ), _attachment( tpl.attachmentString ), _parent( 0x0 ), _type( tpl.type ),
-	_handle( 0 ), _sgHandle( 0 ), _flags( 0 ), _sortKey( 0 ), _dirty( true ), _transformed( true ),
+	_handle( 0 ), _sgHandle( 0 ), _flags( 0 ), _updateStamp( 0 ), _sortKey( 0 ), _dirty( true ), _transformed( true ),
 	_renderable( false ), _lodSupported( false ), _occlusionCullingSupported( false )
 {
 	_relTrans = Matrix4f::ScaleMat( tpl.scale.x, tpl.scale.y, tpl.scale.z );
@@ -238,6 +246,9 @@ void SceneNode::updateTree()
 	
 	Modules::sceneMan().updateSpatialNode( _sgHandle );
 
+	// Renderer caches compare stamps instead of consuming the transformation flag of the application
+	_updateStamp = Modules::sceneMan().nextUpdateStamp();
+
 	onPostUpdate();
 
 	_dirty = false;
@@ -625,7 +636,7 @@ void SpatialGraph::setCurrentView( int viewID )
 // Class SceneManager
 // *************************************************************************************************
 
-SceneManager::SceneManager() : _rayNum( 0 ), _spatialGraph( nullptr )
+SceneManager::SceneManager() : _spatialGraph( nullptr ), _updateCounter( 0 )
 {
 	SceneNode *rootNode = GroupNode::factoryFunc( GroupNodeTpl( "RootNode" ) );
 	rootNode->_handle = RootNode;
@@ -696,6 +707,8 @@ NodeRegEntry *SceneManager::findType( const string &typeString )
 
 void SceneManager::updateNodes()
 {
+	H3D_PROFILE_ZONE( "SceneManager::updateTree" );
+
 	getRootNode().updateTree();
 }
 
@@ -921,63 +934,120 @@ int SceneManager::findNodes( SceneNode &startNode, const string &name, int type
 }
 
 
-void SceneManager::castRayInternal( SceneNode &node )
+void SceneManager::collectRayQueryNodes( SceneNode &node, int ignoreFlags, vector< SceneNode * > &nodes ) const
 {
-	if( !(node._flags & SceneNodeFlags::NoRayQuery) )
-	{
-		Vec3f intsPos;
-		if( node.checkIntersection( _rayOrigin, _rayDirection, intsPos ) )
-		{
-			float dist = (intsPos - _rayOrigin).length();
+	if( node._flags & (SceneNodeFlags::NoRayQuery | ignoreFlags) ) return;
 
-			CastRayResult crr;
-			crr.node = &node;
-			crr.distance = dist;
-			crr.intersection = intsPos;
+	nodes.push_back( &node );
 
-			bool inserted = false;
-			for( vector< CastRayResult >::iterator it = _castRayResults.begin(); it != _castRayResults.end(); ++it )
-			{
-				if( dist < it->distance )
-				{
-					_castRayResults.insert( it, crr );
-					inserted = true;
-					break;
-				}
-			}
+	for( size_t i = 0, s = node._children.size(); i < s; ++i )
+	{
+		collectRayQueryNodes( *node._children[i], ignoreFlags, nodes );
+	}
+}
 
-			if( !inserted )
-			{
-				_castRayResults.push_back( crr );
-			}
 
-			if( _rayNum > 0 && (int)_castRayResults.size() > _rayNum )
-			{
-				_castRayResults.pop_back();
-			}
-		}
+int SceneManager::castRay( SceneNode &node, const Vec3f &rayOrig, const Vec3f &rayDir, int numNearest )
+{
+	_castRayResults.resize( 0 );  // Clear without affecting capacity
+
+	vector< SceneNode * > nodes;
+	collectRayQueryNodes( node, 0, nodes );
 
-		for( size_t i = 0, s = node._children.size(); i < s; ++i )
+	for( size_t i = 0, s = nodes.size(); i < s; ++i )
+	{
+		CastRayResult crr;
+		if( nodes[i]->checkIntersection( rayOrig, rayDir, crr.intersection ) )
 		{
-			castRayInternal( *node._children[i] );
+			crr.node = nodes[i];
+			crr.distance = (crr.intersection - rayOrig).length();
+			_castRayResults.push_back( crr );
 		}
 	}
+
+	// Stable sort keeps the traversal order of equally distant intersections
+	stable_sort( _castRayResults.begin(), _castRayResults.end(),
+		[]( const CastRayResult &a, const CastRayResult &b ) { return a.distance < b.distance; } );
+	if( numNearest > 0 && (int)_castRayResults.size() > numNearest )
+		_castRayResults.resize( numNearest );
+
+	return (int)_castRayResults.size();
 }
 
 
-int SceneManager::castRay( SceneNode &node, const Vec3f &rayOrig, const Vec3f &rayDir, int numNearest )
+int SceneManager::castRays( SceneNode &node, const float *rays, uint32 count, RayHit *hits, int flags ) const
 {
-	_castRayResults.resize( 0 );  // Clear without affecting capacity
+	bool anyHit = (flags & RayQueryFlags::AnyHit) != 0;
 
-	if( node._flags & SceneNodeFlags::NoRayQuery ) return 0;
+	vector< SceneNode * > nodes;
+	collectRayQueryNodes( node, flags & ~RayQueryFlags::AnyHit, nodes );
 
-	_rayOrigin = rayOrig;
-	_rayDirection = rayDir;
-	_rayNum = numNearest;
+	// Rays are culled against a hierarchy of the node bounds
+	vector< Vec3f > bounds( nodes.size() * 2 );
+	for( size_t i = 0, s = nodes.size(); i < s; ++i )
+	{
+		bounds[i * 2 + 0] = nodes[i]->_bBox.min;
+		bounds[i * 2 + 1] = nodes[i]->_bBox.max;
+	}
 
-	castRayInternal( node );
+	BoxBVH bvh;
+	bvh.build( bounds.empty() ? 0x0 : &bounds[0], (uint32)nodes.size() );
 
-	return (int)_castRayResults.size();
+	atomic< int > numHits( 0 );
+
+	// All state of a query is local, so batches of rays can be run as jobs; small counts stay on the
+	// calling thread
+	Modules::jobMan().parallelFor( (int)count, RayQueryGrainSize, [&]( int begin, int end )
+	{
+		int localHits = 0;
+		
+		for( int i = begin; i < end; ++i )
+		{
+			Vec3f orig( rays[i * 6 + 0], rays[i * 6 + 1], rays[i * 6 + 2] );
+			Vec3f dir( rays[i * 6 + 3], rays[i * 6 + 4], rays[i * 6 + 5] );
+			float dirSqrLen = dir.dot( dir );
+
+			SceneNode *hitNode = 0x0;
+			Vec3f hitPos;
+			float t;
+
+			if( dirSqrLen > 0 )
+			{
+				bvh.intersect( orig, dir, t, anyHit, [&]( uint32 index, float &tMax )
+				{
+					Vec3f intsPos;
+					if( !nodes[index]->checkIntersection( orig, dir, intsPos ) ) return false;
+
+					float tHit = (intsPos - orig).dot( dir ) / dirSqrLen;
+					if( tHit > tMax ) return false;
+
+					tMax = tHit;
+					hitNode = nodes[index];
+					hitPos = intsPos;
+					return true;
+				} );
+			}
+
+			RayHit &hit = hits[i];
+			if( hitNode != 0x0 )
+			{
+				hit.node = hitNode->getHandle();
+				hit.distance = (hitPos - orig).length();
+				hit.intersection[0] = hitPos.x; hit.intersection[1] = hitPos.y; hit.intersection[2] = hitPos.z;
+				++localHits;
+			}
+			else
+			{
+				hit.node = 0;
+				hit.distance = 0;
+				hit.intersection[0] = 0; hit.intersection[1] = 0; hit.intersection[2] = 0;
+			}
+		}
+
+		numHits += localHits;
+	} );
+
+	return numHits;
 }
 
 
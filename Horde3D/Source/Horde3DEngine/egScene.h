@@ -66,7 +66,8 @@ struct SceneNodeFlags
 		NoDraw = 0x1,
 		NoCastShadow = 0x2,
 		NoRayQuery = 0x4,
-		Inactive = 0x7  // NoDraw | NoCastShadow | NoRayQuery
+		Inactive = 0x7,  // NoDraw | NoCastShadow | NoRayQuery
+		Occluder = 0x8
 	};
 };
 
@@ -166,6 +167,7 @@ protected:
 	NodeHandle                  _handle;
 	uint32                      _sgHandle;  // Spatial graph handle
 	uint32                      _flags;
+	uint32                      _updateStamp;  // Unique value that changes whenever the node is updated
 	float                       _sortKey;
 	bool                        _dirty;  // Does the node need to be updated?
 	bool                        _transformed;
@@ -321,6 +323,22 @@ struct CastRayResult
 	Vec3f      intersection;
 };
 
+// Layout is identical to H3DRayHit of the public API
+struct RayHit
+{
+	NodeHandle  node;
+	float       distance;
+	float       intersection[3];
+};
+
+struct RayQueryFlags
+{
+	enum List
+	{
+		AnyHit = 0x10000  // Stop at the first intersection found instead of the closest one
+	};
+};
+
 // =================================================================================================
 
 class SceneManager
@@ -349,6 +367,7 @@ public:
 	
 	int castRay( SceneNode &node, const Vec3f &rayOrig, const Vec3f &rayDir, int numNearest );
 	bool getCastRayResult( int index, CastRayResult &crr );
+	int castRays( SceneNode &node, const float *rays, uint32 count, RayHit *hits, int flags ) const;
 
 	int checkNodeVisibility( SceneNode &node, CameraNode &cam, bool checkOcclusion, bool calcLod );
 
@@ -379,11 +398,13 @@ public:
 	std::vector< SceneNode * > &getLightQueue() const { return _spatialGraph->getLightQueue(); }
 	RenderQueue &getRenderQueue() const { return _spatialGraph->getRenderQueue(); }
 
+	uint32 nextUpdateStamp() { return ++_updateCounter; }
+
 protected:
 	NodeHandle parseNode( SceneNodeTpl &tpl, SceneNode *parent );
 	void removeNodeRec( SceneNode &node );
 
-	void castRayInternal( SceneNode &node );
+	void collectRayQueryNodes( SceneNode &node, int ignoreFlags, std::vector< SceneNode * > &nodes ) const;
 
 protected:
 	std::vector< SceneNode *>      _nodes;  // _nodes[0] is root node
@@ -391,13 +412,10 @@ protected:
 	std::vector< SceneNode * >     _findResults;
 	std::vector< CastRayResult >   _castRayResults;
 	SpatialGraph                   *_spatialGraph;
+	uint32                         _updateCounter;  // Source of the node update stamps
 
 	std::map< int, NodeRegEntry >  _registry;  // Registry of node types
 
-	Vec3f                          _rayOrigin;  // Don't put these values on the stack during recursive search
-	Vec3f                          _rayDirection;  // Ditto
-	int                            _rayNum;  // Ditto
-
 	friend class Renderer;
 };
 
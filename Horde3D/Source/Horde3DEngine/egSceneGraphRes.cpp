@@ -13,6 +13,7 @@
 #include "egSceneGraphRes.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "utXML.h"
 #include "rapidxml_print.h"
 #include <iterator>
@@ -172,6 +173,8 @@ bool SceneGraphResource::parseNode( XMLNode &xmlNode, SceneNodeTpl *parentTpl )
 
 bool SceneGraphResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "SceneGraphResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 	
 	XMLDoc doc;
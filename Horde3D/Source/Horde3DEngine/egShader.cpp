@@ -13,7 +13,9 @@
 #include "egShader.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
+#include "utImageProc.h"
 #include <fstream>
 #include <cstring>
 
@@ -82,6 +84,8 @@ bool CodeResource::raiseError( const std::string &msg )
 
 bool CodeResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "CodeResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	char *code = new char[size+1];
@@ -228,6 +232,13 @@ std::string CodeResource::assembleCode() const
 }
 
 
+void CodeResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = _code.size();
+	gpuBytes = 0;
+}
+
+
 void CodeResource::updateShaders()
 {
 	auto resources = Modules::resMan().getResources();
@@ -382,6 +393,19 @@ protected:
 
 // =================================================================================================
 
+static const uint32 ProgramCacheVersion = 1;
+
+// Header of program binary cache files
+struct ProgramCacheHeader
+{
+	char    magic[4];
+	uint32  version;
+	uint64  key;
+	uint32  binaryFormat;
+	uint32  size;
+};
+
+
 string ShaderResource::_vertPreamble = "";
 string ShaderResource::_fragPreamble = "";
 string ShaderResource::_geomPreamble = "";
@@ -389,6 +413,10 @@ string ShaderResource::_tessCtlPreamble = "";
 string ShaderResource::_tessEvalPreamble = "";
 string ShaderResource::_computePreamble = "";
 bool ShaderResource::_defaultPreambleSet = false;
+unordered_map< string, int > ShaderResource::_contextIDs;
+vector< string > ShaderResource::_contextNames;
+uint32 ShaderResource::_programCacheLookups = 0;
+uint32 ShaderResource::_programCacheHits = 0;
 
 string ShaderResource::_tmpCodeVS = "";
 string ShaderResource::_tmpCodeFS = "";
@@ -421,6 +449,7 @@ void ShaderResource::initializationFunc()
 	// specify default version preamble for shaders
 	switch ( Modules::renderer().getRenderDeviceType() )
 	{
+		case RenderBackendType::Null:
 		case RenderBackendType::OpenGL4:
 		{
 			_vertPreamble = "#version 330\n";
@@ -783,6 +812,7 @@ bool ShaderResource::parseFXSectionContext( Tokenizer &tok, const char * identif
 
 	context.id = tok.getToken( identifier );
 	if ( context.id == "" ) return raiseError( "FX: Invalid identifier", tok.getLine() );
+	context.nameID = getContextID( context.id );
 
 	// Skip annotations
 	if ( tok.checkToken( "<" ) )
@@ -1015,8 +1045,11 @@ bool ShaderResource::parseFXSectionContext( Tokenizer &tok, const char * identif
 			return raiseError( "FX: Compute shader referenced by context '" + context.id + "' not found" );
 	}
 
-	// Skip contexts that are intended for other render interfaces
-	if ( Modules::renderer().getRenderDeviceType() == targetRenderBackend )
+	// Skip contexts that are intended for other render interfaces; the null device uses the desktop
+	// contexts, so that materials are processed like on a real device
+	int renderBackend = Modules::renderer().getRenderDeviceType();
+	if( renderBackend == RenderBackendType::Null ) renderBackend = RenderBackendType::OpenGL4;
+	if ( renderBackend == targetRenderBackend )
 	{
 		_contexts.push_back( context );
  	}
@@ -1026,6 +1059,8 @@ bool ShaderResource::parseFXSectionContext( Tokenizer &tok, const char * identif
 
 bool ShaderResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "ShaderResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 	
 	// Parse sections
@@ -1109,7 +1144,15 @@ bool ShaderResource::load( const char *data, int size )
 // 		counter--;
 // 	}
 
+	uint32 cacheLookups = _programCacheLookups, cacheHits = _programCacheHits;
 	compileContexts();
+
+	if( _programCacheLookups > cacheLookups )
+	{
+		Modules::log().writeInfo( "Shader resource '%s': %i of %i programs loaded from cache (%.0f%% hit rate since startup)",
+			_name.c_str(), _programCacheHits - cacheHits, _programCacheLookups - cacheLookups,
+			100.0f * _programCacheHits / _programCacheLookups );
+	}
 	
 	return true;
 }
@@ -1132,10 +1175,8 @@ void ShaderResource::preLoadCombination( uint32 combMask )
 }
 
 
-bool ShaderResource::compileCombination( ShaderContext &context, ShaderCombination &sc )
+void ShaderResource::assembleCombination( const ShaderContext &context, uint32 combMask )
 {
-	uint32 combMask = sc.combMask;
-	
 	// Add preamble
 	_tmpCodeVS = _vertPreamble;
 	_tmpCodeFS = _fragPreamble;
@@ -1202,42 +1243,22 @@ bool ShaderResource::compileCombination( ShaderContext &context, ShaderCombinati
 	}
 
 	// Add actual shader code
-	bool vsAvailable, fsAvailable, csAvailable, gsAvailable, tscAvailable, tseAvailable;
-	vsAvailable = fsAvailable = csAvailable = gsAvailable = tscAvailable = tseAvailable = false;
+	if ( context.vertCodeIdx >= 0 ) _tmpCodeVS += getCode( context.vertCodeIdx )->assembleCode();
+	if ( context.fragCodeIdx >= 0 ) _tmpCodeFS += getCode( context.fragCodeIdx )->assembleCode();
+	if ( context.geomCodeIdx >= 0 ) _tmpCodeGS += getCode( context.geomCodeIdx )->assembleCode();
+	if ( context.tessCtlCodeIdx >= 0 ) _tmpCodeTSCtl += getCode( context.tessCtlCodeIdx )->assembleCode();
+	if ( context.tessEvalCodeIdx >= 0 ) _tmpCodeTSEval += getCode( context.tessEvalCodeIdx )->assembleCode();
+	if ( context.computeCodeIdx >= 0 ) _tmpCodeCS += getCode( context.computeCodeIdx )->assembleCode();
+}
 
-	if ( context.vertCodeIdx >= 0 )
-	{
-		_tmpCodeVS += getCode( context.vertCodeIdx )->assembleCode();
-		vsAvailable = true;
-	}
-	if ( context.fragCodeIdx >= 0 )
-	{
-		_tmpCodeFS += getCode( context.fragCodeIdx )->assembleCode();
-		fsAvailable = true;
-	}
-	if ( context.geomCodeIdx >= 0 )
-	{
-		_tmpCodeGS += getCode( context.geomCodeIdx )->assembleCode();
-		gsAvailable = true;
-	}
-	if ( context.tessCtlCodeIdx >= 0 )
-	{
-		_tmpCodeTSCtl += getCode( context.tessCtlCodeIdx )->assembleCode();
-		tscAvailable = true;
-	}
-	if ( context.tessEvalCodeIdx >= 0 )
-	{
-		_tmpCodeTSEval += getCode( context.tessEvalCodeIdx )->assembleCode();
-		tseAvailable = true;
-	}
-	if ( context.computeCodeIdx >= 0 )
-	{
-		_tmpCodeCS += getCode( context.computeCodeIdx )->assembleCode();
-		csAvailable = true;
-	}
 
-	Modules::log().writeInfo( "---- C O M P I L I N G  . S H A D E R . %s@%s[%i] ----",
-		_name.c_str(), context.id.c_str(), sc.combMask );
+bool ShaderResource::compileCombination( ShaderContext &context, ShaderCombination &sc )
+{
+	assembleCombination( context, sc.combMask );
+
+	bool vsAvailable = context.vertCodeIdx >= 0, fsAvailable = context.fragCodeIdx >= 0;
+	bool gsAvailable = context.geomCodeIdx >= 0, csAvailable = context.computeCodeIdx >= 0;
+	bool tscAvailable = context.tessCtlCodeIdx >= 0, tseAvailable = context.tessEvalCodeIdx >= 0;
 	
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
@@ -1247,16 +1268,35 @@ bool ShaderResource::compileCombination( ShaderContext &context, ShaderCombinati
 		rdi->destroyShader( sc.shaderObj );
 		sc.shaderObj = 0;
 	}
+
+	// Try program binary from previous runs before compiling from source
+	uint64 cacheKey = 0;
+	bool compiled = false;
+	if( isProgramCacheEnabled() )
+	{
+		cacheKey = calcProgramKey( context );
+		compiled = loadCachedProgram( sc, cacheKey );
+		++_programCacheLookups;
+		if( compiled ) ++_programCacheHits;
+	}
 	
-	// Compile shader
-	bool compiled = Modules::renderer().createShaderComb( sc, 
-														  vsAvailable ? _tmpCodeVS.c_str() : 0,
-														  fsAvailable ? _tmpCodeFS.c_str() : 0,  
-														  gsAvailable ? _tmpCodeGS.c_str() : 0,
-														  tscAvailable ? _tmpCodeTSCtl.c_str() : 0,
-														  tseAvailable ? _tmpCodeTSEval.c_str() : 0,
-														  csAvailable ? _tmpCodeCS.c_str() : 0
-														  );
+	if( !compiled )
+	{
+		Modules::log().writeInfo( "---- C O M P I L I N G  . S H A D E R . %s@%s[%i] ----",
+			_name.c_str(), context.id.c_str(), sc.combMask );
+
+		// Compile shader
+		compiled = Modules::renderer().createShaderComb( sc, 
+														 vsAvailable ? _tmpCodeVS.c_str() : 0,
+														 fsAvailable ? _tmpCodeFS.c_str() : 0,  
+														 gsAvailable ? _tmpCodeGS.c_str() : 0,
+														 tscAvailable ? _tmpCodeTSCtl.c_str() : 0,
+														 tseAvailable ? _tmpCodeTSEval.c_str() : 0,
+														 csAvailable ? _tmpCodeCS.c_str() : 0
+														 );
+		if( compiled && cacheKey != 0 ) storeCachedProgram( sc, cacheKey );
+	}
+
 	if( !compiled )
 	{
 		Modules::log().writeError( "Shader resource '%s': Failed to compile shader context '%s' (comb %i)",
@@ -1396,6 +1436,127 @@ void ShaderResource::compileContexts()
 }
 
 
+bool ShaderResource::isProgramCacheEnabled()
+{
+	return !Modules::config().cacheDirectory.empty() &&
+	       Modules::renderer().getRenderDevice()->getCaps().programBinaries;
+}
+
+
+uint64 ShaderResource::calcProgramKey( const ShaderContext &context ) const
+{
+	// Binaries are only valid for the exact code, backend and driver they were created with
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	int header[2] = { (int)ProgramCacheVersion, Modules::renderer().getRenderDeviceType() };
+	uint64 key = ImageProc::hash( header, sizeof( header ) );
+	key = ImageProc::hash( rdi->getDriverString().c_str(), rdi->getDriverString().length(), key );
+
+	const string *codes[6] = { &_tmpCodeVS, &_tmpCodeFS, &_tmpCodeGS, &_tmpCodeTSCtl, &_tmpCodeTSEval, &_tmpCodeCS };
+	int codeIndices[6] = { context.vertCodeIdx, context.fragCodeIdx, context.geomCodeIdx,
+	                       context.tessCtlCodeIdx, context.tessEvalCodeIdx, context.computeCodeIdx };
+	for( uint32 i = 0; i < 6; ++i )
+	{
+		int available = codeIndices[i] >= 0 ? 1 : 0;
+		key = ImageProc::hash( &available, sizeof( available ), key );
+		if( available ) key = ImageProc::hash( codes[i]->c_str(), codes[i]->length(), key );
+	}
+
+	return key;
+}
+
+
+static string getProgramCacheFileName( uint64 key )
+{
+	char keyStr[32];
+	snprintf( keyStr, sizeof( keyStr ), "%016llx", (unsigned long long)key );
+	return Modules::config().cacheDirectory + "/" + keyStr + ".shb";
+}
+
+
+bool ShaderResource::loadCachedProgram( ShaderCombination &sc, uint64 key )
+{
+	ifstream inf( getProgramCacheFileName( key ).c_str(), ios::binary );
+	if( !inf.good() ) return false;
+
+	ProgramCacheHeader header;
+	inf.read( (char *)&header, sizeof( header ) );
+	if( !inf.good() || memcmp( header.magic, "H3DP", 4 ) != 0 || header.version != ProgramCacheVersion ||
+	    header.key != key || header.size == 0 )
+	{
+		return false;
+	}
+
+	vector< char > data( header.size );
+	inf.read( &data[0], header.size );
+	if( !inf.good() ) return false;
+
+	// Fails if the driver does not accept the binary anymore, e.g. after a driver update
+	return Modules::renderer().createShaderCombFromBinary( sc, header.binaryFormat, &data[0], header.size );
+}
+
+
+bool ShaderResource::storeCachedProgram( ShaderCombination &sc, uint64 key )
+{
+	ProgramCacheHeader header;
+	vector< char > data;
+	if( !Modules::renderer().getRenderDevice()->getShaderBinary( sc.shaderObj, &header.binaryFormat, &data ) )
+		return false;
+
+	memcpy( header.magic, "H3DP", 4 );
+	header.version = ProgramCacheVersion;
+	header.key = key;
+	header.size = (uint32)data.size();
+
+	ofstream outf( getProgramCacheFileName( key ).c_str(), ios::binary | ios::trunc );
+	outf.write( (const char *)&header, sizeof( header ) );
+	outf.write( &data[0], data.size() );
+	
+	return outf.good();
+}
+
+
+int ShaderResource::updateProgramCache()
+{
+	if( !isProgramCacheEnabled() ) return -1;
+	
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	int numStored = 0;
+
+	for( size_t i = 0; i < _contexts.size(); ++i )
+	{
+		ShaderContext &context = _contexts[i];
+		
+		for( size_t j = 0; j < context.shaderCombs.size(); ++j )
+		{
+			ShaderCombination &sc = context.shaderCombs[j];
+			if( sc.shaderObj == 0 ) continue;
+
+			assembleCombination( context, sc.combMask );
+			uint64 key = calcProgramKey( context );
+
+			// Existing entries are validated by letting the driver load them
+			ShaderCombination test;
+			if( loadCachedProgram( test, key ) )
+			{
+				Modules::renderer().releaseShaderComb( test );
+				continue;
+			}
+
+			if( storeCachedProgram( sc, key ) ) ++numStored;
+			else
+			{
+				Modules::log().writeWarning( "Shader resource '%s': Failed to store program binary of context '%s' (comb %i)",
+					_name.c_str(), context.id.c_str(), sc.combMask );
+			}
+		}
+	}
+
+	rdi->bindShader( 0 );
+	
+	return numStored;
+}
+
+
 ShaderCombination *ShaderResource::getCombination( ShaderContext &context, uint32 combMask )
 {
 	if( !context.compiled ) return 0x0;
@@ -1440,6 +1601,32 @@ uint32 ShaderResource::calcCombMask( const std::vector< std::string > &flags )
 }
 
 
+int ShaderResource::getContextID( const string &name )
+{
+	auto itr = _contextIDs.find( name );
+	if( itr != _contextIDs.end() ) return itr->second;
+
+	int id = (int)_contextIDs.size();
+	_contextIDs[name] = id;
+	_contextNames.push_back( name );
+	return id;
+}
+
+
+int ShaderResource::findContextID( const string &name )
+{
+	auto itr = _contextIDs.find( name );
+	return itr != _contextIDs.end() ? itr->second : -1;
+}
+
+
+const string &ShaderResource::getContextName( int id )
+{
+	static const string emptyName;
+	return id >= 0 && id < (int)_contextNames.size() ? _contextNames[id] : emptyName;
+}
+
+
 int ShaderResource::getElemCount( int elem ) const
 {
 	switch( elem )
@@ -17,6 +17,7 @@
 #include "egResource.h"
 #include "egTexture.h"
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
@@ -49,6 +50,7 @@ public:
 	bool hasDependency( CodeResource *codeRes ) const;
 	bool tryLinking( uint32 *flagMask );
 	std::string assembleCode() const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	bool isLoaded() const { return _loaded; }
 	const std::string &getCode() const { return _code; }
@@ -164,6 +166,7 @@ struct ShaderCombination
 struct ShaderContext
 {
 	std::string                       id;
+	int                               nameID;  // Interned id, see ShaderResource::getContextID
 	uint32                            flagMask;
 	
 	// RenderConfig
@@ -184,7 +187,7 @@ struct ShaderContext
 
 
 	ShaderContext() :
-		flagMask( 0 ), blendStateSrc( BlendModes::Zero ), blendStateDst( BlendModes::Zero ), depthFunc( TestModes::LessEqual ),
+		nameID( -1 ), flagMask( 0 ), blendStateSrc( BlendModes::Zero ), blendStateDst( BlendModes::Zero ), depthFunc( TestModes::LessEqual ),
 		cullMode( CullModes::Back ), tessVerticesInPatchCount( 1 ), depthTest( true ), writeDepth( true ), alphaToCoverage( false ), blendingEnabled( false ),
 		vertCodeIdx( -1 ), fragCodeIdx( -1 ), geomCodeIdx( -1 ), tessCtlCodeIdx( -1 ), tessEvalCodeIdx( -1 ), computeCodeIdx( -1 ), compiled( false )
 	{
@@ -246,6 +249,13 @@ public:
 	}
 
 	static uint32 calcCombMask( const std::vector< std::string > &flags );
+	// Maps a context name to an integer that is the same for all shaders; called for names that are
+	// defined by resources and nodes, so that the table does not grow with arbitrary lookups
+	static int getContextID( const std::string &name );
+	// Returns the id of a context name or -1 if no shader, pipeline or light uses it
+	static int findContextID( const std::string &name );
+	// Returns the name of a context id or an empty string for invalid ids
+	static const std::string &getContextName( int id );
 	
 	ShaderResource( const std::string &name, int flags );
 	~ShaderResource();
@@ -257,6 +267,9 @@ public:
 
 	void preLoadCombination( uint32 combMask );
 	void compileContexts();
+	// Stores all compiled combinations that are missing in the program cache or are rejected by the
+	// driver; returns the number of stored programs or -1 if the cache is not available
+	int updateProgramCache();
 	ShaderCombination *getCombination( ShaderContext &context, uint32 combMask );
 
 	int getElemCount( int elem ) const;
@@ -272,6 +285,13 @@ public:
 		
 		return 0x0;
 	}
+	ShaderContext *findContext( int nameID )
+	{
+		for( uint32 i = 0; i < _contexts.size(); ++i )
+			if( _contexts[i].nameID == nameID ) return &_contexts[i];
+		
+		return 0x0;
+	}
 
 	std::vector< ShaderContext > &getContexts() { return _contexts; }
 	CodeResource *getCode( uint32 index ) { return &_codeSections[index]; }
@@ -282,12 +302,22 @@ private:
 
 	bool parseFXSectionContext( Tokenizer &tok, const char * identifier, int targetRenderBackend );
 
+	void assembleCombination( const ShaderContext &context, uint32 combMask );
 	bool compileCombination( ShaderContext &context, ShaderCombination &sc );
+
+	// Program binary cache, keyed by the assembled code
+	static bool isProgramCacheEnabled();
+	uint64 calcProgramKey( const ShaderContext &context ) const;
+	bool loadCachedProgram( ShaderCombination &sc, uint64 key );
+	bool storeCachedProgram( ShaderCombination &sc, uint64 key );
 	
 private:
 	static std::string            _vertPreamble, _fragPreamble, _geomPreamble, _tessCtlPreamble, _tessEvalPreamble, _computePreamble;
 	static std::string            _tmpCodeVS, _tmpCodeFS, _tmpCodeGS, _tmpCodeCS, _tmpCodeTSCtl, _tmpCodeTSEval;
 	static bool					  _defaultPreambleSet;
+	static std::unordered_map< std::string, int >  _contextIDs;
+	static std::vector< std::string >              _contextNames;
+	static uint32                 _programCacheLookups, _programCacheHits;
 
 	std::vector< ShaderContext >  _contexts;
 	std::vector< ShaderSampler >  _samplers;
@@ -0,0 +1,216 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "egTexStreaming.h"
+#include "egTexture.h"
+#include "egMaterial.h"
+#include "egModules.h"
+#include "egCom.h"
+#include <algorithm>
+#include <queue>
+#include <cmath>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+// Maximum amount of texture data uploaded per frame when raising resident levels
+static const uint64 MaxStreamUploadPerFrame = 32 * 1024 * 1024;
+
+// Factor by which the screen-space demand of an unused texture decays each frame
+static const float StreamDemandDecay = 0.95f;
+
+// *************************************************************************************************
+// Class TexResidencyPolicy
+// *************************************************************************************************
+
+uint64 TexResidencyItem::calcChainSize( uint32 level ) const
+{
+	uint64 size = 0;
+	for( uint32 i = level; i < numLevels; ++i ) size += levelSizes[i];
+	return size;
+}
+
+
+float TexResidencyPolicy::solve( vector< TexResidencyItem > &items, uint64 budget )
+{
+	uint64 demand = 0;
+	for( size_t i = 0; i < items.size(); ++i )
+	{
+		TexResidencyItem &item = items[i];
+		ASSERT( item.numLevels <= MaxStreamedMipLevels && item.floorLevel < item.numLevels );
+
+		item.targetLevel = std::min( item.desiredLevel, item.floorLevel );
+		demand += item.calcChainSize( item.targetLevel );
+	}
+	uint64 total = demand;
+
+	if( total > budget )
+	{
+		// Min-heap of candidate levels ordered by priority lost per byte freed
+		typedef pair< float, size_t > Candidate;
+		priority_queue< Candidate, vector< Candidate >, greater< Candidate > > candidates;
+
+		for( size_t i = 0; i < items.size(); ++i )
+		{
+			const TexResidencyItem &item = items[i];
+			if( item.targetLevel < item.floorLevel )
+				candidates.push( Candidate( item.priority / std::max( item.levelSizes[item.targetLevel], 1u ), i ) );
+		}
+
+		while( total > budget && !candidates.empty() )
+		{
+			size_t idx = candidates.top().second;
+			TexResidencyItem &item = items[idx];
+			candidates.pop();
+
+			total -= item.levelSizes[item.targetLevel];
+			++item.targetLevel;
+
+			if( item.targetLevel < item.floorLevel )
+			{
+				candidates.push( Candidate( item.priority / std::max( item.levelSizes[item.targetLevel], 1u ), idx ) );
+			}
+		}
+	}
+
+	return budget > 0 ? (float)((double)demand / (double)budget) : 0.0f;
+}
+
+
+// *************************************************************************************************
+// Class TextureStreamer
+// *************************************************************************************************
+
+TextureStreamer::TextureStreamer() :
+	_pressure( 0 ), _residentMem( 0 )
+{
+}
+
+
+void TextureStreamer::registerTexture( TextureResource *texRes )
+{
+	if( find( _textures.begin(), _textures.end(), texRes ) == _textures.end() )
+		_textures.push_back( texRes );
+}
+
+
+void TextureStreamer::unregisterTexture( TextureResource *texRes )
+{
+	vector< TextureResource * >::iterator itr = find( _textures.begin(), _textures.end(), texRes );
+	if( itr != _textures.end() )
+	{
+		*itr = _textures.back();
+		_textures.pop_back();
+	}
+}
+
+
+void TextureStreamer::noteMaterialUsage( MaterialResource *matRes, float screenSize )
+{
+	// Follow material links but guard against cycles
+	for( uint32 depth = 0; matRes != 0x0 && depth < 4; ++depth )
+	{
+		for( size_t i = 0, s = matRes->_samplers.size(); i < s; ++i )
+		{
+			TextureResource *texRes = matRes->_samplers[i].texRes;
+			if( texRes != 0x0 && texRes->isStreamed() ) texRes->noteStreamUsage( screenSize );
+		}
+		matRes = matRes->_matLink;
+	}
+}
+
+
+uint32 TextureStreamer::calcDesiredLevel( uint32 width, uint32 height, uint32 floorLevel, float screenSize )
+{
+	// Assume that the texture is mapped once across the projected extent of the mesh; one level
+	// of bias accounts for tiling and oblique surfaces
+	if( screenSize < 1.0f ) return floorLevel;
+
+	float ratio = (float)std::max( width, height ) / screenSize;
+	if( ratio <= 2.0f ) return 0;
+
+	uint32 level = (uint32)floorf( log2f( ratio ) ) - 1;
+	return std::min( level, floorLevel );
+}
+
+
+void TextureStreamer::update()
+{
+	_pressure = 0;
+	_residentMem = 0;
+	if( _textures.empty() ) return;
+
+	// Streaming was disabled after the textures were loaded; they keep their full mip chain then
+	if( Modules::config().texStreamingBudget == 0 )
+	{
+		for( size_t i = 0; i < _textures.size(); ++i )
+		{
+			_textures[i]->setResidentMip( 0 );
+			_residentMem += _textures[i]->_streamData.size();
+		}
+		return;
+	}
+
+	uint64 budget = (uint64)Modules::config().texStreamingBudget * 1024 * 1024;
+
+	// Gather residency requests
+	_items.resize( _textures.size() );
+	for( size_t i = 0; i < _textures.size(); ++i )
+	{
+		TextureResource *texRes = _textures[i];
+		TexResidencyItem &item = _items[i];
+
+		texRes->_streamDemand = std::max( texRes->_streamFrameDemand, texRes->_streamDemand * StreamDemandDecay );
+		texRes->_streamFrameDemand = 0;
+
+		item.numLevels = texRes->getMaxMipLevel() + 1;
+		item.floorLevel = texRes->getStreamFloorMip();
+		item.desiredLevel = calcDesiredLevel( texRes->getWidth(), texRes->getHeight(), item.floorLevel,
+		                                      texRes->_streamDemand );
+		item.priority = texRes->_streamDemand;
+		for( uint32 j = 0; j < item.numLevels; ++j )
+			item.levelSizes[j] = texRes->getStreamLevelSize( j );
+	}
+
+	_pressure = TexResidencyPolicy::solve( _items, budget );
+
+	// Release memory first, then raise levels of the most important textures within upload limit
+	vector< size_t > raises;
+	for( size_t i = 0; i < _items.size(); ++i )
+	{
+		uint32 resident = _textures[i]->getResidentMip();
+		if( _items[i].targetLevel > resident )
+			_textures[i]->setResidentMip( _items[i].targetLevel );
+		else if( _items[i].targetLevel < resident )
+			raises.push_back( i );
+	}
+
+	sort( raises.begin(), raises.end(), [this]( size_t a, size_t b )
+		{ return _items[a].priority > _items[b].priority; } );
+
+	uint64 uploaded = 0;
+	for( size_t i = 0; i < raises.size() && uploaded < MaxStreamUploadPerFrame; ++i )
+	{
+		const TexResidencyItem &item = _items[raises[i]];
+		if( _textures[raises[i]]->setResidentMip( item.targetLevel ) )
+			uploaded += item.calcChainSize( item.targetLevel );
+	}
+
+	for( size_t i = 0; i < _items.size(); ++i )
+		_residentMem += _items[i].calcChainSize( _textures[i]->getResidentMip() );
+}
+
+}  // namespace
@@ -0,0 +1,93 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _egTexStreaming_H_
+#define _egTexStreaming_H_
+
+#include "egPrerequisites.h"
+#include <vector>
+
+
+namespace Horde3D {
+
+class TextureResource;
+class MaterialResource;
+
+const uint32 MaxStreamedMipLevels = 16;
+
+// =================================================================================================
+// Texture Residency Policy
+// =================================================================================================
+
+// Input and output of the residency policy for a single texture. Mip levels are counted from the
+// finest level 0; a texture with resident level n has levels n to numLevels - 1 in video memory.
+struct TexResidencyItem
+{
+	uint32  levelSizes[MaxStreamedMipLevels];  // Memory size of each mip level
+	uint32  numLevels;
+	uint32  floorLevel;     // Coarsest level that is always resident
+	uint32  desiredLevel;   // Level required by the current screen-space usage
+	float   priority;       // Importance of the texture, e.g. its screen-space size in pixels
+	uint32  targetLevel;    // Result: level that should be resident
+
+	TexResidencyItem() : numLevels( 0 ), floorLevel( 0 ), desiredLevel( 0 ), priority( 0 ), targetLevel( 0 )
+	{
+		for( uint32 i = 0; i < MaxStreamedMipLevels; ++i ) levelSizes[i] = 0;
+	}
+
+	uint64 calcChainSize( uint32 level ) const;
+};
+
+// The policy does not depend on a render device so that it can be evaluated offline
+class TexResidencyPolicy
+{
+public:
+	// Computes the target levels of all items so that their total size fits into budget bytes.
+	// Textures start at their desired level; if the budget is exceeded, the level whose removal
+	// costs the least priority per freed byte is dropped until the budget is met or all textures
+	// are at their floor level. Returns the budget pressure, which is the memory requested by the
+	// desired levels divided by the budget.
+	static float solve( std::vector< TexResidencyItem > &items, uint64 budget );
+};
+
+// =================================================================================================
+// Texture Streamer
+// =================================================================================================
+
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+
+	void registerTexture( TextureResource *texRes );
+	void unregisterTexture( TextureResource *texRes );
+
+	// Records that a material is visible with the given projected size in pixels
+	void noteMaterialUsage( MaterialResource *matRes, float screenSize );
+
+	// Updates the resident levels of all streamed textures; called once per frame
+	void update();
+
+	float getPressure() const { return _pressure; }
+	uint64 getResidentMem() const { return _residentMem; }
+
+	static uint32 calcDesiredLevel( uint32 width, uint32 height, uint32 floorLevel, float screenSize );
+
+protected:
+	std::vector< TextureResource * >  _textures;
+	std::vector< TexResidencyItem >   _items;
+	float                             _pressure;
+	uint64                            _residentMem;
+};
+
+}
+#endif // _egTexStreaming_H_
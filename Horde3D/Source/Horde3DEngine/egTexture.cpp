@@ -14,9 +14,14 @@
 #include "egTexture.h"
 #include "egModules.h"
 #include "egCom.h"
+#include "egProfiler.h"
 #include "egRenderer.h"
+#include "egJobs.h"
 #include "utImage.h"
+#include "utImageProc.h"
 #include <cstring>
+#include <cstdio>
+#include <fstream>
 
 #include "utDebug.h"
 #include <array>
@@ -36,12 +41,20 @@ using namespace std;
 //
 #define FOURCC( c0, c1, c2, c3 ) ((c0) | (c1<<8) | (c2<<16) | (c3<<24))
 
+#define DDSD_CAPS             0x00000001
+#define DDSD_HEIGHT           0x00000002
+#define DDSD_WIDTH            0x00000004
+#define DDSD_PIXELFORMAT      0x00001000
 #define DDSD_MIPMAPCOUNT      0x00020000
 
 #define DDPF_ALPHAPIXELS      0x00000001
 #define DDPF_FOURCC           0x00000004
 #define DDPF_RGB              0x00000040
 
+#define DDSCAPS_COMPLEX       0x00000008
+#define DDSCAPS_TEXTURE       0x00001000
+#define DDSCAPS_MIPMAP        0x00400000
+
 #define DDSCAPS2_CUBEMAP      0x00000200
 #define DDSCAPS2_CM_COMPLETE  (0x00000400 | 0x00000800 | 0x00001000 | 0x00002000 | 0x00004000 | 0x00008000)
 #define DDSCAPS2_VOLUME       0x00200000
@@ -148,6 +161,9 @@ uint32 TextureResource::defTex3DObject = 0;
 uint32 TextureResource::defTexCubeObject = 0;
 bool TextureResource::bgraSwizzleRequired = true;
 
+// Streamed textures always keep the mip levels up to this size resident
+static const uint32 StreamFloorSize = 64;
+
 void TextureResource::initializationFunc()
 {
 	unsigned char texData[] = 
@@ -208,7 +224,8 @@ TextureResource::TextureResource( const string &name, int flags ) :
 TextureResource::TextureResource( const string &name, uint32 width, uint32 height, uint32 depth,
                                   TextureFormats::List fmt, int flags ) :
 	Resource( ResourceTypes::Texture, name, flags ),
-	_width( width ), _height( height ), _depth( depth ), _rbObj( 0 )
+	_width( width ), _height( height ), _depth( depth ), _rbObj( 0 ),
+	_residentMip( 0 ), _streamDemand( 0 ), _streamFrameDemand( 0 )
 {	
 	_loaded = true;
 	_texFormat = fmt;
@@ -265,6 +282,9 @@ void TextureResource::initDefault()
 	_width = 0; _height = 0; _depth = 0;
 	_sRGB = false;
 	_maxMipLevel = 0;
+	_residentMip = 0;
+	_streamDemand = 0;
+	_streamFrameDemand = 0;
 	
 	if( _texType == TextureTypes::TexCube )
 		_texObject = defTexCubeObject;
@@ -289,6 +309,13 @@ void TextureResource::release()
 		rdi->destroyTexture( _texObject );
 	}
 
+	if( isStreamed() )
+	{
+		Modules::renderer().getTexStreamer().unregisterTexture( this );
+		vector< unsigned char >().swap( _streamData );
+		_streamOffsets.clear();
+	}
+
 	_texObject = 0;
 }
 
@@ -453,12 +480,16 @@ bool TextureResource::loadDDS( const char *data, int size )
 		return raiseError( "Unsupported DDS pixel format" );
 
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	bool stream = canStream();
 
-	// Create texture
-	_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
-	                                 _maxMipLevel, false, false, _sRGB );
+	// Create texture; streamed textures are created once the mip chain is complete
+	if( !stream )
+	{
+		_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
+		                                 _maxMipLevel, false, false, _sRGB );
 	
-	if ( _texObject == 0 ) return raiseError( "Failed to create DDS texture" );
+		if ( _texObject == 0 ) return raiseError( "Failed to create DDS texture" );
+	}
 
 	// Upload texture subresources
 	int numSlices = _texType == TextureTypes::TexCube ? 6 : 1;
@@ -500,7 +531,14 @@ bool TextureResource::loadDDS( const char *data, int size )
 					for( uint32 k = 0; k < pixCount * 4; k += 4 )
 						*p++ = pixels[k+2] | pixels[k+1]<<8 | pixels[k+0]<<16 | pixels[k+3]<<24;
 				
-				rdi->uploadTextureData( _texObject, i, j, dstBuf );
+				if( stream )
+					addStreamLevel( dstBuf, pixCount * 4 );
+				else
+					rdi->uploadTextureData( _texObject, i, j, dstBuf );
+			}
+			else if( stream )
+			{
+				addStreamLevel( pixels, mipSize );
 			}
 			else
 			{
@@ -519,6 +557,8 @@ bool TextureResource::loadDDS( const char *data, int size )
 
 	ASSERT( pixels == (unsigned char *)data + size );
 
+	if( stream ) return beginStreaming();
+
 	return true;
 }
 
@@ -593,12 +633,16 @@ bool TextureResource::loadKTX( const char *data, int size )
 		return raiseError( "Unsupported KTX pixel format" );
 	
 	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	bool stream = canStream();
 
-	// Create texture
-	_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
-		_maxMipLevel, false, false, _sRGB );
+	// Create texture; streamed textures are created once the mip chain is complete
+	if( !stream )
+	{
+		_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
+			_maxMipLevel, false, false, _sRGB );
 
-	if ( _texObject == 0 ) return raiseError( "Failed to create KTX texture" );
+		if ( _texObject == 0 ) return raiseError( "Failed to create KTX texture" );
+	}
 
 	//uint32 sliceCount = _texType == TextureTypes::TexCube ? 6 : 1;
 	unsigned char *pixels = ( unsigned char * ) ( data + sizeof( KTXHeader ) + ktxHeader.bytesOfKeyValueData );
@@ -634,7 +678,14 @@ bool TextureResource::loadKTX( const char *data, int size )
 							for ( uint32 k = 0; k < pixCount * 4; k += 4 )
 								*p++ = pixels[ k + 2 ] | pixels[ k + 1 ] << 8 | pixels[ k + 0 ] << 16 | pixels[ k + 3 ] << 24;
 
-						rdi->uploadTextureData( _texObject, slice, mip, dstBuf );
+						if ( stream )
+							addStreamLevel( dstBuf, pixCount * 4 );
+						else
+							rdi->uploadTextureData( _texObject, slice, mip, dstBuf );
+					}
+					else if ( stream )
+					{
+						addStreamLevel( pixels, mipSize );
 					}
 					else
 					{
@@ -655,6 +706,8 @@ bool TextureResource::loadKTX( const char *data, int size )
 	if ( dstBuf != 0x0 ) delete[] dstBuf;
 
 	ASSERT( pixels == ( unsigned char * ) data + size );
+
+	if ( stream ) return beginStreaming();
 	return true;
 }
 
@@ -664,6 +717,36 @@ bool TextureResource::loadSTBI( const char *data, int size )
 	bool hdr = false;
 	if( stbi_is_hdr_from_memory( (unsigned char *)data, size ) > 0 ) hdr = true;
 	
+	const EngineConfig &config = Modules::config();
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+
+	_depth = 1;
+	_texType = TextureTypes::Tex2D;
+	_texFormat = hdr ? TextureFormats::RGBA16F : TextureFormats::BGRA8;
+	_sRGB = (_flags & ResourceFlags::TexSRGB) != 0;
+	
+	// Decide if 8 bit images go through the CPU pipeline (mipmap generation and DXT encoding)
+	bool mipmaps = !(_flags & ResourceFlags::NoTexMipmaps);
+	bool compress = !hdr && config.texCompression && !(_flags & ResourceFlags::NoTexCompression) &&
+	                rdi->getCaps().texDXT;
+	int mipFilter = hdr || !mipmaps ? MipFilters::Driver : config.texMipmapFilter;
+	if( compress && mipmaps && mipFilter == MipFilters::Driver ) mipFilter = MipFilters::Box;
+	
+	string cacheFileName;
+	if( (compress || mipFilter != MipFilters::Driver) && !config.cacheDirectory.empty() )
+	{
+		// Key cache entries by source data and every setting that influences the result
+		int settings[] = { 1, compress, mipFilter, _sRGB, mipmaps, bgraSwizzleRequired };
+		uint64 key = ImageProc::hash( data, size );
+		key = ImageProc::hash( settings, sizeof( settings ), key );
+		
+		char keyStr[32];
+		snprintf( keyStr, sizeof( keyStr ), "%016llx", key );
+		cacheFileName = config.cacheDirectory + "/" + keyStr + ".dds";
+
+		if( loadCached( cacheFileName ) ) return true;
+	}
+
 	int comps;
 	void *pixels = 0x0;
 	if( hdr )
@@ -674,24 +757,18 @@ bool TextureResource::loadSTBI( const char *data, int size )
 	if( pixels == 0x0 )
 		return raiseError( "Invalid image format (" + string( stbi_failure_reason() ) + ")" );
 
-	// Swizzle RGBA -> BGRA if required
-	if ( bgraSwizzleRequired )
+	_maxMipLevel = mipmaps ? getMaxAtMipFullLevel() : 0;
+
+	if( compress || mipFilter != MipFilters::Driver )
 	{
-		uint32 *ptr = ( uint32 * ) pixels;
-		for ( uint32 i = 0, si = _width * _height; i < si; ++i )
-		{
-			uint32 col = *ptr;
-			*ptr++ = ( col & 0xFF00FF00 ) | ( ( col & 0x000000FF ) << 16 ) | ( ( col & 0x00FF0000 ) >> 16 );
-		}
+		bool result = uploadProcessed( (unsigned char *)pixels, compress, mipFilter, cacheFileName );
+		stbi_image_free( pixels );
+		return result;
 	}
-	
-	_depth = 1;
-	_texType = TextureTypes::Tex2D;
-	_texFormat = hdr ? TextureFormats::RGBA16F : TextureFormats::BGRA8;
-	_sRGB = (_flags & ResourceFlags::TexSRGB) != 0;
-	_maxMipLevel = (_flags & ResourceFlags::NoTexMipmaps) ? 0 : getMaxAtMipFullLevel();
 
-	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	// Swizzle RGBA -> BGRA if required
+	if ( bgraSwizzleRequired && !hdr )
+		ImageProc::swizzleRedBlue( (uint32 *)pixels, (size_t)_width * _height );
 
 	// Create and upload texture
 	_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
@@ -704,8 +781,156 @@ bool TextureResource::loadSTBI( const char *data, int size )
 }
 
 
+bool TextureResource::loadCached( const string &fileName )
+{
+	ifstream inf( fileName.c_str(), ios::binary | ios::ate );
+	if( !inf.good() ) return false;
+
+	streamoff fileSize = inf.tellg();
+	if( fileSize <= 128 ) return false;
+	
+	vector< char > buf( (size_t)fileSize );
+	inf.seekg( 0 );
+	inf.read( &buf[0], fileSize );
+	if( !inf.good() || !checkDDS( &buf[0], (int)fileSize ) ) return false;
+
+	if( !loadDDS( &buf[0], (int)fileSize ) )
+	{
+		Modules::log().writeWarning( "Texture resource '%s': ignoring invalid cache entry '%s'",
+		                             _name.c_str(), fileName.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+
+bool TextureResource::uploadProcessed( unsigned char *pixels, bool compress, int mipFilter,
+                                       const string &cacheFileName )
+{
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	
+	// Rows are processed by the job system of the engine
+	ImageProc::ParallelForFunc parallelFor = []( int count, int grainSize, const ImageProc::RangeFunc &func )
+		{ Modules::jobMan().parallelFor( count, grainSize, func ); };
+
+	vector< ImageLevel > mips;
+	if( _maxMipLevel > 0 )
+	{
+		ImageProc::generateMips( pixels, _width, _height, _maxMipLevel, (MipFilters::List)mipFilter,
+		                         _sRGB, mips, parallelFor );
+	}
+
+	// Gather final data of all levels
+	vector< const unsigned char * > levelData( _maxMipLevel + 1 );
+	vector< size_t > levelSizes( _maxMipLevel + 1 );
+	vector< vector< unsigned char > > encoded;
+	
+	if( compress )
+	{
+		bool alpha = ImageProc::hasTranslucency( pixels, (size_t)_width * _height );
+		_texFormat = alpha ? TextureFormats::DXT5 : TextureFormats::DXT1;
+		encoded.resize( _maxMipLevel + 1 );
+		
+		for( uint32 i = 0; i <= _maxMipLevel; ++i )
+		{
+			int width = i > 0 ? mips[i - 1].width : _width;
+			int height = i > 0 ? mips[i - 1].height : _height;
+			encoded[i].resize( ImageProc::calcBCSize( width, height, alpha ) );
+			ImageProc::encodeBC( i > 0 ? &mips[i - 1].data[0] : pixels, width, height, alpha, &encoded[i][0],
+			                     parallelFor );
+			levelData[i] = &encoded[i][0];
+			levelSizes[i] = encoded[i].size();
+		}
+	}
+	else
+	{
+		for( uint32 i = 0; i <= _maxMipLevel; ++i )
+		{
+			unsigned char *level = i > 0 ? &mips[i - 1].data[0] : pixels;
+			size_t pixCount = i > 0 ? mips[i - 1].data.size() / 4 : (size_t)_width * _height;
+			if( bgraSwizzleRequired ) ImageProc::swizzleRedBlue( (uint32 *)level, pixCount );
+			levelData[i] = level;
+			levelSizes[i] = pixCount * 4;
+		}
+	}
+
+	if( canStream() )
+	{
+		for( uint32 i = 0; i <= _maxMipLevel; ++i )
+			addStreamLevel( levelData[i], levelSizes[i] );
+		if( !beginStreaming() ) return false;
+	}
+	else
+	{
+		_texObject = rdi->createTexture( _texType, _width, _height, _depth, _texFormat,
+			_maxMipLevel, false, false, _sRGB );
+		if( _texObject == 0 ) return raiseError( "Failed to create texture" );
+
+		for( uint32 i = 0; i <= _maxMipLevel; ++i )
+			rdi->uploadTextureData( _texObject, 0, i, levelData[i] );
+	}
+
+	if( cacheFileName.empty() ) return true;
+
+	// Store result as DDS; uncompressed data is written in upload byte order, which is BGRA
+	// except for backends that do not require swizzling, whose cache entries are keyed separately
+	DDSHeader header;
+	memset( &header, 0, sizeof( DDSHeader ) );
+	header.dwMagic = FOURCC( 'D', 'D', 'S', ' ' );
+	header.dwSize = 124;
+	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+	                 (_maxMipLevel > 0 ? DDSD_MIPMAPCOUNT : 0);
+	header.dwHeight = _height;
+	header.dwWidth = _width;
+	header.dwMipMapCount = _maxMipLevel + 1;
+	header.pixFormat.dwSize = 32;
+	if( compress )
+	{
+		header.pixFormat.dwFlags = DDPF_FOURCC;
+		header.pixFormat.dwFourCC = _texFormat == TextureFormats::DXT5 ?
+			FOURCC( 'D', 'X', 'T', '5' ) : FOURCC( 'D', 'X', 'T', '1' );
+	}
+	else
+	{
+		header.pixFormat.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		header.pixFormat.dwRGBBitCount = 32;
+		header.pixFormat.dwRBitMask = 0x00ff0000;
+		header.pixFormat.dwGBitMask = 0x0000ff00;
+		header.pixFormat.dwBBitMask = 0x000000ff;
+		header.pixFormat.dwABitMask = 0xff000000;
+	}
+	header.caps.dwCaps = DDSCAPS_TEXTURE | (_maxMipLevel > 0 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	DDSHeader headerLE;
+	elemcpy_le( (uint32 *)&headerLE, (uint32 *)&header, sizeof( DDSHeader ) / sizeof( uint32 ) );
+
+	// Write to a temporary file first so that concurrent loaders never see partial entries
+	string tmpFileName = cacheFileName + ".tmp";
+	ofstream outf( tmpFileName.c_str(), ios::binary );
+	if( !outf.good() )
+	{
+		Modules::log().writeWarning( "Texture resource '%s': failed to write cache entry '%s'",
+		                             _name.c_str(), cacheFileName.c_str() );
+		return true;
+	}
+	
+	outf.write( (const char *)&headerLE, sizeof( DDSHeader ) );
+	for( uint32 i = 0; i <= _maxMipLevel; ++i )
+		outf.write( (const char *)levelData[i], levelSizes[i] );
+	outf.close();
+
+	if( outf.fail() || rename( tmpFileName.c_str(), cacheFileName.c_str() ) != 0 )
+		remove( tmpFileName.c_str() );
+
+	return true;
+}
+
+
 bool TextureResource::load( const char *data, int size )
 {
+	H3D_PROFILE_ZONE( "TextureResource::load" );
+
 	if( !Resource::load( data, size ) ) return false;
 
 	if ( checkDDS( data, size ) )
@@ -723,6 +948,78 @@ uint32_t TextureResource::getMaxAtMipFullLevel() const
 }
 
 
+uint32 TextureResource::getStreamFloorMip() const
+{
+	uint32 floorMip = 0;
+	while( floorMip < _maxMipLevel && (std::max( _width, _height ) >> floorMip) > (int)StreamFloorSize )
+		++floorMip;
+	return floorMip;
+}
+
+
+bool TextureResource::setResidentMip( uint32 mipLevel )
+{
+	if( !isStreamed() ) return false;
+
+	mipLevel = std::min( mipLevel, _maxMipLevel );
+	if( mipLevel == _residentMip && _texObject != 0 ) return true;
+	
+	// Recreate texture with the requested part of the mip chain
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	uint32 texObj = rdi->createTexture( _texType, std::max( _width >> mipLevel, 1 ), std::max( _height >> mipLevel, 1 ),
+	                                    _depth, _texFormat, _maxMipLevel - mipLevel, false, false, _sRGB );
+	if( texObj == 0 ) return false;
+
+	for( uint32 i = mipLevel; i <= _maxMipLevel; ++i )
+		rdi->uploadTextureData( texObj, 0, i - mipLevel, &_streamData[_streamOffsets[i]] );
+
+	if( _texObject != 0 ) rdi->destroyTexture( _texObject );
+	_texObject = texObj;
+	_residentMip = mipLevel;
+
+	return true;
+}
+
+
+bool TextureResource::canStream() const
+{
+	return Modules::config().texStreamingBudget > 0 && _texType == TextureTypes::Tex2D &&
+	       _maxMipLevel > 0 && _maxMipLevel < MaxStreamedMipLevels && !(_flags & ResourceFlags::TexDynamic);
+}
+
+
+void TextureResource::addStreamLevel( const void *data, size_t size )
+{
+	_streamOffsets.push_back( _streamData.size() );
+	_streamData.insert( _streamData.end(), (const unsigned char *)data, (const unsigned char *)data + size );
+}
+
+
+bool TextureResource::beginStreaming()
+{
+	ASSERT( _streamOffsets.size() == _maxMipLevel + 1 );
+	_streamOffsets.push_back( _streamData.size() );
+
+	// Start with the coarse levels only; the streamer raises the level based on usage
+	_texObject = 0;
+	if( !setResidentMip( getStreamFloorMip() ) ) return raiseError( "Failed to create streamed texture" );
+	
+	Modules::renderer().getTexStreamer().registerTexture( this );
+
+	return true;
+}
+
+
+void TextureResource::endStreaming()
+{
+	setResidentMip( 0 );
+
+	Modules::renderer().getTexStreamer().unregisterTexture( this );
+	vector< unsigned char >().swap( _streamData );
+	_streamOffsets.clear();
+}
+
+
 int TextureResource::getElemCount( int elem ) const
 {
 	switch( elem )
@@ -748,6 +1045,8 @@ int TextureResource::getElemParamI( int elem, int elemIdx, int param ) const
 			return _texFormat;
 		case TextureResData::TexSliceCountI:
 			return _texType == TextureTypes::TexCube ? 6 : 1;
+		case TextureResData::TexResidentMipI:
+			return _residentMip;
 		}
 		break;
 	case TextureResData::ImageElem:
@@ -784,6 +1083,9 @@ void *TextureResource::mapStream( int elem, int elemIdx, int stream, bool read,
 		{
 			RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
 
+			// Direct access requires the full mip chain in video memory
+			if( isStreamed() ) endStreaming();
+
 			mappedData = Modules::renderer().useScratchBuf(
 				rdi->calcTextureSize( _texFormat, _width, _height, _depth ), 16 ); // 16 byte aligned
 			
@@ -807,6 +1109,34 @@ void *TextureResource::mapStream( int elem, int elemIdx, int stream, bool read,
 }
 
 
+void TextureResource::getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const
+{
+	cpuBytes = _streamData.size();
+	gpuBytes = 0;
+
+	// Default textures are shared and not accounted
+	if( _texObject == 0 || _texObject == defTex2DObject || _texObject == defTex3DObject ||
+	    _texObject == defTexCubeObject ) return;
+	
+	// Only the mip levels from the resident one are in video memory
+	RenderDeviceInterface *rdi = Modules::renderer().getRenderDevice();
+	int width = std::max( 1, _width >> _residentMip );
+	int height = std::max( 1, _height >> _residentMip );
+	int depth = _texType == TextureTypes::Tex3D ? std::max( 1, _depth >> _residentMip ) : 1;
+	gpuBytes = rdi->calcTextureSize( _texFormat, width, height, depth, _maxMipLevel - _residentMip );
+	if( _texType == TextureTypes::TexCube ) gpuBytes *= 6;
+}
+
+
+uint32 TextureResource::getMappedWriteSize() const
+{
+	if( mappedData == 0x0 || mappedWriteImage < 0 ) return 0;
+
+	// Size of the mapped buffer, which is large enough for every image
+	return Modules::renderer().getRenderDevice()->calcTextureSize( _texFormat, _width, _height, _depth );
+}
+
+
 void TextureResource::unmapStream()
 {
 	if( mappedData != 0x0 )
@@ -37,7 +37,8 @@ struct TextureResData
 		TexSliceCountI,
 		ImgWidthI,
 		ImgHeightI,
-		ImgPixelStream
+		ImgPixelStream,
+		TexResidentMipI
 	};
 };
 
@@ -64,6 +65,8 @@ public:
 	int getElemParamI( int elem, int elemIdx, int param ) const;
 	void *mapStream( int elem, int elemIdx, int stream, bool read, bool write );
 	void unmapStream();
+	uint32 getMappedWriteSize() const;
+	void getMemoryUsage( uint64 &cpuBytes, uint64 &gpuBytes ) const;
 
 	TextureTypes::List getTexType() const { return _texType; }
 	TextureFormats::List getTexFormat() const { return _texFormat; }
@@ -74,6 +77,16 @@ public:
 	uint32 getRBObject() const { return _rbObj; }
 	uint32 getMaxMipLevel() const { return _maxMipLevel; }
 
+	// Streaming
+	bool isStreamed() const { return !_streamOffsets.empty(); }
+	uint32 getResidentMip() const { return _residentMip; }
+	uint32 getStreamFloorMip() const;
+	uint32 getStreamLevelSize( uint32 level ) const
+		{ return (uint32)(_streamOffsets[level + 1] - _streamOffsets[level]); }
+	bool setResidentMip( uint32 mipLevel );
+	void noteStreamUsage( float screenSize )
+		{ if( screenSize > _streamFrameDemand ) _streamFrameDemand = screenSize; }
+
 public:
 	static uint32	defTex2DObject;
 	static uint32	defTex3DObject;
@@ -87,7 +100,13 @@ protected:
 	bool loadKTX( const char *data, int size );
 	bool loadDDS( const char *data, int size );
 	bool loadSTBI( const char *data, int size );
+	bool loadCached( const std::string &fileName );
+	bool uploadProcessed( unsigned char *pixels, bool compress, int mipFilter, const std::string &cacheFileName );
     uint32 getMaxAtMipFullLevel() const;
+	bool canStream() const;
+	void addStreamLevel( const void *data, size_t size );
+	bool beginStreaming();
+	void endStreaming();
 
 protected:
 	static unsigned char  *mappedData;
@@ -101,7 +120,13 @@ protected:
 	uint32                _maxMipLevel;     // number of mip levels = _maxMipLevel + 1
 	bool                  _sRGB;
 
+	std::vector< unsigned char >  _streamData;     // CPU copy of all mip levels of a streamed texture
+	std::vector< size_t >         _streamOffsets;  // Offsets of mip levels, terminated by data size
+	uint32                        _residentMip;    // Finest mip level in video memory
+	float                         _streamDemand, _streamFrameDemand;  // Screen-space size in pixels
+
 	friend class ResourceManager;
+	friend class TextureStreamer;
 };
 
 typedef SmartResPtr< TextureResource > PTextureResource;
@@ -0,0 +1,494 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "utBVH.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	include <emmintrin.h>
+#	define H3D_BVH_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#	include <arm_neon.h>
+#	define H3D_BVH_NEON
+#endif
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+static const uint32 BVHNumBins = 12;
+static const uint32 BVHMaxLeafPrims = 8;  // Larger leaves are split even if the SAH favors a leaf
+static const uint32 BVHMaxDepth = 60;     // Must be smaller than the traversal stack size
+static const uint32 BVHStackSize = 64;
+static const float BVHTraversalCost = 1.0f;  // Relative to the cost of a primitive test
+
+
+namespace {
+
+struct BuildBox
+{
+	Vec3f  bbMin, bbMax;
+
+	BuildBox() : bbMin( Math::MaxFloat, Math::MaxFloat, Math::MaxFloat ),
+	             bbMax( -Math::MaxFloat, -Math::MaxFloat, -Math::MaxFloat ) {}
+
+	void grow( const Vec3f &v )
+	{
+		bbMin.x = minf( bbMin.x, v.x ); bbMin.y = minf( bbMin.y, v.y ); bbMin.z = minf( bbMin.z, v.z );
+		bbMax.x = maxf( bbMax.x, v.x ); bbMax.y = maxf( bbMax.y, v.y ); bbMax.z = maxf( bbMax.z, v.z );
+	}
+
+	void grow( const BuildBox &b ) { grow( b.bbMin ); grow( b.bbMax ); }
+
+	float area() const
+	{
+		if( bbMax.x < bbMin.x ) return 0;
+		Vec3f d = bbMax - bbMin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+struct BuildBin
+{
+	BuildBox  box;
+	uint32    count;
+
+	BuildBin() : count( 0 ) {}
+};
+
+struct BuildTask
+{
+	uint32  node, depth;
+};
+
+struct BVHRay
+{
+#if defined( H3D_BVH_SSE2 )
+	__m128       orig, invDir;
+#elif defined( H3D_BVH_NEON )
+	float32x4_t  orig, invDir;
+#else
+	float        orig[3], invDir[3];
+#endif
+
+	BVHRay( const Vec3f &rayOrig, const Vec3f &rayDir )
+	{
+		// Avoid infinite slab distances that would produce NaNs for rays on a slab plane
+		float inv[3];
+		for( int i = 0; i < 3; ++i )
+		{
+			float d = (&rayDir.x)[i];
+			inv[i] = fabsf( d ) > 1e-20f ? 1.0f / d : (d < 0 ? -1e20f : 1e20f);
+		}
+
+#if defined( H3D_BVH_SSE2 )
+		orig = _mm_set_ps( 0, rayOrig.z, rayOrig.y, rayOrig.x );
+		invDir = _mm_set_ps( 0, inv[2], inv[1], inv[0] );
+#elif defined( H3D_BVH_NEON )
+		float o4[4] = { rayOrig.x, rayOrig.y, rayOrig.z, 0 }, i4[4] = { inv[0], inv[1], inv[2], 0 };
+		orig = vld1q_f32( o4 );
+		invDir = vld1q_f32( i4 );
+#else
+		orig[0] = rayOrig.x; orig[1] = rayOrig.y; orig[2] = rayOrig.z;
+		invDir[0] = inv[0]; invDir[1] = inv[1]; invDir[2] = inv[2];
+#endif
+	}
+};
+
+
+inline bool intersectBox( const BVHNode &node, const BVHRay &ray, float tMax, float &tEntry )
+{
+	// Slab test; the fourth lane holds the node's index data and is ignored
+#if defined( H3D_BVH_SSE2 )
+	__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node.bbMin ), ray.orig ), ray.invDir );
+	__m128 t2 = _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( node.bbMax ), ray.orig ), ray.invDir );
+	__m128 tNear = _mm_min_ps( t1, t2 );
+	__m128 tFar = _mm_max_ps( t1, t2 );
+	tNear = _mm_max_ss( _mm_max_ss( tNear, _mm_shuffle_ps( tNear, tNear, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ),
+	                    _mm_movehl_ps( tNear, tNear ) );
+	tFar = _mm_min_ss( _mm_min_ss( tFar, _mm_shuffle_ps( tFar, tFar, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ),
+	                   _mm_movehl_ps( tFar, tFar ) );
+	tEntry = _mm_cvtss_f32( tNear );
+	float tExit = _mm_cvtss_f32( tFar );
+#elif defined( H3D_BVH_NEON )
+	float32x4_t t1 = vmulq_f32( vsubq_f32( vld1q_f32( node.bbMin ), ray.orig ), ray.invDir );
+	float32x4_t t2 = vmulq_f32( vsubq_f32( vld1q_f32( node.bbMax ), ray.orig ), ray.invDir );
+	float32x4_t tNear = vminq_f32( t1, t2 );
+	float32x4_t tFar = vmaxq_f32( t1, t2 );
+	tEntry = maxf( maxf( vgetq_lane_f32( tNear, 0 ), vgetq_lane_f32( tNear, 1 ) ), vgetq_lane_f32( tNear, 2 ) );
+	float tExit = minf( minf( vgetq_lane_f32( tFar, 0 ), vgetq_lane_f32( tFar, 1 ) ), vgetq_lane_f32( tFar, 2 ) );
+#else
+	tEntry = -Math::MaxFloat;
+	float tExit = Math::MaxFloat;
+	for( int i = 0; i < 3; ++i )
+	{
+		float t1 = (node.bbMin[i] - ray.orig[i]) * ray.invDir[i];
+		float t2 = (node.bbMax[i] - ray.orig[i]) * ray.invDir[i];
+		tEntry = maxf( tEntry, minf( t1, t2 ) );
+		tExit = minf( tExit, maxf( t1, t2 ) );
+	}
+#endif
+
+	return tEntry <= tExit && tExit >= 0 && tEntry <= tMax;
+}
+
+
+inline bool intersectTriangle( const Vec3f &rayOrig, const Vec3f &rayDir,
+                               const Vec3f &vert0, const Vec3f &vert1, const Vec3f &vert2, float &t )
+{
+	// Same non-culling test as rayTriangleIntersection but returning the ray parameter
+	Vec3f edge1 = vert1 - vert0;
+	Vec3f edge2 = vert2 - vert0;
+	Vec3f pvec = rayDir.cross( edge2 );
+
+	float det = edge1.dot( pvec );
+	if( det > -Math::Epsilon && det < Math::Epsilon ) return false;
+	float invDet = 1.0f / det;
+
+	Vec3f tvec = rayOrig - vert0;
+	float u = tvec.dot( pvec ) * invDet;
+	if( u < 0.0f || u > 1.0f ) return false;
+
+	Vec3f qvec = tvec.cross( edge1 );
+	float v = rayDir.dot( qvec ) * invDet;
+	if( v < 0.0f || u + v > 1.0f ) return false;
+
+	t = edge2.dot( qvec ) * invDet;
+	return t >= 0.0f;
+}
+
+
+void buildHierarchy( const vector< BuildBox > &primBoxes, vector< BVHNode > &nodes, vector< uint32 > &order )
+{
+	uint32 numPrims = (uint32)primBoxes.size();
+	vector< Vec3f > centroids( numPrims );
+	order.resize( numPrims );
+	
+	for( uint32 i = 0; i < numPrims; ++i )
+	{
+		centroids[i] = (primBoxes[i].bbMin + primBoxes[i].bbMax) * 0.5f;
+		order[i] = i;
+	}
+
+	// A binary tree with numPrims leaves has at most 2 * numPrims - 1 nodes
+	nodes.clear();
+	nodes.reserve( numPrims * 2 );
+	nodes.push_back( BVHNode() );
+	nodes[0].first = 0;
+	nodes[0].count = numPrims;
+
+	vector< BuildTask > tasks;
+	tasks.push_back( BuildTask() );
+	tasks.back().node = 0;
+	tasks.back().depth = 0;
+
+	while( !tasks.empty() )
+	{
+		BuildTask task = tasks.back();
+		tasks.pop_back();
+
+		uint32 first = nodes[task.node].first, count = nodes[task.node].count;
+
+		BuildBox box, centroidBox;
+		for( uint32 i = first; i < first + count; ++i )
+		{
+			box.grow( primBoxes[order[i]] );
+			centroidBox.grow( centroids[order[i]] );
+		}
+
+		BVHNode &node = nodes[task.node];
+		node.bbMin[0] = box.bbMin.x; node.bbMin[1] = box.bbMin.y; node.bbMin[2] = box.bbMin.z;
+		node.bbMax[0] = box.bbMax.x; node.bbMax[1] = box.bbMax.y; node.bbMax[2] = box.bbMax.z;
+
+		if( count <= 2 || task.depth >= BVHMaxDepth ) continue;
+
+		// Find split plane with lowest SAH cost among the bin boundaries of all axes
+		float bestCost = Math::MaxFloat;
+		int bestAxis = -1;
+		uint32 bestSplit = 0;
+
+		for( int axis = 0; axis < 3; ++axis )
+		{
+			float cMin = (&centroidBox.bbMin.x)[axis], cMax = (&centroidBox.bbMax.x)[axis];
+			if( cMax <= cMin ) continue;
+
+			BuildBin bins[BVHNumBins];
+			float scale = BVHNumBins / (cMax - cMin);
+			for( uint32 i = first; i < first + count; ++i )
+			{
+				uint32 b = std::min( (uint32)(((&centroids[order[i]].x)[axis] - cMin) * scale), BVHNumBins - 1 );
+				bins[b].box.grow( primBoxes[order[i]] );
+				++bins[b].count;
+			}
+
+			float leftArea[BVHNumBins - 1];
+			uint32 leftCount[BVHNumBins - 1];
+			BuildBox leftBox, rightBox;
+			uint32 leftSum = 0, rightSum = 0;
+			for( uint32 i = 0; i < BVHNumBins - 1; ++i )
+			{
+				leftSum += bins[i].count;
+				leftBox.grow( bins[i].box );
+				leftCount[i] = leftSum;
+				leftArea[i] = leftBox.area();
+			}
+			for( uint32 i = BVHNumBins - 1; i > 0; --i )
+			{
+				rightSum += bins[i].count;
+				rightBox.grow( bins[i].box );
+				float cost = leftCount[i - 1] * leftArea[i - 1] + rightSum * rightBox.area();
+				if( leftCount[i - 1] > 0 && rightSum > 0 && cost < bestCost )
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+
+		float parentArea = box.area();
+		float splitCost = parentArea > 0 ? BVHTraversalCost + bestCost / parentArea : Math::MaxFloat;
+		if( (bestAxis < 0 || splitCost >= (float)count) && count <= BVHMaxLeafPrims ) continue;
+
+		// Partition primitives; fall back to a median split if the SAH could not separate them
+		uint32 mid = first + count / 2;
+		if( bestAxis >= 0 )
+		{
+			float cMin = (&centroidBox.bbMin.x)[bestAxis], cMax = (&centroidBox.bbMax.x)[bestAxis];
+			float scale = BVHNumBins / (cMax - cMin);
+			uint32 *split = std::partition( &order[first], &order[first] + count, [&]( uint32 prim )
+				{ return std::min( (uint32)(((&centroids[prim].x)[bestAxis] - cMin) * scale), BVHNumBins - 1 ) < bestSplit; } );
+			mid = (uint32)(split - &order[0]);
+			if( mid == first || mid == first + count ) mid = first + count / 2;
+		}
+
+		uint32 left = (uint32)nodes.size();
+		nodes.push_back( BVHNode() );
+		nodes.push_back( BVHNode() );
+		nodes[left].first = first;
+		nodes[left].count = mid - first;
+		nodes[left + 1].first = mid;
+		nodes[left + 1].count = first + count - mid;
+		nodes[task.node].first = left;
+		nodes[task.node].count = 0;
+
+		BuildTask childTask;
+		childTask.depth = task.depth + 1;
+		childTask.node = left + 1;
+		tasks.push_back( childTask );
+		childTask.node = left;
+		tasks.push_back( childTask );
+	}
+}
+
+
+// Visits the leaves hit by the ray front to back. testLeaf( first, count, tBest ) intersects the
+// primitives of a leaf, lowers tBest and returns true if one of them was hit.
+template< class LeafFunc > bool traverseHierarchy( const vector< BVHNode > &nodes, const BVHRay &ray,
+                                                   float &tBest, bool anyHit, LeafFunc testLeaf )
+{
+	float tEntry;
+	bool hit = false;
+
+	if( nodes.empty() || !intersectBox( nodes[0], ray, tBest, tEntry ) ) return false;
+
+	// The stack keeps the entry distance of deferred nodes so that they can be skipped once a
+	// closer hit is known
+	uint32 stackNodes[BVHStackSize];
+	float stackDists[BVHStackSize];
+	uint32 stackSize = 0;
+	uint32 nodeIdx = 0;
+
+	for( ;; )
+	{
+		const BVHNode &node = nodes[nodeIdx];
+
+		if( node.count > 0 )
+		{
+			if( testLeaf( node.first, node.count, tBest ) )
+			{
+				hit = true;
+				if( anyHit ) return true;
+			}
+		}
+		else
+		{
+			uint32 child0 = node.first, child1 = node.first + 1;
+			float dist0, dist1;
+			bool hit0 = intersectBox( nodes[child0], ray, tBest, dist0 );
+			bool hit1 = intersectBox( nodes[child1], ray, tBest, dist1 );
+
+			if( hit0 && hit1 )
+			{
+				if( dist1 < dist0 )
+				{
+					std::swap( child0, child1 );
+					std::swap( dist0, dist1 );
+				}
+				ASSERT( stackSize < BVHStackSize );
+				stackNodes[stackSize] = child1;
+				stackDists[stackSize++] = dist1;
+				nodeIdx = child0;
+				continue;
+			}
+			else if( hit0 || hit1 )
+			{
+				nodeIdx = hit0 ? child0 : child1;
+				continue;
+			}
+		}
+
+		// Pop next node that can still contain a closer hit
+		while( stackSize > 0 && stackDists[stackSize - 1] > tBest ) --stackSize;
+		if( stackSize == 0 ) break;
+		nodeIdx = stackNodes[--stackSize];
+	}
+
+	return hit;
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+// Class TriangleBVH
+// *************************************************************************************************
+
+void TriangleBVH::clear()
+{
+	_nodes.clear();
+	_triVerts.clear();
+}
+
+
+void TriangleBVH::build( const Vec3f *verts, const void *indices, bool indices16, uint32 firstIndex, uint32 indexCount )
+{
+	clear();
+
+	uint32 numTris = indexCount / 3;
+	if( verts == 0x0 || indices == 0x0 || numTris == 0 ) return;
+
+	// Gather triangle bounds and centroids
+	vector< uint32 > triVerts( numTris * 3 );
+	vector< BuildBox > triBoxes( numTris );
+
+	for( uint32 i = 0; i < numTris; ++i )
+	{
+		for( uint32 j = 0; j < 3; ++j )
+		{
+			uint32 idx = firstIndex + i * 3 + j;
+			triVerts[i * 3 + j] = indices16 ? ((const uint16 *)indices)[idx] : ((const uint32 *)indices)[idx];
+			triBoxes[i].grow( verts[triVerts[i * 3 + j]] );
+		}
+	}
+
+	vector< uint32 > order;
+	buildHierarchy( triBoxes, _nodes, order );
+
+	// Store triangles in leaf order
+	_triVerts.resize( numTris * 3 );
+	for( uint32 i = 0; i < numTris; ++i )
+	{
+		_triVerts[i * 3 + 0] = triVerts[order[i] * 3 + 0];
+		_triVerts[i * 3 + 1] = triVerts[order[i] * 3 + 1];
+		_triVerts[i * 3 + 2] = triVerts[order[i] * 3 + 2];
+	}
+}
+
+
+bool TriangleBVH::intersect( const Vec3f *verts, const Vec3f &rayOrig, const Vec3f &rayDir, float &t,
+                             bool anyHit ) const
+{
+	BVHRay ray( rayOrig, rayDir );
+	float tBest = 1.0f;
+
+	bool hit = traverseHierarchy( _nodes, ray, tBest, anyHit, [&]( uint32 first, uint32 count, float &tMax )
+	{
+		bool leafHit = false;
+		const uint32 *tri = &_triVerts[first * 3];
+		for( uint32 i = 0; i < count; ++i, tri += 3 )
+		{
+			float tHit;
+			if( intersectTriangle( rayOrig, rayDir, verts[tri[0]], verts[tri[1]], verts[tri[2]], tHit ) &&
+			    tHit <= tMax )
+			{
+				tMax = tHit;
+				leafHit = true;
+				if( anyHit ) break;
+			}
+		}
+		return leafHit;
+	} );
+
+	if( hit ) t = tBest;
+	return hit;
+}
+
+
+// *************************************************************************************************
+// Class BoxBVH
+// *************************************************************************************************
+
+void BoxBVH::clear()
+{
+	_nodes.clear();
+	_prims.clear();
+}
+
+
+void BoxBVH::build( const Vec3f *bounds, uint32 count )
+{
+	clear();
+	if( bounds == 0x0 || count == 0 ) return;
+
+	vector< BuildBox > boxes( count );
+	for( uint32 i = 0; i < count; ++i )
+	{
+		boxes[i].grow( bounds[i * 2 + 0] );
+		boxes[i].grow( bounds[i * 2 + 1] );
+	}
+
+	buildHierarchy( boxes, _nodes, _prims );
+}
+
+
+bool BoxBVH::intersect( const Vec3f &rayOrig, const Vec3f &rayDir, float &t, bool anyHit,
+                        const std::function< bool( uint32, float & ) > &testPrim ) const
+{
+	BVHRay ray( rayOrig, rayDir );
+	float tBest = 1.0f;
+
+	bool hit = traverseHierarchy( _nodes, ray, tBest, anyHit, [&]( uint32 first, uint32 count, float &tMax )
+	{
+		bool leafHit = false;
+		for( uint32 i = first; i < first + count; ++i )
+		{
+			float tHit = tMax;
+			if( testPrim( _prims[i], tHit ) && tHit <= tMax )
+			{
+				tMax = tHit;
+				leafHit = true;
+				if( anyHit ) break;
+			}
+		}
+		return leafHit;
+	} );
+
+	if( hit ) t = tBest;
+	return hit;
+}
+
+}  // namespace
@@ -0,0 +1,86 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _utBVH_H_
+#define _utBVH_H_
+
+#include "utPlatform.h"
+#include "utMath.h"
+#include <vector>
+#include <functional>
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// Triangle Bounding Volume Hierarchy
+// =================================================================================================
+
+struct BVHNode
+{
+	float   bbMin[3];
+	uint32  first;   // Inner node: index of left child, right child follows; leaf: first triangle
+	float   bbMax[3];
+	uint32  count;   // Number of triangles; 0 for inner nodes
+};
+
+// The hierarchy stores only triangle indices, so the vertex positions it was built from have to be
+// passed to the queries and must not change while the hierarchy is in use
+class TriangleBVH
+{
+public:
+	TriangleBVH() {}
+
+	// Builds the hierarchy for the triangles in [firstIndex, firstIndex + indexCount) of the index data
+	// using the binned surface area heuristic
+	void build( const Vec3f *verts, const void *indices, bool indices16, uint32 firstIndex, uint32 indexCount );
+	void clear();
+
+	// Finds the closest intersection of the segment rayOrig + t * rayDir with t in [0, 1]. On success t
+	// receives the ray parameter of the hit. If anyHit is set, the traversal stops at the first hit found.
+	bool intersect( const Vec3f *verts, const Vec3f &rayOrig, const Vec3f &rayDir, float &t,
+	                bool anyHit = false ) const;
+
+	bool isEmpty() const { return _nodes.empty(); }
+	uint32 getNodeCount() const { return (uint32)_nodes.size(); }
+	size_t getMemSize() const { return _nodes.size() * sizeof( BVHNode ) + _triVerts.size() * sizeof( uint32 ); }
+
+protected:
+	std::vector< BVHNode >  _nodes;
+	std::vector< uint32 >   _triVerts;  // Three vertex indices per triangle in leaf order
+};
+
+// Hierarchy over arbitrary axis aligned boxes, e.g. the bounds of scene nodes
+class BoxBVH
+{
+public:
+	BoxBVH() {}
+
+	// Builds the hierarchy for count boxes given as pairs of minimum and maximum corners
+	void build( const Vec3f *bounds, uint32 count );
+	void clear();
+
+	// Visits the boxes hit by the segment rayOrig + t * rayDir with t in [0, 1], roughly front to back.
+	// testPrim( index, t ) is called with the closest hit found so far in t and has to return true and
+	// lower t if the primitive is hit closer. Returns the closest hit, or the first one if anyHit is set.
+	bool intersect( const Vec3f &rayOrig, const Vec3f &rayDir, float &t, bool anyHit,
+	                const std::function< bool( uint32, float & ) > &testPrim ) const;
+
+	bool isEmpty() const { return _nodes.empty(); }
+
+protected:
+	std::vector< BVHNode >  _nodes;
+	std::vector< uint32 >   _prims;  // Primitive indices in leaf order
+};
+
+}
+#endif // _utBVH_H_
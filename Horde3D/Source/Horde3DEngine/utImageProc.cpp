@@ -0,0 +1,519 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "utImageProc.h"
+#include "utMath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	include <emmintrin.h>
+#	define H3D_IMAGEPROC_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#	include <arm_neon.h>
+#	define H3D_IMAGEPROC_NEON
+#endif
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+namespace {
+
+// Conversion tables between 8 bit sRGB and linear float
+struct ColorTables
+{
+	static const int linearRes = 1 << 14;
+
+	float          toLinear[256];
+	unsigned char  toSRGB[linearRes + 1];
+
+	ColorTables()
+	{
+		for( int i = 0; i < 256; ++i )
+		{
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf( (c + 0.055f) / 1.055f, 2.4f );
+		}
+		for( int i = 0; i <= linearRes; ++i )
+		{
+			float c = i / (float)linearRes;
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf( c, 1.0f / 2.4f ) - 0.055f;
+			toSRGB[i] = (unsigned char)std::min( ftoi_r( c * 255.0f ), 255 );
+		}
+	}
+
+	static const ColorTables &get()
+	{
+		static ColorTables tables;
+		return tables;
+	}
+};
+
+
+// Weights for a 2:1 reduction; tap i reads source pixel 2 * x + firstOffset + i
+struct MipKernel
+{
+	int    numTaps, firstOffset;
+	float  weights[6];
+
+	explicit MipKernel( MipFilters::List filter )
+	{
+		if( filter != MipFilters::Kaiser )
+		{
+			numTaps = 2; firstOffset = 0;
+			weights[0] = weights[1] = 0.5f;
+			return;
+		}
+
+		// Kaiser-windowed sinc (alpha 4) with a support of 1.5 destination pixels
+		const float alpha = 4.0f, support = 1.5f;
+		numTaps = 6; firstOffset = -2;
+
+		float sum = 0;
+		for( int i = 0; i < numTaps; ++i )
+		{
+			float t = (i - 2.5f) * 0.5f;  // Tap distance in destination pixels
+			float x = t / support;
+			float window = besselI0( alpha * sqrtf( std::max( 1.0f - x * x, 0.0f ) ) ) / besselI0( alpha );
+			weights[i] = sinc( t ) * window;
+			sum += weights[i];
+		}
+		for( int i = 0; i < numTaps; ++i ) weights[i] /= sum;
+	}
+
+	static float sinc( float x )
+	{
+		if( fabsf( x ) < 1e-5f ) return 1.0f;
+		return sinf( Math::Pi * x ) / (Math::Pi * x);
+	}
+
+	static float besselI0( float x )
+	{
+		float sum = 1.0f, term = 1.0f;
+		for( int k = 1; k < 20; ++k )
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+			if( term < sum * 1e-7f ) break;
+		}
+		return sum;
+	}
+};
+
+
+// Filters one source row horizontally into dstWidth linear RGBA values
+void filterRow( const unsigned char *srcRow, int srcWidth, int dstWidth, const MipKernel &kernel,
+                const float *toLinear, float *dst )
+{
+	for( int x = 0; x < dstWidth; ++x )
+	{
+		float r = 0, g = 0, b = 0, a = 0;
+		for( int i = 0; i < kernel.numTaps; ++i )
+		{
+			int sx = std::min( std::max( 2 * x + kernel.firstOffset + i, 0 ), srcWidth - 1 );
+			const unsigned char *p = srcRow + sx * 4;
+			float w = kernel.weights[i];
+			r += w * toLinear[p[0]];
+			g += w * toLinear[p[1]];
+			b += w * toLinear[p[2]];
+			a += w * p[3];
+		}
+		dst[x * 4 + 0] = r;
+		dst[x * 4 + 1] = g;
+		dst[x * 4 + 2] = b;
+		dst[x * 4 + 3] = a * (1.0f / 255.0f);
+	}
+}
+
+
+void runRange( const ImageProc::ParallelForFunc &parallelFor, int count, int grainSize,
+               const ImageProc::RangeFunc &func )
+{
+	if( parallelFor ) parallelFor( count, grainSize, func );
+	else func( 0, count );
+}
+
+
+void downsample( const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst,
+                 int dstWidth, int dstHeight, const MipKernel &kernel, bool sRGB,
+                 const ImageProc::ParallelForFunc &parallelFor )
+{
+	const ColorTables &tables = ColorTables::get();
+	float identity[256];
+	if( !sRGB )
+	{
+		for( int i = 0; i < 256; ++i ) identity[i] = i / 255.0f;
+	}
+	const float *toLinear = sRGB ? tables.toLinear : identity;
+
+	runRange( parallelFor, dstHeight, 16, [&]( int begin, int end )
+	{
+		vector< float > rows( kernel.numTaps * dstWidth * 4 );
+
+		for( int y = begin; y < end; ++y )
+		{
+			for( int i = 0; i < kernel.numTaps; ++i )
+			{
+				int sy = std::min( std::max( 2 * y + kernel.firstOffset + i, 0 ), srcHeight - 1 );
+				filterRow( src + (size_t)sy * srcWidth * 4, srcWidth, dstWidth, kernel, toLinear,
+				           &rows[i * dstWidth * 4] );
+			}
+
+			unsigned char *out = dst + (size_t)y * dstWidth * 4;
+			for( int x = 0; x < dstWidth * 4; ++x )
+			{
+				float v = 0;
+				for( int i = 0; i < kernel.numTaps; ++i )
+					v += kernel.weights[i] * rows[i * dstWidth * 4 + x];
+				v = clamp( v, 0.0f, 1.0f );
+
+				if( sRGB && (x & 3) != 3 )
+					out[x] = tables.toSRGB[ftoi_r( v * ColorTables::linearRes )];
+				else
+					out[x] = (unsigned char)ftoi_r( v * 255.0f );
+			}
+		}
+	} );
+}
+
+
+// BC1/BC3 block encoding
+
+inline uint32 packColor565( const float *c )
+{
+	int r = ftoi_r( clamp( c[0], 0.0f, 255.0f ) * 31.0f / 255.0f );
+	int g = ftoi_r( clamp( c[1], 0.0f, 255.0f ) * 63.0f / 255.0f );
+	int b = ftoi_r( clamp( c[2], 0.0f, 255.0f ) * 31.0f / 255.0f );
+	return (r << 11) | (g << 5) | b;
+}
+
+
+inline void unpackColor565( uint32 c, int *rgb )
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+// Assigns the nearest palette entry to each texel; returns the squared error
+int matchColors( const unsigned char *block, uint32 c0, uint32 c1, uint32 &indices )
+{
+	int palette[4][3];
+	unpackColor565( c0, palette[0] );
+	unpackColor565( c1, palette[1] );
+	for( int i = 0; i < 3; ++i )
+	{
+		palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+		palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+	}
+
+	int error = 0;
+	indices = 0;
+	for( int i = 0; i < 16; ++i )
+	{
+		const unsigned char *p = block + i * 4;
+		int best = 0, bestDist = 0x7fffffff;
+		for( int j = 0; j < 4; ++j )
+		{
+			int dr = p[0] - palette[j][0], dg = p[1] - palette[j][1], db = p[2] - palette[j][2];
+			int dist = dr * dr + dg * dg + db * db;
+			if( dist < bestDist ) { bestDist = dist; best = j; }
+		}
+		indices |= (uint32)best << (i * 2);
+		error += bestDist;
+	}
+	return error;
+}
+
+
+// Orders the endpoints for four color mode and computes the texel indices
+int finishColorEndpoints( const unsigned char *block, uint32 &c0, uint32 &c1, uint32 &indices )
+{
+	if( c0 < c1 ) std::swap( c0, c1 );
+	if( c0 == c1 )
+	{
+		indices = 0;
+		int rgb[3];
+		unpackColor565( c0, rgb );
+		int error = 0;
+		for( int i = 0; i < 16; ++i )
+		{
+			for( int j = 0; j < 3; ++j )
+				error += (block[i * 4 + j] - rgb[j]) * (block[i * 4 + j] - rgb[j]);
+		}
+		return error;
+	}
+	return matchColors( block, c0, c1, indices );
+}
+
+
+void encodeColorBlock( const unsigned char *block, unsigned char *dst )
+{
+	// Find principal axis of the color distribution
+	float mean[3] = { 0, 0, 0 };
+	for( int i = 0; i < 16; ++i )
+	{
+		for( int j = 0; j < 3; ++j ) mean[j] += block[i * 4 + j];
+	}
+	for( int j = 0; j < 3; ++j ) mean[j] /= 16.0f;
+
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for( int i = 0; i < 16; ++i )
+	{
+		float r = block[i * 4 + 0] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	float axis[3] = { 1, 1, 1 };
+	for( int iter = 0; iter < 4; ++iter )
+	{
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float m = std::max( fabsf( x ), std::max( fabsf( y ), fabsf( z ) ) );
+		if( m < 1e-6f ) break;
+		axis[0] = x / m; axis[1] = y / m; axis[2] = z / m;
+	}
+
+	// Use extreme texels along the axis as initial endpoints
+	int minIdx = 0, maxIdx = 0;
+	float minProj = Math::MaxFloat, maxProj = -Math::MaxFloat;
+	for( int i = 0; i < 16; ++i )
+	{
+		float proj = block[i * 4 + 0] * axis[0] + block[i * 4 + 1] * axis[1] + block[i * 4 + 2] * axis[2];
+		if( proj < minProj ) { minProj = proj; minIdx = i; }
+		if( proj > maxProj ) { maxProj = proj; maxIdx = i; }
+	}
+
+	float e0[3], e1[3];
+	for( int j = 0; j < 3; ++j )
+	{
+		e0[j] = block[maxIdx * 4 + j];
+		e1[j] = block[minIdx * 4 + j];
+	}
+	uint32 c0 = packColor565( e0 ), c1 = packColor565( e1 ), indices;
+	int error = finishColorEndpoints( block, c0, c1, indices );
+
+	// Refine endpoints with a least squares fit to the selected indices
+	if( error > 0 && c0 != c1 )
+	{
+		const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0, bb = 0, ab = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+		for( int i = 0; i < 16; ++i )
+		{
+			float a = weights[(indices >> (i * 2)) & 3], b = 1.0f - a;
+			aa += a * a; bb += b * b; ab += a * b;
+			for( int j = 0; j < 3; ++j )
+			{
+				ax[j] += a * block[i * 4 + j];
+				bx[j] += b * block[i * 4 + j];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if( fabsf( det ) > 1e-6f )
+		{
+			for( int j = 0; j < 3; ++j )
+			{
+				e0[j] = (ax[j] * bb - bx[j] * ab) / det;
+				e1[j] = (bx[j] * aa - ax[j] * ab) / det;
+			}
+			uint32 r0 = packColor565( e0 ), r1 = packColor565( e1 ), rIndices;
+			if( finishColorEndpoints( block, r0, r1, rIndices ) < error )
+			{
+				c0 = r0; c1 = r1; indices = rIndices;
+			}
+		}
+	}
+
+	dst[0] = (unsigned char)(c0 & 0xFF); dst[1] = (unsigned char)(c0 >> 8);
+	dst[2] = (unsigned char)(c1 & 0xFF); dst[3] = (unsigned char)(c1 >> 8);
+	for( int i = 0; i < 4; ++i ) dst[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+
+void encodeAlphaBlock( const unsigned char *block, unsigned char *dst )
+{
+	int a0 = 0, a1 = 255;
+	for( int i = 0; i < 16; ++i )
+	{
+		a0 = std::max( a0, (int)block[i * 4 + 3] );
+		a1 = std::min( a1, (int)block[i * 4 + 3] );
+	}
+
+	dst[0] = (unsigned char)a0;
+	dst[1] = (unsigned char)a1;
+	uint64 bits = 0;
+
+	if( a0 != a1 )
+	{
+		// Eight value mode: palette index 0 is a0, 1 is a1 and 2-7 interpolate from a0 to a1
+		int palette[8] = { a0, a1 };
+		for( int i = 1; i < 7; ++i ) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+
+		for( int i = 0; i < 16; ++i )
+		{
+			int a = block[i * 4 + 3], best = 0, bestDist = 256;
+			for( int j = 0; j < 8; ++j )
+			{
+				int dist = abs( a - palette[j] );
+				if( dist < bestDist ) { bestDist = dist; best = j; }
+			}
+			bits |= (uint64)best << (i * 3);
+		}
+	}
+
+	for( int i = 0; i < 6; ++i ) dst[2 + i] = (unsigned char)(bits >> (i * 8));
+}
+
+}  // namespace
+
+
+// =================================================================================================
+// ImageProc
+// =================================================================================================
+
+uint64 ImageProc::hash( const void *data, size_t size, uint64 seed )
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	uint64 h = seed;
+	for( size_t i = 0; i < size; ++i )
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+
+void ImageProc::swizzleRedBlue( uint32 *pixels, size_t count )
+{
+	size_t i = 0;
+
+#if defined( H3D_IMAGEPROC_SSE2 )
+	const __m128i maskGA = _mm_set1_epi32( (int)0xFF00FF00 );
+	const __m128i maskLow = _mm_set1_epi32( 0x000000FF );
+	for( ; i + 4 <= count; i += 4 )
+	{
+		__m128i col = _mm_loadu_si128( (const __m128i *)(pixels + i) );
+		__m128i ga = _mm_and_si128( col, maskGA );
+		__m128i lo = _mm_slli_epi32( _mm_and_si128( col, maskLow ), 16 );
+		__m128i hi = _mm_and_si128( _mm_srli_epi32( col, 16 ), maskLow );
+		_mm_storeu_si128( (__m128i *)(pixels + i), _mm_or_si128( ga, _mm_or_si128( lo, hi ) ) );
+	}
+#elif defined( H3D_IMAGEPROC_NEON )
+	for( ; i + 16 <= count; i += 16 )
+	{
+		uint8x16x4_t col = vld4q_u8( (const uint8_t *)(pixels + i) );
+		uint8x16_t tmp = col.val[0];
+		col.val[0] = col.val[2];
+		col.val[2] = tmp;
+		vst4q_u8( (uint8_t *)(pixels + i), col );
+	}
+#endif
+
+	for( ; i < count; ++i )
+	{
+		uint32 col = pixels[i];
+		pixels[i] = ( col & 0xFF00FF00 ) | ( ( col & 0x000000FF ) << 16 ) | ( ( col & 0x00FF0000 ) >> 16 );
+	}
+}
+
+
+bool ImageProc::hasTranslucency( const unsigned char *rgba, size_t count )
+{
+	for( size_t i = 0; i < count; ++i )
+	{
+		if( rgba[i * 4 + 3] != 255 ) return true;
+	}
+	return false;
+}
+
+
+void ImageProc::generateMips( const unsigned char *rgba, int width, int height, int maxMipLevel,
+                              MipFilters::List filter, bool sRGB, vector< ImageLevel > &levels,
+                              const ParallelForFunc &parallelFor )
+{
+	MipKernel kernel( filter );
+	levels.resize( maxMipLevel );
+
+	const unsigned char *src = rgba;
+	int srcWidth = width, srcHeight = height;
+
+	for( int i = 0; i < maxMipLevel; ++i )
+	{
+		ImageLevel &level = levels[i];
+		level.width = std::max( srcWidth >> 1, 1 );
+		level.height = std::max( srcHeight >> 1, 1 );
+		level.data.resize( (size_t)level.width * level.height * 4 );
+
+		downsample( src, srcWidth, srcHeight, &level.data[0], level.width, level.height, kernel, sRGB, parallelFor );
+
+		src = &level.data[0];
+		srcWidth = level.width;
+		srcHeight = level.height;
+	}
+}
+
+
+size_t ImageProc::calcBCSize( int width, int height, bool withAlpha )
+{
+	return (size_t)idivceil( width, 4 ) * idivceil( height, 4 ) * (withAlpha ? 16 : 8);
+}
+
+
+void ImageProc::encodeBC( const unsigned char *rgba, int width, int height, bool withAlpha, unsigned char *dst,
+                          const ParallelForFunc &parallelFor )
+{
+	int blocksX = idivceil( width, 4 ), blocksY = idivceil( height, 4 );
+	size_t blockSize = withAlpha ? 16 : 8;
+
+	runRange( parallelFor, blocksY, 4, [&]( int begin, int end )
+	{
+		unsigned char block[64];
+
+		for( int by = begin; by < end; ++by )
+		{
+			for( int bx = 0; bx < blocksX; ++bx )
+			{
+				// Gather texels, replicating edge texels for partial blocks
+				for( int y = 0; y < 4; ++y )
+				{
+					int sy = std::min( by * 4 + y, height - 1 );
+					for( int x = 0; x < 4; ++x )
+					{
+						int sx = std::min( bx * 4 + x, width - 1 );
+						memcpy( block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4 );
+					}
+				}
+
+				unsigned char *out = dst + ((size_t)by * blocksX + bx) * blockSize;
+				if( withAlpha )
+				{
+					encodeAlphaBlock( block, out );
+					out += 8;
+				}
+				encodeColorBlock( block, out );
+			}
+		}
+	} );
+}
+
+}
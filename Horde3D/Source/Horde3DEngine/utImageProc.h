@@ -0,0 +1,72 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _utImageProc_H_
+#define _utImageProc_H_
+
+#include "utPlatform.h"
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// CPU image processing used by the texture loading pipeline
+// =================================================================================================
+
+struct MipFilters
+{
+	enum List
+	{
+		Driver = 0,  // Leave mipmap generation to the render device
+		Box,         // 2x2 box filter
+		Kaiser       // 6-tap Kaiser-windowed sinc
+	};
+};
+
+struct ImageLevel
+{
+	int                           width, height;
+	std::vector< unsigned char >  data;
+};
+
+namespace ImageProc
+{
+	typedef std::function< void( int, int ) > RangeFunc;
+	// Runs a RangeFunc on chunks of [0, count) with at least grainSize elements each; the processing
+	// functions take it from the caller to run on its threads and work on the calling thread without
+	typedef std::function< void( int count, int grainSize, const RangeFunc &func ) > ParallelForFunc;
+
+	// 64 bit FNV-1a hash; pass the result of a previous call as seed to hash several blocks
+	uint64 hash( const void *data, size_t size, uint64 seed = 14695981039346656037ULL );
+
+	// Swaps the red and blue channels of 8 bit RGBA/BGRA pixels in place
+	void swizzleRedBlue( uint32 *pixels, size_t count );
+
+	bool hasTranslucency( const unsigned char *rgba, size_t count );
+
+	// Builds levels 1..maxMipLevel of a RGBA8 image; for sRGB images filtering is done in linear space
+	void generateMips( const unsigned char *rgba, int width, int height, int maxMipLevel,
+	                   MipFilters::List filter, bool sRGB, std::vector< ImageLevel > &levels,
+	                   const ParallelForFunc &parallelFor = ParallelForFunc() );
+
+	// Encodes a RGBA8 image to BC1 (DXT1) or, if withAlpha is set, BC3 (DXT5) blocks;
+	// dst must hold calcBCSize( width, height, withAlpha ) bytes
+	size_t calcBCSize( int width, int height, bool withAlpha );
+	void encodeBC( const unsigned char *rgba, int width, int height, bool withAlpha, unsigned char *dst,
+	               const ParallelForFunc &parallelFor = ParallelForFunc() );
+}
+
+}
+#endif // _utImageProc_H_
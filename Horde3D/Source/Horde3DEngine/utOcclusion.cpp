@@ -0,0 +1,276 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "utOcclusion.h"
+#include "utSIMD.h"
+#include <algorithm>
+#include <cmath>
+
+#include "utDebug.h"
+
+
+namespace Horde3D {
+
+using namespace std;
+
+static const float OccMinClipW = 1e-6f;
+static const float OccMinTriArea = 1e-8f;  // Twice the screen-space area in pixels
+
+
+namespace {
+
+const float LaneOffsets[4] = { 0, 1, 2, 3 };
+
+
+// Keeps the closer depth in all lanes that are inside of the three edges
+inline Float4 depthTest4( Float4 depth, Float4 z, Float4 e0, Float4 e1, Float4 e2 )
+{
+	Float4 zero = splat4( 0 );
+	Mask4 inside = and4( and4( cmpGE4( e0, zero ), cmpGE4( e1, zero ) ), cmpGE4( e2, zero ) );
+	return select4( inside, min4( depth, z ), depth );
+}
+
+
+inline Vec4f lerpClip( const Vec4f &a, const Vec4f &b, float t )
+{
+	return Vec4f( a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t );
+}
+
+}  // namespace
+
+
+// *************************************************************************************************
+// Class OcclusionBuffer
+// *************************************************************************************************
+
+OcclusionBuffer::OcclusionBuffer() :
+	_width( 0 ), _height( 0 ), _rasterizedTris( 0 )
+{
+}
+
+
+void OcclusionBuffer::resize( uint32 width, uint32 height )
+{
+	width = (width + 3) & ~3u;
+	if( width == _width && height == _height ) return;
+
+	_width = width;
+	_height = height;
+	_depth.assign( (size_t)width * height, 1.0f );
+}
+
+
+void OcclusionBuffer::clear( const Matrix4f &viewProjMat )
+{
+	_viewProjMat = viewProjMat;
+	_rasterizedTris = 0;
+	std::fill( _depth.begin(), _depth.end(), 1.0f );
+}
+
+
+void OcclusionBuffer::rasterizeTriangles( const Matrix4f &worldMat, const Vec3f *verts, uint32 vertStart, uint32 vertEnd,
+                                          const void *indices, bool indices16, uint32 firstIndex, uint32 indexCount )
+{
+	if( _depth.empty() || verts == 0x0 || indices == 0x0 || vertEnd < vertStart ) return;
+
+	Matrix4f mvp = _viewProjMat * worldMat;
+
+	_clipVerts.resize( vertEnd - vertStart + 1 );
+	for( uint32 i = vertStart; i <= vertEnd; ++i )
+		_clipVerts[i - vertStart] = mvp * Vec4f( verts[i] );
+
+	for( uint32 i = firstIndex; i + 3 <= firstIndex + indexCount; i += 3 )
+	{
+		uint32 i0, i1, i2;
+		if( indices16 )
+		{
+			i0 = ((const uint16 *)indices)[i + 0]; i1 = ((const uint16 *)indices)[i + 1]; i2 = ((const uint16 *)indices)[i + 2];
+		}
+		else
+		{
+			i0 = ((const uint32 *)indices)[i + 0]; i1 = ((const uint32 *)indices)[i + 1]; i2 = ((const uint32 *)indices)[i + 2];
+		}
+		ASSERT( i0 >= vertStart && i1 >= vertStart && i2 >= vertStart );
+		ASSERT( i0 <= vertEnd && i1 <= vertEnd && i2 <= vertEnd );
+
+		rasterizeClipTriangle( _clipVerts[i0 - vertStart], _clipVerts[i1 - vertStart], _clipVerts[i2 - vertStart] );
+	}
+}
+
+
+void OcclusionBuffer::rasterizeClipTriangle( const Vec4f &v0, const Vec4f &v1, const Vec4f &v2 )
+{
+	const Vec4f *in[3] = { &v0, &v1, &v2 };
+	float dist[3];
+	uint32 numInside = 0;
+
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		dist[i] = in[i]->z + in[i]->w;  // Distance to the near plane z = -w
+		if( dist[i] >= 0 ) ++numInside;
+	}
+	if( numInside == 0 ) return;
+
+	// Clip polygon against near plane, the result has at most four vertices
+	Vec4f poly[4];
+	uint32 numVerts = 0;
+	if( numInside == 3 )
+	{
+		poly[0] = v0; poly[1] = v1; poly[2] = v2;
+		numVerts = 3;
+	}
+	else
+	{
+		for( uint32 i = 0; i < 3; ++i )
+		{
+			uint32 j = (i + 1) % 3;
+			if( dist[i] >= 0 ) poly[numVerts++] = *in[i];
+			if( (dist[i] >= 0) != (dist[j] >= 0) )
+				poly[numVerts++] = lerpClip( *in[i], *in[j], dist[i] / (dist[i] - dist[j]) );
+		}
+	}
+
+	// Project to screen space
+	Vec3f screen[4];
+	for( uint32 i = 0; i < numVerts; ++i )
+	{
+		if( poly[i].w < OccMinClipW ) return;
+
+		float invW = 1.0f / poly[i].w;
+		screen[i] = Vec3f( (poly[i].x * invW * 0.5f + 0.5f) * _width, (poly[i].y * invW * 0.5f + 0.5f) * _height,
+		                   poly[i].z * invW * 0.5f + 0.5f );
+	}
+
+	for( uint32 i = 2; i < numVerts; ++i )
+		rasterizeScreenTriangle( screen[0], screen[i - 1], screen[i] );
+	++_rasterizedTris;
+}
+
+
+void OcclusionBuffer::rasterizeScreenTriangle( const Vec3f &v0, const Vec3f &v1, const Vec3f &v2 )
+{
+	// Bring triangle into counter-clockwise order so that the inside has positive edge values
+	double area = ((double)v1.x - v0.x) * ((double)v2.y - v0.y) - ((double)v2.x - v0.x) * ((double)v1.y - v0.y);
+	if( fabs( area ) < OccMinTriArea ) return;
+
+	const Vec3f *p[3] = { &v0, &v1, &v2 };
+	if( area < 0 )
+	{
+		std::swap( p[1], p[2] );
+		area = -area;
+	}
+
+	// Pixel bounds; pixel centers are at half-integer coordinates
+	float minX = minf( minf( v0.x, v1.x ), v2.x ), maxX = maxf( maxf( v0.x, v1.x ), v2.x );
+	float minY = minf( minf( v0.y, v1.y ), v2.y ), maxY = maxf( maxf( v0.y, v1.y ), v2.y );
+	if( maxX < 0 || maxY < 0 || minX > (float)_width || minY > (float)_height ) return;
+
+	int x0 = (int)clamp( floorf( minX ), 0, (float)_width - 1 ) & ~3;
+	int x1 = (int)clamp( floorf( maxX ), 0, (float)_width - 1 );
+	int y0 = (int)clamp( floorf( minY ), 0, (float)_height - 1 );
+	int y1 = (int)clamp( floorf( maxY ), 0, (float)_height - 1 );
+
+	// Edge functions e = a * x + b * y + c; set up in double precision since vertices clipped close
+	// to the near plane can project far outside the buffer
+	double ea[3], eb[3], ec[3];
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		const Vec3f &a = *p[i], &b = *p[(i + 1) % 3];
+		ea[i] = (double)a.y - b.y;
+		eb[i] = (double)b.x - a.x;
+		ec[i] = -(ea[i] * a.x + eb[i] * a.y);
+	}
+
+	// Depth plane
+	double dzdx = (((double)p[1]->z - p[0]->z) * ((double)p[2]->y - p[0]->y) -
+	               ((double)p[2]->z - p[0]->z) * ((double)p[1]->y - p[0]->y)) / area;
+	double dzdy = (((double)p[2]->z - p[0]->z) * ((double)p[1]->x - p[0]->x) -
+	               ((double)p[1]->z - p[0]->z) * ((double)p[2]->x - p[0]->x)) / area;
+	double zc = p[0]->z - dzdx * p[0]->x - dzdy * p[0]->y;
+
+	Float4 offsets = load4( LaneOffsets );
+	Float4 laneE[3], stepE[3];
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		laneE[i] = mul4( splat4( (float)ea[i] ), offsets );
+		stepE[i] = splat4( (float)(ea[i] * 4) );
+	}
+	Float4 laneZ = mul4( splat4( (float)dzdx ), offsets );
+	Float4 stepZ = splat4( (float)(dzdx * 4) );
+
+	double px = x0 + 0.5;
+	for( int y = y0; y <= y1; ++y )
+	{
+		double py = y + 0.5;
+		Float4 e0 = add4( splat4( (float)(ea[0] * px + eb[0] * py + ec[0]) ), laneE[0] );
+		Float4 e1 = add4( splat4( (float)(ea[1] * px + eb[1] * py + ec[1]) ), laneE[1] );
+		Float4 e2 = add4( splat4( (float)(ea[2] * px + eb[2] * py + ec[2]) ), laneE[2] );
+		Float4 z = add4( splat4( (float)(dzdx * px + dzdy * py + zc) ), laneZ );
+
+		float *row = &_depth[(size_t)y * _width];
+		for( int x = x0; x <= x1; x += 4 )
+		{
+			store4( row + x, depthTest4( load4( row + x ), z, e0, e1, e2 ) );
+			e0 = add4( e0, stepE[0] );
+			e1 = add4( e1, stepE[1] );
+			e2 = add4( e2, stepE[2] );
+			z = add4( z, stepZ );
+		}
+	}
+}
+
+
+bool OcclusionBuffer::testBox( const Vec3f &bbMin, const Vec3f &bbMax ) const
+{
+	if( _depth.empty() ) return true;
+
+	float minX = Math::MaxFloat, maxX = -Math::MaxFloat;
+	float minY = Math::MaxFloat, maxY = -Math::MaxFloat;
+	float minZ = Math::MaxFloat;
+
+	for( uint32 i = 0; i < 8; ++i )
+	{
+		Vec4f corner( i & 1 ? bbMax.x : bbMin.x, i & 2 ? bbMax.y : bbMin.y, i & 4 ? bbMax.z : bbMin.z, 1.0f );
+		Vec4f c = _viewProjMat * corner;
+		if( c.z < -c.w || c.w < OccMinClipW ) return true;
+
+		float invW = 1.0f / c.w;
+		float sx = (c.x * invW * 0.5f + 0.5f) * _width;
+		float sy = (c.y * invW * 0.5f + 0.5f) * _height;
+		minX = minf( minX, sx ); maxX = maxf( maxX, sx );
+		minY = minf( minY, sy ); maxY = maxf( maxY, sy );
+		minZ = minf( minZ, c.z * invW * 0.5f + 0.5f );
+	}
+
+	// Boxes outside of the buffer are left to frustum culling
+	if( maxX < 0 || maxY < 0 || minX > (float)_width || minY > (float)_height ) return true;
+
+	// The test can include up to three pixels left of the box, which only makes it more conservative
+	int x0 = (int)clamp( floorf( minX ), 0, (float)_width - 1 ) & ~3;
+	int x1 = (int)clamp( floorf( maxX ), 0, (float)_width - 1 );
+	int y0 = (int)clamp( floorf( minY ), 0, (float)_height - 1 );
+	int y1 = (int)clamp( floorf( maxY ), 0, (float)_height - 1 );
+
+	Float4 boxZ = splat4( minZ );
+	for( int y = y0; y <= y1; ++y )
+	{
+		const float *row = &_depth[(size_t)y * _width];
+		for( int x = x0; x <= x1; x += 4 )
+		{
+			if( movemask4( cmpGE4( load4( row + x ), boxZ ) ) != 0 ) return true;
+		}
+	}
+
+	return false;
+}
+
+}  // namespace
@@ -0,0 +1,66 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _utOcclusion_H_
+#define _utOcclusion_H_
+
+#include "utPlatform.h"
+#include "utMath.h"
+#include <vector>
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// Software Occlusion Buffer
+// =================================================================================================
+
+// Low resolution depth buffer that occluder triangles are rasterized into on the CPU. Depth values
+// are normalized device depths mapped to [0, 1]; the buffer does not depend on a render device.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer();
+
+	// The width is rounded up to a multiple of four pixels
+	void resize( uint32 width, uint32 height );
+	// Resets all pixels to the far plane and sets the matrix used by subsequent calls
+	void clear( const Matrix4f &viewProjMat );
+
+	// Rasterizes the triangles in [firstIndex, firstIndex + indexCount) of the index data. Only the
+	// vertices in [vertStart, vertEnd] are transformed, all indices must be within that range.
+	void rasterizeTriangles( const Matrix4f &worldMat, const Vec3f *verts, uint32 vertStart, uint32 vertEnd,
+	                         const void *indices, bool indices16, uint32 firstIndex, uint32 indexCount );
+
+	// Returns false if the box is completely hidden behind the rasterized occluders. The test is
+	// conservative, boxes intersecting the near plane are always reported as visible.
+	bool testBox( const Vec3f &bbMin, const Vec3f &bbMax ) const;
+
+	uint32 getWidth() const { return _width; }
+	uint32 getHeight() const { return _height; }
+	const float *getDepthData() const { return _depth.empty() ? 0x0 : &_depth[0]; }
+	uint32 getRasterizedTriCount() const { return _rasterizedTris; }
+
+protected:
+	void rasterizeClipTriangle( const Vec4f &v0, const Vec4f &v1, const Vec4f &v2 );
+	void rasterizeScreenTriangle( const Vec3f &v0, const Vec3f &v1, const Vec3f &v2 );
+
+protected:
+	std::vector< float >  _depth;
+	std::vector< Vec4f >  _clipVerts;  // Scratch buffer for transformed vertices
+	Matrix4f              _viewProjMat;
+	uint32                _width, _height;
+	uint32                _rasterizedTris;
+};
+
+}
+#endif // _utOcclusion_H_
@@ -0,0 +1,110 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#ifndef _utSIMD_H_
+#define _utSIMD_H_
+
+#include "utPlatform.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	include <emmintrin.h>
+#	define H3D_SIMD_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#	include <arm_neon.h>
+#	define H3D_SIMD_NEON
+#endif
+
+
+namespace Horde3D {
+
+// =================================================================================================
+// Four-wide float operations
+// =================================================================================================
+
+// Thin wrappers so that CPU-side loops can process four values at once with SSE2, NEON or a
+// scalar fallback; comparisons return a lane mask that can be used with select4 or movemask4
+
+#if defined( H3D_SIMD_SSE2 )
+
+typedef __m128 Float4;
+typedef __m128 Mask4;
+
+inline Float4 splat4( float f ) { return _mm_set1_ps( f ); }
+inline Float4 load4( const float *p ) { return _mm_loadu_ps( p ); }
+inline void store4( float *p, Float4 v ) { _mm_storeu_ps( p, v ); }
+inline Float4 add4( Float4 a, Float4 b ) { return _mm_add_ps( a, b ); }
+inline Float4 sub4( Float4 a, Float4 b ) { return _mm_sub_ps( a, b ); }
+inline Float4 mul4( Float4 a, Float4 b ) { return _mm_mul_ps( a, b ); }
+inline Float4 min4( Float4 a, Float4 b ) { return _mm_min_ps( a, b ); }
+inline Float4 max4( Float4 a, Float4 b ) { return _mm_max_ps( a, b ); }
+
+inline Mask4 cmpGE4( Float4 a, Float4 b ) { return _mm_cmpge_ps( a, b ); }
+inline Mask4 and4( Mask4 a, Mask4 b ) { return _mm_and_ps( a, b ); }
+inline Float4 select4( Mask4 m, Float4 a, Float4 b ) { return _mm_or_ps( _mm_and_ps( m, a ), _mm_andnot_ps( m, b ) ); }
+inline int movemask4( Mask4 m ) { return _mm_movemask_ps( m ); }
+
+#elif defined( H3D_SIMD_NEON )
+
+typedef float32x4_t Float4;
+typedef uint32x4_t Mask4;
+
+inline Float4 splat4( float f ) { return vdupq_n_f32( f ); }
+inline Float4 load4( const float *p ) { return vld1q_f32( p ); }
+inline void store4( float *p, Float4 v ) { vst1q_f32( p, v ); }
+inline Float4 add4( Float4 a, Float4 b ) { return vaddq_f32( a, b ); }
+inline Float4 sub4( Float4 a, Float4 b ) { return vsubq_f32( a, b ); }
+inline Float4 mul4( Float4 a, Float4 b ) { return vmulq_f32( a, b ); }
+inline Float4 min4( Float4 a, Float4 b ) { return vminq_f32( a, b ); }
+inline Float4 max4( Float4 a, Float4 b ) { return vmaxq_f32( a, b ); }
+
+inline Mask4 cmpGE4( Float4 a, Float4 b ) { return vcgeq_f32( a, b ); }
+inline Mask4 and4( Mask4 a, Mask4 b ) { return vandq_u32( a, b ); }
+inline Float4 select4( Mask4 m, Float4 a, Float4 b ) { return vbslq_f32( m, a, b ); }
+
+inline int movemask4( Mask4 m )
+{
+	static const uint32 laneBits[4] = { 1, 2, 4, 8 };
+	uint32x4_t bits = vandq_u32( m, vld1q_u32( laneBits ) );
+	uint32x2_t sum = vadd_u32( vget_low_u32( bits ), vget_high_u32( bits ) );
+	return (int)vget_lane_u32( vpadd_u32( sum, sum ), 0 );
+}
+
+#else
+
+struct Float4
+{
+	float v[4];
+};
+
+struct Mask4
+{
+	bool v[4];
+};
+
+inline Float4 splat4( float f ) { Float4 r; r.v[0] = r.v[1] = r.v[2] = r.v[3] = f; return r; }
+inline Float4 load4( const float *p ) { Float4 r; for( int i = 0; i < 4; ++i ) r.v[i] = p[i]; return r; }
+inline void store4( float *p, Float4 v ) { for( int i = 0; i < 4; ++i ) p[i] = v.v[i]; }
+inline Float4 add4( Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] += b.v[i]; return a; }
+inline Float4 sub4( Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] -= b.v[i]; return a; }
+inline Float4 mul4( Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] *= b.v[i]; return a; }
+inline Float4 min4( Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline Float4 max4( Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+
+inline Mask4 cmpGE4( Float4 a, Float4 b ) { Mask4 m; for( int i = 0; i < 4; ++i ) m.v[i] = a.v[i] >= b.v[i]; return m; }
+inline Mask4 and4( Mask4 a, Mask4 b ) { for( int i = 0; i < 4; ++i ) a.v[i] = a.v[i] && b.v[i]; return a; }
+inline Float4 select4( Mask4 m, Float4 a, Float4 b ) { for( int i = 0; i < 4; ++i ) if( !m.v[i] ) a.v[i] = b.v[i]; return a; }
+inline int movemask4( Mask4 m ) { return (m.v[0] ? 1 : 0) | (m.v[1] ? 2 : 0) | (m.v[2] ? 4 : 0) | (m.v[3] ? 8 : 0); }
+
+#endif
+
+}
+#endif // _utSIMD_H_
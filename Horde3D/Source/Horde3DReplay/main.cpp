@@ -0,0 +1,113 @@
+// *************************************************************************************************
+//
+// Horde3D
+//   Next-Generation Graphics Engine
+// --------------------------------------
+// Copyright (C) 2006-2020 Nicolas Schulz and Horde3D team
+//
+// This software is distributed under the terms of the Eclipse Public License v1.0.
+// A copy of the license may be obtained at: http://www.eclipse.org/legal/epl-v10.html
+//
+// *************************************************************************************************
+
+#include "Horde3D.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+
+void printHelp()
+{
+	printf( "Usage:\n" );
+	printf( "Horde3DReplay FILE [optional arguments]\n\n" );
+	printf( "Replays a capture recorded with h3dBeginCapture using the null render device and prints\n" );
+	printf( "the captured and replayed time of each frame in ms.\n\n" );
+	printf( "Optional arguments:\n" );
+	printf( "-frames N    replay at most N frames\n" );
+	printf( "-quiet       print only the summary\n" );
+}
+
+
+float getPercentile( vector< float > values, float percentile )
+{
+	if( values.empty() ) return 0;
+
+	// Nearest rank
+	sort( values.begin(), values.end() );
+	size_t rank = (size_t)(percentile / 100.0f * values.size() + 0.999f);
+
+	return values[min( max( rank, (size_t)1 ), values.size() ) - 1];
+}
+
+
+int main( int argc, char **argv )
+{
+	const char *fileName = 0x0;
+	int maxFrames = -1;
+	bool quiet = false;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-frames" ) == 0 && i + 1 < argc ) maxFrames = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-quiet" ) == 0 ) quiet = true;
+		else if( argv[i][0] != '-' && fileName == 0x0 ) fileName = argv[i];
+		else
+		{
+			printHelp();
+			return 1;
+		}
+	}
+
+	if( fileName == 0x0 )
+	{
+		printHelp();
+		return 1;
+	}
+
+	// The null render device executes the CPU side of the engine without a graphics context, which
+	// makes replays comparable across machines
+	if( !h3dInit( H3DRenderDevice::Null ) || !h3dBeginReplay( fileName ) )
+	{
+		printf( "Failed to replay '%s'\n", fileName );
+		h3dRelease();
+		return 1;
+	}
+
+	vector< float > captureTimes, replayTimes;
+	if( !quiet ) printf( "frame;capture_ms;replay_ms\n" );
+
+	float captureTime = 0;
+	for( int frame = 0; frame != maxFrames; ++frame )
+	{
+		chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+		if( !h3dReplayFrame( &captureTime ) ) break;
+		float replayTime = chrono::duration< float, milli >( chrono::steady_clock::now() - begin ).count();
+
+		captureTimes.push_back( captureTime );
+		replayTimes.push_back( replayTime );
+		if( !quiet ) printf( "%i;%.3f;%.3f\n", frame, captureTime, replayTime );
+	}
+
+	h3dEndReplay();
+
+	printf( "Replayed %u frames\n", (unsigned int)replayTimes.size() );
+	printf( "capture: median %.3f ms, p99 %.3f ms\n", getPercentile( captureTimes, 50 ), getPercentile( captureTimes, 99 ) );
+	printf( "replay:  median %.3f ms, p99 %.3f ms\n", getPercentile( replayTimes, 50 ), getPercentile( replayTimes, 99 ) );
+
+	// Divergences and errors of the replay
+	int level;
+	float time;
+	for( const char *msg = h3dGetMessage( &level, &time ); msg[0] != '\0'; msg = h3dGetMessage( &level, &time ) )
+	{
+		if( level <= 2 ) fprintf( stderr, "%s: %s\n", level == 1 ? "Error" : "Warning", msg );
+	}
+
+	h3dRelease();
+
+	return 0;
+}